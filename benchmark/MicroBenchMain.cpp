@@ -0,0 +1,140 @@
+#include <benchmark/benchmark.h>
+
+#include "RingBuffer.hpp"
+#include "LockFreeRingBuffer.hpp"
+#include "TelemetryBuffer.hpp"
+#include "UpdateThread/LockableClass.hpp"
+#include "TypeGenerator.hpp"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace robot_remote_control;
+
+/**
+ * component level benchmarks of the buffers, locks and protobuf paths used for each message,
+ * to compare changes of these against the current implementation on the same machine
+ *
+ * usage: rrc_microbench [--benchmark_format=json] (see --help for the google benchmark options)
+ */
+
+// push/pop pairs of a RingBuffer, arg: number of callbacks
+static void BM_RingBufferPushPop(benchmark::State &state) {
+    RingBuffer<Pose> buffer(10);
+    int64_t called = 0;
+    for (int i = 0; i < state.range(0); ++i) {
+        buffer.addDataReceivedCallback([&called](const Pose &) { called++; });
+    }
+    Pose pose = TypeGenerator::genPose();
+    Pose popped;
+    for (auto _ : state) {
+        buffer.pushData(pose);
+        buffer.popData(&popped);
+    }
+    benchmark::DoNotOptimize(called);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RingBufferPushPop)->Arg(0)->Arg(1)->Arg(4);
+
+static void BM_LockFreeRingBufferPushPop(benchmark::State &state) {
+    LockFreeRingBuffer<Pose> buffer(10);
+    Pose pose = TypeGenerator::genPose();
+    Pose popped;
+    for (auto _ : state) {
+        buffer.pushData(pose);
+        buffer.popData(&popped);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LockFreeRingBufferPushPop);
+
+// the access through the base class pointer as in the old telemetry path
+static void BM_RingBufferAccessPushPop(benchmark::State &state) {
+    std::shared_ptr<RingBufferBase> buffer(new RingBuffer<Pose>(10));
+    Pose pose = TypeGenerator::genPose();
+    Pose popped;
+    for (auto _ : state) {
+        RingBufferAccess::pushData(buffer, pose);
+        RingBufferAccess::popData(buffer, &popped);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RingBufferAccessPushPop);
+
+// the same through a TelemetryBuffer::Handle (locked, no dynamic_pointer_cast)
+static void BM_TelemetryHandlePushPop(benchmark::State &state) {
+    TelemetryBuffer buffers;
+    TelemetryBuffer::Handle<Pose> handle = buffers.registerType<Pose>(CURRENT_POSE, 10);
+    Pose pose = TypeGenerator::genPose();
+    Pose popped;
+    for (auto _ : state) {
+        handle.pushData(pose);
+        handle.popData(&popped);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TelemetryHandlePushPop);
+
+static void BM_TelemetryPeekSerialized(benchmark::State &state) {
+    TelemetryBuffer buffers;
+    buffers.registerType<PointCloud>(POINTCLOUD, 10).pushData(TypeGenerator::genPointCloud(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(buffers.peekSerialized(POINTCLOUD));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TelemetryPeekSerialized)->Arg(100)->Arg(10000);
+
+// parsing a received message into the buffer, as done for each received telemetry message, arg: lazy buffer
+template <class TYPE> static void telemetryParse(benchmark::State &state, const TYPE &message) {
+    TelemetryBuffer buffers;
+    TelemetryBuffer::Handle<TYPE> handle = buffers.registerType<TYPE>(0, 10, false, state.range(0));
+    const std::string serialized = message.SerializeAsString();
+    for (auto _ : state) {
+        handle.pushSerialized(serialized.data(), serialized.size(), true);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * serialized.size());
+}
+
+static void BM_TelemetryParsePose(benchmark::State &state) {
+    telemetryParse(state, TypeGenerator::genPose());
+}
+BENCHMARK(BM_TelemetryParsePose)->Arg(0)->Arg(1);
+
+static void BM_TelemetryParseJointState(benchmark::State &state) {
+    telemetryParse(state, TypeGenerator::genJointState());
+}
+BENCHMARK(BM_TelemetryParseJointState)->Arg(0)->Arg(1);
+
+static void BM_TelemetryParsePointCloud(benchmark::State &state) {
+    telemetryParse(state, TypeGenerator::genPointCloud(1000));
+}
+BENCHMARK(BM_TelemetryParsePointCloud)->Arg(0)->Arg(1);
+
+// LockableClass::lockedAccess() of the benchmark thread while arg threads are spinning on it
+static void BM_LockableClassContended(benchmark::State &state) {
+    LockableClass<int64_t> value(0);
+    std::atomic<bool> running(true);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < state.range(0); ++i) {
+        readers.emplace_back([&value, &running]() {
+            while (running.load(std::memory_order_relaxed)) {
+                benchmark::DoNotOptimize(value.lockedAccess().get());
+            }
+        });
+    }
+    for (auto _ : state) {
+        value.lockedAccess().get()++;
+    }
+    running.store(false);
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LockableClassContended)->Arg(0)->Arg(1)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,253 @@
+#include "RobotController.hpp"
+#include "ControlledRobot.hpp"
+#include "Transports/TransportZmq.hpp"
+#include "Transports/TransportLoopback.hpp"
+#ifdef RRC_BENCH_GZIP
+    #include "Transports/TransportWrapperGzip.hpp"
+#endif
+#ifdef RRC_BENCH_UDT
+    #include "Transports/TransportUDT.hpp"
+#endif
+#ifdef RRC_BENCH_SHM
+    #include "Transports/TransportShm.hpp"
+#endif
+#include "TypeGenerator.hpp"
+
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using robot_remote_control::TransportSharedPtr;
+using robot_remote_control::TransportZmq;
+using robot_remote_control::RobotController;
+using robot_remote_control::ControlledRobot;
+using robot_remote_control::TypeGenerator;
+
+/**
+ * end-to-end benchmark of a ControlledRobot/RobotController pair in this process over the transport variants
+ *
+ * usage: rrc_bench [transports=tcp,ipc,gzip,udt,shm,loopback] [seconds per benchmark=2] [point cloud sizes=1000,10000,100000,1000000]
+ *
+ * Prints one JSON object per line and benchmark:
+ * command_rtt: percentiles of the time until a command is acknowledged
+ * telemetry: messages and bytes per second received, and the cpu time (of both sides) per message
+ */
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Transports {
+    TransportSharedPtr robotCommands;
+    TransportSharedPtr robotTelemetry;
+    TransportSharedPtr commands;
+    TransportSharedPtr telemetry;
+};
+
+// the largest point clouds are bigger than the default buffers of UDT and shared memory
+const size_t maxMessageSize = 64 * 1024 * 1024;
+
+bool createTransports(const std::string &name, const int &index, Transports *transports) {
+    const std::string commandPort = std::to_string(7100 + 2 * index);
+    const std::string telemetryPort = std::to_string(7101 + 2 * index);
+    if (name == "tcp") {
+        transports->robotCommands = TransportSharedPtr(new TransportZmq("tcp://*:" + commandPort, TransportZmq::REP));
+        transports->robotTelemetry = TransportSharedPtr(new TransportZmq("tcp://*:" + telemetryPort, TransportZmq::PUB));
+        transports->commands = TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:" + commandPort, TransportZmq::REQ));
+        transports->telemetry = TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:" + telemetryPort, TransportZmq::SUB));
+        return true;
+    }
+    if (name == "ipc") {
+        transports->robotCommands = TransportSharedPtr(new TransportZmq("ipc:///tmp/rrc_bench_commands", TransportZmq::REP));
+        transports->robotTelemetry = TransportSharedPtr(new TransportZmq("ipc:///tmp/rrc_bench_telemetry", TransportZmq::PUB));
+        transports->commands = TransportSharedPtr(new TransportZmq("ipc:///tmp/rrc_bench_commands", TransportZmq::REQ));
+        transports->telemetry = TransportSharedPtr(new TransportZmq("ipc:///tmp/rrc_bench_telemetry", TransportZmq::SUB));
+        return true;
+    }
+#ifdef RRC_BENCH_GZIP
+    if (name == "gzip") {
+        using robot_remote_control::TransportWrapperGzip;
+        transports->robotCommands = TransportSharedPtr(new TransportWrapperGzip(TransportSharedPtr(new TransportZmq("tcp://*:" + commandPort, TransportZmq::REP))));
+        transports->robotTelemetry = TransportSharedPtr(new TransportWrapperGzip(TransportSharedPtr(new TransportZmq("tcp://*:" + telemetryPort, TransportZmq::PUB))));
+        transports->commands = TransportSharedPtr(new TransportWrapperGzip(TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:" + commandPort, TransportZmq::REQ))));
+        transports->telemetry = TransportSharedPtr(new TransportWrapperGzip(TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:" + telemetryPort, TransportZmq::SUB))));
+        return true;
+    }
+#endif
+#ifdef RRC_BENCH_UDT
+    if (name == "udt") {
+        using robot_remote_control::TransportUDT;
+        transports->robotCommands = TransportSharedPtr(new TransportUDT(TransportUDT::SERVER, atoi(commandPort.c_str()), "", maxMessageSize));
+        transports->robotTelemetry = TransportSharedPtr(new TransportUDT(TransportUDT::SERVER, atoi(telemetryPort.c_str()), "", maxMessageSize));
+        transports->commands = TransportSharedPtr(new TransportUDT(TransportUDT::CLIENT, atoi(commandPort.c_str()), "127.0.0.1", maxMessageSize));
+        transports->telemetry = TransportSharedPtr(new TransportUDT(TransportUDT::CLIENT, atoi(telemetryPort.c_str()), "127.0.0.1", maxMessageSize));
+        return true;
+    }
+#endif
+    if (name == "loopback") {
+        using robot_remote_control::TransportLoopback;
+        TransportLoopback::Options options;
+        std::tie(transports->commands, transports->robotCommands) = TransportLoopback::createPair(options);
+        options.dropWhenFull = true;
+        std::tie(transports->telemetry, transports->robotTelemetry) = TransportLoopback::createPair(options);
+        return true;
+    }
+#ifdef RRC_BENCH_SHM
+    if (name == "shm") {
+        using robot_remote_control::TransportShm;
+        TransportShm::Options options;
+        // the largest message is 8 bytes smaller than the ring
+        options.capacity = maxMessageSize + 8;
+        transports->robotCommands = TransportSharedPtr(new TransportShm("rrc_bench_commands", TransportShm::SERVER, options));
+        options.dropWhenFull = true;
+        transports->robotTelemetry = TransportSharedPtr(new TransportShm("rrc_bench_telemetry", TransportShm::SERVER, options));
+        transports->commands = TransportSharedPtr(new TransportShm("rrc_bench_commands", TransportShm::CLIENT));
+        transports->telemetry = TransportSharedPtr(new TransportShm("rrc_bench_telemetry", TransportShm::CLIENT));
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::vector<std::string> split(const std::string &list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// user and system time of the process in microseconds
+int64_t cpuTimeUs() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+double elapsedS(const Clock::time_point &start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void benchCommandRtt(const std::string &transport, RobotController *controller, const float &seconds) {
+    robot_remote_control::Twist twist = TypeGenerator::genTwist();
+    std::vector<double> rtts;
+    Clock::time_point start = Clock::now();
+    while (elapsedS(start) < seconds) {
+        Clock::time_point sent = Clock::now();
+        // returns when the command was acknowledged
+        controller->setTwistCommand(twist);
+        rtts.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+    }
+    std::sort(rtts.begin(), rtts.end());
+    auto percentile = [&rtts](const double &p) {
+        return rtts[std::min(rtts.size() - 1, static_cast<size_t>(p * rtts.size()))];
+    };
+    printf("{\"transport\": \"%s\", \"benchmark\": \"command_rtt\", \"type\": \"TWIST_COMMAND\", \"count\": %zu, "
+           "\"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}\n",
+           transport.c_str(), rtts.size(), percentile(0.5), percentile(0.9), percentile(0.99), rtts.back());
+    fflush(stdout);
+}
+
+/**
+ * sends with a window of messages in flight, so the sender measures what arrives instead of filling queues
+ */
+void benchTelemetry(const std::string &transport, const std::string &type, const int &points, const std::function<int()> &send,
+                    std::atomic<uint64_t> *received, const float &seconds) {
+    const int64_t window = 8;
+    received->store(0);
+    int64_t sent = 0;
+    int64_t lost = 0;
+    int64_t bytes = 0;
+    int64_t cpuStart = cpuTimeUs();
+    Clock::time_point start = Clock::now();
+    while (elapsedS(start) < seconds) {
+        Clock::time_point waitStart = Clock::now();
+        while (sent - lost - static_cast<int64_t>(received->load()) >= window) {
+            if (elapsedS(waitStart) > 1) {
+                // dropped by the transport
+                lost = sent - received->load();
+                break;
+            }
+            usleep(100);
+        }
+        // 0 if dropped
+        bytes = std::max<int64_t>(bytes, send());
+        sent++;
+    }
+    // the messages in flight
+    Clock::time_point drainStart = Clock::now();
+    while (static_cast<int64_t>(received->load()) + lost < sent && elapsedS(drainStart) < 5) {
+        usleep(1000);
+    }
+    double elapsed = elapsedS(start);
+    int64_t cpu = cpuTimeUs() - cpuStart;
+    int64_t count = received->load();
+    printf("{\"transport\": \"%s\", \"benchmark\": \"telemetry\", \"type\": \"%s\", \"points\": %i, \"bytes\": %li, "
+           "\"sent\": %li, \"received\": %li, \"messages_per_s\": %.1f, \"mb_per_s\": %.3f, \"cpu_us_per_message\": %.1f}\n",
+           transport.c_str(), type.c_str(), points, static_cast<long>(bytes), static_cast<long>(sent), static_cast<long>(count),
+           count / elapsed, count * bytes / elapsed / 1000000.0, count ? static_cast<double>(cpu) / count : 0.0);
+    fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> transportNames = split(argc > 1 ? argv[1] : "tcp,ipc,gzip,udt,shm,loopback");
+    const float seconds = argc > 2 ? atof(argv[2]) : 2;
+    std::vector<std::string> sizes = split(argc > 3 ? argv[3] : "1000,10000,100000,1000000");
+
+    for (size_t index = 0; index < transportNames.size(); ++index) {
+        const std::string &name = transportNames[index];
+        Transports transports;
+        if (!createTransports(name, index, &transports)) {
+            fprintf(stderr, "transport %s is not available\n", name.c_str());
+            continue;
+        }
+        ControlledRobot robot(transports.robotCommands, transports.robotTelemetry);
+        RobotController controller(transports.commands, transports.telemetry);
+        std::atomic<uint64_t> received(0);
+        // the messages are only counted, full buffers would drop them before the callbacks
+        for (const uint16_t &type : {robot_remote_control::CURRENT_POSE, robot_remote_control::JOINT_STATE, robot_remote_control::POINTCLOUD}) {
+            controller.setLatestValueTelemetry(type);
+        }
+        controller.addTelemetryReceivedCallback<robot_remote_control::Pose>(robot_remote_control::CURRENT_POSE,
+            [&received](const robot_remote_control::Pose &) { received++; });
+        controller.addTelemetryReceivedCallback<robot_remote_control::JointState>(robot_remote_control::JOINT_STATE,
+            [&received](const robot_remote_control::JointState &) { received++; });
+        controller.addTelemetryReceivedCallback<robot_remote_control::PointCloud>(robot_remote_control::POINTCLOUD,
+            [&received](const robot_remote_control::PointCloud &) { received++; });
+        robot.startUpdateThread(10, robot_remote_control::UpdateThread::REACTOR);
+        controller.startUpdateThread(10, robot_remote_control::UpdateThread::REACTOR);
+        // connections and subscriptions
+        sleep(1);
+
+        benchCommandRtt(name, &controller, seconds);
+
+        robot_remote_control::Pose pose = TypeGenerator::genPose();
+        benchTelemetry(name, "CURRENT_POSE", 0, [&]() { return robot.setCurrentPose(pose); }, &received, seconds);
+        robot_remote_control::JointState joints = TypeGenerator::genJointState();
+        benchTelemetry(name, "JOINT_STATE", 0, [&]() { return robot.setJointState(joints); }, &received, seconds);
+        for (const std::string &size : sizes) {
+            int points = atoi(size.c_str());
+            robot_remote_control::PointCloud pointcloud = TypeGenerator::genPointCloud(points);
+            benchTelemetry(name, "POINTCLOUD", points, [&]() { return robot.setPointCloud(pointcloud); }, &received, seconds);
+        }
+
+        controller.stopUpdateThread();
+        robot.stopUpdateThread();
+    }
+    return 0;
+}
@@ -246,7 +246,8 @@ int main(int argc, char** argv)
         robot.getStatistics().calculate();
         robot.getStatistics().print(true);
 
-        usleep(100000);
+        // react to a target pose right away, otherwise update the telemetry every 100 ms
+        robot.waitForCommand(robot_remote_control::TARGET_POSE_COMMAND, 100);
     }
 
 
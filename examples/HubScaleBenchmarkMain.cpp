@@ -0,0 +1,87 @@
+#include "RobotControllerHub.hpp"
+#include "ControlledRobot.hpp"
+#include "Transports/TransportZmq.hpp"
+
+#include <unistd.h>
+#include <cstdlib>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using robot_remote_control::TransportSharedPtr;
+using robot_remote_control::TransportZmq;
+using robot_remote_control::RobotController;
+using robot_remote_control::RobotControllerHub;
+using robot_remote_control::ControlledRobot;
+
+/**
+ * simulated robots sending poses to one RobotControllerHub in the same process
+ *
+ * usage: hub_scale_benchmark [robots=100] [hub threads=2] [pose rate in Hz=50] [seconds=10] [zmq io threads=2]
+ */
+int main(int argc, char** argv) {
+    const int robotCount = argc > 1 ? atoi(argv[1]) : 100;
+    const int hubThreads = argc > 2 ? atoi(argv[2]) : 2;
+    const int rate = argc > 3 ? atoi(argv[3]) : 50;
+    const int seconds = argc > 4 ? atoi(argv[4]) : 10;
+    const int ioThreads = argc > 5 ? atoi(argv[5]) : 2;
+    const int basePort = 20000;
+
+    TransportZmq::setIOThreads(ioThreads);
+
+    std::vector< std::shared_ptr<ControlledRobot> > robots;
+    RobotControllerHub hub(hubThreads);
+    std::atomic<uint64_t> received(0);
+
+    for (int i = 0; i < robotCount; ++i) {
+        std::string commandPort = std::to_string(basePort + 2 * i);
+        std::string telemetryPort = std::to_string(basePort + 2 * i + 1);
+        TransportSharedPtr robotCommands = TransportSharedPtr(new TransportZmq("tcp://*:" + commandPort, TransportZmq::REP));
+        TransportSharedPtr robotTelemetry = TransportSharedPtr(new TransportZmq("tcp://*:" + telemetryPort, TransportZmq::PUB));
+        robots.push_back(std::make_shared<ControlledRobot>(robotCommands, robotTelemetry));
+
+        TransportSharedPtr commands = TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:" + commandPort, TransportZmq::REQ));
+        TransportSharedPtr telemetry = TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:" + telemetryPort, TransportZmq::SUB));
+        std::shared_ptr<RobotController> controller = std::make_shared<RobotController>(commands, telemetry);
+        controller->addTelemetryReceivedCallback<robot_remote_control::Pose>(robot_remote_control::CURRENT_POSE,
+            [&received](const robot_remote_control::Pose &pose) {
+                received++;
+            });
+        hub.addRobot("robot_" + std::to_string(i), controller);
+    }
+
+    // the hub runs twice as fast as the robots send
+    hub.start(std::max(1, 500 / rate));
+    // wait for the subscriptions
+    sleep(1);
+    received.store(0);
+
+    robot_remote_control::Pose pose;
+    pose.mutable_orientation()->set_w(1);
+    Timer timer;
+    timer.start();
+    uint64_t sent = 0;
+    const useconds_t interval = 1000000 / rate;
+    while (timer.getElapsedTime() < seconds) {
+        // all simulated robots in this thread
+        for (const std::shared_ptr<ControlledRobot> &robot : robots) {
+            pose.mutable_position()->set_x(sent);
+            robot->setCurrentPose(pose);
+            robot->update();
+            sent++;
+        }
+        usleep(interval);
+    }
+    float elapsed = timer.getElapsedTime();
+    // the last messages in flight
+    usleep(100 * 1000);
+    hub.stop();
+
+    printf("robots: %i, hub threads: %i, zmq io threads: %i\n", robotCount, hubThreads, ioThreads);
+    printf("sent %llu poses, received %llu (%.1f%%), %.0f poses/s, hub overruns: %llu\n",
+           (unsigned long long)sent, (unsigned long long)received.load(), sent ? 100.0 * received.load() / sent : 0.0,
+           received.load() / elapsed, (unsigned long long)hub.getOverruns());
+    return 0;
+}
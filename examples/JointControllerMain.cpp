@@ -170,7 +170,8 @@ int main(int argc, char** argv) {
             controller.setJointCommand(jointcommand);
 
         } else {
-            usleep(20000);
+            // returns as soon as a new joint state is received
+            controller.waitForTelemetry(robot_remote_control::JOINT_STATE, 20);
         }
 
         usleep(10000);
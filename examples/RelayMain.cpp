@@ -0,0 +1,51 @@
+#include "Relay/TelemetryRelay.hpp"
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+
+#include "Transports/TransportZmq.hpp"
+
+using robot_remote_control::TransportSharedPtr;
+using robot_remote_control::TransportZmq;
+
+/**
+ * relays a robot (ControlledRobotMain, ports 7001/7002) to controllers connecting to the ports 7101/7102,
+ * a second telemetry port 7103 only gets every 10th pose and no point clouds
+ *
+ * usage: robot_remote_control-relay_bin [robot address, default 127.0.0.1]
+ */
+int main(int argc, char** argv) {
+    std::string robot = argc > 1 ? argv[1] : "127.0.0.1";
+
+    TransportSharedPtr robotCommands = TransportSharedPtr(new TransportZmq("tcp://" + robot + ":7001", TransportZmq::REQ));
+    TransportSharedPtr robotTelemetry = TransportSharedPtr(new TransportZmq("tcp://" + robot + ":7002", TransportZmq::SUB));
+
+    // ROUTER, so several controllers can send requests at the same time
+    TransportSharedPtr clientCommands = TransportSharedPtr(new TransportZmq("tcp://*:7101", TransportZmq::ROUTER));
+    TransportSharedPtr clientTelemetry = TransportSharedPtr(new TransportZmq("tcp://*:7102", TransportZmq::PUB));
+    TransportSharedPtr reducedTelemetry = TransportSharedPtr(new TransportZmq("tcp://*:7103", TransportZmq::PUB));
+
+    robot_remote_control::TelemetryRelay relay(robotCommands, robotTelemetry, clientCommands);
+    relay.addDownstream(clientTelemetry);
+
+    robot_remote_control::TelemetryRelay::DownstreamOptions reduced;
+    reduced.decimation[robot_remote_control::CURRENT_POSE] = 10;
+    for (uint16_t type = robot_remote_control::NO_TELEMETRY_DATA + 1; type < robot_remote_control::TELEMETRY_MESSAGE_TYPES_NUMBER; ++type) {
+        if (type != robot_remote_control::POINTCLOUD) {
+            reduced.types.push_back(type);
+        }
+    }
+    relay.addDownstream(reducedTelemetry, reduced);
+
+    relay.startUpdateThread(10);
+
+    while (true) {
+        robot_remote_control::TelemetryRelay::Statistics statistics = relay.getStatistics();
+        std::cout << "received " << statistics.received << " forwarded " << statistics.forwarded << " dropped " << statistics.dropped
+                  << " answered " << statistics.answeredLocally << " requests to the robot " << statistics.requestsForwarded << std::endl;
+        sleep(1);
+    }
+
+    return 0;
+}
@@ -112,8 +112,8 @@ int main(int argc, char** argv) {
 
         printf("latency %f seconds\n", controller.getHeartBreatRoundTripTime()/2.0);
 
-
-        usleep(10000);
+        // wait for the next pose instead of sleeping, at most 10 ms
+        controller.waitForTelemetry(robot_remote_control::CURRENT_POSE, 10);
     }
 
     return 0;
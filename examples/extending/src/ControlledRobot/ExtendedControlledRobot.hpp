@@ -14,7 +14,7 @@ class ExtendedControlledRobot : public ControlledRobot {
     }
 
     int setNewTelemetryMessage(const myrobot::NewTelemetryMessage& telemetry) {
-        return sendTelemetry(telemetry, NEW_TELEMETRY_MESSAGE);
+        return setTelemetry<NEW_TELEMETRY_MESSAGE>(telemetry);
     }
 
  private:
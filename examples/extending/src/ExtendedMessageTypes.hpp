@@ -3,6 +3,7 @@
 #include "Types/myrobot.pb.h"
 
 #include <robot_remote_control/MessageTypes.hpp>
+#include <robot_remote_control/MessageTraits.hpp>
 
 namespace robot_remote_control {
 
@@ -10,6 +11,10 @@ namespace robot_remote_control {
 
     enum ExtendedTelemetryMessageType : uint16_t { NEW_TELEMETRY_MESSAGE = TELEMETRY_MESSAGE_TYPES_NUMBER, EXTENDED_TELEMETRY_MESSAGE_TYPES_NUMBER };
 
+    // the protobuf types of the new messages, for the typed accessors (e.g. getTelemetry<NEW_TELEMETRY_MESSAGE>())
+    RRC_TELEMETRY_TRAITS(NEW_TELEMETRY_MESSAGE, myrobot::NewTelemetryMessage, true)
+    RRC_CONTROL_TRAITS(NEW_CONTROL_MESSAGE, myrobot::NewControlMessage)
+
 
 }  // end namespace robot_remote_control
 
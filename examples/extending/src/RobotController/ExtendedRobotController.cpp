@@ -7,7 +7,7 @@ ExtendedRobotController::ExtendedRobotController(TransportSharedPtr commandTrans
     RobotController(commandTransport, telemetryTransport) {
 
         //
-        registerTelemetryType<myrobot::NewTelemetryMessage>(NEW_TELEMETRY_MESSAGE, 10);
+        registerTelemetryType<NEW_TELEMETRY_MESSAGE>(10);
 }
 
 }  // namespace robot_remote_control
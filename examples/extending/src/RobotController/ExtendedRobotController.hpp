@@ -12,15 +12,15 @@ class ExtendedRobotController : public RobotController {
     explicit ExtendedRobotController(TransportSharedPtr commandTransport, TransportSharedPtr telemetryTransport = TransportSharedPtr());
 
     void setNewControlMessage(const myrobot::NewControlMessage & msg) {
-        sendProtobufData(msg, NEW_CONTROL_MESSAGE);
+        sendCommand<NEW_CONTROL_MESSAGE>(msg);
     }
 
     void requestNewTelemetryMessage(myrobot::NewTelemetryMessage *msg) {
-        requestTelemetry(NEW_TELEMETRY_MESSAGE, msg);
+        requestTelemetry<NEW_TELEMETRY_MESSAGE>(msg);
     }
 
     bool getNewTelemetryMessage(myrobot::NewTelemetryMessage *msg) {
-        return getTelemetry(NEW_TELEMETRY_MESSAGE, msg);
+        return getTelemetry<NEW_TELEMETRY_MESSAGE>(msg);
     }
 };
 
@@ -0,0 +1,190 @@
+#include "BandwidthGovernor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <set>
+
+namespace robot_remote_control {
+
+namespace {
+    // round trip times kept for the minimum
+    const size_t roundTripWindow = 16;
+    // the link queues when the round trip time is above minimum * factor + slack
+    const float queueingFactor = 1.5;
+    const float queueingSlack = 0.002;
+    // growth of the estimate per sample without queueing, dropped when it exceeds the throughput by dropFactor
+    const double probeFactor = 1.1;
+    const double dropFactor = 2.0;
+    // smoothing of the measured rates
+    const double smoothing = 0.5;
+    // limits closer than this to the applied one are not applied
+    const float limitHysteresis = 0.1;
+    // rate limits need a frequency > 0, 0 removes the limit
+    const float lowestFrequency = 0.001;
+}
+
+BandwidthGovernor::BandwidthGovernor(const double &headroom):headroom(headroom), configuredBudget(0), estimatedBudget(0) {}
+
+void BandwidthGovernor::setLinkBudget(const double &bytesPerSecond) {
+    std::lock_guard<std::mutex> lock(mutex);
+    configuredBudget = bytesPerSecond > 0 ? bytesPerSecond : 0;
+}
+
+double BandwidthGovernor::getLinkBudget() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return configuredBudget > 0 ? configuredBudget : estimatedBudget;
+}
+
+void BandwidthGovernor::addLinkSample(const float &roundTripTime, const double &deliveredBytesPerSecond) {
+    if (roundTripTime <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    roundTripTimes.push_back(roundTripTime);
+    if (roundTripTimes.size() > roundTripWindow) {
+        roundTripTimes.pop_front();
+    }
+    const float minRoundTrip = *std::min_element(roundTripTimes.begin(), roundTripTimes.end());
+    if (roundTripTime > minRoundTrip * queueingFactor + queueingSlack) {
+        if (deliveredBytesPerSecond > 0) {
+            // the link is saturated, it delivers its capacity
+            estimatedBudget = deliveredBytesPerSecond;
+        }
+    } else if (estimatedBudget > 0) {
+        estimatedBudget *= probeFactor;
+        if (deliveredBytesPerSecond > 0 && estimatedBudget > deliveredBytesPerSecond * dropFactor) {
+            // plenty of capacity left
+            estimatedBudget = 0;
+        }
+    }
+}
+
+void BandwidthGovernor::setPriority(const uint16_t &type, const unsigned int &priority, const float &minFrequency) {
+    if (type >= types.size()) {
+        printf("invalid telemetry type %i for the bandwidth governor in %s:%i\n", type, __FILE__, __LINE__);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    types[type].governed = true;
+    types[type].released = false;
+    types[type].priority = priority;
+    types[type].minFrequency = std::max(minFrequency, lowestFrequency);
+}
+
+void BandwidthGovernor::removePriority(const uint16_t &type) {
+    if (type >= types.size()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    types[type].governed = false;
+    types[type].released = true;
+}
+
+bool BandwidthGovernor::changed(const float &applied, const float &limit) const {
+    if ((applied == 0) != (limit == 0)) {
+        return true;
+    }
+    return std::fabs(limit - applied) > applied * limitHysteresis;
+}
+
+BandwidthGovernor::Decision BandwidthGovernor::update(const Statistics &statistics, const double &seconds) {
+    Decision decision;
+    if (seconds <= 0) {
+        return decision;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    decision.budgetBytesPerSecond = configuredBudget > 0 ? configuredBudget : estimatedBudget;
+
+    // offered rates: sent and skipped (rate limited) messages
+    std::vector<double> offeredBytesPerSecond(types.size(), 0);
+    std::set<unsigned int> priorities;
+    for (size_t type = 0; type < types.size(); ++type) {
+        TypeState &state = types[type];
+        const Statistics::Stats &stats = statistics.stat_per_type[type];
+        uint64_t messages = stats.getMessagesTotal();
+        uint64_t skipped = stats.getSkippedTotal();
+        uint64_t bytes = stats.getBytesTotal();
+        uint64_t sentMessages = messages - state.lastMessages;
+        uint64_t skippedMessages = skipped - state.lastSkipped;
+        if (sentMessages) {
+            double size = static_cast<double>(bytes - state.lastBytes) / sentMessages;
+            state.messageSize = state.messageSize > 0 ? state.messageSize * smoothing + size * (1 - smoothing) : size;
+        }
+        double frequency = (sentMessages + skippedMessages) / seconds;
+        state.offeredFrequency = state.offeredFrequency * smoothing + frequency * (1 - smoothing);
+        state.lastMessages = messages;
+        state.lastSkipped = skipped;
+        state.lastBytes = bytes;
+
+        offeredBytesPerSecond[type] = state.offeredFrequency * state.messageSize;
+        decision.demandBytesPerSecond += offeredBytesPerSecond[type];
+        if (state.governed && state.priority > 0) {
+            priorities.insert(state.priority);
+        }
+    }
+
+    std::vector<float> limits(types.size(), 0);
+    if (decision.budgetBytesPerSecond > 0) {
+        // essential and not governed types are never limited
+        double remaining = decision.budgetBytesPerSecond * headroom;
+        for (size_t type = 0; type < types.size(); ++type) {
+            if (!types[type].governed || types[type].priority == 0) {
+                remaining -= offeredBytesPerSecond[type];
+            }
+        }
+        for (const unsigned int &priority : priorities) {
+            double demand = 0;
+            for (size_t type = 0; type < types.size(); ++type) {
+                if (types[type].governed && types[type].priority == priority) {
+                    demand += offeredBytesPerSecond[type];
+                }
+            }
+            double fraction = demand > 0 ? std::min(1.0, std::max(0.0, remaining / demand)) : 1;
+            for (size_t type = 0; type < types.size(); ++type) {
+                TypeState &state = types[type];
+                if (!state.governed || state.priority != priority) {
+                    continue;
+                }
+                if (fraction >= 1) {
+                    remaining -= offeredBytesPerSecond[type];
+                    continue;
+                }
+                limits[type] = std::max<float>(state.minFrequency, state.offeredFrequency * fraction);
+                remaining -= std::min<double>(state.offeredFrequency, limits[type]) * state.messageSize;
+            }
+            remaining = std::max(0.0, remaining);
+        }
+        if (decision.demandBytesPerSecond > 0) {
+            decision.quality = std::min(1.0, decision.budgetBytesPerSecond * headroom / decision.demandBytesPerSecond);
+        }
+    }
+
+    for (size_t type = 0; type < types.size(); ++type) {
+        TypeState &state = types[type];
+        if (!state.governed && !state.released) {
+            continue;
+        }
+        state.released = false;
+        if (changed(state.appliedLimit, limits[type])) {
+            state.appliedLimit = limits[type];
+            decision.rateLimits.push_back(std::make_pair(static_cast<uint16_t>(type), limits[type]));
+        }
+    }
+    return decision;
+}
+
+BandwidthGovernor::Decision BandwidthGovernor::releaseLimits() {
+    Decision decision;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t type = 0; type < types.size(); ++type) {
+        if (types[type].appliedLimit != 0) {
+            types[type].appliedLimit = 0;
+            decision.rateLimits.push_back(std::make_pair(static_cast<uint16_t>(type), 0.0f));
+        }
+        types[type].released = false;
+    }
+    return decision;
+}
+
+}  // namespace robot_remote_control
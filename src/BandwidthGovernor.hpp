@@ -0,0 +1,126 @@
+#pragma once
+
+#include "MessageTypes.hpp"
+#include "Statistics.hpp"
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief distributes a link budget (bytes per second) to the telemetry types by priority.
+ *
+ * The budget is configured (setLinkBudget()) or estimated from the round trip times and the throughput reported
+ * by the controller (addLinkSample()). The offered rate of each governed type is measured from the lock-free
+ * counters of the Statistics (sent and skipped messages), so it is known even while the type is rate limited.
+ * Each update() fills the budget in the order of the priorities: types of priority 0 are never limited,
+ * the first priority that does not fit is limited proportionally, lower priorities get their minimum frequency.
+ *
+ * The quality of the decision (budget / offered rate) is used by the ControlledRobot to coarsen point clouds
+ * and maps and to raise the compression effort of the telemetry transport.
+ */
+class BandwidthGovernor {
+ public:
+    struct Decision {
+        Decision():budgetBytesPerSecond(0), demandBytesPerSecond(0), quality(1) {}
+        // 0 if unknown, nothing is limited then
+        double budgetBytesPerSecond;
+        // offered by all types
+        double demandBytesPerSecond;
+        // budget / demand, 1 if everything fits
+        float quality;
+        // changed limits of governed types (type, maximum frequency), 0 removes the limit
+        std::vector< std::pair<uint16_t, float> > rateLimits;
+    };
+
+    /**
+     * @param headroom part of the budget to use, the rest absorbs bursts and commands
+     */
+    explicit BandwidthGovernor(const double &headroom = 0.9);
+
+    /**
+     * @brief configure the link budget
+     *
+     * @param bytesPerSecond the budget, 0 to estimate it from addLinkSample()
+     */
+    void setLinkBudget(const double &bytesPerSecond);
+
+    /**
+     * @brief the configured or estimated budget, 0 if unknown
+     */
+    double getLinkBudget();
+
+    /**
+     * @brief add a measurement of the link, e.g. reported by the controller in the heartbeats:
+     * a round trip time above the minimum means the link queues, its throughput is the budget then.
+     * Without queueing the estimate grows until it is dropped (unknown, nothing limited).
+     *
+     * @param roundTripTime seconds
+     * @param deliveredBytesPerSecond telemetry received by the controller
+     */
+    void addLinkSample(const float &roundTripTime, const double &deliveredBytesPerSecond);
+
+    /**
+     * @brief govern the rate of a telemetry type
+     *
+     * @param type the TelemetryMessageType
+     * @param priority 0 for essential types which are never limited, higher values are limited first
+     * @param minFrequency frequency that is kept for the type, even if the budget is exceeded
+     */
+    void setPriority(const uint16_t &type, const unsigned int &priority, const float &minFrequency = 0.1);
+
+    /**
+     * @brief stop governing a type, its limit is removed on the next update()
+     */
+    void removePriority(const uint16_t &type);
+
+    /**
+     * @brief measure the offered rates and distribute the budget
+     *
+     * @param statistics the statistics of the ControlledRobot (have to be enabled)
+     * @param seconds time since the last update
+     */
+    Decision update(const Statistics &statistics, const double &seconds);
+
+    /**
+     * @brief remove all applied limits (e.g. when the governor is stopped), the priorities are kept
+     *
+     * @return Decision the limits to remove
+     */
+    Decision releaseLimits();
+
+ private:
+    struct TypeState {
+        TypeState():governed(false), priority(0), minFrequency(0), lastMessages(0), lastSkipped(0), lastBytes(0),
+                    messageSize(0), offeredFrequency(0), appliedLimit(0), released(false) {}
+        bool governed;
+        unsigned int priority;
+        float minFrequency;
+        uint64_t lastMessages;
+        uint64_t lastSkipped;
+        uint64_t lastBytes;
+        // smoothed
+        double messageSize;
+        double offeredFrequency;
+        // 0 for no limit
+        float appliedLimit;
+        // removePriority() was called, the limit is removed
+        bool released;
+    };
+
+    // only changed limits are applied, setting a rate limit resets its timer
+    bool changed(const float &applied, const float &limit) const;
+
+    std::mutex mutex;
+    double headroom;
+    double configuredBudget;
+    double estimatedBudget;
+    std::deque<float> roundTripTimes;
+    std::array<TypeState, TELEMETRY_MESSAGE_TYPES_NUMBER> types;
+};
+
+}  // namespace robot_remote_control
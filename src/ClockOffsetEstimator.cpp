@@ -0,0 +1,127 @@
+#include "ClockOffsetEstimator.hpp"
+#include "UpdateThread/Clock.hpp"
+
+#include <chrono>
+
+namespace robot_remote_control {
+
+namespace {
+    // the drift needs some time between the samples to be meaningful
+    const int64_t minDriftSpanNs = 10000000000LL;
+    // crystals are within 100 ppm, more is noise of the (asymmetric) delays
+    const double maxDriftPpm = 500.0;
+}
+
+ClockOffsetEstimator::ClockOffsetEstimator(const size_t &filterSamples, const size_t &driftSamples):
+    filterSamples(filterSamples ? filterSamples : 1),
+    driftSamples(driftSamples ? driftSamples : 1),
+    fittedOffsetNs(0) {}
+
+void ClockOffsetEstimator::addSample(const int64_t &localSendNs, const int64_t &remoteReceiveNs, const int64_t &remoteReplyNs, const int64_t &localReceiveNs) {
+    Sample sample;
+    sample.localNs = localSendNs + (localReceiveNs - localSendNs) / 2;
+    sample.offsetNs = ((remoteReceiveNs - localSendNs) + (remoteReplyNs - localReceiveNs)) / 2;
+    sample.delayNs = (localReceiveNs - localSendNs) - (remoteReplyNs - remoteReceiveNs);
+    if (sample.delayNs < 0) {
+        sample.delayNs = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    recent.push_back(sample);
+    if (recent.size() > filterSamples) {
+        recent.pop_front();
+    }
+
+    const Sample* best = &recent.front();
+    for (const Sample &candidate : recent) {
+        if (candidate.delayNs <= best->delayNs) {
+            best = &candidate;
+        }
+    }
+    // a sample is only selected once, even if it stays the best of the window
+    if (!selected.empty() && selected.back().localNs == best->localNs) {
+        return;
+    }
+    selected.push_back(*best);
+    if (selected.size() > driftSamples) {
+        selected.pop_front();
+    }
+
+    estimate.valid = true;
+    estimate.uncertaintyNs = best->delayNs / 2;
+    estimate.referenceNs = best->localNs;
+    updateDrift();
+    estimate.offsetNs = static_cast<int64_t>(fittedOffsetNs);
+}
+
+void ClockOffsetEstimator::updateDrift() {
+    const Sample &last = selected.back();
+    estimate.driftPpm = 0;
+    fittedOffsetNs = last.offsetNs;
+    if (selected.size() < 3 || last.localNs - selected.front().localNs < minDriftSpanNs) {
+        return;
+    }
+
+    // least squares, relative to the last sample to keep the precision
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (const Sample &sample : selected) {
+        double x = (sample.localNs - last.localNs) / 1000000000.0;
+        double y = sample.offsetNs - last.offsetNs;
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    double n = selected.size();
+    double denominator = n * sumXX - sumX * sumX;
+    if (denominator <= 0) {
+        return;
+    }
+    // ns per s = ppm * 1000
+    double slope = (n * sumXY - sumX * sumY) / denominator;
+    double driftPpm = slope / 1000.0;
+    if (driftPpm > maxDriftPpm || driftPpm < -maxDriftPpm) {
+        return;
+    }
+    double intercept = (sumY - slope * sumX) / n;
+    estimate.driftPpm = driftPpm;
+    fittedOffsetNs = last.offsetNs + intercept;
+}
+
+int64_t ClockOffsetEstimator::offsetAt(const int64_t &localNs) const {
+    if (!estimate.valid) {
+        return 0;
+    }
+    double elapsedSeconds = (localNs - estimate.referenceNs) / 1000000000.0;
+    return static_cast<int64_t>(fittedOffsetNs + estimate.driftPpm * 1000.0 * elapsedSeconds);
+}
+
+ClockOffsetEstimator::Estimate ClockOffsetEstimator::getEstimate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return estimate;
+}
+
+int64_t ClockOffsetEstimator::getOffsetNs(const int64_t &localNs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return offsetAt(localNs);
+}
+
+int64_t ClockOffsetEstimator::toLocalNs(const int64_t &remoteNs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // the offset changes by ppm only, the remote time is close enough to the local time to look it up
+    return remoteNs - offsetAt(remoteNs - offsetAt(remoteNs));
+}
+
+void ClockOffsetEstimator::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    recent.clear();
+    selected.clear();
+    estimate = Estimate();
+    fittedOffsetNs = 0;
+}
+
+int64_t ClockOffsetEstimator::nowNs() {
+    return Clock::realtimeNs();
+}
+
+}  // namespace robot_remote_control
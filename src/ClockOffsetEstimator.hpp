@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace robot_remote_control {
+
+/**
+ * @brief estimates the offset and drift of a remote clock (e.g. the robot) from request/reply exchanges like NTP:
+ * of the recent samples the one with the smallest round trip delay is used (it has the smallest error),
+ * the drift is the slope of a line fitted through these selected offsets.
+ *
+ * All times are nanoseconds since the epoch (CLOCK_REALTIME on both sides).
+ */
+class ClockOffsetEstimator {
+ public:
+    struct Estimate {
+        Estimate():valid(false), offsetNs(0), driftPpm(0), uncertaintyNs(0), referenceNs(0) {}
+        // false until the first sample
+        bool valid;
+        // remote - local at referenceNs
+        int64_t offsetNs;
+        // change of the offset in ns per s of local time
+        double driftPpm;
+        // half the round trip delay of the selected sample (the maximum error of its offset)
+        int64_t uncertaintyNs;
+        // local time of the selected sample
+        int64_t referenceNs;
+    };
+
+    /**
+     * @param filterSamples number of recent samples to select the one with the smallest delay from
+     * @param driftSamples number of selected samples to estimate the drift from
+     */
+    explicit ClockOffsetEstimator(const size_t &filterSamples = 8, const size_t &driftSamples = 16);
+
+    /**
+     * @brief add an exchange
+     *
+     * @param localSendNs local time the request was sent (t0)
+     * @param remoteReceiveNs remote time the request was received (t1)
+     * @param remoteReplyNs remote time the reply was sent (t2)
+     * @param localReceiveNs local time the reply was received (t3)
+     */
+    void addSample(const int64_t &localSendNs, const int64_t &remoteReceiveNs, const int64_t &remoteReplyNs, const int64_t &localReceiveNs);
+
+    Estimate getEstimate();
+
+    /**
+     * @brief remote - local at a local time, 0 without samples
+     */
+    int64_t getOffsetNs(const int64_t &localNs);
+
+    /**
+     * @brief convert a remote time into local time
+     */
+    int64_t toLocalNs(const int64_t &remoteNs);
+
+    void reset();
+
+    /**
+     * @brief the local time (CLOCK_REALTIME)
+     */
+    static int64_t nowNs();
+
+ private:
+    struct Sample {
+        int64_t localNs;
+        int64_t offsetNs;
+        int64_t delayNs;
+    };
+
+    // needs the mutex locked
+    int64_t offsetAt(const int64_t &localNs) const;
+    void updateDrift();
+
+    std::mutex mutex;
+    size_t filterSamples;
+    size_t driftSamples;
+    std::deque<Sample> recent;
+    std::deque<Sample> selected;
+    Estimate estimate;
+    // offsets of the fitted line, at estimate.referenceNs
+    double fittedOffsetNs;
+};
+
+}  // namespace robot_remote_control
@@ -0,0 +1,148 @@
+#include "ClientSessions.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace robot_remote_control {
+
+ClientSessions::ClientSessions(const float &defaultTimeout):defaultTimeout(defaultTimeout) {}
+
+void ClientSessions::setDefaultTimeout(const float &timeout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    defaultTimeout = timeout;
+}
+
+bool ClientSessions::received(const std::string &peer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto session = sessions.find(peer);
+    bool created = session == sessions.end();
+    if (created) {
+        session = sessions.insert(std::make_pair(peer, Session())).first;
+        session->second.timeoutSeconds = defaultTimeout;
+    }
+    session->second.requests++;
+    // each request counts as heartbeat, the controllers only send heartbeats when idle
+    session->second.timeout.start(session->second.timeoutSeconds);
+    return created;
+}
+
+void ClientSessions::heartbeat(const std::string &peer, const float &timeout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto session = sessions.find(peer);
+    if (session == sessions.end()) {
+        return;
+    }
+    session->second.timeoutSeconds = timeout;
+    session->second.timeout.start(timeout);
+}
+
+void ClientSessions::setPriority(const std::string &peer, const int &priority) {
+    std::lock_guard<std::mutex> lock(mutex);
+    priorities[peer] = priority;
+}
+
+int ClientSessions::priority(const std::string &peer) const {
+    auto entry = priorities.find(peer);
+    return entry != priorities.end() ? entry->second : 0;
+}
+
+bool ClientSessions::mayCommand(const std::string &peer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (commander.empty() || commander == peer || priority(peer) > priority(commander)) {
+        commander = peer;
+        return true;
+    }
+    return false;
+}
+
+std::string ClientSessions::getCommander() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return commander;
+}
+
+void ClientSessions::release(const std::string &peer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (commander == peer) {
+        commander.clear();
+    }
+}
+
+std::vector<std::string> ClientSessions::expire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> expired;
+    for (auto session = sessions.begin(); session != sessions.end();) {
+        if (session->second.timeout.isExpired()) {
+            if (session->first == commander) {
+                commander.clear();
+            }
+            expired.push_back(session->first);
+            session = sessions.erase(session);
+        } else {
+            ++session;
+        }
+    }
+    return expired;
+}
+
+std::vector<ClientSessions::SessionInfo> ClientSessions::getSessions() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<SessionInfo> infos;
+    for (auto &session : sessions) {
+        SessionInfo info;
+        info.peer = session.first;
+        info.priority = priority(session.first);
+        info.commanding = session.first == commander;
+        info.idleTime = session.second.timeout.getElapsedTime();
+        info.requests = session.second.requests;
+        infos.push_back(info);
+    }
+    return infos;
+}
+
+void ClientSessions::setFeatures(const std::string &peer, const Features &features) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto session = sessions.find(peer);
+    if (session != sessions.end()) {
+        session->second.features = features;
+    }
+}
+
+ClientSessions::Features ClientSessions::getFeatures(const std::string &peer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto session = sessions.find(peer);
+    return session != sessions.end() ? session->second.features : Features();
+}
+
+ClientSessions::Features ClientSessions::getCommonFeatures() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (sessions.empty()) {
+        return Features();
+    }
+    Features common = sessions.begin()->second.features;
+    for (auto &session : sessions) {
+        const Features &features = session.second.features;
+        common.wireHeaderVersion = std::min(common.wireHeaderVersion, features.wireHeaderVersion);
+        common.telemetryChunks = common.telemetryChunks && features.telemetryChunks;
+        common.logMessages = common.logMessages && features.logMessages;
+        if (features.jointTable != common.jointTable) {
+            common.jointTable = 0;
+        }
+        // an encoding only if all controllers selected the same one
+        if (features.pointCloudEncoding.type() != common.pointCloudEncoding.type() ||
+            features.pointCloudEncoding.resolution() != common.pointCloudEncoding.resolution()) {
+            common.pointCloudEncoding.Clear();
+        }
+        std::vector<uint16_t> fixedLayoutTypes;
+        std::set_intersection(common.fixedLayoutTypes.begin(), common.fixedLayoutTypes.end(),
+                              features.fixedLayoutTypes.begin(), features.fixedLayoutTypes.end(), std::back_inserter(fixedLayoutTypes));
+        common.fixedLayoutTypes.swap(fixedLayoutTypes);
+    }
+    return common;
+}
+
+size_t ClientSessions::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sessions.size();
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "UpdateThread/Timer.hpp"
+#include "Types/RobotRemoteControl.pb.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief robot-side state of the controllers connected to one command transport with several peers (TransportZmq::ROUTER),
+ * see ControlledRobot::setMultiClient().
+ *
+ * Each controller (identified by Transport::getPeer()) has its own heartbeat timeout. Only one controller commands the robot
+ * at a time: the first one sending a command, until its session expires, it calls release() or a controller with a higher
+ * priority sends a command. Requests that do not command the robot (e.g. telemetry or map requests) are accepted from all controllers.
+ */
+class ClientSessions {
+ public:
+    struct SessionInfo {
+        std::string peer;
+        int priority;
+        bool commanding;
+        // seconds since the last request
+        float idleTime;
+        uint64_t requests;
+    };
+
+    /**
+     * @brief the features a controller negotiated (CAPABILITIES, WIRE_HEADER_VERSION). The telemetry stream is shared
+     * by all controllers, it only uses the features all sessions negotiated. A new session has none until its controller
+     * negotiates (older controllers never do).
+     */
+    struct Features {
+        Features():wireHeaderVersion(0), telemetryChunks(false), logMessages(false), jointTable(0) {}
+        // 0 for the plain type header
+        uint8_t wireHeaderVersion;
+        // TELEMETRY_CHUNK is reassembled
+        bool telemetryChunks;
+        // LOG_MESSAGES is split into LOG_MESSAGE
+        bool logMessages;
+        // JOINT_NAME_TABLE, 0 for JointStates with names
+        uint64_t jointTable;
+        // UNENCODED_POINTCLOUD sends the point clouds as set by the robot
+        PointCloudEncoding pointCloudEncoding;
+        // telemetry types sent as FixedLayout struct, sorted
+        std::vector<uint16_t> fixedLayoutTypes;
+    };
+
+    /**
+     * @param defaultTimeout seconds without a request until a session without heartbeats expires
+     */
+    explicit ClientSessions(const float &defaultTimeout = 5);
+
+    /**
+     * @brief the timeout of sessions created afterwards
+     */
+    void setDefaultTimeout(const float &timeout);
+
+    /**
+     * @brief a request of a peer was received
+     *
+     * @return true if this started a new session
+     */
+    bool received(const std::string &peer);
+
+    /**
+     * @brief a heartbeat of a peer was received, the session expires after timeout seconds without requests
+     */
+    void heartbeat(const std::string &peer, const float &timeout);
+
+    /**
+     * @brief the priority of a peer (also before it connects), the default is 0
+     */
+    void setPriority(const std::string &peer, const int &priority);
+
+    /**
+     * @brief arbitrate a command of a peer, the peer becomes the commanding peer if there is none
+     * or if its priority is higher than the one of the commanding peer
+     *
+     * @return true if the peer may command
+     */
+    bool mayCommand(const std::string &peer);
+
+    /**
+     * @brief the commanding peer, empty if there is none
+     */
+    std::string getCommander();
+
+    /**
+     * @brief give up commanding (e.g. when the operator of the peer is done), another peer may command then
+     */
+    void release(const std::string &peer);
+
+    /**
+     * @brief remove the expired sessions
+     *
+     * @return the peers of the removed sessions
+     */
+    std::vector<std::string> expire();
+
+    std::vector<SessionInfo> getSessions();
+
+    /**
+     * @brief set the features negotiated by the controller of a session, ignored if the peer has no session
+     */
+    void setFeatures(const std::string &peer, const Features &features);
+
+    /**
+     * @return Features the features negotiated by the controller of a session, none if the peer has no session
+     */
+    Features getFeatures(const std::string &peer);
+
+    /**
+     * @brief the features all sessions negotiated, the ones the shared telemetry stream may use
+     *
+     * @return Features the common subset, none if there is no session
+     */
+    Features getCommonFeatures();
+
+    size_t size();
+
+ private:
+    struct Session {
+        Session():requests(0) {}
+        Timer timeout;
+        float timeoutSeconds;
+        uint64_t requests;
+        Features features;
+    };
+
+    int priority(const std::string &peer) const;
+
+    std::mutex mutex;
+    float defaultTimeout;
+    std::map<std::string, Session> sessions;
+    std::map<std::string, int> priorities;
+    std::string commander;
+};
+
+}  // namespace robot_remote_control
@@ -1,16 +1,54 @@
 #include "ControlledRobot.hpp"
+
+#include <google/protobuf/wire_format_lite.h>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <random>
 
 
 namespace robot_remote_control {
 
 
 ControlledRobot::ControlledRobot(TransportSharedPtr commandTransport, TransportSharedPtr telemetryTransport):UpdateThread(),
+    wireHeaderVersion(0),
+    telemetryQueue([this](const TelemetrySendQueue::Chunk &chunk) { sendQueuedTelemetry(chunk); }),
+    telemetryChunkSize(0),
+    controllerReassemblesChunks(true),
+    rateLimitsActive(false),
+    telemetryBatchDepth(0),
+    replyWithRequestId(false),
+    replyRequestId(0),
+    multiClient(false),
+    heartbeatAllowedLatency(0.1),
     commandTransport(commandTransport),
     telemetryTransport(telemetryTransport),
-    heartbeatAllowedLatency(0.1),
-    buffers(std::make_shared<TelemetryBuffer>()),
-    logLevel(CUSTOM-1) {
+    replyTransport(commandTransport.get()),
+    streamedCommands(0),
+    droppedStreamedCommands(0),
+    requestsReceived(false),
+    logLevel(CUSTOM-1),
+    logBatching(false),
+    controllerSplitsLogs(true),
+    compactJointTable(0),
+    mapChunksPerUpdate(4),
+    statisticsTask(0),
+    governorTask(0),
+    coarsening(1),
+    maxCoarsening(4) {
+    for (std::atomic<uint32_t> &sequence : telemetrySequences) {
+        sequence.store(0);
+    }
+    for (std::atomic<uint32_t> &sequence : sentSequences) {
+        sequence.store(0);
+    }
+    for (std::atomic<bool> &fixedLayout : fixedLayoutTypes) {
+        fixedLayout.store(false);
+    }
+    std::random_device random;
+    sessionId = (static_cast<uint64_t>(random()) << 32) | random();
+    governorTimer.start();
+    commandbuffers.assign(CONTROL_MESSAGE_TYPE_NUMBER, nullptr);
     registerCommandType(TARGET_POSE_COMMAND, &poseCommand);
     registerCommandType(TWIST_COMMAND, &twistCommand);
     registerCommandType(GOTO_COMMAND, &goToCommand);
@@ -22,38 +60,81 @@ ControlledRobot::ControlledRobot(TransportSharedPtr commandTransport, TransportS
     registerCommandType(ROBOT_TRAJECTORY_COMMAND, &robotTrajectoryCommand);
 
 
-    registerTelemetryType<Pose>(CURRENT_POSE);
-    registerTelemetryType<JointState>(JOINT_STATE);
-    registerTelemetryType<JointState>(CONTROLLABLE_JOINTS);
-    registerTelemetryType<SimpleActions>(SIMPLE_ACTIONS);
-    registerTelemetryType<ComplexActions>(COMPLEX_ACTIONS);
-    registerTelemetryType<RobotName>(ROBOT_NAME);
-    registerTelemetryType<RobotState>(ROBOT_STATE);
-    registerTelemetryType<LogMessage>(LOG_MESSAGE);
-    registerTelemetryType<VideoStreams>(VIDEO_STREAMS);
-    registerTelemetryType<SimpleSensors>(SIMPLE_SENSOR_DEFINITION);
-    // simple sensors are stored in separate buffer when receiving, but sending requires this for requests
-    registerTelemetryType<SimpleSensor>(SIMPLE_SENSOR_VALUE);
-    registerTelemetryType<WrenchState>(WRENCH_STATE);
-    registerTelemetryType<MapsDefinition>(MAPS_DEFINITION);
-    registerTelemetryType<Map>(MAP);
-    registerTelemetryType<Poses>(POSES);
-    registerTelemetryType<Transforms>(TRANSFORMS);
-    registerTelemetryType<PermissionRequest>(PERMISSION_REQUEST); //no need to buffer, fills future
-    registerTelemetryType<PointCloud>(POINTCLOUD);
-    registerTelemetryType<IMU>(IMU_VALUES);
-    registerTelemetryType<ContactPoints>(CONTACT_POINTS);
-    registerTelemetryType<Twist>(CURRENT_TWIST);
-    registerTelemetryType<Acceleration>(CURRENT_ACCELERATION);
+    TelemetryTypes::forEach(DefaultTelemetryRegistrar{this});
+    telemetryQueue.setPolicy(LOG_MESSAGE, TelemetrySendQueue::NEVER_DROP);
+    telemetryQueue.setPolicy(PERMISSION_REQUEST, TelemetrySendQueue::NEVER_DROP);
+    for (uint16_t type : {CURRENT_POSE, CURRENT_TWIST, CURRENT_ACCELERATION, JOINT_STATE, WRENCH_STATE, IMU_VALUES, PERMISSION_REQUEST}) {
+        telemetryQueue.setPriorityClass(type, TelemetrySendQueue::HIGH);
+    }
+    for (uint16_t type : {POINTCLOUD, MAP, POSES}) {
+        telemetryQueue.setPriorityClass(type, TelemetrySendQueue::BULK);
+    }
+}
+
+void ControlledRobot::setAsyncTelemetry(const bool &async, const size_t &defaultDepth) {
+    telemetryQueue.setDefaultDepth(defaultDepth);
+    if (async) {
+        telemetryQueue.start();
+    } else {
+        telemetryQueue.stop();
+    }
+}
+
+void ControlledRobot::sendQueuedTelemetry(const TelemetrySendQueue::Chunk &chunk) {
+    char header[WireHeader::maxSize + chunkHeaderSize];
+    if (chunk.isComplete()) {
+        const size_t headerSize = writeTelemetryHeader(chunk.type, WireHeader::NONE, header);
+        uint32_t bytes = telemetryTransport->send(MessageView(header, headerSize), MessageView(*chunk.payload));
+        RRC_TRACE(TELEMETRY_SENT, chunk.type, bytes);
+        updateStatistics(bytes, chunk.type);
+        return;
+    }
+    // [uint16_t type][uint32_t message id][uint32_t offset][uint32_t message size][part of the payload]
+    size_t headerSize = writeTelemetryHeader(TELEMETRY_CHUNK, WireHeader::CHUNKED, header);
+    const uint32_t messageId = chunk.messageId;
+    const uint32_t offset = chunk.offset;
+    const uint32_t messageSize = chunk.payload->size();
+    memcpy(header + headerSize, &chunk.type, sizeof(uint16_t));
+    memcpy(header + headerSize + 2, &messageId, sizeof(uint32_t));
+    memcpy(header + headerSize + 6, &offset, sizeof(uint32_t));
+    memcpy(header + headerSize + 10, &messageSize, sizeof(uint32_t));
+    headerSize += chunkHeaderSize;
+    uint32_t bytes = telemetryTransport->send(MessageView(header, headerSize), MessageView(chunk.payload->data() + chunk.offset, chunk.size));
+    RRC_TRACE(TELEMETRY_SENT, chunk.type, bytes);
+    updateStatistics(bytes, chunk.type);
 }
 
 void ControlledRobot::update() {
+    requestsReceived = false;
     while (receiveRequest() != NO_CONTROL_DATA) {}
 
+    if (multiClient) {
+        sendDeferredReplies();
+        const std::vector<std::string> expired = clientSessions.expire();
+        if (!expired.empty()) {
+            applySharedFeatures();
+        }
+        for (const std::string &peer : expired) {
+            // the transport keeps routing state per peer
+            commandTransport->releasePeer(peer);
+            notifyClientSession(peer, false);
+        }
+    }
+
+    sendMapChunks();
+
+    if (logBatching.load() && logBatcher.isDue()) {
+        flushLogMessages();
+    }
+
     if (heartbeatCommand.read(&heartbeatValues)) {
         connected.store(true);
         // printf("received new HB params %.2f, %.2f\n", heartbeatValues.heartbeatduration(), heartbeatValues.heartbeatlatency());
         heartbeatTimer.start(heartbeatValues.heartbeatduration() + heartbeatAllowedLatency);
+    } else if (requestsReceived && heartbeatValues.heartbeatduration() > 0) {
+        // each request with a reply counts as heartbeat, the controller only sends heartbeats when idle
+        connected.store(true);
+        heartbeatTimer.start(heartbeatValues.heartbeatduration() + heartbeatAllowedLatency);
     }
     if (heartbeatTimer.isExpired()) {
         connected.store(false);
@@ -64,61 +145,906 @@ void ControlledRobot::update() {
     }
 }
 
+void ControlledRobot::setMultiClient(const bool &enable, const float &sessionTimeout) {
+    multiClient = enable;
+    clientSessions.setDefaultTimeout(sessionTimeout);
+    if (enable && !deferredRequests) {
+        deferredRequests = std::make_shared<CallbackExecutor>(1);
+    }
+}
+
+void ControlledRobot::notifyClientSession(const std::string &peer, const bool &connected) {
+    for (const auto &callback : clientSessionCallbacks) {
+        callback(peer, connected);
+    }
+}
+
+void ControlledRobot::deferRequest(const std::function<void(std::string *reply)> &answer) {
+    // the state of the current request, the worker replies later
+    DeferredReply pending = {replyTransport, requestPeer, replyWithRequestId, replyRequestId, std::string()};
+    if (!deferredRequests->post(0, [this, pending, answer]() {
+            DeferredReply deferred = pending;
+            answer(&deferred.reply);
+            std::lock_guard<std::mutex> lock(deferredRepliesMutex);
+            deferredReplies.push_back(std::move(deferred));
+        })) {
+        // the oldest queued request was dropped, its controller runs into its reply timeout
+        printf("too many deferred requests, dropped the oldest\n");
+    }
+}
+
+void ControlledRobot::sendDeferredReplies() {
+    std::deque<DeferredReply> replies;
+    {
+        std::lock_guard<std::mutex> lock(deferredRepliesMutex);
+        replies.swap(deferredReplies);
+    }
+    for (DeferredReply &deferred : replies) {
+        if (!deferred.transport || !deferred.transport->setPeer(deferred.peer)) {
+            continue;
+        }
+        replyTransport = deferred.transport;
+        replyWithRequestId = deferred.withRequestId;
+        replyRequestId = deferred.requestId;
+        sendReply(deferred.reply);
+    }
+}
+
+void ControlledRobot::preallocateBuffers(const size_t &bytes) {
+    commandTransport->preallocate(&commandReceiveBuffer, bytes);
+    for (CommandBufferBase *buffer : commandbuffers) {
+        if (buffer) {
+            buffer->setReuseMemory(true);
+        }
+    }
+    if (controlTransport.get()) {
+        controlTransport->preallocate(&controlReceiveBuffer, bytes);
+    }
+    if (commandStreamTransport.get()) {
+        commandStreamTransport->preallocate(&commandStreamReceiveBuffer, bytes);
+    }
+}
+
+void ControlledRobot::waitForUpdate(const unsigned int &maxMilliseconds) {
+    unsigned int timeout = maxMilliseconds;
+    // if already expired, the callback is called on each update anyway, no need to wake up more often
+    float heartbeatRemaining = heartbeatTimer.getRemainingTime();
+    if (heartbeatRemaining > 0) {
+        timeout = std::min(timeout, static_cast<unsigned int>(std::ceil(heartbeatRemaining * 1000.0)));
+    }
+    if (mapTransfers.active()) {
+        // keep sending chunks, the chunks per update limit the rate
+        timeout = std::min(timeout, 1u);
+    }
+    if (!controlTransport.get() && !commandStreamTransport.get()) {
+        commandTransport->waitForData(timeout);
+        return;
+    }
+    // the transports can't be polled together, so all are checked each millisecond
+    Transport* waiting = commandStreamTransport.get() ? commandStreamTransport.get() : controlTransport.get();
+    Transport* other = commandStreamTransport.get() ? controlTransport.get() : nullptr;
+    Timer waitTimer;
+    waitTimer.start(timeout / 1000.0);
+    while (!waiting->waitForData(1) && !(other && other->waitForData(0)) && !commandTransport->waitForData(0) && !waitTimer.isExpired()) {}
+}
+
 void ControlledRobot::updateStatistics(const uint32_t &bytesSent, const uint16_t &type) {
-    #ifdef RRC_STATISTICS
+    if (statistics.isEnabled()) {
         statistics.global.addBytesSent(bytesSent);
         statistics.stat_per_type[type].addBytesSent(bytesSent);
-    #endif
+    }
+}
+
+void ControlledRobot::setStatisticsPublishInterval(const float &seconds) {
+    std::lock_guard<std::mutex> lock(statisticsTaskMutex);
+    if (statisticsTask) {
+        getScheduler().cancel(statisticsTask);
+        statisticsTask = 0;
+    }
+    if (seconds > 0) {
+        statisticsTask = getScheduler().schedulePeriodic(std::chrono::duration_cast<Scheduler::Clock::duration>(std::chrono::duration<float>(seconds)),
+                                                        [this]() { publishStatistics(); });
+    }
+}
+
+int ControlledRobot::publishStatistics() {
+    statistics.calculate();
+    auto fill = [](const uint16_t &type, const std::string &name, Statistics::Stats *stats, TelemetryStatistics *message) {
+        Statistics::StatData data = stats->getStats();
+        message->set_type(type);
+        message->set_name(name);
+        message->set_messages(data.messagesTotal);
+        message->set_bytes(data.bytesTotal);
+        message->set_skipped(data.skippedTotal);
+        message->set_bytes_per_second(data.bpsAvg);
+        message->set_frequency(data.frequencyAvg);
+        return data.messagesTotal > 0 || data.skippedTotal > 0;
+    };
+    RobotStatistics message;
+    timeval now;
+    gettimeofday(&now, 0);
+    message.mutable_timestamp()->set_secs(now.tv_sec);
+    message.mutable_timestamp()->set_nsecs(now.tv_usec * 1000);
+    fill(0, "global", &statistics.global, message.mutable_global());
+    for (size_t type = 1; type < statistics.stat_per_type.size(); ++type) {
+        TelemetryStatistics typeStatistics;
+        if (fill(type, statistics.names[type], &statistics.stat_per_type[type], &typeStatistics)) {
+            *message.add_types() = typeStatistics;
+        }
+    }
+    return sendTelemetry(message, ROBOT_STATISTICS);
+}
+
+void ControlledRobot::setBandwidthGovernorInterval(const float &seconds) {
+    std::lock_guard<std::mutex> lock(governorTaskMutex);
+    if (governorTask) {
+        getScheduler().cancel(governorTask);
+        governorTask = 0;
+        applyBandwidthDecision(bandwidthGovernor.releaseLimits());
+    }
+    if (seconds > 0) {
+        governorTimer.start();
+        governorTask = getScheduler().schedulePeriodic(std::chrono::duration_cast<Scheduler::Clock::duration>(std::chrono::duration<float>(seconds)),
+                                                      [this]() { governBandwidth(); });
+    }
+}
+
+BandwidthGovernor::Decision ControlledRobot::governBandwidth() {
+    std::lock_guard<std::mutex> lock(governorMutex);
+    const float seconds = governorTimer.getElapsedTime();
+    governorTimer.start();
+    BandwidthGovernor::Decision decision = bandwidthGovernor.update(statistics, seconds);
+    applyBandwidthDecision(decision);
+    return decision;
+}
+
+void ControlledRobot::applyBandwidthDecision(const BandwidthGovernor::Decision &decision) {
+    for (const std::pair<uint16_t, float> &limit : decision.rateLimits) {
+        setTelemetryRateLimit(limit.first, limit.second);
+    }
+    const float quality = std::max(decision.quality, 1.0f / maxCoarsening.load());
+    coarsening.store(1.0f / quality);
+    if (telemetryTransport.get()) {
+        // a slow link favours compression over CPU time
+        telemetryTransport->setCompressionEffort(1.0f - decision.quality);
+    }
+}
+
+size_t ControlledRobot::writeTelemetryHeader(const uint16_t &type, const uint16_t &flags, char* target) {
+    if (!wireHeaderVersion.load(std::memory_order_relaxed) || type >= telemetrySequences.size()) {
+        memcpy(target, &type, sizeof(uint16_t));
+        return sizeof(uint16_t);
+    }
+    WireHeader header;
+    header.type = type;
+    header.flags = flags;
+    header.sequence = telemetrySequences[type].fetch_add(1, std::memory_order_relaxed);
+    sentSequences[type].store(header.sequence + 1, std::memory_order_relaxed);
+    header.sendTimeNs = WireHeader::now();
+    return header.write(target);
+}
+
+ClientSessions::Features ControlledRobot::getRequestFeatures() {
+    return multiClient ? clientSessions.getFeatures(requestPeer) : controllerFeatures;
+}
+
+void ControlledRobot::setRequestFeatures(const ClientSessions::Features &features) {
+    if (multiClient) {
+        clientSessions.setFeatures(requestPeer, features);
+    } else {
+        controllerFeatures = features;
+    }
+    applySharedFeatures();
+}
+
+void ControlledRobot::applySharedFeatures() {
+    // a controller which did not negotiate gets the plain stream
+    const ClientSessions::Features shared = multiClient ? clientSessions.getCommonFeatures() : controllerFeatures;
+    wireHeaderVersion.store(shared.wireHeaderVersion);
+    controllerReassemblesChunks.store(shared.telemetryChunks);
+    telemetryQueue.setChunkSize(shared.telemetryChunks ? telemetryChunkSize.load() : 0);
+    compactJointTable.store(shared.jointTable);
+    controllerSplitsLogs.store(shared.logMessages);
+    for (std::atomic<bool> &fixedLayout : fixedLayoutTypes) {
+        fixedLayout.store(false);
+    }
+    for (const uint16_t &type : shared.fixedLayoutTypes) {
+        fixedLayoutTypes[type].store(true);
+    }
+    const PointCloudEncoding &encoding = shared.pointCloudEncoding;
+    if (encoding.type() != selectedPointCloudEncoding.type() || encoding.resolution() != selectedPointCloudEncoding.resolution()) {
+        selectedPointCloudEncoding = encoding;
+        setPointCloudEncoding(encoding);
+    }
+}
+
+bool ControlledRobot::usesFixedLayout(const uint16_t &type) {
+    if (type >= fixedLayoutTypes.size() || !fixedLayoutTypes[type].load(std::memory_order_relaxed)) {
+        return false;
+    }
+    // the flag is in the WireHeader only, the controller may have switched back to the plain header
+    if (!wireHeaderVersion.load(std::memory_order_relaxed) || telemetryQueue.isRunning()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(telemetryBatchMutex);
+    return telemetryBatchDepth == 0;
+}
+
+TelemetryCache::Payload ControlledRobot::getLatestTelemetry(const uint16_t &type) {
+    TelemetryCache::Payload latest = latestTelemetry.get(type);
+    if (type != JOINT_STATE) {
+        return latest;
+    }
+    // cached as sent, without names if the controllers agreed on the table, the requesting controller may not know it
+    JointState joints;
+    if (!joints.ParseFromString(*latest) || !joints.name_table() || !jointNameTable.lockedAccess()->expand(&joints)) {
+        return latest;
+    }
+    return std::make_shared<const std::string>(joints.SerializeAsString());
+}
+
+void ControlledRobot::resumeSession(const MessageView &request) {
+    // the last sequence number + 1 the controller received per type, 0 for types it has to get
+    std::array<uint32_t, TELEMETRY_MESSAGE_TYPES_NUMBER> received;
+    received.fill(0);
+    if (request.size >= sizeof(uint64_t) && request.get<uint64_t>() == sessionId) {
+        const size_t itemSize = sizeof(uint16_t) + sizeof(uint32_t);
+        for (size_t offset = sizeof(uint64_t); offset + itemSize <= request.size; offset += itemSize) {
+            const uint16_t type = request.get<uint16_t>(offset);
+            if (type < received.size()) {
+                received[type] = request.get<uint32_t>(offset + sizeof(uint16_t)) + 1;
+            }
+        }
+    }
+    std::string reply(reinterpret_cast<const char*>(&sessionId), sizeof(uint64_t));
+    for (uint16_t type = NO_TELEMETRY_DATA + 1; type < TELEMETRY_MESSAGE_TYPES_NUMBER; ++type) {
+        if (type == TELEMETRY_BATCH || type == MAP_CHUNK || !latestTelemetry.contains(type)) {
+            continue;
+        }
+        const uint32_t sent = sentSequences[type].load(std::memory_order_relaxed);
+        if (sent && sent == received[type]) {
+            // the controller has the latest value
+            continue;
+        }
+        TelemetryCache::Payload latest = getLatestTelemetry(type);
+        const uint32_t size = latest->size();
+        reply.append(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+        reply.append(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+        reply.append(*latest);
+    }
+    sendReply(reply);
+}
+
+void ControlledRobot::negotiateCapabilities(const MessageView &serializedOffer) {
+    Capabilities offer;
+    if (!offer.ParseFromArray(serializedOffer.data, serializedOffer.size)) {
+        printf("unable to parse message of type %i in %s:%i\n", CAPABILITIES, __FILE__, __LINE__);
+        sendReply(NO_CONTROL_DATA);
+        return;
+    }
+    Capabilities selected;
+    selected.set_protocol_version(std::min(offer.protocol_version(), PROTOCOL_VERSION));
+
+    // the selection of this controller, the telemetry stream uses the common subset of all sessions
+    ClientSessions::Features features = getRequestFeatures();
+    const uint8_t version = std::min<uint32_t>(offer.wire_header_version(), WireHeader::currentVersion);
+    features.wireHeaderVersion = version;
+    selected.set_wire_header_version(version);
+
+    features.pointCloudEncoding.Clear();
+    for (const PointCloudEncoding &encoding : offer.pointcloud_encodings()) {
+        if (encoding.type() <= OCTREE_POINTCLOUD) {
+            features.pointCloudEncoding = encoding;
+            *selected.add_pointcloud_encodings() = encoding;
+            break;
+        }
+    }
+
+    // the controller selects the table by JOINT_NAME_TABLE, it needs the CONTROLLABLE_JOINTS for it
+    selected.set_compact_joints(offer.compact_joints() && jointNameTable.lockedAccess()->getId() != 0);
+    if (!selected.compact_joints()) {
+        features.jointTable = 0;
+    }
+
+    features.telemetryChunks = offer.telemetry_chunks();
+    selected.set_telemetry_chunks(offer.telemetry_chunks() && telemetryChunkSize.load() > 0);
+
+    selected.set_session_resume(offer.session_resume());
+
+    features.logMessages = offer.log_messages();
+    selected.set_log_messages(offer.log_messages());
+
+    // the types of this library the controller can decode, the structs need the WireHeader for the flag
+    const std::vector<uint16_t> fixedLayouts = FixedLayout::supportedTypes();
+    features.fixedLayoutTypes.clear();
+    for (const uint32_t type : offer.fixed_layout_types()) {
+        if (version && std::find(fixedLayouts.begin(), fixedLayouts.end(), type) != fixedLayouts.end()) {
+            features.fixedLayoutTypes.push_back(type);
+            selected.add_fixed_layout_types(type);
+        }
+    }
+    std::sort(features.fixedLayoutTypes.begin(), features.fixedLayoutTypes.end());
+    features.fixedLayoutTypes.erase(std::unique(features.fixedLayoutTypes.begin(), features.fixedLayoutTypes.end()),
+                                    features.fixedLayoutTypes.end());
+
+    setRequestFeatures(features);
+    {
+        std::lock_guard<std::mutex> lock(capabilitiesMutex);
+        negotiatedCapabilities = selected;
+    }
+    std::string reply;
+    const uint16_t type = CAPABILITIES;
+    reply.append(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+    reply.append(selected.SerializeAsString());
+    sendReply(reply);
+}
+
+void ControlledRobot::sendMapChunks() {
+    if (!telemetryTransport.get()) {
+        return;
+    }
+    char header[WireHeader::maxSize];
+    const unsigned int chunks = mapChunksPerUpdate.load();
+    for (unsigned int i = 0; i < chunks && mapTransfers.nextChunk(&mapChunk); ++i) {
+        // not buffered for requests and not rate limited, the controller resumes the transfer if chunks get lost
+        const size_t payloadSize = mapChunk.ByteSizeLong();
+        const size_t headerSize = writeTelemetryHeader(MAP_CHUNK, WireHeader::CHUNKED, header);
+        uint32_t bytes = telemetryTransport->send(MessageView(header, headerSize), payloadSize,
+            [this](char* target) {
+                mapChunk.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(target));
+            });
+        updateStatistics(bytes, MAP_CHUNK);
+    }
+}
+
+bool ControlledRobot::getMap(const uint32_t &mapId, std::string *map) {
+    auto lockedAccess = mapBuffer.lockedAccess();
+    if (mapId < lockedAccess.get().size()) {
+        return RingBufferAccess::peekData(lockedAccess.get()[mapId], map);
+    }
+    return false;
+}
+
+void ControlledRobot::setTelemetryRateLimit(const uint16_t &type, const float &maxFrequency, const uint32_t &decimation) {
+    if (type >= TELEMETRY_MESSAGE_TYPES_NUMBER) {
+        printf("invalid telemetry type %i for rate limit in %s:%i\n", type, __FILE__, __LINE__);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(rateLimitMutex);
+    if (rateLimits.size() < TELEMETRY_MESSAGE_TYPES_NUMBER) {
+        rateLimits.resize(TELEMETRY_MESSAGE_TYPES_NUMBER);
+    }
+    RateLimit &limit = rateLimits[type];
+    limit.minInterval = (maxFrequency > 0) ? 1.0 / maxFrequency : 0;
+    limit.decimation = decimation;
+    limit.counter = 0;
+    limit.sent = false;
+
+    bool active = false;
+    for (const RateLimit &entry : rateLimits) {
+        if (entry.minInterval > 0 || entry.decimation > 1) {
+            active = true;
+            break;
+        }
+    }
+    rateLimitsActive.store(active);
+}
+
+bool ControlledRobot::rateLimitAllowsSend(const uint16_t &type) {
+    if (!rateLimitsActive.load()) {
+        return true;
+    }
+    bool allowed = true;
+    {
+        std::lock_guard<std::mutex> lock(rateLimitMutex);
+        if (type >= rateLimits.size()) {
+            return true;
+        }
+        allowed = rateLimits[type].allowsSend();
+    }
+    if (!allowed && statistics.isEnabled()) {
+        statistics.stat_per_type[type].addSkipped();
+    }
+    return allowed;
+}
+
+bool ControlledRobot::RateLimit::allowsSend() {
+    bool allowed = true;
+    if (decimation > 1) {
+        allowed = (counter % decimation) == 0;
+        counter++;
+    }
+    if (allowed && minInterval > 0) {
+        if (sent && lastSent.getElapsedTime() < minInterval) {
+            allowed = false;
+        } else {
+            lastSent.start();
+            sent = true;
+        }
+    }
+    return allowed;
+}
+
+void ControlledRobot::setImageStreamConfigs(const ImageStreamConfigs &configs) {
+    std::lock_guard<std::mutex> lock(imageStreamMutex);
+    for (const ImageStreamConfig &config : configs.streams()) {
+        ImageStream &stream = imageStreams[config.camera_id()];
+        stream.config = config;
+        stream.limit = RateLimit();
+        stream.limit.minInterval = (config.max_frequency() > 0) ? 1.0 / config.max_frequency() : 0;
+        stream.limit.decimation = config.decimation();
+    }
+}
+
+bool ControlledRobot::getImageStreamConfig(const uint32_t &cameraId, ImageStreamConfig *config) {
+    std::lock_guard<std::mutex> lock(imageStreamMutex);
+    auto stream = imageStreams.find(cameraId);
+    if (stream == imageStreams.end()) {
+        return false;
+    }
+    *config = stream->second.config;
+    return true;
+}
+
+bool ControlledRobot::imageStreamAllowsSend(const uint32_t &cameraId) {
+    std::lock_guard<std::mutex> lock(imageStreamMutex);
+    auto stream = imageStreams.find(cameraId);
+    if (stream == imageStreams.end()) {
+        return true;
+    }
+    return !stream->second.config.disabled() && stream->second.limit.allowsSend();
+}
+
+int ControlledRobot::setImageFrame(const ImageFrame &frame, const char* data, const size_t &size) {
+    using google::protobuf::internal::WireFormatLite;
+    using google::protobuf::io::CodedOutputStream;
+    if (!telemetryTransport.get()) {
+        printf("ERROR Transport invalid\n");
+        return 0;
+    }
+    if (size && frame.data().size()) {
+        printf("the ImageFrame has data already, dropping the frame in %s:%i\n", __FILE__, __LINE__);
+        return 0;
+    }
+    if (!imageStreamAllowsSend(frame.camera_id()) || !rateLimitAllowsSend(IMAGE_FRAME)) {
+        return 0;
+    }
+    // the data field is appended to the serialized metadata, a parser takes it like a serialized ImageFrame
+    const uint32_t dataTag = WireFormatLite::MakeTag(ImageFrame::kDataFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+    const size_t metadataSize = frame.ByteSizeLong();
+    const size_t dataHeaderSize = size ? CodedOutputStream::VarintSize32(dataTag) + CodedOutputStream::VarintSize32(size) : 0;
+    char header[WireHeader::maxSize];
+    const size_t headerSize = writeTelemetryHeader(IMAGE_FRAME, WireHeader::NONE, header);
+    uint32_t bytes = telemetryTransport->send(MessageView(header, headerSize), metadataSize + dataHeaderSize + size,
+        [&](char* target) {
+            uint8_t* position = frame.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(target));
+            if (size) {
+                position = CodedOutputStream::WriteVarint32ToArray(dataTag, position);
+                position = CodedOutputStream::WriteVarint32ToArray(size, position);
+                memcpy(position, data, size);
+            }
+        });
+    RRC_TRACE(TELEMETRY_SENT, IMAGE_FRAME, bytes);
+    updateStatistics(bytes, IMAGE_FRAME);
+    return bytes ? bytes - headerSize : 0;
+}
+
+void ControlledRobot::beginTelemetryBatch() {
+    std::lock_guard<std::mutex> lock(telemetryBatchMutex);
+    if (telemetryBatchDepth == 0) {
+        // keeps the capacity of the last batch
+        telemetryBatch.resize(sizeof(uint16_t));
+        uint16_t header = TELEMETRY_BATCH;
+        memcpy(&telemetryBatch[0], &header, sizeof(uint16_t));
+    }
+    telemetryBatchDepth++;
+}
+
+int ControlledRobot::commitTelemetryBatch() {
+    std::lock_guard<std::mutex> lock(telemetryBatchMutex);
+    if (telemetryBatchDepth == 0) {
+        return 0;
+    }
+    telemetryBatchDepth--;
+    if (telemetryBatchDepth > 0 || telemetryBatch.size() <= sizeof(uint16_t) || !telemetryTransport.get()) {
+        return 0;
+    }
+    int bytes;
+    if (wireHeaderVersion.load(std::memory_order_relaxed)) {
+        char header[WireHeader::maxSize];
+        const size_t headerSize = writeTelemetryHeader(TELEMETRY_BATCH, WireHeader::BATCHED, header);
+        bytes = telemetryTransport->send(MessageView(header, headerSize), MessageView(telemetryBatch).sub(sizeof(uint16_t)));
+    } else {
+        bytes = telemetryTransport->send(telemetryBatch);
+    }
+    if (statistics.isEnabled()) {
+        // the types are counted when added to the batch
+        statistics.global.addBytesSent(bytes);
+    }
+    return bytes;
+}
+
+bool ControlledRobot::addToTelemetryBatch(const uint16_t &type, const size_t &payloadSize, const Transport::PayloadWriter &writePayload) {
+    std::lock_guard<std::mutex> lock(telemetryBatchMutex);
+    if (telemetryBatchDepth == 0) {
+        return false;
+    }
+    // [uint16_t type][uint32_t size][payload]
+    const size_t headerSize = sizeof(uint16_t) + sizeof(uint32_t);
+    size_t offset = telemetryBatch.size();
+    telemetryBatch.resize(offset + headerSize + payloadSize);
+    char* target = &telemetryBatch[offset];
+    uint32_t size = payloadSize;
+    memcpy(target, &type, sizeof(uint16_t));
+    memcpy(target + sizeof(uint16_t), &size, sizeof(uint32_t));
+    writePayload(target + headerSize);
+    if (statistics.isEnabled()) {
+        statistics.stat_per_type[type].addBytesSent(headerSize + payloadSize);
+    }
+    return true;
 }
 
 ControlMessageType ControlledRobot::receiveRequest() {
-    std::string msg;
+    // real-time commands first
+    while (commandStreamTransport.get() && receiveStreamedCommand()) {}
+    while (controlTransport.get() && receiveRequest(controlTransport, &controlReceiveBuffer) != NO_CONTROL_DATA) {}
+    return receiveRequest(commandTransport, &commandReceiveBuffer);
+}
+
+ControlMessageType ControlledRobot::receiveRequest(const TransportSharedPtr &transport, ReceiveBuffer *buffer) {
     Transport::Flags flags = Transport::NONE;
     // if (!this->threaded()){
         flags = Transport::NOBLOCK;
     // }
-    int result = commandTransport->receive(&msg, flags);
+    int result = transport->receive(buffer, flags);
     if (result) {
-        ControlMessageType requestType = evaluateRequest(msg);
+        requestsReceived = true;
+        replyTransport = transport.get();
+        if (multiClient) {
+            requestPeer = transport->getPeer();
+            if (clientSessions.received(requestPeer)) {
+                // the stream falls back to the features the new controller negotiates
+                applySharedFeatures();
+                notifyClientSession(requestPeer, true);
+            }
+        }
+        ControlMessageType requestType = evaluateRequest(buffer->view());
         return requestType;
     }
     return NO_CONTROL_DATA;
 }
 
-ControlMessageType ControlledRobot::evaluateRequest(const std::string& request) {
-    uint16_t* type = reinterpret_cast<uint16_t*>(const_cast<char*>(request.data()));
-    ControlMessageType msgtype = (ControlMessageType)*type;
-    std::string serializedMessage(request.data()+sizeof(uint16_t), request.size()-sizeof(uint16_t));
+bool ControlledRobot::receiveStreamedCommand() {
+    if (!commandStreamTransport->receive(&commandStreamReceiveBuffer, Transport::NOBLOCK)) {
+        return false;
+    }
+    const MessageView &message = commandStreamReceiveBuffer.view();
+    const size_t headerSize = 2 * sizeof(uint32_t);
+    if (message.size < headerSize + sizeof(uint16_t)) {
+        droppedStreamedCommands++;
+        return true;
+    }
+    const uint32_t stream = message.get<uint32_t>();
+    const uint32_t sequence = message.get<uint32_t>(sizeof(uint32_t));
+    const uint16_t type = message.get<uint16_t>(headerSize);
+    if (type == PERMISSION || !getCommandBuffer(type)) {
+        printf("commands of type %i can not be streamed\n", type);
+        droppedStreamedCommands++;
+        return true;
+    }
+    CommandStream &commandStream = commandStreams[stream];
+    commandStream.lastUse = ++streamedCommands;
+    auto last = commandStream.sequences.find(type);
+    if (last == commandStream.sequences.end()) {
+        commandStream.sequences[type] = sequence;
+    } else {
+        // wraps around
+        if (static_cast<int32_t>(last->second - sequence) >= 0) {
+            // out of order or duplicated
+            droppedStreamedCommands++;
+            return true;
+        }
+        last->second = sequence;
+    }
+    if (commandStreams.size() > maxCommandStreams) {
+        // e.g. of controllers that were restarted
+        auto oldest = std::min_element(commandStreams.begin(), commandStreams.end(),
+            [](const std::pair<const uint32_t, CommandStream> &a, const std::pair<const uint32_t, CommandStream> &b) {
+                return a.second.lastUse < b.second.lastUse;
+            });
+        commandStreams.erase(oldest);
+    }
+    replyTransport = nullptr;
+    // the type and payload behind the sequence number is evaluated like a request
+    evaluateRequest(message.sub(headerSize));
+    return true;
+}
+
+int ControlledRobot::sendReply(const MessageView& reply) {
+    if (!replyTransport) {
+        return 0;
+    }
+    if (replyWithRequestId) {
+        return replyTransport->send(MessageView(reinterpret_cast<const char*>(&replyRequestId), sizeof(uint32_t)), reply);
+    }
+    return replyTransport->send(reply, 0, Transport::PayloadWriter());
+}
+
+int ControlledRobot::sendReply(const ControlMessageType &type) {
+    // no string, the type is sent from the stack
+    const uint16_t reply = type;
+    return sendReply(MessageView(reinterpret_cast<const char*>(&reply), sizeof(uint16_t)));
+}
+
+ControlMessageType ControlledRobot::evaluateRequest(const MessageView& request) {
+    replyWithRequestId = false;
+    if (request.size < sizeof(uint16_t)) {
+        // a reply is needed anyway
+        sendReply(NO_CONTROL_DATA);
+        return NO_CONTROL_DATA;
+    }
+    uint16_t header = request.get<uint16_t>();
+    size_t headerSize = sizeof(uint16_t);
+    if (header & REQUEST_ID_FLAG) {
+        if (request.size < sizeof(uint16_t) + sizeof(uint32_t)) {
+            sendReply(NO_CONTROL_DATA);
+            return NO_CONTROL_DATA;
+        }
+        replyRequestId = request.get<uint32_t>(sizeof(uint16_t));
+        replyWithRequestId = true;
+        headerSize += sizeof(uint32_t);
+    }
+    ControlMessageType msgtype = (ControlMessageType)(header & ~REQUEST_ID_FLAG);
+    // no copy, just a view on the data behind the header
+    MessageView serializedMessage = request.sub(headerSize);
+    RRC_TRACE_SCOPE(REQUEST_PARSE_START, REQUEST_PARSE_END, msgtype, request.size);
+
+    if (multiClient && replyTransport && isCommand(msgtype) && !clientSessions.mayCommand(requestPeer)) {
+        // another controller commands the robot, the type is returned, so update() evaluates the next request
+        sendReply(NO_CONTROL_DATA);
+        return msgtype;
+    }
 
     switch (msgtype) {
         case TELEMETRY_REQUEST: {
-            uint16_t* requestedtype = reinterpret_cast<uint16_t*>(const_cast<char*>(serializedMessage.data()));
-            TelemetryMessageType type = (TelemetryMessageType) *requestedtype;
-            std::string reply = buffers->peekSerialized(type);
-            commandTransport->send(reply);
+            TelemetryMessageType type = NO_TELEMETRY_DATA;
+            if (serializedMessage.size >= sizeof(uint16_t)) {
+                type = (TelemetryMessageType)serializedMessage.get<uint16_t>();
+            }
+            // no copy, the reply holds a reference to the sent message
+            TelemetryCache::Payload reply = getLatestTelemetry(type);
+            sendReply(*reply);
             return TELEMETRY_REQUEST;
         }
-        case MAP_REQUEST: {
-            uint16_t* requestedMap = reinterpret_cast<uint16_t*>(const_cast<char*>(serializedMessage.data()));
-            std::string map;
-            //get map
-            {
-                auto lockedAccess = mapBuffer.lockedAccess();
-                if (*requestedMap < lockedAccess.get().size()){
-                    RingBufferAccess::peekData(lockedAccess.get()[*requestedMap],&map);
+        case DESCRIPTION_VERSIONS: {
+            // [type][hash of the controller][0] per type, replied with the current hash and the payload if it changed
+            std::string reply;
+            DescriptionCache::parseItems(serializedMessage, [&](const uint16_t &type, const uint64_t &hash, const MessageView &payload) {
+                TelemetryCache::Payload latest = latestTelemetry.get(type);
+                const uint64_t currentHash = DescriptionCache::contentHash(*latest);
+                DescriptionCache::appendItem(&reply, type, currentHash, currentHash == hash ? MessageView() : MessageView(*latest));
+            });
+            sendReply(reply);
+            return DESCRIPTION_VERSIONS;
+        }
+        case TELEMETRY_BULK_REQUEST: {
+            // types without a message yet are left out, the controller keeps its buffers then
+            std::string reply;
+            for (size_t offset = 0; offset + sizeof(uint16_t) <= serializedMessage.size; offset += sizeof(uint16_t)) {
+                const uint16_t type = serializedMessage.get<uint16_t>(offset);
+                if (type == TELEMETRY_BATCH || !latestTelemetry.contains(type)) {
+                    continue;
                 }
+                TelemetryCache::Payload latest = getLatestTelemetry(type);
+                const uint32_t size = latest->size();
+                reply.append(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+                reply.append(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+                reply.append(*latest);
+            }
+            sendReply(reply);
+            return TELEMETRY_BULK_REQUEST;
+        }
+        case MAP_REQUEST: {
+            uint16_t requestedMap = 0;
+            if (serializedMessage.size >= sizeof(uint16_t)) {
+                requestedMap = serializedMessage.get<uint16_t>();
             }
-            commandTransport->send(map);
+            if (multiClient && replyTransport) {
+                // large maps would delay the requests of the other controllers
+                deferRequest([this, requestedMap](std::string *reply) {
+                    getMap(requestedMap, reply);
+                });
+                return MAP_REQUEST;
+            }
+            std::string map;
+            getMap(requestedMap, &map);
+            sendReply(map);
             return MAP_REQUEST;
         }
+        case MAP_TRANSFER_REQUEST: {
+            MapTransferRequest transferRequest;
+            if (!transferRequest.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                printf("unable to parse message of type %i in %s:%i\n", msgtype, __FILE__, __LINE__);
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            // only the snapshot of the map is taken here, the chunks are sent by update()
+            MapTransferInfo info = mapTransfers.start(transferRequest, [this, &transferRequest](std::string *map) {
+                return getMap(transferRequest.map_id(), map);
+            });
+            sendReply(info.SerializeAsString());
+            return MAP_TRANSFER_REQUEST;
+        }
+        case MAP_TILES_REQUEST: {
+            MapTilesRequest tilesRequest;
+            if (!tilesRequest.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                printf("unable to parse message of type %i in %s:%i\n", msgtype, __FILE__, __LINE__);
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            MapTiles tiles;
+            tiledMaps.getChanges(tilesRequest, &tiles);
+            sendReply(tiles.SerializeAsString());
+            return MAP_TILES_REQUEST;
+        }
         case LOG_LEVEL_SELECT: {
-            logLevel = *reinterpret_cast<uint16_t*>(const_cast<char*>(serializedMessage.data()));
-            commandTransport->send(serializeControlMessageType(LOG_LEVEL_SELECT));
+            if (serializedMessage.size >= sizeof(uint16_t)) {
+                logLevel = serializedMessage.get<uint16_t>();
+            }
+            sendReply(LOG_LEVEL_SELECT);
             return LOG_LEVEL_SELECT;
         }
+        case TELEMETRY_RATE_LIMITS: {
+            TelemetryRateLimits limits;
+            if (!limits.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                printf("unable to parse message of type %i in %s:%i\n", msgtype, __FILE__, __LINE__);
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            for (const TelemetryRateLimit &limit : limits.limits()) {
+                setTelemetryRateLimit(limit.type(), limit.maxfrequency(), limit.decimation());
+            }
+            sendReply(TELEMETRY_RATE_LIMITS);
+            return TELEMETRY_RATE_LIMITS;
+        }
+        case POINTCLOUD_ENCODING: {
+            PointCloudEncoding encoding;
+            if (!encoding.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                printf("unable to parse message of type %i in %s:%i\n", msgtype, __FILE__, __LINE__);
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            ClientSessions::Features features = getRequestFeatures();
+            features.pointCloudEncoding = encoding;
+            setRequestFeatures(features);
+            sendReply(POINTCLOUD_ENCODING);
+            return POINTCLOUD_ENCODING;
+        }
+        case IMAGE_STREAM_CONFIG: {
+            ImageStreamConfigs configs;
+            if (!configs.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                printf("unable to parse message of type %i in %s:%i\n", msgtype, __FILE__, __LINE__);
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            setImageStreamConfigs(configs);
+            sendReply(IMAGE_STREAM_CONFIG);
+            notifyCommandCallbacks(IMAGE_STREAM_CONFIG);
+            return IMAGE_STREAM_CONFIG;
+        }
+        case SESSION_RESUME: {
+            resumeSession(serializedMessage);
+            return SESSION_RESUME;
+        }
+        case CAPABILITIES: {
+            negotiateCapabilities(serializedMessage);
+            return CAPABILITIES;
+        }
+        case JOINT_NAME_TABLE: {
+            uint64_t table = 0;
+            if (serializedMessage.size >= sizeof(uint64_t)) {
+                table = serializedMessage.get<uint64_t>();
+            }
+            if (table && table != jointNameTable.lockedAccess()->getId()) {
+                // the controller has to get the current CONTROLLABLE_JOINTS first
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            ClientSessions::Features features = getRequestFeatures();
+            features.jointTable = table;
+            setRequestFeatures(features);
+            sendReply(JOINT_NAME_TABLE);
+            return JOINT_NAME_TABLE;
+        }
+        case WIRE_HEADER_VERSION: {
+            uint8_t version = 0;
+            if (serializedMessage.size >= sizeof(uint8_t)) {
+                version = serializedMessage.get<uint8_t>();
+            }
+            if (version > WireHeader::currentVersion) {
+                version = WireHeader::currentVersion;
+            }
+            ClientSessions::Features features = getRequestFeatures();
+            features.wireHeaderVersion = version;
+            setRequestFeatures(features);
+            // the version used, the controller may support a newer one
+            char reply[sizeof(uint16_t) + sizeof(uint8_t)];
+            const uint16_t type = WIRE_HEADER_VERSION;
+            memcpy(reply, &type, sizeof(uint16_t));
+            memcpy(reply + sizeof(uint16_t), &version, sizeof(uint8_t));
+            sendReply(MessageView(reply, sizeof(reply)));
+            return WIRE_HEADER_VERSION;
+        }
+        case HEARTBEAT: {
+            const int64_t receiveTimeNs = realtimeNs();
+            HeartBeat heartbeat;
+            if (!heartbeat.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                printf("unable to parse message of type %i in %s:%i\n", msgtype, __FILE__, __LINE__);
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            heartbeatCommand.write(heartbeat);
+            if (multiClient && replyTransport) {
+                clientSessions.heartbeat(requestPeer, heartbeat.heartbeatduration() + heartbeatAllowedLatency);
+            }
+            if (heartbeat.round_trip_time() > 0) {
+                bandwidthGovernor.addLinkSample(heartbeat.round_trip_time(), heartbeat.received_bytes_per_second());
+            }
+            if (heartbeat.request_clock()) {
+                // [HEARTBEAT][receive time][reply time], older controllers only check the type
+                char reply[sizeof(uint16_t) + 2 * sizeof(int64_t)];
+                const uint16_t type = HEARTBEAT;
+                memcpy(reply, &type, sizeof(uint16_t));
+                memcpy(reply + sizeof(uint16_t), &receiveTimeNs, sizeof(int64_t));
+                const int64_t replyTimeNs = realtimeNs();
+                memcpy(reply + sizeof(uint16_t) + sizeof(int64_t), &replyTimeNs, sizeof(int64_t));
+                sendReply(MessageView(reply, sizeof(reply)));
+            } else {
+                sendReply(HEARTBEAT);
+            }
+            notifyCommandCallbacks(HEARTBEAT);
+            return HEARTBEAT;
+        }
+        case JOINTS_COMMAND: {
+            // reused, so the repeated fields keep their memory
+            JointCommand &command = receivedJointsCommand;
+            bool parsed = jointsCommand.reusesMemory() ? CommandBufferBase::parseKeepingMemory(serializedMessage, &command)
+                                                       : command.ParseFromArray(serializedMessage.data, serializedMessage.size);
+            if (!parsed) {
+                printf("unable to parse message of type %i in %s:%i\n", msgtype, __FILE__, __LINE__);
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            if (!jointNameTable.lockedAccess()->expand(&command)) {
+                // the table changed, the controller sends the names again
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            jointsCommand.write(command);
+            sendReply(JOINTS_COMMAND);
+            notifyCommandCallbacks(JOINTS_COMMAND);
+            return JOINTS_COMMAND;
+        }
+        case ROBOT_TRAJECTORY_UPDATE: {
+            TrajectoryUpdate update;
+            if (!update.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                printf("unable to parse message of type %i in %s:%i\n", msgtype, __FILE__, __LINE__);
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            if (!robotTrajectoryCommand.apply(update)) {
+                printf("trajectory update at %i is behind the end of the trajectory\n", update.start_index());
+                sendReply(NO_CONTROL_DATA);
+                return NO_CONTROL_DATA;
+            }
+            sendReply(ROBOT_TRAJECTORY_UPDATE);
+            // the trajectory command changed
+            notifyCommandCallbacks(ROBOT_TRAJECTORY_COMMAND);
+            return ROBOT_TRAJECTORY_UPDATE;
+        }
         case PERMISSION: {
             Permission perm;
-            perm.ParseFromString(serializedMessage);
+            perm.ParseFromArray(serializedMessage.data, serializedMessage.size);
             std::promise<bool> &promise = pendingPermissionRequests[perm.requestuid()];
             try {
                 promise.set_value(perm.granted());
@@ -127,18 +1053,19 @@ ControlMessageType ControlledRobot::evaluateRequest(const std::string& request)
             }
         }
         default: {
-            CommandBufferBase * cmdbuffer = commandbuffers[msgtype];
+            // bounds-checked, unknown types have no buffer
+            CommandBufferBase * cmdbuffer = getCommandBuffer(msgtype);
             if (cmdbuffer) {
                 if (!cmdbuffer->write(serializedMessage)) {
                     printf("unable to parse message of type %i in %s:%i\n", msgtype, __FILE__, __LINE__);
-                    commandTransport->send(serializeControlMessageType(NO_CONTROL_DATA));
+                    sendReply(NO_CONTROL_DATA);
                     return NO_CONTROL_DATA;
                 }
-                commandTransport->send(serializeControlMessageType(msgtype));
-                notifyCommandCallbacks(*type);
+                sendReply(msgtype);
+                notifyCommandCallbacks(msgtype);
                 return msgtype;
             } else {
-                commandTransport->send(serializeControlMessageType(NO_CONTROL_DATA));
+                sendReply(NO_CONTROL_DATA);
                 return msgtype;
             }
         }
@@ -146,7 +1073,11 @@ ControlMessageType ControlledRobot::evaluateRequest(const std::string& request)
 }
 
 void ControlledRobot::notifyCommandCallbacks(const uint16_t &type) {
-    auto callCb = [&](const std::function<void(const uint16_t &type)> &cb){cb(type);};
+    commandSignal.notify();
+    auto callCb = [&](const std::function<void(const uint16_t &type)> &cb){
+        RRC_TRACE(CALLBACK_DISPATCH, type, 0);
+        cb(type);
+    };
     std::for_each(commandCallbacks.begin(), commandCallbacks.end(), callCb);
 }
 
@@ -174,24 +1105,80 @@ int ControlledRobot::setLogMessage(enum LogLevel lvl, const std::string& message
         LogMessage msg;
         msg.set_level(lvl);
         msg.set_message(message);
-        return sendTelemetry(msg, LOG_MESSAGE);
+        return sendLogMessage(msg);
     }
     return -1;
 }
 
 int ControlledRobot::setLogMessage(const LogMessage& log_message) {
     if (log_message.level() <= logLevel || log_message.level() >= CUSTOM) {
-        return sendTelemetry(log_message, LOG_MESSAGE);
+        return sendLogMessage(log_message);
     }
     return -1;
 }
 
+int ControlledRobot::sendLogMessage(const LogMessage &message) {
+    if (!logBatching.load()) {
+        return sendTelemetry(message, LOG_MESSAGE);
+    }
+    LogBatcher::Result result;
+    if (message.has_timestamp()) {
+        result = logBatcher.add(message);
+    } else {
+        // batched messages are delayed, the time of the log is kept
+        LogMessage stamped = message;
+        *stamped.mutable_timestamp() = getTime();
+        result = logBatcher.add(stamped);
+    }
+    switch (result) {
+        case LogBatcher::DROPPED:   return -1;
+        case LogBatcher::SEND:      return sendTelemetry(message, LOG_MESSAGE);
+        case LogBatcher::FULL:      return flushLogMessages();
+        default:                    return 0;
+    }
+}
+
+void ControlledRobot::setLogBatching(const LogBatcher::Options &options) {
+    logBatcher.setOptions(options);
+    logBatching.store(true);
+}
+
+void ControlledRobot::disableLogBatching() {
+    logBatching.store(false);
+    flushLogMessages();
+}
+
+int ControlledRobot::flushLogMessages() {
+    LogMessages batch;
+    if (!logBatcher.take(&batch)) {
+        return 0;
+    }
+    const robot_remote_control::TimeStamp now = getTime();
+    for (LogMessage &message : *batch.mutable_messages()) {
+        // the reports of rate limited messages
+        if (!message.has_timestamp()) {
+            *message.mutable_timestamp() = now;
+        }
+    }
+    if (batch.messages_size() > 1 && controllerSplitsLogs.load()) {
+        return sendTelemetry(batch, LOG_MESSAGES);
+    }
+    int bytes = 0;
+    for (const LogMessage &message : batch.messages()) {
+        bytes += std::max(0, sendTelemetry(message, LOG_MESSAGE));
+    }
+    return bytes;
+}
+
+int64_t ControlledRobot::realtimeNs() {
+    return Clock::realtimeNs();
+}
+
 robot_remote_control::TimeStamp ControlledRobot::getTime() {
-    struct timespec rawtime;
-    clock_gettime(CLOCK_REALTIME, &rawtime);
+    const int64_t now = Clock::realtimeNs();
     robot_remote_control::TimeStamp timestamp;
-    timestamp.set_secs(rawtime.tv_sec);
-    timestamp.set_nsecs(rawtime.tv_nsec);
+    timestamp.set_secs(now / 1000000000);
+    timestamp.set_nsecs(now % 1000000000);
     return timestamp;
 }
 
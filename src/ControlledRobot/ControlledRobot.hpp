@@ -1,31 +1,62 @@
 #pragma once
 
 #include "MessageTypes.hpp"
+#include "MessageTraits.hpp"
 #include "Transports/Transport.hpp"
 #include "UpdateThread/UpdateThread.hpp"
 #include "UpdateThread/Timer.hpp"
+#include "UpdateThread/CallbackExecutor.hpp"
 #include "TelemetryBuffer.hpp"
+#include "TelemetryCache.hpp"
+#include "FixedLayout.hpp"
+#include "TripleBuffer.hpp"
+#include "DataSignal.hpp"
+#include "DescriptionCache.hpp"
+#include "TransformTree.hpp"
+#include "ClientSessions.hpp"
+#include "LogBatcher.hpp"
+#include "TelemetrySendQueue.hpp"
 #include "SimpleBuffer.hpp"
 #include "Statistics.hpp"
+#include "BandwidthGovernor.hpp"
+#include "Tracing.hpp"
+#include "PointCloudCodec.hpp"
+#include "MapTiles.hpp"
+#include "MapTransfer.hpp"
+#include "JointNameTable.hpp"
+#include "Types/Conversions/GridMapLayerCodec.hpp"
+#include <deque>
 #include <map>
 #include <string>
 #include <memory>
 #include <vector>
 #include <atomic>
 #include <algorithm>
+#include <mutex>
+#include <cstring>
+#include <google/protobuf/message.h>
+#include <google/protobuf/io/coded_stream.h>
 
 namespace robot_remote_control {
 
 class ControlledRobot: public UpdateThread {
     public:
         explicit ControlledRobot(TransportSharedPtr commandTransport, TransportSharedPtr telemetryTransport);
-        virtual ~ControlledRobot() {}
+        virtual ~ControlledRobot() {
+            // the sender thread uses the transport and the statistics
+            telemetryQueue.stop();
+        }
 
         /**
          * @brief threaded update function called by UpdateThread that receives commands
          */
         virtual void update();
 
+        /**
+         * @brief used in UpdateThread::REACTOR mode: waits for commands, but not longer than the heartbeat allows
+         */
+        virtual void waitForUpdate(const unsigned int &maxMilliseconds);
+
 
         void setupHeartbeatCallback(const float &allowedLatency, const std::function<void(const float&)> &callback) {
             heartbeatAllowedLatency = allowedLatency;
@@ -44,7 +75,15 @@ class ControlledRobot: public UpdateThread {
          * @param function that takes const uint16_t &type (the tpye id from the message receive) as argument (may also be a lamda)
          */
         void addCommandReceivedCallback(const std::function<void(const uint16_t &type)> &function) {
-            commandCallbacks.push_back(function);
+            if (!callbackExecutor) {
+                commandCallbacks.push_back(function);
+                return;
+            }
+            std::shared_ptr<CallbackExecutor> executor = callbackExecutor;
+            std::shared_ptr< std::function<void(const uint16_t &type)> > callback = std::make_shared< std::function<void(const uint16_t &type)> >(function);
+            commandCallbacks.push_back([executor, callback](const uint16_t &type) {
+                executor->post(type, [callback, type]() { (*callback)(type); }, callback.get());
+            });
         }
 
         /**
@@ -52,13 +91,157 @@ class ControlledRobot: public UpdateThread {
          * 
          * @param type the Command type id from the MessageTypes header
          * @param function 
+         * @return false if the type has no command buffer
+         */
+        bool addCommandReceivedCallback(const uint16_t &type, const std::function<void()> &function) {
+            CommandBufferBase *buffer = getCommandBuffer(type);
+            if (!buffer) {
+                printf("no command buffer for type %i, the callback is not added\n", type);
+                return false;
+            }
+            if (!callbackExecutor) {
+                buffer->addCommandReceivedCallback(function);
+                return true;
+            }
+            std::shared_ptr<CallbackExecutor> executor = callbackExecutor;
+            std::shared_ptr< std::function<void()> > callback = std::make_shared< std::function<void()> >(function);
+            buffer->addCommandReceivedCallback([executor, callback, type]() {
+                executor->post(type, [callback]() { (*callback)(); }, callback.get());
+            });
+            return true;
+        }
+
+        /**
+         * @brief block until a new command of a type is received, instead of polling the getters in a loop
+         *
+         * @param type the Command type id from the MessageTypes header
+         * @param timeoutMs maximum time to wait in milliseconds
+         * @return true if there is a command that was not read yet (right away if there already was one),
+         * false on timeout or if the type has no command buffer
+         */
+        bool waitForCommand(const uint16_t &type, const unsigned int &timeoutMs) {
+            CommandBufferBase *buffer = getCommandBuffer(type);
+            if (!buffer) {
+                return false;
+            }
+            return commandSignal.waitFor([buffer]() { return buffer->isNew(); }, timeoutMs);
+        }
+
+        /**
+         * @brief receive real-time commands on a separate transport (see RobotController::setControlTransport()),
+         * its requests are evaluated before each request of the command transport, so they are not delayed by bulk requests queued there
+         * @warning has to be called before the update thread is started
+         *
+         * @param transport the transport, e.g. a second REP socket
          */
-        void addCommandReceivedCallback(const uint16_t &type, const std::function<void()> &function) {
-            commandbuffers[type]->addCommandReceivedCallback(function);
+        void setControlTransport(const TransportSharedPtr &transport) {
+            controlTransport = transport;
         }
 
         /**
-         * @brief Get the Statistics object, it is only updated with data if this library is compiled with RRC_STATISTICS
+         * @brief serve several controllers at once on a command transport with several peers (TransportZmq::ROUTER,
+         * the controllers connect with DEALER or REQ sockets):
+         *  - each controller has its own session with its own heartbeat timeout (see getClientSessions())
+         *  - commands are only accepted from the commanding controller, the others get NO_CONTROL_DATA (see ClientSessions)
+         *  - MAP_REQUEST is answered by a worker thread, the reply is sent by a later update(),
+         *    so the requests of other controllers are not delayed by large maps (replies may be out of order then)
+         *  - the telemetry stream is shared, it only uses the features all sessions negotiated (e.g. the WireHeader),
+         *    a controller that did not negotiate gets the plain stream
+         * Streamed commands (setCommandStreamTransport()) have no peer and are not arbitrated.
+         * @warning has to be called before the update thread is started
+         *
+         * @param enable use sessions, the transport has to support Transport::getPeer()
+         * @param sessionTimeout seconds without requests until the session of a controller without heartbeats expires
+         */
+        void setMultiClient(const bool &enable, const float &sessionTimeout = 5);
+
+        /**
+         * @brief set the priority of a controller, a controller with a higher priority takes over commanding with its next command
+         *
+         * @param peer the peer id (e.g. the TransportZmq::SocketOptions::identity of the controller)
+         * @param priority the priority, 0 by default
+         */
+        void setClientPriority(const std::string &peer, const int &priority) {
+            clientSessions.setPriority(peer, priority);
+        }
+
+        /**
+         * @brief let another controller command the robot (e.g. when the operator of the commanding one is done)
+         */
+        void releaseCommandingClient() {
+            clientSessions.release(clientSessions.getCommander());
+        }
+
+        /**
+         * @brief the controllers connected in multi-client mode, see setMultiClient()
+         */
+        std::vector<ClientSessions::SessionInfo> getClientSessions() {
+            return clientSessions.getSessions();
+        }
+
+        /**
+         * @brief the id of this run of the robot, a controller resuming its session (RobotController::resumeSession())
+         * gets all latest telemetry when the robot restarted meanwhile
+         */
+        uint64_t getSessionId() const {
+            return sessionId;
+        }
+
+        /**
+         * @brief add a callback for controllers connecting (true) and their sessions expiring (false) in multi-client mode,
+         * called in the update thread
+         * @warning has to be called before the update thread is started
+         */
+        void addClientSessionCallback(const std::function<void(const std::string &peer, const bool &connected)> &function) {
+            clientSessionCallbacks.push_back(function);
+        }
+
+        /**
+         * @brief receive streamed commands (see RobotController::setCommandStreamTransport()), they are not acknowledged.
+         * A command is dropped when its sequence number is older than the one of the last command of its type and controller
+         * (each RobotController streams with its own random stream id, so a restarted or second controller starts its own sequence).
+         * The streamed commands are evaluated before the requests of the other transports.
+         * @warning has to be called before the update thread is started
+         *
+         * @param transport the transport, e.g. TransportZmq::PULL
+         */
+        void setCommandStreamTransport(const TransportSharedPtr &transport) {
+            commandStreamTransport = transport;
+        }
+
+        /**
+         * @brief number of streamed commands dropped because they were out of order or of a type that can't be streamed
+         */
+        uint64_t getDroppedStreamedCommands() {
+            return droppedStreamedCommands.load();
+        }
+
+        /**
+         * @brief reserve the buffers used to receive requests and send replies, for update() in real-time loops.
+         * The command buffers keep the memory of their fields (see CommandBufferBase::setReuseMemory()).
+         * Once each command type was received three times (warm-up, one for each slot of its TripleBuffer), evaluating commands and sending the acknowledgements
+         * does not allocate memory, given the transports do not allocate (zmq uses malloc for large messages)
+         * @warning has to be called after setControlTransport() and before the update thread is started
+         *
+         * @param bytes size of the largest expected request
+         */
+        void preallocateBuffers(const size_t &bytes);
+
+        /**
+         * @brief set the executor calling the command callbacks added after this call, so slow callbacks
+         * do not delay the evaluation of the following requests in the update thread.
+         * The callback policy (e.g. CallbackExecutor::LATEST_ONLY) is set on the executor per command type,
+         * the callbacks should read the latest command with the getters (e.g. getTwistCommand()).
+         *
+         * @param executor the executor, nullptr to call new callbacks in the update thread (default)
+         */
+        void setCallbackExecutor(const std::shared_ptr<CallbackExecutor> &executor) {
+            callbackExecutor = executor;
+        }
+
+        /**
+         * @brief Get the Statistics object, recording is enabled by default if this library is compiled with RRC_STATISTICS
+         * and can be switched by Statistics::setEnabled() at runtime
          * 
          * @return Statistics& 
          */
@@ -66,13 +249,188 @@ class ControlledRobot: public UpdateThread {
             return statistics;
         }
 
+        /**
+         * @brief publish the statistics periodically as ROBOT_STATISTICS telemetry (RobotController::getRobotStatistics()),
+         * the rates are calculated before each publication. Needs the update thread (or runScheduledTasks()).
+         *
+         * @param seconds interval, 0 stops publishing (default)
+         */
+        void setStatisticsPublishInterval(const float &seconds);
+
+        /**
+         * @brief calculate the statistics and send them as ROBOT_STATISTICS telemetry
+         *
+         * @return int number of bytes sent
+         */
+        int publishStatistics();
+
+        /**
+         * @brief Get the BandwidthGovernor to configure the link budget and the priorities of the telemetry types
+         */
+        BandwidthGovernor& getBandwidthGovernor() {
+            return bandwidthGovernor;
+        }
+
+        /**
+         * @brief run the BandwidthGovernor periodically: it sets the rate limits of the types with a priority
+         * (BandwidthGovernor::setPriority()), and when the budget is exceeded it coarsens point clouds and grid maps
+         * (see setMaxCoarsening()) and raises the compression effort of the telemetry transport (Transport::setCompressionEffort()).
+         * The link budget is estimated from the heartbeats if it is not configured.
+         * Needs the statistics enabled and the update thread (or runScheduledTasks()).
+         *
+         * @param seconds interval, 0 stops governing and removes its limits (default)
+         */
+        void setBandwidthGovernorInterval(const float &seconds);
+
+        /**
+         * @brief run the BandwidthGovernor once and apply its decision
+         */
+        BandwidthGovernor::Decision governBandwidth();
+
+        /**
+         * @brief Set the maximum factor the point cloud resolution and the allowed grid map error are scaled with
+         * by the BandwidthGovernor, only lossy encodings (resolution or max_error > 0) are scaled
+         *
+         * @param factor 1 to keep the encodings, default 4
+         */
+        void setMaxCoarsening(const float &factor) {
+            maxCoarsening.store(std::max(1.0f, factor));
+        }
+
+        /**
+         * @brief the current scale of the point cloud resolution and the grid map error, 1 if the budget is not exceeded
+         */
+        float getCoarsening() {
+            return coarsening.load();
+        }
+
+        /**
+         * @brief limit the publication rate of a telemetry type, calls above the limit only update the
+         * latest value (for telemetry requests) and are not sent.
+         * The controller can also set the limits using RobotController::setTelemetryRateLimit()
+         *
+         * @param type the TelemetryMessageType to limit
+         * @param maxFrequency maximum number of messages sent per second, 0 for no limit
+         * @param decimation only send every n-th message, 0 or 1 to send all
+         */
+        void setTelemetryRateLimit(const uint16_t &type, const float &maxFrequency, const uint32_t &decimation = 0);
+
+        /**
+         * @brief send the telemetry from a sender thread, so the setters (e.g. setCurrentPose() in a control loop) return
+         * in constant time, also when the transport blocks on a slow link (e.g. TransportUDT).
+         * Each type has a bounded queue, by default DROP_OLDEST with defaultDepth messages, LOG_MESSAGE and PERMISSION_REQUEST are never dropped.
+         * Telemetry batches, map chunks and image frames are still sent by the calling thread.
+         *
+         * @param async false stops the sender thread, the queued messages are sent when it is started again
+         * @param defaultDepth queue size of the DROP_OLDEST types without their own depth
+         */
+        void setAsyncTelemetry(const bool &async = true, const size_t &defaultDepth = 8);
+
+        /**
+         * @brief the drop policy of a type in the queue of setAsyncTelemetry(), e.g. COALESCE for CURRENT_POSE to only send the latest pose
+         *
+         * @param depth queue size for DROP_OLDEST, 0 for the default depth
+         */
+        void setTelemetryQueuePolicy(const uint16_t &type, const TelemetrySendQueue::Policy &policy, const size_t &depth = 0) {
+            telemetryQueue.setPolicy(type, policy, depth);
+        }
+
+        /**
+         * @brief wait until the queued telemetry was sent (e.g. before shutting down)
+         *
+         * @return false if it was not sent within timeoutMs
+         */
+        bool flushTelemetry(const unsigned int &timeoutMs = 1000) {
+            return telemetryQueue.flush(timeoutMs);
+        }
+
+        /**
+         * @brief the priority class of a type in the queue of setAsyncTelemetry(), the classes share the link by their weight.
+         * By default the state of the robot (e.g. CURRENT_POSE, CURRENT_TWIST, JOINT_STATE) and PERMISSION_REQUEST are HIGH,
+         * POINTCLOUD, MAP and POSES are BULK and the other types NORMAL.
+         */
+        void setTelemetryPriorityClass(const uint16_t &type, const uint8_t &priorityClass) {
+            telemetryQueue.setPriorityClass(type, priorityClass);
+        }
+
+        /**
+         * @brief the share of a priority class while several classes have telemetry queued (bytes per round, relative to the other classes)
+         */
+        void setTelemetryClassWeight(const uint8_t &priorityClass, const unsigned int &weight) {
+            telemetryQueue.setClassWeight(priorityClass, weight);
+        }
+
+        /**
+         * @brief split queued messages above this size into TELEMETRY_CHUNK messages, so a big message (e.g. a point cloud)
+         * does not delay the messages of higher classes until it is sent completely. 0 (the default) sends all messages complete
+         * @warning the controller has to support TELEMETRY_CHUNK (RobotController reassembles chunks), a controller that did not
+         * offer it in the CAPABILITIES handshake gets the messages complete
+         */
+        void setTelemetryChunkSize(const size_t &bytes) {
+            telemetryChunkSize.store(bytes);
+            telemetryQueue.setChunkSize(controllerReassemblesChunks.load() ? bytes : 0);
+        }
+
+        /**
+         * @brief the features selected in the last CAPABILITIES handshake of a controller (RobotController::negotiateCapabilities()),
+         * protocol_version is 0 if there was none
+         */
+        Capabilities getNegotiatedCapabilities() {
+            std::lock_guard<std::mutex> lock(capabilitiesMutex);
+            return negotiatedCapabilities;
+        }
+
+        TelemetrySendQueue::Statistics getTelemetryQueueStatistics() {
+            return telemetryQueue.getStatistics();
+        }
+
+        /**
+         * @brief start collecting telemetry: all telemetry until commitTelemetryBatch() is sent in one transport message.
+         * Batches can be nested, the telemetry is sent on the outermost commit
+         */
+        void beginTelemetryBatch();
+
+        /**
+         * @brief send the telemetry collected since beginTelemetryBatch() in one transport message
+         *
+         * @return int number of bytes sent, 0 if nothing was sent (inner batch or no telemetry)
+         */
+        int commitTelemetryBatch();
+
+        /**
+         * @brief begins a telemetry batch on construction and commits it when it goes out of scope
+         *
+         * Example:
+         *  {
+         *      ControlledRobot::TelemetryBatch batch(&robot);
+         *      robot.setCurrentPose(pose);
+         *      robot.setJointState(joints);
+         *  } // both are sent in one transport message
+         */
+        class TelemetryBatch {
+         public:
+            explicit TelemetryBatch(ControlledRobot *robot) : robot(robot) {
+                robot->beginTelemetryBatch();
+            }
+            ~TelemetryBatch() {
+                robot->commitTelemetryBatch();
+            }
+            TelemetryBatch(const TelemetryBatch&) = delete;
+            TelemetryBatch& operator=(const TelemetryBatch&) = delete;
+         private:
+            ControlledRobot *robot;
+        };
+
         // Command getters
+        // The getters of the latest-value commands are wait-free for a single reader (see CommandBuffer): each command
+        // type has to be read from one thread only (e.g. the control loop), several readers have to share the value themselves.
 
         /**
          * @brief Get the Target Pose the robot should move to
          * 
          * @return true if the command was not read before
          * @param command the last received command
+         * @warning read this command from one thread only
          */
         bool getTargetPoseCommand(Pose *command) {
             return poseCommand.read(command);
@@ -83,6 +441,7 @@ class ControlledRobot: public UpdateThread {
          * 
          * @return true if the command was not read before
          * @param command the last received command
+         * @warning read this command from one thread only
          */
         bool getTwistCommand(Twist *command) {
             return twistCommand.read(command);
@@ -93,6 +452,7 @@ class ControlledRobot: public UpdateThread {
          *
          * @return true if the command was not read before
          * @param command the last received command
+         * @warning read this command from one thread only
          */
         bool getGoToCommand(GoTo *command) {
             return goToCommand.read(command);
@@ -103,6 +463,7 @@ class ControlledRobot: public UpdateThread {
          *
          * @return true if the command was not read before
          * @param command the last received command
+         * @warning read this command from one thread only
          */
 
         bool getJointsCommand(JointCommand *command) {
@@ -115,6 +476,7 @@ class ControlledRobot: public UpdateThread {
          *
          * @return true if the command was not read before
          * @param command the last received command
+         * @warning read this command from one thread only
          */
         bool getSimpleActionCommand(SimpleAction *command) {
             return simpleActionsCommand.read(command);
@@ -125,15 +487,35 @@ class ControlledRobot: public UpdateThread {
          *
          * @return true if the command was not read before
          * @param command the last received command
+         * @warning read this command from one thread only
          */
         bool getComplexActionCommand(ComplexAction *command) {
             return complexActionCommandBuffer.read(command);
         }
 
+        /**
+         * @brief Get the trajectory the robot should follow, with the updates received since the ROBOT_TRAJECTORY_COMMAND
+         * (see RobotController::updateRobotTrajectory())
+         *
+         * @return true if the trajectory changed since the last read
+         * @param command the current trajectory
+         */
         bool getRobotTrajectoryCommand(Poses *command) {
             return robotTrajectoryCommand.read(command);
         }
 
+        /**
+         * @brief add a callback for changes of the trajectory, called in the update thread with the trajectory locked,
+         * so only the changed waypoints have to be processed (e.g. to replan the velocity profile behind them).
+         * A new ROBOT_TRAJECTORY_COMMAND changes all waypoints, an update removing waypoints also reduces the size of the trajectory.
+         * @warning has to be called before the update thread is started, the trajectory must not be used after the callback returned
+         *
+         * @param function called with the trajectory and the range of changed waypoints
+         */
+        void addTrajectoryChangedCallback(const std::function<void(const Poses &trajectory, const uint32_t &start, const uint32_t &count)> &function) {
+            robotTrajectoryCommand.addChangedCallback(function);
+        }
+
         /**
          * @brief Helper function to get TimeStamp object
          *
@@ -154,27 +536,190 @@ class ControlledRobot: public UpdateThread {
          */
         template<class CLASS> int sendTelemetry(const CLASS &protodata, const uint16_t& type, bool requestOnly = false) {
             if (telemetryTransport.get()) {
-                std::string buf;
-                buf.resize(sizeof(uint16_t));
-                uint16_t* data = reinterpret_cast<uint16_t*>(const_cast<char*>(buf.data()));
-                *data = type;
-                protodata.AppendToString(&buf);
-                // store latest data for future requests
-                RingBufferAccess::pushData(buffers->lockedAccess().get()[type], protodata, true);
+                if (!requestOnly && usesFixedLayout(type)) {
+                    return sendFixedLayout(protodata, type, std::integral_constant<bool, FixedLayout::Codec<CLASS>::supported>());
+                }
+                // also caches the size for SerializeWithCachedSizesToArray()
+                const size_t payloadSize = protodata.ByteSizeLong();
+                // serialized once, the latest data is kept for future requests
+                TelemetryCache::Payload payload = latestTelemetry.set(type, protodata, payloadSize);
+                if (type < sentSequences.size()) {
+                    // set again when sent with a sequence number
+                    sentSequences[type].store(0, std::memory_order_relaxed);
+                }
+                RRC_TRACE(TELEMETRY_SERIALIZED, type, payloadSize);
+                if (!requestOnly && !rateLimitAllowsSend(type)) {
+                    return 0;
+                }
                 if (!requestOnly) {
-                    uint32_t bytes = telemetryTransport->send(buf);
+                    auto writePayload = [&payload](char* target) {
+                        memcpy(target, payload->data(), payload->size());
+                    };
+                    if (addToTelemetryBatch(type, payloadSize, writePayload)) {
+                        return payloadSize;
+                    }
+                    if (telemetryQueue.isRunning()) {
+                        telemetryQueue.push(type, payload);
+                        return payloadSize;
+                    }
+                    char header[WireHeader::maxSize];
+                    const size_t headerSize = writeTelemetryHeader(type, WireHeader::NONE, header);
+                    uint32_t bytes = telemetryTransport->send(MessageView(header, headerSize), MessageView(*payload));
+                    RRC_TRACE(TELEMETRY_SENT, type, bytes);
                     updateStatistics(bytes, type);
-                    return bytes - sizeof(uint16_t);
+                    return bytes - headerSize;
                 }
-                return buf.size();
+                return payloadSize + sizeof(uint16_t);
             }
             printf("ERROR Transport invalid\n");
             return 0;
         }
 
+        /**
+         * @brief send the FixedLayout struct instead of the serialized message, it is only serialized when it is requested
+         */
+        template<class CLASS> int sendFixedLayout(const CLASS &protodata, const uint16_t& type, std::true_type /*supported*/) {
+            typename FixedLayout::Codec<CLASS>::Layout layout;
+            FixedLayout::Codec<CLASS>::encode(protodata, &layout);
+            latestTelemetry.setEncoded(type, &layout, sizeof(layout), &FixedLayout::serialize<CLASS>);
+            sentSequences[type].store(0, std::memory_order_relaxed);
+            RRC_TRACE(TELEMETRY_SERIALIZED, type, sizeof(layout));
+            if (!rateLimitAllowsSend(type)) {
+                return 0;
+            }
+            char header[WireHeader::maxSize];
+            const size_t headerSize = writeTelemetryHeader(type, WireHeader::FIXED_LAYOUT, header);
+            uint32_t bytes = telemetryTransport->send(MessageView(header, headerSize),
+                                                      MessageView(reinterpret_cast<const char*>(&layout), sizeof(layout)));
+            RRC_TRACE(TELEMETRY_SENT, type, bytes);
+            updateStatistics(bytes, type);
+            return bytes - headerSize;
+        }
+
+        template<class CLASS> int sendFixedLayout(const CLASS &protodata, const uint16_t& type, std::false_type /*supported*/) {
+            // e.g. an extension type registered with the number of a fixed layout type
+            fixedLayoutTypes[type].store(false);
+            return sendTelemetry(protodata, type);
+        }
+
+        /**
+         * @brief true if the controller selected the FixedLayout of the type (Capabilities::fixed_layout_types)
+         * and the message is sent directly, batches and the send queue carry protobuf messages
+         */
+        bool usesFixedLayout(const uint16_t &type);
+
         void updateStatistics(const uint32_t &bytesSent, const uint16_t &type);
 
+        /**
+         * @brief write the header of a telemetry message, the plain type or a WireHeader if the controller selected it
+         *
+         * @param type the telemetry type
+         * @param flags WireHeader::Flags of the message
+         * @param target at least WireHeader::maxSize bytes
+         * @return size_t size of the header
+         */
+        size_t writeTelemetryHeader(const uint16_t &type, const uint16_t &flags, char* target);
+
+        // selected by WIRE_HEADER_VERSION, 0 sends the plain type header
+        std::atomic<uint8_t> wireHeaderVersion;
+        // negotiated by the controller in single-client mode, in multi-client mode each session has its own
+        ClientSessions::Features controllerFeatures;
+        // the encoding the controllers selected last, setPointCloudEncoding() of the robot is kept until they select another one
+        PointCloudEncoding selectedPointCloudEncoding;
+
+        /**
+         * @brief the features negotiated by the controller of the current request
+         */
+        ClientSessions::Features getRequestFeatures();
+
+        /**
+         * @brief record the features negotiated by the controller of the current request and use the ones
+         * of the shared telemetry stream (see applySharedFeatures())
+         */
+        void setRequestFeatures(const ClientSessions::Features &features);
+
+        /**
+         * @brief use the features of the controller, in multi-client mode the ones all sessions negotiated,
+         * called again when sessions start or expire
+         */
+        void applySharedFeatures();
+        std::array<std::atomic<uint32_t>, TELEMETRY_MESSAGE_TYPES_NUMBER> telemetrySequences;
+        // the sequence number + 1 of the message that sent the latest value of a type, 0 if it was not sent with a sequence number
+        // (e.g. rate limited or batched), changed types are sent to resuming controllers (SESSION_RESUME)
+        std::array<std::atomic<uint32_t>, TELEMETRY_MESSAGE_TYPES_NUMBER> sentSequences;
+        // selected by CAPABILITIES (in multi-client mode by all sessions), sent as FixedLayout struct
+        std::array<std::atomic<bool>, TELEMETRY_MESSAGE_TYPES_NUMBER> fixedLayoutTypes;
+        // random per run of the robot, the sequence numbers of a controller resuming another session are meaningless
+        uint64_t sessionId;
+        void resumeSession(const MessageView &request);
+
+        /**
+         * @brief the cached latest message of a type for replies, a compact JointState gets its names back
+         */
+        TelemetryCache::Payload getLatestTelemetry(const uint16_t &type);
+
+        // see setAsyncTelemetry()
+        TelemetrySendQueue telemetryQueue;
+        // the header of a TELEMETRY_CHUNK payload
+        static const size_t chunkHeaderSize = 14;
+        std::atomic<size_t> telemetryChunkSize;
+        // true until a controller without TELEMETRY_CHUNK support negotiated (older controllers do not negotiate),
+        // in multi-client mode while all sessions negotiated it
+        std::atomic<bool> controllerReassemblesChunks;
+
+        /**
+         * @brief select the common features of the offer of the controller and this robot, enable them and reply the selection
+         */
+        void negotiateCapabilities(const MessageView &offer);
+        std::mutex capabilitiesMutex;
+        Capabilities negotiatedCapabilities;
+        void sendQueuedTelemetry(const TelemetrySendQueue::Chunk &chunk);
+
+        /**
+         * @brief checks the rate limit of the type and counts skipped messages
+         *
+         * @return true if the message should be sent
+         */
+        bool rateLimitAllowsSend(const uint16_t &type);
+
+        struct RateLimit {
+            RateLimit():minInterval(0), decimation(0), counter(0), sent(false) {}
+            // counts the message, false if it has to be dropped
+            bool allowsSend();
+            float minInterval;
+            uint32_t decimation;
+            uint32_t counter;
+            Timer lastSent;
+            bool sent;
+        };
+        std::mutex rateLimitMutex;
+        std::vector<RateLimit> rateLimits;
+        // avoids locking the mutex when no limits are set
+        std::atomic<bool> rateLimitsActive;
+
+        /**
+         * @brief add a telemetry message to the current batch
+         *
+         * @return true if a batch is open and the message was added
+         */
+        bool addToTelemetryBatch(const uint16_t &type, const size_t &payloadSize, const Transport::PayloadWriter &writePayload);
+
+        std::mutex telemetryBatchMutex;
+        unsigned int telemetryBatchDepth;
+        std::string telemetryBatch;
+
     public:
+        /**
+         * @brief send a telemetry message with its protobuf type resolved at compile time (TelemetryTraits),
+         * e.g. setTelemetry<CURRENT_POSE>(pose). It is sent as is, without the processing of the type specific setters
+         * (e.g. the compact joint names of setJointState()).
+         *
+         * @return int number of bytes sent
+         */
+        template <uint16_t TYPE> int setTelemetry(const typename TelemetryTraits<TYPE>::type &telemetry) {
+            return sendTelemetry(telemetry, TYPE);
+        }
+
         /**
          * @brief The robot uses this method to provide information about its controllable joints
          *
@@ -182,6 +727,10 @@ class ControlledRobot: public UpdateThread {
          * @return int number of bytes sent
          */
         int initControllableJoints(const JointState& telemetry) {
+            if (jointNameTable.lockedAccess()->set(telemetry)) {
+                // send names until a controller agreed on the new table
+                compactJointTable.store(0);
+            }
             return sendTelemetry(telemetry, CONTROLLABLE_JOINTS);
         }
 
@@ -210,7 +759,8 @@ class ControlledRobot: public UpdateThread {
          * @brief The robot uses this method to provide information about its sensors
          * The name is only mandatory here, setSimpleSnsor() may omit this value and identify by id
          * 
-         * @param telemetry a list of simple sensors and their names/ids, other firelds not nessecary
+         * @param telemetry a list of simple sensors and their names/ids, other firelds not nessecary,
+         * buffer_size sets the number of values the controller buffers (e.g. of high rate sensors)
          * @return int  number of bytes sent
          */
         int initSimpleSensors(const SimpleSensors &telemetry) {
@@ -279,6 +829,34 @@ class ControlledRobot: public UpdateThread {
          */
         int setLogMessage(const LogMessage& log_message);
 
+        /**
+         * @brief batch the log messages which pass the log level: they are sent as LOG_MESSAGES every options.intervalMs
+         * or when options.maxEntries are collected, repetitions are merged into one entry with a count (LogMessage::count)
+         * and the levels can be rate limited, e.g. setLogBatching(LogBatcher::Options().limit(DEBUG, 20).limit(INFO, 50)).
+         * The batches are sent by update(), setLogMessage() returns 0 for batched messages then and -1 for rate limited ones.
+         * Controllers which did not negotiate LOG_MESSAGES get the entries of the batches one by one,
+         * in multi-client mode this is the case until all sessions negotiated it.
+         *
+         * @param options intervalMs 0 only applies the rate limits
+         */
+        void setLogBatching(const LogBatcher::Options &options = LogBatcher::Options());
+
+        /**
+         * @brief send the pending batch and send each log message immediately again
+         */
+        void disableLogBatching();
+
+        /**
+         * @brief send the pending batch now
+         *
+         * @return int number of bytes sent, 0 if nothing was pending
+         */
+        int flushLogMessages();
+
+        LogBatcher::Statistics getLogBatchingStatistics() {
+            return logBatcher.getStatistics();
+        }
+
         /**
          * @brief Set the Robot State as a single string
          * 
@@ -346,6 +924,19 @@ class ControlledRobot: public UpdateThread {
          * @return int number of bytes sent
          */
         int setJointState(const JointState& telemetry) {
+            const uint64_t table = compactJointTable.load();
+            if (table) {
+                // without names, if a controller agreed on the table of the controllable joints (JOINT_NAME_TABLE)
+                JointState compact;
+                bool compacted;
+                {
+                    auto lockedTable = jointNameTable.lockedAccess();
+                    compacted = lockedTable->getId() == table && lockedTable->compact(telemetry, &compact);
+                }
+                if (compacted) {
+                    return sendTelemetry(compact, JOINT_STATE);
+                }
+            }
             return sendTelemetry(telemetry, JOINT_STATE);
         }
 
@@ -370,6 +961,17 @@ class ControlledRobot: public UpdateThread {
             return sendTelemetry(telemetry, SIMPLE_SENSOR_VALUE);
         }
 
+        /**
+         * @brief Set the values of many simple sensors in one message (e.g. of all cells of a battery),
+         * the controller buffers them like single values of setSimpleSensor()
+         *
+         * @param telemetry the sensor values with their ids
+         * @return int number of bytes sent
+         */
+        int setSimpleSensors(const SimpleSensors &telemetry) {
+            return sendTelemetry(telemetry, SIMPLE_SENSOR_VALUES);
+        }
+
         /**
          * @brief Set the Map object, maps are not sent via telemetry, they have to be requsted 
          *  to be sent via the command channel
@@ -406,26 +1008,157 @@ class ControlledRobot: public UpdateThread {
          * @return int 
          */
         int setPointCloud(const robot_remote_control::PointCloud &pointcloud) {
-            return sendTelemetry(pointcloud, POINTCLOUD);
+            PointCloudEncoding encoding = getGovernedPointCloudEncoding();
+            if (encoding.type() == UNENCODED_POINTCLOUD) {
+                return sendTelemetry(pointcloud, POINTCLOUD);
+            }
+            PointCloud encoded = pointcloud;
+            PointCloudCodec::encode(&encoded, encoding);
+            return sendTelemetry(encoded, POINTCLOUD);
         }
 
 
+        /**
+         * @brief send an encoded camera frame owned by the caller (e.g. the output buffer of the encoder), the data is written
+         * into the send buffer of the transport directly, without a copy into the ImageFrame.
+         * The frame is dropped by the rate limits of its camera (see getImageStreamConfig()) and of IMAGE_FRAME.
+         * Frames are not kept for telemetry requests.
+         *
+         * @param frame the metadata (camera_id, encoding, size, timestamp), data() has to be empty
+         * @param data the encoded frame (JPEG or the H.264 NAL units of one frame)
+         * @param size size of data in bytes
+         * @return int number of bytes sent, 0 if dropped
+         */
+        int setImageFrame(const ImageFrame &frame, const char* data, const size_t &size);
+
+        /**
+         * @brief send a camera frame with its data in the message
+         */
+        int setImageFrame(const ImageFrame &frame) {
+            return setImageFrame(frame, nullptr, 0);
+        }
+
+        /**
+         * @brief the stream config of a camera set by the controller (RobotController::setImageStreamConfigs()),
+         * the encoder should apply max_width and max_height.
+         * Use addCommandReceivedCallback() for IMAGE_STREAM_CONFIG to be notified of changes.
+         *
+         * @return false if the controller did not configure the camera
+         */
+        bool getImageStreamConfig(const uint32_t &cameraId, ImageStreamConfig *config);
+
         int setPointCloudMap(const robot_remote_control::PointCloud &pointcloud) {
             robot_remote_control::Map map;
-            map.mutable_map()->PackFrom(pointcloud);
+            PointCloudEncoding encoding = getGovernedPointCloudEncoding();
+            if (encoding.type() == UNENCODED_POINTCLOUD) {
+                map.mutable_map()->PackFrom(pointcloud);
+            } else {
+                PointCloud encoded = pointcloud;
+                PointCloudCodec::encode(&encoded, encoding);
+                map.mutable_map()->PackFrom(encoded);
+            }
             return setMap(map, robot_remote_control::POINTCLOUD_MAP);
         }
 
+        /**
+         * @brief add or replace a tile of a tiled map, controllers only download the tiles changed since their last request
+         * (see RobotController::requestMapTiles())
+         *
+         * @param mapId the id of the map
+         * @param x tile index in x
+         * @param y tile index in y
+         * @param tile the GridMap or PointCloud of the tile area, GridMap tiles of a map need the same size and layers
+         * @return uint64_t the new version of the map
+         */
+        uint64_t setMapTile(const uint32_t &mapId, const int32_t &x, const int32_t &y, const google::protobuf::Message &tile) {
+            return tiledMaps.setTile(mapId, x, y, tile);
+        }
+
+        /**
+         * @brief remove all tiles of a tiled map
+         */
+        void clearMapTiles(const uint32_t &mapId) {
+            tiledMaps.clear(mapId);
+        }
+
+        /**
+         * @brief Set the number of map chunks sent per update() while map transfers are active
+         * (see RobotController::startMapTransfer()), limits the bandwidth used for maps
+         *
+         * @param chunksPerUpdate number of chunks (of usually 64 kB)
+         */
+        void setMapTransferRate(const unsigned int &chunksPerUpdate) {
+            mapChunksPerUpdate.store(chunksPerUpdate);
+        }
+
+        /**
+         * @brief Set the encoding of point clouds and point cloud maps set after this call,
+         * usually selected by the controller using RobotController::setPointCloudEncoding(), in multi-client mode
+         * the controllers select an encoding only if all of them selected the same one
+         *
+         * @param encoding the encoding and resolution to use
+         */
+        void setPointCloudEncoding(const PointCloudEncoding &encoding) {
+            pointCloudEncoding.lockedAccess().set(encoding);
+        }
+
+        PointCloudEncoding getPointCloudEncoding() {
+            return pointCloudEncoding.lockedAccess().get();
+        }
+
+        /**
+         * @brief the encoding used for the next point cloud: getPointCloudEncoding() coarsened by the BandwidthGovernor
+         */
+        PointCloudEncoding getGovernedPointCloudEncoding() {
+            PointCloudEncoding encoding = getPointCloudEncoding();
+            if (encoding.type() != UNENCODED_POINTCLOUD && encoding.resolution() > 0) {
+                encoding.set_resolution(encoding.resolution() * coarsening.load());
+            }
+            return encoding;
+        }
+
         /**
          * @brief Grid map transferredas simplesensor Maps are sent on request, 
-         * 
+         * the layers are encoded as set by setGridMapEncoding()
          */
         int setGridMap(const GridMap &gridmap) {
             robot_remote_control::Map map;
-            map.mutable_map()->PackFrom(gridmap);
+            GridMapEncoding encoding = getGovernedGridMapEncoding();
+            if (encoding.type() == UNENCODED_LAYER) {
+                map.mutable_map()->PackFrom(gridmap);
+            } else {
+                GridMap encoded = gridmap;
+                GridMapLayerCodec::encode(&encoded, encoding);
+                map.mutable_map()->PackFrom(encoded);
+            }
             return setMap(map, robot_remote_control::GRID_MAP);
         }
 
+        /**
+         * @brief Set the encoding of the grid map layers set by setGridMap(), controllers need to decode them
+         * (RobotController::requestGridMap() does)
+         *
+         * @param encoding the encoding, AUTO_LAYER selects the smallest one per layer
+         */
+        void setGridMapEncoding(const GridMapEncoding &encoding) {
+            gridMapEncoding.lockedAccess().set(encoding);
+        }
+
+        GridMapEncoding getGridMapEncoding() {
+            return gridMapEncoding.lockedAccess().get();
+        }
+
+        /**
+         * @brief the encoding used for the next grid map: getGridMapEncoding() coarsened by the BandwidthGovernor
+         */
+        GridMapEncoding getGovernedGridMapEncoding() {
+            GridMapEncoding encoding = getGridMapEncoding();
+            if (encoding.type() != UNENCODED_LAYER && encoding.max_error() > 0) {
+                encoding.set_max_error(encoding.max_error() * coarsening.load());
+            }
+            return encoding;
+        }
+
         /**
          * @brief Set current transforms
          *
@@ -436,18 +1169,127 @@ class ControlledRobot: public UpdateThread {
             return sendTelemetry(telemetry, TRANSFORMS);
         }
 
+        /**
+         * @brief set the transforms that do not change (e.g. of the robot model), they are sent once as STATIC_TRANSFORMS,
+         * controllers connecting later request them (RobotController::requestStaticTransforms())
+         *
+         * @return int number of bytes sent
+         */
+        int setStaticTransforms(const Transforms &telemetry) {
+            return sendTelemetry(telemetry, STATIC_TRANSFORMS);
+        }
+
+        /**
+         * @brief send only the transforms that changed since they were last sent by this function, e.g. the few moving
+         * frames of a large tree (see TransformChangeFilter and setTransformTolerance()).
+         * The controllers keep the unchanged ones in their TransformTree (RobotController::enableTransformTree()).
+         *
+         * @param telemetry all (dynamic) transforms
+         * @return int number of bytes sent, 0 if nothing changed
+         */
+        int setChangedTransforms(const Transforms &telemetry) {
+            Transforms changed;
+            if (!transformChangeFilter.lockedAccess()->filter(telemetry, &changed)) {
+                return 0;
+            }
+            return sendTelemetry(changed, TRANSFORMS);
+        }
+
+        /**
+         * @brief changes below the tolerances are not sent by setChangedTransforms() (default 0, all changes are sent)
+         *
+         * @param positionTolerance distance
+         * @param angleTolerance angle in radians
+         */
+        void setTransformTolerance(const double &positionTolerance, const double &angleTolerance) {
+            transformChangeFilter.lockedAccess()->setTolerance(positionTolerance, angleTolerance);
+        }
+
+        /**
+         * @brief send all transforms with the next setChangedTransforms() (e.g. after a controller connected)
+         */
+        void resendAllTransforms() {
+            transformChangeFilter.lockedAccess()->reset();
+        }
+
     protected:
         virtual ControlMessageType receiveRequest();
 
-        virtual ControlMessageType evaluateRequest(const std::string& request);
+        ControlMessageType receiveRequest(const TransportSharedPtr &transport, ReceiveBuffer *buffer);
+
+        /**
+         * @brief receive and evaluate one streamed command, if it is newer than the last one of its type
+         *
+         * @return false if there was nothing to receive
+         */
+        bool receiveStreamedCommand();
+
+        /**
+         * @brief evaluate a request (type header + payload) and send the reply
+         *
+         * @param request view on the request, it is parsed directly from this memory
+         * @return ControlMessageType the type of the request
+         */
+        virtual ControlMessageType evaluateRequest(const MessageView& request);
+
+        /**
+         * @brief send the reply to the request currently evaluated, if the request had a request id
+         * (see REQUEST_ID_FLAG) it is put in front of the reply. Streamed commands get no reply
+         *
+         * @param reply the reply
+         * @return int number of bytes sent
+         */
+        int sendReply(const MessageView& reply);
+
+        /**
+         * @brief send a reply consisting only of a type (e.g. the acknowledgement of a command), without allocation
+         */
+        int sendReply(const ControlMessageType &type);
+
+        // reused for each request, so the transport can hand out its own memory
+        ReceiveBuffer commandReceiveBuffer;
+
+        // request id of the request currently evaluated
+        bool replyWithRequestId;
+        uint32_t replyRequestId;
+
+        // see setMultiClient()
+        bool multiClient;
+        ClientSessions clientSessions;
+        // the peer of the request currently evaluated
+        std::string requestPeer;
+        std::vector< std::function<void(const std::string &peer, const bool &connected)> > clientSessionCallbacks;
+        void notifyClientSession(const std::string &peer, const bool &connected);
+        // commands the robot, arbitrated in multi-client mode
+        bool isCommand(const uint16_t &type) {
+            return type != HEARTBEAT && (type == ROBOT_TRAJECTORY_UPDATE || getCommandBuffer(type));
+        }
+
+        // a reply of a request evaluated by the deferredRequests worker, sent by update()
+        struct DeferredReply {
+            Transport *transport;
+            std::string peer;
+            bool withRequestId;
+            uint32_t requestId;
+            std::string reply;
+        };
+        std::mutex deferredRepliesMutex;
+        std::deque<DeferredReply> deferredReplies;
+        void sendDeferredReplies();
+        /**
+         * @brief evaluate a request in the deferredRequests worker, answer() writes the reply
+         */
+        void deferRequest(const std::function<void(std::string *reply)> &answer);
 
         void notifyCommandCallbacks(const uint16_t &type);
 
         struct CommandBufferBase{
-            CommandBufferBase() {}
+            CommandBufferBase():reuseMemory(false) {}
             virtual ~CommandBufferBase() {}
-            virtual bool write(const std::string &serializedMessage) = 0;
+            virtual bool write(const MessageView &serializedMessage) = 0;
             virtual bool read(std::string *receivedMessage) = 0;
+            // a command was written since the last read
+            virtual bool isNew() = 0;
             void notify() {
                 auto callCb = [](const std::function<void()> &cb){cb();};
                 std::for_each(callbacks.begin(), callbacks.end(), callCb);
@@ -456,48 +1298,205 @@ class ControlledRobot: public UpdateThread {
             void addCommandReceivedCallback(const std::function<void()> &cb) {
                 callbacks.push_back(cb);
             }
+
+            /**
+             * @brief keep the memory of the command fields when a new command is written, so writing does not
+             * allocate once the fields were big enough. Sub-messages stay set (but empty) when a new command does not have them.
+             */
+            void setReuseMemory(const bool &reuse) {
+                reuseMemory.store(reuse);
+            }
+
+            bool reusesMemory() {
+                return reuseMemory.load();
+            }
+
+            /**
+             * @brief parse a message, keeping the memory of its fields (see clearKeepingMemory())
+             */
+            static bool parseKeepingMemory(const MessageView &serializedMessage, google::protobuf::Message *message) {
+                clearKeepingMemory(message);
+                google::protobuf::io::CodedInputStream input(reinterpret_cast<const uint8_t*>(serializedMessage.data), serializedMessage.size);
+                return message->MergeFromCodedStream(&input) && input.ConsumedEntireMessage();
+            }
+
+            /**
+             * @brief clear a message but keep the memory of its fields. Clear() would delete set sub-messages,
+             * nested messages in repeated fields are still cleared by Clear() of the repeated field
+             */
+            static void clearKeepingMemory(google::protobuf::Message *message) {
+                const google::protobuf::Reflection *reflection = message->GetReflection();
+                const google::protobuf::Descriptor *descriptor = message->GetDescriptor();
+                for (int i = 0; i < descriptor->field_count(); ++i) {
+                    const google::protobuf::FieldDescriptor *field = descriptor->field(i);
+                    if (field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE && !field->is_repeated()) {
+                        if (reflection->HasField(*message, field)) {
+                            clearKeepingMemory(reflection->MutableMessage(message, field));
+                        }
+                    } else {
+                        reflection->ClearField(message, field);
+                    }
+                }
+                if (!reflection->GetUnknownFields(*message).empty()) {
+                    reflection->MutableUnknownFields(message)->Clear();
+                }
+            }
+
+         protected:
+            std::atomic<bool> reuseMemory;
         };
 
+        /**
+         * @brief latest-value buffer of a command type, written by the update thread. Reading is wait-free (see TripleBuffer),
+         * so a getter (e.g. getTwistCommand()) can be polled by a control loop without waiting for a command being received.
+         * @warning each buffer has to be read from one thread only
+         */
         template<class COMMAND> struct CommandBuffer: public CommandBufferBase{
             public:
-                CommandBuffer():isnew(false) {}
+                CommandBuffer() {}
 
                 virtual ~CommandBuffer() {}
 
                 bool read(COMMAND *target) {
-                    bool oldval = isnew.load();
-                    *target = command.lockedAccess().get();
-                    isnew.store(false);
-                    return oldval;
+                    bool isnew = command.fetch();
+                    *target = command.get();
+                    return isnew;
                 }
 
                 void write(const COMMAND &src) {
-                    command.lockedAccess().set(src);
+                    command.write([&](COMMAND *slot) {
+                        if (reuseMemory.load()) {
+                            clearKeepingMemory(slot);
+                            slot->MergeFrom(src);
+                        } else {
+                            *slot = src;
+                        }
+                        return true;
+                    });
+                    notify();
+                }
+
+                /**
+                 * @brief a message that can not be parsed is dropped, the last command stays
+                 */
+                virtual bool write(const MessageView &serializedMessage) {
+                    bool parsed = command.write([&](COMMAND *slot) {
+                        if (reuseMemory.load()) {
+                            return parseKeepingMemory(serializedMessage, slot);
+                        }
+                        return slot->ParseFromArray(serializedMessage.data, serializedMessage.size);
+                    });
+                    if (!parsed) {
+                        return false;
+                    }
+                    notify();
+                    return true;
+                }
+
+                virtual bool read(std::string *receivedMessage) {
+                    bool isnew = command.fetch();
+                    command.get().SerializeToString(receivedMessage);
+                    return isnew;
+                }
+
+                virtual bool isNew() {
+                    return command.hasNew();
+                }
+
+            private:
+                TripleBuffer<COMMAND> command;
+        };
+
+        /**
+         * @brief buffer of the ROBOT_TRAJECTORY_COMMAND, which is also edited in place by ROBOT_TRAJECTORY_UPDATE.
+         * Locked instead of a TripleBuffer, each edit needs the current trajectory.
+         */
+        struct TrajectoryBuffer: public CommandBufferBase{
+            public:
+                TrajectoryBuffer():isnew(false) {}
+
+                virtual ~TrajectoryBuffer() {}
+
+                bool read(Poses *target) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    *target = trajectory;
+                    return isnew.exchange(false);
+                }
+
+                /**
+                 * @brief replace the trajectory, a message that can not be parsed is dropped
+                 */
+                virtual bool write(const MessageView &serializedMessage) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    // parsed aside, swapping keeps the memory of both
+                    bool parsed = reuseMemory.load() ? parseKeepingMemory(serializedMessage, &received)
+                                                     : received.ParseFromArray(serializedMessage.data, serializedMessage.size);
+                    if (!parsed) {
+                        return false;
+                    }
+                    trajectory.Swap(&received);
                     isnew.store(true);
+                    notifyChanged(0, trajectory.poses_size());
                     notify();
+                    return true;
                 }
 
-                virtual bool write(const std::string &serializedMessage) {
-                    // command.lock();
-                    if (!command.lockedAccess()->ParseFromString(serializedMessage)) {
-                        isnew.store(false);
+                /**
+                 * @brief edit the trajectory
+                 *
+                 * @return false if the update starts behind the end of the trajectory, it is not applied then
+                 */
+                bool apply(const TrajectoryUpdate &update) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto *poses = trajectory.mutable_poses();
+                    const uint32_t size = poses->size();
+                    const uint32_t start = update.append() ? size : update.start_index();
+                    if (start > size) {
                         return false;
                     }
+                    const uint32_t count = update.poses_size();
+                    for (uint32_t i = 0; i < count; ++i) {
+                        if (start + i < size) {
+                            *poses->Mutable(start + i) = update.poses(i);
+                        } else {
+                            *poses->Add() = update.poses(i);
+                        }
+                    }
+                    if (update.truncate() && start + count < size) {
+                        poses->DeleteSubrange(start + count, size - start - count);
+                    }
                     isnew.store(true);
+                    notifyChanged(start, count);
                     notify();
                     return true;
                 }
 
                 virtual bool read(std::string *receivedMessage) {
-                    bool oldval = isnew.load();
-                    command.lockedAccess()->SerializeToString(receivedMessage);
-                    isnew.store(false);
-                    return oldval;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    trajectory.SerializeToString(receivedMessage);
+                    return isnew.exchange(false);
+                }
+
+                virtual bool isNew() {
+                    return isnew.load();
+                }
+
+                void addChangedCallback(const std::function<void(const Poses &trajectory, const uint32_t &start, const uint32_t &count)> &cb) {
+                    changedCallbacks.push_back(cb);
                 }
 
             private:
-                LockableClass<COMMAND> command;
+                void notifyChanged(const uint32_t &start, const uint32_t &count) {
+                    for (const auto &cb : changedCallbacks) {
+                        cb(trajectory, start, count);
+                    }
+                }
+
+                std::mutex mutex;
+                Poses trajectory;
+                Poses received;
                 std::atomic<bool> isnew;
+                std::vector< std::function<void(const Poses &trajectory, const uint32_t &start, const uint32_t &count)> > changedCallbacks;
         };
 
         // command buffers
@@ -509,21 +1508,58 @@ class ControlledRobot: public UpdateThread {
         CommandBuffer<JointCommand> jointsCommand;
         CommandBuffer<HeartBeat> heartbeatCommand;
         CommandBuffer<Permission> permissionCommand;
-        CommandBuffer<Poses> robotTrajectoryCommand;
+        TrajectoryBuffer robotTrajectoryCommand;
+        // joint commands are expanded (see JointNameTable) before they are written to jointsCommand
+        JointCommand receivedJointsCommand;
 
         std::vector< std::function<void(const uint16_t &type)> > commandCallbacks;
+        std::shared_ptr<CallbackExecutor> callbackExecutor;
+        // notified with the command callbacks, see waitForCommand()
+        DataSignal commandSignal;
 
         HeartBeat heartbeatValues;
         Timer heartbeatTimer;
         float heartbeatAllowedLatency;
         std::function<void(const float&)> heartbeatExpiredCallback;
         std::atomic<bool> connected;
+        // the clock of getTime(), in the heartbeat replies for the clock offset estimation of the controller
+        static int64_t realtimeNs();
 
         SimpleBuffer<std::string> mapBuffer;
 
-        std::map<uint32_t, CommandBufferBase*> commandbuffers;
-        void registerCommandType(const uint32_t & ID, CommandBufferBase *bufptr) {
+        // indexed by the ControlMessageType, nullptr for types without a buffer
+        std::vector<CommandBufferBase*> commandbuffers;
+
+        /**
+         * @brief register the buffer of a command type, received commands of the type are written into it
+         * and the callbacks of the type are called (see addCommandReceivedCallback()).
+         * Extended command types (e.g. ExtendedControlledRobot::newControlMessageCommand in examples/extending)
+         * are registered the same way in the constructor of the derived class.
+         * @warning has to be called before the update thread is started
+         *
+         * @param ID the ControlMessageType, the table grows for extended types
+         * @param bufptr the buffer, not owned, nullptr removes the type
+         * @return false if the ID collides with the REQUEST_ID_FLAG
+         */
+        bool registerCommandType(const uint16_t &ID, CommandBufferBase *bufptr) {
+            if (ID & REQUEST_ID_FLAG) {
+                printf("command type %i can not be registered, it collides with the request id flag\n", ID);
+                return false;
+            }
+            if (ID >= commandbuffers.size()) {
+                commandbuffers.resize(ID + 1, nullptr);
+            }
             commandbuffers[ID] = bufptr;
+            return true;
+        }
+
+        /**
+         * @brief the buffer of a command type
+         *
+         * @return CommandBufferBase* nullptr for unknown types
+         */
+        CommandBufferBase* getCommandBuffer(const uint16_t &type) const {
+            return type < commandbuffers.size() ? commandbuffers[type] : nullptr;
         }
 
         void addControlMessageType(std::string *buf, const ControlMessageType& type);
@@ -531,26 +1567,113 @@ class ControlledRobot: public UpdateThread {
 
         TransportSharedPtr commandTransport;
         TransportSharedPtr telemetryTransport;
+        // optional lane for real-time commands, see setControlTransport()
+        TransportSharedPtr controlTransport;
+        ReceiveBuffer controlReceiveBuffer;
+        // the transport of the request currently evaluated
+        Transport* replyTransport;
+        // optional stream of commands without replies, see setCommandStreamTransport()
+        TransportSharedPtr commandStreamTransport;
+        ReceiveBuffer commandStreamReceiveBuffer;
+        struct CommandStream {
+            CommandStream():lastUse(0) {}
+            // the sequence number of the last streamed command per type
+            std::map<uint16_t, uint32_t> sequences;
+            uint64_t lastUse;
+        };
+        // per stream id of the controllers, the least recently used ones are removed
+        std::map<uint32_t, CommandStream> commandStreams;
+        uint64_t streamedCommands;
+        static const size_t maxCommandStreams = 16;
+        std::atomic<uint64_t> droppedStreamedCommands;
+        // a request with a reply was received in this update(), it counts as heartbeat
+        bool requestsReceived;
 
         std::string serializeControlMessageType(const ControlMessageType& type);
         // std::string serializeCurrentPose();
 
         template <class PROTO> void registerTelemetryType(const uint16_t &type) {
-            buffers->registerType<PROTO>(type, 1);
-            #ifdef RRC_STATISTICS
-                PROTO telemetry_type;
-                statistics.names[type] = telemetry_type.GetTypeName();
-            #endif
+            statistics.names[type] = PROTO::descriptor()->full_name();
         }
-        // buffer of sent telemetry (used for telemetry requests)
-        std::shared_ptr<TelemetryBuffer> buffers;
+
+        /**
+         * @brief registerTelemetryType() of a type with TelemetryTraits, e.g. an extension type
+         */
+        template <uint16_t TYPE> void registerTelemetryType() {
+            registerTelemetryType<typename TelemetryTraits<TYPE>::type>(TYPE);
+        }
+
+        // registers the TelemetryTypes in the constructor
+        struct DefaultTelemetryRegistrar {
+            ControlledRobot *robot;
+            template <uint16_t TYPE> void visit() {
+                robot->registerTelemetryType<TYPE>();
+            }
+        };
+        // latest sent telemetry (used for telemetry requests)
+        TelemetryCache latestTelemetry;
 
         uint32_t logLevel;
+        // see setLogBatching()
+        LogBatcher logBatcher;
+        std::atomic<bool> logBatching;
+        // false if a controller without LOG_MESSAGES support negotiated (older controllers do not negotiate),
+        // in multi-client mode while a session did not negotiate it
+        std::atomic<bool> controllerSplitsLogs;
+        // log messages that passed the log level
+        int sendLogMessage(const LogMessage &message);
 
         std::map<std::string, std::promise<bool> > pendingPermissionRequests;
 
-        Statistics statistics;
+        LockableClass<PointCloudEncoding> pointCloudEncoding;
+
+        struct ImageStream {
+            ImageStreamConfig config;
+            RateLimit limit;
+        };
+        std::mutex imageStreamMutex;
+        std::map<uint32_t, ImageStream> imageStreams;
+        void setImageStreamConfigs(const ImageStreamConfigs &configs);
+        bool imageStreamAllowsSend(const uint32_t &cameraId);
+        LockableClass<GridMapEncoding> gridMapEncoding;
+
+        // names of the controllable joints, to expand compact joint commands
+        LockableClass<JointNameTable> jointNameTable;
+        // the transforms last sent by setChangedTransforms()
+        LockableClass<TransformChangeFilter> transformChangeFilter;
+        // table agreed on by the controller, 0 to send names
+        std::atomic<uint64_t> compactJointTable;
+
+        TiledMapStore tiledMaps;
 
+        /**
+         * @brief send the next chunks of the active map transfers on the telemetry channel
+         */
+        void sendMapChunks();
+
+        bool getMap(const uint32_t &mapId, std::string *map);
+
+        MapTransferSender mapTransfers;
+        std::atomic<unsigned int> mapChunksPerUpdate;
+        // reused for all chunks
+        MapChunk mapChunk;
+
+        Statistics statistics;
+        std::mutex statisticsTaskMutex;
+        Scheduler::TaskId statisticsTask;
+
+        BandwidthGovernor bandwidthGovernor;
+        std::mutex governorTaskMutex;
+        Scheduler::TaskId governorTask;
+        // time since the last governBandwidth()
+        Timer governorTimer;
+        std::mutex governorMutex;
+        std::atomic<float> coarsening;
+        std::atomic<float> maxCoarsening;
+        void applyBandwidthDecision(const BandwidthGovernor::Decision &decision);
+
+        // evaluates slow requests in multi-client mode, declared last, so it is stopped before the members it uses are destroyed
+        std::shared_ptr<CallbackExecutor> deferredRequests;
 };
 
 }  // namespace robot_remote_control
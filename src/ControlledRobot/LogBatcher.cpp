@@ -0,0 +1,121 @@
+#include "LogBatcher.hpp"
+
+#include <algorithm>
+
+namespace robot_remote_control {
+
+LogBatcher::LogBatcher(const Options &options):options(options), hasPending(false) {}
+
+void LogBatcher::setOptions(const Options &newOptions) {
+    std::lock_guard<std::mutex> lock(mutex);
+    options = newOptions;
+    // the buckets start full again with the new limits
+    for (auto &bucket : buckets) {
+        bucket.second.initialized = false;
+    }
+}
+
+LogBatcher::Options LogBatcher::getOptions() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return options;
+}
+
+bool LogBatcher::allow(const uint32_t &level, const Clock::time_point &now) {
+    auto limit = options.rateLimits.find(level);
+    if (limit == options.rateLimits.end() || limit->second.messagesPerSecond <= 0) {
+        return true;
+    }
+    Bucket &bucket = buckets[level];
+    const double burst = std::max(1.0f, limit->second.burst);
+    if (!bucket.initialized) {
+        bucket.tokens = burst;
+        bucket.initialized = true;
+    } else {
+        const double elapsed = std::chrono::duration<double>(now - bucket.refilled).count();
+        bucket.tokens = std::min(burst, bucket.tokens + elapsed * limit->second.messagesPerSecond);
+    }
+    bucket.refilled = now;
+    if (bucket.tokens < 1) {
+        bucket.dropped++;
+        return false;
+    }
+    bucket.tokens -= 1;
+    return true;
+}
+
+void LogBatcher::markPending(const Clock::time_point &now) {
+    if (!hasPending) {
+        hasPending = true;
+        pendingSince = now;
+    }
+}
+
+LogBatcher::Result LogBatcher::add(const LogMessage &message) {
+    const Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    statistics.added++;
+    if (!allow(message.level(), now)) {
+        statistics.rateLimited++;
+        // reported by the next batch
+        markPending(now);
+        return DROPPED;
+    }
+    if (!options.intervalMs) {
+        return SEND;
+    }
+    markPending(now);
+
+    if (options.deduplicate) {
+        auto entry = entries.find(std::make_pair(message.level(), message.message()));
+        if (entry != entries.end()) {
+            LogMessage* merged = pending.mutable_messages(entry->second);
+            merged->set_count(std::max(1u, merged->count()) + 1);
+            *merged->mutable_last_timestamp() = message.timestamp();
+            statistics.merged++;
+            return BATCHED;
+        }
+        entries[std::make_pair(message.level(), message.message())] = pending.messages_size();
+    }
+    *pending.add_messages() = message;
+    return static_cast<size_t>(pending.messages_size()) >= options.maxEntries ? FULL : BATCHED;
+}
+
+bool LogBatcher::isDue() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!hasPending) {
+        return false;
+    }
+    // without batching the rate limited messages are reported once per second
+    const unsigned int interval = options.intervalMs ? options.intervalMs : 1000;
+    return Clock::now() - pendingSince >= std::chrono::milliseconds(interval);
+}
+
+bool LogBatcher::take(LogMessages *batch) {
+    std::lock_guard<std::mutex> lock(mutex);
+    batch->Clear();
+    batch->mutable_messages()->Swap(pending.mutable_messages());
+    entries.clear();
+    hasPending = false;
+
+    for (auto &bucket : buckets) {
+        if (bucket.second.dropped) {
+            LogMessage* report = batch->add_messages();
+            report->set_level(WARN);
+            report->set_message(std::to_string(bucket.second.dropped) + " log messages of level " + std::to_string(bucket.first)
+                                + " dropped by the rate limit");
+            bucket.second.dropped = 0;
+        }
+    }
+    if (batch->messages_size() == 0) {
+        return false;
+    }
+    statistics.batches++;
+    return true;
+}
+
+LogBatcher::Statistics LogBatcher::getStatistics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statistics;
+}
+
+}  // namespace robot_remote_control
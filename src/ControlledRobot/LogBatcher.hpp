@@ -0,0 +1,123 @@
+#pragma once
+
+#include "MessageTypes.hpp"
+#include "UpdateThread/Clock.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace robot_remote_control {
+
+/**
+ * @brief collects the log messages of the robot into LogMessages batches, see ControlledRobot::setLogBatching().
+ *
+ * A batch is sent when its oldest entry waited Options::intervalMs or when it has Options::maxEntries entries.
+ * Repetitions of a message (same level and text) within a batch are merged into one entry with a count.
+ * Each level can be limited by a token bucket (Options::limit()), the dropped messages are reported by a WARN entry
+ * in the next batch, so a burst of logs (e.g. during a fault cascade) does not saturate the link.
+ */
+class LogBatcher {
+ public:
+    struct RateLimit {
+        explicit RateLimit(const float &messagesPerSecond = 0, const float &burst = 10):messagesPerSecond(messagesPerSecond), burst(burst) {}
+        // 0 is unlimited
+        float messagesPerSecond;
+        // messages allowed at once after an idle period
+        float burst;
+    };
+
+    struct Options {
+        Options():intervalMs(200), maxEntries(100), deduplicate(true) {}
+        // maximum delay of a message, 0 disables batching (the messages are sent one by one, only the rate limits apply then)
+        unsigned int intervalMs;
+        // entries (after merging) that trigger the send of a batch
+        size_t maxEntries;
+        // merge repetitions within a batch
+        bool deduplicate;
+        // the token buckets by LogLevel, levels without limit are not limited
+        std::map<uint32_t, RateLimit> rateLimits;
+
+        /**
+         * @brief limit a level, e.g. Options().limit(DEBUG, 10).limit(INFO, 50, 100)
+         */
+        Options &limit(const uint32_t &level, const float &messagesPerSecond, const float &burst = 10) {
+            rateLimits[level] = RateLimit(messagesPerSecond, burst);
+            return *this;
+        }
+    };
+
+    struct Statistics {
+        Statistics():added(0), merged(0), rateLimited(0), batches(0) {}
+        // messages passed to add()
+        uint64_t added;
+        // repetitions merged into a previous entry
+        uint64_t merged;
+        // messages dropped by the rate limits
+        uint64_t rateLimited;
+        // batches taken with take()
+        uint64_t batches;
+    };
+
+    enum Result {
+        DROPPED,  // rate limited
+        SEND,     // not batched (Options::intervalMs is 0), the caller sends the message
+        BATCHED,  // added to the batch
+        FULL      // added, the batch has maxEntries entries and should be taken now
+    };
+
+    explicit LogBatcher(const Options &options = Options());
+
+    /**
+     * @brief replace the options, the pending batch is kept
+     */
+    void setOptions(const Options &options);
+
+    Options getOptions();
+
+    Result add(const LogMessage &message);
+
+    /**
+     * @brief true if the pending batch (or the report of rate limited messages without batching) waited long enough
+     */
+    bool isDue();
+
+    /**
+     * @brief move the pending entries to the batch, with a WARN entry per level with rate limited messages
+     *
+     * @return false if there was nothing to send
+     */
+    bool take(LogMessages *batch);
+
+    Statistics getStatistics();
+
+ private:
+    struct Bucket {
+        Bucket():tokens(0), initialized(false), dropped(0) {}
+        double tokens;
+        Clock::time_point refilled;
+        bool initialized;
+        // since the last take()
+        uint64_t dropped;
+    };
+
+    // takes a token of the level, false if there is none
+    bool allow(const uint32_t &level, const Clock::time_point &now);
+    void markPending(const Clock::time_point &now);
+
+    std::mutex mutex;
+    Options options;
+    Statistics statistics;
+    std::map<uint32_t, Bucket> buckets;
+
+    LogMessages pending;
+    // the entry of a (level, message) in pending
+    std::map<std::pair<uint32_t, std::string>, int> entries;
+    bool hasPending;
+    Clock::time_point pendingSince;
+};
+
+}  // namespace robot_remote_control
@@ -0,0 +1,231 @@
+#include "TelemetrySendQueue.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace robot_remote_control {
+
+namespace {
+    // bytes a class of weight 1 may send per round (at least one chunk)
+    const size_t minQuantum = 16384;
+}
+
+TelemetrySendQueue::TelemetrySendQueue(const Sender &sender, const size_t &defaultDepth):
+    sender(sender),
+    defaultDepth(defaultDepth),
+    queues(TELEMETRY_MESSAGE_TYPES_NUMBER),
+    classes(BULK + 1),
+    currentClass(0),
+    chunkSize(0),
+    nextMessageId(0),
+    queued(0),
+    sending(false),
+    running(false) {
+    classes[HIGH].weight = 16;
+    classes[NORMAL].weight = 4;
+    classes[BULK].weight = 1;
+}
+
+TelemetrySendQueue::~TelemetrySendQueue() {
+    stop();
+}
+
+TelemetrySendQueue::TypeQueue& TelemetrySendQueue::typeQueue(const uint16_t &type) {
+    if (type >= queues.size()) {
+        queues.resize(type + 1);
+    }
+    return queues[type];
+}
+
+TelemetrySendQueue::ClassQueue& TelemetrySendQueue::classQueue(const uint8_t &priorityClass) {
+    if (priorityClass >= classes.size()) {
+        classes.resize(priorityClass + 1);
+    }
+    return classes[priorityClass];
+}
+
+void TelemetrySendQueue::setPolicy(const uint16_t &type, const Policy &policy, const size_t &depth) {
+    std::lock_guard<std::mutex> lock(mutex);
+    TypeQueue &queue = typeQueue(type);
+    queue.policy = policy;
+    queue.depth = depth;
+}
+
+void TelemetrySendQueue::setDefaultDepth(const size_t &depth) {
+    std::lock_guard<std::mutex> lock(mutex);
+    defaultDepth = depth;
+}
+
+void TelemetrySendQueue::setPriorityClass(const uint16_t &type, const uint8_t &priorityClass) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // the messages queued already are sent in their previous class
+    typeQueue(type).priorityClass = priorityClass;
+    classQueue(priorityClass);
+}
+
+void TelemetrySendQueue::setClassWeight(const uint8_t &priorityClass, const unsigned int &weight) {
+    std::lock_guard<std::mutex> lock(mutex);
+    classQueue(priorityClass).weight = std::max(1u, weight);
+}
+
+void TelemetrySendQueue::setChunkSize(const size_t &bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    chunkSize = bytes;
+}
+
+void TelemetrySendQueue::push(const uint16_t &type, const TelemetryCache::Payload &payload) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        TypeQueue &queue = typeQueue(type);
+        statistics.queued++;
+        if (queue.policy == COALESCE && !queue.messages.empty()) {
+            // keeps its entry in the send order
+            queue.messages.back() = payload;
+            statistics.coalesced++;
+            return;
+        }
+        const size_t depth = queue.depth ? queue.depth : defaultDepth;
+        if (queue.policy == DROP_OLDEST && depth && queue.messages.size() >= depth) {
+            // the newer message takes over the entry of the dropped one, so the order does not grow
+            queue.messages.pop_front();
+            queue.messages.push_back(payload);
+            statistics.dropped++;
+            return;
+        }
+        queue.messages.push_back(payload);
+        classes[queue.priorityClass].order.push_back(type);
+        queued++;
+    }
+    pushed.notify_one();
+}
+
+void TelemetrySendQueue::start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    senderThread = std::thread(&TelemetrySendQueue::run, this);
+}
+
+void TelemetrySendQueue::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    {
+        // so the sender thread cannot miss the notification between its check and the wait
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    pushed.notify_all();
+    if (senderThread.joinable()) {
+        senderThread.join();
+    }
+}
+
+bool TelemetrySendQueue::flush(const unsigned int &timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return drained.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !hasWork() && !sending; });
+}
+
+size_t TelemetrySendQueue::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queued;
+}
+
+TelemetrySendQueue::Statistics TelemetrySendQueue::getStatistics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statistics;
+}
+
+bool TelemetrySendQueue::hasWork() const {
+    for (const ClassQueue &queue : classes) {
+        if (queue.hasWork()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t TelemetrySendQueue::nextChunkSize(const ClassQueue &queue) {
+    size_t remaining;
+    if (queue.inFlight.payload) {
+        remaining = queue.inFlight.payload->size() - queue.inFlight.offset;
+    } else {
+        remaining = queues[queue.order.front()].messages.front()->size();
+    }
+    return chunkSize ? std::min(chunkSize, remaining) : remaining;
+}
+
+void TelemetrySendQueue::nextChunk(ClassQueue *queue, Chunk *chunk) {
+    if (!queue->inFlight.payload) {
+        const uint16_t type = queue->order.front();
+        queue->order.pop_front();
+        queued--;
+        TypeQueue &messages = queues[type];
+        chunk->type = type;
+        chunk->payload = std::move(messages.messages.front());
+        messages.messages.pop_front();
+        chunk->offset = 0;
+        chunk->size = chunk->payload->size();
+        if (!chunkSize || chunk->size <= chunkSize) {
+            return;
+        }
+        // sent in chunks over the next rounds of the class
+        chunk->messageId = nextMessageId++;
+        queue->inFlight = *chunk;
+    }
+    *chunk = queue->inFlight;
+    chunk->size = std::min(chunkSize ? chunkSize : chunk->payload->size(), chunk->payload->size() - chunk->offset);
+    queue->inFlight.offset += chunk->size;
+    if (queue->inFlight.offset >= queue->inFlight.payload->size()) {
+        queue->inFlight = Chunk();
+    }
+}
+
+void TelemetrySendQueue::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    // deficit round robin: each class gets weight * quantum bytes per round, a message is sent when the class saved enough
+    bool turnStarted = false;
+    auto endTurn = [&]() {
+        turnStarted = false;
+        currentClass = (currentClass + 1) % classes.size();
+    };
+    while (running) {
+        pushed.wait(lock, [this] { return hasWork() || !running; });
+        if (!running) {
+            break;
+        }
+        ClassQueue &queue = classes[currentClass];
+        if (!queue.hasWork()) {
+            queue.deficit = 0;
+            endTurn();
+            continue;
+        }
+        const size_t size = nextChunkSize(queue);
+        if (!turnStarted) {
+            queue.deficit += static_cast<int64_t>(queue.weight) * std::max(chunkSize, minQuantum);
+            turnStarted = true;
+        }
+        if (queue.deficit < static_cast<int64_t>(size)) {
+            endTurn();
+            continue;
+        }
+        Chunk chunk;
+        nextChunk(&queue, &chunk);
+        queue.deficit -= chunk.size;
+        sending = true;
+        // the transport may block, the callers keep pushing meanwhile
+        lock.unlock();
+        sender(chunk);
+        const bool last = chunk.offset + chunk.size == chunk.payload->size();
+        chunk.payload.reset();
+        lock.lock();
+        sending = false;
+        if (last) {
+            statistics.sent++;
+        }
+        if (!hasWork()) {
+            drained.notify_all();
+        }
+    }
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "TelemetryCache.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief bounded queues of serialized telemetry by type, drained by a sender thread, see ControlledRobot::setAsyncTelemetry().
+ *
+ * push() only takes a reference to the payload of the TelemetryCache, so the caller (e.g. the control loop calling setCurrentPose())
+ * returns in constant time, also when the transport blocks on a slow link. A full queue of a type drops by its policy.
+ *
+ * Each type belongs to a priority class, the classes share the link by weighted fair queueing (deficit round robin in bytes),
+ * within a class the messages are sent in the order they were pushed. Messages above the chunk size are sent in chunks
+ * (TELEMETRY_CHUNK), so a big message (e.g. a point cloud) of a low class is interleaved with the messages of the higher classes
+ * instead of delaying them until it is sent completely.
+ */
+class TelemetrySendQueue {
+ public:
+    enum Policy {
+        DROP_OLDEST,  // keep the newest depth messages of the type (e.g. state)
+        NEVER_DROP,   // keep all messages (e.g. LOG_MESSAGE, PERMISSION_REQUEST)
+        COALESCE      // keep only the latest message, at the position of the oldest queued one
+    };
+
+    struct Statistics {
+        Statistics():queued(0), sent(0), dropped(0), coalesced(0) {}
+        uint64_t queued;
+        uint64_t sent;
+        // removed by DROP_OLDEST
+        uint64_t dropped;
+        // replaced by COALESCE
+        uint64_t coalesced;
+    };
+
+    // the default classes, more can be added by setClassWeight()
+    enum PriorityClass : uint8_t {HIGH = 0, NORMAL, BULK};
+
+    /**
+     * @brief a message or a part of it
+     */
+    struct Chunk {
+        Chunk():type(0), messageId(0), offset(0), size(0) {}
+        uint16_t type;
+        TelemetryCache::Payload payload;
+        // same for all chunks of a message
+        uint32_t messageId;
+        size_t offset;
+        size_t size;
+
+        bool isComplete() const {
+            return offset == 0 && size == payload->size();
+        }
+    };
+
+    typedef std::function<void(const Chunk &chunk)> Sender;
+
+    /**
+     * @param sender called by the sender thread for each message or chunk
+     * @param defaultDepth depth of the DROP_OLDEST queues of types without their own depth
+     */
+    explicit TelemetrySendQueue(const Sender &sender, const size_t &defaultDepth = 8);
+
+    ~TelemetrySendQueue();
+
+    /**
+     * @brief the policy of a type, DROP_OLDEST with the default depth if not set
+     *
+     * @param depth queue size for DROP_OLDEST, 0 uses the default depth
+     */
+    void setPolicy(const uint16_t &type, const Policy &policy, const size_t &depth = 0);
+
+    void setDefaultDepth(const size_t &depth);
+
+    /**
+     * @brief the priority class of a type, NORMAL if not set
+     */
+    void setPriorityClass(const uint16_t &type, const uint8_t &priorityClass);
+
+    /**
+     * @brief the share of a class while several classes have messages queued, a class with weight 4 sends 4 times
+     * the bytes of a class with weight 1 (the defaults are HIGH 16, NORMAL 4, BULK 1)
+     */
+    void setClassWeight(const uint8_t &priorityClass, const unsigned int &weight);
+
+    /**
+     * @brief messages above this size are sent in chunks of this size, 0 (the default) sends all messages complete
+     * @warning the controller needs to support TELEMETRY_CHUNK
+     */
+    void setChunkSize(const size_t &bytes);
+
+    /**
+     * @brief queue a message, the sender thread has to be started for it to be sent
+     */
+    void push(const uint16_t &type, const TelemetryCache::Payload &payload);
+
+    void start();
+
+    /**
+     * @brief stop the sender thread, the queued messages stay queued
+     */
+    void stop();
+
+    bool isRunning() const {
+        return running;
+    }
+
+    /**
+     * @brief wait until all queued messages were sent
+     *
+     * @return false if they were not sent within timeoutMs
+     */
+    bool flush(const unsigned int &timeoutMs);
+
+    size_t size();
+
+    Statistics getStatistics();
+
+ private:
+    struct TypeQueue {
+        TypeQueue():policy(DROP_OLDEST), depth(0), priorityClass(NORMAL) {}
+        Policy policy;
+        // 0 for the default depth
+        size_t depth;
+        uint8_t priorityClass;
+        std::deque<TelemetryCache::Payload> messages;
+    };
+
+    struct ClassQueue {
+        ClassQueue():weight(1), deficit(0) {}
+        unsigned int weight;
+        // one entry per queued message
+        std::deque<uint16_t> order;
+        // the message being sent in chunks, if any
+        Chunk inFlight;
+        // bytes the class may send in the current round
+        int64_t deficit;
+
+        bool hasWork() const {
+            return !order.empty() || inFlight.payload;
+        }
+    };
+
+    void run();
+    TypeQueue& typeQueue(const uint16_t &type);
+    ClassQueue& classQueue(const uint8_t &priorityClass);
+    // the next chunk of the class, its size is returned in chunk->size
+    void nextChunk(ClassQueue *queue, Chunk *chunk);
+    size_t nextChunkSize(const ClassQueue &queue);
+    // true if a class has a message queued
+    bool hasWork() const;
+
+    Sender sender;
+    std::mutex mutex;
+    std::condition_variable pushed;
+    std::condition_variable drained;
+    size_t defaultDepth;
+    std::vector<TypeQueue> queues;
+    std::vector<ClassQueue> classes;
+    size_t currentClass;
+    size_t chunkSize;
+    uint32_t nextMessageId;
+    size_t queued;
+    // a message is taken out of the queues, but not sent yet
+    bool sending;
+    Statistics statistics;
+
+    std::atomic<bool> running;
+    std::thread senderThread;
+};
+
+}  // namespace robot_remote_control
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace robot_remote_control {
+
+/**
+ * @brief lets threads wait for new data (e.g. pushed into a telemetry or command buffer) instead of polling the buffers.
+ * One signal is shared by all types, waiters check their own condition when woken.
+ * notify() only costs a fence and an atomic load while nobody waits.
+ */
+class DataSignal {
+ public:
+    DataSignal():waiters(0) {}
+
+    /**
+     * @brief wake all waiting threads, to be called after the data was pushed
+     */
+    void notify() {
+        // pairs with the fence in waitFor(): either the waiter sees the data or this sees the waiter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed)) {
+            {
+                // the waiter is either before its check or waiting
+                std::lock_guard<std::mutex> lock(mutex);
+            }
+            condition.notify_all();
+        }
+    }
+
+    /**
+     * @brief wait until ready() returns true
+     *
+     * @param ready the condition, checked right away and after each notify()
+     * @param timeoutMs maximum time to wait in milliseconds
+     * @return the last result of ready(), false on timeout
+     */
+    template <class PREDICATE> bool waitFor(const PREDICATE &ready, const unsigned int &timeoutMs) {
+        if (ready()) {
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool result = condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+ private:
+    std::atomic<unsigned int> waiters;
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+}  // namespace robot_remote_control
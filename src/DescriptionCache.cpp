@@ -0,0 +1,166 @@
+#include "DescriptionCache.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace robot_remote_control {
+
+namespace {
+    const char fileMagic[8] = {'R', 'R', 'C', 'D', 'E', 'S', 'C', '1'};
+}
+
+DescriptionCache::DescriptionCache(const std::vector<uint16_t> &cachedTypes):types(cachedTypes.empty() ? defaultTypes() : cachedTypes) {
+    for (const uint16_t &type : types) {
+        if (type >= cached.size()) {
+            cached.resize(type + 1, false);
+        }
+        cached[type] = true;
+    }
+}
+
+std::vector<uint16_t> DescriptionCache::defaultTypes() {
+    return {ROBOT_NAME, CONTROLLABLE_JOINTS, SIMPLE_ACTIONS, COMPLEX_ACTIONS, SIMPLE_SENSOR_DEFINITION, VIDEO_STREAMS};
+}
+
+void DescriptionCache::appendItem(std::string *buffer, const uint16_t &type, const uint64_t &hash, const MessageView &payload) {
+    const uint32_t size = payload.size;
+    buffer->append(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+    buffer->append(reinterpret_cast<const char*>(&hash), sizeof(uint64_t));
+    buffer->append(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+    buffer->append(payload.data, payload.size);
+}
+
+bool DescriptionCache::parseItems(const MessageView &data, const std::function<void(const uint16_t &type, const uint64_t &hash, const MessageView &payload)> &item) {
+    size_t offset = 0;
+    while (offset + itemHeaderSize <= data.size) {
+        const uint16_t type = data.get<uint16_t>(offset);
+        const uint64_t hash = data.get<uint64_t>(offset + sizeof(uint16_t));
+        const uint32_t size = data.get<uint32_t>(offset + sizeof(uint16_t) + sizeof(uint64_t));
+        offset += itemHeaderSize;
+        if (offset + size > data.size) {
+            return false;
+        }
+        item(type, hash, MessageView(data.data + offset, size));
+        offset += size;
+    }
+    return offset == data.size;
+}
+
+void DescriptionCache::set(const uint16_t &type, const MessageView &payload, const bool &validated) {
+    if (!isCached(type)) {
+        return;
+    }
+    const uint64_t hash = contentHash(payload);
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry &entry = entries[type];
+    entry.hash = hash;
+    entry.payload.assign(payload.data, payload.size);
+    entry.valid = true;
+    entry.validated = validated;
+}
+
+bool DescriptionCache::get(const uint16_t &type, std::string *payload, const bool &validatedOnly) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = entries.find(type);
+    if (entry == entries.end() || !entry->second.valid || (validatedOnly && !entry->second.validated)) {
+        return false;
+    }
+    *payload = entry->second.payload;
+    return true;
+}
+
+bool DescriptionCache::getHash(const uint16_t &type, uint64_t *hash) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = entries.find(type);
+    if (entry == entries.end() || !entry->second.valid) {
+        return false;
+    }
+    *hash = entry->second.hash;
+    return true;
+}
+
+void DescriptionCache::setValidated(const uint16_t &type) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = entries.find(type);
+    if (entry != entries.end() && entry->second.valid) {
+        entry->second.validated = true;
+    }
+}
+
+bool DescriptionCache::isValidated(const uint16_t &type) {
+    if (!isCached(type)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = entries.find(type);
+    return entry != entries.end() && entry->second.valid && entry->second.validated;
+}
+
+void DescriptionCache::invalidate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : entries) {
+        entry.second.validated = false;
+    }
+}
+
+std::string DescriptionCache::pathFor(const std::string &directory, const std::string &robotName) {
+    std::string name = robotName.empty() ? "unnamed" : robotName;
+    for (char &c : name) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') {
+            c = '_';
+        }
+    }
+    return directory + "/" + name + ".rrcdesc";
+}
+
+bool DescriptionCache::save(const std::string &path) {
+    std::string content(fileMagic, sizeof(fileMagic));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &entry : entries) {
+            if (entry.second.valid) {
+                appendItem(&content, entry.first, entry.second.hash, MessageView(entry.second.payload));
+            }
+        }
+    }
+    // replaced atomically, a crash does not leave a partial cache
+    std::string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        printf("unable to write the description cache %s\n", tmpPath.c_str());
+        return false;
+    }
+    bool written = fwrite(content.data(), 1, content.size(), file) == content.size();
+    written = fclose(file) == 0 && written;
+    if (!written || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        printf("unable to write the description cache %s\n", path.c_str());
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool DescriptionCache::load(const std::string &path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::string content;
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, read);
+    }
+    fclose(file);
+    if (content.size() < sizeof(fileMagic) || memcmp(content.data(), fileMagic, sizeof(fileMagic)) != 0) {
+        printf("%s is not a description cache\n", path.c_str());
+        return false;
+    }
+    return parseItems(MessageView(content).sub(sizeof(fileMagic)), [this](const uint16_t &type, const uint64_t &hash, const MessageView &payload) {
+        // the hash is recomputed, a corrupted payload is not validated by the robot then
+        set(type, payload, false);
+    });
+}
+
+}  // namespace robot_remote_control
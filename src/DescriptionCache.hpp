@@ -0,0 +1,136 @@
+#pragma once
+
+#include "MessageTypes.hpp"
+#include "Transports/Transport.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief controller-side cache of the static descriptions of a robot (name, controllable joints, actions, sensors, video streams).
+ *
+ * After a reconnect RobotController::refreshDescriptions() sends the content hashes of all cached types in one
+ * DESCRIPTION_VERSIONS request, the robot only replies the payloads that changed. Validated entries answer the
+ * requests of their types (e.g. requestRobotName()) without a round trip until the connection is lost.
+ * Received telemetry of a cached type updates its entry.
+ * The cache can be saved per robot (pathFor()) to skip the transfer after a restart of the controller.
+ *
+ * Wire (and file) format of an item: [uint16_t type][uint64_t hash][uint32_t size][payload]
+ */
+class DescriptionCache {
+ public:
+    /**
+     * @param types the cached types, defaultTypes() if empty
+     */
+    explicit DescriptionCache(const std::vector<uint16_t> &types = std::vector<uint16_t>());
+
+    /**
+     * @brief ROBOT_NAME, CONTROLLABLE_JOINTS, SIMPLE_ACTIONS, COMPLEX_ACTIONS, SIMPLE_SENSOR_DEFINITION and VIDEO_STREAMS
+     */
+    static std::vector<uint16_t> defaultTypes();
+
+    /**
+     * @brief FNV-1a hash of a serialized message, also used by the ControlledRobot
+     */
+    static uint64_t contentHash(const MessageView &payload) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < payload.size; ++i) {
+            hash ^= static_cast<uint8_t>(payload.data[i]);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    enum : size_t { itemHeaderSize = sizeof(uint16_t) + sizeof(uint64_t) + sizeof(uint32_t) };
+
+    static void appendItem(std::string *buffer, const uint16_t &type, const uint64_t &hash, const MessageView &payload);
+
+    /**
+     * @brief call item for each complete item in data
+     *
+     * @return false if data ends with an incomplete item
+     */
+    static bool parseItems(const MessageView &data, const std::function<void(const uint16_t &type, const uint64_t &hash, const MessageView &payload)> &item);
+
+    const std::vector<uint16_t>& getTypes() const {
+        return types;
+    }
+
+    /**
+     * @brief true if the type is cached (one of the types of the constructor), does not lock
+     */
+    bool isCached(const uint16_t &type) const {
+        return type < cached.size() && cached[type];
+    }
+
+    /**
+     * @brief store the latest payload of a cached type
+     *
+     * @param validated the payload is known to be the current one of the robot
+     */
+    void set(const uint16_t &type, const MessageView &payload, const bool &validated = true);
+
+    /**
+     * @brief the cached payload
+     *
+     * @param validatedOnly only return payloads validated since the last invalidate()
+     * @return false if there is no (validated) payload
+     */
+    bool get(const uint16_t &type, std::string *payload, const bool &validatedOnly = true);
+
+    /**
+     * @brief the hash of the cached payload
+     *
+     * @return false if the type has no payload
+     */
+    bool getHash(const uint16_t &type, uint64_t *hash);
+
+    void setValidated(const uint16_t &type);
+
+    bool isValidated(const uint16_t &type);
+
+    /**
+     * @brief mark all entries as not validated (e.g. when the connection is lost), the payloads are kept
+     */
+    void invalidate();
+
+    /**
+     * @brief the file of the cache of a robot
+     *
+     * @param directory directory of the cache files
+     * @param robotName name of the robot, characters not allowed in file names are replaced
+     */
+    static std::string pathFor(const std::string &directory, const std::string &robotName);
+
+    bool save(const std::string &path);
+
+    /**
+     * @brief load the entries of a file, they are not validated
+     *
+     * @return false if the file could not be read
+     */
+    bool load(const std::string &path);
+
+ private:
+    struct Entry {
+        Entry():hash(0), valid(false), validated(false) {}
+        uint64_t hash;
+        std::string payload;
+        bool valid;
+        bool validated;
+    };
+
+    std::vector<uint16_t> types;
+    // indexed by type, constant after the constructor
+    std::vector<bool> cached;
+    std::mutex mutex;
+    std::map<uint16_t, Entry> entries;
+};
+
+}  // namespace robot_remote_control
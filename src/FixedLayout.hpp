@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Types/RobotRemoteControl.pb.h"
+#include "MessageTraits.hpp"
+
+namespace robot_remote_control {
+
+/**
+ * @brief fixed-layout little-endian encoding of small high-rate telemetry (Pose, Twist, IMU, Acceleration).
+ *
+ * The message is a packed struct without padding, so it is sent and received with a single memcpy
+ * instead of the protobuf varint and tag encoding. The layout is only used for the types the controller offered
+ * and the robot selected (Capabilities::fixed_layout_types, needs the WireHeader), the messages are marked
+ * with WireHeader::FIXED_LAYOUT. Both sides convert from and to the protobuf classes, so the API does not change.
+ *
+ * fields holds the presence of the sub messages (has_position() etc.), absent ones are zero.
+ */
+namespace FixedLayout {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // the layout is the memory of the structs, big-endian builds keep protobuf
+    const bool available = std::numeric_limits<float>::is_iec559 && std::numeric_limits<double>::is_iec559;
+#else
+    const bool available = false;
+#endif
+
+    struct PoseLayout {
+        enum Fields : uint32_t { POSITION = 1, ORIENTATION = 2, TIMESTAMP = 4 };
+        uint32_t fields;
+        int32_t secs;
+        int32_t nsecs;
+        float orientation2d;
+        double position[3];
+        double orientation[4];
+    };
+
+    struct TwistLayout {
+        enum Fields : uint32_t { LINEAR = 1, ANGULAR = 2 };
+        uint32_t fields;
+        float linear[3];
+        float angular[3];
+    };
+
+    struct AccelerationLayout {
+        enum Fields : uint32_t { LINEAR = 1, ANGULAR = 2 };
+        uint32_t fields;
+        float linear[3];
+        float angular[3];
+    };
+
+    struct IMULayout {
+        enum Fields : uint32_t { ACCELERATION = 1, GYRO = 2, MAG = 4, ORIENTATION = 8 };
+        uint32_t fields;
+        float acceleration[3];
+        float gyro[3];
+        float mag[3];
+        double orientation[4];
+    };
+
+    // the wire format, a change of the structs is a new protocol
+    static_assert(sizeof(PoseLayout) == 72 && std::is_trivially_copyable<PoseLayout>::value, "PoseLayout has padding");
+    static_assert(sizeof(TwistLayout) == 28 && std::is_trivially_copyable<TwistLayout>::value, "TwistLayout has padding");
+    static_assert(sizeof(AccelerationLayout) == 28 && std::is_trivially_copyable<AccelerationLayout>::value, "AccelerationLayout has padding");
+    static_assert(sizeof(IMULayout) == 72 && std::is_trivially_copyable<IMULayout>::value, "IMULayout has padding");
+
+    inline void toArray(const Vector3 &vector, float* target) {
+        target[0] = vector.x();
+        target[1] = vector.y();
+        target[2] = vector.z();
+    }
+
+    inline void fromArray(const float* source, Vector3 *vector) {
+        vector->set_x(source[0]);
+        vector->set_y(source[1]);
+        vector->set_z(source[2]);
+    }
+
+    inline void toArray(const Orientation &orientation, double* target) {
+        target[0] = orientation.x();
+        target[1] = orientation.y();
+        target[2] = orientation.z();
+        target[3] = orientation.w();
+    }
+
+    inline void fromArray(const double* source, Orientation *orientation) {
+        orientation->set_x(source[0]);
+        orientation->set_y(source[1]);
+        orientation->set_z(source[2]);
+        orientation->set_w(source[3]);
+    }
+
+    /**
+     * @brief the conversion of a protobuf class, supported is false for classes without a fixed layout
+     */
+    template <class PROTO> struct Codec {
+        enum : bool { supported = false };
+    };
+
+    template <> struct Codec<Pose> {
+        enum : bool { supported = true };
+        typedef PoseLayout Layout;
+
+        static void encode(const Pose &pose, Layout *layout) {
+            memset(layout, 0, sizeof(Layout));
+            if (pose.has_position()) {
+                layout->fields |= Layout::POSITION;
+                layout->position[0] = pose.position().x();
+                layout->position[1] = pose.position().y();
+                layout->position[2] = pose.position().z();
+            }
+            if (pose.has_orientation()) {
+                layout->fields |= Layout::ORIENTATION;
+                toArray(pose.orientation(), layout->orientation);
+            }
+            if (pose.has_timestamp()) {
+                layout->fields |= Layout::TIMESTAMP;
+                layout->secs = pose.timestamp().secs();
+                layout->nsecs = pose.timestamp().nsecs();
+            }
+            layout->orientation2d = pose.orientation2d();
+        }
+
+        static void decode(const Layout &layout, Pose *pose) {
+            pose->Clear();
+            if (layout.fields & Layout::POSITION) {
+                Position* position = pose->mutable_position();
+                position->set_x(layout.position[0]);
+                position->set_y(layout.position[1]);
+                position->set_z(layout.position[2]);
+            }
+            if (layout.fields & Layout::ORIENTATION) {
+                fromArray(layout.orientation, pose->mutable_orientation());
+            }
+            if (layout.fields & Layout::TIMESTAMP) {
+                pose->mutable_timestamp()->set_secs(layout.secs);
+                pose->mutable_timestamp()->set_nsecs(layout.nsecs);
+            }
+            pose->set_orientation2d(layout.orientation2d);
+        }
+
+        static bool timestampNs(const Layout &layout, int64_t *timestamp) {
+            if (!(layout.fields & Layout::TIMESTAMP)) {
+                return false;
+            }
+            *timestamp = static_cast<int64_t>(layout.secs) * 1000000000 + layout.nsecs;
+            return true;
+        }
+    };
+
+    /**
+     * @brief Twist and Acceleration, a linear and an angular Vector3
+     */
+    template <class PROTO, class LAYOUT> struct VectorPairCodec {
+        enum : bool { supported = true };
+        typedef LAYOUT Layout;
+
+        static void encode(const PROTO &message, Layout *layout) {
+            memset(layout, 0, sizeof(Layout));
+            if (message.has_linear()) {
+                layout->fields |= Layout::LINEAR;
+                toArray(message.linear(), layout->linear);
+            }
+            if (message.has_angular()) {
+                layout->fields |= Layout::ANGULAR;
+                toArray(message.angular(), layout->angular);
+            }
+        }
+
+        static void decode(const Layout &layout, PROTO *message) {
+            message->Clear();
+            if (layout.fields & Layout::LINEAR) {
+                fromArray(layout.linear, message->mutable_linear());
+            }
+            if (layout.fields & Layout::ANGULAR) {
+                fromArray(layout.angular, message->mutable_angular());
+            }
+        }
+
+        static bool timestampNs(const Layout &/*layout*/, int64_t */*timestamp*/) {
+            return false;
+        }
+    };
+
+    template <> struct Codec<Twist> : public VectorPairCodec<Twist, TwistLayout> {};
+    template <> struct Codec<Acceleration> : public VectorPairCodec<Acceleration, AccelerationLayout> {};
+
+    template <> struct Codec<IMU> {
+        enum : bool { supported = true };
+        typedef IMULayout Layout;
+
+        static void encode(const IMU &imu, Layout *layout) {
+            memset(layout, 0, sizeof(Layout));
+            if (imu.has_acceleration()) {
+                layout->fields |= Layout::ACCELERATION;
+                toArray(imu.acceleration(), layout->acceleration);
+            }
+            if (imu.has_gyro()) {
+                layout->fields |= Layout::GYRO;
+                toArray(imu.gyro(), layout->gyro);
+            }
+            if (imu.has_mag()) {
+                layout->fields |= Layout::MAG;
+                toArray(imu.mag(), layout->mag);
+            }
+            if (imu.has_orientation()) {
+                layout->fields |= Layout::ORIENTATION;
+                toArray(imu.orientation(), layout->orientation);
+            }
+        }
+
+        static void decode(const Layout &layout, IMU *imu) {
+            imu->Clear();
+            if (layout.fields & Layout::ACCELERATION) {
+                fromArray(layout.acceleration, imu->mutable_acceleration());
+            }
+            if (layout.fields & Layout::GYRO) {
+                fromArray(layout.gyro, imu->mutable_gyro());
+            }
+            if (layout.fields & Layout::MAG) {
+                fromArray(layout.mag, imu->mutable_mag());
+            }
+            if (layout.fields & Layout::ORIENTATION) {
+                fromArray(layout.orientation, imu->mutable_orientation());
+            }
+        }
+
+        static bool timestampNs(const Layout &/*layout*/, int64_t */*timestamp*/) {
+            return false;
+        }
+    };
+
+    /**
+     * @brief decode a received message with a single memcpy into the preallocated layout
+     *
+     * @return false if the size does not match the layout
+     */
+    template <class LAYOUT> bool read(const char* data, const size_t &size, LAYOUT *layout) {
+        if (size != sizeof(LAYOUT)) {
+            return false;
+        }
+        memcpy(layout, data, sizeof(LAYOUT));
+        return true;
+    }
+
+    /**
+     * @brief convert an encoded message to the serialized protobuf message, e.g. for the telemetry cache
+     */
+    template <class PROTO> void serialize(const std::string &encoded, std::string *serialized) {
+        typename Codec<PROTO>::Layout layout;
+        PROTO message;
+        if (read(encoded.data(), encoded.size(), &layout)) {
+            Codec<PROTO>::decode(layout, &message);
+        }
+        message.SerializeToString(serialized);
+    }
+
+    typedef void (*Serializer)(const std::string &encoded, std::string *serialized);
+
+    // finds serialize() of a type of TelemetryTypes
+    struct SerializerLookup {
+        explicit SerializerLookup(const uint16_t &type):type(type), serializer(nullptr) {}
+        template <uint16_t TYPE> void visit() {
+            typedef typename TelemetryTraits<TYPE>::type Proto;
+            if (TYPE == type) {
+                set<Proto>(std::integral_constant<bool, Codec<Proto>::supported>());
+            }
+        }
+        template <class PROTO> void set(std::true_type /*supported*/) {
+            serializer = &serialize<PROTO>;
+        }
+        template <class PROTO> void set(std::false_type /*supported*/) {}
+        uint16_t type;
+        Serializer serializer;
+    };
+
+    /**
+     * @brief serialize() of a telemetry type of this library, e.g. for messages received with WireHeader::FIXED_LAYOUT
+     *
+     * @return Serializer nullptr if the type has no fixed layout
+     */
+    inline Serializer serializerOf(const uint16_t &type) {
+        SerializerLookup lookup(type);
+        TelemetryTypes::forEach(lookup);
+        return lookup.serializer;
+    }
+
+    // collects the types of TelemetryTypes with a Codec
+    struct TypeCollector {
+        template <uint16_t TYPE> void visit() {
+            if (Codec<typename TelemetryTraits<TYPE>::type>::supported) {
+                types.push_back(TYPE);
+            }
+        }
+        std::vector<uint16_t> types;
+    };
+
+    /**
+     * @brief the telemetry types of this library with a fixed layout, offered by the RobotController
+     */
+    inline std::vector<uint16_t> supportedTypes() {
+        TypeCollector collector;
+        if (available) {
+            TelemetryTypes::forEach(collector);
+        }
+        return collector.types;
+    }
+
+}  // namespace FixedLayout
+}  // namespace robot_remote_control
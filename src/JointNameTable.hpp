@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Types/RobotRemoteControl.pb.h"
+#include <string>
+#include <unordered_map>
+
+namespace robot_remote_control {
+
+/**
+ * @brief the joint names of CONTROLLABLE_JOINTS, used to send JointState and JointCommand without names.
+ * Both sides calculate the same id from the names, a compact message is only expanded with a table of the same id.
+ */
+class JointNameTable {
+ public:
+    JointNameTable():id(0) {}
+
+    /**
+     * @brief FNV-1a of all names, 0 is reserved for "no table"
+     */
+    static uint64_t calculateId(const google::protobuf::RepeatedPtrField<std::string> &names) {
+        uint64_t hash = 14695981039346656037ull;
+        for (const std::string &name : names) {
+            // include the terminator, so {"ab","c"} differs from {"a","bc"}
+            for (size_t i = 0; i <= name.size(); ++i) {
+                hash ^= static_cast<uint8_t>(name.c_str()[i]);
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash ? hash : 1;
+    }
+
+    /**
+     * @brief set the table from the CONTROLLABLE_JOINTS
+     *
+     * @return true if the table changed
+     */
+    bool set(const JointState &controllableJoints) {
+        uint64_t newId = controllableJoints.name_size() ? calculateId(controllableJoints.name()) : 0;
+        if (newId == id) {
+            return false;
+        }
+        id = newId;
+        names = controllableJoints.name();
+        indices.clear();
+        for (int i = 0; i < names.size(); ++i) {
+            indices[names.Get(i)] = i;
+        }
+        return true;
+    }
+
+    uint64_t getId() const {
+        return id;
+    }
+
+    /**
+     * @brief copy a JointState or JointCommand without the names
+     *
+     * @param joints the message with names
+     * @param compact the values and the table id or indices into the table
+     * @return false if a joint is not in the table (compact is not changed)
+     */
+    template <class JOINTS> bool compact(const JOINTS &joints, JOINTS *compact) const {
+        if (!id) {
+            return false;
+        }
+        bool tableOrder = joints.name_size() == names.size();
+        for (int i = 0; i < joints.name_size() && tableOrder; ++i) {
+            tableOrder = joints.name(i) == names.Get(i);
+        }
+        google::protobuf::RepeatedField<uint32_t> nameIndex;
+        if (!tableOrder) {
+            nameIndex.Reserve(joints.name_size());
+            for (const std::string &name : joints.name()) {
+                auto index = indices.find(name);
+                if (index == indices.end()) {
+                    return false;
+                }
+                nameIndex.Add(index->second);
+            }
+        }
+        copyValues(joints, compact);
+        compact->set_name_table(id);
+        compact->mutable_name_index()->Swap(&nameIndex);
+        return true;
+    }
+
+    /**
+     * @brief restore the names of a compact message in place, messages with names are not changed
+     *
+     * @return false if the message uses a different table
+     */
+    template <class JOINTS> bool expand(JOINTS *joints) const {
+        if (!joints->name_table()) {
+            return true;
+        }
+        if (joints->name_table() != id) {
+            return false;
+        }
+        if (!joints->name_index_size()) {
+            *joints->mutable_name() = names;
+        } else {
+            joints->mutable_name()->Reserve(joints->name_index_size());
+            for (const uint32_t &index : joints->name_index()) {
+                if (index >= static_cast<uint32_t>(names.size())) {
+                    joints->clear_name();
+                    return false;
+                }
+                *joints->add_name() = names.Get(index);
+            }
+        }
+        joints->clear_name_table();
+        joints->clear_name_index();
+        return true;
+    }
+
+ private:
+    // all fields but the names
+    static void copyValues(const JointState &joints, JointState *target) {
+        target->Clear();
+        *target->mutable_position() = joints.position();
+        *target->mutable_velocity() = joints.velocity();
+        *target->mutable_effort() = joints.effort();
+        *target->mutable_acceleration() = joints.acceleration();
+        if (joints.has_timestamp()) {
+            *target->mutable_timestamp() = joints.timestamp();
+        }
+    }
+
+    static void copyValues(const JointCommand &joints, JointCommand *target) {
+        target->Clear();
+        *target->mutable_position() = joints.position();
+        *target->mutable_velocity() = joints.velocity();
+        *target->mutable_effort() = joints.effort();
+        *target->mutable_acceleration() = joints.acceleration();
+        *target->mutable_kp_gain() = joints.kp_gain();
+        *target->mutable_kd_gain() = joints.kd_gain();
+        if (joints.has_timestamp()) {
+            *target->mutable_timestamp() = joints.timestamp();
+        }
+    }
+
+    uint64_t id;
+    google::protobuf::RepeatedPtrField<std::string> names;
+    std::unordered_map<std::string, uint32_t> indices;
+};
+
+}  // namespace robot_remote_control
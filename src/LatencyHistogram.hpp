@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace robot_remote_control {
+
+/**
+ * @brief histogram of durations in microseconds with a fixed relative precision (like a HdrHistogram):
+ * values below 64 are exact, larger ones are in one of 32 buckets per power of two (at most ~3% too high).
+ *
+ * Recording is lock-free and allocation-free, so it can be done in the receiving thread,
+ * reading is possible from any thread at the same time (the results may miss concurrent recordings).
+ */
+class LatencyHistogram {
+ public:
+    struct Summary {
+        Summary():count(0), min(0), p50(0), p90(0), p99(0), p999(0), max(0), mean(0) {}
+        uint64_t count;
+        uint64_t min;
+        uint64_t p50;
+        uint64_t p90;
+        uint64_t p99;
+        uint64_t p999;
+        uint64_t max;
+        double mean;
+    };
+
+    // values are clamped to ~12 days
+    static const uint64_t maxValue = (uint64_t(1) << 40) - 1;
+
+    LatencyHistogram() {
+        reset();
+    }
+
+    void record(uint64_t value) {
+        if (value > maxValue) {
+            value = maxValue;
+        }
+        counts[index(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t current = minimum.load(std::memory_order_relaxed);
+        while (value < current && !minimum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+        current = maximum.load(std::memory_order_relaxed);
+        while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief the value below which percent of the recorded values are
+     *
+     * @param percent e.g. 99.9
+     * @return uint64_t the upper end of the bucket (but not more than the max), 0 if nothing was recorded
+     */
+    uint64_t percentile(const double &percent) const {
+        std::array<uint64_t, bucketCount> snapshot;
+        uint64_t recorded = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            snapshot[i] = counts[i].load(std::memory_order_relaxed);
+            recorded += snapshot[i];
+        }
+        return percentile(snapshot, recorded, percent);
+    }
+
+    Summary summary() const {
+        std::array<uint64_t, bucketCount> snapshot;
+        Summary result;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            snapshot[i] = counts[i].load(std::memory_order_relaxed);
+            result.count += snapshot[i];
+        }
+        if (!result.count) {
+            return result;
+        }
+        result.min = minimum.load(std::memory_order_relaxed);
+        result.max = maximum.load(std::memory_order_relaxed);
+        result.mean = static_cast<double>(sum.load(std::memory_order_relaxed)) / result.count;
+        result.p50 = percentile(snapshot, result.count, 50);
+        result.p90 = percentile(snapshot, result.count, 90);
+        result.p99 = percentile(snapshot, result.count, 99);
+        result.p999 = percentile(snapshot, result.count, 99.9);
+        return result;
+    }
+
+    void reset() {
+        for (std::atomic<uint64_t> &bucket : counts) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        total.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        minimum.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
+    }
+
+ private:
+    static const unsigned int subBucketBits = 5;
+    static const uint64_t subBuckets = 1 << subBucketBits;
+    // linear up to 2 * subBuckets, then subBuckets for each further power of two
+    static const size_t bucketCount = (40 - subBucketBits) * subBuckets + subBuckets;
+
+    static size_t index(const uint64_t &value) {
+        if (value < 2 * subBuckets) {
+            return value;
+        }
+        unsigned int highestBit = 63 - __builtin_clzll(value);
+        unsigned int shift = highestBit - subBucketBits;
+        return shift * subBuckets + (value >> shift);
+    }
+
+    // the highest value in the bucket
+    static uint64_t highestValue(const size_t &index) {
+        if (index < 2 * subBuckets) {
+            return index;
+        }
+        unsigned int shift = index / subBuckets - 1;
+        uint64_t subBucket = index % subBuckets + subBuckets;
+        return ((subBucket + 1) << shift) - 1;
+    }
+
+    uint64_t percentile(const std::array<uint64_t, bucketCount> &snapshot, const uint64_t &recorded, const double &percent) const {
+        if (!recorded) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(percent / 100.0 * recorded + 0.5);
+        rank = rank < 1 ? 1 : rank;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            seen += snapshot[i];
+            if (seen >= rank) {
+                uint64_t highest = highestValue(i);
+                uint64_t max = maximum.load(std::memory_order_relaxed);
+                return highest < max ? highest : max;
+            }
+        }
+        return maximum.load(std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, bucketCount> counts;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> minimum;
+    std::atomic<uint64_t> maximum;
+};
+
+}  // namespace robot_remote_control
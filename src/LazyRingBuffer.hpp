@@ -0,0 +1,165 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+#include "RingBuffer.hpp"
+#include "LockFreeRingBuffer.hpp"
+
+namespace robot_remote_control {
+
+/**
+ * @brief buffer of protobuf messages that stores the serialized bytes, messages are only parsed when they are read.
+ * For types that are rarely read, this saves parsing each received message.
+ *
+ * Thread safety is the same as for the underlying buffer (RingBuffer or LockFreeRingBuffer).
+ */
+template <class TYPE> class LazyRingBuffer: public TypedRingBufferBase<TYPE> {
+    public:
+        /**
+         * @param buffersize number of messages
+         * @param lockfree use a LockFreeRingBuffer for the serialized messages
+         */
+        LazyRingBuffer(const size_t & buffersize, bool lockfree = false): TypedRingBufferBase<TYPE>() {
+            if (lockfree) {
+                serialized.reset(new LockFreeRingBuffer<std::string>(buffersize));
+            } else {
+                serialized.reset(new RingBuffer<std::string>(buffersize));
+            }
+        }
+
+        virtual ~LazyRingBuffer() {}
+
+        size_t size() {
+            return serialized->size();
+        }
+
+        size_t capacity() {
+            return serialized->capacity();
+        }
+
+        void resize(const size_t &newsize) {
+            serialized->resize(newsize);
+        }
+
+        /**
+         * @brief counts the bytes of the serialized messages
+         */
+        bool setByteLimit(const size_t &maxBytes, const std::shared_ptr<BufferedBytes> &counter) {
+            return serialized->setByteLimit(maxBytes, counter);
+        }
+
+        bool dropOldest() {
+            return serialized->dropOldest();
+        }
+
+        /**
+         * @brief push a serialized message, only copies the bytes (into the memory of an old message)
+         */
+        bool pushSerialized(const char* data, const size_t &size, bool overwriteIfFull = false) {
+            if (!callbacks.empty()) {
+                // callbacks need the parsed message anyway
+                if (!producerMessage.ParseFromArray(data, size)) {
+                    return false;
+                }
+                notify(producerMessage);
+            }
+            return serialized->pushInPlace([&](std::string *slot) {
+                slot->assign(data, size);
+                return true;
+            }, overwriteIfFull);
+        }
+
+        bool pushData(const TYPE & data, bool overwriteIfFull = false) {
+            notify(data);
+            return serialized->pushInPlace([&data](std::string *slot) {
+                return data.SerializeToString(slot);
+            }, overwriteIfFull);
+        }
+
+        bool pushData(TYPE && data, bool overwriteIfFull = false) {
+            return pushData(static_cast<const TYPE&>(data), overwriteIfFull);
+        }
+
+        bool pushInPlace(const std::function<bool(TYPE *slot)> &fill, bool overwriteIfFull = false) {
+            if (!fill(&producerMessage)) {
+                return false;
+            }
+            return pushData(producerMessage, overwriteIfFull);
+        }
+
+        bool popData(TYPE *data) {
+            if (!serialized->popData(&consumerBytes)) {
+                return false;
+            }
+            return data->ParseFromString(consumerBytes);
+        }
+
+        bool peekData(TYPE *data) {
+            if (!serialized->peekData(&consumerBytes)) {
+                return false;
+            }
+            return data->ParseFromString(consumerBytes);
+        }
+
+        size_t popAll(std::vector<TYPE> *data) {
+            consumerBatch.clear();
+            serialized->popAll(&consumerBatch);
+            return parseAll(data);
+        }
+
+        bool peekAll(std::vector<TYPE> *data) {
+            consumerBatch.clear();
+            if (!serialized->peekAll(&consumerBatch)) {
+                return false;
+            }
+            parseAll(data);
+            return true;
+        }
+
+        /**
+         * @brief the serialized oldest message without parsing it
+         */
+        bool peekSerialized(std::string *data) {
+            return serialized->peekData(data);
+        }
+
+        /**
+         * @brief callbacks parse each message when it is pushed
+         */
+        void addDataReceivedCallback(const std::function<void(const TYPE & data)> &cb) {
+            callbacks.push_back(cb);
+        }
+
+    private:
+        size_t parseAll(std::vector<TYPE> *data) {
+            size_t parsed = 0;
+            data->reserve(data->size() + consumerBatch.size());
+            for (const std::string &bytes : consumerBatch) {
+                data->emplace_back();
+                if (data->back().ParseFromString(bytes)) {
+                    parsed++;
+                } else {
+                    data->pop_back();
+                }
+            }
+            return parsed;
+        }
+
+        void notify(const TYPE & data) {
+            auto callCb = [&](const std::function<void (const TYPE & data)> &cb){cb(data);};
+            std::for_each(callbacks.begin(), callbacks.end(), callCb);
+        }
+
+        std::unique_ptr< TypedRingBufferBase<std::string> > serialized;
+        std::vector< std::function<void (const TYPE & data)> > callbacks;
+        // reused by the pushing and the reading thread
+        TYPE producerMessage;
+        std::string consumerBytes;
+        std::vector<std::string> consumerBatch;
+};
+
+}  // namespace robot_remote_control
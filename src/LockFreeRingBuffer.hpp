@@ -0,0 +1,221 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <utility>
+
+#include "RingBuffer.hpp"
+
+namespace robot_remote_control {
+
+/**
+ * @brief lock-free ring buffer for exactly one producer thread (pushData) and one consumer thread (popData/peekData)
+ * with the same semantics as RingBuffer (including overwriting the oldest data if full).
+ *
+ * Elements are never copied while the other thread may access them: the producer writes into a spare slot it owns
+ * and swaps it into the ring, the consumer swaps its own spare slot in to take an element out.
+ * So TYPE can be any copyable type (e.g. a protobuf message).
+ *
+ * @warning resize() and addDataReceivedCallback() are not thread safe, they should be called before the buffer is in use
+ */
+template <class TYPE> class LockFreeRingBuffer: public TypedRingBufferBase<TYPE> {
+    public:
+        explicit LockFreeRingBuffer(const size_t & buffersize): TypedRingBufferBase<TYPE>() {
+            init(buffersize);
+        }
+
+        virtual ~LockFreeRingBuffer() {}
+
+        size_t size() {
+            // load the consumer position first, the producer position only grows
+            uint64_t read = consumer.position.load(std::memory_order_acquire);
+            uint64_t written = producer.position.load(std::memory_order_acquire);
+            // when overwritten, the consumer skips the old data on the next pop
+            return std::min<uint64_t>(written - read, buffersize);
+        }
+
+        size_t capacity() {
+            return buffersize;
+        }
+
+        /**
+         * @brief resize the buffer, unlike RingBuffer, the content is dropped
+         */
+        void resize(const size_t &newsize) {
+            if (size() > 0) {
+                printf("possible data loss due to resize on nonemty buffer\n");
+            }
+            init(newsize);
+        }
+
+        bool pushData(const TYPE & data, bool overwriteIfFull = false) {
+            return pushInPlace([&data](TYPE *slot) {
+                *slot = data;
+                return true;
+            }, overwriteIfFull);
+        }
+
+        bool pushData(TYPE && data, bool overwriteIfFull = false) {
+            return pushInPlace([&data](TYPE *slot) {
+                *slot = std::move(data);
+                return true;
+            }, overwriteIfFull);
+        }
+
+        bool pushInPlace(const std::function<bool(TYPE *slot)> &fill, bool overwriteIfFull = false) {
+            // only this thread writes the producer position
+            uint64_t position = producer.position.load(std::memory_order_relaxed);
+            if (!overwriteIfFull && position - consumer.position.load(std::memory_order_acquire) >= buffersize) {
+                return false;
+            }
+            // the spare slot is owned by the producer, no other thread accesses it while it is filled
+            const size_t slot = producer.spare;
+            if (!fill(&slots[slot])) {
+                return false;
+            }
+            // before handing the slot over, the consumer may take the element right after that
+            notify(slots[slot]);
+            uint64_t previous = cells[position % buffersize].exchange(pack(position + 1, producer.spare), std::memory_order_acq_rel);
+            // the replaced slot is either an old element or handed over by the consumer
+            producer.spare = indexOf(previous);
+            producer.position.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief pop the oldest element, it is swapped out, so the buffer reuses the memory of the old content of data
+         */
+        bool popData(TYPE *data) {
+            if (fetchFront()) {
+                using std::swap;
+                swap(*data, slots[consumer.spare]);
+                consumer.frontFetched = false;
+                consumer.position.store(consumer.position.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                return true;
+            }
+            return false;
+        }
+
+        bool peekData(TYPE *data) {
+            if (fetchFront()) {
+                *data = slots[consumer.spare];
+                return true;
+            }
+            return false;
+        }
+
+        void addDataReceivedCallback(const std::function<void(const TYPE & data)> &cb) {
+            callbacks.push_back(cb);
+        }
+
+    private:
+        static const size_t CACHELINE_SIZE = 64;
+        // 20 bits for the slot index, 44 bits sequence number (the position + 1 of the element, 0 for no element)
+        static const uint64_t INDEX_BITS = 20;
+        static const uint64_t INDEX_MASK = (uint64_t(1) << INDEX_BITS) - 1;
+
+        static uint64_t pack(const uint64_t &sequence, const size_t &index) {
+            return (sequence << INDEX_BITS) | index;
+        }
+
+        static uint64_t sequenceOf(const uint64_t &cell) {
+            return cell >> INDEX_BITS;
+        }
+
+        static size_t indexOf(const uint64_t &cell) {
+            return cell & INDEX_MASK;
+        }
+
+        void init(const size_t &newsize) {
+            if (newsize > INDEX_MASK - 1) {
+                printf("LockFreeRingBuffer size %lu too big, using %lu\n", newsize, INDEX_MASK - 1);
+            }
+            buffersize = std::max<size_t>(1, std::min<size_t>(newsize, INDEX_MASK - 1));
+            // each cell owns a slot, plus one spare slot for producer and consumer
+            slots.clear();
+            slots.resize(buffersize + 2);
+            cells.reset(new std::atomic<uint64_t>[buffersize]);
+            for (size_t i = 0; i < buffersize; ++i) {
+                cells[i].store(pack(0, i));
+            }
+            producer.spare = buffersize;
+            producer.position.store(0);
+            consumer.spare = buffersize + 1;
+            consumer.position.store(0);
+            consumer.frontFetched = false;
+        }
+
+        /**
+         * @brief take the oldest element out of the ring into the consumer spare slot (if not already done)
+         * @return true if there is an element in the consumer spare slot
+         */
+        bool fetchFront() {
+            uint64_t read = consumer.position.load(std::memory_order_relaxed);
+            if (consumer.frontFetched) {
+                if (producer.position.load(std::memory_order_acquire) - read <= buffersize) {
+                    return true;
+                }
+                // would have been overwritten in the meantime, drop it like RingBuffer does
+                consumer.frontFetched = false;
+                read++;
+            }
+            while (true) {
+                std::atomic<uint64_t> &cell = cells[read % buffersize];
+                uint64_t current = cell.load(std::memory_order_acquire);
+                uint64_t sequence = sequenceOf(current);
+                if (sequence < read + 1) {
+                    // not yet written or already taken
+                    consumer.position.store(read, std::memory_order_release);
+                    return false;
+                } else if (sequence == read + 1) {
+                    if (cell.compare_exchange_strong(current, pack(0, consumer.spare), std::memory_order_acq_rel, std::memory_order_acquire)) {
+                        consumer.spare = indexOf(current);
+                        consumer.frontFetched = true;
+                        consumer.position.store(read, std::memory_order_release);
+                        return true;
+                    }
+                    // the producer overwrote the element right now, check the cell again
+                } else {
+                    // the producer overwrote the element, skip all overwritten elements
+                    uint64_t written = producer.position.load(std::memory_order_acquire);
+                    read++;
+                    if (written > buffersize) {
+                        read = std::max(read, written - buffersize);
+                    }
+                }
+            }
+        }
+
+        void notify(const TYPE & data) {
+            auto callCb = [&](const std::function<void (const TYPE & data)> &cb){cb(data);};
+            std::for_each(callbacks.begin(), callbacks.end(), callCb);
+        }
+
+        size_t buffersize;
+        // the ring, each cell holds the index of the slot containing the element and its sequence number
+        std::unique_ptr< std::atomic<uint64_t>[] > cells;
+        std::vector<TYPE> slots;
+        std::vector< std::function<void (const TYPE & data)> > callbacks;
+
+        // producer and consumer state on different cache lines
+        struct ProducerState {
+            char padding_front[CACHELINE_SIZE];
+            std::atomic<uint64_t> position;
+            size_t spare;
+            char padding_back[CACHELINE_SIZE];
+        } producer;
+
+        struct ConsumerState {
+            std::atomic<uint64_t> position;
+            size_t spare;
+            bool frontFetched;
+            char padding_back[CACHELINE_SIZE];
+        } consumer;
+};
+
+}  // namespace robot_remote_control
@@ -0,0 +1,192 @@
+#include "MapTiles.hpp"
+#include "PointCloudCodec.hpp"
+#include "Types/Conversions/PackedPointCloud.hpp"
+#include "Types/Conversions/GridMapLayerCodec.hpp"
+
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <string>
+
+namespace robot_remote_control {
+
+TiledMapStore::TiledMapStore() {
+    // a new store needs to invalidate controller caches of a previous one (e.g. after a robot restart)
+    std::random_device random;
+    epoch = (static_cast<uint64_t>(random()) << 32) | random();
+}
+
+uint64_t TiledMapStore::setTile(const uint32_t &mapId, const int32_t &x, const int32_t &y, const google::protobuf::Message &tile) {
+    std::lock_guard<std::mutex> lock(mutex);
+    TiledMap &map = maps[mapId];
+    TileIndex index(x, y);
+    MapTile &entry = map.tiles[index];
+    if (entry.version()) {
+        map.changes.erase(entry.version());
+    }
+    map.version++;
+    entry.set_x(x);
+    entry.set_y(y);
+    entry.set_version(map.version);
+    entry.mutable_data()->PackFrom(tile);
+    map.changes[map.version] = index;
+    return map.version;
+}
+
+void TiledMapStore::clear(const uint32_t &mapId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    TiledMap &map = maps[mapId];
+    map.tiles.clear();
+    map.changes.clear();
+    map.version++;
+    map.clearedVersion = map.version;
+}
+
+void TiledMapStore::getChanges(const MapTilesRequest &request, MapTiles *changes) {
+    changes->Clear();
+    changes->set_map_id(request.map_id());
+    changes->set_epoch(epoch);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto mapIter = maps.find(request.map_id());
+    if (mapIter == maps.end()) {
+        changes->set_complete(true);
+        return;
+    }
+    const TiledMap &map = mapIter->second;
+    changes->set_version(map.version);
+
+    bool complete = request.epoch() != epoch || request.known_version() == 0 ||
+                    request.known_version() < map.clearedVersion || request.known_version() > map.version;
+    changes->set_complete(complete);
+    if (complete) {
+        for (const auto &tile : map.tiles) {
+            *changes->add_tiles() = tile.second;
+        }
+        return;
+    }
+    for (auto change = map.changes.upper_bound(request.known_version()); change != map.changes.end(); ++change) {
+        *changes->add_tiles() = map.tiles.at(change->second);
+    }
+}
+
+
+MapTileCache::MapTileCache():epoch(0), version(0) {}
+
+MapTilesRequest MapTileCache::getRequest(const uint32_t &mapId) const {
+    MapTilesRequest request;
+    request.set_map_id(mapId);
+    request.set_epoch(epoch);
+    request.set_known_version(version);
+    return request;
+}
+
+size_t MapTileCache::merge(const MapTiles &changes) {
+    if (changes.complete() || changes.epoch() != epoch) {
+        tiles.clear();
+    }
+    epoch = changes.epoch();
+    version = changes.version();
+    for (const MapTile &tile : changes.tiles()) {
+        tiles[std::make_pair(tile.x(), tile.y())] = tile;
+    }
+    return changes.tiles_size();
+}
+
+bool MapTileCache::getGridMap(GridMap *gridmap) const {
+    std::vector<std::pair<const MapTile*, GridMap> > gridTiles;
+    int32_t minX = std::numeric_limits<int32_t>::max(), minY = std::numeric_limits<int32_t>::max();
+    int32_t maxX = std::numeric_limits<int32_t>::min(), maxY = std::numeric_limits<int32_t>::min();
+    for (const auto &entry : tiles) {
+        GridMap tilemap;
+        if (entry.second.data().UnpackTo(&tilemap) && tilemap.layers_size()) {
+            GridMapLayerCodec::decode(&tilemap);
+            minX = std::min(minX, entry.second.x());
+            minY = std::min(minY, entry.second.y());
+            maxX = std::max(maxX, entry.second.x());
+            maxY = std::max(maxY, entry.second.y());
+            gridTiles.push_back(std::make_pair(&entry.second, tilemap));
+        }
+    }
+    if (gridTiles.empty()) {
+        return false;
+    }
+
+    // the first tile defines the layout
+    const GridMap &first = gridTiles.front().second;
+    const size_t tileSizeX = first.layers(0).size().x();
+    const size_t tileSizeY = first.layers(0).size().y();
+    const size_t sizeX = tileSizeX * (maxX - minX + 1);
+    const size_t sizeY = tileSizeY * (maxY - minY + 1);
+
+    gridmap->Clear();
+    gridmap->set_frame(first.frame());
+    *gridmap->mutable_timestamp() = first.timestamp();
+    // the origin of the tile at (minX, minY), the tiles are expected to be axis aligned in the map frame
+    *gridmap->mutable_origin() = first.origin();
+    const Vector2 &scale = first.layers(0).scale();
+    Position *origin = gridmap->mutable_origin()->mutable_position();
+    origin->set_x(origin->x() - (gridTiles.front().first->x() - minX) * static_cast<double>(tileSizeX) * scale.x());
+    origin->set_y(origin->y() - (gridTiles.front().first->y() - minY) * static_cast<double>(tileSizeY) * scale.y());
+
+    for (const SimpleSensor &layer : first.layers()) {
+        SimpleSensor *merged = gridmap->add_layers();
+        merged->set_name(layer.name());
+        merged->set_id(layer.id());
+        *merged->mutable_scale() = layer.scale();
+        merged->mutable_size()->set_x(sizeX);
+        merged->mutable_size()->set_y(sizeY);
+        merged->mutable_value()->Resize(sizeX * sizeY, std::numeric_limits<float>::quiet_NaN());
+    }
+
+    for (const auto &gridTile : gridTiles) {
+        const size_t offsetX = (gridTile.first->x() - minX) * tileSizeX;
+        const size_t offsetY = (gridTile.first->y() - minY) * tileSizeY;
+        for (int layerIndex = 0; layerIndex < gridmap->layers_size(); ++layerIndex) {
+            SimpleSensor *merged = gridmap->mutable_layers(layerIndex);
+            for (const SimpleSensor &layer : gridTile.second.layers()) {
+                if (layer.name() != merged->name() || layer.size().x() != tileSizeX || layer.size().y() != tileSizeY ||
+                    static_cast<size_t>(layer.value_size()) < tileSizeX * tileSizeY) {
+                    continue;
+                }
+                float* target = merged->mutable_value()->mutable_data();
+                for (size_t y = 0; y < tileSizeY; ++y) {
+                    const float* row = layer.value().data() + y * tileSizeX;
+                    std::copy(row, row + tileSizeX, target + (offsetY + y) * sizeX + offsetX);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool MapTileCache::getPointCloud(PointCloud *pointcloud) const {
+    std::vector<PointCloud> clouds;
+    size_t count = 0;
+    for (const auto &entry : tiles) {
+        PointCloud cloud;
+        if (entry.second.data().UnpackTo(&cloud)) {
+            PointCloudCodec::decode(&cloud);
+            count += PackedPointCloud::size(cloud);
+            clouds.push_back(std::move(cloud));
+        }
+    }
+    if (clouds.empty()) {
+        return false;
+    }
+
+    pointcloud->Clear();
+    pointcloud->set_frame(clouds.front().frame());
+    *pointcloud->mutable_timestamp() = clouds.front().timestamp();
+    *pointcloud->mutable_origin() = clouds.front().origin();
+    PackedPointCloud::Point* target = PackedPointCloud::resize(pointcloud, count);
+    for (const PointCloud &cloud : clouds) {
+        for (size_t i = 0; i < PackedPointCloud::size(cloud); ++i) {
+            *target++ = PackedPointCloud::getPoint(cloud, i);
+        }
+    }
+    return true;
+}
+
+}  // namespace robot_remote_control
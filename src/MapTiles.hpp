@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Types/RobotRemoteControl.pb.h"
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace robot_remote_control {
+
+/**
+ * @brief robot side store of tiled maps, each change of a tile gets a new (increasing) version of the map,
+ * so a controller knowing all tiles up to a version only needs the tiles changed after that version
+ */
+class TiledMapStore {
+ public:
+    TiledMapStore();
+
+    /**
+     * @brief add or replace a tile
+     *
+     * @param mapId the map to add the tile to
+     * @param x tile index in x
+     * @param y tile index in y
+     * @param tile the content of the tile (e.g. GridMap or PointCloud)
+     * @return uint64_t the new version of the map
+     */
+    uint64_t setTile(const uint32_t &mapId, const int32_t &x, const int32_t &y, const google::protobuf::Message &tile);
+
+    /**
+     * @brief remove all tiles of a map, the version is kept, so caches will get a complete map on their next request
+     */
+    void clear(const uint32_t &mapId);
+
+    /**
+     * @brief get the tiles changed after the known version of the request
+     *
+     * @param request the map and the version known by the controller
+     * @param changes only the changed tiles, all tiles if the epoch of the request differs
+     */
+    void getChanges(const MapTilesRequest &request, MapTiles *changes);
+
+ private:
+    typedef std::pair<int32_t, int32_t> TileIndex;
+    struct TiledMap {
+        TiledMap():version(0), clearedVersion(0) {}
+        uint64_t version;
+        // caches older than this need a complete map
+        uint64_t clearedVersion;
+        std::map<TileIndex, MapTile> tiles;
+        // version -> tile, to find the changed ones without looking at all tiles
+        std::map<uint64_t, TileIndex> changes;
+    };
+
+    std::mutex mutex;
+    uint64_t epoch;
+    std::map<uint32_t, TiledMap> maps;
+};
+
+/**
+ * @brief controller side cache of a tiled map, merges the received changes
+ */
+class MapTileCache {
+ public:
+    MapTileCache();
+
+    /**
+     * @brief the request for the changes since the last merge
+     */
+    MapTilesRequest getRequest(const uint32_t &mapId) const;
+
+    /**
+     * @brief merge a reply of the robot into the cache
+     *
+     * @return size_t number of changed tiles
+     */
+    size_t merge(const MapTiles &changes);
+
+    uint64_t getVersion() const {
+        return version;
+    }
+
+    const std::map<std::pair<int32_t, int32_t>, MapTile>& getTiles() const {
+        return tiles;
+    }
+
+    /**
+     * @brief merge all GridMap tiles into one GridMap, all tiles need to have the same size and layers.
+     * Missing tiles are filled with NaN
+     *
+     * @return true if there were GridMap tiles
+     */
+    bool getGridMap(GridMap *gridmap) const;
+
+    /**
+     * @brief merge all PointCloud tiles into one packed PointCloud
+     *
+     * @return true if there were PointCloud tiles
+     */
+    bool getPointCloud(PointCloud *pointcloud) const;
+
+ private:
+    uint64_t epoch;
+    uint64_t version;
+    std::map<std::pair<int32_t, int32_t>, MapTile> tiles;
+};
+
+}  // namespace robot_remote_control
@@ -0,0 +1,263 @@
+#include "MapTransfer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstring>
+#include <google/protobuf/io/coded_stream.h>
+
+namespace robot_remote_control {
+
+// odr-used by the default arguments
+const uint64_t MapTransfer::DEFAULT_MAX_SIZE;
+
+MapTransfer::MapTransfer(const uint32_t &transferId, const uint32_t &mapId, const uint32_t &chunkSize,
+                         const std::function<void(const float &progress)> &progressCallback,
+                         const uint64_t &maxSize):
+    transferId(transferId),
+    mapId(mapId),
+    requestedChunkSize(chunkSize),
+    maxSize(maxSize),
+    progressCallback(progressCallback),
+    hasInfo(false),
+    receivedChunks(0) {
+    lastChunk.start();
+}
+
+void MapTransfer::reset(const MapTransferInfo &newInfo) {
+    info = newInfo;
+    hasInfo = true;
+    data.clear();
+    data.resize(info.total_size());
+    received.assign(info.chunks(), false);
+    receivedChunks = 0;
+}
+
+bool MapTransfer::completeUnlocked() const {
+    return hasInfo && receivedChunks == info.chunks();
+}
+
+float MapTransfer::progressUnlocked() const {
+    if (!hasInfo) {
+        return 0;
+    }
+    if (info.chunks() == 0) {
+        return 1;
+    }
+    return static_cast<float>(receivedChunks) / info.chunks();
+}
+
+bool MapTransfer::setInfo(const MapTransferInfo &newInfo) {
+    bool complete;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (hasInfo && newInfo.total_size() == info.total_size() && newInfo.checksum() == info.checksum() &&
+            newInfo.chunk_size() == info.chunk_size()) {
+            return true;
+        }
+        // the chunks have to cover the map, otherwise a small total size could come with a huge number of chunks
+        const uint64_t chunks = newInfo.chunk_size() ? (newInfo.total_size() + newInfo.chunk_size() - 1) / newInfo.chunk_size() : 0;
+        if (newInfo.total_size() > maxSize || newInfo.chunks() != chunks || (newInfo.total_size() && !newInfo.chunk_size())) {
+            printf("ERROR invalid map transfer info (%llu bytes in %u chunks of %u bytes, maximum %llu bytes), ignoring it\n",
+                   static_cast<unsigned long long>(newInfo.total_size()), newInfo.chunks(), newInfo.chunk_size(),
+                   static_cast<unsigned long long>(maxSize));
+            return false;
+        }
+        reset(newInfo);
+        complete = completeUnlocked();
+    }
+    if (complete) {
+        completed.notify_all();
+    }
+    return true;
+}
+
+bool MapTransfer::addChunk(const MapChunk &chunk) {
+    if (!setInfo(chunk.info())) {
+        return isComplete();
+    }
+    float progress;
+    bool complete;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lastChunk.start();
+        const uint64_t offset = static_cast<uint64_t>(chunk.index()) * info.chunk_size();
+        if (chunk.index() >= info.chunks() || received[chunk.index()] || offset + chunk.data().size() > data.size()) {
+            // duplicate after a resume or invalid
+            return completeUnlocked();
+        }
+        memcpy(&data[offset], chunk.data().data(), chunk.data().size());
+        received[chunk.index()] = true;
+        receivedChunks++;
+        progress = progressUnlocked();
+        complete = completeUnlocked();
+    }
+    if (progressCallback) {
+        progressCallback(progress);
+    }
+    if (complete) {
+        completed.notify_all();
+    }
+    return complete;
+}
+
+uint32_t MapTransfer::getFirstMissingChunk() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto missing = std::find(received.begin(), received.end(), false);
+    return missing - received.begin();
+}
+
+float MapTransfer::getProgress() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return progressUnlocked();
+}
+
+bool MapTransfer::isComplete() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return completeUnlocked();
+}
+
+bool MapTransfer::waitForCompletion(const float &timeoutSeconds) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return completed.wait_for(lock, std::chrono::duration<float>(timeoutSeconds), [this]() { return completeUnlocked(); });
+}
+
+bool MapTransfer::getMap(std::string *map) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!completeUnlocked() || info.total_size() == 0) {
+        return false;
+    }
+    *map = data;
+    return true;
+}
+
+bool MapTransfer::getMap(Map *map) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!completeUnlocked() || info.total_size() == 0) {
+        return false;
+    }
+    // the default limit of protobuf is too small for large maps
+    google::protobuf::io::CodedInputStream cistream(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+    #if GOOGLE_PROTOBUF_VERSION >= 3006000
+        cistream.SetTotalBytesLimit(data.size());
+    #else
+        cistream.SetTotalBytesLimit(data.size(), data.size());
+    #endif
+    return map->ParseFromCodedStream(&cistream);
+}
+
+float MapTransfer::getSecondsSinceLastChunk() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastChunk.getElapsedTime();
+}
+
+MapTransferRequest MapTransfer::getResumeRequest() {
+    MapTransferRequest request;
+    request.set_map_id(mapId);
+    request.set_transfer_id(transferId);
+    request.set_chunk_size(requestedChunkSize);
+    request.set_first_chunk(getFirstMissingChunk());
+    std::lock_guard<std::mutex> lock(mutex);
+    lastChunk.start();
+    return request;
+}
+
+
+MapTransferSender::MapTransferSender():lastTransferId(0), useCounter(0), activeTransfers(0) {}
+
+MapTransferInfo MapTransferSender::start(const MapTransferRequest &request, const std::function<bool(std::string *map)> &getMap) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto known = transfers.find(request.transfer_id());
+    if (known == transfers.end() || known->second.info.map_id() != request.map_id()) {
+        std::shared_ptr<std::string> map = std::make_shared<std::string>();
+        MapTransferInfo info;
+        info.set_transfer_id(request.transfer_id());
+        info.set_map_id(request.map_id());
+        if (getMap(map.get()) && map->size()) {
+            uint32_t chunkSize = request.chunk_size() ? request.chunk_size() : DEFAULT_CHUNK_SIZE;
+            info.set_total_size(map->size());
+            info.set_chunk_size(chunkSize);
+            info.set_chunks((map->size() + chunkSize - 1) / chunkSize);
+            info.set_checksum(std::hash<std::string>()(*map));
+        }
+        if (known != transfers.end() && known->second.nextChunk < known->second.info.chunks()) {
+            activeTransfers--;
+        }
+        Transfer &transfer = transfers[request.transfer_id()];
+        transfer.info = info;
+        transfer.map = map;
+        transfer.nextChunk = transfer.info.chunks();
+        known = transfers.find(request.transfer_id());
+    }
+    Transfer &transfer = known->second;
+    bool wasActive = transfer.nextChunk < transfer.info.chunks();
+    transfer.nextChunk = std::min(request.first_chunk(), transfer.info.chunks());
+    transfer.lastUse = ++useCounter;
+    bool isActive = transfer.nextChunk < transfer.info.chunks();
+    if (isActive != wasActive) {
+        activeTransfers += isActive ? 1 : -1;
+    }
+    MapTransferInfo info = transfer.info;
+    removeOldTransfers();
+    return info;
+}
+
+bool MapTransferSender::nextChunk(MapChunk *chunk) {
+    std::shared_ptr<const std::string> map;
+    uint64_t offset, size;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!activeTransfers) {
+            return false;
+        }
+        // round robin, starting after the transfer of the last chunk
+        auto transfer = transfers.upper_bound(lastTransferId);
+        for (size_t i = 0; i <= transfers.size(); ++i, ++transfer) {
+            if (transfer == transfers.end()) {
+                transfer = transfers.begin();
+            }
+            if (transfer->second.nextChunk < transfer->second.info.chunks()) {
+                break;
+            }
+        }
+        Transfer &active = transfer->second;
+        lastTransferId = transfer->first;
+        *chunk->mutable_info() = active.info;
+        chunk->set_index(active.nextChunk);
+        offset = static_cast<uint64_t>(active.nextChunk) * active.info.chunk_size();
+        size = std::min<uint64_t>(active.info.chunk_size(), active.map->size() - offset);
+        map = active.map;
+        active.nextChunk++;
+        if (active.nextChunk == active.info.chunks()) {
+            activeTransfers--;
+        }
+    }
+    // the snapshot is not modified, no need to copy under the lock
+    chunk->set_data(map->data() + offset, size);
+    return true;
+}
+
+bool MapTransferSender::active() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return activeTransfers > 0;
+}
+
+void MapTransferSender::removeOldTransfers() {
+    while (transfers.size() > MAX_KEPT_TRANSFERS) {
+        auto oldest = transfers.end();
+        for (auto transfer = transfers.begin(); transfer != transfers.end(); ++transfer) {
+            bool finished = transfer->second.nextChunk >= transfer->second.info.chunks();
+            if (finished && (oldest == transfers.end() || transfer->second.lastUse < oldest->second.lastUse)) {
+                oldest = transfer;
+            }
+        }
+        if (oldest == transfers.end()) {
+            // all active
+            return;
+        }
+        transfers.erase(oldest);
+    }
+}
+
+}  // namespace robot_remote_control
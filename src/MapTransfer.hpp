@@ -0,0 +1,170 @@
+#pragma once
+
+#include "Types/RobotRemoteControl.pb.h"
+#include "UpdateThread/Timer.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief controller side state of a chunked map transfer (see RobotController::startMapTransfer()).
+ * Chunks are received on the telemetry channel and may arrive in any order or more than once.
+ */
+class MapTransfer {
+ public:
+    // the buffer of a transfer is allocated in the size the robot claims, larger maps are rejected by default
+    static const uint64_t DEFAULT_MAX_SIZE = 1024 * 1024 * 1024;
+
+    /**
+     * @param maxSize maximum size of the map in bytes, transfers of larger maps are rejected
+     */
+    MapTransfer(const uint32_t &transferId, const uint32_t &mapId, const uint32_t &chunkSize,
+                const std::function<void(const float &progress)> &progressCallback = nullptr,
+                const uint64_t &maxSize = DEFAULT_MAX_SIZE);
+
+    /**
+     * @brief set the transfer parameters from the reply of the robot (or the info of a chunk),
+     * the received data is discarded if the map changed since the last info
+     *
+     * @return false if the info is inconsistent or the map is larger than the maximum size, the info is ignored then
+     */
+    bool setInfo(const MapTransferInfo &info);
+
+    /**
+     * @brief add a received chunk
+     *
+     * @return true if the transfer is complete after this chunk
+     */
+    bool addChunk(const MapChunk &chunk);
+
+    /**
+     * @brief the chunk to resume the transfer from
+     */
+    uint32_t getFirstMissingChunk();
+
+    /**
+     * @brief received fraction of the map, 0..1
+     */
+    float getProgress();
+
+    /**
+     * @brief true if all chunks are received or the robot has no such map
+     */
+    bool isComplete();
+
+    /**
+     * @brief wait until the transfer is complete, chunks are received (and the transfer resumed) by RobotController::update()
+     *
+     * @param timeoutSeconds maximum time to wait
+     * @return true if complete
+     */
+    bool waitForCompletion(const float &timeoutSeconds);
+
+    /**
+     * @brief Get the serialized map
+     *
+     * @return false if not complete or the map is not available on the robot
+     */
+    bool getMap(std::string *map);
+
+    bool getMap(Map *map);
+
+    /**
+     * @brief time since the last chunk (or the last (re)start of the transfer)
+     */
+    float getSecondsSinceLastChunk();
+
+    /**
+     * @brief the MapTransferRequest to (re)start the transfer from the first missing chunk,
+     * also restarts the timer of getSecondsSinceLastChunk()
+     */
+    MapTransferRequest getResumeRequest();
+
+    uint32_t getTransferId() const {
+        return transferId;
+    }
+
+    uint32_t getMapId() const {
+        return mapId;
+    }
+
+ private:
+    // needs a locked mutex
+    void reset(const MapTransferInfo &info);
+    bool completeUnlocked() const;
+    float progressUnlocked() const;
+
+    const uint32_t transferId;
+    const uint32_t mapId;
+    const uint32_t requestedChunkSize;
+    const uint64_t maxSize;
+    std::function<void(const float &progress)> progressCallback;
+
+    std::mutex mutex;
+    std::condition_variable completed;
+    bool hasInfo;
+    MapTransferInfo info;
+    std::string data;
+    std::vector<bool> received;
+    uint32_t receivedChunks;
+    Timer lastChunk;
+};
+
+/**
+ * @brief robot side of the chunked map transfers: keeps a snapshot of each requested map and hands out
+ * the chunks of all active transfers round robin, so a large map does not block other telemetry
+ */
+class MapTransferSender {
+ public:
+    MapTransferSender();
+
+    /**
+     * @brief start or resume a transfer
+     *
+     * @param request the request of the controller
+     * @param getMap called to get the map if the transfer is not known yet, returns false if there is no such map
+     * @return MapTransferInfo the reply to the request
+     */
+    MapTransferInfo start(const MapTransferRequest &request, const std::function<bool(std::string *map)> &getMap);
+
+    /**
+     * @brief get the next chunk of the active transfers
+     *
+     * @param chunk the chunk to fill, the data buffer is reused
+     * @return false if there is no active transfer
+     */
+    bool nextChunk(MapChunk *chunk);
+
+    /**
+     * @brief true while chunks are left to be sent
+     */
+    bool active();
+
+    static const uint32_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+    // finished transfers are kept for resume requests, the oldest ones are removed beyond this number
+    static const size_t MAX_KEPT_TRANSFERS = 8;
+
+ private:
+    struct Transfer {
+        MapTransferInfo info;
+        std::shared_ptr<const std::string> map;
+        uint32_t nextChunk;
+        uint64_t lastUse;
+    };
+
+    void removeOldTransfers();
+
+    std::mutex mutex;
+    std::map<uint32_t, Transfer> transfers;
+    uint32_t lastTransferId;
+    uint64_t useCounter;
+    size_t activeTransfers;
+};
+
+}  // namespace robot_remote_control
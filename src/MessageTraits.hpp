@@ -0,0 +1,114 @@
+#pragma once
+
+#include "MessageTypes.hpp"
+
+#include <initializer_list>
+
+namespace robot_remote_control {
+
+/**
+ * @brief compile-time mapping of a TelemetryMessageType to its protobuf type, e.g. TelemetryTraits<CURRENT_POSE>::type is Pose.
+ *
+ * Used by the typed accessors (RobotController::getTelemetry<CURRENT_POSE>(), ControlledRobot::setTelemetry<CURRENT_POSE>())
+ * to resolve the type statically and to reject mismatching types at compile time,
+ * the buffers of the default types are registered from TelemetryTypes.
+ * Types without a specialization (or unknown extension types) do not compile.
+ *
+ * Extension types (see examples/extending) add their specialization with RRC_TELEMETRY_TRAITS in the namespace robot_remote_control:
+ * @code
+ * RRC_TELEMETRY_TRAITS(NEW_TELEMETRY_MESSAGE, myrobot::NewTelemetryMessage, true)
+ * @endcode
+ */
+template <uint16_t TYPE> struct TelemetryTraits;
+
+/**
+ * @brief compile-time mapping of a ControlMessageType to the protobuf type of the command, see TelemetryTraits
+ */
+template <uint16_t TYPE> struct ControlTraits;
+
+/**
+ * @param ID the TelemetryMessageType
+ * @param PROTO the protobuf type
+ * @param BUFFERED received into a buffer by the RobotController (e.g. not the maps, which are only requested)
+ */
+#define RRC_TELEMETRY_TRAITS(ID, PROTO, BUFFERED) \
+    template <> struct TelemetryTraits<ID> { \
+        typedef PROTO type; \
+        enum : uint16_t { id = ID }; \
+        enum : bool { buffered = BUFFERED }; \
+    };
+
+#define RRC_CONTROL_TRAITS(ID, PROTO) \
+    template <> struct ControlTraits<ID> { \
+        typedef PROTO type; \
+        enum : uint16_t { id = ID }; \
+    };
+
+RRC_TELEMETRY_TRAITS(CURRENT_POSE, Pose, true)
+RRC_TELEMETRY_TRAITS(JOINT_STATE, JointState, true)
+RRC_TELEMETRY_TRAITS(CONTROLLABLE_JOINTS, JointState, true)
+RRC_TELEMETRY_TRAITS(SIMPLE_ACTIONS, SimpleActions, true)
+RRC_TELEMETRY_TRAITS(COMPLEX_ACTIONS, ComplexActions, true)
+RRC_TELEMETRY_TRAITS(ROBOT_NAME, RobotName, true)
+RRC_TELEMETRY_TRAITS(ROBOT_STATE, RobotState, true)
+RRC_TELEMETRY_TRAITS(LOG_MESSAGE, LogMessage, true)
+RRC_TELEMETRY_TRAITS(VIDEO_STREAMS, VideoStreams, true)
+RRC_TELEMETRY_TRAITS(SIMPLE_SENSOR_DEFINITION, SimpleSensors, true)
+// simple sensors are stored in a separate buffer per sensor when receiving
+RRC_TELEMETRY_TRAITS(SIMPLE_SENSOR_VALUE, SimpleSensor, false)
+RRC_TELEMETRY_TRAITS(WRENCH_STATE, WrenchState, true)
+RRC_TELEMETRY_TRAITS(MAPS_DEFINITION, MapsDefinition, false)
+RRC_TELEMETRY_TRAITS(MAP, Map, false)
+RRC_TELEMETRY_TRAITS(POSES, Poses, true)
+RRC_TELEMETRY_TRAITS(TRANSFORMS, Transforms, true)
+RRC_TELEMETRY_TRAITS(PERMISSION_REQUEST, PermissionRequest, true)
+RRC_TELEMETRY_TRAITS(POINTCLOUD, PointCloud, true)
+RRC_TELEMETRY_TRAITS(IMU_VALUES, IMU, true)
+RRC_TELEMETRY_TRAITS(CONTACT_POINTS, ContactPoints, true)
+RRC_TELEMETRY_TRAITS(CURRENT_TWIST, Twist, true)
+RRC_TELEMETRY_TRAITS(CURRENT_ACCELERATION, Acceleration, true)
+RRC_TELEMETRY_TRAITS(ROBOT_STATISTICS, RobotStatistics, true)
+RRC_TELEMETRY_TRAITS(STATIC_TRANSFORMS, Transforms, true)
+RRC_TELEMETRY_TRAITS(SIMPLE_SENSOR_VALUES, SimpleSensors, false)
+RRC_TELEMETRY_TRAITS(IMAGE_FRAME, ImageFrame, true)
+// batched logs are split into the buffer of LOG_MESSAGE when receiving
+RRC_TELEMETRY_TRAITS(LOG_MESSAGES, LogMessages, false)
+
+RRC_CONTROL_TRAITS(TARGET_POSE_COMMAND, Pose)
+RRC_CONTROL_TRAITS(TWIST_COMMAND, Twist)
+RRC_CONTROL_TRAITS(JOINTS_COMMAND, JointCommand)
+RRC_CONTROL_TRAITS(SIMPLE_ACTIONS_COMMAND, SimpleAction)
+RRC_CONTROL_TRAITS(COMPLEX_ACTION_COMMAND, ComplexAction)
+RRC_CONTROL_TRAITS(GOTO_COMMAND, GoTo)
+RRC_CONTROL_TRAITS(HEARTBEAT, HeartBeat)
+RRC_CONTROL_TRAITS(PERMISSION, Permission)
+RRC_CONTROL_TRAITS(ROBOT_TRAJECTORY_COMMAND, Poses)
+RRC_CONTROL_TRAITS(ROBOT_TRAJECTORY_UPDATE, TrajectoryUpdate)
+RRC_CONTROL_TRAITS(IMAGE_STREAM_CONFIG, ImageStreamConfigs)
+RRC_CONTROL_TRAITS(CAPABILITIES, Capabilities)
+
+/**
+ * @brief a list of telemetry types known at compile time
+ *
+ * forEach() calls visitor.template visit<TYPE>() for each type in the order of the list,
+ * so a registration can be generated for all types without repeating the type mapping.
+ */
+template <uint16_t... TYPES> struct TelemetryTypeList {
+    enum : size_t { size = sizeof...(TYPES) };
+
+    template <class VISITOR> static void forEach(VISITOR &&visitor) {
+        // expands to one call per type, in order
+        (void)std::initializer_list<int>{(visitor.template visit<TYPES>(), 0)...};
+    }
+};
+
+/**
+ * @brief all telemetry types of this library with a protobuf type
+ */
+typedef TelemetryTypeList<CURRENT_POSE, JOINT_STATE, CONTROLLABLE_JOINTS, SIMPLE_ACTIONS, COMPLEX_ACTIONS, ROBOT_NAME, ROBOT_STATE,
+                          LOG_MESSAGE, VIDEO_STREAMS, SIMPLE_SENSOR_DEFINITION, SIMPLE_SENSOR_VALUE, WRENCH_STATE, MAPS_DEFINITION, MAP,
+                          POSES, TRANSFORMS, PERMISSION_REQUEST, POINTCLOUD, IMU_VALUES, CONTACT_POINTS, CURRENT_TWIST,
+                          CURRENT_ACCELERATION, ROBOT_STATISTICS, STATIC_TRANSFORMS, SIMPLE_SENSOR_VALUES, IMAGE_FRAME,
+                          LOG_MESSAGES> TelemetryTypes;
+
+}  // namespace robot_remote_control
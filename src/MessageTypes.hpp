@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Types/RobotRemoteControl.pb.h"
+#include "WireHeader.hpp"
 
 namespace robot_remote_control {
 
@@ -21,9 +22,33 @@ namespace robot_remote_control {
                             HEARTBEAT,
                             PERMISSION,
                             ROBOT_TRAJECTORY_COMMAND,
+                            TELEMETRY_RATE_LIMITS,   // set maximum rates/decimation of telemetry types
+                            POINTCLOUD_ENCODING,     // select the encoding of point clouds and point cloud maps
+                            MAP_TILES_REQUEST,       // request the tiles of a tiled map that changed since a known version
+                            MAP_TRANSFER_REQUEST,    // start/resume sending a map in chunks on the telemetry channel
+                            JOINT_NAME_TABLE,        // [uint64_t table id] enable compact JointState/JointCommand, 0 disables
+                            WIRE_HEADER_VERSION,     // [uint8_t version] select the telemetry header (WireHeader), 0 is the plain type header
+                            DESCRIPTION_VERSIONS,    // content hashes of cached descriptions, the reply has the changed payloads (DescriptionCache)
+                            TELEMETRY_BULK_REQUEST,  // [uint16_t type]... the reply is a TELEMETRY_BATCH payload of the latest messages of the types
+                            ROBOT_TRAJECTORY_UPDATE, // edit the trajectory of the last ROBOT_TRAJECTORY_COMMAND in place (TrajectoryUpdate)
+                            IMAGE_STREAM_CONFIG,     // rate, decimation and resolution of camera streams (ImageStreamConfigs)
+                            SESSION_RESUME,          // [uint64_t session id]([uint16_t type][uint32_t last sequence])... the reply is the session id
+                                                     // of the robot and a TELEMETRY_BATCH payload of the types that changed since
+                            CAPABILITIES,            // the features supported by the controller (Capabilities), the reply has the selected ones
                             CONTROL_MESSAGE_TYPE_NUMBER  // LAST element
                             };
 
+    /**
+     * @brief set in the ControlMessageType header, if a uint32_t request id follows the type.
+     * The robot puts the same id in front of the reply, so replies can be matched to pipelined requests
+     */
+    const uint16_t REQUEST_ID_FLAG = 0x8000;
+
+    /**
+     * @brief exchanged in the CAPABILITIES handshake, raised when the meaning of existing messages changes
+     */
+    const uint32_t PROTOCOL_VERSION = 1;
+
     enum TelemetryMessageType : uint16_t { NO_TELEMETRY_DATA = 0,
                                 CURRENT_POSE,               // the current Pose of the robot base
                                 JOINT_STATE,                // current Joint values
@@ -47,6 +72,15 @@ namespace robot_remote_control {
                                 CONTACT_POINTS,             // contact points
                                 CURRENT_TWIST,              // the current movement speeds of the robot
                                 CURRENT_ACCELERATION,       // the current movement accelerations of the robot
+                                TELEMETRY_BATCH,            // several telemetry messages in one message ([uint16_t type][uint32_t size][payload] each)
+                                MAP_CHUNK,                  // part of a map transfer (MAP_TRANSFER_REQUEST)
+                                ROBOT_STATISTICS,           // send-side statistics of the robot (ControlledRobot::setStatisticsPublishInterval())
+                                STATIC_TRANSFORMS,          // transforms that do not change, sent once (ControlledRobot::setStaticTransforms())
+                                SIMPLE_SENSOR_VALUES,       // values of many simple sensors in one message (SimpleSensors)
+                                IMAGE_FRAME,                // compressed camera frame (ImageFrame)
+                                TELEMETRY_CHUNK,            // part of a big telemetry message ([uint16_t type][uint32_t message id][uint32_t offset][uint32_t message size][bytes]),
+                                                            // sent by the queue of ControlledRobot::setAsyncTelemetry()
+                                LOG_MESSAGES,               // batched log messages (LogMessages), buffered as LOG_MESSAGE by the controller
                                 TELEMETRY_MESSAGE_TYPES_NUMBER  // LAST element
                             };
 
@@ -0,0 +1,202 @@
+#include "MetricsExporter.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace robot_remote_control {
+
+namespace {
+    // poll interval of the server thread to notice stopHttpServer()
+    const int stopCheckMs = 200;
+    // time a client has to send its request
+    const int requestTimeoutMs = 1000;
+    const size_t maxRequestSize = 4096;
+
+    bool sendAll(const int &socket, const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t result = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (result <= 0) {
+                return false;
+            }
+            sent += result;
+        }
+        return true;
+    }
+}
+
+MetricsExporter::MetricsExporter():serverSocket(-1), httpPort(0), running(false) {}
+
+MetricsExporter::~MetricsExporter() {
+    stopHttpServer();
+}
+
+void MetricsExporter::addCollector(const Collector &collector) {
+    std::lock_guard<std::mutex> lock(collectorsMutex);
+    collectors.push_back(collector);
+}
+
+std::string MetricsExporter::collect() {
+    std::string out;
+    std::lock_guard<std::mutex> lock(collectorsMutex);
+    for (const Collector &collector : collectors) {
+        collector(&out);
+    }
+    return out;
+}
+
+bool MetricsExporter::writeFile(const std::string &path) {
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "w");
+    if (!file) {
+        printf("unable to write metrics to %s\n", temporary.c_str());
+        return false;
+    }
+    std::string metrics = collect();
+    bool written = fwrite(metrics.data(), 1, metrics.size(), file) == metrics.size();
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        printf("unable to write metrics to %s\n", path.c_str());
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MetricsExporter::startHttpServer(const uint16_t &port, const std::string &address) {
+    if (running.load()) {
+        return false;
+    }
+    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (serverSocket < 0) {
+        printf("unable to create the metrics socket: %s\n", strerror(errno));
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in socketAddress;
+    memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sin_family = AF_INET;
+    socketAddress.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &socketAddress.sin_addr) != 1
+        || bind(serverSocket, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0
+        || listen(serverSocket, 8) != 0) {
+        printf("unable to serve metrics on %s:%u: %s\n", address.c_str(), port, strerror(errno));
+        close(serverSocket);
+        serverSocket = -1;
+        return false;
+    }
+    socklen_t length = sizeof(socketAddress);
+    getsockname(serverSocket, reinterpret_cast<sockaddr*>(&socketAddress), &length);
+    httpPort.store(ntohs(socketAddress.sin_port));
+
+    running.store(true);
+    serverThread = std::thread(&MetricsExporter::serve, this);
+    return true;
+}
+
+void MetricsExporter::stopHttpServer() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    serverThread.join();
+    close(serverSocket);
+    serverSocket = -1;
+    httpPort.store(0);
+}
+
+void MetricsExporter::serve() {
+    while (running.load()) {
+        pollfd server = {serverSocket, POLLIN, 0};
+        if (poll(&server, 1, stopCheckMs) <= 0) {
+            continue;
+        }
+        int client = accept(serverSocket, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        answer(client);
+        close(client);
+    }
+}
+
+void MetricsExporter::answer(const int &client) {
+    // read the request line and headers, a body is not expected
+    std::string request;
+    char buffer[512];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < maxRequestSize) {
+        pollfd poller = {client, POLLIN, 0};
+        if (poll(&poller, 1, requestTimeoutMs) <= 0) {
+            return;
+        }
+        ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, received);
+    }
+
+    std::string status = "200 OK";
+    std::string body;
+    if (request.compare(0, 4, "GET ") != 0) {
+        status = "405 Method Not Allowed";
+    } else if (request.compare(4, 9, "/metrics ") != 0 && request.compare(4, 9, "/metrics?") != 0 && request.compare(4, 2, "/ ") != 0) {
+        status = "404 Not Found";
+    } else {
+        body = collect();
+    }
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+                           "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+    sendAll(client, response);
+}
+
+void MetricsExporter::appendFamily(std::string *out, const std::string &name, const std::string &type, const std::string &help) {
+    out->append("# HELP " + name + " " + help + "\n");
+    out->append("# TYPE " + name + " " + type + "\n");
+}
+
+void MetricsExporter::appendSample(std::string *out, const std::string &name, const std::string &labels, const double &value) {
+    out->append(name);
+    if (labels.size()) {
+        out->append("{" + labels + "}");
+    }
+    char number[32];
+    if (std::isnan(value)) {
+        snprintf(number, sizeof(number), " NaN\n");
+    } else if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        // counters without exponent
+        snprintf(number, sizeof(number), " %.0f\n", value);
+    } else {
+        snprintf(number, sizeof(number), " %.9g\n", value);
+    }
+    out->append(number);
+}
+
+std::string MetricsExporter::label(const std::string &name, const std::string &value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (const char &c : value) {
+        if (c == '\\' || c == '"') {
+            escaped.push_back('\\');
+            escaped.push_back(c);
+        } else if (c == '\n') {
+            escaped.append("\\n");
+        } else {
+            escaped.push_back(c);
+        }
+    }
+    return name + "=\"" + escaped + "\"";
+}
+
+}  // namespace robot_remote_control
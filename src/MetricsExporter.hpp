@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief serves metrics in the Prometheus text format (version 0.0.4, also read by OpenMetrics scrapers)
+ * over a minimal HTTP endpoint (GET /metrics) or writes them into a text file (e.g. for the textfile collector of the node_exporter).
+ *
+ * The metrics are provided by collectors, e.g. Statistics::appendMetrics() and ReceiveStatistics::appendMetrics(),
+ * which only read the lock-free counters, so scraping does not block the sending and receiving threads:
+ * @code
+ *  MetricsExporter exporter;
+ *  exporter.addCollector([&robot](std::string *out) { robot.getStatistics().appendMetrics(out); });
+ *  exporter.startHttpServer(9464);
+ * @endcode
+ */
+class MetricsExporter {
+ public:
+    typedef std::function<void(std::string *out)> Collector;
+
+    MetricsExporter();
+    ~MetricsExporter();
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    /**
+     * @brief add a source of metrics, called on every scrape from the scraping thread
+     */
+    void addCollector(const Collector &collector);
+
+    /**
+     * @brief the metrics of all collectors
+     */
+    std::string collect();
+
+    /**
+     * @brief write the metrics into a file, replaced atomically (rename), so readers never see a partial file
+     *
+     * @return false if the file could not be written
+     */
+    bool writeFile(const std::string &path);
+
+    /**
+     * @brief serve the metrics in a thread
+     *
+     * @param port the port, 0 to choose a free one (see getHttpPort())
+     * @param address the address to listen on
+     * @return false if the port could not be opened
+     */
+    bool startHttpServer(const uint16_t &port, const std::string &address = "0.0.0.0");
+
+    void stopHttpServer();
+
+    /**
+     * @brief the port of the running server, 0 if not running
+     */
+    uint16_t getHttpPort() const {
+        return httpPort.load();
+    }
+
+    // helpers for the collectors
+
+    /**
+     * @brief append the # HELP and # TYPE lines of a metric family
+     *
+     * @param type counter, gauge or summary
+     */
+    static void appendFamily(std::string *out, const std::string &name, const std::string &type, const std::string &help);
+
+    /**
+     * @brief append a sample
+     *
+     * @param labels e.g. label("type", "3") + "," + label("name", "Pose"), empty for none
+     */
+    static void appendSample(std::string *out, const std::string &name, const std::string &labels, const double &value);
+
+    /**
+     * @brief a label with an escaped value
+     */
+    static std::string label(const std::string &name, const std::string &value);
+
+ private:
+    void serve();
+    void answer(const int &client);
+
+    std::mutex collectorsMutex;
+    std::vector<Collector> collectors;
+
+    int serverSocket;
+    std::atomic<uint16_t> httpPort;
+    std::atomic<bool> running;
+    std::thread serverThread;
+};
+
+}  // namespace robot_remote_control
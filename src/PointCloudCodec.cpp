@@ -0,0 +1,249 @@
+#include "PointCloudCodec.hpp"
+#include "Types/Conversions/PackedPointCloud.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+namespace robot_remote_control {
+namespace PointCloudCodec {
+
+namespace {
+
+    // 21 bits per axis fit into the 63 bit morton codes
+    const uint32_t MAX_OCTREE_DEPTH = 21;
+
+    struct Extent {
+        float min[3];
+        float max[3];
+    };
+
+    Extent getExtent(const PackedPointCloud::Point* points, const size_t &count) {
+        Extent extent = {{0, 0, 0}, {0, 0, 0}};
+        if (!count) {
+            return extent;
+        }
+        extent.min[0] = extent.max[0] = points[0].x;
+        extent.min[1] = extent.max[1] = points[0].y;
+        extent.min[2] = extent.max[2] = points[0].z;
+        for (size_t i = 1; i < count; ++i) {
+            const float values[3] = {points[i].x, points[i].y, points[i].z};
+            for (int axis = 0; axis < 3; ++axis) {
+                extent.min[axis] = std::min(extent.min[axis], values[axis]);
+                extent.max[axis] = std::max(extent.max[axis], values[axis]);
+            }
+        }
+        return extent;
+    }
+
+    uint32_t voxelIndex(const float &value, const float &min, const float &resolution) {
+        return static_cast<uint32_t>(std::floor((value - min) / resolution));
+    }
+
+    uint64_t mortonCode(const uint32_t &x, const uint32_t &y, const uint32_t &z, const uint32_t &depth) {
+        uint64_t code = 0;
+        for (uint32_t bit = 0; bit < depth; ++bit) {
+            code |= static_cast<uint64_t>((x >> bit) & 1) << (3 * bit + 2);
+            code |= static_cast<uint64_t>((y >> bit) & 1) << (3 * bit + 1);
+            code |= static_cast<uint64_t>((z >> bit) & 1) << (3 * bit);
+        }
+        return code;
+    }
+
+    void mortonDecode(const uint64_t &code, const uint32_t &depth, uint32_t *x, uint32_t *y, uint32_t *z) {
+        *x = *y = *z = 0;
+        for (uint32_t bit = 0; bit < depth; ++bit) {
+            *x |= static_cast<uint32_t>((code >> (3 * bit + 2)) & 1) << bit;
+            *y |= static_cast<uint32_t>((code >> (3 * bit + 1)) & 1) << bit;
+            *z |= static_cast<uint32_t>((code >> (3 * bit)) & 1) << bit;
+        }
+    }
+
+    void setOffset(PointCloud *cloud, const Extent &extent, const float &resolution) {
+        Position *offset = cloud->mutable_quantization_offset();
+        offset->set_x(extent.min[0]);
+        offset->set_y(extent.min[1]);
+        offset->set_z(extent.min[2]);
+        cloud->set_resolution(resolution);
+    }
+
+    bool encodeQuantized(PointCloud *cloud, const float &resolution) {
+        const size_t count = PackedPointCloud::size(*cloud);
+        const PackedPointCloud::Point* points = PackedPointCloud::points(*cloud);
+        Extent extent = getExtent(points, count);
+        for (int axis = 0; axis < 3; ++axis) {
+            if (voxelIndex(extent.max[axis], extent.min[axis], resolution) > UINT16_MAX) {
+                return false;
+            }
+        }
+
+        std::string quantized;
+        quantized.resize(count * 3 * sizeof(uint16_t));
+        uint16_t* target = reinterpret_cast<uint16_t*>(&quantized[0]);
+        for (size_t i = 0; i < count; ++i) {
+            *target++ = voxelIndex(points[i].x, extent.min[0], resolution);
+            *target++ = voxelIndex(points[i].y, extent.min[1], resolution);
+            *target++ = voxelIndex(points[i].z, extent.min[2], resolution);
+        }
+        cloud->clear_packed_points();
+        cloud->set_quantized_points(std::move(quantized));
+        setOffset(cloud, extent, resolution);
+        return true;
+    }
+
+    bool encodeOctree(PointCloud *cloud, const float &resolution) {
+        const size_t count = PackedPointCloud::size(*cloud);
+        const PackedPointCloud::Point* points = PackedPointCloud::points(*cloud);
+        Extent extent = getExtent(points, count);
+
+        uint32_t maxIndex = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            float voxels = std::floor((extent.max[axis] - extent.min[axis]) / resolution);
+            if (voxels >= (1 << MAX_OCTREE_DEPTH)) {
+                return false;
+            }
+            maxIndex = std::max(maxIndex, static_cast<uint32_t>(voxels));
+        }
+        // at least one level, so an empty octree is an empty cloud
+        uint32_t depth = 1;
+        while ((maxIndex >> depth) > 0) {
+            depth++;
+        }
+
+        std::vector<uint64_t> codes(count);
+        for (size_t i = 0; i < count; ++i) {
+            codes[i] = mortonCode(voxelIndex(points[i].x, extent.min[0], resolution),
+                                  voxelIndex(points[i].y, extent.min[1], resolution),
+                                  voxelIndex(points[i].z, extent.min[2], resolution), depth);
+        }
+        std::sort(codes.begin(), codes.end());
+        codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+
+        // the nodes of each level are in sorted order, which is the order the decoder creates them
+        std::string octree;
+        for (uint32_t level = 0; level < depth && codes.size(); ++level) {
+            const uint32_t childShift = 3 * (depth - level - 1);
+            uint64_t node = codes.front() >> (childShift + 3);
+            uint8_t mask = 0;
+            for (const uint64_t &code : codes) {
+                if ((code >> (childShift + 3)) != node) {
+                    octree.push_back(mask);
+                    node = code >> (childShift + 3);
+                    mask = 0;
+                }
+                mask |= 1 << ((code >> childShift) & 7);
+            }
+            octree.push_back(mask);
+        }
+
+        cloud->clear_packed_points();
+        cloud->clear_channels();
+        cloud->set_octree(std::move(octree));
+        cloud->set_octree_depth(depth);
+        setOffset(cloud, extent, resolution);
+        return true;
+    }
+
+    void decodeQuantized(PointCloud *cloud) {
+        const std::string &quantized = cloud->quantized_points();
+        const size_t count = quantized.size() / (3 * sizeof(uint16_t));
+        const Position &offset = cloud->quantization_offset();
+        const float resolution = cloud->resolution();
+
+        std::string packed;
+        packed.resize(count * sizeof(PackedPointCloud::Point));
+        PackedPointCloud::Point* target = reinterpret_cast<PackedPointCloud::Point*>(&packed[0]);
+        const uint16_t* source = reinterpret_cast<const uint16_t*>(quantized.data());
+        for (size_t i = 0; i < count; ++i) {
+            target[i].x = offset.x() + (source[0] + 0.5) * resolution;
+            target[i].y = offset.y() + (source[1] + 0.5) * resolution;
+            target[i].z = offset.z() + (source[2] + 0.5) * resolution;
+            source += 3;
+        }
+        cloud->clear_quantized_points();
+        cloud->set_packed_points(std::move(packed));
+    }
+
+    bool decodeOctree(PointCloud *cloud) {
+        const std::string &octree = cloud->octree();
+        const uint32_t depth = cloud->octree_depth();
+        if (depth == 0 || depth > MAX_OCTREE_DEPTH) {
+            return false;
+        }
+        std::vector<uint64_t> nodes(1, 0);
+        std::vector<uint64_t> children;
+        size_t pos = 0;
+        for (uint32_t level = 0; level < depth; ++level) {
+            children.clear();
+            for (const uint64_t &node : nodes) {
+                if (pos >= octree.size()) {
+                    printf("incomplete octree in %s:%i\n", __FILE__, __LINE__);
+                    return false;
+                }
+                uint8_t mask = octree[pos++];
+                for (uint64_t child = 0; child < 8; ++child) {
+                    if (mask & (1 << child)) {
+                        children.push_back((node << 3) | child);
+                    }
+                }
+            }
+            nodes.swap(children);
+        }
+
+        const Position &offset = cloud->quantization_offset();
+        const float resolution = cloud->resolution();
+        PackedPointCloud::Point* target = PackedPointCloud::resize(cloud, nodes.size());
+        for (const uint64_t &code : nodes) {
+            uint32_t x, y, z;
+            mortonDecode(code, depth, &x, &y, &z);
+            *target++ = {static_cast<float>(offset.x() + (x + 0.5) * resolution),
+                         static_cast<float>(offset.y() + (y + 0.5) * resolution),
+                         static_cast<float>(offset.z() + (z + 0.5) * resolution)};
+        }
+        cloud->clear_octree();
+        cloud->clear_octree_depth();
+        return true;
+    }
+
+}  // namespace
+
+bool encode(PointCloud *cloud, const PointCloudEncoding &encoding) {
+    if (encoding.type() == UNENCODED_POINTCLOUD) {
+        return true;
+    }
+    decode(cloud);
+    PackedPointCloud::pack(cloud);
+    if (encoding.type() == PACKED_POINTCLOUD) {
+        return true;
+    }
+    if (!(encoding.resolution() > 0)) {
+        printf("invalid point cloud resolution %f\n", encoding.resolution());
+        return false;
+    }
+    switch (encoding.type()) {
+        case QUANTIZED_POINTCLOUD: return encodeQuantized(cloud, encoding.resolution());
+        case OCTREE_POINTCLOUD: return encodeOctree(cloud, encoding.resolution());
+        default: return false;
+    }
+}
+
+bool decode(PointCloud *cloud) {
+    bool encoded = false;
+    if (cloud->quantized_points().size()) {
+        decodeQuantized(cloud);
+        encoded = true;
+    }
+    if (cloud->octree().size()) {
+        encoded = decodeOctree(cloud);
+    }
+    if (encoded) {
+        cloud->clear_resolution();
+        cloud->clear_quantization_offset();
+    }
+    return encoded;
+}
+
+}  // namespace PointCloudCodec
+}  // namespace robot_remote_control
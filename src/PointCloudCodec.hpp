@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Types/RobotRemoteControl.pb.h"
+
+namespace robot_remote_control {
+
+/**
+ * @brief lossy encodings of PointCloud, positions are stored in voxels of size resolution
+ * relative to the minimum of the cloud (quantization_offset).
+ *
+ * QUANTIZED_POINTCLOUD: uint16 x,y,z per point, point order and channels are kept
+ * OCTREE_POINTCLOUD: one child mask byte per occupied octree node, one point per occupied voxel (channels are dropped)
+ */
+namespace PointCloudCodec {
+
+    /**
+     * @brief encode the cloud in place
+     *
+     * @param cloud the cloud to encode (packed, unpacked or already encoded)
+     * @param encoding the encoding and resolution
+     * @return true if encoded as requested, false if the cloud was left packed (invalid resolution or the extent is too large)
+     */
+    bool encode(PointCloud *cloud, const PointCloudEncoding &encoding);
+
+    /**
+     * @brief decode quantized or octree points to packed_points, packed and unpacked clouds are not changed
+     *
+     * @return true if the cloud was encoded
+     */
+    bool decode(PointCloud *cloud);
+
+}  // namespace PointCloudCodec
+}  // namespace robot_remote_control
@@ -0,0 +1,293 @@
+#include "ReceiveStatistics.hpp"
+#include "MetricsExporter.hpp"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+namespace robot_remote_control {
+
+namespace {
+    const int64_t unknown = std::numeric_limits<int64_t>::min();
+
+    int64_t steadyNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void printSummary(const char* name, const LatencyHistogram::Summary &summary) {
+        printf("    %s us: count %llu, min %llu, p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, max %llu\n", name,
+               (unsigned long long)summary.count, (unsigned long long)summary.min, (unsigned long long)summary.p50,
+               (unsigned long long)summary.p90, (unsigned long long)summary.p99, (unsigned long long)summary.p999,
+               (unsigned long long)summary.max);
+    }
+}
+
+ReceiveStatistics::TelemetryData::TelemetryData() {
+    reset();
+}
+
+void ReceiveStatistics::TelemetryData::reset() {
+    interArrival.reset();
+    age.reset();
+    messages.store(0);
+    bytes.store(0);
+    firstArrivalNs.store(0);
+    lastArrivalNs.store(0);
+    jitterUs.store(0);
+    lastTransitUs = unknown;
+    lastInterArrivalUs = unknown;
+}
+
+ReceiveStatistics::ReceiveStatistics() {
+    for (std::atomic<TelemetryData*> &data : telemetry) {
+        data.store(nullptr);
+    }
+    for (std::atomic<LatencyHistogram*> &histogram : requests) {
+        histogram.store(nullptr);
+    }
+    #ifdef RRC_STATISTICS
+        enabled.store(true);
+    #else
+        enabled.store(false);
+    #endif
+}
+
+ReceiveStatistics::~ReceiveStatistics() {
+    for (std::atomic<TelemetryData*> &data : telemetry) {
+        delete data.load();
+    }
+    for (std::atomic<LatencyHistogram*> &histogram : requests) {
+        delete histogram.load();
+    }
+}
+
+void ReceiveStatistics::addReceived(const uint16_t &type, const size_t &bytes, const int64_t &ageUs) {
+    if (type >= telemetry.size()) {
+        return;
+    }
+    TelemetryData* data = getOrCreate(&telemetry[type]);
+    int64_t now = steadyNs();
+    int64_t last = data->lastArrivalNs.load(std::memory_order_relaxed);
+    int64_t interArrivalUs = unknown;
+    if (data->messages.load(std::memory_order_relaxed)) {
+        interArrivalUs = (now - last) / 1000;
+        data->interArrival.record(interArrivalUs);
+    } else {
+        data->firstArrivalNs.store(now, std::memory_order_relaxed);
+    }
+    data->lastArrivalNs.store(now, std::memory_order_relaxed);
+    data->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    data->messages.fetch_add(1, std::memory_order_relaxed);
+
+    // the difference of consecutive transit times (or inter-arrival times if there are no TimeStamps)
+    int64_t difference = unknown;
+    if (ageUs >= 0) {
+        data->age.record(ageUs);
+        if (data->lastTransitUs != unknown) {
+            difference = ageUs - data->lastTransitUs;
+        }
+        data->lastTransitUs = ageUs;
+    } else if (interArrivalUs != unknown) {
+        if (data->lastInterArrivalUs != unknown) {
+            difference = interArrivalUs - data->lastInterArrivalUs;
+        }
+        data->lastInterArrivalUs = interArrivalUs;
+    }
+    if (difference != unknown) {
+        double jitter = data->jitterUs.load(std::memory_order_relaxed);
+        data->jitterUs.store(jitter + (std::llabs(difference) - jitter) / 16.0, std::memory_order_relaxed);
+    }
+}
+
+void ReceiveStatistics::addRoundTrip(const uint16_t &type, const float &seconds) {
+    uint64_t us = seconds > 0 ? static_cast<uint64_t>(seconds * 1000000.0) : 0;
+    roundTrips.record(us);
+    if (type < requests.size()) {
+        getOrCreate(&requests[type])->record(us);
+    }
+}
+
+ReceiveStatistics::TypeStats ReceiveStatistics::getTelemetryStats(const uint16_t &type) const {
+    TypeStats stats;
+    if (type >= telemetry.size()) {
+        return stats;
+    }
+    if (bufferedBytesReader) {
+        stats.bufferedBytes = bufferedBytesReader(type);
+    }
+    const TelemetryData* data = telemetry[type].load(std::memory_order_acquire);
+    if (!data) {
+        return stats;
+    }
+    stats.messages = data->messages.load(std::memory_order_relaxed);
+    stats.bytes = data->bytes.load(std::memory_order_relaxed);
+    double seconds = (data->lastArrivalNs.load(std::memory_order_relaxed) - data->firstArrivalNs.load(std::memory_order_relaxed)) / 1000000000.0;
+    if (stats.messages > 1 && seconds > 0) {
+        // the first message starts the measurement
+        stats.messagesPerSecond = (stats.messages - 1) / seconds;
+        stats.bytesPerSecond = stats.bytes * (stats.messages - 1) / static_cast<double>(stats.messages) / seconds;
+    }
+    stats.jitterUs = data->jitterUs.load(std::memory_order_relaxed);
+    stats.interArrivalUs = data->interArrival.summary();
+    stats.ageUs = data->age.summary();
+    return stats;
+}
+
+LatencyHistogram::Summary ReceiveStatistics::getRoundTrip(const uint16_t &type) const {
+    if (type >= requests.size()) {
+        return LatencyHistogram::Summary();
+    }
+    const LatencyHistogram* histogram = requests[type].load(std::memory_order_acquire);
+    return histogram ? histogram->summary() : LatencyHistogram::Summary();
+}
+
+std::vector<uint16_t> ReceiveStatistics::getReceivedTypes() const {
+    std::vector<uint16_t> types;
+    for (size_t type = 0; type < telemetry.size(); ++type) {
+        const TelemetryData* data = telemetry[type].load(std::memory_order_acquire);
+        if (data && data->messages.load(std::memory_order_relaxed)) {
+            types.push_back(type);
+        }
+    }
+    return types;
+}
+
+void ReceiveStatistics::print() const {
+    printf("requests:\n");
+    printSummary("round trip", getRoundTrip());
+    for (const uint16_t &type : getReceivedTypes()) {
+        TypeStats stats = getTelemetryStats(type);
+        printf("%s (%u): %llu messages, %.1f/s, %.2f kBytes/s, jitter %.0f us, %.2f kBytes buffered\n", names[type].c_str(), type,
+               (unsigned long long)stats.messages, stats.messagesPerSecond, stats.bytesPerSecond / 1000.0, stats.jitterUs,
+               stats.bufferedBytes / 1000.0);
+        printSummary("inter-arrival", stats.interArrivalUs);
+        if (stats.ageUs.count) {
+            printSummary("age", stats.ageUs);
+        }
+    }
+}
+
+namespace {
+    void appendSummary(std::string *out, const std::string &name, const std::string &labels, const LatencyHistogram::Summary &summary) {
+        const std::string separator = labels.size() ? "," : "";
+        MetricsExporter::appendSample(out, name, labels + separator + MetricsExporter::label("quantile", "0.5"), summary.p50);
+        MetricsExporter::appendSample(out, name, labels + separator + MetricsExporter::label("quantile", "0.9"), summary.p90);
+        MetricsExporter::appendSample(out, name, labels + separator + MetricsExporter::label("quantile", "0.99"), summary.p99);
+        MetricsExporter::appendSample(out, name, labels + separator + MetricsExporter::label("quantile", "0.999"), summary.p999);
+        MetricsExporter::appendSample(out, name + "_sum", labels, summary.mean * summary.count);
+        MetricsExporter::appendSample(out, name + "_count", labels, summary.count);
+    }
+}
+
+void ReceiveStatistics::appendMetrics(std::string *out, const std::string &prefix) const {
+    std::vector<uint16_t> types = getReceivedTypes();
+    std::vector<std::string> labels;
+    std::vector<TypeStats> stats;
+    for (const uint16_t &type : types) {
+        labels.push_back(MetricsExporter::label("type", std::to_string(type)) + "," + MetricsExporter::label("name", names[type]));
+        stats.push_back(getTelemetryStats(type));
+    }
+
+    MetricsExporter::appendFamily(out, prefix + "_messages_total", "counter", "received telemetry messages");
+    for (size_t i = 0; i < types.size(); ++i) {
+        MetricsExporter::appendSample(out, prefix + "_messages_total", labels[i], stats[i].messages);
+    }
+    MetricsExporter::appendFamily(out, prefix + "_bytes_total", "counter", "bytes of the received telemetry");
+    for (size_t i = 0; i < types.size(); ++i) {
+        MetricsExporter::appendSample(out, prefix + "_bytes_total", labels[i], stats[i].bytes);
+    }
+    if (bufferedBytesReader) {
+        MetricsExporter::appendFamily(out, prefix + "_buffered_bytes", "gauge", "memory of the messages in the receive buffer");
+        for (size_t i = 0; i < types.size(); ++i) {
+            MetricsExporter::appendSample(out, prefix + "_buffered_bytes", labels[i], stats[i].bufferedBytes);
+        }
+    }
+    MetricsExporter::appendFamily(out, prefix + "_jitter_microseconds", "gauge", "smoothed variation of the transit time (RFC 3550)");
+    for (size_t i = 0; i < types.size(); ++i) {
+        MetricsExporter::appendSample(out, prefix + "_jitter_microseconds", labels[i], stats[i].jitterUs);
+    }
+    MetricsExporter::appendFamily(out, prefix + "_inter_arrival_microseconds", "summary", "time between received messages");
+    for (size_t i = 0; i < types.size(); ++i) {
+        appendSummary(out, prefix + "_inter_arrival_microseconds", labels[i], stats[i].interArrivalUs);
+    }
+    MetricsExporter::appendFamily(out, prefix + "_age_microseconds", "summary", "receive time - TimeStamp of the message");
+    for (size_t i = 0; i < types.size(); ++i) {
+        if (stats[i].ageUs.count) {
+            appendSummary(out, prefix + "_age_microseconds", labels[i], stats[i].ageUs);
+        }
+    }
+
+    MetricsExporter::appendFamily(out, prefix + "_round_trip_microseconds", "summary", "round trip time of the requests");
+    for (size_t type = 0; type < requests.size(); ++type) {
+        LatencyHistogram::Summary summary = getRoundTrip(type);
+        if (summary.count) {
+            appendSummary(out, prefix + "_round_trip_microseconds", MetricsExporter::label("type", std::to_string(type)), summary);
+        }
+    }
+}
+
+void ReceiveStatistics::reset() {
+    for (std::atomic<TelemetryData*> &data : telemetry) {
+        TelemetryData* existing = data.load(std::memory_order_acquire);
+        if (existing) {
+            existing->reset();
+        }
+    }
+    for (std::atomic<LatencyHistogram*> &histogram : requests) {
+        LatencyHistogram* existing = histogram.load(std::memory_order_acquire);
+        if (existing) {
+            existing->reset();
+        }
+    }
+    roundTrips.reset();
+}
+
+bool ReceiveStatistics::readTimestamp(const MessageView &serializedMessage, const int &field, int64_t *usSinceEpoch) {
+    using google::protobuf::internal::WireFormatLite;
+    google::protobuf::io::CodedInputStream stream(reinterpret_cast<const uint8_t*>(serializedMessage.data), serializedMessage.size);
+    while (uint32_t tag = stream.ReadTag()) {
+        if (WireFormatLite::GetTagFieldNumber(tag) != field || WireFormatLite::GetTagWireType(tag) != WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+            if (!WireFormatLite::SkipField(&stream, tag)) {
+                return false;
+            }
+            continue;
+        }
+        uint32_t length;
+        if (!stream.ReadVarint32(&length)) {
+            return false;
+        }
+        google::protobuf::io::CodedInputStream::Limit limit = stream.PushLimit(length);
+        // TimeStamp: int32 secs = 1, int32 nsecs = 2
+        int64_t secs = 0;
+        int64_t nsecs = 0;
+        while (uint32_t timestampTag = stream.ReadTag()) {
+            uint64_t value;
+            if (WireFormatLite::GetTagWireType(timestampTag) != WireFormatLite::WIRETYPE_VARINT || !stream.ReadVarint64(&value)) {
+                return false;
+            }
+            if (WireFormatLite::GetTagFieldNumber(timestampTag) == 1) {
+                secs = static_cast<int32_t>(value);
+            } else if (WireFormatLite::GetTagFieldNumber(timestampTag) == 2) {
+                nsecs = static_cast<int32_t>(value);
+            }
+        }
+        stream.PopLimit(limit);
+        if (secs == 0 && nsecs == 0) {
+            // not set by the robot
+            return false;
+        }
+        *usSinceEpoch = secs * 1000000 + nsecs / 1000;
+        return true;
+    }
+    return false;
+}
+
+int64_t ReceiveStatistics::ageUs(const int64_t &usSinceEpoch) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count() - usSinceEpoch;
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "MessageTypes.hpp"
+#include "LatencyHistogram.hpp"
+#include "Transports/Transport.hpp"
+
+#include <atomic>
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief statistics of what a RobotController receives: message rate, bytes, inter-arrival jitter and percentiles
+ * of the inter-arrival times and the age (receive time - TimeStamp of the message) per telemetry type,
+ * and the round trip times of requests per command type.
+ *
+ * Recording is enabled by default if this library is compiled with RRC_STATISTICS and can be switched at runtime by setEnabled().
+ * Recording is done by the receiving thread, the getters can be called from any other thread.
+ * The ages are only meaningful if the clocks of the robot and the controller are synchronized.
+ */
+class ReceiveStatistics {
+ public:
+    struct TypeStats {
+        TypeStats():messages(0), bytes(0), messagesPerSecond(0), bytesPerSecond(0), jitterUs(0), bufferedBytes(0) {}
+        uint64_t messages;
+        uint64_t bytes;
+        // averaged from the first to the last received message
+        double messagesPerSecond;
+        double bytesPerSecond;
+        // smoothed variation of the transit time (RFC 3550), of the inter-arrival time for messages without TimeStamp
+        double jitterUs;
+        LatencyHistogram::Summary interArrivalUs;
+        // empty for types without TimeStamp
+        LatencyHistogram::Summary ageUs;
+        // memory of the messages in the receive buffer, 0 if not counted (see RobotController::setTelemetryMemoryBudget())
+        uint64_t bufferedBytes;
+    };
+
+    ReceiveStatistics();
+    ~ReceiveStatistics();
+    ReceiveStatistics(const ReceiveStatistics&) = delete;
+    ReceiveStatistics& operator=(const ReceiveStatistics&) = delete;
+
+    /**
+     * @brief switch the recording on or off, the recorded values are kept
+     */
+    void setEnabled(const bool &enable) {
+        enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief record a received telemetry message
+     *
+     * @param type the telemetry type
+     * @param bytes size of the serialized message
+     * @param ageUs microseconds since the TimeStamp of the message, negative if unknown
+     */
+    void addReceived(const uint16_t &type, const size_t &bytes, const int64_t &ageUs = -1);
+
+    /**
+     * @brief set the source of TypeStats::bufferedBytes
+     * @warning has to be set before the statistics are read, it is called from the reading threads
+     */
+    void setBufferedBytesReader(const std::function<uint64_t(const uint16_t &type)> &reader) {
+        bufferedBytesReader = reader;
+    }
+
+    /**
+     * @brief record the round trip time of a request
+     *
+     * @param type the ControlMessageType of the request
+     * @param seconds time until the reply was received
+     */
+    void addRoundTrip(const uint16_t &type, const float &seconds);
+
+    /**
+     * @brief get the statistics of a telemetry type
+     * @return TypeStats zero messages if nothing was received
+     */
+    TypeStats getTelemetryStats(const uint16_t &type) const;
+
+    /**
+     * @brief get the round trip time percentiles of a request type in microseconds
+     */
+    LatencyHistogram::Summary getRoundTrip(const uint16_t &type) const;
+
+    /**
+     * @brief the round trip times of all request types together
+     */
+    LatencyHistogram::Summary getRoundTrip() const {
+        return roundTrips.summary();
+    }
+
+    /**
+     * @brief the telemetry types received since the last reset()
+     */
+    std::vector<uint16_t> getReceivedTypes() const;
+
+    void print() const;
+
+    /**
+     * @brief append the statistics in the Prometheus text format, the percentiles as summaries,
+     * only reads the lock-free counters, so it can be called from the thread of a MetricsExporter
+     *
+     * @param prefix prefix of the metric names
+     */
+    void appendMetrics(std::string *out, const std::string &prefix = "rrc_received") const;
+
+    /**
+     * @brief clear all statistics
+     * @warning recordings concurrent to the reset may be lost
+     */
+    void reset();
+
+    // used by print(), set when the types are registered
+    std::array<std::string, TELEMETRY_MESSAGE_TYPES_NUMBER> names;
+
+    /**
+     * @brief read the TimeStamp of a serialized message without parsing it
+     *
+     * @param serializedMessage the message
+     * @param field field number of the TimeStamp in the message
+     * @param usSinceEpoch the TimeStamp in microseconds
+     * @return false if the message has no such field
+     */
+    static bool readTimestamp(const MessageView &serializedMessage, const int &field, int64_t *usSinceEpoch);
+
+    /**
+     * @brief microseconds since a TimeStamp read by readTimestamp()
+     */
+    static int64_t ageUs(const int64_t &usSinceEpoch);
+
+ private:
+    struct TelemetryData {
+        TelemetryData();
+        void reset();
+
+        LatencyHistogram interArrival;
+        LatencyHistogram age;
+        std::atomic<uint64_t> messages;
+        std::atomic<uint64_t> bytes;
+        std::atomic<int64_t> firstArrivalNs;
+        std::atomic<int64_t> lastArrivalNs;
+        std::atomic<double> jitterUs;
+        // only used by the receiving thread
+        int64_t lastTransitUs;
+        int64_t lastInterArrivalUs;
+    };
+
+    // created on the first use of the type, to not allocate the histograms of all types
+    template <class DATA> static DATA* getOrCreate(std::atomic<DATA*> *slot) {
+        DATA* data = slot->load(std::memory_order_acquire);
+        if (!data) {
+            DATA* created = new DATA();
+            if (slot->compare_exchange_strong(data, created, std::memory_order_acq_rel)) {
+                data = created;
+            } else {
+                // created by another thread in the meantime
+                delete created;
+            }
+        }
+        return data;
+    }
+
+    std::array<std::atomic<TelemetryData*>, TELEMETRY_MESSAGE_TYPES_NUMBER> telemetry;
+    std::array<std::atomic<LatencyHistogram*>, CONTROL_MESSAGE_TYPE_NUMBER> requests;
+    LatencyHistogram roundTrips;
+    std::atomic<bool> enabled;
+    std::function<uint64_t(const uint16_t &type)> bufferedBytesReader;
+};
+
+}  // namespace robot_remote_control
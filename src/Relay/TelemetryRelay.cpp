@@ -0,0 +1,276 @@
+#include "TelemetryRelay.hpp"
+#include "DescriptionCache.hpp"
+#include "FixedLayout.hpp"
+#include "UpdateThread/Timer.hpp"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace robot_remote_control {
+
+TelemetryRelay::TelemetryRelay(TransportSharedPtr robotCommands, TransportSharedPtr robotTelemetry, TransportSharedPtr clientCommands, const float &maxLatency):
+    robotCommands(robotCommands),
+    robotTelemetry(robotTelemetry),
+    clientCommands(clientCommands),
+    maxLatency(maxLatency),
+    staticTypesRequested(false),
+    cached(TELEMETRY_MESSAGE_TYPES_NUMBER, false),
+    latest(TELEMETRY_MESSAGE_TYPES_NUMBER) {
+    setStaticTypes(DescriptionCache::defaultTypes());
+}
+
+void TelemetryRelay::addDownstream(TransportSharedPtr clientTelemetry, const DownstreamOptions &options) {
+    Downstream downstream;
+    downstream.transport = clientTelemetry;
+    downstream.options = options;
+    // tables by type, so forwarding does not search the options
+    downstream.forwardedTypes.assign(TELEMETRY_MESSAGE_TYPES_NUMBER, options.types.empty());
+    for (const uint16_t &type : options.types) {
+        if (type < downstream.forwardedTypes.size()) {
+            downstream.forwardedTypes[type] = true;
+        }
+    }
+    downstream.decimation.assign(TELEMETRY_MESSAGE_TYPES_NUMBER, 1);
+    for (const auto &decimation : options.decimation) {
+        if (decimation.first < downstream.decimation.size()) {
+            downstream.decimation[decimation.first] = std::max<uint32_t>(1, decimation.second);
+        }
+    }
+    downstream.counters.assign(TELEMETRY_MESSAGE_TYPES_NUMBER, 0);
+    downstreams.push_back(downstream);
+}
+
+void TelemetryRelay::setStaticTypes(const std::vector<uint16_t> &types) {
+    staticTypes.assign(TELEMETRY_MESSAGE_TYPES_NUMBER, false);
+    for (const uint16_t &type : types) {
+        if (type < staticTypes.size()) {
+            staticTypes[type] = true;
+        }
+    }
+}
+
+void TelemetryRelay::update() {
+    if (!staticTypesRequested) {
+        requestStaticTypes();
+        staticTypesRequested = true;
+    }
+    while (robotTelemetry->receive(&telemetryBuffer, Transport::NOBLOCK)) {
+        const MessageView &message = telemetryBuffer.view();
+        if (message.size < sizeof(uint16_t)) {
+            continue;
+        }
+        // the flag of the versioned header is masked, so both headers are routed by type
+        const uint16_t type = message.get<uint16_t>() & ~WIRE_HEADER_FLAG;
+        {
+            std::lock_guard<std::mutex> lock(statisticsMutex);
+            statistics.received++;
+        }
+        cacheTelemetry(message);
+        forward(message, type);
+    }
+    while (clientCommands.get() && clientCommands->receive(&requestBuffer, Transport::NOBLOCK)) {
+        evaluateRequest(requestBuffer.view());
+    }
+}
+
+void TelemetryRelay::forward(const MessageView &message, const uint16_t &type) {
+    for (Downstream &downstream : downstreams) {
+        const bool known = type < downstream.forwardedTypes.size();
+        if (known && (!downstream.forwardedTypes[type] || downstream.counters[type]++ % downstream.decimation[type])) {
+            std::lock_guard<std::mutex> lock(statisticsMutex);
+            statistics.dropped++;
+            continue;
+        }
+        // the message is republished as received (e.g. with the versioned header of the robot)
+        downstream.transport->send(message, 0, Transport::PayloadWriter());
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        statistics.forwarded++;
+    }
+}
+
+void TelemetryRelay::cacheTelemetry(const MessageView &message) {
+    WireHeader header;
+    const size_t headerSize = WireHeader::read(message.data, message.size, &header);
+    if (!headerSize || (header.flags & (WireHeader::COMPRESSED | WireHeader::CHUNKED))) {
+        // not a complete message of the type
+        return;
+    }
+    MessageView payload = message.sub(headerSize);
+    if (header.flags & WireHeader::FIXED_LAYOUT) {
+        // requests are answered with the protobuf message
+        FixedLayout::Serializer serializer = FixedLayout::serializerOf(header.type);
+        if (serializer) {
+            std::string serialized;
+            serializer(payload.toString(), &serialized);
+            cache(header.type, MessageView(serialized));
+        }
+        return;
+    }
+    if (header.type != TELEMETRY_BATCH) {
+        cache(header.type, payload);
+        return;
+    }
+    // [uint16_t type][uint32_t size][payload] per message
+    size_t offset = 0;
+    while (offset + sizeof(uint16_t) + sizeof(uint32_t) <= payload.size) {
+        const uint16_t type = payload.get<uint16_t>(offset);
+        const uint32_t size = payload.get<uint32_t>(offset + sizeof(uint16_t));
+        offset += sizeof(uint16_t) + sizeof(uint32_t);
+        if (offset + size > payload.size) {
+            return;
+        }
+        cache(type, MessageView(payload.data + offset, size));
+        offset += size;
+    }
+}
+
+void TelemetryRelay::cache(const uint16_t &type, const MessageView &payload) {
+    if (type >= latest.size() || type == MAP_CHUNK || type == TELEMETRY_CHUNK) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    // keeps the capacity of the string
+    latest[type].assign(payload.data, payload.size);
+    cached[type] = true;
+}
+
+bool TelemetryRelay::getLatest(const uint16_t &type, std::string *payload) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (type >= cached.size() || !cached[type]) {
+        return false;
+    }
+    *payload = latest[type];
+    return true;
+}
+
+void TelemetryRelay::evaluateRequest(const MessageView &request) {
+    const uint16_t header = request.size >= sizeof(uint16_t) ? request.get<uint16_t>() : uint16_t(NO_CONTROL_DATA);
+    size_t headerSize = sizeof(uint16_t);
+    const bool withRequestId = (header & REQUEST_ID_FLAG) && request.size >= sizeof(uint16_t) + sizeof(uint32_t);
+    uint32_t requestId = 0;
+    if (withRequestId) {
+        requestId = request.get<uint32_t>(sizeof(uint16_t));
+        headerSize += sizeof(uint32_t);
+    }
+    const uint16_t type = header & ~REQUEST_ID_FLAG;
+    MessageView payload = request.sub(headerSize);
+
+    std::string localReply;
+    bool answered = false;
+    if (type == TELEMETRY_REQUEST && payload.size >= sizeof(uint16_t)) {
+        answered = getLatest(payload.get<uint16_t>(), &localReply);
+    } else if (type == TELEMETRY_BULK_REQUEST) {
+        answered = answerBulkRequest(payload, &localReply);
+    } else if (type == DESCRIPTION_VERSIONS) {
+        answered = answerDescriptionVersions(payload, &localReply);
+    }
+    if (answered) {
+        reply(localReply, withRequestId, requestId);
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        statistics.answeredLocally++;
+        return;
+    }
+
+    std::string robotReply;
+    if (!requestRobot(request, &robotReply)) {
+        const uint16_t noData = NO_CONTROL_DATA;
+        reply(MessageView(reinterpret_cast<const char*>(&noData), sizeof(uint16_t)), withRequestId, requestId);
+        return;
+    }
+    if (type == TELEMETRY_REQUEST && payload.size >= sizeof(uint16_t)) {
+        const uint16_t telemetryType = payload.get<uint16_t>();
+        MessageView telemetry = withRequestId ? MessageView(robotReply).sub(sizeof(uint32_t)) : MessageView(robotReply);
+        // an empty reply: the robot has no message of the type yet
+        if (telemetryType < staticTypes.size() && staticTypes[telemetryType] && telemetry.size) {
+            cache(telemetryType, telemetry);
+        }
+    }
+    // as received, the reply of the robot has the request id already
+    reply(robotReply, false, 0);
+}
+
+bool TelemetryRelay::answerBulkRequest(const MessageView &types, std::string *reply) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (size_t offset = 0; offset + sizeof(uint16_t) <= types.size; offset += sizeof(uint16_t)) {
+        const uint16_t type = types.get<uint16_t>(offset);
+        if (type >= cached.size() || !cached[type]) {
+            // the robot may have it
+            return false;
+        }
+        const uint32_t size = latest[type].size();
+        reply->append(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+        reply->append(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+        reply->append(latest[type]);
+    }
+    return true;
+}
+
+bool TelemetryRelay::answerDescriptionVersions(const MessageView &items, std::string *reply) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    bool complete = true;
+    DescriptionCache::parseItems(items, [&](const uint16_t &type, const uint64_t &hash, const MessageView &payload) {
+        if (type >= cached.size() || !cached[type]) {
+            complete = false;
+            return;
+        }
+        const uint64_t currentHash = DescriptionCache::contentHash(latest[type]);
+        DescriptionCache::appendItem(reply, type, currentHash, currentHash == hash ? MessageView() : MessageView(latest[type]));
+    });
+    return complete;
+}
+
+bool TelemetryRelay::requestRobot(const MessageView &request, std::string *robotReply) {
+    {
+        std::lock_guard<std::mutex> lock(statisticsMutex);
+        statistics.requestsForwarded++;
+    }
+    robotCommands->send(request, 0, Transport::PayloadWriter());
+    Timer timeout;
+    timeout.start(maxLatency);
+    while (robotCommands->receive(robotReply, Transport::NOBLOCK) == 0) {
+        if (timeout.isExpired()) {
+            printf("no reply of the robot within %.2f seconds\n", maxLatency);
+            return false;
+        }
+        usleep(1000);
+    }
+    return true;
+}
+
+void TelemetryRelay::reply(const MessageView &reply, const bool &withRequestId, const uint32_t &requestId) {
+    if (withRequestId) {
+        clientCommands->send(MessageView(reinterpret_cast<const char*>(&requestId), sizeof(uint32_t)), reply);
+    } else {
+        clientCommands->send(reply, 0, Transport::PayloadWriter());
+    }
+}
+
+void TelemetryRelay::requestStaticTypes() {
+    // one DESCRIPTION_VERSIONS request, it has an item for each type (a TELEMETRY_REQUEST of an unset type has an empty reply)
+    std::string request;
+    const uint16_t type = DESCRIPTION_VERSIONS;
+    request.append(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+    for (uint16_t staticType = 0; staticType < staticTypes.size(); ++staticType) {
+        if (staticTypes[staticType]) {
+            DescriptionCache::appendItem(&request, staticType, 0, MessageView());
+        }
+    }
+    std::string robotReply;
+    if (!requestRobot(request, &robotReply)) {
+        return;
+    }
+    DescriptionCache::parseItems(robotReply, [&](const uint16_t &type, const uint64_t &hash, const MessageView &payload) {
+        // an empty payload: the robot did not set the type yet, it is cached when published
+        if (payload.size) {
+            cache(type, payload);
+        }
+    });
+}
+
+TelemetryRelay::Statistics TelemetryRelay::getStatistics() {
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    return statistics;
+}
+
+}  // namespace robot_remote_control
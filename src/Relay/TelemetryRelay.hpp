@@ -0,0 +1,136 @@
+#pragma once
+
+#include "MessageTypes.hpp"
+#include "WireHeader.hpp"
+#include "Transports/Transport.hpp"
+#include "UpdateThread/UpdateThread.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief fan-out node between a robot and many controllers, so telemetry crosses the uplink of the robot only once.
+ *
+ * The relay connects once to the command and telemetry transports of the robot (e.g. REQ and SUB), republishes the received
+ * telemetry on the downstream telemetry transports (e.g. PUB) and forwards the requests of the controllers on the
+ * downstream command transport (e.g. REP or ROUTER) to the robot.
+ * The latest message of each telemetry type is cached, TELEMETRY_REQUEST, TELEMETRY_BULK_REQUEST and DESCRIPTION_VERSIONS
+ * of cached types are answered by the relay. Replies to requests of the description types (e.g. ROBOT_NAME, CONTROLLABLE_JOINTS) are cached as well
+ * and requested once when the relay starts, so controllers connecting later do not reach the robot for them.
+ *
+ * Each downstream telemetry transport can transcode: a compressing transport (e.g. TransportWrapperZstd) compresses
+ * for its clients only, and DownstreamOptions decimate or filter the types.
+ */
+class TelemetryRelay : public UpdateThread {
+ public:
+    struct DownstreamOptions {
+        DownstreamOptions() {}
+        // only forward every n-th message of a type, 0 or 1 forwards all (types not in the map are forwarded)
+        std::map<uint16_t, uint32_t> decimation;
+        // only forward these types, empty for all
+        std::vector<uint16_t> types;
+    };
+
+    struct Statistics {
+        Statistics():received(0), forwarded(0), dropped(0), answeredLocally(0), requestsForwarded(0) {}
+        uint64_t received;
+        // downstream messages, counted per downstream transport
+        uint64_t forwarded;
+        // decimated or filtered
+        uint64_t dropped;
+        uint64_t answeredLocally;
+        uint64_t requestsForwarded;
+    };
+
+    /**
+     * @param robotCommands connected to the command transport of the robot (e.g. TransportZmq::REQ)
+     * @param robotTelemetry connected to the telemetry transport of the robot (e.g. TransportZmq::SUB)
+     * @param clientCommands the command transport of the controllers (e.g. TransportZmq::REP or ROUTER), may be nullptr for telemetry only
+     * @param maxLatency seconds to wait for a reply of the robot, the controller gets NO_CONTROL_DATA then
+     * (the telemetry is not forwarded while waiting)
+     */
+    TelemetryRelay(TransportSharedPtr robotCommands, TransportSharedPtr robotTelemetry, TransportSharedPtr clientCommands, const float &maxLatency = 1);
+
+    virtual ~TelemetryRelay() {}
+
+    /**
+     * @brief add a transport the telemetry is republished on
+     * @warning has to be called before the update thread is started
+     */
+    void addDownstream(TransportSharedPtr clientTelemetry, const DownstreamOptions &options = DownstreamOptions());
+
+    /**
+     * @brief the types whose request replies are cached, they are requested from the robot by the first update() (DESCRIPTION_VERSIONS)
+     * (the description types of DescriptionCache by default)
+     * @warning has to be called before the update thread is started
+     */
+    void setStaticTypes(const std::vector<uint16_t> &types);
+
+    /**
+     * @brief forward the received telemetry and the requests of the controllers
+     */
+    virtual void update();
+
+    /**
+     * @brief the cached payload of a type (without the header)
+     *
+     * @return false if there is none
+     */
+    bool getLatest(const uint16_t &type, std::string *payload);
+
+    Statistics getStatistics();
+
+ protected:
+    /**
+     * @brief waits for telemetry of the robot
+     */
+    virtual void waitForUpdate(const unsigned int &maxMilliseconds) {
+        robotTelemetry->waitForData(maxMilliseconds);
+    }
+
+ private:
+    struct Downstream {
+        TransportSharedPtr transport;
+        DownstreamOptions options;
+        std::vector<bool> forwardedTypes;
+        std::vector<uint32_t> decimation;
+        std::vector<uint32_t> counters;
+    };
+
+    void forward(const MessageView &message, const uint16_t &type);
+    void cacheTelemetry(const MessageView &message);
+    void cache(const uint16_t &type, const MessageView &payload);
+    void evaluateRequest(const MessageView &request);
+    // true if all types were cached
+    bool answerBulkRequest(const MessageView &types, std::string *reply);
+    bool answerDescriptionVersions(const MessageView &items, std::string *reply);
+    // false if the robot did not reply within maxLatency
+    bool requestRobot(const MessageView &request, std::string *robotReply);
+    void reply(const MessageView &reply, const bool &withRequestId, const uint32_t &requestId);
+    void requestStaticTypes();
+
+    TransportSharedPtr robotCommands;
+    TransportSharedPtr robotTelemetry;
+    TransportSharedPtr clientCommands;
+    float maxLatency;
+    std::vector<Downstream> downstreams;
+    ReceiveBuffer telemetryBuffer;
+    ReceiveBuffer requestBuffer;
+
+    std::vector<bool> staticTypes;
+    bool staticTypesRequested;
+
+    std::mutex cacheMutex;
+    std::vector<bool> cached;
+    std::vector<std::string> latest;
+
+    std::mutex statisticsMutex;
+    Statistics statistics;
+};
+
+}  // namespace robot_remote_control
@@ -5,10 +5,33 @@
 #include <memory>
 #include <functional>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <type_traits>
 
 
 namespace robot_remote_control {
 
+/**
+ * @brief the bytes of the elements of a buffer, updated by the buffer and readable without locking it
+ */
+struct BufferedBytes {
+    explicit BufferedBytes(std::atomic<int64_t> *total = nullptr):bytes(0), total(total) {}
+
+    void add(const int64_t &delta) {
+        bytes.fetch_add(delta, std::memory_order_relaxed);
+        if (total) {
+            total->fetch_add(delta, std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<int64_t> bytes;
+    // the sum of several buffers, nullptr if not needed
+    std::atomic<int64_t> *total;
+};
+
 /**
  * @brief base class to be able to hold buffers of different types in a vector 
  */
@@ -21,6 +44,79 @@ class RingBufferBase{
         virtual size_t capacity() = 0;
         virtual void resize(const size_t &newsize) = 0;
         // virtual void clear();
+
+        /**
+         * @brief count the bytes of the elements (ByteSizeLong() of protobuf messages) into counter,
+         * and drop the oldest elements when a push exceeds maxBytes (the newest element is always kept)
+         *
+         * @param maxBytes the limit, 0 to only count
+         * @param counter the counter, nullptr to stop counting
+         * @return false if the buffer does not support it (e.g. LockFreeRingBuffer)
+         */
+        virtual bool setByteLimit(const size_t &maxBytes, const std::shared_ptr<BufferedBytes> &counter) {
+            return false;
+        }
+
+        /**
+         * @brief drop the oldest element and release its memory, used to keep a budget of several buffers
+         *
+         * @return false if there is only one element (or none), or the buffer does not support it
+         */
+        virtual bool dropOldest() {
+            return false;
+        }
+};
+
+/**
+ * @brief interface of buffers for a specific type, so different buffer implementations can be used
+ */
+template <class TYPE> class TypedRingBufferBase: public RingBufferBase {
+    public:
+        TypedRingBufferBase() {}
+        virtual ~TypedRingBufferBase() {}
+
+        virtual bool pushData(const TYPE & data, bool overwriteIfFull = false) = 0;
+
+        /**
+         * @brief push without copying, data is moved into the slot (and has an unspecified value afterwards)
+         */
+        virtual bool pushData(TYPE && data, bool overwriteIfFull = false) = 0;
+
+        /**
+         * @brief push by writing directly into the next slot of the buffer (e.g. parsing a protobuf message into it),
+         * the slot contains an old element, so its memory (e.g. of repeated fields) can be reused
+         *
+         * @param fill writes the data into the slot, if it returns false nothing is pushed
+         * @return true if pushed
+         */
+        virtual bool pushInPlace(const std::function<bool(TYPE *slot)> &fill, bool overwriteIfFull = false) = 0;
+        virtual bool popData(TYPE *data) = 0;
+        virtual bool peekData(TYPE *data) = 0;
+        virtual void addDataReceivedCallback(const std::function<void(const TYPE & data)> &cb) = 0;
+
+        /**
+         * @brief pop all elements (oldest first) and append them to data
+         *
+         * @return size_t number of popped elements
+         */
+        virtual size_t popAll(std::vector<TYPE> *data) {
+            size_t popped = 0;
+            TYPE element;
+            while (popData(&element)) {
+                data->push_back(std::move(element));
+                popped++;
+            }
+            return popped;
+        }
+
+        /**
+         * @brief append copies of all elements (oldest first) to data, without removing them
+         *
+         * @return false if the buffer can not be read without popping (LockFreeRingBuffer)
+         */
+        virtual bool peekAll(std::vector<TYPE> *data) {
+            return false;
+        }
 };
 
 /**
@@ -30,9 +126,10 @@ class RingBufferBase{
  * 
  */
 
-template <class TYPE> class RingBuffer: public RingBufferBase {
+template <class TYPE> class RingBuffer: public TypedRingBufferBase<TYPE> {
     public:
-        explicit RingBuffer(const size_t & buffersize): RingBufferBase(), buffersize(buffersize), contentsize(0), in(0), out(0) {
+        explicit RingBuffer(const size_t & buffersize): TypedRingBufferBase<TYPE>(), buffersize(buffersize), contentsize(0), in(0), out(0),
+                                                        maxBytes(0), bytes(0) {
             buffer.resize(buffersize);
         }
 
@@ -54,39 +151,102 @@ template <class TYPE> class RingBuffer: public RingBufferBase {
             buffersize = newsize;
             buffer.resize(buffersize);
 
-            if (in > buffersize) {
-                in = buffersize;
+            if (out >= buffersize) {
+                out = 0;
+            }
+            // content beyond the new size is dropped
+            contentsize = std::min(contentsize, buffersize);
+            in = (out + contentsize) % buffersize;
+            if (counter) {
+                countBytes();
+            }
+        }
+
+        bool setByteLimit(const size_t &maxBytes, const std::shared_ptr<BufferedBytes> &counter) {
+            if (this->counter) {
+                this->counter->add(-static_cast<int64_t>(bytes));
+            }
+            this->maxBytes = maxBytes;
+            this->counter = counter;
+            bytes = 0;
+            if (counter) {
+                countBytes();
+                limitBytes();
             }
+            return true;
+        }
 
-            if (out > buffersize) {
-                out = 0;
+        bool dropOldest() {
+            if (contentsize <= 1) {
+                return false;
             }
+            // releases the memory, the slot is filled again by a push anyway
+            buffer[out] = TYPE();
+            removeBytes(out);
+            contentsize--;
+            out++;
+            out %= buffersize;
+            return true;
         }
 
         bool pushData(const TYPE & data, bool overwriteIfFull = false) {
+            return pushInPlace([&data](TYPE *slot) {
+                *slot = data;
+                return true;
+            }, overwriteIfFull);
+        }
+
+        bool pushData(TYPE && data, bool overwriteIfFull = false) {
+            return pushInPlace([&data](TYPE *slot) {
+                *slot = std::move(data);
+                return true;
+            }, overwriteIfFull);
+        }
+
+        bool pushInPlace(const std::function<bool(TYPE *slot)> &fill, bool overwriteIfFull = false) {
+            const size_t slot = in;
             if (contentsize != buffersize) {
-                buffer[in] = data;
+                if (!fill(&buffer[slot])) {
+                    return false;
+                }
                 contentsize++;
                 in++;
                 in %= buffersize;
-                notify(data);
-                return true;
             } else if (overwriteIfFull) {
-                // buffer full, force-push (overwrite latest)
-                buffer[in] = data;
+                // buffer full, force-push (overwrite latest): the slot is the oldest element, which stays valid if the fill fails
+                if (!fill(&spare)) {
+                    return false;
+                }
+                using std::swap;
+                // the memory of the oldest element is reused by the next overwrite
+                swap(spare, buffer[slot]);
+                removeBytes(slot);
                 out++;
                 out %= buffersize;
                 in++;
                 in %= buffersize;
-                notify(data);
-                return true;
+            } else {
+                return false;
             }
-            return false;
+            TYPE &data = buffer[slot];
+            if (counter) {
+                slotBytes[slot] = elementBytes(data, 0);
+                bytes += slotBytes[slot];
+                counter->add(slotBytes[slot]);
+                limitBytes();
+            }
+            notify(data);
+            return true;
         }
 
+        /**
+         * @brief pop the oldest element, it is swapped out, so the buffer reuses the memory of the old content of data
+         */
         bool popData(TYPE *data) {
             if (contentsize > 0) {
-                *data = buffer[out];
+                using std::swap;
+                swap(*data, buffer[out]);
+                removeBytes(out);
                 contentsize--;
                 out++;
                 out %= buffersize;
@@ -103,6 +263,31 @@ template <class TYPE> class RingBuffer: public RingBufferBase {
             return false;
         }
 
+        /**
+         * @brief the elements are swapped out like in popData()
+         */
+        size_t popAll(std::vector<TYPE> *data) {
+            const size_t popped = contentsize;
+            data->reserve(data->size() + popped);
+            using std::swap;
+            for (; contentsize > 0; --contentsize) {
+                data->emplace_back();
+                swap(data->back(), buffer[out]);
+                removeBytes(out);
+                out++;
+                out %= buffersize;
+            }
+            return popped;
+        }
+
+        bool peekAll(std::vector<TYPE> *data) {
+            data->reserve(data->size() + contentsize);
+            for (size_t i = 0; i < contentsize; ++i) {
+                data->push_back(buffer[(out + i) % buffersize]);
+            }
+            return true;
+        }
+
         void addDataReceivedCallback(const std::function<void(const TYPE & data)> &cb) {
             callbacks.push_back(cb);
         }
@@ -112,8 +297,52 @@ template <class TYPE> class RingBuffer: public RingBufferBase {
             auto callCb = [&](const std::function<void (const TYPE & data)> &cb){cb(data);};
             std::for_each(callbacks.begin(), callbacks.end(), callCb);
         }
+
+        // the serialized size of protobuf messages, the length of strings (e.g. LazyRingBuffer), sizeof otherwise
+        template <class T> static auto elementBytes(const T &data, int) -> decltype(static_cast<size_t>(data.ByteSizeLong())) {
+            return data.ByteSizeLong();
+        }
+        static size_t elementBytes(const std::string &data, int) {
+            return data.size();
+        }
+        template <class T> static size_t elementBytes(const T &data, long) {  // NOLINT(runtime/int)
+            return sizeof(T);
+        }
+
+        void removeBytes(const size_t &slot) {
+            if (counter) {
+                bytes -= slotBytes[slot];
+                counter->add(-static_cast<int64_t>(slotBytes[slot]));
+                slotBytes[slot] = 0;
+            }
+        }
+
+        void countBytes() {
+            counter->add(-static_cast<int64_t>(bytes));
+            slotBytes.assign(buffersize, 0);
+            bytes = 0;
+            for (size_t i = 0; i < contentsize; ++i) {
+                const size_t slot = (out + i) % buffersize;
+                slotBytes[slot] = elementBytes(buffer[slot], 0);
+                bytes += slotBytes[slot];
+            }
+            counter->add(bytes);
+        }
+
+        void limitBytes() {
+            while (maxBytes && bytes > maxBytes && dropOldest()) {}
+        }
+
         size_t buffersize, contentsize, in, out;
         std::vector<TYPE> buffer;
+        // filled when the buffer is full, swapped in if the fill succeeded
+        TYPE spare;
+
+        // setByteLimit(), the bytes of each slot are kept to subtract them when the element leaves the buffer
+        size_t maxBytes;
+        size_t bytes;
+        std::shared_ptr<BufferedBytes> counter;
+        std::vector<size_t> slotBytes;
 
         std::vector< std::function<void (const TYPE & data)> > callbacks;
 };
@@ -122,15 +351,24 @@ template <class TYPE> class RingBuffer: public RingBufferBase {
 class RingBufferAccess{
     public:
         template<class DATATYPE> static bool pushData(std::shared_ptr<RingBufferBase> buffer, const DATATYPE & data, bool overwrite = false) {
-            std::shared_ptr< RingBuffer<DATATYPE> > dataclass = std::dynamic_pointer_cast< RingBuffer<DATATYPE> >(buffer);
+            std::shared_ptr< TypedRingBufferBase<DATATYPE> > dataclass = std::dynamic_pointer_cast< TypedRingBufferBase<DATATYPE> >(buffer);
             if (dataclass.get()) {
                 return dataclass->pushData(data, overwrite);
             }
             return false;
         }
 
+        template<class DATATYPE, class = typename std::enable_if<!std::is_lvalue_reference<DATATYPE>::value>::type>
+        static bool pushData(std::shared_ptr<RingBufferBase> buffer, DATATYPE && data, bool overwrite = false) {
+            std::shared_ptr< TypedRingBufferBase<DATATYPE> > dataclass = std::dynamic_pointer_cast< TypedRingBufferBase<DATATYPE> >(buffer);
+            if (dataclass.get()) {
+                return dataclass->pushData(std::move(data), overwrite);
+            }
+            return false;
+        }
+
         template<class DATATYPE> static bool popData(std::shared_ptr<RingBufferBase> buffer, DATATYPE *data) {
-            std::shared_ptr< RingBuffer<DATATYPE> > dataclass = std::dynamic_pointer_cast< RingBuffer<DATATYPE> >(buffer);
+            std::shared_ptr< TypedRingBufferBase<DATATYPE> > dataclass = std::dynamic_pointer_cast< TypedRingBufferBase<DATATYPE> >(buffer);
             if (dataclass.get()) {
                 return dataclass->popData(data);
             }
@@ -138,7 +376,7 @@ class RingBufferAccess{
         }
 
         template<class DATATYPE> static bool peekData(const std::shared_ptr<RingBufferBase> &buffer, DATATYPE *data) {
-            std::shared_ptr< RingBuffer<DATATYPE> > dataclass = std::dynamic_pointer_cast< RingBuffer<DATATYPE> >(buffer);
+            std::shared_ptr< TypedRingBufferBase<DATATYPE> > dataclass = std::dynamic_pointer_cast< TypedRingBufferBase<DATATYPE> >(buffer);
             if (dataclass.get()) {
                 return dataclass->peekData(data);
             }
@@ -146,7 +384,7 @@ class RingBufferAccess{
         }
 
         template<class DATATYPE> static bool addDataReceivedCallback(const std::shared_ptr<RingBufferBase> &buffer, const std::function<void(const DATATYPE & data)> &cb) {
-            std::shared_ptr< RingBuffer<DATATYPE> > dataclass = std::dynamic_pointer_cast< RingBuffer<DATATYPE> >(buffer);
+            std::shared_ptr< TypedRingBufferBase<DATATYPE> > dataclass = std::dynamic_pointer_cast< TypedRingBufferBase<DATATYPE> >(buffer);
             if (dataclass.get()) {
                 dataclass->addDataReceivedCallback(cb);
                 return true;
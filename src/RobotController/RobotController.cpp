@@ -3,40 +3,76 @@
 #include <memory>
 #include <unistd.h>
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <cstring>
 #include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
 
 using namespace robot_remote_control;
 
 
+struct RobotController::DefaultTelemetryRegistrar {
+    RobotController *controller;
+    size_t buffersize;
+
+    template <uint16_t TYPE> void visit() {
+        if (TelemetryTraits<TYPE>::buffered) {
+            controller->registerTelemetryType<TYPE>(buffersize, false, decoder<TYPE>());
+        }
+    }
+
+    template <uint16_t TYPE> std::function<void(typename TelemetryTraits<TYPE>::type *data)> decoder() {
+        return nullptr;
+    }
+};
+
+template <> std::function<void(JointState *data)> RobotController::DefaultTelemetryRegistrar::decoder<JOINT_STATE>() {
+    RobotController *robotController = controller;
+    return [robotController](JointState *jointState) {
+        robotController->expandJointNames(jointState);
+    };
+}
+
+template <> std::function<void(JointState *data)> RobotController::DefaultTelemetryRegistrar::decoder<CONTROLLABLE_JOINTS>() {
+    RobotController *robotController = controller;
+    return [robotController](JointState *controllableJoints) {
+        robotController->updateJointNameTable(controllableJoints);
+    };
+}
+
 RobotController::RobotController(TransportSharedPtr commandTransport, TransportSharedPtr telemetryTransport, const size_t &buffersize, const float &maxLatency):UpdateThread(),
+    nextRequestId(0),
+    asyncRequests(false),
+    wireHeaderVersion(0),
+    robotSessionId(0),
+    sessionResumption(false),
+    resumePending(false),
+    capabilityNegotiation(false),
+    negotiationPending(false),
+    maxChunkedMessageSize(defaultMaxChunkedMessageSize),
+    compactJointTable(0),
+    renegotiateJointTable(false),
+    nextMapTransferId(std::random_device()()),
+    telemetryFiltered(false),
     commandTransport(commandTransport),
     telemetryTransport(telemetryTransport),
     heartBeatDuration(0),
+    heartbeatAnnounced(false),
     heartBreatRoundTripTime(0),
+    pendingHeartbeatSentNs(0),
+    receivedTelemetryBytes(0),
+    heartbeatReceivedBytes(0),
     maxLatency(maxLatency),
     buffers(std::make_shared<TelemetryBuffer>()),
-    simplesensorbuffer(std::make_shared< SimpleBuffer<SimpleSensor> >()) {
-        registerTelemetryType<Pose>(CURRENT_POSE, buffersize);
-        registerTelemetryType<JointState>(JOINT_STATE, buffersize);
-        registerTelemetryType<JointState>(CONTROLLABLE_JOINTS, buffersize);
-        registerTelemetryType<SimpleActions>(SIMPLE_ACTIONS, buffersize);
-        registerTelemetryType<ComplexActions>(COMPLEX_ACTIONS, buffersize);
-        registerTelemetryType<RobotName>(ROBOT_NAME, buffersize);
-        registerTelemetryType<RobotState>(ROBOT_STATE, buffersize);
-        registerTelemetryType<LogMessage>(LOG_MESSAGE, buffersize);
-        registerTelemetryType<VideoStreams>(VIDEO_STREAMS, buffersize);
-        registerTelemetryType<SimpleSensors>(SIMPLE_SENSOR_DEFINITION, buffersize);
-        // simple sensors are stored in separate buffer when receiving, but sending requires this for requests
-        // registerTelemetryType<SimpleSensor>(SIMPLE_SENSOR_VALUE, buffersize);
-        registerTelemetryType<WrenchState>(WRENCH_STATE, buffersize);
-        registerTelemetryType<Poses>(POSES, buffersize);
-        registerTelemetryType<Transforms>(TRANSFORMS, buffersize);
-        registerTelemetryType<PermissionRequest>(PERMISSION_REQUEST, buffersize);
-        registerTelemetryType<PointCloud>(POINTCLOUD, buffersize);
-        registerTelemetryType<IMU>(IMU_VALUES, buffersize);
-        registerTelemetryType<ContactPoints>(CONTACT_POINTS, buffersize);
-        registerTelemetryType<Twist>(CURRENT_TWIST, buffersize);
-        registerTelemetryType<Acceleration>(CURRENT_ACCELERATION, buffersize);
+    simplesensorbuffer(std::make_shared< SimpleBuffer<SimpleSensor> >()),
+    connected(false) {
+        TelemetryTypes::forEach(DefaultTelemetryRegistrar{this, buffersize});
+        std::shared_ptr<TelemetryBuffer> bufferedBytes = buffers;
+        receiveStatistics.setBufferedBytesReader([bufferedBytes](const uint16_t &type) {
+            return bufferedBytes->getBufferedBytes(type);
+        });
 
         lostConnectionCallback = [&](const float& time){
             printf("lost connection to robot, no reply for %f seconds\n", time);
@@ -44,6 +80,8 @@ RobotController::RobotController(TransportSharedPtr commandTransport, TransportS
 }
 
 RobotController::~RobotController() {
+    // the workers use the buffers and signals
+    parseExecutor.reset();
 }
 
 void RobotController::setTargetPose(const Pose & pose) {
@@ -59,9 +97,176 @@ void RobotController::setGoToCommand(const GoTo &goToCommand) {
 }
 
 void RobotController::setJointCommand(const JointCommand &jointsCommand) {
+    const uint64_t table = compactJointTable.load();
+    if (table) {
+        JointCommand compact;
+        bool compacted;
+        {
+            auto lockedTable = jointNameTable.lockedAccess();
+            compacted = lockedTable->getId() == table && lockedTable->compact(jointsCommand, &compact);
+        }
+        if (compacted) {
+            std::string reply = sendProtobufData(compact, JOINTS_COMMAND);
+            if (reply.size() < sizeof(uint16_t) || *reinterpret_cast<const uint16_t*>(reply.data()) == JOINTS_COMMAND) {
+                return;
+            }
+            // the robot has a different table now, send with names until negotiated again
+            compactJointTable.store(0);
+            renegotiateJointTable.store(true);
+        }
+    }
     sendProtobufData(jointsCommand, JOINTS_COMMAND);
 }
 
+bool RobotController::setCompactJoints(bool enable) {
+    uint64_t table = 0;
+    if (enable) {
+        JointState controllableJoints;
+        requestControllableJoints(&controllableJoints);
+        auto lockedTable = jointNameTable.lockedAccess();
+        lockedTable->set(controllableJoints);
+        table = lockedTable->getId();
+        if (!table) {
+            return false;
+        }
+    }
+    std::string buf;
+    buf.resize(sizeof(uint16_t) + sizeof(uint64_t));
+    const uint16_t type = JOINT_NAME_TABLE;
+    memcpy(&buf[0], &type, sizeof(uint16_t));
+    memcpy(&buf[sizeof(uint16_t)], &table, sizeof(uint64_t));
+    std::string reply = sendRequest(buf);
+    if (reply.size() < sizeof(uint16_t) || *reinterpret_cast<const uint16_t*>(reply.data()) != JOINT_NAME_TABLE) {
+        compactJointTable.store(0);
+        return false;
+    }
+    compactJointTable.store(table);
+    return true;
+}
+
+bool RobotController::setVersionedHeader(bool enable) {
+    char request[sizeof(uint16_t) + sizeof(uint8_t)];
+    const uint16_t type = WIRE_HEADER_VERSION;
+    const uint8_t version = enable ? WireHeader::currentVersion : 0;
+    memcpy(request, &type, sizeof(uint16_t));
+    memcpy(request + sizeof(uint16_t), &version, sizeof(uint8_t));
+    std::string reply = sendRequest(std::string(request, sizeof(request)));
+    if (reply.size() < sizeof(request) || *reinterpret_cast<const uint16_t*>(reply.data()) != WIRE_HEADER_VERSION) {
+        // an older robot, it keeps the plain header
+        wireHeaderVersion.store(0);
+        return !enable;
+    }
+    wireHeaderVersion.store(reply[sizeof(uint16_t)]);
+    return wireHeaderVersion.load() == version;
+}
+
+Capabilities RobotController::defaultCapabilities() {
+    Capabilities capabilities;
+    capabilities.set_protocol_version(PROTOCOL_VERSION);
+    capabilities.set_wire_header_version(WireHeader::currentVersion);
+    capabilities.set_compact_joints(true);
+    capabilities.set_telemetry_chunks(true);
+    capabilities.set_session_resume(true);
+    capabilities.set_log_messages(true);
+    for (const uint16_t type : FixedLayout::supportedTypes()) {
+        capabilities.add_fixed_layout_types(type);
+    }
+    return capabilities;
+}
+
+bool RobotController::negotiateCapabilities(const Capabilities &offer) {
+    std::string reply = sendProtobufData(offer, CAPABILITIES);
+    Capabilities selected;
+    if (reply.size() < sizeof(uint16_t) || *reinterpret_cast<const uint16_t*>(reply.data()) != CAPABILITIES
+        || !selected.ParseFromArray(reply.data() + sizeof(uint16_t), reply.size() - sizeof(uint16_t))) {
+        negotiateFeatures(offer);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(capabilitiesMutex);
+        negotiatedCapabilities = selected;
+    }
+    wireHeaderVersion.store(selected.wire_header_version());
+    if (selected.compact_joints()) {
+        setCompactJoints(true);
+    }
+    if (selected.session_resume()) {
+        sessionResumption.store(true);
+    }
+    return true;
+}
+
+void RobotController::negotiateFeatures(const Capabilities &offer) {
+    {
+        std::lock_guard<std::mutex> lock(capabilitiesMutex);
+        negotiatedCapabilities = Capabilities();
+    }
+    if (offer.wire_header_version()) {
+        setVersionedHeader(true);
+    }
+    for (const PointCloudEncoding &encoding : offer.pointcloud_encodings()) {
+        if (setPointCloudEncoding(encoding)) {
+            break;
+        }
+    }
+    if (offer.compact_joints()) {
+        setCompactJoints(true);
+    }
+}
+
+RobotController::SequenceCounters RobotController::getSequenceCounters(const uint16_t &type) {
+    SequenceCounters counters;
+    for (size_t i = 0; i < telemetrySequences.size(); ++i) {
+        if (type == NO_TELEMETRY_DATA || type == i) {
+            counters.received += telemetrySequences[i].received.load(std::memory_order_relaxed);
+            counters.gaps += telemetrySequences[i].gaps.load(std::memory_order_relaxed);
+            counters.reordered += telemetrySequences[i].reordered.load(std::memory_order_relaxed);
+            counters.dropped += telemetrySequences[i].dropped.load(std::memory_order_relaxed);
+        }
+    }
+    return counters;
+}
+
+bool RobotController::countSequence(const WireHeader &header) {
+    if (header.type >= telemetrySequences.size()) {
+        return true;
+    }
+    TelemetrySequence &sequence = telemetrySequences[header.type];
+    sequence.received.fetch_add(1, std::memory_order_relaxed);
+    // wraps around like the sequence numbers
+    const int32_t ahead = static_cast<int32_t>(header.sequence - sequence.expected);
+    if (!sequence.started || ahead < -sequenceRestartWindow) {
+        sequence.started = true;
+        sequence.expected = header.sequence + 1;
+        sequence.lastReceived.store(sequence.expected, std::memory_order_relaxed);
+    } else if (ahead >= 0) {
+        sequence.gaps.fetch_add(ahead, std::memory_order_relaxed);
+        sequence.expected = header.sequence + 1;
+        sequence.lastReceived.store(sequence.expected, std::memory_order_relaxed);
+    } else {
+        // counted as missing when the newer message arrived
+        sequence.reordered.fetch_add(1, std::memory_order_relaxed);
+        if (sequence.gaps.load(std::memory_order_relaxed)) {
+            sequence.gaps.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+    return true;
+}
+
+void RobotController::expandJointNames(JointState *jointState) {
+    if (!jointNameTable.lockedAccess()->expand(jointState)) {
+        // sent for a table this controller doesn't know (yet)
+        renegotiateJointTable.store(compactJointTable.load() != 0);
+    }
+}
+
+void RobotController::updateJointNameTable(JointState *controllableJoints) {
+    if (jointNameTable.lockedAccess()->set(*controllableJoints) && compactJointTable.load()) {
+        renegotiateJointTable.store(true);
+    }
+}
+
 void RobotController::setSimpleActionCommand(const SimpleAction &simpleActionCommand) {
     sendProtobufData(simpleActionCommand, SIMPLE_ACTIONS_COMMAND);
 }
@@ -74,6 +279,34 @@ void RobotController::setRobotTrajectoryCommand(const Poses &robotTrajectoryComm
     sendProtobufData(robotTrajectoryCommand, ROBOT_TRAJECTORY_COMMAND);
 }
 
+bool RobotController::updateRobotTrajectory(const TrajectoryUpdate &update) {
+    std::string reply = sendProtobufData(update, ROBOT_TRAJECTORY_UPDATE);
+    if (reply.size() < sizeof(uint16_t)) {
+        return false;
+    }
+    uint16_t replytype = *reinterpret_cast<const uint16_t*>(reply.data());
+    return replytype == ROBOT_TRAJECTORY_UPDATE;
+}
+
+bool RobotController::appendToRobotTrajectory(const std::vector<Pose> &poses) {
+    TrajectoryUpdate update;
+    update.set_append(true);
+    for (const Pose &pose : poses) {
+        *update.add_poses() = pose;
+    }
+    return updateRobotTrajectory(update);
+}
+
+bool RobotController::replaceRobotTrajectoryTail(const uint32_t &startIndex, const std::vector<Pose> &poses) {
+    TrajectoryUpdate update;
+    update.set_start_index(startIndex);
+    update.set_truncate(true);
+    for (const Pose &pose : poses) {
+        *update.add_poses() = pose;
+    }
+    return updateRobotTrajectory(update);
+}
+
 void RobotController::setLogLevel(const uint16_t &level) {
     std::string buf;
     buf.resize(sizeof(uint16_t) + sizeof(uint16_t));
@@ -85,35 +318,221 @@ void RobotController::setLogLevel(const uint16_t &level) {
     sendRequest(buf);
 }
 
+bool RobotController::setTelemetryRateLimits(const TelemetryRateLimits &limits) {
+    std::string reply = sendProtobufData(limits, TELEMETRY_RATE_LIMITS);
+    if (reply.size() < sizeof(uint16_t)) {
+        return false;
+    }
+    uint16_t replytype = *reinterpret_cast<const uint16_t*>(reply.data());
+    return replytype == TELEMETRY_RATE_LIMITS;
+}
+
+bool RobotController::setTelemetryRateLimit(const uint16_t &type, const float &maxFrequency, const uint32_t &decimation) {
+    TelemetryRateLimits limits;
+    TelemetryRateLimit *limit = limits.add_limits();
+    limit->set_type(type);
+    limit->set_maxfrequency(maxFrequency);
+    limit->set_decimation(decimation);
+    return setTelemetryRateLimits(limits);
+}
+
+bool RobotController::setPointCloudEncoding(const PointCloudEncoding &encoding) {
+    std::string reply = sendProtobufData(encoding, POINTCLOUD_ENCODING);
+    if (reply.size() < sizeof(uint16_t)) {
+        return false;
+    }
+    uint16_t replytype = *reinterpret_cast<const uint16_t*>(reply.data());
+    return replytype == POINTCLOUD_ENCODING;
+}
+
+bool RobotController::setImageStreamConfigs(const ImageStreamConfigs &configs) {
+    std::string reply = sendProtobufData(configs, IMAGE_STREAM_CONFIG);
+    if (reply.size() < sizeof(uint16_t)) {
+        return false;
+    }
+    uint16_t replytype = *reinterpret_cast<const uint16_t*>(reply.data());
+    return replytype == IMAGE_STREAM_CONFIG;
+}
+
+bool RobotController::requestPointCloudMap(PointCloud *pointcloud, const uint16_t &mapId) {
+    Map map;
+    requestMap(&map, mapId);
+    if (!map.map().UnpackTo(pointcloud)) {
+        return false;
+    }
+    PointCloudCodec::decode(pointcloud);
+    return true;
+}
+
+bool RobotController::requestGridMap(GridMap *gridmap, const uint16_t &mapId) {
+    Map map;
+    requestMap(&map, mapId);
+    if (!map.map().UnpackTo(gridmap)) {
+        return false;
+    }
+    GridMapLayerCodec::decode(gridmap);
+    return true;
+}
+
 bool RobotController::setPermission(const Permission& permission) {
     sendProtobufData(permission, PERMISSION);
 }
 
 void RobotController::update() {
     if (telemetryTransport.get()) {
-        std::string buf;
         Transport::Flags flags = Transport::NONE;
         // if (!this->threaded()){
             flags = Transport::NOBLOCK;
         // }
-        while (telemetryTransport->receive(&buf, flags)) {
-            evaluateTelemetry(buf);
+        std::shared_ptr<TelemetryRecorder> recorder = std::atomic_load(&telemetryRecorder);
+        while (telemetryTransport->receive(&telemetryReceiveBuffer, flags)) {
+            receivedTelemetryBytes += telemetryReceiveBuffer.view().size;
+            RRC_TRACE(TELEMETRY_RECEIVED, NO_TELEMETRY_DATA, telemetryReceiveBuffer.view().size);
+            if (recorder) {
+                recorder->record(telemetryReceiveBuffer.view());
+            }
+            evaluateTelemetry(telemetryReceiveBuffer.view());
         }
     } else {
         printf("ERROR no telemetry Transport set\n");
     }
 
-    if (heartBeatDuration != 0 && heartBeatTimer.isExpired()) {
-        //TODO: check if send needed?
+    if (asyncRequests.load()) {
+        receiveReplies(0);
+    }
+
+    resumeStalledMapTransfers();
+
+    if (renegotiateJointTable.exchange(false)) {
+        setCompactJoints(true);
+    }
+
+    if (negotiationPending.exchange(false) && capabilityNegotiation.load()) {
+        Capabilities offer;
+        {
+            std::lock_guard<std::mutex> lock(capabilitiesMutex);
+            offer = capabilityOffer;
+        }
+        negotiateCapabilities(offer);
+    }
+
+    if (resumePending.exchange(false) && sessionResumption.load()) {
+        resumeSession();
+    }
+
+    if (pendingHeartbeat.valid() && pendingHeartbeat.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        // the round trip time is measured by receiveReplies()
+        std::string reply = pendingHeartbeat.get();
+        if (reply.size()) {
+            heartbeatAnnounced.store(true);
+            // received by receiveReplies() in this update(), the delay until here only lowers the weight of the sample
+            addClockSample(reply, pendingHeartbeatSentNs, ClockOffsetEstimator::nowNs());
+        }
+    }
+
+    // announced heartbeats were sent, so the timer was started
+    const bool refresh = heartbeatAnnounced.load() && explicitHeartbeatTimer.getElapsedTime() > heartbeatRefreshFactor * heartBeatDuration;
+    if (heartBeatDuration != 0 && (heartBeatTimer.lockedAccess()->isExpired() || refresh)) {
         if (commandTransport.get()) {
             HeartBeat hb;
             hb.set_heartbeatduration(heartBeatDuration);
-            latencyTimer.start();
-            std::string rep = sendProtobufData(hb, HEARTBEAT);
-            float time = latencyTimer.getElapsedTime();
-            heartBreatRoundTripTime.store(time);
+            hb.set_request_clock(true);
+            // the link measured since the last explicit heartbeat, for the BandwidthGovernor of the robot
+            float sinceLastHeartbeat = explicitHeartbeatTimer.getElapsedTime();
+            if (heartbeatAnnounced.load() && sinceLastHeartbeat > 0) {
+                hb.set_round_trip_time(heartBreatRoundTripTime.load());
+                hb.set_received_bytes_per_second((receivedTelemetryBytes - heartbeatReceivedBytes) / sinceLastHeartbeat);
+            }
+            if (asyncRequests.load()) {
+                // do not block update() (e.g. the other robots of a RobotControllerHub thread)
+                if (!pendingHeartbeat.valid()) {
+                    explicitHeartbeatTimer.start();
+                    heartbeatReceivedBytes = receivedTelemetryBytes;
+                    pendingHeartbeatSentNs = ClockOffsetEstimator::nowNs();
+                    pendingHeartbeat = sendCommandAsync(hb, HEARTBEAT);
+                }
+            } else {
+                explicitHeartbeatTimer.start();
+                heartbeatReceivedBytes = receivedTelemetryBytes;
+                // the round trip time is measured by sendRequestOn()
+                int64_t sentNs = ClockOffsetEstimator::nowNs();
+                std::string reply = sendProtobufData(hb, HEARTBEAT);
+                if (reply.size()) {
+                    heartbeatAnnounced.store(true);
+                    addClockSample(reply, sentNs, ClockOffsetEstimator::nowNs());
+                }
+            }
         }
-        heartBeatTimer.start(heartBeatDuration);
+        heartBeatTimer.lockedAccess()->start(heartBeatDuration);
+    }
+}
+
+void RobotController::requestCompleted(const uint16_t &type, const float &roundTripTime) {
+    if (receiveStatistics.isEnabled()) {
+        receiveStatistics.addRoundTrip(type, roundTripTime);
+    }
+    lastConnectedTimer.lockedAccess()->start();
+    if (!connected.exchange(true)) {
+        negotiationPending.store(true);
+        resumePending.store(true);
+    }
+    // smoothed like the TCP round trip time (RFC 6298)
+    float smoothed = heartBreatRoundTripTime.load();
+    float updated;
+    do {
+        updated = smoothed == 0 ? roundTripTime : smoothed + 0.125f * (roundTripTime - smoothed);
+    } while (!heartBreatRoundTripTime.compare_exchange_weak(smoothed, updated));
+    if (heartBeatDuration != 0 && heartbeatAnnounced.load()) {
+        // the request was a heartbeat for the robot
+        heartBeatTimer.lockedAccess()->start(heartBeatDuration);
+    }
+}
+
+void RobotController::addClockSample(const std::string &reply, const int64_t &sentNs, const int64_t &receivedNs) {
+    if (reply.size() < sizeof(uint16_t) + 2 * sizeof(int64_t) || MessageView(reply).get<uint16_t>() != HEARTBEAT) {
+        // older robots, NO_CONTROL_DATA
+        return;
+    }
+    int64_t robotReceiveNs, robotReplyNs;
+    memcpy(&robotReceiveNs, reply.data() + sizeof(uint16_t), sizeof(int64_t));
+    memcpy(&robotReplyNs, reply.data() + sizeof(uint16_t) + sizeof(int64_t), sizeof(int64_t));
+    clockOffset.addSample(sentNs, robotReceiveNs, robotReplyNs, receivedNs);
+}
+
+TimeStamp RobotController::toLocalTime(const TimeStamp &robotTime) {
+    int64_t robotNs = static_cast<int64_t>(robotTime.secs()) * 1000000000 + robotTime.nsecs();
+    int64_t localNs = clockOffset.toLocalNs(robotNs);
+    TimeStamp local;
+    local.set_secs(localNs / 1000000000);
+    local.set_nsecs(localNs % 1000000000);
+    return local;
+}
+
+double RobotController::getAge(const TimeStamp &robotTime) {
+    int64_t robotNs = static_cast<int64_t>(robotTime.secs()) * 1000000000 + robotTime.nsecs();
+    return (ClockOffsetEstimator::nowNs() - clockOffset.toLocalNs(robotNs)) / 1000000000.0;
+}
+
+bool RobotController::setMaxTelemetryAge(const uint16_t &type, const float &maxAgeSeconds) {
+    if (type >= telemetryAdders.size() || !telemetryAdders[type] || !telemetryAdders[type]->timestampField) {
+        return false;
+    }
+    telemetryAdders[type]->maxAgeUs.store(maxAgeSeconds > 0 ? static_cast<int64_t>(maxAgeSeconds * 1000000.0) : 0);
+    return true;
+}
+
+void RobotController::waitForUpdate(const unsigned int &maxMilliseconds) {
+    unsigned int timeout = maxMilliseconds;
+    if (heartBeatDuration != 0) {
+        float heartbeatRemaining = heartBeatTimer.lockedAccess()->getRemainingTime();
+        if (heartbeatRemaining >= 0) {
+            timeout = std::min(timeout, static_cast<unsigned int>(std::ceil(heartbeatRemaining * 1000.0)));
+        }
+    }
+    if (telemetryTransport.get()) {
+        telemetryTransport->waitForData(timeout);
+    } else {
+        UpdateThread::waitForUpdate(timeout);
     }
 }
 
@@ -121,55 +540,686 @@ void RobotController::requestMap(Map *map, const uint16_t &mapId){
     std::string replybuf;
     requestBinary(mapId, &replybuf, MAP_REQUEST);
     google::protobuf::io::CodedInputStream cistream(reinterpret_cast<const uint8_t *>(replybuf.data()), replybuf.size());
-    cistream.SetTotalBytesLimit(replybuf.size(), replybuf.size());
+    #if GOOGLE_PROTOBUF_VERSION >= 3006000
+        cistream.SetTotalBytesLimit(replybuf.size());
+    #else
+        cistream.SetTotalBytesLimit(replybuf.size(), replybuf.size());
+    #endif
     map->ParseFromCodedStream(&cistream);
 }
 
+int RobotController::refreshDescriptions() {
+    if (!descriptionCache) {
+        return -1;
+    }
+    const uint16_t header = DESCRIPTION_VERSIONS;
+    std::string request(reinterpret_cast<const char*>(&header), sizeof(uint16_t));
+    for (const uint16_t &type : descriptionCache->getTypes()) {
+        uint64_t hash = 0;
+        descriptionCache->getHash(type, &hash);
+        DescriptionCache::appendItem(&request, type, hash, MessageView());
+    }
+    std::string reply = sendRequest(request);
+    int transferred = 0;
+    // unchanged items have the cached hash and no payload
+    bool complete = DescriptionCache::parseItems(reply, [&](const uint16_t &type, const uint64_t &hash, const MessageView &payload) {
+        uint64_t cachedHash;
+        if (descriptionCache->getHash(type, &cachedHash) && cachedHash == hash) {
+            descriptionCache->setValidated(type);
+        } else {
+            descriptionCache->set(type, payload);
+            transferred++;
+        }
+    });
+    if (reply.empty() || !complete) {
+        printf("the robot does not support description versions\n");
+        return -1;
+    }
+    return transferred;
+}
+
+std::shared_ptr<TransformTree> RobotController::enableTransformTree(const size_t &historySize) {
+    if (transformTree) {
+        return transformTree;
+    }
+    std::shared_ptr<TransformTree> tree = std::make_shared<TransformTree>(historySize);
+    addTelemetryReceivedCallback<TRANSFORMS>([tree](const Transforms &transforms) {
+        tree->add(transforms);
+    });
+    addTelemetryReceivedCallback<STATIC_TRANSFORMS>([tree](const Transforms &transforms) {
+        tree->add(transforms, true);
+    });
+    transformTree = tree;
+    if (connected.load()) {
+        Transforms staticTransforms;
+        requestStaticTransforms(&staticTransforms);
+    }
+    return tree;
+}
+
+int RobotController::requestTelemetrySnapshot(const std::vector<uint16_t> &types, std::map<uint16_t, std::string> *payloads) {
+    std::string request;
+    request.resize(sizeof(uint16_t) * (types.size() + 1));
+    uint16_t* data = reinterpret_cast<uint16_t*>(&request[0]);
+    *data = TELEMETRY_BULK_REQUEST;
+    std::copy(types.begin(), types.end(), data + 1);
+    std::string reply = sendRequest(request);
+
+    int received = 0;
+    bool complete = parseTelemetryBatch(reply, [&](const TelemetryMessageType &msgtype, const MessageView &payload) {
+        // buffered like received telemetry, types that are not registered here are only returned
+        if (msgtype == SIMPLE_SENSOR_VALUE || msgtype == SIMPLE_SENSOR_VALUES || msgtype == LOG_MESSAGES || (msgtype < telemetryAdders.size() && telemetryAdders[msgtype].get())) {
+            evaluateTelemetryPayload(msgtype, payload);
+        }
+        if (payloads) {
+            (*payloads)[msgtype].assign(payload.data, payload.size);
+        }
+        received++;
+    });
+    // an empty reply is a valid snapshot without messages, an old robot replies NO_CONTROL_DATA
+    if (!complete) {
+        printf("the robot does not support bulk telemetry requests\n");
+        return -1;
+    }
+    return received;
+}
+
+int RobotController::resumeSession() {
+    std::string request;
+    const uint16_t type = SESSION_RESUME;
+    const uint64_t session = robotSessionId.load();
+    request.append(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+    request.append(reinterpret_cast<const char*>(&session), sizeof(uint64_t));
+    for (uint16_t telemetryType = 0; telemetryType < telemetrySequences.size(); ++telemetryType) {
+        const uint32_t lastReceived = telemetrySequences[telemetryType].lastReceived.load(std::memory_order_relaxed);
+        if (lastReceived) {
+            const uint32_t sequence = lastReceived - 1;
+            request.append(reinterpret_cast<const char*>(&telemetryType), sizeof(uint16_t));
+            request.append(reinterpret_cast<const char*>(&sequence), sizeof(uint32_t));
+        }
+    }
+    std::string reply = sendRequest(request);
+    if (reply.size() < sizeof(uint64_t)) {
+        printf("the robot does not support session resumption\n");
+        return -1;
+    }
+    const uint64_t replySession = *reinterpret_cast<const uint64_t*>(reply.data());
+    if (session && replySession != session && wireHeaderVersion.load()) {
+        // a restarted robot sends the plain header
+        setVersionedHeader(true);
+    }
+    robotSessionId.store(replySession);
+
+    int received = 0;
+    parseTelemetryBatch(MessageView(reply).sub(sizeof(uint64_t)), [&](const TelemetryMessageType &msgtype, const MessageView &payload) {
+        if (msgtype == SIMPLE_SENSOR_VALUE || msgtype == SIMPLE_SENSOR_VALUES || msgtype == LOG_MESSAGES || (msgtype < telemetryAdders.size() && telemetryAdders[msgtype].get())) {
+            evaluateTelemetryPayload(msgtype, payload);
+        }
+        received++;
+    });
+    return received;
+}
+
+std::shared_ptr<MapTransfer> RobotController::startMapTransfer(const uint32_t &mapId, const std::function<void(const float &progress)> &progressCallback,
+                                                               const uint32_t &chunkSize, const uint64_t &maxSize) {
+    if (telemetryFiltered.load()) {
+        subscribeTelemetry(MAP_CHUNK);
+    }
+    // random start, so transfers of several controllers do not mix up
+    std::shared_ptr<MapTransfer> transfer = std::make_shared<MapTransfer>(nextMapTransferId++, mapId, chunkSize, progressCallback, maxSize);
+    {
+        std::lock_guard<std::mutex> lock(mapTransferMutex);
+        mapTransfers[transfer->getTransferId()] = transfer;
+    }
+    if (!resumeMapTransfer(transfer)) {
+        std::lock_guard<std::mutex> lock(mapTransferMutex);
+        mapTransfers.erase(transfer->getTransferId());
+        return std::shared_ptr<MapTransfer>();
+    }
+    return transfer;
+}
+
+bool RobotController::resumeMapTransfer(const std::shared_ptr<MapTransfer> &transfer) {
+    MapTransferRequest request = transfer->getResumeRequest();
+    std::string reply = sendProtobufData(request, MAP_TRANSFER_REQUEST);
+    MapTransferInfo info;
+    if (reply.empty() || !info.ParseFromString(reply) || info.transfer_id() != transfer->getTransferId()) {
+        return false;
+    }
+    if (!transfer->setInfo(info)) {
+        return false;
+    }
+    if (transfer->getFirstMissingChunk() < request.first_chunk()) {
+        // the robot had to take a new snapshot of a changed map, all chunks are needed
+        return resumeMapTransfer(transfer);
+    }
+    return true;
+}
+
+void RobotController::resumeStalledMapTransfers() {
+    std::vector< std::shared_ptr<MapTransfer> > stalled;
+    {
+        std::lock_guard<std::mutex> lock(mapTransferMutex);
+        for (auto entry = mapTransfers.begin(); entry != mapTransfers.end();) {
+            std::shared_ptr<MapTransfer> transfer = entry->second.lock();
+            if (!transfer.get()) {
+                entry = mapTransfers.erase(entry);
+                continue;
+            }
+            if (!transfer->isComplete() && transfer->getSecondsSinceLastChunk() > maxLatency) {
+                stalled.push_back(transfer);
+            }
+            ++entry;
+        }
+    }
+    // requests without holding the lock, chunks may be received meanwhile
+    for (const std::shared_ptr<MapTransfer> &transfer : stalled) {
+        resumeMapTransfer(transfer);
+    }
+}
+
+void RobotController::evaluateMapChunk(const MessageView& serializedMessage) {
+    MapChunk chunk;
+    if (!chunk.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+        printf("unable to parse map chunk\n");
+        return;
+    }
+    std::shared_ptr<MapTransfer> transfer;
+    {
+        std::lock_guard<std::mutex> lock(mapTransferMutex);
+        auto entry = mapTransfers.find(chunk.info().transfer_id());
+        if (entry == mapTransfers.end()) {
+            // transfer of another controller or dropped
+            return;
+        }
+        transfer = entry->second.lock();
+    }
+    if (transfer.get()) {
+        transfer->addChunk(chunk);
+    }
+}
+
+int RobotController::requestMapTiles(MapTileCache *cache, const uint32_t &mapId) {
+    std::string reply = sendProtobufData(cache->getRequest(mapId), MAP_TILES_REQUEST);
+    MapTiles tiles;
+    if (reply.empty() || !tiles.ParseFromString(reply)) {
+        return -1;
+    }
+    return cache->merge(tiles);
+}
+
 std::string RobotController::sendRequest(const std::string& serializedMessage, const robot_remote_control::Transport::Flags &flags) {
-    std::lock_guard<std::mutex> lock(commandTransportMutex);
+    return sendRequest(MessageView(serializedMessage), 0, robot_remote_control::Transport::PayloadWriter(), flags);
+}
+
+std::string RobotController::sendRequest(const MessageView &header, const size_t &payloadSize, const robot_remote_control::Transport::PayloadWriter &writePayload,
+                                         const robot_remote_control::Transport::Flags &flags) {
+    if (header.size == sizeof(uint16_t) && isStreamedType(header.get<uint16_t>())) {
+        return sendStreamed(header, payloadSize, writePayload);
+    }
+    if (header.size >= sizeof(uint16_t) && isControlLaneType(header.get<uint16_t>())) {
+        // not queued behind bulk requests, which only lock the commandTransportMutex
+        return sendRequestOn(controlTransport, &controlTransportMutex, header, payloadSize, writePayload, flags);
+    }
+
+    if (asyncRequests.load()) {
+        std::future<std::string> reply = sendRequestAsync(header, payloadSize, writePayload, flags);
+        // pending requests expire after maxLatency, so this terminates
+        while (reply.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            receiveReplies(1);
+        }
+        return reply.get();
+    }
+
+    return sendRequestOn(commandTransport, &commandTransportMutex, header, payloadSize, writePayload, flags);
+}
+
+void RobotController::connectionLost(const float &time) {
+    connected.store(false);
+    if (descriptionCache) {
+        // the robot may have changed meanwhile
+        descriptionCache->invalidate();
+    }
+    lostConnectionCallback(time);
+}
+
+std::string RobotController::sendRequestOn(const TransportSharedPtr &transport, std::mutex *transportMutex, const MessageView &header, const size_t &payloadSize,
+                                           const robot_remote_control::Transport::PayloadWriter &writePayload, const robot_remote_control::Transport::Flags &flags) {
+    std::lock_guard<std::mutex> lock(*transportMutex);
+    const uint16_t requestType = header.size >= sizeof(uint16_t) ? header.get<uint16_t>() : static_cast<uint16_t>(CONTROL_MESSAGE_TYPE_NUMBER);
+    RRC_TRACE(REQUEST_WAIT_START, requestType, header.size + payloadSize);
     try {
-        commandTransport->send(serializedMessage, flags);
+        transport->send(header, payloadSize, writePayload, flags);
     }catch (const std::exception &error) {
-        connected.store(false);
-        lostConnectionCallback(maxLatency);
+        connectionLost(maxLatency);
+        RRC_TRACE(REQUEST_WAIT_END, requestType, 0);
         return "";
     }
     std::string replystr;
 
+    // one timer per lane, the lanes may wait at the same time
+    Timer requestTimer;
     requestTimer.start(maxLatency);
-    while (commandTransport->receive(&replystr, flags) == 0 && !requestTimer.isExpired()) {
+    while (transport->receive(&replystr, flags) == 0 && !requestTimer.isExpired()) {
         // wait time depends on how long the transports recv blocks
         usleep(1000);
     }
+    RRC_TRACE(REQUEST_WAIT_END, requestType, replystr.size());
     if (requestTimer.isExpired()) {
-        connected.store(false);
-        lostConnectionCallback(lastConnectedTimer.getElapsedTime());
+        connectionLost(lastConnectedTimer.lockedAccess()->getElapsedTime());
         return "";
     }
-    lastConnectedTimer.start();
-    connected.store(true);
+    requestCompleted(requestType, requestTimer.getElapsedTime());
     return replystr;
 }
 
-TelemetryMessageType RobotController::evaluateTelemetry(const std::string& reply) {
-    uint16_t* type = reinterpret_cast<uint16_t*>(const_cast<char*>(reply.data()));
+void RobotController::setControlTransport(const TransportSharedPtr &transport, const std::vector<uint16_t> &types) {
+    controlLaneTypes.assign(CONTROL_MESSAGE_TYPE_NUMBER, false);
+    for (const uint16_t &type : types) {
+        if (type >= controlLaneTypes.size()) {
+            controlLaneTypes.resize(type + 1, false);
+        }
+        controlLaneTypes[type] = true;
+    }
+    controlTransport = transport;
+}
+
+void RobotController::setCommandStreamTransport(const TransportSharedPtr &transport, const std::vector<uint16_t> &types) {
+    streamedTypes.assign(CONTROL_MESSAGE_TYPE_NUMBER, false);
+    for (const uint16_t &type : types) {
+        if (type >= streamedTypes.size()) {
+            streamedTypes.resize(type + 1, false);
+        }
+        streamedTypes[type] = true;
+    }
+    streamSequences.assign(streamedTypes.size(), 0);
+    // new per controller, so the robot does not compare the sequence numbers to the ones of a previous controller
+    streamId = std::random_device()();
+    commandStreamTransport = transport;
+}
+
+std::string RobotController::sendStreamed(const MessageView &header, const size_t &payloadSize, const robot_remote_control::Transport::PayloadWriter &writePayload) {
+    // [uint32 stream][uint32 sequence][uint16 type][payload], so the robot evaluates the message behind the sequence like a request
+    char streamHeader[2 * sizeof(uint32_t) + sizeof(uint16_t)];
+    const uint16_t type = header.get<uint16_t>();
+    std::lock_guard<std::mutex> lock(commandStreamMutex);
+    const uint32_t sequence = ++streamSequences[type];
+    memcpy(streamHeader, &streamId, sizeof(uint32_t));
+    memcpy(streamHeader + sizeof(uint32_t), &sequence, sizeof(uint32_t));
+    memcpy(streamHeader + 2 * sizeof(uint32_t), &type, sizeof(uint16_t));
+    try {
+        commandStreamTransport->send(MessageView(streamHeader, sizeof(streamHeader)), payloadSize, writePayload, robot_remote_control::Transport::NOBLOCK);
+    }catch (const std::exception &error) {
+        printf("unable to stream command of type %i: %s\n", type, error.what());
+    }
+    // there is no reply
+    return "";
+}
+
+std::future<std::string> RobotController::sendRequestAsync(const MessageView &header, const size_t &payloadSize, const robot_remote_control::Transport::PayloadWriter &writePayload,
+                                                           const robot_remote_control::Transport::Flags &flags) {
+    uint32_t requestId = nextRequestId++;
+    std::future<std::string> future;
+    {
+        std::lock_guard<std::mutex> lock(pendingRequestsMutex);
+        PendingRequest &pending = pendingRequests[requestId];
+        future = pending.reply.get_future();
+        pending.timeout.start(maxLatency);
+        pending.type = header.get<uint16_t>();
+    }
+
+    // [type | REQUEST_ID_FLAG][request id][rest of the header][payload]
+    uint16_t type = header.get<uint16_t>() | REQUEST_ID_FLAG;
+    char idHeader[sizeof(uint16_t) + sizeof(uint32_t)];
+    memcpy(idHeader, &type, sizeof(uint16_t));
+    memcpy(idHeader + sizeof(uint16_t), &requestId, sizeof(uint32_t));
+    MessageView headerRest = header.sub(sizeof(uint16_t));
+
+    std::lock_guard<std::mutex> lock(commandTransportMutex);
+    try {
+        commandTransport->send(MessageView(idHeader, sizeof(idHeader)), headerRest.size + payloadSize, [&](char* target) {
+            if (headerRest.size) {
+                memcpy(target, headerRest.data, headerRest.size);
+            }
+            if (payloadSize && writePayload) {
+                writePayload(target + headerRest.size);
+            }
+        }, flags);
+    } catch (const std::exception &error) {
+        connectionLost(maxLatency);
+        std::lock_guard<std::mutex> pendingLock(pendingRequestsMutex);
+        auto pending = pendingRequests.find(requestId);
+        if (pending != pendingRequests.end()) {
+            pending->second.reply.set_value("");
+            pendingRequests.erase(pending);
+        }
+    }
+    return future;
+}
+
+void RobotController::receiveReplies(const unsigned int &timeoutMs) {
+    bool expired = false;
+    {
+        std::lock_guard<std::mutex> lock(commandTransportMutex);
+        if (commandTransport->waitForData(timeoutMs)) {
+            while (commandTransport->receive(&replyReceiveBuffer, robot_remote_control::Transport::NOBLOCK)) {
+                const MessageView &reply = replyReceiveBuffer.view();
+                if (reply.size < sizeof(uint32_t)) {
+                    continue;
+                }
+                uint32_t requestId = reply.get<uint32_t>();
+                std::lock_guard<std::mutex> pendingLock(pendingRequestsMutex);
+                auto pending = pendingRequests.find(requestId);
+                if (pending != pendingRequests.end()) {
+                    pending->second.reply.set_value(reply.sub(sizeof(uint32_t)).toString());
+                    requestCompleted(pending->second.type, pending->second.timeout.getElapsedTime());
+                    pendingRequests.erase(pending);
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> pendingLock(pendingRequestsMutex);
+        for (auto pending = pendingRequests.begin(); pending != pendingRequests.end();) {
+            if (pending->second.timeout.isExpired()) {
+                pending->second.reply.set_value("");
+                pending = pendingRequests.erase(pending);
+                expired = true;
+            } else {
+                ++pending;
+            }
+        }
+    }
+    if (expired) {
+        connectionLost(lastConnectedTimer.lockedAccess()->getElapsedTime());
+    }
+}
+
+TelemetryMessageType RobotController::evaluateTelemetry(const MessageView& reply) {
+    WireHeader header;
+    const size_t headerSize = WireHeader::read(reply.data, reply.size, &header);
+    if (!headerSize) {
+        return NO_TELEMETRY_DATA;
+    }
+    RRC_TRACE_SCOPE(TELEMETRY_PARSE_START, TELEMETRY_PARSE_END, header.type, reply.size);
+    if (header.version && !countSequence(header) && header.type < telemetryAdders.size()
+        && telemetryAdders[header.type] && telemetryAdders[header.type]->overwrite.load()) {
+        // e.g. a pose delayed on an unreliable transport, the buffer has a newer one already
+        telemetrySequences[header.type].dropped.fetch_add(1, std::memory_order_relaxed);
+        return NO_TELEMETRY_DATA;
+    }
+
+    if (header.flags & WireHeader::FIXED_LAYOUT) {
+        return evaluateFixedLayout((TelemetryMessageType)header.type, reply.sub(headerSize));
+    }
+    // no copy, just a view on the data behind the header
+    return evaluateTelemetryPayload((TelemetryMessageType)header.type, reply.sub(headerSize));
+}
+
+TelemetryMessageType RobotController::evaluateFixedLayout(const TelemetryMessageType &msgtype, const MessageView& message) {
+    if (msgtype >= telemetryAdders.size() || !telemetryAdders[msgtype].get()) {
+        // only offered for the types of this library, which are always registered
+        printf("fixed layout of unregistered type %i, dropping telemetry\n", msgtype);
+        return NO_TELEMETRY_DATA;
+    }
+    const std::shared_ptr<TelemetryAdderBase> &adder = telemetryAdders[msgtype];
+    const bool statistics = receiveStatistics.isEnabled();
+    const int64_t maxAgeUs = adder->maxAgeUs.load(std::memory_order_relaxed);
+    if (statistics || maxAgeUs) {
+        int64_t timestampNs;
+        if (adder->fixedLayoutTimestamp(message, &timestampNs)) {
+            int64_t ageUs = localAgeUs(timestampNs / 1000);
+            if (statistics) {
+                receiveStatistics.addReceived(msgtype, message.size, std::max<int64_t>(0, ageUs));
+            }
+            if (maxAgeUs && ageUs > maxAgeUs) {
+                adder->staleDropped.fetch_add(1, std::memory_order_relaxed);
+                return msgtype;
+            }
+        } else if (statistics) {
+            receiveStatistics.addReceived(msgtype, message.size);
+        }
+    }
+    if (!adder->addFixedLayout(msgtype, message)) {
+        printf("unable to decode fixed layout of type %i (%zu bytes), dropping telemetry\n", msgtype, message.size);
+        return NO_TELEMETRY_DATA;
+    }
+    telemetrySignal.notify();
+    return msgtype;
+}
+
+bool RobotController::subscribeTelemetry(const uint16_t &type) {
+    if (!telemetryTransport.get()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(telemetrySubscriptionMutex);
+    if (telemetrySubscriptions.empty()) {
+        // batches and chunks may contain the subscribed types
+        if (!subscribeTopics(TELEMETRY_BATCH, true) || !subscribeTopics(TELEMETRY_CHUNK, true)) {
+            return false;
+        }
+        telemetrySubscriptions.insert(TELEMETRY_BATCH);
+        telemetrySubscriptions.insert(TELEMETRY_CHUNK);
+    }
+    if (!subscribeTopics(type, true)) {
+        return false;
+    }
+    telemetrySubscriptions.insert(type);
+    telemetryFiltered.store(true);
+    return true;
+}
+
+bool RobotController::unsubscribeTelemetry(const uint16_t &type) {
+    if (!telemetryTransport.get()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(telemetrySubscriptionMutex);
+    if (!subscribeTopics(type, false)) {
+        return false;
+    }
+    telemetrySubscriptions.erase(type);
+    return true;
+}
+
+bool RobotController::subscribeTopics(const uint16_t &type, const bool &subscribe) {
+    // the type header is the topic, with and without the versioned header
+    for (const uint16_t topic : {type, static_cast<uint16_t>(type | WIRE_HEADER_FLAG)}) {
+        std::string serialized(reinterpret_cast<const char*>(&topic), sizeof(uint16_t));
+        if (!(subscribe ? telemetryTransport->subscribe(serialized) : telemetryTransport->unsubscribe(serialized))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RobotController::subscribeRegisteredTelemetry() {
+    bool result = subscribeTelemetry(SIMPLE_SENSOR_VALUE) && subscribeTelemetry(SIMPLE_SENSOR_VALUES);
+    if (result && telemetryAdders[LOG_MESSAGE].get()) {
+        result = subscribeTelemetry(LOG_MESSAGES);
+    }
+    for (size_t type = 0; type < telemetryAdders.size() && result; ++type) {
+        if (telemetryAdders[type].get()) {
+            result = subscribeTelemetry(type);
+        }
+    }
+    return result;
+}
+
+bool RobotController::isTelemetrySubscribed(const uint16_t &type) {
+    if (!telemetryFiltered.load()) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(telemetrySubscriptionMutex);
+    return telemetrySubscriptions.find(type) != telemetrySubscriptions.end();
+}
 
-    std::string serializedMessage(reply.data()+sizeof(uint16_t), reply.size()-sizeof(uint16_t));
+bool RobotController::parseTelemetryBatch(const MessageView& batch, const std::function<void(const TelemetryMessageType &type, const MessageView &payload)> &item) {
+    const size_t headerSize = sizeof(uint16_t) + sizeof(uint32_t);
+    size_t offset = 0;
+    while (batch.size - offset >= headerSize) {
+        TelemetryMessageType msgtype = (TelemetryMessageType)batch.get<uint16_t>(offset);
+        uint32_t size = batch.get<uint32_t>(offset + sizeof(uint16_t));
+        offset += headerSize;
+        if (size > batch.size - offset) {
+            return false;
+        }
+        item(msgtype, MessageView(batch.data + offset, size));
+        offset += size;
+    }
+    return offset == batch.size;
+}
 
-    TelemetryMessageType msgtype = (TelemetryMessageType)*type;
+void RobotController::evaluateTelemetryBatch(const MessageView& batch) {
+    bool complete = parseTelemetryBatch(batch, [this](const TelemetryMessageType &msgtype, const MessageView &payload) {
+        // no nested batches
+        if (msgtype != TELEMETRY_BATCH && isTelemetrySubscribed(msgtype)) {
+            evaluateTelemetryPayload(msgtype, payload);
+        }
+    });
+    if (!complete) {
+        printf("incomplete telemetry batch, dropping the rest\n");
+    }
+}
 
+void RobotController::evaluateTelemetryChunk(const MessageView& chunk) {
+    // [uint16_t type][uint32_t message id][uint32_t offset][uint32_t message size][bytes]
+    const size_t headerSize = sizeof(uint16_t) + 3 * sizeof(uint32_t);
+    if (chunk.size < headerSize) {
+        return;
+    }
+    const uint16_t type = chunk.get<uint16_t>();
+    const uint32_t messageId = chunk.get<uint32_t>(2);
+    const uint32_t offset = chunk.get<uint32_t>(6);
+    const uint32_t messageSize = chunk.get<uint32_t>(10);
+    const MessageView part = chunk.sub(headerSize);
+    // no nested chunks or batches
+    if (type == TELEMETRY_CHUNK || type == TELEMETRY_BATCH || !isTelemetrySubscribed(type)) {
+        return;
+    }
+    ChunkedMessage &message = chunkedMessages[type];
+    if (offset == 0) {
+        if (messageSize > maxChunkedMessageSize.load()) {
+            printf("ERROR chunked message of type %u with %u bytes exceeds the maximum size of %zu bytes, dropping it\n",
+                   type, messageSize, maxChunkedMessageSize.load());
+            // the following chunks of the message do not match the offset
+            message.data.clear();
+            message.received = 0;
+            return;
+        }
+        // keeps the capacity of the previous message
+        message.messageId = messageId;
+        message.data.resize(messageSize);
+        message.received = 0;
+    } else if (message.messageId != messageId || offset != message.received) {
+        // a chunk was lost, the next message of the type starts with offset 0
+        return;
+    }
+    if (offset + part.size > message.data.size()) {
+        return;
+    }
+    if (part.size) {
+        memcpy(&message.data[offset], part.data, part.size);
+    }
+    message.received += part.size;
+    if (message.received == message.data.size()) {
+        evaluateTelemetryPayload(static_cast<TelemetryMessageType>(type), message.data);
+        message.received = 0;
+    }
+}
+
+void RobotController::setOffThreadParsing(const std::vector<uint16_t> &types, const size_t &threads, const size_t &maxQueued) {
+    parseExecutor.reset();
+    offThreadTypes.clear();
+    if (types.empty()) {
+        return;
+    }
+    parseExecutor.reset(new CallbackExecutor(threads, maxQueued));
+    for (const uint16_t &type : types) {
+        if (type >= offThreadTypes.size()) {
+            offThreadTypes.resize(type + 1, false);
+        }
+        offThreadTypes[type] = true;
+        parseExecutor->setPolicy(type, CallbackExecutor::ORDERED);
+    }
+}
+
+TelemetryMessageType RobotController::evaluateTelemetryPayload(const TelemetryMessageType &msgtype, const MessageView& serializedMessage) {
     // try to resolve through registered types
-    std::shared_ptr<TelemetryAdderBase> adder = telemetryAdders[msgtype];
-    if (adder.get()) {
-        adder->addToTelemetryBuffer(msgtype, serializedMessage);
-        return msgtype;
+    if (msgtype < telemetryAdders.size()) {
+        const std::shared_ptr<TelemetryAdderBase> &adder = telemetryAdders[msgtype];
+        if (adder.get()) {
+            const bool statistics = receiveStatistics.isEnabled();
+            const int64_t maxAgeUs = adder->maxAgeUs.load(std::memory_order_relaxed);
+            if (statistics || maxAgeUs) {
+                int64_t timestamp;
+                if (adder->timestampField && ReceiveStatistics::readTimestamp(serializedMessage, adder->timestampField, &timestamp)) {
+                    int64_t ageUs = localAgeUs(timestamp);
+                    if (statistics) {
+                        receiveStatistics.addReceived(msgtype, serializedMessage.size, std::max<int64_t>(0, ageUs));
+                    }
+                    if (maxAgeUs && ageUs > maxAgeUs) {
+                        // stale, would only push out newer messages of the buffer
+                        adder->staleDropped.fetch_add(1, std::memory_order_relaxed);
+                        return msgtype;
+                    }
+                } else if (statistics) {
+                    receiveStatistics.addReceived(msgtype, serializedMessage.size);
+                }
+            }
+            if (descriptionCache && descriptionCache->isCached(msgtype)) {
+                // sent by the robot, so it is the current description
+                descriptionCache->set(msgtype, serializedMessage);
+            }
+            if (msgtype == SIMPLE_SENSOR_DEFINITION) {
+                SimpleSensors definition;
+                if (definition.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                    initSimpleSensorBuffers(definition);
+                }
+            }
+            if (parseExecutor && msgtype < offThreadTypes.size() && offThreadTypes[msgtype] && !buffers->isLazy(msgtype)) {
+                // copied, the receive buffer is reused by the next update
+                std::shared_ptr<std::string> payload = std::make_shared<std::string>(serializedMessage.data, serializedMessage.size);
+                std::shared_ptr<TelemetryAdderBase> parser = adder;
+                parseExecutor->post(msgtype, [this, parser, msgtype, payload]() {
+                    parser->parseAndAdd(msgtype, *payload);
+                    telemetrySignal.notify();
+                });
+                return msgtype;
+            }
+            adder->addToTelemetryBuffer(msgtype, serializedMessage);
+            telemetrySignal.notify();
+            return msgtype;
+        }
     }
 
     // handle special types
 
     switch (msgtype) {
         // multi values in single stream
-        case SIMPLE_SENSOR_VALUE:       addToSimpleSensorBuffer(serializedMessage);
+        case SIMPLE_SENSOR_VALUE:       if (receiveStatistics.isEnabled()) {
+                                            receiveStatistics.addReceived(msgtype, serializedMessage.size);
+                                        }
+                                        addToSimpleSensorBuffer(serializedMessage);
+                                        return msgtype;
+
+        case SIMPLE_SENSOR_VALUES:      if (receiveStatistics.isEnabled()) {
+                                            receiveStatistics.addReceived(msgtype, serializedMessage.size);
+                                        }
+                                        addSimpleSensorsToBuffer(serializedMessage);
+                                        return msgtype;
+
+        case LOG_MESSAGES:              if (receiveStatistics.isEnabled()) {
+                                            receiveStatistics.addReceived(msgtype, serializedMessage.size);
+                                        }
+                                        evaluateLogMessages(serializedMessage);
+                                        return msgtype;
+
+        case TELEMETRY_BATCH:           evaluateTelemetryBatch(serializedMessage);
+                                        return msgtype;
+
+        case MAP_CHUNK:                 evaluateMapChunk(serializedMessage);
+                                        return msgtype;
+
+        case TELEMETRY_CHUNK:           evaluateTelemetryChunk(serializedMessage);
                                         return msgtype;
 
         case TELEMETRY_MESSAGE_TYPES_NUMBER:
@@ -188,15 +1238,47 @@ TelemetryMessageType RobotController::evaluateTelemetry(const std::string& reply
     return NO_TELEMETRY_DATA;
 }
 
-void RobotController::addToSimpleSensorBuffer(const std::string &serializedMessage) {
+void RobotController::evaluateLogMessages(const MessageView &serializedMessage) {
+    if (!telemetryAdders[LOG_MESSAGE].get()) {
+        return;
+    }
+    using google::protobuf::internal::WireFormatLite;
+    // the entries are serialized LogMessages, they are evaluated without parsing the batch
+    google::protobuf::io::CodedInputStream stream(reinterpret_cast<const uint8_t*>(serializedMessage.data), serializedMessage.size);
+    while (uint32_t tag = stream.ReadTag()) {
+        if (WireFormatLite::GetTagFieldNumber(tag) != 1 || WireFormatLite::GetTagWireType(tag) != WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+            if (!WireFormatLite::SkipField(&stream, tag)) {
+                break;
+            }
+            continue;
+        }
+        uint32_t length;
+        if (!stream.ReadVarint32(&length) || stream.CurrentPosition() + length > serializedMessage.size) {
+            printf("unable to parse message of type %i in %s:%i\n", LOG_MESSAGES, __FILE__, __LINE__);
+            break;
+        }
+        evaluateTelemetryPayload(LOG_MESSAGE, MessageView(serializedMessage.data + stream.CurrentPosition(), length));
+        stream.Skip(length);
+    }
+}
+
+void RobotController::addToSimpleSensorBuffer(const MessageView &serializedMessage) {
     SimpleSensor data;
-    data.ParseFromString(serializedMessage);
-    // check if buffer number is big enough
-    // size must be id+1 (id 0 needs size 1)
-    simplesensorbuffer->initBufferID(data.id());
-    // if (simplesensorbuffer->size() <= data.id()){
-    //     simplesensorbuffer->resize(data.id());
-    // }
-
-    RingBufferAccess::pushData(simplesensorbuffer->lockedAccess().get()[data.id()], data, true);
+    data.ParseFromArray(serializedMessage.data, serializedMessage.size);
+    // the buffer of the id is created if needed
+    simplesensorbuffer->pushData(std::move(data));
+}
+
+void RobotController::addSimpleSensorsToBuffer(const MessageView &serializedMessage) {
+    if (!receivedSimpleSensors.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+        printf("unable to parse simple sensor values\n");
+        return;
+    }
+    simplesensorbuffer->pushAll(receivedSimpleSensors.mutable_sensors());
+}
+
+void RobotController::initSimpleSensorBuffers(const SimpleSensors &definition) {
+    simplesensorbuffer->initBuffers(definition.sensors(), [](const SimpleSensor &sensor) {
+        return static_cast<size_t>(sensor.buffer_size());
+    });
 }
@@ -5,13 +5,32 @@
 #include <memory>
 #include <mutex>
 #include <atomic>
+#include <map>
+#include <set>
+#include <future>
 
 #include "MessageTypes.hpp"
+#include "MessageTraits.hpp"
 #include "Transports/Transport.hpp"
 #include "TelemetryBuffer.hpp"
+#include "PointCloudCodec.hpp"
+#include "FixedLayout.hpp"
+#include "MapTiles.hpp"
+#include "MapTransfer.hpp"
+#include "JointNameTable.hpp"
+#include "Types/Conversions/GridMapLayerCodec.hpp"
 #include "SimpleBuffer.hpp"
+#include "ReceiveStatistics.hpp"
+#include "ClockOffsetEstimator.hpp"
+#include "DataSignal.hpp"
+#include "DescriptionCache.hpp"
+#include "TransformTree.hpp"
+#include "TelemetryLog.hpp"
+#include "SharedTelemetryStore.hpp"
+#include "Tracing.hpp"
 #include "UpdateThread/UpdateThread.hpp"
 #include "UpdateThread/Timer.hpp"
+#include "UpdateThread/CallbackExecutor.hpp"
 
 
 
@@ -30,15 +49,82 @@ class RobotController: public UpdateThread {
          */
         virtual void update();
 
+        /**
+         * @brief used in UpdateThread::REACTOR mode: waits for telemetry, but not longer than the next heartbeat is due
+         */
+        virtual void waitForUpdate(const unsigned int &maxMilliseconds);
+
         /**
          * @brief sets the expected next heartbeat time on the robot side
          * The value is trasmitted with the heartbeat message and is evaluated on the robot side, (stable) latency
-         * it not an issue
+         * it not an issue.
+         * Each request with a reply counts as a heartbeat on both sides, an explicit heartbeat is only sent when there
+         * was no request for this duration (and at least every heartbeatRefreshFactor durations, for robots that restarted)
          */
         void setHeartBeatDuration(const float &duration_seconds) {
             heartBeatDuration = duration_seconds;
-            heartBeatTimer.start(heartBeatDuration);
+            heartbeatAnnounced.store(false);
+            heartBeatTimer.lockedAccess()->start(heartBeatDuration);
+        }
+        /**
+         * @brief enable pipelined requests: each request gets a request id (see REQUEST_ID_FLAG) and replies are matched
+         * by it, so many requests can be outstanding at the same time. Requires a command transport that allows this
+         * (e.g. TransportZmq::DEALER with TransportZmq::ROUTER on the robot side).
+         * The synchronous functions then wait for their own reply only, replies are received while waiting and in update()
+         */
+        void setAsyncRequests(bool enable) {
+            asyncRequests.store(enable);
+        }
+
+        /**
+         * @brief send real-time commands on a separate transport, so they are not delayed by bulk requests (e.g. requestMap())
+         * that keep the command transport busy. The robot needs the matching transport, see ControlledRobot::setControlTransport().
+         * The commands of the control lane are always sent synchronously (not with setAsyncRequests()).
+         * @warning has to be called before the update thread is started
+         *
+         * @param transport the transport, e.g. a second REQ socket, nullptr to send everything on the command transport
+         * @param types the command types sent on the control lane
+         */
+        void setControlTransport(const TransportSharedPtr &transport,
+                                 const std::vector<uint16_t> &types = {TWIST_COMMAND, JOINTS_COMMAND, HEARTBEAT});
+
+        /**
+         * @brief stream commands without waiting for acknowledgements (e.g. high rate teleoperation), each command
+         * is sent with a sequence number per type, the robot drops commands older than the last one it received from this controller.
+         * Lost commands are not repeated, the heartbeat (on the command transport) tells whether the robot is connected.
+         * The robot needs the matching transport, see ControlledRobot::setCommandStreamTransport().
+         * @warning has to be called before the update thread is started
+         *
+         * @param transport a transport without replies (e.g. TransportZmq::PUSH), nullptr to send everything as requests
+         * @param types the command types to stream, their setters do not wait for replies
+         */
+        void setCommandStreamTransport(const TransportSharedPtr &transport,
+                                       const std::vector<uint16_t> &types = {TWIST_COMMAND, JOINTS_COMMAND});
+
+        /**
+         * @brief send a command without waiting for the reply, without setAsyncRequests(true) it waits anyway
+         * @warning the reply is only received while in update() or other requests are waiting, so the update thread should run
+         *
+         * @param protodata the command
+         * @param type the ControlMessageType of the command
+         * @return std::future<std::string> the reply, empty if no reply was received within maxLatency
+         */
+        template< class CLASS > std::future<std::string> sendCommandAsync(const CLASS &protodata, const uint16_t &type) {
+            const uint16_t header = type;
+            // also caches the size for SerializeWithCachedSizesToArray()
+            const size_t payloadSize = protodata.ByteSizeLong();
+            auto writePayload = [&protodata](char* target) {
+                protodata.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(target));
+            };
+            MessageView headerView(reinterpret_cast<const char*>(&header), sizeof(uint16_t));
+            if (asyncRequests.load() && !isControlLaneType(type) && !isStreamedType(type)) {
+                return sendRequestAsync(headerView, payloadSize, writePayload);
+            }
+            std::promise<std::string> reply;
+            reply.set_value(sendRequest(headerView, payloadSize, writePayload));
+            return reply.get_future();
         }
+
         /**
          * @brief Set the allowed maximum latency for receiving heartbeat reply messages after sending a heartbeat
          * the default is set in the constructor
@@ -47,6 +133,14 @@ class RobotController: public UpdateThread {
             maxLatency = value;
         }
 
+        /**
+         * @brief Set the maximum size of a message received in TELEMETRY_CHUNKs, larger messages are dropped.
+         * The reassembly buffer of a type is allocated in the size the robot claims in the first chunk.
+         */
+        void setMaxChunkedMessageSize(const size_t &bytes) {
+            maxChunkedMessageSize = bytes;
+        }
+
         /**
          * @brief can be used to override the default printout when the connection timed out
          * 
@@ -68,12 +162,119 @@ class RobotController: public UpdateThread {
         /**
          * @brief Get the Heart Breat Round Trip Time
          * 
-         * @return float time in seconds needed to send/receive the last heartbeat (if used)
+         * @return float smoothed time in seconds needed to send a request and receive its reply, measured on all requests
+         * (heartbeats and commands)
          */
         float getHeartBreatRoundTripTime() {
             return heartBreatRoundTripTime.load();
         }
 
+        /**
+         * @brief Get the statistics of the received telemetry (rates, jitter, age percentiles) and of the request round trip times,
+         * recording is enabled by default if this library is compiled with RRC_STATISTICS and can be switched by ReceiveStatistics::setEnabled()
+         *
+         * @return ReceiveStatistics& can be queried from any thread
+         */
+        ReceiveStatistics& getReceiveStatistics() {
+            return receiveStatistics;
+        }
+
+        /**
+         * @brief Get the offset of the robot clock (ControlledRobot::getTime()) to the local clock, estimated from the
+         * heartbeat round trips like NTP (see ClockOffsetEstimator), so heartbeats have to be enabled by setHeartBeatDuration()
+         *
+         * @return double robot time - local time in seconds, 0 until a robot replied with its time
+         */
+        double getRobotClockOffset() {
+            return clockOffset.getOffsetNs(ClockOffsetEstimator::nowNs()) / 1000000000.0;
+        }
+
+        /**
+         * @brief Get the details of the clock offset estimation (drift, uncertainty)
+         */
+        ClockOffsetEstimator::Estimate getRobotClockEstimate() {
+            return clockOffset.getEstimate();
+        }
+
+        /**
+         * @brief convert a TimeStamp set by the robot (e.g. of a telemetry message) into local time
+         */
+        TimeStamp toLocalTime(const TimeStamp &robotTime);
+
+        /**
+         * @brief the age of a TimeStamp set by the robot, corrected by the clock offset
+         *
+         * @return double seconds
+         */
+        double getAge(const TimeStamp &robotTime);
+
+        /**
+         * @brief drop received messages of a type that are older than maxAgeSeconds (by their TimeStamp, corrected by
+         * getRobotClockOffset()) instead of buffering them, e.g. after a link outage.
+         * Until the robot clock offset is estimated, the TimeStamps are compared without correction.
+         *
+         * @param maxAgeSeconds 0 to keep all messages (default)
+         * @return false if the type is not registered or has no TimeStamp
+         */
+        bool setMaxTelemetryAge(const uint16_t &type, const float &maxAgeSeconds);
+
+        /**
+         * @brief the number of messages dropped because of setMaxTelemetryAge()
+         */
+        uint64_t getStaleTelemetryDropped(const uint16_t &type) {
+            if (type >= telemetryAdders.size() || !telemetryAdders[type]) {
+                return 0;
+            }
+            return telemetryAdders[type]->staleDropped.load();
+        }
+
+        /**
+         * @brief cache the static descriptions of the robot (requestRobotName(), requestControllableJoints(), ...),
+         * see DescriptionCache and refreshDescriptions()
+         * @warning has to be called before the update thread is started
+         *
+         * @param cache the cache, e.g. loaded from DescriptionCache::pathFor(), nullptr disables caching
+         */
+        void setDescriptionCache(const std::shared_ptr<DescriptionCache> &cache) {
+            descriptionCache = cache;
+        }
+
+        std::shared_ptr<DescriptionCache> getDescriptionCache() {
+            return descriptionCache;
+        }
+
+        /**
+         * @brief validate all cached descriptions with one request (e.g. after a reconnect), only the changed ones are transferred.
+         * Afterwards the requests of the cached types are answered from the cache until the connection is lost.
+         *
+         * @return int number of transferred (changed or not cached) descriptions, -1 without a cache or a reply
+         */
+        int refreshDescriptions();
+
+        /**
+         * @brief record the raw telemetry messages received by update() (before they are parsed), e.g. to replay
+         * them later with TelemetryReplay
+         *
+         * @param recorder an open recorder, nullptr stops recording
+         */
+        void setTelemetryRecorder(const std::shared_ptr<TelemetryRecorder> &recorder) {
+            std::atomic_store(&telemetryRecorder, recorder);
+        }
+
+        std::shared_ptr<TelemetryRecorder> getTelemetryRecorder() {
+            return std::atomic_load(&telemetryRecorder);
+        }
+
+        /**
+         * @brief parse a telemetry message as if it was received by update(), used by TelemetryReplay
+         *
+         * @param message the message as received (type header + payload)
+         * @return TelemetryMessageType the type of the message
+         */
+        TelemetryMessageType injectTelemetry(const MessageView &message) {
+            return evaluateTelemetry(message);
+        }
+
         /**
          * @brief Set the Target Pose of the ControlledRobot
          * 
@@ -102,6 +303,113 @@ class RobotController: public UpdateThread {
          */
         void setJointCommand(const JointCommand &jointsCommand);
 
+        /**
+         * @brief send JointState and JointCommand without joint names: both sides use the names of CONTROLLABLE_JOINTS
+         * (requested by this call) and the messages only contain the values in that order (or indices into it).
+         * When the robot changes its controllable joints, it sends names again and the table is negotiated again by update().
+         * The compact JointStates are sent to all controllers, the names are restored by each controller that received
+         * the CONTROLLABLE_JOINTS.
+         *
+         * @param enable true to enable
+         * @return true if the robot agreed
+         */
+        bool setCompactJoints(bool enable = true);
+
+        /**
+         * @brief select the versioned telemetry header (WireHeader) with per-type sequence numbers and send timestamps,
+         * the robot keeps sending the plain type header if it doesn't know the request (older versions).
+         * The header is used for all controllers of the telemetry connection, so they all need to support it.
+         *
+         * @param enable false to go back to the plain type header
+         * @return true if the robot agreed
+         */
+        bool setVersionedHeader(bool enable = true);
+
+        /**
+         * @brief resync the telemetry after a reconnect in one round trip (SESSION_RESUME): the last received sequence numbers
+         * are sent to the robot, which replies the latest value of each type that changed since (or that was not received).
+         * The values are added to the buffers like received telemetry. Without the versioned header (setVersionedHeader())
+         * there are no sequence numbers, so the latest values of all types are sent.
+         * When the robot restarted meanwhile (another session id), all types are sent and the versioned header is selected again.
+         *
+         * @return int number of received messages, -1 if the robot does not support it
+         */
+        int resumeSession();
+
+        /**
+         * @brief call resumeSession() in the update thread whenever the robot replies again after the connection was lost
+         * (also on the first connection)
+         */
+        void setSessionResumption(bool enable = true) {
+            sessionResumption.store(enable);
+        }
+
+        /**
+         * @brief the features of this controller, offered by negotiateCapabilities(): the protocol and wire header version,
+         * compact joints, telemetry chunks, session resumption, batched logs and the FixedLayout of Pose, Twist, IMU and Acceleration
+         * (little-endian builds only, no point cloud encodings, they are lossy)
+         */
+        static Capabilities defaultCapabilities();
+
+        /**
+         * @brief select the features both sides support in one round trip (CAPABILITIES) instead of one request each:
+         * the robot replies the selection and enables its part (header version, point cloud encoding, telemetry chunks),
+         * this controller enables compact joints (setCompactJoints()) and session resumption (setSessionResumption()) if selected.
+         * The first of the offered point cloud encodings the robot knows is used.
+         * Older robots do not know the request, then the features are negotiated one by one with the existing requests.
+         *
+         * @param offer the features to use if the robot supports them
+         * @return true if the robot replied the selection, false for the fallback
+         */
+        bool negotiateCapabilities(const Capabilities &offer = defaultCapabilities());
+
+        /**
+         * @brief the features selected by the last negotiateCapabilities(), protocol_version is 0 before or after the fallback
+         */
+        Capabilities getNegotiatedCapabilities() {
+            std::lock_guard<std::mutex> lock(capabilitiesMutex);
+            return negotiatedCapabilities;
+        }
+
+        /**
+         * @brief call negotiateCapabilities() in the update thread whenever the robot replies again after the connection was lost
+         * (also on the first connection), before a resumeSession()
+         */
+        void setCapabilityNegotiation(bool enable = true, const Capabilities &offer = defaultCapabilities()) {
+            {
+                std::lock_guard<std::mutex> lock(capabilitiesMutex);
+                capabilityOffer = offer;
+            }
+            capabilityNegotiation.store(enable);
+        }
+
+        /**
+         * @brief the version of the telemetry header agreed on by setVersionedHeader(), 0 for the plain type header
+         */
+        uint8_t getWireHeaderVersion() {
+            return wireHeaderVersion.load();
+        }
+
+        struct SequenceCounters {
+            SequenceCounters():received(0), gaps(0), reordered(0), dropped(0) {}
+            // messages with a sequence number
+            uint64_t received;
+            // messages missing in the sequence (late messages fill their gap again)
+            uint64_t gaps;
+            // messages received after a newer one of the same type
+            uint64_t reordered;
+            // reordered messages of latest-value types (setLatestValueTelemetry()), they are not buffered
+            uint64_t dropped;
+        };
+
+        /**
+         * @brief detected losses and reorders of telemetry with the versioned header (see setVersionedHeader())
+         *
+         * @param type the telemetry type, NO_TELEMETRY_DATA for the sum of all types
+         * @return SequenceCounters the counters
+         */
+        SequenceCounters getSequenceCounters(const uint16_t &type = NO_TELEMETRY_DATA);
+
         /**
          * @brief Set the SimpleActions command that the controlled robot should execute
          *
@@ -119,6 +427,25 @@ class RobotController: public UpdateThread {
 
         void setRobotTrajectoryCommand(const Poses &robotTrajectoryCommand);
 
+        /**
+         * @brief edit the trajectory of the last setRobotTrajectoryCommand() on the robot, only the changed waypoints are sent
+         *
+         * @param update replaces the waypoints from start_index (or the end if append is set) on, truncate removes the waypoints behind them
+         * @return true if the robot applied the update, false if there was no reply or start_index is behind the end of the trajectory
+         */
+        bool updateRobotTrajectory(const TrajectoryUpdate &update);
+
+        /**
+         * @brief append waypoints to the trajectory on the robot, see updateRobotTrajectory()
+         */
+        bool appendToRobotTrajectory(const std::vector<Pose> &poses);
+
+        /**
+         * @brief replace the waypoints from startIndex on and remove the ones behind them (e.g. after replanning the rest of the trajectory),
+         * see updateRobotTrajectory()
+         */
+        bool replaceRobotTrajectoryTail(const uint32_t &startIndex, const std::vector<Pose> &poses);
+
 
         /**
          * @brief Set the LogLevel of the controlled robot
@@ -127,6 +454,55 @@ class RobotController: public UpdateThread {
          */
         void setLogLevel(const uint16_t &level);
 
+        /**
+         * @brief Set the publication rate limits of telemetry types on the robot,
+         * messages above the limit are not sent, but are still available via requestTelemetry()
+         *
+         * @param limits the limits to set, types not in the list keep their current limit
+         * @return true if the robot accepted the limits
+         */
+        bool setTelemetryRateLimits(const TelemetryRateLimits &limits);
+
+        /**
+         * @brief Set the publication rate limit of a single telemetry type on the robot
+         *
+         * @param type the TelemetryMessageType to limit
+         * @param maxFrequency maximum number of messages sent per second, 0 for no limit
+         * @param decimation only send every n-th message, 0 or 1 to send all
+         * @return true if the robot accepted the limit
+         */
+        bool setTelemetryRateLimit(const uint16_t &type, const float &maxFrequency, const uint32_t &decimation = 0);
+
+        /**
+         * @brief only receive the given telemetry type (and all others subscribed), on transports that support
+         * filtering on the robot side (e.g. TransportZmq SUB), so unneeded types are not sent at all.
+         * Without subscriptions all types are received. TELEMETRY_BATCH is subscribed with the first type,
+         * unsubscribed types in batches are ignored.
+         * @warning must be called before the update thread is started (the transport is not thread safe)
+         *
+         * @param type the TelemetryMessageType to receive
+         * @return true if the transport supports filtering
+         */
+        bool subscribeTelemetry(const uint16_t &type);
+
+        /**
+         * @brief stop receiving a type subscribed with subscribeTelemetry()
+         * @warning must be called before the update thread is started (the transport is not thread safe)
+         *
+         * @param type the TelemetryMessageType
+         * @return true if the transport supports filtering
+         */
+        bool unsubscribeTelemetry(const uint16_t &type);
+
+        /**
+         * @brief subscribe all types registered with registerTelemetryType(), SIMPLE_SENSOR_VALUE and SIMPLE_SENSOR_VALUES
+         * (and LOG_MESSAGES with LOG_MESSAGE)
+         * @warning must be called before the update thread is started (the transport is not thread safe)
+         *
+         * @return true if the transport supports filtering
+         */
+        bool subscribeRegisteredTelemetry();
+
         /**
          * @brief Set the Permission object
          * 
@@ -169,6 +545,17 @@ class RobotController: public UpdateThread {
             return getTelemetry(CURRENT_ACCELERATION, telemetry);
         }
 
+        /**
+         * @brief Get the send-side statistics of the robot, if the robot publishes them (ControlledRobot::setStatisticsPublishInterval())
+         *
+         * @param telemetry the RobotStatistics object to write to
+         * @return true if new data was read
+         * @return false otherwise
+         */
+        bool getRobotStatistics(RobotStatistics *telemetry) {
+            return getTelemetry(ROBOT_STATISTICS, telemetry);
+        }
+
         /**
          * @brief Get an array of Poses
          * 
@@ -227,6 +614,40 @@ class RobotController: public UpdateThread {
             return result;
         }
 
+        /**
+         * @brief pop all buffered values of a simple sensor (oldest first), see setSimpleSensorBufferSize()
+         *
+         * @return size_t number of values appended to values
+         */
+        size_t getAllSimpleSensor(const uint16_t &id, std::vector<SimpleSensor> *values) {
+            auto lockedAccess = simplesensorbuffer->lockedAccess();
+            if (lockedAccess.get().size() <= id || !lockedAccess.get()[id].get()) {
+                return 0;
+            }
+            return std::static_pointer_cast< TypedRingBufferBase<SimpleSensor> >(lockedAccess.get()[id])->popAll(values);
+        }
+
+        /**
+         * @brief set the number of buffered values of a simple sensor (the default is one, the latest value),
+         * overrides the buffer_size of the SIMPLE_SENSOR_DEFINITION (which is limited to SimpleBuffer::maxSuggestedBufferSize).
+         * An existing buffer is resized and loses its values.
+         *
+         * @return false if the size is 0
+         */
+        bool setSimpleSensorBufferSize(const uint16_t &id, const size_t &size) {
+            return simplesensorbuffer->setBufferSize(id, size);
+        }
+
+        /**
+         * @brief set the number of buffered values of the simple sensors without a buffer size
+         * @warning only affects buffers created afterwards
+         *
+         * @return false if the size is 0
+         */
+        bool setDefaultSimpleSensorBufferSize(const size_t &size) {
+            return simplesensorbuffer->setDefaultBufferSize(size);
+        }
+
         bool getPermissionRequest(PermissionRequest* request) {
             return getTelemetry(PERMISSION_REQUEST, request);
         }
@@ -273,6 +694,38 @@ class RobotController: public UpdateThread {
             return getTelemetry(TRANSFORMS, transforms);
         }
 
+        /**
+         * @brief request the transforms that do not change (ControlledRobot::setStaticTransforms()),
+         * they are added to the transform tree if enabled
+         *
+         * @param transforms the static transforms
+         */
+        void requestStaticTransforms(Transforms *transforms) {
+            requestTelemetry(STATIC_TRANSFORMS, transforms);
+            std::shared_ptr<TransformTree> tree = transformTree;
+            if (tree) {
+                tree->add(*transforms, true);
+            }
+        }
+
+        /**
+         * @brief keep all received TRANSFORMS and STATIC_TRANSFORMS in a TransformTree, to look up the pose
+         * between any two connected frames at a time within the history (e.g. when the robot only sends changed
+         * transforms, ControlledRobot::setChangedTransforms()). The buffer of TRANSFORMS is still filled.
+         * @warning has to be called before the update thread is started, adds telemetry callbacks
+         *
+         * @param historySize number of transforms kept per pair of frames
+         * @return std::shared_ptr<TransformTree> the tree, the static transforms are requested right away if connected
+         */
+        std::shared_ptr<TransformTree> enableTransformTree(const size_t &historySize = 100);
+
+        /**
+         * @brief the tree of enableTransformTree(), nullptr if not enabled
+         */
+        std::shared_ptr<TransformTree> getTransformTree() {
+            return transformTree;
+        }
+
         /**
          * @brief Get the Point Cloud object
          * 
@@ -281,9 +734,66 @@ class RobotController: public UpdateThread {
          * @return false 
          */
         bool getPointCloud(PointCloud *pointcloud) {
-            return getTelemetry(POINTCLOUD, pointcloud);
+            if (getTelemetry(POINTCLOUD, pointcloud)) {
+                // quantized/octree clouds are returned as packed clouds
+                PointCloudCodec::decode(pointcloud);
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief get the next camera frame (of any camera, see ImageFrame::camera_id()),
+         * setLatestValueTelemetry(IMAGE_FRAME) keeps only the newest frame
+         *
+         * @param frame the frame, data() holds the encoded image (swapped out of the buffer, no copy)
+         * @return true if a frame was read
+         */
+        bool getImageFrame(ImageFrame *frame) {
+            return getTelemetry(IMAGE_FRAME, frame);
+        }
+
+        /**
+         * @brief set rate, decimation and resolution of camera streams, each stream keeps its config until it is set again
+         *
+         * @param configs the configs by camera_id
+         * @return true if the robot accepted the configs
+         */
+        bool setImageStreamConfigs(const ImageStreamConfigs &configs);
+
+        bool setImageStreamConfig(const ImageStreamConfig &config) {
+            ImageStreamConfigs configs;
+            *configs.add_streams() = config;
+            return setImageStreamConfigs(configs);
         }
 
+        /**
+         * @brief Set the encoding the robot uses for point clouds and point cloud maps.
+         * The lossy encodings reduce the size a lot, getPointCloud() and requestPointCloudMap() decode them.
+         *
+         * @param encoding the encoding and resolution
+         * @return true if the robot accepted the encoding
+         */
+        bool setPointCloudEncoding(const PointCloudEncoding &encoding);
+
+        /**
+         * @brief request a POINTCLOUD_MAP and decode it
+         *
+         * @param pointcloud the cloud to write the map to (packed if the robot uses an encoding)
+         * @param mapId the id of the map
+         * @return true if the map is a point cloud
+         */
+        bool requestPointCloudMap(PointCloud *pointcloud, const uint16_t &mapId = POINTCLOUD_MAP);
+
+        /**
+         * @brief request a GRID_MAP and decode its layers
+         *
+         * @param gridmap the decoded grid map
+         * @param mapId the id of the map
+         * @return true if the map was a GridMap
+         */
+        bool requestGridMap(GridMap *gridmap, const uint16_t &mapId = GRID_MAP);
+
 
         /**
          * @brief request the curretn state instead of waiting for the first telemetry message
@@ -336,6 +846,7 @@ class RobotController: public UpdateThread {
          */
         void requestSimpleSensors(SimpleSensors *sensors) {
             requestTelemetry(SIMPLE_SENSOR_DEFINITION, sensors);
+            initSimpleSensorBuffers(*sensors);
         }
 
         /**
@@ -369,10 +880,44 @@ class RobotController: public UpdateThread {
 
         void requestMap(Map *map, const uint16_t &mapId);
 
+        /**
+         * @brief request the tiles of a tiled map changed since the last request with this cache and merge them into the cache
+         *
+         * @param cache the cache of the map, use MapTileCache::getGridMap() or getPointCloud() to get the merged map
+         * @param mapId the id of the map
+         * @return int number of updated tiles, -1 on error
+         */
+        int requestMapTiles(MapTileCache *cache, const uint32_t &mapId);
+
         void requestMap(std::string *map, const uint16_t &mapId){
             requestBinary(mapId, map, MAP_REQUEST);
         }
 
+        /**
+         * @brief start a chunked map transfer: the map is sent in chunks on the telemetry channel, interleaved with
+         * the other telemetry, so other commands and the heartbeat are not blocked by large maps.
+         * Stalled transfers (no chunk for maxLatency) are resumed from the first missing chunk by update().
+         * When telemetry subscriptions are used, MAP_CHUNK is subscribed automatically.
+         *
+         * @param mapId the id of the map
+         * @param progressCallback called in the update thread for each new chunk with the received fraction (0..1)
+         * @param chunkSize bytes per chunk, 0 for the robots default (MapTransferSender::DEFAULT_CHUNK_SIZE)
+         * @param maxSize maximum size of the map in bytes, the buffer is allocated in the size the robot claims
+         * @return std::shared_ptr<MapTransfer> the transfer, use MapTransfer::waitForCompletion() and MapTransfer::getMap(),
+         * empty if the robot did not reply or the map is larger than maxSize. The transfer is dropped when the pointer is released.
+         */
+        std::shared_ptr<MapTransfer> startMapTransfer(const uint32_t &mapId,
+                                                      const std::function<void(const float &progress)> &progressCallback = nullptr,
+                                                      const uint32_t &chunkSize = 0,
+                                                      const uint64_t &maxSize = MapTransfer::DEFAULT_MAX_SIZE);
+
+        /**
+         * @brief request the missing chunks of a transfer (e.g. after a connection loss), also done automatically by update()
+         *
+         * @return true if the robot replied with a valid info
+         */
+        bool resumeMapTransfer(const std::shared_ptr<MapTransfer> &transfer);
+
         /**
          * @brief Get the Number of pending messages for a specific Telemetry type
          * 
@@ -380,8 +925,18 @@ class RobotController: public UpdateThread {
          * @return unsigned int number of messages in the buffer
          */
         unsigned int getBufferSize(const TelemetryMessageType &type) {
-            int size = buffers->lockedAccess().get()[type]->size();
-            return size;
+            return buffers->size(type);
+        }
+
+        /**
+         * @brief block until a message of a type is buffered, instead of polling the getters in a loop
+         *
+         * @param type a registered telemetry type
+         * @param timeoutMs maximum time to wait in milliseconds
+         * @return true if there is a message in the buffer (right away if there already was one), false on timeout
+         */
+        bool waitForTelemetry(const uint16_t &type, const unsigned int &timeoutMs) {
+            return telemetrySignal.waitFor([this, &type]() { return buffers->size(type) > 0; }, timeoutMs);
         }
 
         /**
@@ -390,23 +945,265 @@ class RobotController: public UpdateThread {
          * 
          * @tparam DATATYPE 
          * @param type 
-         * @param data 
+         * @param data the message is swapped into data (no copy), the old content of data is reused by the buffer
          * @return unsigned int 
          */
 
         template< class DATATYPE > unsigned int getTelemetry(const uint16_t &type, DATATYPE *data ) {
-            bool result = RingBufferAccess::popData(buffers->lockedAccess().get()[type], data);
-            return result;
+            // only one lock of the buffer of this type, no dynamic cast
+            return buffers->getHandle<DATATYPE>(type).popData(data);
+        }
+
+        /**
+         * @brief Get the next TelemetryMessage as a new object owned by the caller (swapped out of the buffer, no copy)
+         *
+         * @return std::unique_ptr<DATATYPE> empty if there was no new message
+         */
+        template< class DATATYPE > std::unique_ptr<DATATYPE> getTelemetry(const uint16_t &type) {
+            std::unique_ptr<DATATYPE> data(new DATATYPE());
+            if (!buffers->getHandle<DATATYPE>(type).popData(data.get())) {
+                data.reset();
+            }
+            return data;
+        }
+
+        /**
+         * @brief pop all buffered messages of a type (oldest first) with one lock of the buffer, e.g. to log every JointState
+         *
+         * @param data the messages are appended (moved out of the buffer)
+         * @return size_t number of messages
+         */
+        template< class DATATYPE > size_t getAllTelemetry(const uint16_t &type, std::vector<DATATYPE> *data) {
+            return buffers->getHandle<DATATYPE>(type).popAll(data);
+        }
+
+        /**
+         * @brief copy all buffered messages of a type (oldest first) without removing them, consistent with getBufferSize()
+         *
+         * @return false if the type is not registered or its buffer is lock-free (registerTelemetryType())
+         */
+        template< class DATATYPE > bool peekAllTelemetry(const uint16_t &type, std::vector<DATATYPE> *data) {
+            return buffers->getHandle<DATATYPE>(type).peekAll(data);
         }
 
         template< class DATATYPE > void requestTelemetry(const uint16_t &type, DATATYPE *result, const uint16_t &requestType = TELEMETRY_REQUEST) {
             std::string replybuf;
+            const bool cached = requestType == TELEMETRY_REQUEST && descriptionCache && descriptionCache->isCached(type);
+            if (cached && descriptionCache->get(type, &replybuf)) {
+                // validated since the connection was established
+                result->ParseFromString(replybuf);
+                return;
+            }
             requestBinary(type, &replybuf, requestType);
+            if (cached && connected.load()) {
+                descriptionCache->set(type, replybuf);
+            }
             result->ParseFromString(replybuf);
         }
 
+        /**
+         * @brief getTelemetry() with the protobuf type resolved at compile time (TelemetryTraits), e.g. getTelemetry<CURRENT_POSE>(&pose)
+         */
+        template< uint16_t TYPE > unsigned int getTelemetry(typename TelemetryTraits<TYPE>::type *data) {
+            return buffers->getHandle<typename TelemetryTraits<TYPE>::type>(TYPE).popData(data);
+        }
+
+        template< uint16_t TYPE > std::unique_ptr<typename TelemetryTraits<TYPE>::type> getTelemetry() {
+            return getTelemetry<typename TelemetryTraits<TYPE>::type>(TYPE);
+        }
+
+        template< uint16_t TYPE > size_t getAllTelemetry(std::vector<typename TelemetryTraits<TYPE>::type> *data) {
+            return getAllTelemetry(TYPE, data);
+        }
+
+        template< uint16_t TYPE > bool peekAllTelemetry(std::vector<typename TelemetryTraits<TYPE>::type> *data) {
+            return peekAllTelemetry(TYPE, data);
+        }
+
+        template< uint16_t TYPE > void requestTelemetry(typename TelemetryTraits<TYPE>::type *result) {
+            requestTelemetry(TYPE, result);
+        }
+
+        /**
+         * @brief request the latest messages of several types in one round trip (TELEMETRY_BULK_REQUEST), e.g. a complete
+         * snapshot of the robot state instead of one requestTelemetry() per type.
+         * The received messages of registered types are added to their buffers (and callbacks) like received telemetry.
+         *
+         * @param types the requested types
+         * @param payloads if set, receives the serialized messages by type
+         * @return int number of received messages (types the robot has no message of are left out), -1 if the reply is invalid
+         */
+        int requestTelemetrySnapshot(const std::vector<uint16_t> &types, std::map<uint16_t, std::string> *payloads = nullptr);
+
+        /**
+         * @brief requestTelemetrySnapshot() into objects of the types (TelemetryTraits),
+         * e.g. requestTelemetrySnapshot<CURRENT_POSE, JOINT_STATE>(&pose, &jointState).
+         * Objects of types without a message on the robot are not changed.
+         */
+        template< uint16_t... TYPES > int requestTelemetrySnapshot(typename TelemetryTraits<TYPES>::type*... results) {
+            std::map<uint16_t, std::string> payloads;
+            int received = requestTelemetrySnapshot(std::vector<uint16_t>{TYPES...}, &payloads);
+            (void)std::initializer_list<int>{(parseSnapshotPayload(payloads, TYPES, results), 0)...};
+            return received;
+        }
+
+        /**
+         * @brief send the command of a ControlMessageType with its protobuf type (ControlTraits), e.g. sendCommand<TWIST_COMMAND>(twist)
+         *
+         * @return std::string the reply of the robot
+         */
+        template< uint16_t TYPE > std::string sendCommand(const typename ControlTraits<TYPE>::type &command) {
+            return sendProtobufData(command, TYPE);
+        }
+
+        /**
+         * @brief store the received messages of a type serialized, they are only parsed when read (getTelemetry(), getLogMessage(), ...).
+         * Saves the parsing of types that are received often but rarely read. Types with callbacks are parsed
+         * on receive for the callbacks anyway.
+         * @warning has to be called before the update thread is started and before callbacks are added to this type,
+         * the buffer of the type is replaced (received messages and callbacks are dropped)
+         *
+         * @param type the telemetry type
+         * @param lazy true to parse on read, false to parse on receive (default)
+         * @return false if the type is not registered or needs to be decoded on receive (JOINT_STATE, CONTROLLABLE_JOINTS)
+         */
+        bool setLazyTelemetry(const uint16_t &type, bool lazy = true) {
+            if (type >= telemetryRegistrations.size() || !telemetryRegistrations[type]) {
+                return false;
+            }
+            if (buffers->isLazy(type) == lazy) {
+                return true;
+            }
+            return telemetryRegistrations[type](lazy);
+        }
+
+        /**
+         * @brief add a callback called for each received message of the type
+         * @warning without a CallbackExecutor the callback is called in the update thread while the buffer of the type is locked:
+         * it delays all following messages and must not read the same type (e.g. with getTelemetry())
+         */
+        template< uint16_t TYPE > void addTelemetryReceivedCallback(const std::function<void(const typename TelemetryTraits<TYPE>::type & data)> &function) {
+            addTelemetryReceivedCallback<typename TelemetryTraits<TYPE>::type>(TYPE, function);
+        }
+
         template< class DATATYPE > void addTelemetryReceivedCallback(const uint16_t &type, const std::function<void(const DATATYPE & data)> &function) {
-            RingBufferAccess::addDataReceivedCallback<DATATYPE>(buffers->lockedAccess().get()[type], function);
+            if (!callbackExecutor) {
+                buffers->getHandle<DATATYPE>(type).addDataReceivedCallback([function, type](const DATATYPE & data) {
+                    RRC_TRACE(CALLBACK_DISPATCH, type, 0);
+                    function(data);
+                });
+                return;
+            }
+            std::shared_ptr<CallbackExecutor> executor = callbackExecutor;
+            std::shared_ptr< std::function<void(const DATATYPE & data)> > callback = std::make_shared< std::function<void(const DATATYPE & data)> >(function);
+            buffers->getHandle<DATATYPE>(type).addDataReceivedCallback([executor, callback, type](const DATATYPE & data) {
+                // copied, the buffer slot is reused
+                std::shared_ptr<const DATATYPE> message = std::make_shared<DATATYPE>(data);
+                executor->post(type, [callback, message, type]() {
+                    RRC_TRACE(CALLBACK_DISPATCH, type, 0);
+                    (*callback)(*message);
+                }, callback.get());
+            });
+        }
+
+        /**
+         * @brief keep only the newest message of a type in the receive buffer (e.g. CURRENT_POSE), so the getters
+         * never return stale data when the messages are read slower than received.
+         * See also TransportZmq::addLatestValueType() to conflate the type on the transport and TransportUDT::addLatestValueType()
+         * to send it unreliably. With the versioned header (setVersionedHeader()), a message older than the last received one
+         * of the type is dropped (see SequenceCounters::dropped).
+         * @warning has to be called before the update thread is started when the buffer of the type is lock-free
+         *
+         * @return false if the type is not registered
+         */
+        bool setLatestValueTelemetry(const uint16_t &type) {
+            if (type >= telemetryAdders.size() || !telemetryAdders[type] || !buffers->resize(type, 1)) {
+                return false;
+            }
+            telemetryAdders[type]->overwrite.store(true);
+            return true;
+        }
+
+        /**
+         * @brief limit the memory of the receive buffer of a type (e.g. POINTCLOUD, MAP), besides the number of messages of
+         * the buffersize, the oldest messages are dropped when it is exceeded (the newest one is kept).
+         * The memory is the ByteSizeLong() of the messages, reported in ReceiveStatistics::TypeStats::bufferedBytes.
+         *
+         * @param maxBytes the limit, 0 to only report the memory
+         * @return false if the type is not registered or its buffer is lock-free
+         */
+        bool setTelemetryByteCapacity(const uint16_t &type, const size_t &maxBytes) {
+            return buffers->setByteCapacity(type, maxBytes);
+        }
+
+        /**
+         * @brief limit the memory of all receive buffers, when it is exceeded the oldest messages of the types using the
+         * most memory are dropped, the newest message of each type is kept. Lock-free buffers are not counted.
+         * The memory per type is reported in ReceiveStatistics::TypeStats::bufferedBytes.
+         *
+         * @param maxBytes the budget, 0 for no budget (the memory is still counted)
+         */
+        void setTelemetryMemoryBudget(const size_t &maxBytes) {
+            buffers->setMemoryBudget(maxBytes);
+        }
+
+        /**
+         * @brief the memory of all counted receive buffers (setTelemetryByteCapacity(), setTelemetryMemoryBudget())
+         */
+        size_t getBufferedTelemetryBytes() const {
+            return buffers->getBufferedBytes();
+        }
+
+        /**
+         * @brief set the executor calling the callbacks added after this call (addTelemetryReceivedCallback()),
+         * so slow callbacks do not block the update thread and the buffers.
+         * The callback policy (e.g. CallbackExecutor::LATEST_ONLY) is set on the executor per telemetry type.
+         *
+         * @param executor the executor, nullptr to call new callbacks in the update thread (default)
+         */
+        void setCallbackExecutor(const std::shared_ptr<CallbackExecutor> &executor) {
+            callbackExecutor = executor;
+        }
+
+        /**
+         * @brief parse the messages of heavy types (e.g. POINTCLOUD, MAP) on worker threads instead of the update thread,
+         * so small messages received after a large one (e.g. CURRENT_POSE) are buffered without waiting for its parsing.
+         * The messages of each type are still parsed and buffered in the order they were received.
+         * The callbacks of these types are called in the worker thread (unless a callback executor is set),
+         * and the message is buffered shortly after the update returned (waitForTelemetry() waits for it).
+         * Lazy types (setLazyTelemetry()) are copied in the update thread anyway.
+         * @warning has to be called before the update thread is started
+         *
+         * @param types the types to parse on the worker threads, empty to parse all types in the update thread again
+         * @param threads number of worker threads, types are parsed in parallel with more than one
+         * @param maxQueued received messages waiting to be parsed, the oldest one is dropped when full
+         */
+        void setOffThreadParsing(const std::vector<uint16_t> &types, const size_t &threads = 1, const size_t &maxQueued = 100);
+
+        /**
+         * @brief publish the received telemetry into a shared memory store (SharedTelemetryStore::OWNER),
+         * so other processes on this host read it from there instead of running their own RobotController.
+         * Only the types of the store are published, each one after it was buffered.
+         * @warning has to be called before the update thread is started
+         *
+         * @param store the store, nullptr to stop publishing
+         */
+        void setTelemetryStore(const std::shared_ptr<SharedTelemetryStore> &store) {
+            telemetryStore = store;
+            for (const std::shared_ptr<TelemetryAdderBase> &adder : telemetryAdders) {
+                if (adder) {
+                    adder->store = store;
+                }
+            }
+        }
+
+        /**
+         * @brief wait until the messages received so far are parsed (setOffThreadParsing())
+         *
+         * @return true if all were parsed within the timeout, or true when nothing is parsed off thread
+         */
+        bool waitForParsing(const float &timeoutSeconds = 1.0) {
+            return !parseExecutor || parseExecutor->waitUntilIdle(timeoutSeconds);
         }
 
         void requestBinary(const uint16_t &type, std::string *result, const uint16_t &requestType = TELEMETRY_REQUEST) {
@@ -427,67 +1224,509 @@ class RobotController: public UpdateThread {
 
         virtual std::string sendRequest(const std::string& serializedMessage, const robot_remote_control::Transport::Flags &flags = robot_remote_control::Transport::NOBLOCK);
 
-        TelemetryMessageType evaluateTelemetry(const std::string& reply);
+        /**
+         * @brief send a request from a header and a payload which is serialized directly into the send buffer of the transport
+         *
+         * @param header the header of the request (the command type)
+         * @param payloadSize size of the serialized payload
+         * @param writePayload function serializing exactly payloadSize bytes into the target
+         * @return std::string the reply
+         */
+        virtual std::string sendRequest(const MessageView &header, const size_t &payloadSize, const robot_remote_control::Transport::PayloadWriter &writePayload,
+                                        const robot_remote_control::Transport::Flags &flags = robot_remote_control::Transport::NOBLOCK);
+
+        /**
+         * @brief send a request and wait for the reply on one lane (command or control transport)
+         */
+        std::string sendRequestOn(const TransportSharedPtr &transport, std::mutex *transportMutex, const MessageView &header, const size_t &payloadSize,
+                                  const robot_remote_control::Transport::PayloadWriter &writePayload, const robot_remote_control::Transport::Flags &flags);
+
+        /**
+         * @brief send a request with a request id, the reply is matched by the id, so it can be one of many pending requests
+         *
+         * @return std::future<std::string> the reply, empty if no reply was received within maxLatency
+         */
+        std::future<std::string> sendRequestAsync(const MessageView &header, const size_t &payloadSize, const robot_remote_control::Transport::PayloadWriter &writePayload,
+                                                  const robot_remote_control::Transport::Flags &flags = robot_remote_control::Transport::NOBLOCK);
+
+        /**
+         * @brief receive replies of requests sent by sendRequestAsync() and set the values of their futures,
+         * requests without reply within maxLatency are set to an empty reply
+         *
+         * @param timeoutMs time to wait for replies
+         */
+        void receiveReplies(const unsigned int &timeoutMs);
+
+        struct PendingRequest {
+            std::promise<std::string> reply;
+            Timer timeout;
+            uint16_t type;
+        };
+        std::map<uint32_t, PendingRequest> pendingRequests;
+        std::mutex pendingRequestsMutex;
+        std::atomic<uint32_t> nextRequestId;
+        std::atomic<bool> asyncRequests;
+        // only used with commandTransportMutex locked
+        ReceiveBuffer replyReceiveBuffer;
+
+        /**
+         * @brief parse a telemetry message (type header + payload) into the buffers
+         *
+         * @param reply view on the message, parsing is done directly from this memory
+         * @return TelemetryMessageType the type of the message
+         */
+        TelemetryMessageType evaluateTelemetry(const MessageView& reply);
+
+        // see setVersionedHeader()
+        std::atomic<uint8_t> wireHeaderVersion;
+        struct TelemetrySequence {
+            TelemetrySequence():started(false), expected(0), lastReceived(0), received(0), gaps(0), reordered(0), dropped(0) {}
+            // only used by the receiving thread
+            bool started;
+            uint32_t expected;
+            // the newest sequence number + 1, 0 if none, read by resumeSession()
+            std::atomic<uint32_t> lastReceived;
+            std::atomic<uint64_t> received;
+            std::atomic<uint64_t> gaps;
+            std::atomic<uint64_t> reordered;
+            std::atomic<uint64_t> dropped;
+        };
+        std::array<TelemetrySequence, TELEMETRY_MESSAGE_TYPES_NUMBER> telemetrySequences;
+        // older sequence numbers are from a restarted robot
+        static const int32_t sequenceRestartWindow = 1000;
+        // see resumeSession(), 0 until the first resume
+        std::atomic<uint64_t> robotSessionId;
+        std::atomic<bool> sessionResumption;
+        // the connection was lost and is back
+        std::atomic<bool> resumePending;
+
+        // see setCapabilityNegotiation()
+        std::atomic<bool> capabilityNegotiation;
+        std::atomic<bool> negotiationPending;
+        std::mutex capabilitiesMutex;
+        Capabilities capabilityOffer;
+        Capabilities negotiatedCapabilities;
+        // negotiates the offered features one by one with an older robot
+        void negotiateFeatures(const Capabilities &offer);
+
+        // false if a newer message of the type was received already
+        bool countSequence(const WireHeader &header);
+
+        /**
+         * @brief put the payload of a telemetry message into the buffer of its type
+         *
+         * @param msgtype the type from the header
+         * @param serializedMessage the payload
+         * @return TelemetryMessageType the type of the message
+         */
+        TelemetryMessageType evaluateTelemetryPayload(const TelemetryMessageType &msgtype, const MessageView& serializedMessage);
+
+        /**
+         * @brief put a message with WireHeader::FIXED_LAYOUT into the buffer of its type, converted from the FixedLayout struct
+         */
+        TelemetryMessageType evaluateFixedLayout(const TelemetryMessageType &msgtype, const MessageView& message);
+
+        /**
+         * @brief unpack a TELEMETRY_BATCH message and evaluate the contained messages
+         */
+        void evaluateTelemetryBatch(const MessageView& batch);
+
+        /**
+         * @brief add a TELEMETRY_CHUNK to the message of its type, the message is evaluated when it is complete
+         */
+        void evaluateTelemetryChunk(const MessageView& chunk);
+
+        struct ChunkedMessage {
+            ChunkedMessage():messageId(0), received(0) {}
+            uint32_t messageId;
+            size_t received;
+            std::string data;
+        };
+        // by type, the chunks of a message arrive in order, a message with a lost chunk is dropped
+        std::map<uint16_t, ChunkedMessage> chunkedMessages;
+        std::atomic<size_t> maxChunkedMessageSize;
+        static const size_t defaultMaxChunkedMessageSize = 256 * 1024 * 1024;
+
+        /**
+         * @brief call item for each message of a TELEMETRY_BATCH payload
+         *
+         * @return false if the batch ends with an incomplete message
+         */
+        static bool parseTelemetryBatch(const MessageView& batch, const std::function<void(const TelemetryMessageType &type, const MessageView &payload)> &item);
+
+        template< class DATATYPE > static void parseSnapshotPayload(const std::map<uint16_t, std::string> &payloads, const uint16_t &type, DATATYPE *result) {
+            auto payload = payloads.find(type);
+            if (payload != payloads.end()) {
+                result->ParseFromString(payload->second);
+            }
+        }
+
+        /**
+         * @brief add a MAP_CHUNK to its transfer
+         */
+        void evaluateMapChunk(const MessageView& serializedMessage);
+
+        /**
+         * @brief resume the transfers that did not receive a chunk for maxLatency
+         */
+        void resumeStalledMapTransfers();
+
+        /**
+         * @brief decoder of JOINT_STATE, restores the names of compact messages
+         */
+        void expandJointNames(JointState *jointState);
+
+        /**
+         * @brief decoder of CONTROLLABLE_JOINTS, updates the name table
+         */
+        void updateJointNameTable(JointState *controllableJoints);
+
+        LockableClass<JointNameTable> jointNameTable;
+        // table agreed on with the robot, 0 if names are sent
+        std::atomic<uint64_t> compactJointTable;
+        // the robot changed its table, set by the update thread
+        std::atomic<bool> renegotiateJointTable;
+
+        std::mutex mapTransferMutex;
+        std::map<uint32_t, std::weak_ptr<MapTransfer> > mapTransfers;
+        std::atomic<uint32_t> nextMapTransferId;
+
+        /**
+         * @brief true if no subscriptions are set or type is subscribed
+         */
+        bool isTelemetrySubscribed(const uint16_t &type);
+
+        // (un)subscribe the topics of both telemetry headers, needs the telemetrySubscriptionMutex locked
+        bool subscribeTopics(const uint16_t &type, const bool &subscribe);
+
+        std::mutex telemetrySubscriptionMutex;
+        std::set<uint16_t> telemetrySubscriptions;
+        // only lock the mutex if subscriptions are set
+        std::atomic<bool> telemetryFiltered;
+
+        // reused for each telemetry receive, so the transport can hand out its own memory
+        ReceiveBuffer telemetryReceiveBuffer;
+        // see setDescriptionCache()
+        std::shared_ptr<DescriptionCache> descriptionCache;
+        // see enableTransformTree()
+        std::shared_ptr<TransformTree> transformTree;
+
+        // the connection is lost, no reply in time
+        void connectionLost(const float &time);
+
+        // see setTelemetryRecorder(), accessed with std::atomic_load/store
+        std::shared_ptr<TelemetryRecorder> telemetryRecorder;
 
         TransportSharedPtr commandTransport;
         TransportSharedPtr telemetryTransport;
 
-        float heartBeatDuration;
-        Timer heartBeatTimer;
+        std::atomic<float> heartBeatDuration;
+        // restarted by every completed request, an explicit heartbeat is sent when it expires
+        LockableClass<Timer> heartBeatTimer;
+        // the robot knows the heartbeat duration only from explicit heartbeats
+        std::atomic<bool> heartbeatAnnounced;
+        Timer explicitHeartbeatTimer;
+        static const int heartbeatRefreshFactor = 10;
         std::atomic<float> heartBreatRoundTripTime;
-        Timer latencyTimer;
-        Timer requestTimer;
-        Timer lastConnectedTimer;
+        /**
+         * @brief a request got its reply: the robot is connected and the link is not idle
+         *
+         * @param type the ControlMessageType of the request
+         * @param roundTripTime time from sending the request to receiving the reply
+         */
+        void requestCompleted(const uint16_t &type, const float &roundTripTime);
+
+        ReceiveStatistics receiveStatistics;
+        // heartbeat waiting for its reply when using async requests
+        std::future<std::string> pendingHeartbeat;
+        int64_t pendingHeartbeatSentNs;
+        // counted by update(), reported in the heartbeats
+        uint64_t receivedTelemetryBytes;
+        uint64_t heartbeatReceivedBytes;
+        ClockOffsetEstimator clockOffset;
+        /**
+         * @brief add the robot times of a heartbeat reply to the clock offset estimation
+         *
+         * @param reply [HEARTBEAT][robot receive time][robot reply time] (or only the type from older robots)
+         * @param sentNs local time the heartbeat was sent
+         * @param receivedNs local time the reply was received
+         */
+        void addClockSample(const std::string &reply, const int64_t &sentNs, const int64_t &receivedNs);
+        // age of a robot TimeStamp (ReceiveStatistics::readTimestamp()) in local time
+        int64_t localAgeUs(const int64_t &robotUsSinceEpoch) {
+            return (ClockOffsetEstimator::nowNs() - clockOffset.toLocalNs(robotUsSinceEpoch * 1000)) / 1000;
+        }
+        LockableClass<Timer> lastConnectedTimer;
         std::mutex commandTransportMutex;
+        // optional lane for real-time commands, see setControlTransport()
+        TransportSharedPtr controlTransport;
+        std::mutex controlTransportMutex;
+        std::vector<bool> controlLaneTypes;
+        bool isControlLaneType(const uint16_t &type) {
+            return controlTransport.get() && type < controlLaneTypes.size() && controlLaneTypes[type];
+        }
+        // optional stream for commands without acknowledgement, see setCommandStreamTransport()
+        TransportSharedPtr commandStreamTransport;
+        std::mutex commandStreamMutex;
+        std::vector<bool> streamedTypes;
+        // the sequence number of the last streamed command per type
+        std::vector<uint32_t> streamSequences;
+        // random, the robot keeps the sequence numbers per stream
+        uint32_t streamId;
+        bool isStreamedType(const uint16_t &type) {
+            return commandStreamTransport.get() && type < streamedTypes.size() && streamedTypes[type];
+        }
+        std::string sendStreamed(const MessageView &header, const size_t &payloadSize, const robot_remote_control::Transport::PayloadWriter &writePayload);
         float maxLatency;
 
         std::shared_ptr<TelemetryBuffer>  buffers;
         std::shared_ptr<SimpleBuffer <SimpleSensor> >  simplesensorbuffer;
+        // notified for each message added to the buffers, see waitForTelemetry()
+        DataSignal telemetrySignal;
         // void initBuffers(const unsigned int &defaultSize);
 
         std::function<void(const float&)> lostConnectionCallback;
+        std::shared_ptr<CallbackExecutor> callbackExecutor;
+        // setOffThreadParsing(), the types are indexed by type
+        std::unique_ptr<CallbackExecutor> parseExecutor;
+        std::vector<bool> offThreadTypes;
+        // setTelemetryStore(), also set on the adders
+        std::shared_ptr<SharedTelemetryStore> telemetryStore;
         std::atomic<bool> connected;
 
         template< class CLASS > std::string sendProtobufData(const CLASS &protodata, const uint16_t &type, const robot_remote_control::Transport::Flags &flags = robot_remote_control::Transport::NOBLOCK ) {
-            std::string buf;
-            buf.resize(sizeof(uint16_t));
-            uint16_t* data = reinterpret_cast<uint16_t*>(const_cast<char*>(buf.data()));
-            *data = type;
-            protodata.AppendToString(&buf);
-            return sendRequest(buf, flags);
+            const uint16_t header = type;
+            // also caches the size for SerializeWithCachedSizesToArray()
+            const size_t payloadSize = protodata.ByteSizeLong();
+            return sendRequest(MessageView(reinterpret_cast<const char*>(&header), sizeof(uint16_t)), payloadSize,
+                [&protodata](char* target) {
+                    protodata.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(target));
+                }, flags);
         }
 
 
         class TelemetryAdderBase{
          public:
-            explicit TelemetryAdderBase(std::shared_ptr<TelemetryBuffer> buffers) : buffers(buffers) {}
+            explicit TelemetryAdderBase(std::shared_ptr<TelemetryBuffer> buffers) : overwrite(false), timestampField(0), maxAgeUs(0),
+                                                                                    staleDropped(0), buffers(buffers) {}
             virtual ~TelemetryAdderBase() {}
-            virtual void addToTelemetryBuffer(const uint16_t &type, const std::string &serializedMessage) = 0;
+            virtual void addToTelemetryBuffer(const uint16_t &type, const MessageView &serializedMessage) = 0;
+            // parses before locking the buffer, used off the update thread, so parsing does not block reading the buffer
+            virtual void parseAndAdd(const uint16_t &type, const std::string &serializedMessage) {
+                addToTelemetryBuffer(type, serializedMessage);
+            }
+            /**
+             * @brief add a FixedLayout struct (WireHeader::FIXED_LAYOUT)
+             *
+             * @return false if the type has no fixed layout or the size does not match
+             */
+            virtual bool addFixedLayout(const uint16_t &/*type*/, const MessageView &/*message*/) {
+                return false;
+            }
+            // the time stamp of a FixedLayout struct in nanoseconds, false if it has none
+            virtual bool fixedLayoutTimestamp(const MessageView &/*message*/, int64_t */*timestampNs*/) {
+                return false;
+            }
+            // replace the oldest message if the buffer is full, instead of dropping the new one
+            std::atomic<bool> overwrite;
+            // field number of the TimeStamp for the receive statistics, 0 if the type has none
+            int timestampField;
+            // setTelemetryStore(), nullptr if the messages are not published
+            std::shared_ptr<SharedTelemetryStore> store;
+            // setMaxTelemetryAge(), 0 to keep all messages
+            std::atomic<int64_t> maxAgeUs;
+            std::atomic<uint64_t> staleDropped;
          protected:
+            // keeps the buffers (and the handles into them) valid
             std::shared_ptr<TelemetryBuffer>  buffers;
         };
         template <class CLASS> class TelemetryAdder : public TelemetryAdderBase {
          public:
-            explicit TelemetryAdder(std::shared_ptr<TelemetryBuffer> buffers) : TelemetryAdderBase(buffers) {}
-            virtual void addToTelemetryBuffer(const uint16_t &type, const std::string &serializedMessage) {
-                CLASS data;
-                data.ParseFromString(serializedMessage);
-                RingBufferAccess::pushData(buffers->lockedAccess().get()[type], data);
+            TelemetryAdder(std::shared_ptr<TelemetryBuffer> buffers, const TelemetryBuffer::Handle<CLASS> &handle,
+                           const std::function<void(CLASS *data)> &decode = nullptr) : TelemetryAdderBase(buffers), handle(handle), decode(decode) {
+                const google::protobuf::FieldDescriptor* field = CLASS::descriptor()->FindFieldByName("timestamp");
+                if (field && field->message_type() == TimeStamp::descriptor()) {
+                    timestampField = field->number();
+                }
+            }
+            virtual void addToTelemetryBuffer(const uint16_t &type, const MessageView &serializedMessage) {
+                traceDrop(type);
+                if (!decode) {
+                    // parsed into the slot or only copied if the type is lazy
+                    handle.pushSerialized(serializedMessage.data, serializedMessage.size, overwrite.load());
+                    if (store) {
+                        // also when the own buffer is full, the readers do not depend on this process popping it
+                        store->publish(type, serializedMessage);
+                    }
+                } else {
+                    bool filled = false;
+                    handle.pushInPlace([&](CLASS *slot) {
+                        filled = true;
+                        if (!slot->ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                            return false;
+                        }
+                        decode(slot);
+                        if (store) {
+                            // decoded, so the readers do not need the decoding state of this controller
+                            store->publish(type, *slot);
+                        }
+                        return true;
+                    }, overwrite.load());
+                    if (store && !filled) {
+                        // the own buffer is full
+                        CLASS message;
+                        if (message.ParseFromArray(serializedMessage.data, serializedMessage.size)) {
+                            decode(&message);
+                            store->publish(type, message);
+                        }
+                    }
+                }
+                buffers->enforceMemoryBudget();
+            }
+            virtual void parseAndAdd(const uint16_t &type, const std::string &serializedMessage) {
+                CLASS message;
+                if (!message.ParseFromString(serializedMessage)) {
+                    return;
+                }
+                if (decode) {
+                    decode(&message);
+                }
+                if (store) {
+                    if (decode) {
+                        store->publish(type, message);
+                    } else {
+                        store->publish(type, MessageView(serializedMessage));
+                    }
+                }
+                traceDrop(type);
+                handle.pushData(std::move(message), overwrite.load());
+                buffers->enforceMemoryBudget();
+            }
+            virtual bool addFixedLayout(const uint16_t &type, const MessageView &message) {
+                return addFixedLayout(type, message, std::integral_constant<bool, FixedLayout::Codec<CLASS>::supported>());
+            }
+            virtual bool fixedLayoutTimestamp(const MessageView &message, int64_t *timestampNs) {
+                return fixedLayoutTimestamp(message, timestampNs, std::integral_constant<bool, FixedLayout::Codec<CLASS>::supported>());
+            }
+         private:
+            bool addFixedLayout(const uint16_t &type, const MessageView &message, std::true_type /*supported*/) {
+                // preallocated on the stack, read with one memcpy
+                typename FixedLayout::Codec<CLASS>::Layout layout;
+                if (!FixedLayout::read(message.data, message.size, &layout)) {
+                    return false;
+                }
+                traceDrop(type);
+                bool filled = false;
+                handle.pushInPlace([&](CLASS *slot) {
+                    filled = true;
+                    FixedLayout::Codec<CLASS>::decode(layout, slot);
+                    if (decode) {
+                        decode(slot);
+                    }
+                    if (store) {
+                        store->publish(type, *slot);
+                    }
+                    return true;
+                }, overwrite.load());
+                if (store && !filled) {
+                    // the own buffer is full, the readers do not depend on this process popping it
+                    CLASS decoded;
+                    FixedLayout::Codec<CLASS>::decode(layout, &decoded);
+                    if (decode) {
+                        decode(&decoded);
+                    }
+                    store->publish(type, decoded);
+                }
+                buffers->enforceMemoryBudget();
+                return true;
+            }
+            bool addFixedLayout(const uint16_t &/*type*/, const MessageView &/*message*/, std::false_type /*supported*/) {
+                return false;
+            }
+            bool fixedLayoutTimestamp(const MessageView &message, int64_t *timestampNs, std::true_type /*supported*/) {
+                typename FixedLayout::Codec<CLASS>::Layout layout;
+                return FixedLayout::read(message.data, message.size, &layout) && FixedLayout::Codec<CLASS>::timestampNs(layout, timestampNs);
+            }
+            bool fixedLayoutTimestamp(const MessageView &/*message*/, int64_t */*timestampNs*/, std::false_type /*supported*/) {
+                return false;
+            }
+            void traceDrop(const uint16_t &type) {
+                #ifndef RRC_DISABLE_TRACING
+                    // only checked with a hook, the size is locked for buffers with a mutex
+                    if (Tracing::enabled() && handle.size() >= handle.capacity()) {
+                        RRC_TRACE(BUFFER_DROP, type, handle.capacity());
+                    }
+                #endif
             }
+            TelemetryBuffer::Handle<CLASS> handle;
+            std::function<void(CLASS *data)> decode;
         };
 
         std::vector< std::shared_ptr<TelemetryAdderBase> > telemetryAdders;
 
-        void addToSimpleSensorBuffer(const std::string &serializedMessage);
+        // LOG_MESSAGES into the buffer of LOG_MESSAGE, entry by entry
+        void evaluateLogMessages(const MessageView &serializedMessage);
 
-        template <class PROTO> void registerTelemetryType(const uint16_t &type, const size_t &buffersize = 10) {
-            buffers->registerType<PROTO>(type, buffersize);
+        void addToSimpleSensorBuffer(const MessageView &serializedMessage);
+        // SIMPLE_SENSOR_VALUES into the buffers of the SimpleSensor ids
+        void addSimpleSensorsToBuffer(const MessageView &serializedMessage);
+        // creates the buffers of the defined sensors, so receiving does not resize the buffers
+        void initSimpleSensorBuffers(const SimpleSensors &definition);
+        // reused, SIMPLE_SENSOR_VALUES are parsed in the update thread only
+        SimpleSensors receivedSimpleSensors;
+
+        /**
+         * @brief register a telemetry type to be received
+         * @warning has to be called before the update thread is started (e.g. in the constructor)
+         *
+         * @param type the type
+         * @param buffersize size of the receive buffer
+         * @param lockfree use a lock-free buffer, the buffer is filled by the update thread, so popping/peeking it is only allowed from one other thread
+         * @param decode called in the update thread on each received message before it is buffered (e.g. to expand compact messages)
+         */
+        template <class PROTO> void registerTelemetryType(const uint16_t &type, const size_t &buffersize = 10, bool lockfree = false,
+                                                          const std::function<void(PROTO *data)> &decode = nullptr) {
+            if (type >= telemetryRegistrations.size()) {
+                telemetryRegistrations.resize(type+1);
+            }
+            // kept to register the type again by setLazyTelemetry()
+            telemetryRegistrations[type] = [this, type, buffersize, lockfree, decode](bool lazy) {
+                if (lazy && decode) {
+                    // decoded messages have to be parsed on receive
+                    return false;
+                }
+                // keeps setLatestValueTelemetry() and setMaxTelemetryAge()
+                bool latestValue = telemetryAdders[type] && telemetryAdders[type]->overwrite.load();
+                int64_t maxAgeUs = telemetryAdders[type] ? telemetryAdders[type]->maxAgeUs.load() : 0;
+                TelemetryBuffer::Handle<PROTO> handle = buffers->registerType<PROTO>(type, latestValue ? 1 : buffersize, lockfree, lazy);
+                telemetryAdders[type] = std::shared_ptr<TelemetryAdderBase>(new TelemetryAdder<PROTO>(buffers, handle, decode));
+                telemetryAdders[type]->overwrite.store(latestValue);
+                telemetryAdders[type]->maxAgeUs.store(maxAgeUs);
+                telemetryAdders[type]->store = telemetryStore;
+                if (type < receiveStatistics.names.size()) {
+                    receiveStatistics.names[type] = PROTO::descriptor()->full_name();
+                }
+                return true;
+            };
             if (type >= telemetryAdders.size()) {  // e.g. type == 42, for index 42, size must be 43
                 telemetryAdders.resize(type+1);
             }
-            telemetryAdders[type] = std::shared_ptr<TelemetryAdderBase>(new TelemetryAdder<PROTO>(buffers));
+            telemetryRegistrations[type](false);
         }
 
+        /**
+         * @brief registerTelemetryType() of a type with TelemetryTraits, e.g. an extension type
+         */
+        template <uint16_t TYPE> void registerTelemetryType(const size_t &buffersize = 10, bool lockfree = false,
+                                                            const std::function<void(typename TelemetryTraits<TYPE>::type *data)> &decode = nullptr) {
+            registerTelemetryType<typename TelemetryTraits<TYPE>::type>(TYPE, buffersize, lockfree, decode);
+        }
+
+        std::vector< std::function<bool(bool lazy)> > telemetryRegistrations;
+
+        // registers the buffered TelemetryTypes in the constructor
+        struct DefaultTelemetryRegistrar;
+
 };
 
 }  // end namespace robot_remote_control
@@ -0,0 +1,147 @@
+#include "RobotControllerHub.hpp"
+
+#include <chrono>
+#include <algorithm>
+
+namespace robot_remote_control {
+
+RobotControllerHub::RobotControllerHub(const size_t &threads):
+    workers(threads ? threads : 1),
+    isRunning(false),
+    overruns(0) {}
+
+RobotControllerHub::~RobotControllerHub() {
+    stop();
+}
+
+bool RobotControllerHub::addRobot(const std::string &name, const std::shared_ptr<RobotController> &controller) {
+    if (!controller) {
+        return false;
+    }
+    if (controller->threaded()) {
+        printf("ERROR robot %s not added to the hub, the update thread of the controller is running\n", name.c_str());
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (sessions.find(name) != sessions.end()) {
+        return false;
+    }
+    // the least loaded thread
+    size_t worker = 0;
+    for (size_t i = 1; i < workers.size(); ++i) {
+        if (workers[i].robots.size() < workers[worker].robots.size()) {
+            worker = i;
+        }
+    }
+    Session &session = sessions[name];
+    session.controller = controller;
+    session.worker = worker;
+    workers[worker].robots.push_back(controller);
+    workers[worker].generation++;
+    return true;
+}
+
+bool RobotControllerHub::removeRobot(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto session = sessions.find(name);
+    if (session == sessions.end()) {
+        return false;
+    }
+    Worker &worker = workers[session->second.worker];
+    worker.robots.erase(std::remove(worker.robots.begin(), worker.robots.end(), session->second.controller), worker.robots.end());
+    worker.generation++;
+    sessions.erase(session);
+    return true;
+}
+
+std::shared_ptr<RobotController> RobotControllerHub::getRobot(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto session = sessions.find(name);
+    if (session == sessions.end()) {
+        return std::shared_ptr<RobotController>();
+    }
+    return session->second.controller;
+}
+
+std::vector<std::string> RobotControllerHub::getRobotNames() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> names;
+    names.reserve(sessions.size());
+    for (const auto &session : sessions) {
+        names.push_back(session.first);
+    }
+    return names;
+}
+
+size_t RobotControllerHub::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sessions.size();
+}
+
+void RobotControllerHub::updateAll() {
+    std::vector< std::shared_ptr<RobotController> > robots;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        robots.reserve(sessions.size());
+        for (const auto &session : sessions) {
+            robots.push_back(session.second.controller);
+        }
+    }
+    for (const std::shared_ptr<RobotController> &robot : robots) {
+        robot->update();
+    }
+}
+
+void RobotControllerHub::start(const unsigned int &milliseconds) {
+    if (isRunning.exchange(true)) {
+        return;
+    }
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].thread = std::thread(&RobotControllerHub::workerMain, this, i, milliseconds);
+    }
+}
+
+void RobotControllerHub::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!isRunning.exchange(false)) {
+            return;
+        }
+    }
+    stopCondition.notify_all();
+    for (Worker &worker : workers) {
+        if (worker.thread.joinable()) {
+            worker.thread.join();
+        }
+    }
+}
+
+void RobotControllerHub::workerMain(const size_t &index, const unsigned int &milliseconds) {
+    const std::chrono::milliseconds interval(milliseconds);
+    std::vector< std::shared_ptr<RobotController> > robots;
+    uint64_t generation = 0;
+    std::chrono::steady_clock::time_point nextPass = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    while (isRunning.load()) {
+        Worker &worker = workers[index];
+        if (worker.generation != generation) {
+            robots = worker.robots;
+            generation = worker.generation;
+        }
+        lock.unlock();
+        for (const std::shared_ptr<RobotController> &robot : robots) {
+            robot->update();
+        }
+        nextPass += interval;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (nextPass < now) {
+            // do not try to catch up, that would only delay the other threads
+            overruns++;
+            nextPass = now;
+        }
+        lock.lock();
+        stopCondition.wait_until(lock, nextPass, [this]() { return !isRunning.load(); });
+    }
+}
+
+}  // namespace robot_remote_control
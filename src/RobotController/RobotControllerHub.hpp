@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+#include "RobotController.hpp"
+
+namespace robot_remote_control {
+
+/**
+ * @brief runs the update() of many RobotControllers on a small pool of threads instead of one UpdateThread each
+ * (e.g. for a console connected to a fleet of robots).
+ * The controllers are used with their normal API, only their update thread is not started.
+ *
+ * Each robot is updated by one of the threads, in turn with the other robots of this thread.
+ * A blocking request in update() (the heartbeat) delays the other robots of the thread, so
+ * the controllers should use RobotController::setAsyncRequests() (the heartbeat does not wait for its reply then).
+ * When using TransportZmq, all robots share one zmq context, TransportZmq::setIOThreads() configures it.
+ */
+class RobotControllerHub {
+ public:
+    /**
+     * @param threads number of threads updating the robots
+     */
+    explicit RobotControllerHub(const size_t &threads = 1);
+
+    virtual ~RobotControllerHub();
+
+    /**
+     * @brief add a robot, it is updated by the next update pass
+     *
+     * @param name the unique name of the robot in this hub
+     * @param controller the controller, its own update thread must not be running
+     * @return false if the name is used or the controller runs its update thread
+     */
+    bool addRobot(const std::string &name, const std::shared_ptr<RobotController> &controller);
+
+    /**
+     * @brief remove a robot, it may still be in the current update pass
+     *
+     * @return false if there is no such robot
+     */
+    bool removeRobot(const std::string &name);
+
+    /**
+     * @brief Get the controller of a robot
+     *
+     * @return std::shared_ptr<RobotController> empty if there is no such robot
+     */
+    std::shared_ptr<RobotController> getRobot(const std::string &name);
+
+    std::vector<std::string> getRobotNames();
+
+    size_t size();
+
+    /**
+     * @brief update all robots once in the calling thread (to be used without start())
+     */
+    void updateAll();
+
+    /**
+     * @brief start the threads updating the robots
+     *
+     * @param milliseconds time between the starts of two update passes of a thread
+     */
+    void start(const unsigned int &milliseconds);
+
+    /**
+     * @brief stop the threads after their current update pass
+     */
+    void stop();
+
+    bool running() {
+        return isRunning.load();
+    }
+
+    /**
+     * @brief number of update passes that took longer than the update interval (of all threads)
+     */
+    uint64_t getOverruns() {
+        return overruns.load();
+    }
+
+ private:
+    struct Session {
+        std::shared_ptr<RobotController> controller;
+        size_t worker;
+    };
+
+    struct Worker {
+        Worker():generation(0) {}
+        std::vector< std::shared_ptr<RobotController> > robots;
+        // changed when robots changes, so the thread only copies the list on changes
+        uint64_t generation;
+        std::thread thread;
+    };
+
+    void workerMain(const size_t &index, const unsigned int &milliseconds);
+
+    std::mutex mutex;
+    std::condition_variable stopCondition;
+    std::map<std::string, Session> sessions;
+    std::vector<Worker> workers;
+    std::atomic<bool> isRunning;
+    std::atomic<uint64_t> overruns;
+};
+
+}  // namespace robot_remote_control
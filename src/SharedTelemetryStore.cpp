@@ -0,0 +1,401 @@
+#include "SharedTelemetryStore.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <chrono>
+
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+#endif
+
+namespace robot_remote_control {
+
+namespace {
+    const uint32_t storeMagic = 0x72727473;  // "rrts"
+    const uint32_t storeVersion = 1;
+    enum StoreState {INITIALIZING, READY, CLOSED};
+    // a reader retries when the newest slot was overwritten while it was copied
+    const int latestRetries = 4;
+
+    size_t align(const size_t &size) {
+        return (size + 63) & ~static_cast<size_t>(63);
+    }
+
+    void futexWait(std::atomic<uint32_t> *word, const uint32_t &value, const unsigned int &timeoutMs) {
+    #ifdef __linux__
+        timespec timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000;
+        // FUTEX_WAIT only reads the word, so it works on the read-only mapping of the readers
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+    #else
+        usleep(std::min(timeoutMs, 1u) * 1000);
+    #endif
+    }
+
+    int64_t steadyNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void futexWake(std::atomic<uint32_t> *word) {
+    #ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    #endif
+    }
+}
+
+struct SharedTelemetryStore::SlotHeader {
+    // seqlock: 2 * index + 1 while the message with the index is written, 2 * index + 2 when it is complete
+    std::atomic<uint64_t> sequence;
+    uint64_t size;
+};
+
+struct SharedTelemetryStore::TypeHeader {
+    std::atomic<uint64_t> published;
+    std::atomic<uint64_t> oversized;
+    // 0 if the type is not stored
+    uint32_t slots;
+    uint32_t slotBytes;
+    // of the first slot from the start of the segment
+    uint64_t offset;
+    // SlotHeader and data, aligned to cache lines
+    uint64_t slotStride;
+};
+
+struct SharedTelemetryStore::Segment {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> state;
+    // futex word, incremented on each publish
+    std::atomic<uint32_t> written;
+    uint64_t size;
+    TypeHeader types[TELEMETRY_MESSAGE_TYPES_NUMBER];
+};
+
+SharedTelemetryStore::SharedTelemetryStore(const std::string &name, const Mode &mode, const Options &options):
+    name(name[0] == '/' ? name : "/" + name),
+    mode(mode),
+    options(options),
+    segment(nullptr),
+    device(0),
+    inode(0),
+    checkedNs(0),
+    nextIndex(TELEMETRY_MESSAGE_TYPES_NUMBER, 0),
+    dropped(TELEMETRY_MESSAGE_TYPES_NUMBER, 0) {
+    if (mode == OWNER) {
+        std::lock_guard<std::mutex> lock(attachMutex);
+        create();
+    } else {
+        attach();
+    }
+}
+
+SharedTelemetryStore::~SharedTelemetryStore() {
+    Segment* mapped = segment.load();
+    if (mode == OWNER && mapped) {
+        // readers stop waiting and attach to the segment of the next owner
+        mapped->state.store(CLOSED);
+        mapped->written.fetch_add(1);
+        futexWake(&mapped->written);
+        // not the segment of a new owner that replaced this one
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd >= 0) {
+            if (isCurrent(fd)) {
+                shm_unlink(name.c_str());
+            }
+            close(fd);
+        }
+    }
+    for (const std::pair<void*, size_t> &mapping : mappings) {
+        munmap(mapping.first, mapping.second);
+    }
+}
+
+bool SharedTelemetryStore::remove(const std::string &name) {
+    return shm_unlink((name[0] == '/' ? name : "/" + name).c_str()) == 0;
+}
+
+bool SharedTelemetryStore::create() {
+    size_t size = align(sizeof(Segment));
+    for (const std::pair<const uint16_t, TypeLayout> &type : options.types) {
+        if (type.first < TELEMETRY_MESSAGE_TYPES_NUMBER && type.second.slots) {
+            size += type.second.slots * align(sizeof(SlotHeader) + type.second.slotBytes);
+        }
+    }
+    // the segment of a crashed owner would keep stale messages
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        printf("ERROR unable to create the telemetry store %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+    // sparse, the pages of the slots are allocated when they are written
+    if (ftruncate(fd, size) != 0) {
+        printf("ERROR unable to resize the telemetry store %s: %s\n", name.c_str(), strerror(errno));
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) == 0) {
+        device = status.st_dev;
+        inode = status.st_ino;
+    }
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        printf("ERROR unable to map the telemetry store %s: %s\n", name.c_str(), strerror(errno));
+        shm_unlink(name.c_str());
+        return false;
+    }
+    Segment* created = new (memory) Segment();
+    created->magic = storeMagic;
+    created->version = storeVersion;
+    created->written.store(0);
+    created->size = size;
+    size_t offset = align(sizeof(Segment));
+    for (uint16_t type = 0; type < TELEMETRY_MESSAGE_TYPES_NUMBER; ++type) {
+        TypeHeader &header = created->types[type];
+        header.published.store(0);
+        header.oversized.store(0);
+        auto layout = options.types.find(type);
+        header.slots = layout != options.types.end() ? layout->second.slots : 0;
+        header.slotBytes = header.slots ? layout->second.slotBytes : 0;
+        header.slotStride = header.slots ? align(sizeof(SlotHeader) + header.slotBytes) : 0;
+        header.offset = offset;
+        for (uint32_t index = 0; index < header.slots; ++index) {
+            SlotHeader* slotHeader = new (static_cast<char*>(memory) + offset + index * header.slotStride) SlotHeader();
+            slotHeader->sequence.store(0);
+            slotHeader->size = 0;
+        }
+        offset += header.slots * header.slotStride;
+    }
+    created->state.store(READY);
+    mappings.emplace_back(memory, size);
+    segment.store(created);
+    return true;
+}
+
+bool SharedTelemetryStore::isCurrent(const int &fd) {
+    struct stat status;
+    return fstat(fd, &status) == 0 && static_cast<uint64_t>(status.st_dev) == device && static_cast<uint64_t>(status.st_ino) == inode;
+}
+
+SharedTelemetryStore::Segment* SharedTelemetryStore::attach() {
+    Segment* mapped = segment.load();
+    if (mode == OWNER) {
+        return mapped;
+    }
+    // the state of a crashed owner stays READY, its replacement is only seen by the name
+    const int64_t now = steadyNs();
+    const int64_t checkIntervalNs = static_cast<int64_t>(replacementCheckMs) * 1000000;
+    if (mapped && mapped->state.load() == READY && now - checkedNs.load(std::memory_order_relaxed) < checkIntervalNs) {
+        return mapped;
+    }
+    std::lock_guard<std::mutex> lock(attachMutex);
+    mapped = segment.load();
+    if (mapped && mapped->state.load() == READY && now - checkedNs.load(std::memory_order_relaxed) < checkIntervalNs) {
+        // checked by another thread
+        return mapped;
+    }
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        // the owner is not started (again) yet, or the segment of a crashed one was removed
+        segment.store(nullptr);
+        return nullptr;
+    }
+    if (mapped && mapped->state.load() == READY && isCurrent(fd)) {
+        close(fd);
+        checkedNs.store(now, std::memory_order_relaxed);
+        return mapped;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Segment)) {
+        close(fd);
+        return nullptr;
+    }
+    const size_t size = status.st_size;
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        printf("ERROR unable to map the telemetry store %s: %s\n", name.c_str(), strerror(errno));
+        return nullptr;
+    }
+    Segment* attached = static_cast<Segment*>(memory);
+    if (attached->state.load() != READY) {
+        // initializing or closed, try again on the next use
+        munmap(memory, size);
+        return nullptr;
+    }
+    if (attached->magic != storeMagic || attached->version != storeVersion || attached->size > size) {
+        printf("ERROR %s is not a compatible telemetry store\n", name.c_str());
+        munmap(memory, size);
+        return nullptr;
+    }
+    // the former segment stays mapped, other threads may still read from it
+    mappings.emplace_back(memory, size);
+    device = status.st_dev;
+    inode = status.st_ino;
+    checkedNs.store(now, std::memory_order_relaxed);
+    std::fill(nextIndex.begin(), nextIndex.end(), 0);
+    segment.store(attached);
+    return attached;
+}
+
+bool SharedTelemetryStore::attached() {
+    return attach() != nullptr;
+}
+
+bool SharedTelemetryStore::isStored(const uint16_t &type) {
+    return typeHeader(attach(), type) != nullptr;
+}
+
+SharedTelemetryStore::TypeHeader* SharedTelemetryStore::typeHeader(Segment* mapped, const uint16_t &type) {
+    if (!mapped || type >= TELEMETRY_MESSAGE_TYPES_NUMBER || !mapped->types[type].slots) {
+        return nullptr;
+    }
+    return &mapped->types[type];
+}
+
+SharedTelemetryStore::SlotHeader* SharedTelemetryStore::slot(Segment* mapped, const TypeHeader &header, const uint64_t &index) {
+    return reinterpret_cast<SlotHeader*>(reinterpret_cast<char*>(mapped) + header.offset + (index % header.slots) * header.slotStride);
+}
+
+char* SharedTelemetryStore::beginPublish(const uint16_t &type, const size_t &size) {
+    Segment* mapped = segment.load();
+    TypeHeader* header = mode == OWNER ? typeHeader(mapped, type) : nullptr;
+    if (!header) {
+        return nullptr;
+    }
+    if (size > header->slotBytes) {
+        header->oversized.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    const uint64_t index = header->published.load(std::memory_order_relaxed);
+    SlotHeader* slotHeader = slot(mapped, *header, index);
+    slotHeader->sequence.store(2 * index + 1, std::memory_order_relaxed);
+    // the odd sequence is visible before the data changes
+    std::atomic_thread_fence(std::memory_order_release);
+    return reinterpret_cast<char*>(slotHeader) + sizeof(SlotHeader);
+}
+
+void SharedTelemetryStore::endPublish(const uint16_t &type, const size_t &size) {
+    Segment* mapped = segment.load();
+    TypeHeader &header = mapped->types[type];
+    const uint64_t index = header.published.load(std::memory_order_relaxed);
+    SlotHeader* slotHeader = slot(mapped, header, index);
+    slotHeader->size = size;
+    slotHeader->sequence.store(2 * index + 2, std::memory_order_release);
+    header.published.store(index + 1, std::memory_order_release);
+    mapped->written.fetch_add(1, std::memory_order_release);
+    // readers can not announce themselves on the read-only mapping, so they are always woken
+    futexWake(&mapped->written);
+}
+
+bool SharedTelemetryStore::publish(const uint16_t &type, const MessageView &serializedMessage) {
+    char* data = beginPublish(type, serializedMessage.size);
+    if (!data) {
+        return false;
+    }
+    if (serializedMessage.size) {
+        memcpy(data, serializedMessage.data, serializedMessage.size);
+    }
+    endPublish(type, serializedMessage.size);
+    return true;
+}
+
+bool SharedTelemetryStore::read(Segment* mapped, const TypeHeader &header, const uint64_t &index, std::string *serializedMessage) {
+    const SlotHeader* slotHeader = slot(mapped, header, index);
+    const uint64_t sequence = slotHeader->sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * index + 2) {
+        // overwritten by a newer message or being written
+        return false;
+    }
+    const size_t size = std::min<uint64_t>(slotHeader->size, header.slotBytes);
+    serializedMessage->assign(reinterpret_cast<const char*>(slotHeader) + sizeof(SlotHeader), size);
+    // the copy is complete before the sequence is checked again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slotHeader->sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+bool SharedTelemetryStore::readLatest(const uint16_t &type, std::string *serializedMessage) {
+    Segment* mapped = attach();
+    TypeHeader* header = typeHeader(mapped, type);
+    if (!header) {
+        return false;
+    }
+    for (int retry = 0; retry < latestRetries; ++retry) {
+        const uint64_t published = header->published.load(std::memory_order_acquire);
+        if (!published) {
+            return false;
+        }
+        if (read(mapped, *header, published - 1, serializedMessage)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SharedTelemetryStore::readNext(const uint16_t &type, std::string *serializedMessage) {
+    Segment* mapped = attach();
+    TypeHeader* header = typeHeader(mapped, type);
+    if (!header) {
+        return false;
+    }
+    uint64_t &next = nextIndex[type];
+    while (true) {
+        const uint64_t published = header->published.load(std::memory_order_acquire);
+        if (next >= published) {
+            return false;
+        }
+        if (published - next > header->slots) {
+            // overwritten already
+            dropped[type] += published - header->slots - next;
+            next = published - header->slots;
+        }
+        if (read(mapped, *header, next, serializedMessage)) {
+            next++;
+            return true;
+        }
+        // overwritten while it was copied
+        dropped[type]++;
+        next++;
+    }
+}
+
+bool SharedTelemetryStore::waitForTelemetry(const unsigned int &timeoutMs) {
+    Segment* mapped = attach();
+    if (!mapped) {
+        // nothing to wait on, check again later
+        usleep(std::min(timeoutMs, 10u) * 1000);
+        return false;
+    }
+    const uint32_t written = mapped->written.load(std::memory_order_acquire);
+    futexWait(&mapped->written, written, timeoutMs);
+    return mapped->written.load(std::memory_order_acquire) != written && mapped->state.load() == READY;
+}
+
+uint64_t SharedTelemetryStore::getPublished(const uint16_t &type) {
+    TypeHeader* header = typeHeader(attach(), type);
+    return header ? header->published.load(std::memory_order_acquire) : 0;
+}
+
+uint64_t SharedTelemetryStore::getDropped(const uint16_t &type) {
+    return type < dropped.size() ? dropped[type] : 0;
+}
+
+uint64_t SharedTelemetryStore::getOversized(const uint16_t &type) {
+    TypeHeader* header = typeHeader(attach(), type);
+    return header ? header->oversized.load(std::memory_order_relaxed) : 0;
+}
+
+}  // namespace robot_remote_control
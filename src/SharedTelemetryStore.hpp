@@ -0,0 +1,242 @@
+#pragma once
+
+#include "MessageTypes.hpp"
+#include "MessageTraits.hpp"
+#include "Transports/Transport.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief telemetry store in a shared memory segment (/dev/shm/<name>), so several processes on the controller host
+ * (e.g. UI, logger, supervisor) share the telemetry received by one RobotController instead of receiving and parsing it each.
+ *
+ * The OWNER process creates the store and passes it to its RobotController (RobotController::setTelemetryStore()),
+ * which publishes each received message of the stored types. READER processes map the segment read-only and get the
+ * messages without any lock: each type has a ring of fixed size slots, a seqlock per slot tells the reader if the slot was
+ * overwritten while it was copied. A reader attaches on first use and again when the OWNER was restarted, also after a crash:
+ * the segment behind the name is checked at most every replacementCheckMs for a new one of the next owner
+ * (the segments of former owners stay mapped until the reader is destroyed, so concurrent reads stay valid).
+ * Only the types below TELEMETRY_MESSAGE_TYPES_NUMBER can be stored.
+ *
+ * Messages larger than the slots of their type are not stored (see getOversized()).
+ * The messages are stored as received (e.g. with the PointCloudEncoding of the robot), except for the types decoded by the
+ * RobotController (e.g. compact joint names), which are stored decoded.
+ */
+class SharedTelemetryStore {
+ public:
+    enum Mode {OWNER, READER};
+
+    // interval of a READER checking if the segment was replaced by a new OWNER
+    enum : unsigned int { replacementCheckMs = 100 };
+
+    struct TypeLayout {
+        explicit TypeLayout(const uint32_t &slots = 4, const uint32_t &slotBytes = 64 * 1024):slots(slots), slotBytes(slotBytes) {}
+        // messages kept per type, readers reading slower than this lose the older ones
+        uint32_t slots;
+        // the largest message of the type
+        uint32_t slotBytes;
+    };
+
+    struct Options {
+        Options() {}
+        // the stored types (only used by the OWNER)
+        std::map<uint16_t, TypeLayout> types;
+
+        /**
+         * @brief store a type, e.g. Options().add(CURRENT_POSE).add(POINTCLOUD, TypeLayout(2, 16 * 1024 * 1024))
+         */
+        Options &add(const uint16_t &type, const TypeLayout &layout = TypeLayout()) {
+            types[type] = layout;
+            return *this;
+        }
+
+        /**
+         * @brief all telemetry types with the same layout (the pages of unused slots are never allocated)
+         */
+        static Options allTypes(const TypeLayout &layout = TypeLayout()) {
+            Options options;
+            for (uint16_t type = 0; type < TELEMETRY_MESSAGE_TYPES_NUMBER; ++type) {
+                options.add(type, layout);
+            }
+            return options;
+        }
+    };
+
+    /**
+     * @param name name of the shared memory segment, the same in all processes
+     * @param mode OWNER creates the segment, READER attaches to it
+     * @param options the stored types (OWNER only)
+     */
+    SharedTelemetryStore(const std::string &name, const Mode &mode, const Options &options = Options());
+    ~SharedTelemetryStore();
+
+    SharedTelemetryStore(const SharedTelemetryStore&) = delete;
+    SharedTelemetryStore& operator=(const SharedTelemetryStore&) = delete;
+
+    /**
+     * @brief true if the segment is mapped (a READER attaches on first use)
+     */
+    bool attached();
+
+    /**
+     * @brief true if the type is stored (READER: attaches first)
+     */
+    bool isStored(const uint16_t &type);
+
+    /**
+     * @brief store a serialized message of a type (OWNER only)
+     * @warning each type must only be published by one thread at a time
+     *
+     * @return false if the type is not stored or the message is too large
+     */
+    bool publish(const uint16_t &type, const MessageView &serializedMessage);
+
+    /**
+     * @brief store a message, serialized directly into the slot (OWNER only)
+     */
+    template <class PROTO> bool publish(const uint16_t &type, const PROTO &message) {
+        const size_t size = message.ByteSizeLong();
+        char* data = beginPublish(type, size);
+        if (!data) {
+            return false;
+        }
+        message.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(data));
+        endPublish(type, size);
+        return true;
+    }
+
+    /**
+     * @brief the newest message of a type, without removing it (READER and OWNER)
+     *
+     * @return false if there is no message of the type (yet)
+     */
+    template <class PROTO> bool getLatestTelemetry(const uint16_t &type, PROTO *data) {
+        std::string &buffer = readBuffer();
+        return readLatest(type, &buffer) && data->ParseFromString(buffer);
+    }
+
+    /**
+     * @brief the next message of a type this reader did not get yet, oldest first, like RobotController::getTelemetry().
+     * A new reader starts with the oldest message in the store.
+     * @warning the read positions are not thread safe, each thread reading with getTelemetry() needs its own store object
+     *
+     * @return false if there is no new message
+     */
+    template <class PROTO> bool getTelemetry(const uint16_t &type, PROTO *data) {
+        std::string &buffer = readBuffer();
+        return readNext(type, &buffer) && data->ParseFromString(buffer);
+    }
+
+    /**
+     * @brief getTelemetry() with the protobuf type resolved at compile time, e.g. getTelemetry<CURRENT_POSE>(&pose)
+     */
+    template <uint16_t TYPE> bool getTelemetry(typename TelemetryTraits<TYPE>::type *data) {
+        return getTelemetry(TYPE, data);
+    }
+
+    template <uint16_t TYPE> bool getLatestTelemetry(typename TelemetryTraits<TYPE>::type *data) {
+        return getLatestTelemetry(TYPE, data);
+    }
+
+    bool getCurrentPose(Pose *pose) {
+        return getTelemetry(CURRENT_POSE, pose);
+    }
+
+    bool getJointState(JointState *jointState) {
+        return getTelemetry(JOINT_STATE, jointState);
+    }
+
+    /**
+     * @brief the serialized newest message of a type, e.g. to forward it without parsing
+     */
+    bool readLatest(const uint16_t &type, std::string *serializedMessage);
+
+    /**
+     * @brief the serialized next message of a type, see getTelemetry()
+     */
+    bool readNext(const uint16_t &type, std::string *serializedMessage);
+
+    /**
+     * @brief wait until a message is published (of any type)
+     *
+     * @return true if a message was published within the timeout
+     */
+    bool waitForTelemetry(const unsigned int &timeoutMs);
+
+    /**
+     * @brief number of messages of a type published so far
+     */
+    uint64_t getPublished(const uint16_t &type);
+
+    /**
+     * @brief messages this reader lost with getTelemetry(), because they were overwritten before they were read
+     */
+    uint64_t getDropped(const uint16_t &type);
+
+    /**
+     * @brief messages the OWNER did not store because they were larger than the slots of their type
+     */
+    uint64_t getOversized(const uint16_t &type);
+
+    /**
+     * @brief remove a segment left by a crashed OWNER (a new OWNER replaces it anyway)
+     *
+     * @return false if there was no such segment
+     */
+    static bool remove(const std::string &name);
+
+ private:
+    struct Segment;
+    struct TypeHeader;
+    struct SlotHeader;
+
+    bool create();
+    // maps the segment of the OWNER, again if the mapped one was closed or replaced
+    Segment* attach();
+    // true if the name still refers to the mapped segment
+    bool isCurrent(const int &fd);
+
+    // nullptr if the type is not stored
+    TypeHeader* typeHeader(Segment* mapped, const uint16_t &type);
+    SlotHeader* slot(Segment* mapped, const TypeHeader &header, const uint64_t &index);
+    // copy the message with the index, false if it was overwritten (or not written yet)
+    bool read(Segment* mapped, const TypeHeader &header, const uint64_t &index, std::string *serializedMessage);
+
+    // the payload of the next slot of the type, nullptr if it does not fit
+    char* beginPublish(const uint16_t &type, const size_t &size);
+    void endPublish(const uint16_t &type, const size_t &size);
+
+    // reused by the getters of the calling thread
+    static std::string &readBuffer() {
+        static thread_local std::string buffer;
+        return buffer;
+    }
+
+    std::string name;
+    Mode mode;
+    Options options;
+
+    std::mutex attachMutex;
+    std::atomic<Segment*> segment;
+    // the mapped segments with their size, the current one last
+    std::vector< std::pair<void*, size_t> > mappings;
+    // identifies the file of the current segment, a new OWNER creates a new one
+    uint64_t device;
+    uint64_t inode;
+    // steady clock of the last check for a replaced segment
+    std::atomic<int64_t> checkedNs;
+
+    // READER: the index of the next message per type for readNext(), reset when attached to a new segment
+    std::vector<uint64_t> nextIndex;
+    std::vector<uint64_t> dropped;
+};
+
+}  // namespace robot_remote_control
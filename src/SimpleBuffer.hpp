@@ -4,31 +4,141 @@
 #include "RingBuffer.hpp"
 #include "MessageTypes.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <map>
 #include <memory>
 #include <vector>
 
 namespace robot_remote_control {
 
 
+/**
+ * @brief buffers of values with ids (e.g. SimpleSensor), one RingBuffer per id
+ */
 template <class BUFFERTYPE> class SimpleBuffer : public LockableClass< std::vector< std::shared_ptr<RingBufferBase> > >{
     public:
-        SimpleBuffer() {};
+        // sizes suggested by the robot (e.g. SimpleSensor::buffer_size()) are limited to this
+        enum : size_t { maxSuggestedBufferSize = 10000 };
+
+        explicit SimpleBuffer(const size_t &defaultBufferSize = 1):defaultBufferSize(std::max<size_t>(defaultBufferSize, 1)) {};
 
         virtual ~SimpleBuffer() {}
 
         void initBufferID (const uint16_t &id) {
             auto lockedAccessObject = lockedAccess();
-            if (lockedAccessObject.get().size() <= id) {
-                // resize(id+1); //if id == 1, indeyx should be one, so we need size two
-                lockedAccessObject.get().resize(id + 1);  // if id == 1, index should be one, so we need size two
+            initBuffer(&lockedAccessObject.get(), id);
+        }
+
+        /**
+         * @brief create the buffers of all ids of the elements (e.g. of the SimpleSensors of a SIMPLE_SENSOR_DEFINITION),
+         * so receiving does not resize the buffers
+         *
+         * @param bufferSize the size of the buffer of an element (e.g. SimpleSensor::buffer_size()), 0 for the default,
+         * at most maxSuggestedBufferSize, sizes set with setBufferSize() are kept
+         */
+        template <class CONTAINER> void initBuffers(const CONTAINER &elements, const std::function<size_t(const BUFFERTYPE &element)> &bufferSize = nullptr) {
+            auto lockedAccessObject = lockedAccess();
+            for (const BUFFERTYPE &element : elements) {
+                // received from the robot, a corrupt or huge value would allocate a buffer of that many messages
+                const size_t size = bufferSize ? std::min<size_t>(bufferSize(element), maxSuggestedBufferSize) : 0;
+                if (size && !configuredSizes.count(element.id())) {
+                    suggestedSizes[element.id()] = size;
+                }
+                initBuffer(&lockedAccessObject.get(), element.id());
+            }
+        }
+
+        /**
+         * @brief set the number of buffered values of an id, resizes an existing buffer (dropping its values)
+         *
+         * @return false if the size is 0 (the buffer is not changed)
+         */
+        bool setBufferSize(const uint16_t &id, const size_t &size) {
+            if (!size) {
+                printf("buffers need a size of at least one value, %zu for id %i is ignored\n", size, id);
+                return false;
+            }
+            auto lockedAccessObject = lockedAccess();
+            configuredSizes[id] = size;
+            std::vector< std::shared_ptr<RingBufferBase> > &buffers = lockedAccessObject.get();
+            if (buffers.size() > id && buffers[id].get() && buffers[id]->capacity() != size) {
+                buffers[id]->resize(size);
+            }
+            return true;
+        }
+
+        /**
+         * @brief the size of buffers created for ids without a configured size
+         *
+         * @return false if the size is 0 (the default is not changed)
+         */
+        bool setDefaultBufferSize(const size_t &size) {
+            if (!size) {
+                printf("buffers need a size of at least one value, a default size of 0 is ignored\n");
+                return false;
+            }
+            auto lockedAccessObject = lockedAccess();
+            defaultBufferSize = size;
+            return true;
+        }
+
+        /**
+         * @brief push a value into the buffer of its id, created if needed, with one lock
+         */
+        void pushData(BUFFERTYPE &&data) {
+            auto lockedAccessObject = lockedAccess();
+            push(&lockedAccessObject.get(), std::move(data));
+        }
+
+        /**
+         * @brief push all values (e.g. the sensors of a SimpleSensors message) with one lock, they are moved into the buffers
+         */
+        template <class CONTAINER> void pushAll(CONTAINER *elements) {
+            auto lockedAccessObject = lockedAccess();
+            for (BUFFERTYPE &element : *elements) {
+                push(&lockedAccessObject.get(), std::move(element));
+            }
+        }
+
+    private:
+        size_t bufferSize(const uint16_t &id) const {
+            auto configured = configuredSizes.find(id);
+            if (configured != configuredSizes.end()) {
+                return configured->second;
             }
+            auto suggested = suggestedSizes.find(id);
+            return suggested != suggestedSizes.end() ? suggested->second : defaultBufferSize;
+        }
 
-            if (lockedAccessObject.get()[id].get() == nullptr) {
-                    std::shared_ptr<RingBufferBase> newbuf;
-                    newbuf = std::shared_ptr<RingBufferBase>(new RingBuffer<BUFFERTYPE>(1));
-                    lockedAccessObject.get()[id] = newbuf;
+        RingBuffer<BUFFERTYPE>* initBuffer(std::vector< std::shared_ptr<RingBufferBase> > *buffers, const uint16_t &id) {
+            if (buffers->size() <= id) {
+                buffers->resize(id + 1);  // if id == 1, index should be one, so we need size two
+            }
+            std::shared_ptr<RingBufferBase> &buffer = (*buffers)[id];
+            if (buffer.get() == nullptr) {
+                buffer = std::shared_ptr<RingBufferBase>(new RingBuffer<BUFFERTYPE>(bufferSize(id)));
+            } else if (buffer->size() == 0 && buffer->capacity() != bufferSize(id)) {
+                // a suggested size of a new definition
+                buffer->resize(bufferSize(id));
             }
+            // all buffers are created here
+            return static_cast<RingBuffer<BUFFERTYPE>*>(buffer.get());
         }
+
+        void push(std::vector< std::shared_ptr<RingBufferBase> > *buffers, BUFFERTYPE &&data) {
+            RingBuffer<BUFFERTYPE> *buffer = (buffers->size() > data.id() && (*buffers)[data.id()].get())
+                                                 ? static_cast<RingBuffer<BUFFERTYPE>*>((*buffers)[data.id()].get())
+                                                 : initBuffer(buffers, data.id());
+            buffer->pushData(std::move(data), true);
+        }
+
+        size_t defaultBufferSize;
+        // set by setBufferSize()
+        std::map<uint16_t, size_t> configuredSizes;
+        // from initBuffers()
+        std::map<uint16_t, size_t> suggestedSizes;
 };
 
-}  // namespace robot_remote_control
\ No newline at end of file
+}  // namespace robot_remote_control
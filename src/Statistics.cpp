@@ -1,71 +1,138 @@
 #include "Statistics.hpp"
+#include "MetricsExporter.hpp"
 #include <algorithm>
+#include <cstdio>
 
 namespace robot_remote_control {
 
-Statistics::Stats::Stats(const double &runningAvgSamples) {
+Statistics::Stats::Stats(const double &runningAvgSamples):bytes(0), messages(0), skipped(0), bytesLastCalc(0), messagesLastCalc(0) {
     statdata.bytesTotal = 0;
+    statdata.messagesTotal = 0;
     statdata.bytesSinceLast = 0;
+    statdata.lastBytesSize = 0;
     statdata.bpsLast = 0;
     statdata.bpsAvg = 0;
+    statdata.frequency = 0;
+    statdata.frequencyAvg = 0;
+    statdata.skippedTotal = 0;
     gettimeofday(&statdata.lastCalc, 0);
+    statdata.initTime = statdata.lastCalc;
     statdata.runningAvgSamples = runningAvgSamples;
     runningAvgFactor = ((runningAvgSamples-1)/runningAvgSamples);
 }
 
 
-void Statistics::Stats::addBytesSent(const double& bytes) {
-    statdata.bytesTotal += bytes;
-    statdata.bytesSinceLast += bytes;
+void Statistics::Stats::addBytesSent(const double& bytesSent) {
+    bytes.fetch_add(bytesSent, std::memory_order_relaxed);
+    messages.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Statistics::Stats::addSkipped() {
+    skipped.fetch_add(1, std::memory_order_relaxed);
 }
 
 void Statistics::Stats::calculate(timeval* currenttime) {
+    std::lock_guard<std::mutex> lock(statdataMutex);
     timersub(currenttime, &statdata.lastCalc, &diff);
     double seconds = (diff.tv_sec * 1000000 + static_cast<double>(diff.tv_usec))/1000000.0;
+    if (seconds <= 0) {
+        return;
+    }
+
+    uint64_t bytesNow = bytes.load(std::memory_order_relaxed);
+    uint64_t messagesNow = messages.load(std::memory_order_relaxed);
+    statdata.bytesSinceLast = bytesNow - bytesLastCalc;
+    uint64_t messagesSinceLast = messagesNow - messagesLastCalc;
+    bytesLastCalc = bytesNow;
+    messagesLastCalc = messagesNow;
 
     statdata.bpsLast = (statdata.bytesSinceLast/seconds);
     statdata.bpsAvg = (statdata.bpsAvg * runningAvgFactor) + (statdata.bpsLast/statdata.runningAvgSamples);
     statdata.lastCalc = *currenttime;
 
-    if (statdata.bytesSinceLast > 0) {
-        statdata.frequency = 1/seconds;
-        statdata.lastBytesSize = statdata.bytesSinceLast;
-    } else {
-        statdata.frequency = 0;
+    statdata.frequency = messagesSinceLast / seconds;
+    if (messagesSinceLast > 0) {
+        statdata.lastBytesSize = statdata.bytesSinceLast / messagesSinceLast;
     }
 
     statdata.frequencyAvg = (statdata.frequencyAvg * runningAvgFactor) + (statdata.frequency/statdata.runningAvgSamples);
+}
 
-    statdata.bytesSinceLast = 0;
+Statistics::StatData Statistics::Stats::getStats() {
+    std::lock_guard<std::mutex> lock(statdataMutex);
+    StatData current = statdata;
+    current.bytesTotal = bytes.load(std::memory_order_relaxed);
+    current.messagesTotal = messages.load(std::memory_order_relaxed);
+    current.skippedTotal = skipped.load(std::memory_order_relaxed);
+    return current;
 }
 
 void Statistics::Stats::print(const std::string& name) {
+    StatData current = getStats();
+    if (current.skippedTotal > 0) {
+        printf("%.2f kBytes/s avg: %s (size kB: %.2f, skipped: %.0f)\n", current.bpsAvg/1000.0, name.c_str(), current.lastBytesSize/1000.0, current.skippedTotal);
+    } else {
+        printf("%.2f kBytes/s avg: %s (size kB: %.2f)\n", current.bpsAvg/1000.0, name.c_str(), current.lastBytesSize/1000.0);
+    }
+}
+
+Statistics::Statistics() {
     #ifdef RRC_STATISTICS
-        printf("%.2f kBytes/s avg: %s (size kB: %.2f)\n", statdata.bpsAvg/1000.0, name.c_str(), statdata.lastBytesSize/1000.0);
+        enabled.store(true);
+    #else
+        enabled.store(false);
     #endif
 }
 
 void Statistics::calculate() {
-    #ifdef RRC_STATISTICS
-        gettimeofday(&currenttime, 0);
-        global.calculate(&currenttime);
-        std::for_each(stat_per_type.begin(), stat_per_type.end(), [&](auto & stat){
-            stat.calculate(&currenttime);
-        });
-    #endif
+    if (!isEnabled()) {
+        return;
+    }
+    gettimeofday(&currenttime, 0);
+    global.calculate(&currenttime);
+    std::for_each(stat_per_type.begin(), stat_per_type.end(), [&](auto & stat){
+        stat.calculate(&currenttime);
+    });
 }
 
 void Statistics::print(const bool &verbose) {
-    #ifdef RRC_STATISTICS
-        global.print("global");
-        if (verbose) {
-            for (int i = 1; i < names.size(); ++i) {
-                stat_per_type[i].print(names[i]);
-            }
+    if (!isEnabled()) {
+        return;
+    }
+    global.print("global");
+    if (verbose) {
+        for (size_t i = 1; i < names.size(); ++i) {
+            stat_per_type[i].print(names[i]);
         }
-    #endif
+    }
 }
 
-
+void Statistics::appendMetrics(std::string *out, const std::string &prefix) const {
+    typedef uint64_t (Stats::*Total)() const;
+    struct Counter {
+        const char* name;
+        Total total;
+        const char* help;
+    };
+    const Counter counters[] = {
+        {"_bytes_total", &Stats::getBytesTotal, "bytes of the sent telemetry"},
+        {"_messages_total", &Stats::getMessagesTotal, "sent telemetry messages"},
+        {"_skipped_total", &Stats::getSkippedTotal, "telemetry messages not sent because of rate limits"}
+    };
+    for (const Counter &counter : counters) {
+        // the per type metrics are separate families, so summing them does not count the global ones twice
+        MetricsExporter::appendFamily(out, prefix + counter.name, "counter", counter.help);
+        MetricsExporter::appendSample(out, prefix + counter.name, "", (global.*counter.total)());
+        MetricsExporter::appendFamily(out, prefix + "_type" + counter.name, "counter", std::string(counter.help) + " per type");
+        for (size_t type = 1; type < names.size(); ++type) {
+            if (names[type].empty()) {
+                continue;
+            }
+            MetricsExporter::appendSample(out, prefix + "_type" + counter.name,
+                                          MetricsExporter::label("type", std::to_string(type)) + "," + MetricsExporter::label("name", names[type]),
+                                          (stat_per_type[type].*counter.total)());
+        }
+    }
+}
 
 }  // namespace robot_remote_control
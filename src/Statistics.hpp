@@ -2,10 +2,19 @@
 
 #include "MessageTypes.hpp"
 #include <string>
+#include <array>
+#include <atomic>
+#include <mutex>
 #include <sys/time.h>
 
 namespace robot_remote_control {
 
+/**
+ * @brief statistics of the sent telemetry, the counters are lock-free and can be updated from several sending threads.
+ * calculate() derives the rates from them and should be called periodically by one thread.
+ *
+ * Recording is enabled by default if this library is compiled with RRC_STATISTICS and can be switched at runtime by setEnabled().
+ */
 class Statistics {
  public:
     struct StatData{
@@ -14,41 +23,93 @@ class Statistics {
         double bytesSinceLast;
         double lastBytesSize;
         double bytesTotal;
+        double messagesTotal;
         double bpsLast;
         double bpsAvg;
         double frequency;
         double frequencyAvg;
         double runningAvgSamples;
+        // messages not sent because of rate limits
+        double skippedTotal;
     };
 
     struct Stats {
         explicit Stats(const double &runningAvgSamples = 10);
 
+        // one sent message
         void addBytesSent(const double& bytes);
 
+        void addSkipped();
+
         void calculate(timeval* currenttime);
 
         void print(const std::string& name);
 
-        const StatData& getStats() {
-            return statdata;
+        /**
+         * @brief the rates of the last calculate() and the current totals
+         */
+        StatData getStats();
+
+        // the lock-free totals, e.g. for MetricsExporter
+        uint64_t getBytesTotal() const {
+            return bytes.load(std::memory_order_relaxed);
+        }
+
+        uint64_t getMessagesTotal() const {
+            return messages.load(std::memory_order_relaxed);
+        }
+
+        uint64_t getSkippedTotal() const {
+            return skipped.load(std::memory_order_relaxed);
         }
 
-        StatData statdata;
         double runningAvgFactor;
 
      private:
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> messages;
+        std::atomic<uint64_t> skipped;
+
+        // used by calculate() and getStats()
+        std::mutex statdataMutex;
+        StatData statdata;
+        uint64_t bytesLastCalc;
+        uint64_t messagesLastCalc;
         timeval diff;
     };
 
+    Statistics();
+
+    /**
+     * @brief switch the recording on or off, the recorded values are kept
+     */
+    void setEnabled(const bool &enable) {
+        enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
     void calculate();
 
     void print(const bool &verbose = false);
 
+    /**
+     * @brief append the totals (global and of the types with a name) in the Prometheus text format,
+     * only reads the lock-free counters, so it can be called from the thread of a MetricsExporter
+     *
+     * @param prefix prefix of the metric names
+     */
+    void appendMetrics(std::string *out, const std::string &prefix = "rrc_sent") const;
+
     timeval currenttime;
     Stats global;
     std::array<std::string, TELEMETRY_MESSAGE_TYPES_NUMBER> names;
     std::array<Stats, TELEMETRY_MESSAGE_TYPES_NUMBER> stat_per_type;
+
+ private:
+    std::atomic<bool> enabled;
 };
 
 }  // namespace robot_remote_control
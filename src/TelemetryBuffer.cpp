@@ -4,12 +4,9 @@
 namespace robot_remote_control {
 
 
-    TelemetryBuffer::TelemetryBuffer() {
-        // create vector of shared ptr
+    TelemetryBuffer::TelemetryBuffer() : totalBytes(0), memoryBudget(0) {
         // just pre-set sizes to minimize resize calls in registerType
-        lockedAccess()->resize(TELEMETRY_MESSAGE_TYPES_NUMBER);
-
-        converters.resize(TELEMETRY_MESSAGE_TYPES_NUMBER);
+        entries.resize(TELEMETRY_MESSAGE_TYPES_NUMBER);
     }
 
     TelemetryBuffer::~TelemetryBuffer() {
@@ -18,11 +15,98 @@ namespace robot_remote_control {
 
     std::string TelemetryBuffer::peekSerialized(const uint16_t &type) {
         std::string buf("");
-        if (type != NO_TELEMETRY_DATA || type != TELEMETRY_MESSAGE_TYPES_NUMBER) {
-            buf = converters[type]->get();
+        if (type < entries.size() && entries[type].converter.get()) {
+            buf = entries[type].converter->get();
         }
 
         return buf;
     }
 
+    bool TelemetryBuffer::resize(const uint16_t &type, const size_t &newsize) {
+        if (type < entries.size() && entries[type].buffer.get()) {
+            Entry &entry = entries[type];
+            if (entry.mutex) {
+                std::lock_guard<std::mutex> lock(*entry.mutex);
+                entry.buffer->resize(newsize);
+            } else {
+                entry.buffer->resize(newsize);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool TelemetryBuffer::countBytes(Entry *entry) {
+        std::shared_ptr<BufferedBytes> bytes = std::atomic_load(&entry->bytes);
+        if (!bytes) {
+            bytes = std::make_shared<BufferedBytes>(&totalBytes);
+        }
+        if (!entry->buffer->setByteLimit(entry->maxBytes, bytes)) {
+            std::atomic_store(&entry->bytes, std::shared_ptr<BufferedBytes>());
+            return false;
+        }
+        std::atomic_store(&entry->bytes, bytes);
+        return true;
+    }
+
+    bool TelemetryBuffer::setByteCapacity(const uint16_t &type, const size_t &maxBytes) {
+        if (type >= entries.size() || !entries[type].buffer.get() || !entries[type].mutex) {
+            return false;
+        }
+        Entry &entry = entries[type];
+        std::lock_guard<std::mutex> lock(*entry.mutex);
+        entry.maxBytes = maxBytes;
+        return countBytes(&entry);
+    }
+
+    void TelemetryBuffer::setMemoryBudget(const size_t &maxBytes) {
+        for (Entry &entry : entries) {
+            if (entry.buffer.get() && entry.mutex && !std::atomic_load(&entry.bytes)) {
+                std::lock_guard<std::mutex> lock(*entry.mutex);
+                countBytes(&entry);
+            }
+        }
+        memoryBudget.store(maxBytes);
+        enforceMemoryBudget();
+    }
+
+    void TelemetryBuffer::dropOverBudget(const size_t &budget) {
+        std::vector<bool> kept(entries.size(), false);
+        while (totalBytes.load(std::memory_order_relaxed) > static_cast<int64_t>(budget)) {
+            // the type using the most memory, which has more than its newest message
+            Entry* largest = nullptr;
+            size_t largestIndex = 0;
+            int64_t largestBytes = 0;
+            for (size_t i = 0; i < entries.size(); ++i) {
+                Entry &entry = entries[i];
+                // setByteCapacity() may start counting a type meanwhile
+                const std::shared_ptr<BufferedBytes> bytes = std::atomic_load(&entry.bytes);
+                if (bytes && !kept[i] && (!largest || bytes->bytes.load() > largestBytes)) {
+                    largest = &entry;
+                    largestIndex = i;
+                    largestBytes = bytes->bytes.load();
+                }
+            }
+            if (!largest) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(*largest->mutex);
+            if (!largest->buffer->dropOldest()) {
+                kept[largestIndex] = true;
+            }
+        }
+    }
+
+    size_t TelemetryBuffer::size(const uint16_t &type) {
+        if (type < entries.size() && entries[type].buffer.get()) {
+            Entry &entry = entries[type];
+            if (entry.mutex) {
+                std::lock_guard<std::mutex> lock(*entry.mutex);
+                return entry.buffer->size();
+            }
+            return entry.buffer->size();
+        }
+        return 0;
+    }
+
 }  // namespace robot_remote_control
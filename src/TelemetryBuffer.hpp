@@ -4,29 +4,294 @@
 #include <memory>
 #include <vector>
 #include <string>
+#include <mutex>
+#include <atomic>
+#include <typeinfo>
 
-#include "UpdateThread/LockableClass.hpp"
 #include "RingBuffer.hpp"
+#include "LockFreeRingBuffer.hpp"
+#include "LazyRingBuffer.hpp"
 #include "MessageTypes.hpp"
 
 
 namespace robot_remote_control {
 
-class TelemetryBuffer: public LockableClass< std::vector < std::shared_ptr <RingBufferBase> > > {
+/**
+ * @brief Buffers of all telemetry types, each buffer has its own lock (or none if lock-free).
+ * The types have to be registered before the buffers are used (e.g. in the constructor),
+ * afterwards the vector of buffers is not changed anymore and can be read without locking.
+ */
+class TelemetryBuffer {
  public:
     explicit TelemetryBuffer();
 
     ~TelemetryBuffer();
 
+    /**
+     * @brief typed access to the buffer of one type, without dynamic casts or reference counting.
+     * It is valid as long as the TelemetryBuffer exists and the type is not registered again.
+     */
+    template <class TYPE> class Handle {
+     public:
+        Handle() : buffer(nullptr), mutex(nullptr), lazy(nullptr) {}
+        Handle(TypedRingBufferBase<TYPE>* buffer, std::mutex* mutex, LazyRingBuffer<TYPE>* lazy = nullptr) : buffer(buffer), mutex(mutex), lazy(lazy) {}
+
+        bool valid() const {
+            return buffer != nullptr;
+        }
+
+        bool pushData(const TYPE & data, bool overwriteIfFull = false) {
+            if (!buffer) {
+                return false;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                return buffer->pushData(data, overwriteIfFull);
+            }
+            return buffer->pushData(data, overwriteIfFull);
+        }
+
+        bool pushData(TYPE && data, bool overwriteIfFull = false) {
+            if (!buffer) {
+                return false;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                return buffer->pushData(std::move(data), overwriteIfFull);
+            }
+            return buffer->pushData(std::move(data), overwriteIfFull);
+        }
+
+        bool pushInPlace(const std::function<bool(TYPE *slot)> &fill, bool overwriteIfFull = false) {
+            if (!buffer) {
+                return false;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                return buffer->pushInPlace(fill, overwriteIfFull);
+            }
+            return buffer->pushInPlace(fill, overwriteIfFull);
+        }
+
+        /**
+         * @brief push a serialized protobuf message, it is parsed into the next slot (or only copied if the buffer is lazy)
+         *
+         * @return false if the message could not be parsed or the buffer is full
+         */
+        bool pushSerialized(const char* data, const size_t &size, bool overwriteIfFull = false) {
+            if (!buffer) {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock;
+            if (mutex) {
+                lock = std::unique_lock<std::mutex>(*mutex);
+            }
+            if (lazy) {
+                return lazy->pushSerialized(data, size, overwriteIfFull);
+            }
+            // parsed into the slot, Clear() keeps the memory of strings and repeated fields of the old content
+            return buffer->pushInPlace([&](TYPE *slot) {
+                return slot->ParseFromArray(data, size);
+            }, overwriteIfFull);
+        }
+
+        /**
+         * @brief pop the oldest element by swapping it into data, no copy
+         */
+        bool popData(TYPE *data) {
+            if (!buffer) {
+                return false;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                return buffer->popData(data);
+            }
+            return buffer->popData(data);
+        }
+
+        bool peekData(TYPE *data) {
+            if (!buffer) {
+                return false;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                return buffer->peekData(data);
+            }
+            return buffer->peekData(data);
+        }
+
+        /**
+         * @brief pop all elements (oldest first) with one lock, appended to data
+         *
+         * @return size_t number of popped elements
+         */
+        size_t popAll(std::vector<TYPE> *data) {
+            if (!buffer) {
+                return 0;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                return buffer->popAll(data);
+            }
+            return buffer->popAll(data);
+        }
+
+        /**
+         * @brief copy all elements (oldest first) with one lock, so they match size() at that time
+         *
+         * @return false if the type is not registered or the buffer is lock-free
+         */
+        bool peekAll(std::vector<TYPE> *data) {
+            if (!buffer) {
+                return false;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                return buffer->peekAll(data);
+            }
+            return buffer->peekAll(data);
+        }
+
+        size_t size() {
+            if (!buffer) {
+                return 0;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                return buffer->size();
+            }
+            return buffer->size();
+        }
+
+        size_t capacity() {
+            if (!buffer) {
+                return 0;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                return buffer->capacity();
+            }
+            return buffer->capacity();
+        }
+
+        bool addDataReceivedCallback(const std::function<void(const TYPE & data)> &cb) {
+            if (!buffer) {
+                return false;
+            }
+            if (mutex) {
+                std::lock_guard<std::mutex> lock(*mutex);
+                buffer->addDataReceivedCallback(cb);
+            } else {
+                buffer->addDataReceivedCallback(cb);
+            }
+            return true;
+        }
+
+     private:
+        TypedRingBufferBase<TYPE>* buffer;
+        std::mutex* mutex;
+        // same as buffer if the buffer is lazy
+        LazyRingBuffer<TYPE>* lazy;
+    };
 
     /**
      * @brief get the serializes buffer value, so the calling function does not need to know the datatype.
-     * 
+     *
      * @param type The TelemetryMessageType, using a size_t to be able to extent the function
-     * @return std::string 
+     * @return std::string
      */
     std::string peekSerialized(const uint16_t &type);
 
+    /**
+     * @brief Get the number of elements in the buffer of a type
+     *
+     * @param type the type
+     * @return size_t the size, 0 if the type is not registered
+     */
+    size_t size(const uint16_t &type);
+
+    /**
+     * @brief change the capacity of the buffer of a type, old messages are dropped if it shrinks
+     * @warning not thread safe for lock-free buffers
+     *
+     * @return false if the type is not registered
+     */
+    bool resize(const uint16_t &type, const size_t &newsize);
+
+    /**
+     * @brief limit the memory of the buffer of a type (ByteSizeLong() of the messages, the serialized size if lazy),
+     * the oldest messages are dropped when it is exceeded, the newest one is always kept.
+     * The limit is applied in addition to the number of messages, and kept when the type is registered again.
+     *
+     * @param maxBytes the limit, 0 to only count the bytes (see getBufferedBytes())
+     * @return false if the type is not registered or the buffer is lock-free
+     */
+    bool setByteCapacity(const uint16_t &type, const size_t &maxBytes);
+
+    /**
+     * @brief limit the memory of all buffers with a mutex (the lock-free ones are not counted),
+     * when it is exceeded the oldest messages of the types using the most memory are dropped by enforceMemoryBudget(),
+     * the newest message of each type is kept.
+     * The buffers are counted from this call on, so it should be called after all types are registered.
+     *
+     * @param maxBytes the budget, 0 for no budget
+     */
+    void setMemoryBudget(const size_t &maxBytes);
+
+    /**
+     * @brief drop messages if the memory budget is exceeded, only reads a counter when it is not
+     * @warning must not be called while the buffer of a type is locked (e.g. in a callback)
+     */
+    void enforceMemoryBudget() {
+        const size_t budget = memoryBudget.load(std::memory_order_relaxed);
+        if (budget && totalBytes.load(std::memory_order_relaxed) > static_cast<int64_t>(budget)) {
+            dropOverBudget(budget);
+        }
+    }
+
+    /**
+     * @brief the bytes of the buffered messages of a type, without locking the buffer
+     *
+     * @return size_t 0 if the bytes of the type are not counted (setByteCapacity(), setMemoryBudget())
+     */
+    size_t getBufferedBytes(const uint16_t &type) const {
+        if (type < entries.size()) {
+            const std::shared_ptr<BufferedBytes> bytes = std::atomic_load(&entries[type].bytes);
+            if (bytes) {
+                return std::max<int64_t>(0, bytes->bytes.load(std::memory_order_relaxed));
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief the bytes of all counted buffers
+     */
+    size_t getBufferedBytes() const {
+        return std::max<int64_t>(0, totalBytes.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief true if the type is buffered serialized (see LazyRingBuffer)
+     */
+    bool isLazy(const uint16_t &type) {
+        return type < entries.size() && entries[type].lazy;
+    }
+
+    /**
+     * @brief Get the typed handle of a registered type
+     *
+     * @return Handle<TYPE> invalid handle if type is not registered with this TYPE
+     */
+    template<class TYPE> Handle<TYPE> getHandle(const uint16_t &type) {
+        if (type < entries.size() && entries[type].datatype && *entries[type].datatype == typeid(TYPE)) {
+            // type is checked, no dynamic cast needed
+            TypedRingBufferBase<TYPE>* buffer = static_cast<TypedRingBufferBase<TYPE>*>(entries[type].buffer.get());
+            LazyRingBuffer<TYPE>* lazy = entries[type].lazy ? static_cast<LazyRingBuffer<TYPE>*>(buffer) : nullptr;
+            return Handle<TYPE>(buffer, entries[type].mutex.get(), lazy);
+        }
+        return Handle<TYPE>();
+    }
 
     class ProtobufToStringBase {
      public:
@@ -36,50 +301,93 @@ class TelemetryBuffer: public LockableClass< std::vector < std::shared_ptr <Ring
 
     template <class PBTYPE> class ProtobufToString : public ProtobufToStringBase{
      public:
-        explicit ProtobufToString(const uint16_t& type, TelemetryBuffer *telemetrybuffer) : type(type), telemetrybuffer(telemetrybuffer) {}
+        explicit ProtobufToString(const Handle<PBTYPE> &handle) : handle(handle) {}
         virtual ~ProtobufToString() {}
 
         virtual std::string get() {
             std::string buf("");
             PBTYPE data;
-            // expects the buffer to be locked!
-            auto lockObj = telemetrybuffer->lockedAccess();
-            if (RingBufferAccess::peekData(lockObj.get()[type], &data)) {
+            if (handle.peekData(&data)) {
                 data.SerializeToString(&buf);
             }
             return buf;
         }
 
      private:
-        uint16_t type;
-        TelemetryBuffer* telemetrybuffer;
+        Handle<PBTYPE> handle;
     };
 
-    template<class PBTYPE> void registerType(const uint16_t &type, const size_t &buffersize) {
-        auto lockedAccessObject = lockedAccess();
-
+    /**
+     * @brief register a buffer for a type
+     * @warning not thread safe, all types have to be registered before the buffers are used
+     *
+     * @param type the type
+     * @param buffersize size of the buffer
+     * @param lockfree use a LockFreeRingBuffer, only allowed when there is only one thread pushing and one thread reading
+     * @param lazy store the serialized messages, they are parsed when read (see LazyRingBuffer)
+     * @return Handle<PBTYPE> handle to access the buffer of this type
+     */
+    template<class PBTYPE> Handle<PBTYPE> registerType(const uint16_t &type, const size_t &buffersize, bool lockfree = false, bool lazy = false) {
         // add buffer type
-        if (lockedAccessObject.get().size() <= type) {  // if size == type, index of type is not available
-            lockedAccessObject.get().resize(type + 1);  // size != index
+        if (entries.size() <= type) {  // if size == type, index of type is not available
+            entries.resize(type + 1);  // size != index
         }
 
-        std::shared_ptr<RingBufferBase> newbuf = std::shared_ptr<RingBufferBase>(new RingBuffer<PBTYPE>(buffersize));
-        lockedAccessObject.get()[type] = newbuf;
-
-        // add to string converter
-        if (converters.size() <= type) {
-            converters.resize(type + 1);  // size != index
+        Entry &entry = entries[type];
+        entry.lazy = lazy;
+        if (lazy) {
+            entry.buffer = std::shared_ptr<RingBufferBase>(new LazyRingBuffer<PBTYPE>(buffersize, lockfree));
+            if (lockfree) {
+                entry.mutex.reset();
+            } else {
+                entry.mutex.reset(new std::mutex());
+            }
+        } else if (lockfree) {
+            entry.buffer = std::shared_ptr<RingBufferBase>(new LockFreeRingBuffer<PBTYPE>(buffersize));
+            entry.mutex.reset();
+        } else {
+            entry.buffer = std::shared_ptr<RingBufferBase>(new RingBuffer<PBTYPE>(buffersize));
+            entry.mutex.reset(new std::mutex());
+        }
+        entry.datatype = &typeid(PBTYPE);
+        const std::shared_ptr<BufferedBytes> bytes = std::atomic_load(&entry.bytes);
+        if (bytes) {
+            // the new buffer is counted from zero
+            bytes->add(-bytes->bytes.load());
+            if (!entry.buffer->setByteLimit(entry.maxBytes, bytes)) {
+                std::atomic_store(&entry.bytes, std::shared_ptr<BufferedBytes>());
+            }
         }
-        std::shared_ptr<ProtobufToStringBase> conf = std::make_shared< ProtobufToString<PBTYPE> >(type, this);
 
-        converters[type] = conf;
+        Handle<PBTYPE> handle = getHandle<PBTYPE>(type);
+
+        // add to string converter
+        entry.converter = std::make_shared< ProtobufToString<PBTYPE> >(handle);
 
+        return handle;
     }
 
+ private:
+    struct Entry {
+        Entry() : datatype(nullptr), lazy(false), maxBytes(0) {}
+        std::shared_ptr<RingBufferBase> buffer;
+        // nullptr for lock-free buffers
+        std::unique_ptr<std::mutex> mutex;
+        const std::type_info* datatype;
+        bool lazy;
+        std::shared_ptr<ProtobufToStringBase> converter;
+        // nullptr if the bytes are not counted, accessed with std::atomic_load/store (read without the lock)
+        std::shared_ptr<BufferedBytes> bytes;
+        size_t maxBytes;
+    };
 
+    // starts counting the buffer of a locked entry
+    bool countBytes(Entry *entry);
+    void dropOverBudget(const size_t &budget);
 
- private:
-    std::vector< std::shared_ptr<ProtobufToStringBase> > converters;
+    std::vector<Entry> entries;
+    std::atomic<int64_t> totalBytes;
+    std::atomic<size_t> memoryBudget;
 };
 
 }  // namespace robot_remote_control
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+
+#include "MessageTypes.hpp"
+
+namespace robot_remote_control {
+
+/**
+ * @brief the latest serialized message of each telemetry type, shared with the send path.
+ * Replies to telemetry requests only take a reference to it, the message is neither copied nor serialized again.
+ */
+class TelemetryCache {
+ public:
+    typedef std::shared_ptr<const std::string> Payload;
+    // converts an encoded message to the serialized protobuf message (e.g. FixedLayout::serialize())
+    typedef void (*Serializer)(const std::string &encoded, std::string *serialized);
+
+    TelemetryCache() {
+        // pre-set size to minimize resizes in set()
+        entries.resize(TELEMETRY_MESSAGE_TYPES_NUMBER);
+    }
+
+    /**
+     * @brief serialize a message as the latest of its type
+     * @warning uses the cached size, ByteSizeLong() has to be called on the message before
+     *
+     * @param type the telemetry type
+     * @param message the message
+     * @param size the size returned by ByteSizeLong()
+     * @return Payload the serialized message
+     */
+    template <class PROTO> Payload set(const uint16_t &type, const PROTO &message, const size_t &size) {
+        std::shared_ptr<std::string> payload = takeSpare(type);
+        payload->resize(size);
+        if (size) {
+            message.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(&(*payload)[0]));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry &entry = entries[type];
+        entry.spare = std::move(entry.latest);
+        entry.latest = payload;
+        entry.serializer = nullptr;
+        return payload;
+    }
+
+    /**
+     * @brief keep an otherwise encoded message as the latest of its type, it is only serialized when it is requested by get()
+     *
+     * @param type the telemetry type
+     * @param data the encoded message
+     * @param size size of the encoded message
+     * @param serializer converts it to the serialized protobuf message
+     */
+    void setEncoded(const uint16_t &type, const void* data, const size_t &size, Serializer serializer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (type >= entries.size()) {
+            entries.resize(type + 1);
+        }
+        Entry &entry = entries[type];
+        // keeps the memory of the previous one
+        entry.encoded.assign(static_cast<const char*>(data), size);
+        entry.serializer = serializer;
+    }
+
+    /**
+     * @brief the latest message of the type
+     *
+     * @return Payload the serialized message, an empty string if there was none yet
+     */
+    Payload get(const uint16_t &type) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (type < entries.size()) {
+                Entry &entry = entries[type];
+                if (entry.serializer) {
+                    // serialized once for all requests until the next message is set
+                    std::shared_ptr<std::string> payload = std::make_shared<std::string>();
+                    entry.serializer(entry.encoded, payload.get());
+                    entry.spare = std::move(entry.latest);
+                    entry.latest = payload;
+                    entry.serializer = nullptr;
+                }
+                if (entry.latest) {
+                    return entry.latest;
+                }
+            }
+        }
+        static const Payload empty = std::make_shared<const std::string>();
+        return empty;
+    }
+
+    /**
+     * @brief true if a message of the type was set
+     */
+    bool contains(const uint16_t &type) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return type < entries.size() && (entries[type].latest || entries[type].serializer);
+    }
+
+ private:
+    struct Entry {
+        Entry():serializer(nullptr) {}
+        std::shared_ptr<std::string> latest;
+        // the previous latest, its memory is reused if no reply holds it anymore
+        std::shared_ptr<std::string> spare;
+        // set by setEncoded(), latest is outdated while there is a serializer
+        std::string encoded;
+        Serializer serializer;
+    };
+
+    std::shared_ptr<std::string> takeSpare(const uint16_t &type) {
+        std::shared_ptr<std::string> spare;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (type >= entries.size()) {
+                entries.resize(type + 1);
+            }
+            spare = std::move(entries[type].spare);
+        }
+        // the spare is not handed out anymore, so no new references can show up
+        if (!spare || spare.use_count() != 1) {
+            spare = std::make_shared<std::string>();
+        }
+        return spare;
+    }
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+};
+
+}  // namespace robot_remote_control
@@ -0,0 +1,338 @@
+#include "TelemetryLog.hpp"
+#include "RobotController/RobotController.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace robot_remote_control {
+
+namespace {
+    const size_t segmentHeaderSize = sizeof(TelemetryLogFormat::SegmentHeader);
+    const size_t frameHeaderSize = sizeof(TelemetryLogFormat::FrameHeader);
+
+    int64_t realtimeNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+std::string TelemetryLogFormat::segmentPath(const std::string &basePath, const uint32_t &segment) {
+    char number[16];
+    snprintf(number, sizeof(number), ".%06u", segment);
+    return basePath + number + ".rrclog";
+}
+
+std::string TelemetryLogFormat::indexPath(const std::string &basePath) {
+    return basePath + ".rrcidx";
+}
+
+TelemetryRecorder::TelemetryRecorder(const size_t &segmentSize, const uint32_t &indexInterval):
+    segmentSize(std::max(segmentSize, segmentHeaderSize + frameHeaderSize)),
+    indexInterval(indexInterval ? indexInterval : 1),
+    indexFile(nullptr),
+    fd(-1),
+    mapped(nullptr),
+    mappedSize(0),
+    used(0),
+    segment(0),
+    sequence(0),
+    segmentFrames(0) {}
+
+TelemetryRecorder::~TelemetryRecorder() {
+    close();
+}
+
+bool TelemetryRecorder::open(const std::string &path) {
+    close();
+    basePath = path;
+    indexFile = fopen(TelemetryLogFormat::indexPath(basePath).c_str(), "wb");
+    if (!indexFile) {
+        printf("unable to create the telemetry log index %s\n", TelemetryLogFormat::indexPath(basePath).c_str());
+        return false;
+    }
+    segment = 0;
+    sequence = 0;
+    // remove segments of an older log with the same name, a replay would continue with them
+    for (uint32_t old = 0; unlink(TelemetryLogFormat::segmentPath(basePath, old).c_str()) == 0; ++old) {}
+    if (!openSegment(0)) {
+        fclose(indexFile);
+        indexFile = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool TelemetryRecorder::openSegment(const size_t &minimumSize) {
+    mappedSize = std::max(segmentSize, segmentHeaderSize + minimumSize);
+    std::string path = TelemetryLogFormat::segmentPath(basePath, segment);
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, mappedSize) != 0) {
+        printf("unable to create the telemetry log segment %s: %s\n", path.c_str(), strerror(errno));
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        return false;
+    }
+    void* memory = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        printf("unable to map the telemetry log segment %s: %s\n", path.c_str(), strerror(errno));
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    mapped = static_cast<char*>(memory);
+
+    TelemetryLogFormat::SegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, TelemetryLogFormat::magic(), sizeof(header.magic));
+    header.version = TelemetryLogFormat::version;
+    header.headerSize = segmentHeaderSize;
+    header.segment = segment;
+    memcpy(mapped, &header, sizeof(header));
+    used = segmentHeaderSize;
+    segmentFrames = 0;
+    return true;
+}
+
+void TelemetryRecorder::closeSegment() {
+    if (fd < 0) {
+        return;
+    }
+    munmap(mapped, mappedSize);
+    mapped = nullptr;
+    // the zeroed rest is not needed to find the end
+    if (ftruncate(fd, used) != 0) {
+        printf("unable to truncate the telemetry log segment %u\n", segment);
+    }
+    ::close(fd);
+    fd = -1;
+}
+
+void TelemetryRecorder::addIndex(const uint64_t &offset, const int64_t &timeNs) {
+    TelemetryLogFormat::IndexEntry entry;
+    entry.segment = segment;
+    entry.reserved = 0;
+    entry.offset = offset;
+    entry.sequence = sequence;
+    entry.timeNs = timeNs;
+    fwrite(&entry, sizeof(entry), 1, indexFile);
+}
+
+bool TelemetryRecorder::record(const MessageView &message) {
+    return record(message, realtimeNs());
+}
+
+bool TelemetryRecorder::record(const MessageView &message, const int64_t &timeNs) {
+    if (fd < 0) {
+        return false;
+    }
+    const size_t frameSize = frameHeaderSize + message.size;
+    if (used + frameSize > mappedSize) {
+        closeSegment();
+        segment++;
+        // the index is complete up to the finished segment
+        fflush(indexFile);
+        if (!openSegment(frameSize)) {
+            return false;
+        }
+    }
+    if (segmentFrames == 0 || sequence % indexInterval == 0) {
+        addIndex(used, timeNs);
+    }
+
+    TelemetryLogFormat::FrameHeader header;
+    header.size = message.size;
+    header.reserved = 0;
+    header.sequence = sequence;
+    header.timeNs = timeNs;
+    char* frame = mapped + used;
+    memcpy(frame + sizeof(header.size), reinterpret_cast<const char*>(&header) + sizeof(header.size), frameHeaderSize - sizeof(header.size));
+    memcpy(frame + frameHeaderSize, message.data, message.size);
+    // the size is written last, a zero size ends the segment
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(frame, &header.size, sizeof(header.size));
+
+    used += frameSize;
+    sequence++;
+    segmentFrames++;
+    return true;
+}
+
+void TelemetryRecorder::close() {
+    closeSegment();
+    if (indexFile) {
+        fclose(indexFile);
+        indexFile = nullptr;
+    }
+}
+
+TelemetryReplay::TelemetryReplay():currentSegment(0), currentOffset(segmentHeaderSize) {}
+
+TelemetryReplay::~TelemetryReplay() {
+    close();
+}
+
+bool TelemetryReplay::open(const std::string &basePath) {
+    close();
+    for (uint32_t segment = 0;; ++segment) {
+        std::string path = TelemetryLogFormat::segmentPath(basePath, segment);
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            break;
+        }
+        struct stat status;
+        void* memory = MAP_FAILED;
+        if (fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= segmentHeaderSize) {
+            memory = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        // the mapping stays valid without the descriptor
+        ::close(fd);
+        if (memory == MAP_FAILED) {
+            printf("unable to map the telemetry log segment %s\n", path.c_str());
+            break;
+        }
+        TelemetryLogFormat::SegmentHeader header;
+        memcpy(&header, memory, sizeof(header));
+        if (strncmp(header.magic, TelemetryLogFormat::magic(), sizeof(header.magic)) != 0 || header.version != TelemetryLogFormat::version) {
+            printf("%s is not a telemetry log segment of version %u\n", path.c_str(), TelemetryLogFormat::version);
+            munmap(memory, status.st_size);
+            break;
+        }
+        Segment mappedSegment;
+        mappedSegment.data = static_cast<const char*>(memory);
+        mappedSegment.size = status.st_size;
+        segments.push_back(mappedSegment);
+    }
+
+    FILE* indexFile = fopen(TelemetryLogFormat::indexPath(basePath).c_str(), "rb");
+    if (indexFile) {
+        TelemetryLogFormat::IndexEntry entry;
+        while (fread(&entry, sizeof(entry), 1, indexFile) == 1) {
+            if (entry.segment < segments.size()) {
+                index.push_back(entry);
+            }
+        }
+        fclose(indexFile);
+    }
+    rewind();
+    return segments.size() > 0;
+}
+
+void TelemetryReplay::close() {
+    for (const Segment &segment : segments) {
+        munmap(const_cast<char*>(segment.data), segment.size);
+    }
+    segments.clear();
+    index.clear();
+    rewind();
+}
+
+void TelemetryReplay::rewind() {
+    currentSegment = 0;
+    currentOffset = segmentHeaderSize;
+}
+
+bool TelemetryReplay::readFrame(const size_t &segment, const size_t &offset, TelemetryLogFormat::FrameHeader *header) const {
+    if (segment >= segments.size() || offset + frameHeaderSize > segments[segment].size) {
+        return false;
+    }
+    memcpy(header, segments[segment].data + offset, frameHeaderSize);
+    return header->size > 0 && offset + frameHeaderSize + header->size <= segments[segment].size;
+}
+
+bool TelemetryReplay::next(MessageView *message, uint64_t *sequence, int64_t *timeNs) {
+    TelemetryLogFormat::FrameHeader header;
+    while (currentSegment < segments.size()) {
+        if (readFrame(currentSegment, currentOffset, &header)) {
+            *message = MessageView(segments[currentSegment].data + currentOffset + frameHeaderSize, header.size);
+            if (sequence) {
+                *sequence = header.sequence;
+            }
+            if (timeNs) {
+                *timeNs = header.timeNs;
+            }
+            currentOffset += frameHeaderSize + header.size;
+            return true;
+        }
+        // end of the segment
+        currentSegment++;
+        currentOffset = segmentHeaderSize;
+    }
+    return false;
+}
+
+bool TelemetryReplay::seek(const std::function<bool(const TelemetryLogFormat::FrameHeader &header)> &reached) {
+    rewind();
+    // the last index entry before the target, the entries are ordered
+    auto toHeader = [](const TelemetryLogFormat::IndexEntry &entry) {
+        TelemetryLogFormat::FrameHeader header;
+        header.size = 0;
+        header.reserved = 0;
+        header.sequence = entry.sequence;
+        header.timeNs = entry.timeNs;
+        return header;
+    };
+    auto first = std::partition_point(index.begin(), index.end(), [&](const TelemetryLogFormat::IndexEntry &entry) {
+        return !reached(toHeader(entry));
+    });
+    if (first != index.begin()) {
+        --first;
+        currentSegment = first->segment;
+        currentOffset = first->offset;
+    }
+
+    TelemetryLogFormat::FrameHeader header;
+    while (currentSegment < segments.size()) {
+        if (!readFrame(currentSegment, currentOffset, &header)) {
+            currentSegment++;
+            currentOffset = segmentHeaderSize;
+            continue;
+        }
+        if (reached(header)) {
+            return true;
+        }
+        currentOffset += frameHeaderSize + header.size;
+    }
+    return false;
+}
+
+bool TelemetryReplay::seekSequence(const uint64_t &sequence) {
+    return seek([&sequence](const TelemetryLogFormat::FrameHeader &header) { return header.sequence >= sequence; });
+}
+
+bool TelemetryReplay::seekTime(const int64_t &timeNs) {
+    return seek([&timeNs](const TelemetryLogFormat::FrameHeader &header) { return header.timeNs >= timeNs; });
+}
+
+uint64_t TelemetryReplay::replay(const std::function<void(const MessageView &message)> &sink, const double &speed, const uint64_t &maxMessages) {
+    uint64_t replayed = 0;
+    MessageView message;
+    int64_t timeNs;
+    int64_t firstTimeNs = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while ((maxMessages == 0 || replayed < maxMessages) && next(&message, nullptr, &timeNs)) {
+        if (replayed == 0) {
+            firstTimeNs = timeNs;
+        } else if (speed > 0 && timeNs > firstTimeNs) {
+            // relative to the first message, so the delays of the sink do not add up
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<int64_t>((timeNs - firstTimeNs) / speed)));
+        }
+        sink(message);
+        replayed++;
+    }
+    return replayed;
+}
+
+uint64_t TelemetryReplay::replay(RobotController *controller, const double &speed, const uint64_t &maxMessages) {
+    return replay([controller](const MessageView &message) { controller->injectTelemetry(message); }, speed, maxMessages);
+}
+
+}  // namespace robot_remote_control
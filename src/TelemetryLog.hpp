@@ -0,0 +1,218 @@
+#pragma once
+
+#include "Transports/Transport.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace robot_remote_control {
+
+class RobotController;
+
+/**
+ * @brief file format of the telemetry logs written by TelemetryRecorder and read by TelemetryReplay.
+ *
+ * A log consists of segment files (<base>.000000.rrclog, <base>.000001.rrclog, ...) and an index (<base>.rrcidx).
+ * Each segment starts with a SegmentHeader followed by frames: [FrameHeader][message as received].
+ * The size of a frame is written last, so a crashed recorder leaves a zero size (the end of the segment)
+ * instead of a partial frame. The index has an IndexEntry for the first frame of each segment and for
+ * every n-th frame, to seek by time or sequence without scanning the segments.
+ * All values are in host byte order.
+ */
+struct TelemetryLogFormat {
+    struct SegmentHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint32_t segment;
+        uint32_t reserved;
+    };
+
+    struct FrameHeader {
+        // size of the message, 0 marks the end of the segment
+        uint32_t size;
+        uint32_t reserved;
+        // counted over all segments
+        uint64_t sequence;
+        // receive time, ns since the epoch
+        int64_t timeNs;
+    };
+
+    struct IndexEntry {
+        uint32_t segment;
+        uint32_t reserved;
+        // of the FrameHeader in the segment
+        uint64_t offset;
+        uint64_t sequence;
+        int64_t timeNs;
+    };
+
+    enum : uint32_t { version = 1 };
+    static const char* magic() {
+        return "RRCTLOG";
+    }
+
+    static std::string segmentPath(const std::string &basePath, const uint32_t &segment);
+    static std::string indexPath(const std::string &basePath);
+};
+
+/**
+ * @brief appends the raw telemetry messages (as received by RobotController::update(), before they are parsed)
+ * to memory-mapped segment files, see RobotController::setTelemetryRecorder() and TelemetryReplay.
+ *
+ * A new segment is started when the current one is full, the segments are truncated to their used size when closed.
+ * record() is not thread-safe, it is called by the update thread of the controller.
+ */
+class TelemetryRecorder {
+ public:
+    /**
+     * @param segmentSize size of the segment files (larger messages get a segment of their size)
+     * @param indexInterval an index entry every indexInterval messages
+     */
+    explicit TelemetryRecorder(const size_t &segmentSize = 64 * 1024 * 1024, const uint32_t &indexInterval = 256);
+    ~TelemetryRecorder();
+    TelemetryRecorder(const TelemetryRecorder&) = delete;
+    TelemetryRecorder& operator=(const TelemetryRecorder&) = delete;
+
+    /**
+     * @brief start a log, existing files of the log are replaced
+     *
+     * @param basePath path and name of the log files without extension
+     * @return false if the files could not be created
+     */
+    bool open(const std::string &basePath);
+
+    /**
+     * @brief record a message with the current time
+     */
+    bool record(const MessageView &message);
+
+    /**
+     * @brief record a message
+     *
+     * @param timeNs receive time in ns since the epoch
+     * @return false if the log is not open or the segment could not be created
+     */
+    bool record(const MessageView &message, const int64_t &timeNs);
+
+    /**
+     * @brief finish the log, called by the destructor
+     */
+    void close();
+
+    bool isOpen() const {
+        return fd >= 0;
+    }
+
+    /**
+     * @brief number of messages recorded since open()
+     */
+    uint64_t getRecorded() const {
+        return sequence;
+    }
+
+ private:
+    bool openSegment(const size_t &minimumSize);
+    void closeSegment();
+    void addIndex(const uint64_t &offset, const int64_t &timeNs);
+
+    size_t segmentSize;
+    uint32_t indexInterval;
+    std::string basePath;
+    FILE* indexFile;
+
+    int fd;
+    char* mapped;
+    size_t mappedSize;
+    size_t used;
+    uint32_t segment;
+    uint64_t sequence;
+    uint64_t segmentFrames;
+};
+
+/**
+ * @brief reads the logs of TelemetryRecorder and replays them into a RobotController (or any other sink)
+ * in real time, scaled or as fast as possible, e.g. for reproducible load tests of the controller side.
+ */
+class TelemetryReplay {
+ public:
+    TelemetryReplay();
+    ~TelemetryReplay();
+    TelemetryReplay(const TelemetryReplay&) = delete;
+    TelemetryReplay& operator=(const TelemetryReplay&) = delete;
+
+    /**
+     * @brief map all segments of a log read-only
+     *
+     * @param basePath the path given to TelemetryRecorder::open()
+     * @return false if there is no valid segment
+     */
+    bool open(const std::string &basePath);
+
+    void close();
+
+    /**
+     * @brief read the next message
+     *
+     * @param message view into the mapped log, valid until close()
+     * @param sequence the sequence of the message, may be nullptr
+     * @param timeNs the receive time of the message, may be nullptr
+     * @return false at the end of the log
+     */
+    bool next(MessageView *message, uint64_t *sequence = nullptr, int64_t *timeNs = nullptr);
+
+    /**
+     * @brief continue with the first message
+     */
+    void rewind();
+
+    /**
+     * @brief continue with the first message with a sequence >= sequence
+     *
+     * @return false if there is no such message (at the end of the log then)
+     */
+    bool seekSequence(const uint64_t &sequence);
+
+    /**
+     * @brief continue with the first message received at or after timeNs
+     *
+     * @return false if there is no such message (at the end of the log then)
+     */
+    bool seekTime(const int64_t &timeNs);
+
+    /**
+     * @brief replay the messages from the current position
+     *
+     * @param sink called with each message
+     * @param speed 1 for real time, 2 for twice as fast, 0 for as fast as possible
+     * @param maxMessages stop after this number of messages, 0 for all
+     * @return uint64_t number of replayed messages
+     */
+    uint64_t replay(const std::function<void(const MessageView &message)> &sink, const double &speed = 1, const uint64_t &maxMessages = 0);
+
+    /**
+     * @brief replay the messages into a controller as if it received them (RobotController::injectTelemetry()),
+     * the update thread of the controller should not run meanwhile
+     */
+    uint64_t replay(RobotController *controller, const double &speed = 1, const uint64_t &maxMessages = 0);
+
+ private:
+    struct Segment {
+        const char* data;
+        size_t size;
+    };
+
+    bool readFrame(const size_t &segment, const size_t &offset, TelemetryLogFormat::FrameHeader *header) const;
+    // continue at the index entry before the first frame accepted by reached, then scan
+    bool seek(const std::function<bool(const TelemetryLogFormat::FrameHeader &header)> &reached);
+
+    std::vector<Segment> segments;
+    std::vector<TelemetryLogFormat::IndexEntry> index;
+    size_t currentSegment;
+    size_t currentOffset;
+};
+
+}  // namespace robot_remote_control
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef RRC_USDT
+    #include <sys/sdt.h>
+#endif
+
+namespace robot_remote_control {
+
+/**
+ * @brief trace points in the hot paths of the controller and the robot, to profile running systems without recompiling.
+ *
+ * Each point carries the message type and size. A Hook set by setHook() is called for each point, without a hook
+ * a trace point costs a relaxed atomic load. If the library is compiled with RRC_USDT, each point is also a
+ * USDT probe robot_remote_control:trace(point, type, size) for perf, bpftrace or systemtap
+ * (a nop instruction while no tracer is attached).
+ * The trace points are removed completely if the library is compiled with RRC_DISABLE_TRACING.
+ */
+class Tracing {
+ public:
+    enum Point : uint8_t {
+        // RobotController::update(), the size as received, the type is not parsed yet (NO_TELEMETRY_DATA)
+        TELEMETRY_RECEIVED,
+        // RobotController::evaluateTelemetry()
+        TELEMETRY_PARSE_START,
+        TELEMETRY_PARSE_END,
+        // ControlledRobot::evaluateRequest()
+        REQUEST_PARSE_START,
+        REQUEST_PARSE_END,
+        // ControlledRobot::sendTelemetry(), the payload size and the bytes sent
+        TELEMETRY_SERIALIZED,
+        TELEMETRY_SENT,
+        // RobotController::sendRequest(), from the send until the reply (size) is received
+        REQUEST_WAIT_START,
+        REQUEST_WAIT_END,
+        // a telemetry or command callback is called
+        CALLBACK_DISPATCH,
+        // a received message was dropped or replaced an unread one in its full buffer, the size is the capacity,
+        // only checked while a hook is set
+        BUFFER_DROP,
+        POINT_NUMBER
+    };
+
+    class Hook {
+     public:
+        virtual ~Hook() {}
+        /**
+         * @brief called in the thread passing the point, has to be thread-safe and fast
+         */
+        virtual void trace(const Point &point, const uint16_t &type, const size_t &size) = 0;
+    };
+
+    /**
+     * @brief set the hook called by all trace points
+     *
+     * @param hook the hook, not owned, nullptr to disable. A replaced hook may still be called by trace points
+     * passed concurrently, so it should not be deleted right away (e.g. keep it static).
+     */
+    static void setHook(Hook* hook) {
+        slot().store(hook, std::memory_order_release);
+    }
+
+    static Hook* getHook() {
+        return slot().load(std::memory_order_acquire);
+    }
+
+    static bool enabled() {
+        return __builtin_expect(slot().load(std::memory_order_relaxed) != nullptr, 0);
+    }
+
+    static void emit(const Point &point, const uint16_t &type, const size_t &size) {
+        Hook* hook = slot().load(std::memory_order_acquire);
+        if (hook) {
+            hook->trace(point, type, size);
+        }
+    }
+
+    static const char* name(const Point &point) {
+        static const char* names[POINT_NUMBER] = {
+            "telemetry_received", "telemetry_parse_start", "telemetry_parse_end", "request_parse_start", "request_parse_end",
+            "telemetry_serialized", "telemetry_sent", "request_wait_start", "request_wait_end", "callback_dispatch", "buffer_drop"};
+        return point < POINT_NUMBER ? names[point] : "unknown";
+    }
+
+    /**
+     * @brief passes a start point on construction and the end point when leaving the scope (on any return)
+     */
+    class Scope {
+     public:
+        Scope(const Point &start, const Point &end, const uint16_t &type, const size_t &size):end(end), type(type), size(size) {
+            trace(start, type, size);
+        }
+        ~Scope() {
+            trace(end, type, size);
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        static void trace(const Point &point, const uint16_t &type, const size_t &size) {
+            #ifdef RRC_USDT
+                DTRACE_PROBE3(robot_remote_control, trace, point, type, size);
+            #endif
+            if (enabled()) {
+                emit(point, type, size);
+            }
+        }
+
+     private:
+        Point end;
+        uint16_t type;
+        size_t size;
+    };
+
+ private:
+    // shared by all libraries of the process
+    static std::atomic<Hook*>& slot() {
+        static std::atomic<Hook*> hook(nullptr);
+        return hook;
+    }
+};
+
+}  // namespace robot_remote_control
+
+#ifndef RRC_DISABLE_TRACING
+    #define RRC_TRACE(POINT, TYPE, SIZE) robot_remote_control::Tracing::Scope::trace(robot_remote_control::Tracing::POINT, TYPE, SIZE)
+    #define RRC_TRACE_SCOPE(START, END, TYPE, SIZE) \
+        robot_remote_control::Tracing::Scope rrcTraceScope(robot_remote_control::Tracing::START, robot_remote_control::Tracing::END, TYPE, SIZE)
+#else
+    #define RRC_TRACE(POINT, TYPE, SIZE) do {} while (0)
+    #define RRC_TRACE_SCOPE(START, END, TYPE, SIZE) do {} while (0)
+#endif
@@ -0,0 +1,303 @@
+#include "TransformTree.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+namespace robot_remote_control {
+
+namespace {
+    struct Quaternion {
+        double x, y, z, w;
+    };
+
+    // an unset orientation (all zero) is the identity
+    Quaternion toQuaternion(const Orientation &orientation) {
+        Quaternion q = {orientation.x(), orientation.y(), orientation.z(), orientation.w()};
+        double norm = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        if (norm == 0) {
+            return {0, 0, 0, 1};
+        }
+        return {q.x / norm, q.y / norm, q.z / norm, q.w / norm};
+    }
+
+    void setOrientation(const Quaternion &q, Orientation *orientation) {
+        orientation->set_x(q.x);
+        orientation->set_y(q.y);
+        orientation->set_z(q.z);
+        orientation->set_w(q.w);
+    }
+
+    Quaternion multiply(const Quaternion &a, const Quaternion &b) {
+        return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+                a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+    }
+
+    Quaternion conjugate(const Quaternion &q) {
+        return {-q.x, -q.y, -q.z, q.w};
+    }
+
+    void rotate(const Quaternion &q, const Position &position, double *x, double *y, double *z) {
+        Quaternion v = {position.x(), position.y(), position.z(), 0};
+        Quaternion rotated = multiply(multiply(q, v), conjugate(q));
+        *x = rotated.x;
+        *y = rotated.y;
+        *z = rotated.z;
+    }
+
+    double dot(const Quaternion &a, const Quaternion &b) {
+        return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    }
+
+    Quaternion slerp(const Quaternion &a, Quaternion b, const double &factor) {
+        double cosAngle = dot(a, b);
+        // the shorter way
+        if (cosAngle < 0) {
+            b = {-b.x, -b.y, -b.z, -b.w};
+            cosAngle = -cosAngle;
+        }
+        double wa = 1 - factor;
+        double wb = factor;
+        if (cosAngle < 0.9995) {
+            double angle = std::acos(cosAngle);
+            double sinAngle = std::sin(angle);
+            wa = std::sin((1 - factor) * angle) / sinAngle;
+            wb = std::sin(factor * angle) / sinAngle;
+        }
+        // nearly parallel: linear, normalized below
+        Quaternion q = {wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z, wa * a.w + wb * b.w};
+        double norm = std::sqrt(dot(q, q));
+        return {q.x / norm, q.y / norm, q.z / norm, q.w / norm};
+    }
+}
+
+TransformTree::TransformTree(const size_t &historySize):historySize(std::max<size_t>(1, historySize)) {}
+
+TimeStamp TransformTree::fromNs(const int64_t &ns) {
+    TimeStamp time;
+    time.set_secs(ns / 1000000000LL);
+    time.set_nsecs(ns % 1000000000LL);
+    return time;
+}
+
+Pose TransformTree::compose(const Pose &a, const Pose &b) {
+    Quaternion qa = toQuaternion(a.orientation());
+    double x, y, z;
+    rotate(qa, b.position(), &x, &y, &z);
+    Pose result;
+    result.mutable_position()->set_x(a.position().x() + x);
+    result.mutable_position()->set_y(a.position().y() + y);
+    result.mutable_position()->set_z(a.position().z() + z);
+    setOrientation(multiply(qa, toQuaternion(b.orientation())), result.mutable_orientation());
+    return result;
+}
+
+Pose TransformTree::inverse(const Pose &pose) {
+    Quaternion q = conjugate(toQuaternion(pose.orientation()));
+    double x, y, z;
+    rotate(q, pose.position(), &x, &y, &z);
+    Pose result;
+    result.mutable_position()->set_x(-x);
+    result.mutable_position()->set_y(-y);
+    result.mutable_position()->set_z(-z);
+    setOrientation(q, result.mutable_orientation());
+    return result;
+}
+
+Pose TransformTree::interpolate(const Pose &a, const Pose &b, const double &factor) {
+    Pose result;
+    result.mutable_position()->set_x(a.position().x() + (b.position().x() - a.position().x()) * factor);
+    result.mutable_position()->set_y(a.position().y() + (b.position().y() - a.position().y()) * factor);
+    result.mutable_position()->set_z(a.position().z() + (b.position().z() - a.position().z()) * factor);
+    setOrientation(slerp(toQuaternion(a.orientation()), toQuaternion(b.orientation()), factor), result.mutable_orientation());
+    return result;
+}
+
+void TransformTree::add(const Transforms &transforms, const bool &isStatic) {
+    for (const Transform &transform : transforms.transform()) {
+        add(transform, isStatic);
+    }
+}
+
+void TransformTree::add(const Transform &transform, const bool &isStatic) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Frames frames(transform.from(), transform.to());
+    auto edge = edges.find(frames);
+    if (edge == edges.end()) {
+        edge = edges.insert(std::make_pair(frames, Edge())).first;
+        neighbours[transform.from()].push_back(transform.to());
+        neighbours[transform.to()].push_back(transform.from());
+    }
+    Edge &entry = edge->second;
+    entry.isStatic = isStatic;
+    if (isStatic) {
+        entry.history.clear();
+    } else if (!entry.history.empty() && toNs(transform.timestamp()) < toNs(entry.history.back().timestamp())) {
+        // out of order, the history stays sorted
+        return;
+    }
+    entry.history.push_back(transform);
+    while (entry.history.size() > historySize) {
+        entry.history.pop_front();
+    }
+}
+
+bool TransformTree::sample(const Edge &edge, const int64_t &timeNs, Pose *pose, int64_t *sampleTimeNs) const {
+    if (edge.history.empty()) {
+        return false;
+    }
+    if (edge.isStatic || timeNs == 0) {
+        *pose = edge.history.back().transform();
+        *sampleTimeNs = edge.isStatic ? 0 : toNs(edge.history.back().timestamp());
+        return true;
+    }
+    auto after = std::lower_bound(edge.history.begin(), edge.history.end(), timeNs, [](const Transform &transform, const int64_t &time) {
+        return toNs(transform.timestamp()) < time;
+    });
+    if (after == edge.history.end()) {
+        // no extrapolation
+        return false;
+    }
+    const int64_t afterNs = toNs(after->timestamp());
+    if (afterNs == timeNs) {
+        *pose = after->transform();
+    } else if (after == edge.history.begin()) {
+        return false;
+    } else {
+        auto before = after - 1;
+        const int64_t beforeNs = toNs(before->timestamp());
+        *pose = interpolate(before->transform(), after->transform(), static_cast<double>(timeNs - beforeNs) / (afterNs - beforeNs));
+    }
+    *sampleTimeNs = timeNs;
+    return true;
+}
+
+std::vector<std::string> TransformTree::findPath(const std::string &from, const std::string &to) const {
+    // breadth-first, the trees are small
+    std::map<std::string, std::string> previous;
+    std::queue<std::string> open;
+    previous[from] = from;
+    open.push(from);
+    while (!open.empty()) {
+        std::string frame = open.front();
+        open.pop();
+        if (frame == to) {
+            std::vector<std::string> path;
+            for (std::string current = to; current != from; current = previous[current]) {
+                path.push_back(current);
+            }
+            path.push_back(from);
+            std::reverse(path.begin(), path.end());
+            return path;
+        }
+        auto next = neighbours.find(frame);
+        if (next == neighbours.end()) {
+            continue;
+        }
+        for (const std::string &neighbour : next->second) {
+            if (previous.insert(std::make_pair(neighbour, frame)).second) {
+                open.push(neighbour);
+            }
+        }
+    }
+    return std::vector<std::string>();
+}
+
+bool TransformTree::lookup(const std::string &from, const std::string &to, const TimeStamp &time, Transform *result) {
+    const int64_t timeNs = toNs(time);
+    Pose chained;
+    chained.mutable_orientation()->set_w(1);
+    int64_t oldestNs = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> path = findPath(from, to);
+        if (path.empty()) {
+            return false;
+        }
+        for (size_t i = 0; i + 1 < path.size(); ++i) {
+            auto forward = edges.find(Frames(path[i], path[i + 1]));
+            bool inverted = forward == edges.end();
+            const Edge &edge = inverted ? edges.find(Frames(path[i + 1], path[i]))->second : forward->second;
+            Pose pose;
+            int64_t sampleNs;
+            if (!sample(edge, timeNs, &pose, &sampleNs)) {
+                return false;
+            }
+            if (sampleNs && (!oldestNs || sampleNs < oldestNs)) {
+                oldestNs = sampleNs;
+            }
+            chained = compose(chained, inverted ? inverse(pose) : pose);
+        }
+    }
+    result->Clear();
+    *result->mutable_transform() = chained;
+    result->set_from(from);
+    result->set_to(to);
+    *result->mutable_timestamp() = fromNs(timeNs ? timeNs : oldestNs);
+    return true;
+}
+
+std::vector<std::string> TransformTree::getFrames() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> frames;
+    for (const auto &frame : neighbours) {
+        frames.push_back(frame.first);
+    }
+    return frames;
+}
+
+size_t TransformTree::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return edges.size();
+}
+
+void TransformTree::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    edges.clear();
+    neighbours.clear();
+}
+
+TransformChangeFilter::TransformChangeFilter(const double &positionTolerance, const double &angleTolerance):
+    positionTolerance(positionTolerance), angleTolerance(angleTolerance) {}
+
+void TransformChangeFilter::setTolerance(const double &positionTolerance, const double &angleTolerance) {
+    this->positionTolerance = positionTolerance;
+    this->angleTolerance = angleTolerance;
+}
+
+bool TransformChangeFilter::changed(const Pose &last, const Pose &current) const {
+    if (positionTolerance == 0 && angleTolerance == 0) {
+        // exact, the rounding of the angle would report unchanged poses
+        return last.position().x() != current.position().x() || last.position().y() != current.position().y() ||
+               last.position().z() != current.position().z() || last.orientation().x() != current.orientation().x() ||
+               last.orientation().y() != current.orientation().y() || last.orientation().z() != current.orientation().z() ||
+               last.orientation().w() != current.orientation().w() || last.orientation2d() != current.orientation2d();
+    }
+    const double dx = current.position().x() - last.position().x();
+    const double dy = current.position().y() - last.position().y();
+    const double dz = current.position().z() - last.position().z();
+    if (std::sqrt(dx * dx + dy * dy + dz * dz) > positionTolerance) {
+        return true;
+    }
+    // angle between the orientations
+    const double cosHalfAngle = std::min(1.0, std::fabs(dot(toQuaternion(last.orientation()), toQuaternion(current.orientation()))));
+    return 2 * std::acos(cosHalfAngle) > angleTolerance;
+}
+
+int TransformChangeFilter::filter(const Transforms &transforms, Transforms *changedTransforms) {
+    int count = 0;
+    for (const Transform &transform : transforms.transform()) {
+        auto last = lastPassed.find(std::make_pair(transform.from(), transform.to()));
+        if (last != lastPassed.end() && !changed(last->second, transform.transform())) {
+            continue;
+        }
+        *changedTransforms->add_transform() = transform;
+        lastPassed[std::make_pair(transform.from(), transform.to())] = transform.transform();
+        count++;
+    }
+    return count;
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "MessageTypes.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief controller-side index of received transforms by their frames, with a time history per transform.
+ *
+ * A Transform is the pose of the frame "to" in the frame "from" (as in ROS tf). lookup() chains the transforms
+ * between two frames (in both directions) and interpolates each one at the requested time, so UIs can query
+ * poses of any frame at any time within the history without scanning the received lists.
+ * Static transforms (STATIC_TRANSFORMS) have no history and are valid at all times.
+ */
+class TransformTree {
+ public:
+    /**
+     * @param historySize number of transforms kept per pair of frames
+     */
+    explicit TransformTree(const size_t &historySize = 100);
+
+    /**
+     * @brief add transforms, a transform older than the latest of its frames is dropped
+     *
+     * @param isStatic the transforms do not change (e.g. of the robot model), they replace the older ones
+     */
+    void add(const Transforms &transforms, const bool &isStatic = false);
+
+    void add(const Transform &transform, const bool &isStatic = false);
+
+    /**
+     * @brief the pose of the frame "to" in the frame "from" at a time
+     *
+     * @param time the time, zero for the latest transforms
+     * @param result the chained transform, with the requested time (or the oldest of the used latest transforms)
+     * @return false if the frames are not connected or time is outside of the history of a used transform
+     */
+    bool lookup(const std::string &from, const std::string &to, const TimeStamp &time, Transform *result);
+
+    /**
+     * @brief lookup() of the latest transforms
+     */
+    bool lookup(const std::string &from, const std::string &to, Transform *result) {
+        return lookup(from, to, TimeStamp(), result);
+    }
+
+    std::vector<std::string> getFrames();
+
+    /**
+     * @brief the number of pairs of frames
+     */
+    size_t size();
+
+    void clear();
+
+    static int64_t toNs(const TimeStamp &time) {
+        return static_cast<int64_t>(time.secs()) * 1000000000LL + time.nsecs();
+    }
+
+    static TimeStamp fromNs(const int64_t &ns);
+
+    /**
+     * @brief a followed by b, the pose of b's child frame in a's parent frame
+     */
+    static Pose compose(const Pose &a, const Pose &b);
+
+    static Pose inverse(const Pose &pose);
+
+    /**
+     * @brief linear interpolation of the positions and slerp of the orientations, factor 0 is a, 1 is b
+     */
+    static Pose interpolate(const Pose &a, const Pose &b, const double &factor);
+
+ private:
+    typedef std::pair<std::string, std::string> Frames;
+
+    struct Edge {
+        Edge():isStatic(false) {}
+        bool isStatic;
+        // ordered by time, oldest first
+        std::deque<Transform> history;
+    };
+
+    /**
+     * @brief the pose of an edge at a time (0 for the latest)
+     */
+    bool sample(const Edge &edge, const int64_t &timeNs, Pose *pose, int64_t *sampleTimeNs) const;
+
+    /**
+     * @brief the frames from "from" to "to" (both included), empty if not connected
+     */
+    std::vector<std::string> findPath(const std::string &from, const std::string &to) const;
+
+    size_t historySize;
+    std::mutex mutex;
+    std::map<Frames, Edge> edges;
+    // both directions of each edge
+    std::map<std::string, std::vector<std::string> > neighbours;
+};
+
+/**
+ * @brief robot-side filter passing only the transforms that changed since they were last passed,
+ * so of a large tree with few moving frames only the moving ones are sent (ControlledRobot::setChangedTransforms())
+ */
+class TransformChangeFilter {
+ public:
+    /**
+     * @param positionTolerance changes of the position up to this distance are ignored
+     * @param angleTolerance changes of the orientation up to this angle (in radians) are ignored
+     */
+    explicit TransformChangeFilter(const double &positionTolerance = 0, const double &angleTolerance = 0);
+
+    void setTolerance(const double &positionTolerance, const double &angleTolerance);
+
+    /**
+     * @brief append the transforms to changed that differ from the last passed transform of their frames
+     *
+     * @return int number of changed transforms
+     */
+    int filter(const Transforms &transforms, Transforms *changed);
+
+    /**
+     * @brief pass all transforms again (e.g. when a controller connected)
+     */
+    void reset() {
+        lastPassed.clear();
+    }
+
+ private:
+    bool changed(const Pose &last, const Pose &current) const;
+
+    double positionTolerance;
+    double angleTolerance;
+    std::map<std::pair<std::string, std::string>, Pose> lastPassed;
+};
+
+}  // namespace robot_remote_control
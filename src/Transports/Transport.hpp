@@ -1,41 +1,300 @@
-#pragma once 
+#pragma once
 
 #include <string>
 #include <memory>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <chrono>
 
 namespace robot_remote_control
 {
 
-    
+    /**
+     * @brief non-owning view on (a part of) a message, the memory is owned by a string or the transport
+     */
+    struct MessageView {
+        MessageView() : data(nullptr), size(0) {}
+        MessageView(const char* data, const size_t &size) : data(data), size(size) {}
+        // implicit on purpose, so functions taking views also accept strings
+        MessageView(const std::string &buf) : data(buf.data()), size(buf.size()) {}  // NOLINT
+
+        /**
+         * @brief get a view on the data behind offset (e.g. the payload behind a header)
+         *
+         * @param offset number of bytes to skip
+         * @return MessageView empty view if offset is bigger than the size
+         */
+        MessageView sub(const size_t &offset) const {
+            if (offset >= size) {
+                return MessageView(data + size, 0);
+            }
+            return MessageView(data + offset, size - offset);
+        }
+
+        /**
+         * @brief read a trivially copyable value (e.g. a type header) at offset
+         */
+        template <class VALUE> VALUE get(const size_t &offset = 0) const {
+            VALUE value;
+            memcpy(&value, data + offset, sizeof(VALUE));
+            return value;
+        }
+
+        std::string toString() const {
+            return std::string(data, size);
+        }
+
+        const char* data;
+        size_t size;
+    };
+
+    /**
+     * @brief Buffer to receive messages without copying them out of the transport memory.
+     * The memory is owned by a transport specific storage in this buffer, which is reused on subsequent receives.
+     * So the view is only valid until the next receive into the same buffer.
+     */
+    class ReceiveBuffer {
+     public:
+        /**
+         * @brief base for the transport specific storage (e.g. a zmq::message_t)
+         */
+        struct Storage {
+            virtual ~Storage() {}
+        };
+
+        ReceiveBuffer() {}
+        virtual ~ReceiveBuffer() {}
+
+        /**
+         * @brief Get the transport specific storage, it is (re-)created if it is not of the requested type
+         * @warning should only be used by Transport implementations
+         */
+        template <class STORAGE> STORAGE* getStorage() {
+            STORAGE* typedStorage = dynamic_cast<STORAGE*>(storage.get());
+            if (!typedStorage) {
+                typedStorage = new STORAGE();
+                storage.reset(typedStorage);
+            }
+            return typedStorage;
+        }
+
+        void setView(const char* data, const size_t &size) {
+            messageview = MessageView(data, size);
+        }
+
+        const MessageView& view() const {
+            return messageview;
+        }
+
+        const char* data() const {
+            return messageview.data;
+        }
+
+        size_t size() const {
+            return messageview.size;
+        }
+
+        // no copy constructors, the view points into the storage
+        ReceiveBuffer(const ReceiveBuffer&) = delete;
+        ReceiveBuffer& operator=(const ReceiveBuffer&) = delete;
+
+     private:
+        std::unique_ptr<Storage> storage;
+        MessageView messageview;
+    };
 
     class Transport{
-        public: 
-        
+        public:
+
         enum Flags {NONE = 0x0, NOBLOCK = 0x1};
 
+        /**
+         * @brief function writing a payload of a known size directly into the send buffer
+         * (e.g. using protobufs SerializeWithCachedSizesToArray())
+         */
+        typedef std::function<void(char* target)> PayloadWriter;
+
         Transport(){};
         virtual ~Transport(){};
 
         /**
          * @brief send date
-         * 
+         *
          * @param buf the buffer to send
          * @param Flags flags the flags
          * @return int number of bytes sent
          */
         virtual int send(const std::string& buf, Flags flags = NONE) = 0;
 
+        /**
+         * @brief send a message consisting of a header and a payload that is written by the payloadWriter
+         * directly into the memory that is sent. In the default implementation this is a buffer of this
+         * transport, which is reused for every message.
+         *
+         * @param header the header to put in front of the payload
+         * @param payloadSize size of the payload in bytes
+         * @param writePayload function to write exactly payloadSize bytes to the target
+         * @param Flags flags the flags
+         * @return int number of bytes sent (including the header)
+         */
+        virtual int send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags = NONE) {
+            std::lock_guard<std::mutex> lock(sendBufferMutex);
+            // keeps its capacity, so there is no allocation once the buffer was big enough
+            sendBuffer.resize(header.size + payloadSize);
+            if (header.size) {
+                memcpy(&sendBuffer[0], header.data, header.size);
+            }
+            if (payloadSize && writePayload) {
+                writePayload(&sendBuffer[header.size]);
+            }
+            return send(sendBuffer, flags);
+        }
+
+        /**
+         * @brief send a message from header and payload without joining them in the calling code
+         *
+         * @param header the header to put in front of the payload
+         * @param payload the payload
+         * @param Flags flags the flags
+         * @return int number of bytes sent (including the header)
+         */
+        int send(const MessageView &header, const MessageView &payload, Flags flags = NONE) {
+            return send(header, payload.size, [&payload](char* target) {
+                memcpy(target, payload.data, payload.size);
+            }, flags);
+        }
+
         /**
          * @brief receive data
-         * 
+         *
          * @param buf buffer to fill on receive
          * @param Flags flags the flags
          * @return int 0 if no data received, size of data otherwise
          */
         virtual int receive(std::string* buf, Flags flags = NONE) = 0;
 
+        /**
+         * @brief receive data into a buffer owned by the transport, which avoids copies for transports
+         * overriding this function. The default implementation receives into a string which is reused.
+         *
+         * @param buf buffer to receive into, buf->view() is valid until the next receive into buf
+         * @param Flags flags the flags
+         * @return int 0 if no data received, size of data otherwise
+         */
+        virtual int receive(ReceiveBuffer* buf, Flags flags = NONE) {
+            StringStorage* storage = buf->getStorage<StringStorage>();
+            int received = receive(&storage->buffer, flags);
+            if (received) {
+                buf->setView(storage->buffer.data(), storage->buffer.size());
+            } else {
+                buf->setView(nullptr, 0);
+            }
+            return received;
+        }
+
+        /**
+         * @brief reserve memory, so sending and receiving messages up to this size does not allocate (e.g. for real-time loops).
+         * The default implementation reserves the reused send buffer and the string storage of buf,
+         * transports receiving into their own storage should override this
+         *
+         * @param buf the buffer that will be used with receive(), may be nullptr
+         * @param bytes size of the largest expected message
+         */
+        virtual void preallocate(ReceiveBuffer* buf, const size_t &bytes) {
+            if (buf) {
+                buf->getStorage<StringStorage>()->buffer.reserve(bytes);
+            }
+            std::lock_guard<std::mutex> lock(sendBufferMutex);
+            sendBuffer.reserve(bytes);
+        }
+
+        /**
+         * @brief block until there is data to receive or the timeout expired
+         * The default implementation just waits the timeout, so transports not overriding this are polled periodically
+         * @warning should be called from the thread that is receiving
+         *
+         * @param timeoutMs maximum time to wait in milliseconds
+         * @return true if there is data to receive (or might be in the default implementation)
+         */
+        virtual bool waitForData(const unsigned int &timeoutMs) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+            return true;
+        }
+
+        /**
+         * @brief only receive messages starting with topic, on transports that support filtering on the sender side.
+         * By default all messages are received, the first subscribe() removes this default.
+         * @warning should be called from the thread that is receiving
+         *
+         * @param topic the prefix of the messages to receive
+         * @return true if the transport supports filtering
+         */
+        virtual bool subscribe(const std::string &topic) {
+            return false;
+        }
+
+        /**
+         * @brief remove a subscription added by subscribe()
+         *
+         * @param topic the prefix used in subscribe()
+         * @return true if the transport supports filtering
+         */
+        virtual bool unsubscribe(const std::string &topic) {
+            return false;
+        }
+
+        /**
+         * @brief the peer of the last received message, on transports with several peers (e.g. TransportZmq::ROUTER)
+         * @warning should be called from the thread that is receiving
+         *
+         * @return std::string an opaque id of the peer, empty if the transport has a single peer
+         */
+        virtual std::string getPeer() {
+            return std::string();
+        }
+
+        /**
+         * @brief send the following messages to a peer returned by getPeer(), e.g. a reply deferred while requests of
+         * other peers were received. Receiving selects the peer of the received message again.
+         * @warning should be called from the thread that is receiving
+         *
+         * @return false if the transport has a single peer
+         */
+        virtual bool setPeer(const std::string &peer) {
+            return false;
+        }
+
+        /**
+         * @brief a peer returned by getPeer() is gone (e.g. its client session expired), the transport may drop
+         * the state it keeps for it. A later message of the peer is received as from a new peer.
+         * @warning should be called from the thread that is receiving
+         */
+        virtual void releasePeer(const std::string &peer) {}
+
+        /**
+         * @brief adapt the compression of compressing transports between the configured level (0) and the
+         * best compression (1), e.g. by the BandwidthGovernor when the link gets slow
+         *
+         * @param effort 0-1
+         * @return true if the transport compresses and supports changing the level
+         */
+        virtual bool setCompressionEffort(const float &effort) {
+            return false;
+        }
+
+        protected:
+        struct StringStorage : public ReceiveBuffer::Storage {
+            std::string buffer;
+        };
+
+        private:
+        std::string sendBuffer;
+        std::mutex sendBufferMutex;
+
     };
 
     typedef std::shared_ptr<Transport> TransportSharedPtr;
 
-}
\ No newline at end of file
+}
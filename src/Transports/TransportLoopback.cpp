@@ -0,0 +1,215 @@
+#include "TransportLoopback.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace robot_remote_control
+{
+
+/**
+ * @brief bounded queue of many producers and consumers (D. Vyukov): each cell has a sequence number telling
+ * whether it is free for the enqueue position or written for the dequeue position
+ */
+class TransportLoopback::Queue {
+ public:
+    explicit Queue(const size_t &capacity):enqueuePosition(0), dequeuePosition(0), waiting(0), closed(false) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        cells = std::vector<Cell>(size);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief false if the queue is full
+     */
+    bool push(const std::function<void(std::string *target)> &write) {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[position & mask];
+            const intptr_t difference = static_cast<intptr_t>(cell->sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        write(&cell->data);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        notify();
+        return true;
+    }
+
+    /**
+     * @brief swap the oldest message with buf, false if the queue is empty
+     */
+    bool pop(std::string *buf) {
+        size_t position = dequeuePosition.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[position & mask];
+            const intptr_t difference = static_cast<intptr_t>(cell->sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(position + 1);
+            if (difference == 0) {
+                if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        // the former buffer of the receiver is reused by the next sender of this cell
+        buf->swap(cell->data);
+        cell->sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() {
+        const size_t position = dequeuePosition.load(std::memory_order_relaxed);
+        return cells[position & mask].sequence.load(std::memory_order_acquire) != position + 1;
+    }
+
+    /**
+     * @brief wait until there is a message or the queue is closed
+     *
+     * @return true if there is a message
+     */
+    bool wait(const unsigned int &timeoutMs) {
+        if (!empty()) {
+            return true;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        // announced before checking again, so a sender either sees the waiting receiver or the receiver sees the message
+        waiting.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() { return !empty() || closed.load(); });
+        waiting.fetch_sub(1);
+        return !empty();
+    }
+
+    void close() {
+        closed.store(true);
+        std::lock_guard<std::mutex> lock(mutex);
+        condition.notify_all();
+    }
+
+    bool isClosed() {
+        return closed.load();
+    }
+
+ private:
+    struct Cell {
+        Cell():sequence(0) {}
+        std::atomic<size_t> sequence;
+        std::string data;
+    };
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            condition.notify_all();
+        }
+    }
+
+    std::vector<Cell> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePosition;
+    alignas(64) std::atomic<size_t> dequeuePosition;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::atomic<int> waiting;
+    std::atomic<bool> closed;
+};
+
+std::pair<TransportSharedPtr, TransportSharedPtr> TransportLoopback::createPair(const Options &options) {
+    std::shared_ptr<Queue> forward = std::make_shared<Queue>(options.capacity);
+    std::shared_ptr<Queue> backward = std::make_shared<Queue>(options.capacity);
+    return std::make_pair(TransportSharedPtr(new TransportLoopback(forward, backward, options)),
+                          TransportSharedPtr(new TransportLoopback(backward, forward, options)));
+}
+
+TransportLoopback::TransportLoopback(const std::shared_ptr<Queue> &sendQueue, const std::shared_ptr<Queue> &receiveQueue, const Options &options):
+    sendQueue(sendQueue), receiveQueue(receiveQueue), options(options), dropped(0) {}
+
+TransportLoopback::~TransportLoopback() {
+    sendQueue->close();
+    receiveQueue->close();
+}
+
+bool TransportLoopback::push(const std::function<void(std::string *target)> &write, const Flags &flags) {
+    while (!sendQueue->push(write)) {
+        if ((flags & NOBLOCK) || options.dropWhenFull || sendQueue->isClosed()) {
+            dropped++;
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+int TransportLoopback::send(const std::string& buf, Flags flags) {
+    if (sendQueue->isClosed()) {
+        return 0;
+    }
+    return push([&buf](std::string *target) { target->assign(buf); }, flags) ? buf.size() : 0;
+}
+
+int TransportLoopback::send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags) {
+    if (sendQueue->isClosed()) {
+        return 0;
+    }
+    const size_t size = header.size + payloadSize;
+    bool sent = push([&](std::string *target) {
+        target->resize(size);
+        if (header.size) {
+            memcpy(&(*target)[0], header.data, header.size);
+        }
+        if (payloadSize && writePayload) {
+            writePayload(&(*target)[header.size]);
+        }
+    }, flags);
+    return sent ? size : 0;
+}
+
+int TransportLoopback::pop(std::string *buf, const Flags &flags) {
+    if (!receiveQueue->pop(buf)) {
+        if ((flags & NOBLOCK) || !receiveQueue->wait(options.receiveTimeoutMs) || !receiveQueue->pop(buf)) {
+            return 0;
+        }
+    }
+    return buf->size();
+}
+
+int TransportLoopback::receive(std::string* buf, Flags flags) {
+    return pop(buf, flags);
+}
+
+int TransportLoopback::receive(ReceiveBuffer* buf, Flags flags) {
+    StringStorage* storage = buf->getStorage<StringStorage>();
+    int received = pop(&storage->buffer, flags);
+    if (received) {
+        buf->setView(storage->buffer.data(), storage->buffer.size());
+    } else {
+        buf->setView(nullptr, 0);
+    }
+    return received;
+}
+
+bool TransportLoopback::waitForData(const unsigned int &timeoutMs) {
+    return receiveQueue->wait(timeoutMs);
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Transport.hpp"
+
+namespace robot_remote_control
+{
+    /**
+     * @brief transport between a robot and a controller in the same process, e.g. to simulate many ControlledRobots
+     * (together with a VirtualClock, see Clock::setSource()) or for tests.
+     *
+     * createPair() returns two connected endpoints. Each direction is a bounded lock-free queue of messages,
+     * the message is written once (for protobuf payloads directly by the serialization) and its buffer is swapped into
+     * the receive buffer of the other side. The buffers circulate between the sides, so there are no allocations once
+     * they were big enough. Any thread may send, receivers only lock when they wait for data.
+     */
+    class TransportLoopback : public Transport
+    {
+        public:
+            struct Options {
+                Options():capacity(1024), dropWhenFull(false), receiveTimeoutMs(100) {}
+                // messages per direction (rounded up to a power of two)
+                size_t capacity;
+                // drop messages when the queue is full instead of waiting for the receiver (e.g. for telemetry like a zmq PUB socket)
+                bool dropWhenFull;
+                // maximum wait of a blocking receive (real time), so a controller waiting for a reply checks its timeout
+                unsigned int receiveTimeoutMs;
+            };
+
+            /**
+             * @brief two connected endpoints, messages sent on one are received on the other
+             * (e.g. first for the RobotController, second for the ControlledRobot)
+             */
+            static std::pair<TransportSharedPtr, TransportSharedPtr> createPair(const Options &options = Options());
+
+            /**
+             * @brief closes both directions, the other endpoint stops blocking and drops its messages
+             */
+            virtual ~TransportLoopback();
+
+            using Transport::send;
+
+            virtual int send(const std::string& buf, Flags flags = NONE);
+
+            /**
+             * @brief the message is written directly into the buffer passed to the receiver
+             */
+            virtual int send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags = NONE);
+
+            /**
+             * @brief the buffer of the message is swapped with buf, blocks until a message arrives (at most Options::receiveTimeoutMs)
+             */
+            virtual int receive(std::string* buf, Flags flags = NONE);
+
+            virtual int receive(ReceiveBuffer* buf, Flags flags = NONE);
+
+            virtual bool waitForData(const unsigned int &timeoutMs);
+
+            /**
+             * @brief messages dropped because the queue to the other endpoint was full (Options::dropWhenFull)
+             */
+            uint64_t getDropped() {
+                return dropped.load();
+            }
+
+        private:
+            class Queue;
+
+            TransportLoopback(const std::shared_ptr<Queue> &sendQueue, const std::shared_ptr<Queue> &receiveQueue, const Options &options);
+
+            // false if the message was dropped
+            bool push(const std::function<void(std::string *target)> &write, const Flags &flags);
+            int pop(std::string *buf, const Flags &flags);
+
+            std::shared_ptr<Queue> sendQueue;
+            std::shared_ptr<Queue> receiveQueue;
+            Options options;
+            std::atomic<uint64_t> dropped;
+    };
+
+}  // namespace robot_remote_control
@@ -0,0 +1,483 @@
+#include "TransportShm.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <climits>
+#include <new>
+#include <algorithm>
+#include <chrono>
+
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+#endif
+
+namespace robot_remote_control
+{
+
+namespace {
+    const uint32_t segmentMagic = 0x72726373;  // "rrcs"
+    const uint32_t segmentVersion = 1;
+    enum SegmentState {INITIALIZING, READY, CLOSED};
+
+    // each message is prefixed by its size, the marker tells the reader to continue at the start of the ring
+    const uint64_t wrapMarker = UINT64_MAX;
+    const size_t recordHeaderSize = sizeof(uint64_t);
+
+    size_t recordSize(const size_t &size) {
+        return recordHeaderSize + ((size + 7) & ~static_cast<size_t>(7));
+    }
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words need to be plain 32 bit integers");
+
+    void futexWait(std::atomic<uint32_t> *word, const uint32_t &value, const unsigned int &timeoutMs) {
+    #ifdef __linux__
+        timespec timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000;
+        // returns immediately if the word changed since value was read
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+    #else
+        usleep(std::min(timeoutMs, 1u) * 1000);
+    #endif
+    }
+
+    void futexWake(std::atomic<uint32_t> *word) {
+    #ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    #endif
+    }
+
+    int64_t steadyNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+/**
+ * @brief single producer/single consumer ring, the members are on separate cache lines
+ * to not slow down the other side
+ */
+struct TransportShm::Ring {
+    // bytes written/read in total, the positions in the data are modulo the capacity
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    // futex words, incremented on each write/release, the waiting counters tell if a wake is needed
+    alignas(64) std::atomic<uint32_t> written;
+    std::atomic<uint32_t> readersWaiting;
+    alignas(64) std::atomic<uint32_t> released;
+    std::atomic<uint32_t> writersWaiting;
+};
+
+struct TransportShm::Segment {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    std::atomic<uint32_t> state;
+    // 0: server to client, 1: client to server
+    Ring rings[2];
+};
+
+const size_t TransportShm::dataOffset = (sizeof(TransportShm::Segment) + 63) & ~static_cast<size_t>(63);
+
+TransportShm::TransportShm(const std::string &name, const ConnectionType &type, const Options &options):
+    name(name[0] == '/' ? name : "/" + name),
+    type(type),
+    options(options),
+    isAttached(false),
+    device(0),
+    inode(0),
+    checkedNs(0),
+    segment(nullptr),
+    segmentSize(0),
+    capacity(0),
+    sendRing(nullptr),
+    sendData(nullptr),
+    receiveRing(nullptr),
+    receiveData(nullptr),
+    heldEnd(0),
+    retiredMapping(nullptr),
+    retiredSize(0) {
+    if (type == SERVER) {
+        std::lock_guard<std::mutex> lock(attachMutex);
+        create();
+    } else {
+        attach();
+    }
+}
+
+TransportShm::~TransportShm() {
+    if (retiredMapping) {
+        munmap(retiredMapping, retiredSize);
+    }
+    if (!segment) {
+        return;
+    }
+    if (type == SERVER) {
+        // attached clients stop waiting and fail (or attach to a new SERVER) from now on
+        segment->state.store(CLOSED);
+        for (Ring &ring : segment->rings) {
+            ring.written.fetch_add(1);
+            futexWake(&ring.written);
+            ring.released.fetch_add(1);
+            futexWake(&ring.released);
+        }
+        // another SERVER may have replaced the segment meanwhile
+        int fd = shm_open(name.c_str(), O_RDONLY, 0600);
+        if (fd >= 0) {
+            if (isCurrent(fd)) {
+                shm_unlink(name.c_str());
+            }
+            close(fd);
+        }
+    }
+    munmap(segment, segmentSize);
+}
+
+bool TransportShm::remove(const std::string &name) {
+    return shm_unlink((name[0] == '/' ? name : "/" + name).c_str()) == 0;
+}
+
+bool TransportShm::create() {
+    // a segment of a crashed server would have stale data and clients still attached to it
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        printf("ERROR unable to create the shared memory segment %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+    capacity = (options.capacity + 7) & ~static_cast<size_t>(7);
+    segmentSize = dataOffset + 2 * capacity;
+    struct stat status;
+    if (fstat(fd, &status) == 0) {
+        device = status.st_dev;
+        inode = status.st_ino;
+    }
+    if (ftruncate(fd, segmentSize) != 0) {
+        printf("ERROR unable to resize the shared memory segment %s: %s\n", name.c_str(), strerror(errno));
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* memory = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        printf("ERROR unable to map the shared memory segment %s: %s\n", name.c_str(), strerror(errno));
+        shm_unlink(name.c_str());
+        return false;
+    }
+    segment = new (memory) Segment();
+    segment->magic = segmentMagic;
+    segment->version = segmentVersion;
+    segment->capacity = capacity;
+    for (Ring &ring : segment->rings) {
+        ring.head.store(0);
+        ring.tail.store(0);
+        ring.written.store(0);
+        ring.readersWaiting.store(0);
+        ring.released.store(0);
+        ring.writersWaiting.store(0);
+    }
+    sendRing = &segment->rings[0];
+    sendData = static_cast<char*>(memory) + dataOffset;
+    receiveRing = &segment->rings[1];
+    receiveData = sendData + capacity;
+    segment->state.store(READY);
+    isAttached.store(true);
+    return true;
+}
+
+bool TransportShm::isCurrent(const int &fd) {
+    struct stat status;
+    return fstat(fd, &status) == 0 && static_cast<uint64_t>(status.st_dev) == device && static_cast<uint64_t>(status.st_ino) == inode;
+}
+
+bool TransportShm::attach() {
+    if (isAttached.load() && (type == SERVER || steadyNs() - checkedNs.load() < static_cast<int64_t>(replacementCheckMs) * 1000000)) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(attachMutex);
+    if (type == SERVER) {
+        return isAttached.load();
+    }
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (isAttached.load()) {
+        if (fd >= 0 && segment->state.load() == READY && isCurrent(fd)) {
+            close(fd);
+            checkedNs.store(steadyNs());
+            return true;
+        }
+        // the SERVER closed the segment or a restarted one replaced it
+        detach();
+    }
+    if (fd < 0) {
+        // the server is not started yet
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < dataOffset) {
+        close(fd);
+        return false;
+    }
+    size_t size = status.st_size;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        printf("ERROR unable to map the shared memory segment %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+    Segment* mapped = static_cast<Segment*>(memory);
+    if (mapped->state.load() != READY) {
+        // initializing or closed, try again on the next use
+        munmap(memory, size);
+        return false;
+    }
+    if (mapped->magic != segmentMagic || mapped->version != segmentVersion || dataOffset + 2 * mapped->capacity > size) {
+        printf("ERROR %s is not a compatible shared memory segment\n", name.c_str());
+        munmap(memory, size);
+        return false;
+    }
+    std::lock(sendMutex, receiveMutex);
+    std::lock_guard<std::mutex> sendLock(sendMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> receiveLock(receiveMutex, std::adopt_lock);
+    device = status.st_dev;
+    inode = status.st_ino;
+    segment = mapped;
+    segmentSize = size;
+    capacity = mapped->capacity;
+    sendRing = &segment->rings[1];
+    receiveRing = &segment->rings[0];
+    receiveData = static_cast<char*>(memory) + dataOffset;
+    sendData = receiveData + capacity;
+    checkedNs.store(steadyNs());
+    isAttached.store(true);
+    return true;
+}
+
+void TransportShm::detach() {
+    std::lock(sendMutex, receiveMutex);
+    std::lock_guard<std::mutex> sendLock(sendMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> receiveLock(receiveMutex, std::adopt_lock);
+    isAttached.store(false);
+    if (heldEnd) {
+        // the last received view may still be read
+        if (retiredMapping) {
+            munmap(retiredMapping, retiredSize);
+        }
+        retiredMapping = segment;
+        retiredSize = segmentSize;
+        heldEnd = 0;
+    } else {
+        munmap(segment, segmentSize);
+    }
+    segment = nullptr;
+    sendRing = nullptr;
+    sendData = nullptr;
+    receiveRing = nullptr;
+    receiveData = nullptr;
+}
+
+int TransportShm::send(const std::string& buf, Flags flags) {
+    return send(MessageView(), buf.size(), [&buf](char* target) {
+        memcpy(target, buf.data(), buf.size());
+    }, flags);
+}
+
+int TransportShm::send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags) {
+    if (!attach()) {
+        return 0;
+    }
+    const size_t size = header.size + payloadSize;
+    const size_t record = recordSize(size);
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (!isAttached.load()) {
+        // detached meanwhile
+        return 0;
+    }
+    if (record > capacity) {
+        printf("ERROR message of %zu bytes does not fit into the shared memory ring of %zu bytes\n", size, capacity);
+        return 0;
+    }
+    // only this side writes the head
+    uint64_t head = sendRing->head.load(std::memory_order_relaxed);
+    const size_t toEnd = capacity - head % capacity;
+    if (record > toEnd) {
+        // the marker is published alone, the reader skips it and frees the end of the ring,
+        // so a message larger than half of the ring fits at the start
+        if (!waitForSpace(head, toEnd, flags)) {
+            return 0;
+        }
+        memcpy(sendData + head % capacity, &wrapMarker, recordHeaderSize);
+        head += toEnd;
+        publish(head);
+    }
+    if (!waitForSpace(head, record, flags)) {
+        return 0;
+    }
+    char* slot = sendData + head % capacity;
+    uint64_t recordedSize = size;
+    memcpy(slot, &recordedSize, recordHeaderSize);
+    if (header.size) {
+        memcpy(slot + recordHeaderSize, header.data, header.size);
+    }
+    if (payloadSize && writePayload) {
+        writePayload(slot + recordHeaderSize + header.size);
+    }
+    publish(head + record);
+    return size;
+}
+
+bool TransportShm::waitForSpace(const uint64_t &head, const size_t &bytes, Flags flags) {
+    while (head + bytes - sendRing->tail.load(std::memory_order_acquire) > capacity) {
+        if ((flags & NOBLOCK) || options.dropWhenFull || segment->state.load() != READY) {
+            return false;
+        }
+        sendRing->writersWaiting.fetch_add(1);
+        uint32_t released = sendRing->released.load();
+        if (head + bytes - sendRing->tail.load() > capacity) {
+            futexWait(&sendRing->released, released, 100);
+        }
+        sendRing->writersWaiting.fetch_sub(1);
+    }
+    return true;
+}
+
+void TransportShm::publish(const uint64_t &head) {
+    sendRing->head.store(head, std::memory_order_release);
+    sendRing->written.fetch_add(1);
+    if (sendRing->readersWaiting.load()) {
+        futexWake(&sendRing->written);
+    }
+}
+
+const char* TransportShm::readBlocking(std::unique_lock<std::mutex> *lock, size_t *size, Flags flags) {
+    const char* data = read(size);
+    while (!data && !(flags & NOBLOCK)) {
+        // the CLIENT attaches to a restarted SERVER between the waits
+        lock->unlock();
+        attach();
+        lock->lock();
+        if (!attached() || segment->state.load() != READY) {
+            return nullptr;
+        }
+        waitForReceiveRing(100);
+        data = read(size);
+    }
+    return data;
+}
+
+int TransportShm::receive(std::string* buf, Flags flags) {
+    attach();
+    std::unique_lock<std::mutex> lock(receiveMutex);
+    size_t size = 0;
+    const char* data = readBlocking(&lock, &size, flags);
+    if (!data) {
+        return 0;
+    }
+    buf->assign(data, size);
+    release();
+    return size;
+}
+
+int TransportShm::receive(ReceiveBuffer* buf, Flags flags) {
+    attach();
+    std::unique_lock<std::mutex> lock(receiveMutex);
+    size_t size = 0;
+    const char* data = readBlocking(&lock, &size, flags);
+    if (!data) {
+        buf->setView(nullptr, 0);
+        return 0;
+    }
+    // released on the next receive
+    buf->setView(data, size);
+    return size;
+}
+
+bool TransportShm::waitForData(const unsigned int &timeoutMs) {
+    if (!attach()) {
+        // nothing to wait on, check again later
+        usleep(std::min(timeoutMs, 10u) * 1000);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(receiveMutex);
+    return attached() && waitForReceiveRing(timeoutMs);
+}
+
+bool TransportShm::waitForReceiveRing(const unsigned int &timeoutMs) {
+    if (hasData()) {
+        return true;
+    }
+    receiveRing->readersWaiting.fetch_add(1);
+    uint32_t written = receiveRing->written.load();
+    if (!hasData() && segment->state.load() == READY) {
+        futexWait(&receiveRing->written, written, timeoutMs);
+    }
+    receiveRing->readersWaiting.fetch_sub(1);
+    return hasData();
+}
+
+bool TransportShm::hasData() {
+    return receiveRing->head.load(std::memory_order_acquire) != (heldEnd ? heldEnd : receiveRing->tail.load(std::memory_order_relaxed));
+}
+
+const char* TransportShm::read(size_t *size) {
+    release();
+    if (retiredMapping) {
+        // the view of the last message was released
+        munmap(retiredMapping, retiredSize);
+        retiredMapping = nullptr;
+    }
+    if (!attached()) {
+        return nullptr;
+    }
+    // only this side writes the tail
+    uint64_t tail = receiveRing->tail.load(std::memory_order_relaxed);
+    const uint64_t head = receiveRing->head.load(std::memory_order_acquire);
+    if (tail == head) {
+        return nullptr;
+    }
+    size_t offset = tail % capacity;
+    uint64_t recordedSize;
+    memcpy(&recordedSize, receiveData + offset, recordHeaderSize);
+    if (recordedSize == wrapMarker) {
+        // the writer waits for this space to write the following message at the start
+        tail += capacity - offset;
+        advanceTail(tail);
+        if (tail == head) {
+            return nullptr;
+        }
+        offset = 0;
+        memcpy(&recordedSize, receiveData, recordHeaderSize);
+    }
+    // the size is written by the other process
+    if (recordedSize > capacity || recordSize(recordedSize) > capacity - offset || tail + recordSize(recordedSize) > head) {
+        printf("ERROR corrupt message in the shared memory segment %s, dropping the received messages\n", name.c_str());
+        advanceTail(head);
+        return nullptr;
+    }
+    *size = recordedSize;
+    heldEnd = tail + recordSize(recordedSize);
+    return receiveData + offset + recordHeaderSize;
+}
+
+void TransportShm::release() {
+    if (!heldEnd) {
+        return;
+    }
+    const uint64_t tail = heldEnd;
+    heldEnd = 0;
+    advanceTail(tail);
+}
+
+void TransportShm::advanceTail(const uint64_t &tail) {
+    receiveRing->tail.store(tail, std::memory_order_release);
+    receiveRing->released.fetch_add(1);
+    if (receiveRing->writersWaiting.load()) {
+        futexWake(&receiveRing->released);
+    }
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "Transport.hpp"
+
+namespace robot_remote_control
+{
+    /**
+     * @brief transport between two processes on the same host through a shared memory segment (/dev/shm/<name>).
+     * The segment holds one ring of variable size messages per direction, so it connects exactly one SERVER
+     * (e.g. the ControlledRobot) and one CLIENT (e.g. a local RobotController), like a REQ/REP pair or a PUB/SUB pair with a single subscriber.
+     *
+     * The SERVER (re-)creates the segment, the CLIENT attaches to it on first use, so they can be started in any order.
+     * When the SERVER is restarted (also after a crash) the CLIENT attaches to the new segment, it checks for a replaced
+     * segment at most every replacementCheckMs on send and receive. Messages in the old rings are lost then.
+     * Receivers waiting for data (and senders waiting for space) sleep on futexes in the segment,
+     * there are no syscalls as long as both sides are busy.
+     */
+    class TransportShm : public Transport
+    {
+        public:
+
+            enum ConnectionType {SERVER, CLIENT};
+
+            // interval of the CLIENT checking for a restarted SERVER
+            enum : unsigned int { replacementCheckMs = 100 };
+
+            struct Options {
+                Options():capacity(16 * 1024 * 1024), dropWhenFull(false) {}
+                // bytes of each ring (only used by the SERVER), the largest message is 8 bytes smaller
+                size_t capacity;
+                // drop messages when the ring is full instead of waiting for the receiver (e.g. for telemetry like a zmq PUB socket)
+                bool dropWhenFull;
+            };
+
+            /**
+             * @param name name of the shared memory segment, the same on both sides
+             * @param type SERVER creates the segment, CLIENT attaches to it
+             * @param options size of the rings and what to do when a ring is full
+             */
+            TransportShm(const std::string &name, const ConnectionType &type, const Options &options = Options());
+            virtual ~TransportShm();
+
+            /**
+             * @brief remove a segment left by a crashed SERVER (a running SERVER replaces it anyway)
+             *
+             * @return false if there was no such segment
+             */
+            static bool remove(const std::string &name);
+
+            using Transport::send;
+
+            virtual int send(const std::string& buf, Flags flags = NONE);
+
+            /**
+             * @brief the payload is written directly into the ring
+             */
+            virtual int send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags = NONE);
+
+            virtual int receive(std::string* buf, Flags flags = NONE);
+
+            /**
+             * @brief receive without copy, the view points into the ring.
+             * @warning the message is released by the next receive of this transport (also into a different buffer)
+             */
+            virtual int receive(ReceiveBuffer* buf, Flags flags = NONE);
+
+            /**
+             * @brief nothing to reserve: messages are written into and read from the ring
+             */
+            virtual void preallocate(ReceiveBuffer* buf, const size_t &bytes) {}
+
+            /**
+             * @brief waits on the futex of the receiving ring
+             * @warning should be called from the thread that is receiving
+             */
+            virtual bool waitForData(const unsigned int &timeoutMs);
+
+            /**
+             * @brief true if the segment is mapped (the CLIENT attaches on first use)
+             */
+            bool attached() {
+                return isAttached.load();
+            }
+
+        private:
+            struct Ring;
+            struct Segment;
+            // the rings follow the header of the segment
+            static const size_t dataOffset;
+
+            // maps the segment of a SERVER, needs the attachMutex locked
+            bool create();
+            // maps the segment of a CLIENT, the first successful call sets isAttached,
+            // maps the segment again if the SERVER closed or replaced it
+            bool attach();
+            // unmaps the segment of a CLIENT, needs the attachMutex locked
+            void detach();
+            // true if the name refers to the mapped segment
+            bool isCurrent(const int &fd);
+            // the next message, waits (unlocked between the waits, so the segment can be replaced) unless NOBLOCK is set
+            const char* readBlocking(std::unique_lock<std::mutex> *lock, size_t *size, Flags flags);
+            // needs the receiveMutex locked
+            bool waitForReceiveRing(const unsigned int &timeoutMs);
+
+            // waits until the bytes behind head are free in the sending ring unless NOBLOCK or dropWhenFull is set, needs the sendMutex locked
+            bool waitForSpace(const uint64_t &head, const size_t &bytes, Flags flags);
+            // make the sending ring up to head visible to the receiver
+            void publish(const uint64_t &head);
+
+            // the next message of the receiving ring, releases the held one first, nullptr if there is none
+            const char* read(size_t *size);
+            // release the message returned by read()
+            void release();
+            // free the receiving ring up to tail for the sender
+            void advanceTail(const uint64_t &tail);
+            bool hasData();
+
+            std::string name;
+            ConnectionType type;
+            Options options;
+
+            std::mutex attachMutex;
+            std::atomic<bool> isAttached;
+            // identify the mapped segment, a restarted SERVER creates a new one with the same name
+            uint64_t device;
+            uint64_t inode;
+            std::atomic<int64_t> checkedNs;
+            Segment* segment;
+            size_t segmentSize;
+            size_t capacity;
+            Ring* sendRing;
+            char* sendData;
+            Ring* receiveRing;
+            char* receiveData;
+
+            // locked both to change the mapping (after the attachMutex)
+            std::mutex sendMutex;
+            std::mutex receiveMutex;
+            // receive position behind the message returned by read(), 0 if none is held
+            uint64_t heldEnd;
+            // the replaced mapping while a received message may still point into it, unmapped by the next read()
+            void* retiredMapping;
+            size_t retiredSize;
+    };
+}
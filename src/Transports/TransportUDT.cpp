@@ -1,18 +1,39 @@
 #include "TransportUDT.hpp"
+#include "../WireHeader.hpp"
 #include <iostream>
 #include <cstring> //memset
 #include <unistd.h>
+#include <set>
+#include <chrono>
 
 using namespace std;
 using namespace robot_remote_control;
 
+namespace {
+    // UDT error codes
+    const int errorSendBufferFull = 6001;  // non-blocking send: no buffer available
+    const int errorNoData = 6002;  // non-blocking receive: no data available
+    const int errorTimeout = 6003;
+    // the connection was lost, the accept thread reconnects
+    const int errorConnectionBroken = 2001;
+    const int errorNotConnected = 2002;
+
+    int remainingMs(const std::chrono::steady_clock::time_point &deadline) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    }
+}
+
+const int TransportUDT::blockingTimeoutMs;
+const int TransportUDT::reconnectIntervalMs;
 
 TransportUDT::TransportUDT(const ConnectionType &type, const int &port, const std::string &addr, size_t recvBufferSize):connectiontype(type),port(port),addr(addr),recvBufferSize(recvBufferSize){
 
-    blockingRecv = true;
-    blockingSend = true;
     serv = 0;
+    socket.store(0);
+    running.store(true);
     recvBuffer.resize(recvBufferSize);
+    sendEpollId = -1;
+    receiveEpollId = -1;
 
     UDT::startup();
 
@@ -20,7 +41,8 @@ TransportUDT::TransportUDT(const ConnectionType &type, const int &port, const st
 
         serv = UDT::socket(AF_INET, SOCK_DGRAM, 0);
 
-        bool block = true;
+        // accept() polls, so the accept thread can be stopped
+        bool block = false;
         UDT::setsockopt(serv, 0 /*ignored*/, UDT_RCVSYN,&block,sizeof(bool));
         bool reuse = true;
         UDT::setsockopt(serv, 0 /*ignored*/, UDT_REUSEADDR,&reuse, sizeof(bool));
@@ -39,21 +61,12 @@ TransportUDT::TransportUDT(const ConnectionType &type, const int &port, const st
 
         UDT::listen(serv, 10);
 
-        socket.lockedAccess().set(0);
-
-        //start connect thread (locks socket)
+        //start connect thread
         acceptthread = std::thread(&TransportUDT::accept,this);
 
         //sleep(1);
 
     }else{
-        socket.lockedAccess().set(UDT::socket(AF_INET, SOCK_DGRAM, 0));
-
-        // bool block = true;
-        // socket.lock();
-        // UDT::setsockopt(socket.get_ref(), 0 /*ignored*/, UDT_RCVSYN,&block,sizeof(bool));
-        // socket.unlock();
-
         acceptthread = std::thread(&TransportUDT::connect,this);
         //sleep(1);
     }
@@ -62,10 +75,18 @@ TransportUDT::TransportUDT(const ConnectionType &type, const int &port, const st
 
 TransportUDT::~TransportUDT(){
 
+    running.store(false);
     acceptthread.join();
 
-    if (socket.lockedAccess().get()){
-        UDT::close(socket.lockedAccess().get());
+    if (sendEpollId >= 0) {
+        UDT::epoll_release(sendEpollId);
+    }
+    if (receiveEpollId >= 0) {
+        UDT::epoll_release(receiveEpollId);
+    }
+
+    if (socket.load()){
+        UDT::close(socket.load());
     }
     if (serv){
         UDT::close(serv);
@@ -74,108 +95,231 @@ TransportUDT::~TransportUDT(){
 
 
 void TransportUDT::accept(){
-    auto lockedSocket = socket.lockedAccess();
-//      if (!socket.get_ref()){
+    while (running.load()) {
         int namelen;
         sockaddr_in their_addr;
-
-        lockedSocket.get() = UDT::accept(serv, (sockaddr*)&their_addr, &namelen);
-
-        UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_RCVSYN,&blockingRecv,sizeof(bool));
-        UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_SNDSYN,&blockingSend,sizeof(bool));
-
-        int recvtimeout = 500; //ms
-        UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_SNDTIMEO,&recvtimeout, sizeof(int));
-        UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_RCVTIMEO,&recvtimeout, sizeof(int));
-
+        UDTSOCKET accepted = UDT::accept(serv, (sockaddr*)&their_addr, &namelen);
+        if (accepted == UDT::INVALID_SOCK) {
+            if (UDT::getlasterror().getErrorCode() != errorNoData) {
+                cout << "accept: " << UDT::getlasterror().getErrorMessage();
+            }
+            usleep(reconnectIntervalMs * 1000);
+            continue;
+        }
         //cout << "new connection: " << inet_ntoa(their_addr.sin_addr) << ":" << ntohs(their_addr.sin_port) << endl;
-//    }
+        setConnected(accepted);
+    }
 }
 
 void TransportUDT::connect(){
-    auto lockedSocket = socket.lockedAccess();
     sockaddr_in serv_addr;
     serv_addr.sin_family = AF_INET;
     serv_addr.sin_port = htons(port);
     inet_pton(AF_INET, addr.c_str(), &serv_addr.sin_addr);
     memset(&(serv_addr.sin_zero), '\0', 8);
 
-    // connect to the server, implict bind
-    if (UDT::ERROR == UDT::connect(lockedSocket.get(), (sockaddr*)&serv_addr, sizeof(serv_addr)))
-    {
-        cout << "connect: " << UDT::getlasterror().getErrorMessage();
+    bool reported = false;
+    while (running.load()) {
+        UDTSOCKET current = socket.load();
+        if (current && isAlive(current)) {
+            usleep(reconnectIntervalMs * 1000);
+            continue;
+        }
+        UDTSOCKET client = UDT::socket(AF_INET, SOCK_DGRAM, 0);
+        // connect to the server, implict bind
+        if (UDT::ERROR == UDT::connect(client, (sockaddr*)&serv_addr, sizeof(serv_addr)))
+        {
+            if (!reported) {
+                // only once, it is retried until the server is available
+                cout << "connect: " << UDT::getlasterror().getErrorMessage();
+                reported = true;
+            }
+            UDT::close(client);
+            usleep(reconnectIntervalMs * 1000);
+            continue;
+        }
+        reported = false;
+        setConnected(client);
+    }
+}
+
+bool TransportUDT::isAlive(const UDTSOCKET &sock){
+    UDTSTATUS state = UDT::getsockstate(sock);
+    return state != BROKEN && state != CLOSING && state != CLOSED && state != NONEXIST;
+}
+
+void TransportUDT::setConnected(const UDTSOCKET &connected){
+    // blocking calls wait on the epoll sets, so the mode does not need to be switched per call
+    bool block = false;
+    UDT::setsockopt(connected, 0 /*ignored*/, UDT_RCVSYN, &block, sizeof(bool));
+    UDT::setsockopt(connected, 0 /*ignored*/, UDT_SNDSYN, &block, sizeof(bool));
+
+    UDTSOCKET previous = socket.load();
+    if (!previous) {
+        // nothing sends or receives yet, they wait for the socket
+        sendEpollId = UDT::epoll_create();
+        int events = UDT_EPOLL_OUT;
+        UDT::epoll_add_usock(sendEpollId, connected, &events);
+        receiveEpollId = UDT::epoll_create();
+        events = UDT_EPOLL_IN;
+        UDT::epoll_add_usock(receiveEpollId, connected, &events);
+        {
+            std::lock_guard<std::mutex> lock(connectMutex);
+            socket.store(connected);
+        }
+        connectCondition.notify_all();
+        return;
+    }
+
+    // a reconnect, the old socket may still be in use by send or receive
+    std::lock_guard<std::mutex> sendLock(sendMutex);
+    std::lock_guard<std::mutex> receiveLock(receiveMutex);
+    UDT::epoll_remove_usock(sendEpollId, previous);
+    UDT::epoll_remove_usock(receiveEpollId, previous);
+    int events = UDT_EPOLL_OUT;
+    UDT::epoll_add_usock(sendEpollId, connected, &events);
+    events = UDT_EPOLL_IN;
+    UDT::epoll_add_usock(receiveEpollId, connected, &events);
+    socket.store(connected);
+    UDT::close(previous);
+}
+
+UDTSOCKET TransportUDT::getSocket(Flags flags){
+    UDTSOCKET sock = socket.load();
+    if (sock || (flags & NOBLOCK)) {
+        return sock;
     }
-    int recvtimeout = 500; //ms
-    // UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_RCVTIMEO,&recvtimeout, sizeof(int));
-    // UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_SNDTIMEO,&recvtimeout, sizeof(int));
-    UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_RCVSYN,&blockingRecv,sizeof(bool));
-    UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_SNDSYN,&blockingSend,sizeof(bool));
-} 
+    std::unique_lock<std::mutex> lock(connectMutex);
+    connectCondition.wait_for(lock, std::chrono::milliseconds(blockingTimeoutMs), [this]() { return socket.load() != 0; });
+    return socket.load();
+}
+
 
+void TransportUDT::addLatestValueType(const uint16_t &type, const int &ttlMs){
+    latestValueTTL[type] = ttlMs;
+}
 
 int TransportUDT::send(const std::string& buf, Flags flags){
-    auto lockedSocket = socket.lockedAccess();
-
-    if ((flags & NOBLOCK) && blockingSend ){
-        //if should not block but enabled:
-        blockingSend = false;
-        UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_SNDSYN,&blockingSend,sizeof(bool));
-    }else if ((!(flags & NOBLOCK)) && !blockingSend ){
-        //if should block but disabled:
-        blockingSend = true;
-        UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_SNDSYN,&blockingSend,sizeof(bool));
-    }
-
-    int sent = UDT::sendmsg(lockedSocket.get(), buf.data(), buf.size() , -1, true); //ttl -1, inorder true
-    if (UDT::ERROR == sent)
-    {
-        cout << "send error: " << UDT::getlasterror().getErrorMessage();
+    UDTSOCKET sock = getSocket(flags);
+    if (!sock) {
         return 0;
     }
-    //cout << "send done " << addr << ":" << port << " bytes:" << sent << " " << connectiontype << std::endl;
-    return sent;
+    int ttl = -1;
+    bool inorder = true;
+    if (!latestValueTTL.empty() && buf.size() >= sizeof(uint16_t)) {
+        uint16_t type;
+        memcpy(&type, buf.data(), sizeof(uint16_t));
+        // both telemetry headers
+        type &= ~WIRE_HEADER_FLAG;
+        auto latestValue = latestValueTTL.find(type);
+        if (latestValue != latestValueTTL.end()) {
+            ttl = latestValue->second;
+            inorder = false;
+        }
+    }
+    // receiving is not blocked by sending
+    std::lock_guard<std::mutex> lock(sendMutex);
+    // it may have been replaced by a reconnect meanwhile
+    sock = socket.load();
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(blockingTimeoutMs);
+    while (true) {
+        int sent = UDT::sendmsg(sock, buf.data(), buf.size(), ttl, inorder);
+        if (UDT::ERROR != sent) {
+            //cout << "send done " << addr << ":" << port << " bytes:" << sent << " " << connectiontype << std::endl;
+            return sent;
+        }
+        const int error = UDT::getlasterror().getErrorCode();
+        if (error != errorSendBufferFull) {
+            if (error != errorConnectionBroken && error != errorNotConnected) {
+                cout << "send error: " << UDT::getlasterror().getErrorMessage();
+            }
+            return 0;
+        }
+        int remaining = remainingMs(deadline);
+        if ((flags & NOBLOCK) || remaining <= 0) {
+            return 0;
+        }
+        std::set<UDTSOCKET> writefds;
+        UDT::epoll_wait(sendEpollId, NULL, &writefds, remaining);
+    }
+}
+
+namespace {
+    struct UDTStorage : public ReceiveBuffer::Storage {
+        std::string buffer;
+    };
 }
 
 int TransportUDT::receive(std::string* buf, Flags flags){
-    auto lockedSocket = socket.lockedAccess();
-    
-    if ((flags & NOBLOCK) && blockingRecv ){
-        //if should not block but enabled:
-        blockingRecv = false;
-        UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_RCVSYN,&blockingRecv,sizeof(bool));
-    }else if ((!(flags & NOBLOCK)) && !blockingRecv ){
-        //if should block but disabled:
-        blockingRecv = true;
-        UDT::setsockopt(lockedSocket.get(), 0 /*ignored*/, UDT_RCVSYN,&blockingRecv,sizeof(bool));
-    }
-
-    int received = UDT::recvmsg(lockedSocket.get(), (char*)recvBuffer.data(), recvBuffer.size());
-    if (UDT::ERROR == received)
-    {
+    // the shared recvBuffer must not be reused until it was copied
+    std::lock_guard<std::mutex> lock(receiveMutex);
+    int received = receiveInto(const_cast<char*>(recvBuffer.data()), recvBuffer.size(), flags);
+    if (received) {
+        buf->assign(recvBuffer.data(), received);
+    }
+    return received;
+}
 
+int TransportUDT::receive(ReceiveBuffer* buf, Flags flags){
+    UDTStorage* storage = buf->getStorage<UDTStorage>();
+    if (storage->buffer.size() != recvBufferSize) {
+        // only happens on the first use of buf
+        storage->buffer.resize(recvBufferSize);
+    }
+    std::lock_guard<std::mutex> lock(receiveMutex);
+    int received = receiveInto(const_cast<char*>(storage->buffer.data()), storage->buffer.size(), flags);
+    buf->setView(storage->buffer.data(), received);
+    return received;
+}
+
+int TransportUDT::receiveInto(char* target, const size_t &size, Flags flags){
+    UDTSOCKET sock = getSocket(flags);
+    if (!sock) {
+        return 0;
+    }
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(blockingTimeoutMs);
+    while (true) {
+        int received = UDT::recvmsg(sock, target, size);
+        if (UDT::ERROR != received) {
+            //cout << "receive done: "  << port << " bytes:" << received << " " << connectiontype  << std::endl;
+            return received;
+        }
         switch(UDT::getlasterror().getErrorCode())
         {
-            case 6002: // no data is available to be received on a non-blocking socket
-            case 6003: // receive timeout
+            case errorNoData:
+            case errorTimeout:
                 break;
-            case 2001: // connection broken before send is completed
-            case 2002: // not connected
+            case errorConnectionBroken:
+            case errorNotConnected:
+                // reconnected by the accept thread
+                return 0;
             case 5004: // invalid UDT socket
             case 5009: // wrong mode
             case 6004: // an overlapped recv is in progress
             default:
                 //throw std::runtime_error("TransportUDT receive: " + std::string(UDT::getlasterror().getErrorMessage()));        
                 cout << UDT::getlasterror().getErrorMessage() << " code :" << UDT::getlasterror().getErrorCode() << endl;
+                return 0;
         }
+        int remaining = remainingMs(deadline);
+        if ((flags & NOBLOCK) || remaining <= 0) {
             return 0;
+        }
+        std::set<UDTSOCKET> readfds;
+        UDT::epoll_wait(receiveEpollId, &readfds, NULL, remaining);
     }
-    //cout << "receive done: "  << port << " bytes:" << received << " " << connectiontype  << std::endl;
-
-    //don't use string assign here, no need to inti the whole buffer size on target string
-    buf->resize(received);//should already be the case
-    memcpy((void*)buf->data(),recvBuffer.data(),received);
-    
-    return received;
 }
 
-
+bool TransportUDT::waitForData(const unsigned int &timeoutMs){
+    // a send in another thread may still use the socket meanwhile
+    UDTSOCKET sock = socket.load();
+    if (!sock) {
+        usleep(timeoutMs * 1000);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(receiveMutex);
+    std::set<UDTSOCKET> readfds;
+    // returns UDT::ERROR on timeout
+    int ready = UDT::epoll_wait(receiveEpollId, &readfds, NULL, timeoutMs);
+    return ready > 0 && readfds.size();
+}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <map>
 
 #include "Transport.hpp"
-#include "../UpdateThread/LockableClass.hpp"
 
 #include <arpa/inet.h>
 #include "udt/udt.h"
@@ -16,48 +19,119 @@ namespace robot_remote_control
 
             enum ConnectionType {SERVER,CLIENT};
 
+            /**
+             * @brief send and receive use separate locks, so a blocking send of a big message does not delay receiving.
+             * The socket is non-blocking, blocking calls wait on UDT::epoll for at most blockingTimeoutMs
+             * (also for the connection to be established)
+             */
+            static const int blockingTimeoutMs = 500;
+
+            /**
+             * @brief the connection is checked in this interval: a SERVER accepts new connections all the time (a new connection
+             * replaces the current one, e.g. a controller reconnecting after a dropout), a CLIENT reconnects when the
+             * connection broke. Messages sent while reconnecting are dropped (send() returns 0).
+             * See RobotController::setSessionResumption() to resync the telemetry after reconnecting.
+             */
+            static const int reconnectIntervalMs = 100;
+
             TransportUDT(const ConnectionType &type, const int &port, const std::string &addr = "", size_t recvBufferSize=10000000);
             virtual ~TransportUDT();
 
+            using Transport::send;
+
             /**
              * @brief send date
              * 
              * @param buf the buffer to send
              * @param Flags flags the flags
-             * @return int number of bytes sent
+             * @return int number of bytes sent, 0 if the send buffer is full (after blockingTimeoutMs without NOBLOCK)
              */
             virtual int send(const std::string& buf, Flags flags = NONE);
 
             /**
              * @brief receive data
              * 
-             * @param buf buffer to fill on receive
+             * @param buf buffer to fill on receive, UDT needs a buffer for the largest message, so the message is
+             * copied from a buffer of this transport (receive(ReceiveBuffer*) avoids this copy)
              * @param Flags flags the flags
              * @return int 0 if no data received, size of data otherwise
              */
             virtual int receive(std::string* buf, Flags flags = NONE);
 
+            /**
+             * @brief receive data without copy, buf holds its own receive buffer of recvBufferSize
+             *
+             * @param buf buffer to receive into, the view is valid until the next receive into buf
+             * @param Flags flags the flags
+             * @return int 0 if no data received, size of data otherwise
+             */
+            virtual int receive(ReceiveBuffer* buf, Flags flags = NONE);
+
+            /**
+             * @brief send a message type unreliably (e.g. CURRENT_POSE, CURRENT_TWIST, IMU_VALUES): it is dropped when not delivered
+             * within ttlMs and does not wait for older messages, so a lost message does not delay the newer ones (head-of-line blocking).
+             * The other types stay reliable and in order. Messages are routed by their type header (the first uint16_t),
+             * only the sending side needs to add the types.
+             * On the controller side, RobotController::setLatestValueTelemetry() drops messages older than the last received one
+             * of the type (with RobotController::setVersionedHeader() only, which adds the sequence numbers).
+             * @warning has to be called before the transport is used, TELEMETRY_BATCH messages are not routed
+             *
+             * @param type the telemetry type
+             * @param ttlMs milliseconds a message is kept for retransmission
+             */
+            void addLatestValueType(const uint16_t &type, const int &ttlMs = 100);
+
+            /**
+             * @brief uses UDT::epoll to wait for incoming messages
+             * @warning should be called from the thread that is receiving
+             */
+            virtual bool waitForData(const unsigned int &timeoutMs);
+
 
             private:
+                // accepts (SERVER) or connects (CLIENT) until the transport is destroyed
                 std::thread acceptthread;
+                std::atomic<bool> running;
                 void accept();
 
                 void connect();
 
+                // false if the socket is broken or closed
+                static bool isAlive(const UDTSOCKET &sock);
+
+                // configures the connected socket and makes it available to send and receive, replaces the current socket
+                void setConnected(const UDTSOCKET &connected);
+
+                // the connected socket, 0 if not connected (within blockingTimeoutMs unless NOBLOCK is set)
+                UDTSOCKET getSocket(Flags flags);
+
+                // needs the receiveMutex locked
+                int receiveInto(char* target, const size_t &size, Flags flags);
+
                 UDTSOCKET serv;
 
-                LockableClass<UDTSOCKET> socket;
+                // 0 until connected, replaced by setConnected() with the send and receive mutexes locked
+                std::atomic<UDTSOCKET> socket;
+                std::mutex connectMutex;
+                std::condition_variable connectCondition;
 
                 ConnectionType connectiontype;
                 std::string addr;
                 int port;
 
-                bool blockingSend;
-                bool blockingRecv;
+                std::mutex sendMutex;
+                std::mutex receiveMutex;
 
                 size_t recvBufferSize;
                 std::string recvBuffer;
 
+                // the socket is registered for writing in sendEpollId and for reading in receiveEpollId
+                int sendEpollId;
+                int receiveEpollId;
+
+                // see addLatestValueType(), the time to live by type
+                std::map<uint16_t, int> latestValueTTL;
+
     };
 
 } // end namespace robot_remote_control-transport_udt
@@ -0,0 +1,276 @@
+#include "TransportWrapperBonding.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <random>
+
+namespace robot_remote_control {
+
+namespace {
+    // [uint8_t kind][uint32_t epoch][uint32_t sequence], the probes are followed by the uint64_t send time in microseconds
+    enum FrameKind : uint8_t {DATA = 0, PROBE = 1, PROBE_REPLY = 2};
+    const size_t epochOffset = sizeof(uint8_t);
+    const size_t sequenceOffset = epochOffset + sizeof(uint32_t);
+    const size_t frameHeaderSize = sequenceOffset + sizeof(uint32_t);
+    const size_t probeSize = frameHeaderSize + sizeof(uint64_t);
+    // messages of the slower link arrive up to this many messages after the copy of the faster one
+    const size_t duplicateWindow = 4096;
+    const float smoothing = 0.125;
+
+    uint64_t nowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+TransportWrapperBonding::TransportWrapperBonding(const std::vector<TransportSharedPtr> &transports, const Options &options):
+    options(options),
+    running(true),
+    activeLink(0),
+    epoch(std::random_device()()),
+    sequence(0),
+    frameHeader(frameHeaderSize, 0),
+    receivedSequences(duplicateWindow, -1),
+    highestSequence(0),
+    peerEpoch(0),
+    receivedAny(false),
+    droppedMessages(0) {
+    if (transports.empty()) {
+        printf("TransportWrapperBonding: no links\n");
+    }
+    const uint64_t now = nowUs();
+    for (const TransportSharedPtr &transport : transports) {
+        links.emplace_back(new Link());
+        links.back()->transport = transport;
+        // alive until it did not reply within the failover timeout
+        links.back()->lastReplyUs = now;
+    }
+    receiveThread = std::thread(&TransportWrapperBonding::run, this);
+}
+
+TransportWrapperBonding::~TransportWrapperBonding() {
+    running.store(false);
+    queueCondition.notify_all();
+    if (receiveThread.joinable()) {
+        receiveThread.join();
+    }
+}
+
+int TransportWrapperBonding::send(const std::string& buf, Flags flags) {
+    return send(MessageView(), buf, flags);
+}
+
+int TransportWrapperBonding::send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (links.empty()) {
+        return 0;
+    }
+    // keeps its capacity
+    frameHeader.resize(frameHeaderSize + header.size);
+    frameHeader[0] = DATA;
+    memcpy(&frameHeader[epochOffset], &epoch, sizeof(uint32_t));
+    memcpy(&frameHeader[sequenceOffset], &sequence, sizeof(uint32_t));
+    if (header.size) {
+        memcpy(&frameHeader[frameHeaderSize], header.data, header.size);
+    }
+    sequence++;
+
+    const bool duplicate = header.size + payloadSize <= options.duplicateMaxSize;
+    const uint64_t now = duplicate ? nowUs() : 0;
+    int sent = 0;
+    for (size_t index = 0; index < links.size(); ++index) {
+        Link &link = *links[index];
+        if (index != activeLink && !(duplicate && isAlive(link, now))) {
+            continue;
+        }
+        std::lock_guard<std::mutex> transportLock(link.transportMutex);
+        if (link.transport->send(frameHeader, payloadSize, writePayload, flags)) {
+            link.sent++;
+            sent = header.size + payloadSize;
+        }
+    }
+    return sent;
+}
+
+int TransportWrapperBonding::receive(std::string* buf, Flags flags) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    if (!(flags & NOBLOCK)) {
+        queueCondition.wait(lock, [this] { return !queue.empty() || !running; });
+    }
+    if (queue.empty()) {
+        return 0;
+    }
+    buf->swap(queue.front());
+    queue.pop_front();
+    return buf->size();
+}
+
+bool TransportWrapperBonding::waitForData(const unsigned int &timeoutMs) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    return queueCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !queue.empty() || !running; }) && !queue.empty();
+}
+
+size_t TransportWrapperBonding::getActiveLink() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return activeLink;
+}
+
+uint64_t TransportWrapperBonding::getDroppedMessages() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return droppedMessages;
+}
+
+std::vector<TransportWrapperBonding::LinkStatistics> TransportWrapperBonding::getLinkStatistics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint64_t now = nowUs();
+    std::vector<LinkStatistics> statistics;
+    for (const std::unique_ptr<Link> &link : links) {
+        LinkStatistics linkStatistics;
+        linkStatistics.rttMs = link->rttMs;
+        linkStatistics.loss = link->loss;
+        linkStatistics.alive = isAlive(*link, now);
+        linkStatistics.sent = link->sent;
+        linkStatistics.received = link->received;
+        linkStatistics.duplicates = link->duplicates;
+        statistics.push_back(linkStatistics);
+    }
+    return statistics;
+}
+
+void TransportWrapperBonding::run() {
+    uint64_t nextProbe = 0;
+    while (running) {
+        const uint64_t now = nowUs();
+        if (now >= nextProbe) {
+            probe(now);
+            nextProbe = now + options.probeIntervalMs * 1000;
+        }
+        bool received = false;
+        // one message per link and pass, so a busy link does not delay the probe replies of the others
+        for (const std::unique_ptr<Link> &link : links) {
+            std::unique_lock<std::mutex> transportLock(link->transportMutex);
+            if (!link->transport->receive(&link->buffer, NOBLOCK)) {
+                continue;
+            }
+            transportLock.unlock();
+            // only this thread receives into the buffer
+            evaluate(link.get(), link->buffer.view());
+            received = true;
+        }
+        if (!received) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void TransportWrapperBonding::probe(const uint64_t &now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    char probe[probeSize];
+    probe[0] = PROBE;
+    memcpy(probe + epochOffset, &epoch, sizeof(uint32_t));
+    memcpy(probe + frameHeaderSize, &now, sizeof(uint64_t));
+    for (const std::unique_ptr<Link> &link : links) {
+        if (link->probeSequence) {
+            link->loss += smoothing * ((link->probeAnswered ? 0 : 1) - link->loss);
+        }
+        link->probeSequence++;
+        link->probeAnswered = false;
+        memcpy(probe + sequenceOffset, &link->probeSequence, sizeof(uint32_t));
+        std::lock_guard<std::mutex> transportLock(link->transportMutex);
+        link->transport->send(MessageView(probe, probeSize), 0, PayloadWriter(), NOBLOCK);
+    }
+    // fails over when the active link did not reply anymore
+    selectLink(now);
+}
+
+void TransportWrapperBonding::evaluate(Link *link, const MessageView &frame) {
+    if (frame.size < frameHeaderSize) {
+        return;
+    }
+    const uint8_t kind = frame.get<uint8_t>();
+    const uint32_t frameEpoch = frame.get<uint32_t>(epochOffset);
+    const uint32_t frameSequence = frame.get<uint32_t>(sequenceOffset);
+    if (kind == PROBE && frame.size >= probeSize) {
+        char reply[probeSize];
+        memcpy(reply, frame.data, probeSize);
+        reply[0] = PROBE_REPLY;
+        std::lock_guard<std::mutex> lock(link->transportMutex);
+        link->transport->send(MessageView(reply, probeSize), 0, PayloadWriter(), NOBLOCK);
+    } else if (kind == PROBE_REPLY && frame.size >= probeSize) {
+        const uint64_t now = nowUs();
+        // 0 is "not measured"
+        const float rtt = std::max(0.001, (now - frame.get<uint64_t>(frameHeaderSize)) / 1000.0);
+        std::lock_guard<std::mutex> lock(mutex);
+        link->rttMs = link->rttMs > 0 ? link->rttMs + smoothing * (rtt - link->rttMs) : rtt;
+        link->lastReplyUs = now;
+        if (frameSequence == link->probeSequence) {
+            link->probeAnswered = true;
+        }
+        selectLink(now);
+    } else if (kind == DATA) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            link->received++;
+            if (isDuplicate(frameEpoch, frameSequence)) {
+                link->duplicates++;
+                return;
+            }
+        }
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (queue.size() >= std::max<size_t>(options.maxQueuedMessages, 1)) {
+            // nobody receives, keep the latest messages
+            queue.pop_front();
+            droppedMessages++;
+        }
+        queue.emplace_back(frame.data + frameHeaderSize, frame.size - frameHeaderSize);
+        queueCondition.notify_one();
+    }
+}
+
+bool TransportWrapperBonding::isDuplicate(const uint32_t &frameEpoch, const uint32_t &frameSequence) {
+    int64_t &slot = receivedSequences[frameSequence % duplicateWindow];
+    const int32_t ahead = static_cast<int32_t>(frameSequence - highestSequence);
+    if (!receivedAny || frameEpoch != peerEpoch || ahead < -static_cast<int32_t>(duplicateWindow)) {
+        // the first message, the peer restarted (its sequence numbers start again) or missed too many
+        receivedSequences.assign(duplicateWindow, -1);
+        receivedAny = true;
+        peerEpoch = frameEpoch;
+        highestSequence = frameSequence;
+    } else if (slot == frameSequence) {
+        return true;
+    } else if (ahead > 0) {
+        highestSequence = frameSequence;
+    }
+    slot = frameSequence;
+    return false;
+}
+
+bool TransportWrapperBonding::isAlive(const Link &link, const uint64_t &now) const {
+    return now < link.lastReplyUs + options.failoverTimeoutMs * 1000;
+}
+
+float TransportWrapperBonding::cost(const Link &link) const {
+    if (link.rttMs <= 0) {
+        // not measured yet
+        return std::numeric_limits<float>::max();
+    }
+    return link.rttMs * (1 + 4 * link.loss);
+}
+
+void TransportWrapperBonding::selectLink(const uint64_t &now) {
+    size_t best = links.size();
+    for (size_t index = 0; index < links.size(); ++index) {
+        if (index != activeLink && isAlive(*links[index], now) && (best == links.size() || cost(*links[index]) < cost(*links[best]))) {
+            best = index;
+        }
+    }
+    if (best == links.size()) {
+        return;
+    }
+    if (!isAlive(*links[activeLink], now) || cost(*links[best]) < options.switchRatio * cost(*links[activeLink])) {
+        activeLink = best;
+    }
+}
+
+}  // namespace robot_remote_control
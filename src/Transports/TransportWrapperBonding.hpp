@@ -0,0 +1,154 @@
+#pragma once
+
+#include "Transport.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief wrapper bonding several links to the same peer (e.g. WiFi and LTE of a vehicle), both sides need a
+ * TransportWrapperBonding with the links in the same order.
+ *
+ * Each link is probed every Options::probeIntervalMs to measure its round trip time and loss. Messages are sent on the best
+ * link which replied to a probe within Options::failoverTimeoutMs, so a dead link is left within this time instead of waiting
+ * for the lost connection of the RobotController (set it below the heartbeat duration). Small, latency-critical messages can be
+ * duplicated on all links (Options::duplicateMaxSize), the receiver drops the copies by their sequence number
+ * (per run of the sending wrapper, a restarted peer starts a new epoch).
+ *
+ * The links need to be message based and bidirectional (e.g. TransportUDT or TransportZmq DEALER pairs), the probes are
+ * answered on the link they were received on. A thread receives from all links, so they should not be used directly anymore.
+ * Each link is used by one thread at a time, so the links do not need to be thread-safe.
+ * @warning it adds 9 bytes to each message
+ */
+class TransportWrapperBonding : public Transport {
+ public:
+    struct Options {
+        Options():probeIntervalMs(50), failoverTimeoutMs(200), duplicateMaxSize(0), switchRatio(0.8), maxQueuedMessages(1000) {}
+        // time between the probes of a link
+        unsigned int probeIntervalMs;
+        // a link without probe reply for this time is not used
+        unsigned int failoverTimeoutMs;
+        // messages up to this size are sent on all alive links, 0 sends all messages on the best link only
+        size_t duplicateMaxSize;
+        // an alive link is only replaced by a link with a cost below switchRatio times its cost, so similar links do not alternate
+        float switchRatio;
+        // received messages waiting for receive(), the oldest one is dropped when full
+        size_t maxQueuedMessages;
+    };
+
+    struct LinkStatistics {
+        // smoothed round trip time of the probes in milliseconds, 0 before the first probe reply
+        float rttMs;
+        // smoothed ratio of unanswered probes
+        float loss;
+        bool alive;
+        uint64_t sent;
+        uint64_t received;
+        // messages which were received on another link already
+        uint64_t duplicates;
+    };
+
+    /**
+     * @param links the transports to the peer, the first one is used until the probes tell otherwise
+     */
+    explicit TransportWrapperBonding(const std::vector<TransportSharedPtr> &links, const Options &options = Options());
+    virtual ~TransportWrapperBonding();
+
+    using Transport::send;
+
+    /**
+     * @brief send data on the best link (or all alive links if it is small enough to be duplicated)
+     *
+     * @param buf the buffer to send
+     * @param Flags flags the flags
+     * @return int number of bytes sent, 0 if no link sent it
+     */
+    virtual int send(const std::string& buf, Flags flags = NONE);
+
+    /**
+     * @brief send header and payload, the payload is written directly into the buffers of the links
+     */
+    virtual int send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags = NONE);
+
+    /**
+     * @brief receive data received on any link (without duplicates)
+     *
+     * @param buf buffer to fill on receive
+     * @param Flags flags the flags
+     * @return int 0 if no data received, size of data otherwise
+     */
+    virtual int receive(std::string* buf, Flags flags = NONE);
+
+    virtual bool waitForData(const unsigned int &timeoutMs);
+
+    /**
+     * @brief the index of the link the messages are sent on
+     */
+    size_t getActiveLink();
+
+    std::vector<LinkStatistics> getLinkStatistics();
+
+    /**
+     * @brief the received messages dropped because the queue was full (Options::maxQueuedMessages)
+     */
+    uint64_t getDroppedMessages();
+
+ private:
+    struct Link {
+        Link():lastReplyUs(0), probeSequence(0), probeAnswered(false), rttMs(0), loss(0), sent(0), received(0), duplicates(0) {}
+        TransportSharedPtr transport;
+        // sending and receiving on the transport, after the mutex of the link state if both are locked
+        std::mutex transportMutex;
+        ReceiveBuffer buffer;
+        uint64_t lastReplyUs;
+        uint32_t probeSequence;
+        bool probeAnswered;
+        float rttMs;
+        float loss;
+        uint64_t sent;
+        uint64_t received;
+        uint64_t duplicates;
+    };
+
+    void run();
+    void probe(const uint64_t &now);
+    void evaluate(Link *link, const MessageView &frame);
+    // true if the sequence number was received before in the epoch
+    bool isDuplicate(const uint32_t &epoch, const uint32_t &sequence);
+    bool isAlive(const Link &link, const uint64_t &now) const;
+    float cost(const Link &link) const;
+    void selectLink(const uint64_t &now);
+
+    Options options;
+    std::vector<std::unique_ptr<Link>> links;
+    std::atomic<bool> running;
+    std::thread receiveThread;
+
+    // the link state and the sending on the links
+    std::mutex mutex;
+    size_t activeLink;
+    // random per instance, the peer resets its duplicate window when it changes
+    uint32_t epoch;
+    uint32_t sequence;
+    std::string frameHeader;
+
+    // the recently received sequence numbers, indexed by sequence % size (only used by the receive thread)
+    std::vector<int64_t> receivedSequences;
+    uint32_t highestSequence;
+    uint32_t peerEpoch;
+    bool receivedAny;
+
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<std::string> queue;
+    uint64_t droppedMessages;
+};
+
+}  // namespace robot_remote_control
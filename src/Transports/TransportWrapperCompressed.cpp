@@ -0,0 +1,179 @@
+#include "TransportWrapperCompressed.hpp"
+#include "../WireHeader.hpp"
+
+#include <netinet/in.h>
+#include <cstring>
+
+namespace robot_remote_control {
+
+TransportWrapperCompressed::TransportWrapperCompressed(std::shared_ptr<Transport> transport, const size_t &minSize):transport(transport), minSize(minSize) {}
+
+void TransportWrapperCompressed::setTypeCompression(const uint16_t &type, bool enable) {
+    if (type >= disabledTypes.size()) {
+        if (enable) {
+            return;
+        }
+        disabledTypes.resize(type + 1, false);
+    }
+    disabledTypes[type] = !enable;
+}
+
+bool TransportWrapperCompressed::compressionEnabled(const MessageView &message) {
+    // the type header is never compressed, so there has to be more
+    if (message.size < minSize || message.size <= sizeof(uint16_t)) {
+        return false;
+    }
+    uint16_t type = message.get<uint16_t>() & ~WIRE_HEADER_FLAG;
+    return type >= disabledTypes.size() || !disabledTypes[type];
+}
+
+int TransportWrapperCompressed::send(const std::string& buf, Flags flags) {
+    MessageView message(buf);
+    if (compressionEnabled(message)) {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        return sendCompressed(message, flags);
+    }
+    const uint8_t mode = RAW;
+    if (transport->send(message, MessageView(reinterpret_cast<const char*>(&mode), sizeof(uint8_t)), flags)) {
+        return buf.size();
+    }
+    return 0;
+}
+
+int TransportWrapperCompressed::send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags) {
+    const size_t size = header.size + payloadSize;
+    bool compress = false;
+    if (size >= minSize && size > sizeof(uint16_t)) {
+        if (header.size >= sizeof(uint16_t)) {
+            compress = compressionEnabled(MessageView(header.data, size));
+        } else {
+            // the type is partly in the payload, just check the size
+            compress = disabledTypes.empty();
+        }
+    }
+
+    if (!compress) {
+        // append the mode directly behind the payload
+        auto writeRaw = [&writePayload, &payloadSize](char* target) {
+            if (payloadSize && writePayload) {
+                writePayload(target);
+            }
+            target[payloadSize] = RAW;
+        };
+        if (transport->send(header, payloadSize + sizeof(uint8_t), writeRaw, flags)) {
+            return size;
+        }
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+    uncompressedSendBuffer.resize(size);
+    char* target = &uncompressedSendBuffer[0];
+    if (header.size) {
+        memcpy(target, header.data, header.size);
+    }
+    if (payloadSize && writePayload) {
+        writePayload(target + header.size);
+    }
+    return sendCompressed(MessageView(uncompressedSendBuffer), flags);
+}
+
+int TransportWrapperCompressed::sendCompressed(const MessageView &message, Flags flags) {
+    const size_t headerSize = sizeof(uint16_t);
+    const size_t trailerSize = sizeof(uint32_t) + sizeof(uint8_t);
+    MessageView rest = message.sub(headerSize);
+
+    // keeps its capacity, so there is no allocation when sizes are similar
+    compressedSendBuffer.resize(headerSize + compressBound(rest.size) + trailerSize);
+    char* target = &compressedSendBuffer[0];
+    size_t compressedSize = compress(rest.data, rest.size, target + headerSize, compressedSendBuffer.size() - headerSize - trailerSize);
+
+    if (compressedSize == 0 || compressedSize >= rest.size) {
+        // compression failed or does not help
+        const uint8_t mode = RAW;
+        if (transport->send(message, MessageView(reinterpret_cast<const char*>(&mode), sizeof(uint8_t)), flags)) {
+            return message.size;
+        }
+        return 0;
+    }
+
+    memcpy(target, message.data, headerSize);
+    uint32_t uncompressedSize = htonl(rest.size);
+    memcpy(target + headerSize + compressedSize, &uncompressedSize, sizeof(uint32_t));
+    target[headerSize + compressedSize + sizeof(uint32_t)] = COMPRESSED;
+
+    if (transport->send(MessageView(target, headerSize + compressedSize + trailerSize), 0, PayloadWriter(), flags)) {
+        return message.size;
+    }
+    return 0;
+}
+
+int TransportWrapperCompressed::receive(std::string* buf, Flags flags) {
+    if (!transport->receive(&receiveBuffer, flags)) {
+        return 0;
+    }
+    MessageView result;
+    int size = unpack(receiveBuffer.view(), &uncompressedReceiveBuffer, &result);
+    buf->assign(result.data, result.size);
+    return size;
+}
+
+namespace {
+    struct CompressedStorage : public ReceiveBuffer::Storage {
+        ReceiveBuffer compressed;
+        std::string uncompressed;
+    };
+}
+
+int TransportWrapperCompressed::receive(ReceiveBuffer* buf, Flags flags) {
+    CompressedStorage* storage = buf->getStorage<CompressedStorage>();
+    int received = 0;
+    MessageView result;
+    if (transport->receive(&storage->compressed, flags)) {
+        received = unpack(storage->compressed.view(), &storage->uncompressed, &result);
+    }
+    buf->setView(result.data, received);
+    return received;
+}
+
+int TransportWrapperCompressed::unpack(const MessageView &received, std::string* uncompressed, MessageView *result) {
+    *result = MessageView(nullptr, 0);
+    if (received.size < sizeof(uint8_t)) {
+        return 0;
+    }
+    const size_t modePos = received.size - sizeof(uint8_t);
+    uint8_t mode = received.get<uint8_t>(modePos);
+
+    if (mode == RAW) {
+        // no copy, just hide the mode
+        *result = MessageView(received.data, modePos);
+        return result->size;
+    }
+
+    const size_t headerSize = sizeof(uint16_t);
+    if (mode != COMPRESSED || received.size < headerSize + sizeof(uint32_t) + sizeof(uint8_t)) {
+        printf("invalid compressed message in %s:%i\n", __FILE__, __LINE__);
+        return 0;
+    }
+    const size_t sizePos = modePos - sizeof(uint32_t);
+    size_t restSize = ntohl(received.get<uint32_t>(sizePos));
+    if (restSize > uncompressBound(received.data + headerSize, sizePos - headerSize)) {
+        // the size is from the wire, do not allocate more than the data can hold
+        printf("invalid compressed message in %s:%i\n", __FILE__, __LINE__);
+        return 0;
+    }
+
+    if (uncompressed->size() < headerSize + restSize) {
+        uncompressed->resize(headerSize + restSize);
+    }
+    char* target = &(*uncompressed)[0];
+    memcpy(target, received.data, headerSize);
+    if (!uncompress(received.data + headerSize, sizePos - headerSize, target + headerSize, restSize)) {
+        printf("unable to uncompress message in %s:%i\n", __FILE__, __LINE__);
+        return 0;
+    }
+    *result = MessageView(target, headerSize + restSize);
+    return result->size;
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Transport.hpp"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief base class of wrappers compressing data before sending (see TransportWrapperLZ4, TransportWrapperZstd)
+ *
+ * Messages smaller than the threshold or of types with disabled compression are sent raw
+ * with one extra byte. The compression buffers are reused for all messages.
+ *
+ * message layout (the first two bytes are not compressed, so telemetry subscriptions still work):
+ *  raw:        [message][uint8_t RAW]
+ *  compressed: [uint16_t type][compressed rest of the message][uint32_t uncompressed size of the rest][uint8_t COMPRESSED]
+ */
+class TransportWrapperCompressed : public Transport {
+ public:
+    /**
+     * @brief Construct a new compressing wrapper
+     *
+     * @param transport the transport to send compressed data with
+     * @param minSize messages smaller than this are sent uncompressed
+     */
+    explicit TransportWrapperCompressed(std::shared_ptr<Transport> transport, const size_t &minSize = 128);
+    virtual ~TransportWrapperCompressed() {}
+
+    using Transport::send;
+
+    /**
+     * @brief send data, compressed if the size is above the threshold and compression is enabled for the type
+     *
+     * @param buf the buffer to send
+     * @param Flags flags the flags
+     * @return int number of bytes sent (uncompressed)
+     */
+    virtual int send(const std::string& buf, Flags flags = NONE);
+
+    /**
+     * @brief uncompressed messages are written into the wrapped transport without extra copy
+     */
+    virtual int send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags = NONE);
+
+    /**
+     * @brief receive data
+     *
+     * @param buf buffer to fill on receive
+     * @param Flags flags the flags
+     * @return int 0 if no data received, size of data otherwise
+     */
+    virtual int receive(std::string* buf, Flags flags = NONE);
+
+    /**
+     * @brief receive data without copy of uncompressed messages
+     *
+     * @param buf buffer to fill on receive, holds the compressed and uncompressed buffers for reuse
+     * @param Flags flags the flags
+     * @return int 0 if no data received, size of data otherwise
+     */
+    virtual int receive(ReceiveBuffer* buf, Flags flags = NONE);
+
+    /**
+     * @brief waits on the wrapped transport
+     */
+    virtual bool waitForData(const unsigned int &timeoutMs) {
+        return transport->waitForData(timeoutMs);
+    }
+
+    /**
+     * @brief the type header is not compressed, so subscriptions are forwarded to the wrapped transport
+     */
+    virtual bool subscribe(const std::string &topic) {
+        return transport->subscribe(topic);
+    }
+
+    virtual bool unsubscribe(const std::string &topic) {
+        return transport->unsubscribe(topic);
+    }
+
+    /**
+     * @brief the peers of the wrapped transport
+     */
+    virtual std::string getPeer() {
+        return transport->getPeer();
+    }
+
+    virtual bool setPeer(const std::string &peer) {
+        return transport->setPeer(peer);
+    }
+
+    virtual void releasePeer(const std::string &peer) {
+        transport->releasePeer(peer);
+    }
+
+    /**
+     * @brief enable or disable compression for a message type (the first uint16_t of a message), enabled by default
+     * @warning should be set before sending
+     *
+     * @param type the message type (e.g. a TelemetryMessageType on the telemetry channel)
+     * @param enable compress messages of this type
+     */
+    void setTypeCompression(const uint16_t &type, bool enable);
+
+    /**
+     * @brief Set the minimum message size for compression
+     */
+    void setMinSize(const size_t &size) {
+        minSize = size;
+    }
+
+ protected:
+    /**
+     * @brief maximum compressed size of size bytes
+     */
+    virtual size_t compressBound(const size_t &size) = 0;
+
+    /**
+     * @brief compress size bytes of source into target
+     *
+     * @return size_t the compressed size, 0 on failure (the message is sent uncompressed)
+     */
+    virtual size_t compress(const char* source, const size_t &size, char* target, const size_t &targetCapacity) = 0;
+
+    /**
+     * @brief uncompress size bytes of source into target, the uncompressed size is known
+     *
+     * @return true if exactly targetSize bytes were uncompressed
+     */
+    virtual bool uncompress(const char* source, const size_t &size, char* target, const size_t &targetSize) = 0;
+
+    /**
+     * @brief maximum uncompressed size of size bytes of source, the size written in a received message
+     * is checked against it before the buffer is allocated
+     *
+     * @return size_t 0 if source can not be uncompressed
+     */
+    virtual size_t uncompressBound(const char* source, const size_t &size) = 0;
+
+ private:
+    enum Mode : uint8_t {RAW = 0, COMPRESSED = 1};
+
+    bool compressionEnabled(const MessageView &message);
+
+    int sendCompressed(const MessageView &message, Flags flags);
+
+    int unpack(const MessageView &received, std::string* uncompressed, MessageView *result);
+
+    std::shared_ptr<Transport> transport;
+    size_t minSize;
+    std::vector<bool> disabledTypes;
+
+    std::mutex sendMutex;
+    std::string uncompressedSendBuffer;
+    std::string compressedSendBuffer;
+
+    // receive(std::string*) only
+    ReceiveBuffer receiveBuffer;
+    std::string uncompressedReceiveBuffer;
+};
+
+}  // end namespace robot_remote_control
@@ -0,0 +1,211 @@
+#include "TransportWrapperFEC.hpp"
+#include "../WireHeader.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <random>
+
+namespace robot_remote_control {
+
+namespace {
+    // [uint16_t type][uint32_t message id][uint16_t index][uint16_t fragments][uint16_t group size][uint16_t fragment size][uint32_t message size]
+    const size_t fragmentHeaderSize = 18;
+
+    void writeHeader(char* target, const uint16_t &type, const uint32_t &messageId, const uint16_t &index, const uint16_t &fragments,
+                     const uint16_t &groupSize, const uint16_t &fragmentSize, const uint32_t &messageSize) {
+        memcpy(target, &type, sizeof(uint16_t));
+        memcpy(target + 2, &messageId, sizeof(uint32_t));
+        memcpy(target + 6, &index, sizeof(uint16_t));
+        memcpy(target + 8, &fragments, sizeof(uint16_t));
+        memcpy(target + 10, &groupSize, sizeof(uint16_t));
+        memcpy(target + 12, &fragmentSize, sizeof(uint16_t));
+        memcpy(target + 14, &messageSize, sizeof(uint32_t));
+    }
+}
+
+TransportWrapperFEC::TransportWrapperFEC(TransportSharedPtr transport, const Options &options):
+    transport(transport),
+    options(options) {
+    // a restarted sender does not continue with ids of messages the receiver completed already
+    std::random_device random;
+    nextMessageId = random();
+    if (this->options.mtu <= fragmentHeaderSize || this->options.mtu > std::numeric_limits<uint16_t>::max()) {
+        printf("TransportWrapperFEC: invalid mtu %lu, using 1400\n", this->options.mtu);
+        this->options.mtu = 1400;
+    }
+}
+
+void TransportWrapperFEC::setGroupSize(const uint16_t &type, const uint16_t &groupSize) {
+    groupSizes[type] = groupSize;
+}
+
+int TransportWrapperFEC::send(const std::string& buf, Flags flags) {
+    std::lock_guard<std::mutex> lock(sendMutex);
+    const uint16_t type = buf.size() >= sizeof(uint16_t) ? MessageView(buf).get<uint16_t>() : 0;
+    auto groupSize = groupSizes.find(type & ~WIRE_HEADER_FLAG);
+    const uint16_t group = groupSize != groupSizes.end() ? groupSize->second : options.defaultGroupSize;
+
+    const size_t fragmentSize = options.mtu - fragmentHeaderSize;
+    const size_t fragments = std::max<size_t>(1, (buf.size() + fragmentSize - 1) / fragmentSize);
+    const size_t groups = group ? (fragments + group - 1) / group : 0;
+    if (fragments + groups > std::numeric_limits<uint16_t>::max()) {
+        printf("TransportWrapperFEC: message of %lu bytes has too many fragments\n", buf.size());
+        return 0;
+    }
+    const uint32_t messageId = nextMessageId++;
+    char header[fragmentHeaderSize];
+
+    for (size_t index = 0; index < fragments; ++index) {
+        const size_t offset = index * fragmentSize;
+        writeHeader(header, type, messageId, index, fragments, group, fragmentSize, buf.size());
+        if (!transport->send(MessageView(header, fragmentHeaderSize), MessageView(buf.data() + offset, std::min(fragmentSize, buf.size() - offset)), flags)) {
+            return 0;
+        }
+    }
+    for (size_t parity = 0; parity < groups; ++parity) {
+        // as long as the longest fragment of the group (only the last one is shorter)
+        const size_t first = parity * group;
+        const size_t last = std::min(first + group, fragments);
+        parityBuffer.assign(std::min(fragmentSize, buf.size() - first * fragmentSize), 0);
+        for (size_t index = first; index < last; ++index) {
+            const size_t offset = index * fragmentSize;
+            const size_t size = std::min(fragmentSize, buf.size() - offset);
+            for (size_t byte = 0; byte < size; ++byte) {
+                parityBuffer[byte] ^= buf[offset + byte];
+            }
+        }
+        writeHeader(header, type, messageId, fragments + parity, fragments, group, fragmentSize, buf.size());
+        // lost parity is not an error
+        transport->send(MessageView(header, fragmentHeaderSize), parityBuffer, flags);
+    }
+    return buf.size();
+}
+
+int TransportWrapperFEC::receive(std::string* buf, Flags flags) {
+    while (transport->receive(&datagram, flags)) {
+        if (addFragment(datagram.view(), buf)) {
+            return buf->size();
+        }
+    }
+    return 0;
+}
+
+bool TransportWrapperFEC::addFragment(const MessageView &view, std::string *buf) {
+    if (view.size < fragmentHeaderSize) {
+        return false;
+    }
+    FragmentHeader header;
+    header.type = view.get<uint16_t>();
+    header.messageId = view.get<uint32_t>(2);
+    header.index = view.get<uint16_t>(6);
+    header.fragments = view.get<uint16_t>(8);
+    header.groupSize = view.get<uint16_t>(10);
+    header.fragmentSize = view.get<uint16_t>(12);
+    header.messageSize = view.get<uint32_t>(14);
+    const MessageView payload = view.sub(fragmentHeaderSize);
+
+    const bool isParity = header.index >= header.fragments;
+    statistics.fragments++;
+    if (isParity) {
+        statistics.parity++;
+    }
+    if (std::find(completed.begin(), completed.end(), header.messageId) != completed.end()) {
+        // late parity or a fragment that was recovered
+        return false;
+    }
+    const size_t groups = header.groupSize ? (header.fragments + header.groupSize - 1) / header.groupSize : 0;
+    if (!header.fragments || !header.fragmentSize || header.index >= header.fragments + groups ||
+        static_cast<uint64_t>(header.fragments) * header.fragmentSize < header.messageSize) {
+        return false;
+    }
+
+    auto entry = pending.find(header.messageId);
+    if (entry == pending.end()) {
+        PendingMessage message;
+        message.header = header;
+        message.data.resize(header.messageSize);
+        message.received.assign(header.fragments, false);
+        message.missing = header.fragments;
+        entry = pending.insert(std::make_pair(header.messageId, message)).first;
+        while (pending.size() > options.maxPending) {
+            // the oldest message waited longest for its fragments
+            auto oldest = pending.begin();
+            if (oldest == entry && ++oldest == pending.end()) {
+                break;
+            }
+            pending.erase(oldest);
+            statistics.dropped++;
+        }
+    }
+    PendingMessage &message = entry->second;
+    const FragmentHeader &first = message.header;
+    if (header.fragments != first.fragments || header.groupSize != first.groupSize || header.fragmentSize != first.fragmentSize ||
+        header.messageSize != first.messageSize || header.type != first.type) {
+        // corrupt or a reused id, the indices do not belong to this message
+        return false;
+    }
+    if (isParity) {
+        message.parity.insert(std::make_pair(header.index - header.fragments, payload.toString()));
+    } else if (!message.received[header.index]) {
+        const size_t offset = static_cast<size_t>(header.index) * header.fragmentSize;
+        if (offset + payload.size > message.header.messageSize) {
+            return false;
+        }
+        if (payload.size) {
+            memcpy(&message.data[offset], payload.data, payload.size);
+        }
+        message.received[header.index] = true;
+        message.missing--;
+    }
+    recover(&message);
+    if (message.missing) {
+        return false;
+    }
+    buf->swap(message.data);
+    pending.erase(entry);
+    completed.push_back(header.messageId);
+    if (completed.size() > options.maxPending * 4) {
+        completed.pop_front();
+    }
+    return true;
+}
+
+void TransportWrapperFEC::recover(PendingMessage *message) {
+    const FragmentHeader &header = message->header;
+    for (const auto &parity : message->parity) {
+        const size_t first = static_cast<size_t>(parity.first) * header.groupSize;
+        const size_t last = std::min<size_t>(first + header.groupSize, header.fragments);
+        size_t missingIndex = last;
+        size_t missing = 0;
+        for (size_t index = first; index < last; ++index) {
+            if (!message->received[index]) {
+                missingIndex = index;
+                missing++;
+            }
+        }
+        if (missing != 1) {
+            continue;
+        }
+        // the missing fragment is the parity xor the others
+        std::string restored = parity.second;
+        for (size_t index = first; index < last; ++index) {
+            if (index == missingIndex) {
+                continue;
+            }
+            const size_t offset = index * header.fragmentSize;
+            const size_t size = std::min<size_t>(header.fragmentSize, header.messageSize - offset);
+            for (size_t byte = 0; byte < size && byte < restored.size(); ++byte) {
+                restored[byte] ^= message->data[offset + byte];
+            }
+        }
+        const size_t offset = missingIndex * header.fragmentSize;
+        const size_t size = std::min<size_t>(header.fragmentSize, header.messageSize - offset);
+        memcpy(&message->data[offset], restored.data(), std::min(size, restored.size()));
+        message->received[missingIndex] = true;
+        message->missing--;
+        statistics.recovered++;
+    }
+}
+
+}  // namespace robot_remote_control
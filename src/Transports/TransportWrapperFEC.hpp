@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Transport.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace robot_remote_control {
+
+/**
+ * @brief wrapper splitting messages into datagrams of at most Options::mtu bytes, with XOR parity per type,
+ * for transports sending unreliably (e.g. the latest-value types of TransportUDT::addLatestValueType()).
+ *
+ * Without the wrapper a message above the MTU is lost when any of its packets is lost. With parity, one parity
+ * datagram is added for each group of groupSize fragments, a lost fragment per group is recovered by the receiver without
+ * retransmission (e.g. a group size of 4 adds 25% and recovers most messages on a link with 5% random loss).
+ *
+ * Each datagram starts with the type of its message, so routing by type (zmq topics, TransportUDT::addLatestValueType()) still works.
+ * Incomplete messages are dropped when more than Options::maxPending newer messages are incomplete.
+ * Both sides need the wrapper, the parity is only configured on the sending side.
+ * @warning it adds 18 bytes to each datagram
+ */
+class TransportWrapperFEC : public Transport {
+ public:
+    struct Options {
+        Options():mtu(1400), defaultGroupSize(0), maxPending(8) {}
+        // maximum size of the datagrams (including the 18 bytes fragment header)
+        size_t mtu;
+        // group size of the types without setGroupSize(), 0 for no parity
+        uint16_t defaultGroupSize;
+        // incomplete messages kept for their missing fragments
+        size_t maxPending;
+    };
+
+    explicit TransportWrapperFEC(TransportSharedPtr transport, const Options &options = Options());
+    virtual ~TransportWrapperFEC() {}
+
+    /**
+     * @brief add a parity datagram for each groupSize fragments of the messages of a type
+     * @warning has to be called before the transport is used
+     *
+     * @param type the message type (WIRE_HEADER_FLAG is masked)
+     * @param groupSize fragments per parity datagram, 1 duplicates each fragment, 0 disables the parity
+     */
+    void setGroupSize(const uint16_t &type, const uint16_t &groupSize);
+
+    using Transport::send;
+
+    /**
+     * @brief send the fragments and parity datagrams of a message
+     *
+     * @param buf the buffer to send
+     * @param Flags flags the flags
+     * @return int number of bytes sent, 0 if a fragment could not be sent
+     */
+    virtual int send(const std::string& buf, Flags flags = NONE);
+
+    /**
+     * @brief receive a complete (or recovered) message
+     *
+     * @param buf buffer to fill on receive
+     * @param Flags flags the flags
+     * @return int 0 if no message was completed, size of data otherwise
+     */
+    virtual int receive(std::string* buf, Flags flags = NONE);
+
+    /**
+     * @brief waits on the wrapped transport (returns true for fragments that do not complete a message)
+     */
+    virtual bool waitForData(const unsigned int &timeoutMs) {
+        return transport->waitForData(timeoutMs);
+    }
+
+    virtual bool subscribe(const std::string &topic) {
+        return transport->subscribe(topic);
+    }
+
+    virtual bool unsubscribe(const std::string &topic) {
+        return transport->unsubscribe(topic);
+    }
+
+    struct Statistics {
+        Statistics():fragments(0), parity(0), recovered(0), dropped(0) {}
+        // received datagrams
+        uint64_t fragments;
+        uint64_t parity;
+        // fragments restored from the parity
+        uint64_t recovered;
+        // incomplete messages given up
+        uint64_t dropped;
+    };
+
+    Statistics getStatistics() const {
+        Statistics result;
+        result.fragments = statistics.fragments.load();
+        result.parity = statistics.parity.load();
+        result.recovered = statistics.recovered.load();
+        result.dropped = statistics.dropped.load();
+        return result;
+    }
+
+ private:
+    struct FragmentHeader {
+        uint16_t type;
+        uint32_t messageId;
+        // data fragments first, the parity datagrams follow
+        uint16_t index;
+        uint16_t fragments;
+        uint16_t groupSize;
+        uint16_t fragmentSize;
+        uint32_t messageSize;
+    };
+
+    struct PendingMessage {
+        FragmentHeader header;
+        std::string data;
+        std::vector<bool> received;
+        std::map<uint16_t, std::string> parity;
+        size_t missing;
+    };
+
+    // true if the fragment completed a message, which is written to buf
+    bool addFragment(const MessageView &datagram, std::string *buf);
+    void recover(PendingMessage *message);
+
+    TransportSharedPtr transport;
+    Options options;
+    std::map<uint16_t, uint16_t> groupSizes;
+
+    std::mutex sendMutex;
+    uint32_t nextMessageId;
+    std::string parityBuffer;
+
+    ReceiveBuffer datagram;
+    std::map<uint32_t, PendingMessage> pending;
+    // ids of the last completed messages, so the late fragments and parity are ignored
+    std::deque<uint32_t> completed;
+    // counted by the receiving thread, read by getStatistics() from any thread
+    struct Counters {
+        Counters():fragments(0), parity(0), recovered(0), dropped(0) {}
+        std::atomic<uint64_t> fragments;
+        std::atomic<uint64_t> parity;
+        std::atomic<uint64_t> recovered;
+        std::atomic<uint64_t> dropped;
+    } statistics;
+};
+
+}  // namespace robot_remote_control
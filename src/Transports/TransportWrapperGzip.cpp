@@ -2,10 +2,23 @@
 
 #include <netinet/in.h>
 #include <zlib.h>
+#include <algorithm>
+#include <cmath>
 
 namespace robot_remote_control {
 
-TransportWrapperGzip::TransportWrapperGzip(std::shared_ptr<Transport> transport, const int &compressionlevel):transport(transport), compressionlevel(compressionlevel) {}
+TransportWrapperGzip::TransportWrapperGzip(std::shared_ptr<Transport> transport, const int &compressionlevel):transport(transport),
+    configuredLevel(compressionlevel),
+    compressionlevel(compressionlevel) {}
+
+bool TransportWrapperGzip::setCompressionEffort(const float &effort) {
+    const int maxLevel = 9;
+    // -1 is the zlib default (6)
+    const int base = configuredLevel < 0 ? 6 : configuredLevel;
+    const float clamped = std::min(1.0f, std::max(0.0f, effort));
+    compressionlevel.store(clamped > 0 ? base + static_cast<int>(std::lround(clamped * (maxLevel - base))) : configuredLevel);
+    return true;
+}
 
 
 int TransportWrapperGzip::send(const std::string& uncompressed, Flags flags) {
@@ -35,21 +48,44 @@ int TransportWrapperGzip::send(const std::string& uncompressed, Flags flags) {
 
 int TransportWrapperGzip::receive(std::string* uncompressed, Flags flags) {
     std::string compressed;
-    transport->receive(&compressed, flags);
+    if (!transport->receive(&compressed, flags)) {
+        return 0;
+    }
+    return uncompress(compressed, uncompressed);
+}
+
+namespace {
+    struct GzipStorage : public ReceiveBuffer::Storage {
+        ReceiveBuffer compressed;
+        std::string uncompressed;
+    };
+}
 
-    const uint32_t* uncompressedSizePtr = reinterpret_cast<const uint32_t*>(compressed.data());
-    uLong uncompressedSize = ntohl(*uncompressedSizePtr);
-    uLong srcLen = compressed.size()-sizeof(uint32_t);
+int TransportWrapperGzip::receive(ReceiveBuffer* buf, Flags flags) {
+    GzipStorage* storage = buf->getStorage<GzipStorage>();
+    int received = 0;
+    if (transport->receive(&storage->compressed, flags)) {
+        received = uncompress(storage->compressed.view(), &storage->uncompressed);
+    }
+    buf->setView(storage->uncompressed.data(), received);
+    return received;
+}
+
+int TransportWrapperGzip::uncompress(const MessageView &compressed, std::string* uncompressed) {
+    if (compressed.size < sizeof(uint32_t)) {
+        return 0;
+    }
+    uLong uncompressedSize = ntohl(compressed.get<uint32_t>());
+    uLong srcLen = compressed.size-sizeof(uint32_t);
     if (uncompressed->size() < uncompressedSize) {
         uncompressed->resize(uncompressedSize);
     }
     Byte* data = const_cast<Byte*>(reinterpret_cast<const Byte*>(uncompressed->data()));
-    const Byte* sourcePtr = reinterpret_cast<const Byte*>(compressed.data()) + sizeof(uint32_t);
-    int res = uncompress(data, &uncompressedSize, sourcePtr, srcLen);
+    const Byte* sourcePtr = reinterpret_cast<const Byte*>(compressed.data) + sizeof(uint32_t);
+    int res = ::uncompress(data, &uncompressedSize, sourcePtr, srcLen);
     uncompressed->resize(uncompressedSize);
     return uncompressedSize;
 }
 
 
 }  // namespace robot_remote_control
-
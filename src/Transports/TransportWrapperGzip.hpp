@@ -3,6 +3,7 @@
 #include "Transport.hpp"
 #include <string>
 #include <memory>
+#include <atomic>
 
 namespace robot_remote_control {
 
@@ -22,6 +23,8 @@ class TransportWrapperGzip : public Transport {
     explicit TransportWrapperGzip(std::shared_ptr<Transport> transport, const int &compressionlevel = -1);
     virtual ~TransportWrapperGzip() {}
 
+    using Transport::send;
+
     /**
      * @brief send data
      * 
@@ -40,10 +43,33 @@ class TransportWrapperGzip : public Transport {
      */
     virtual int receive(std::string* uncompressed, Flags flags = NONE);
 
+    /**
+     * @brief receive data, the compressed data is received without copy from the wrapped transport
+     * 
+     * @param buf buffer to fill on receive, holds the compressed and uncompressed buffers for reuse
+     * @param Flags flags the flags
+     * @return int 0 if no data received, size of data otherwise
+     */
+    virtual int receive(ReceiveBuffer* buf, Flags flags = NONE);
+
+    /**
+     * @brief waits on the wrapped transport
+     */
+    virtual bool waitForData(const unsigned int &timeoutMs) {
+        return transport->waitForData(timeoutMs);
+    }
+
+    /**
+     * @brief raise the level from the configured one (0) to 9 (1)
+     */
+    virtual bool setCompressionEffort(const float &effort);
 
  private:
+    int uncompress(const MessageView &compressed, std::string* uncompressed);
+
     std::shared_ptr<Transport> transport;
-    int compressionlevel;
+    const int configuredLevel;
+    std::atomic<int> compressionlevel;
 };
 
 } // end namespace robot_remote_control
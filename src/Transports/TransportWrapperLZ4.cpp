@@ -0,0 +1,63 @@
+#include "TransportWrapperLZ4.hpp"
+
+#include <lz4.h>
+#include <algorithm>
+#include <cmath>
+
+namespace robot_remote_control {
+
+TransportWrapperLZ4::TransportWrapperLZ4(std::shared_ptr<Transport> transport, const size_t &minSize, const int &acceleration, const std::string &dictionary):
+    TransportWrapperCompressed(transport, minSize),
+    configuredAcceleration(acceleration),
+    acceleration(acceleration),
+    // LZ4 only uses the last 64 kB of a dictionary
+    dictionary(dictionary.size() > 64 * 1024 ? dictionary.substr(dictionary.size() - 64 * 1024) : dictionary),
+    stream(LZ4_createStream()) {}
+
+TransportWrapperLZ4::~TransportWrapperLZ4() {
+    LZ4_freeStream(static_cast<LZ4_stream_t*>(stream));
+}
+
+bool TransportWrapperLZ4::setCompressionEffort(const float &effort) {
+    const float clamped = std::min(1.0f, std::max(0.0f, effort));
+    acceleration.store(configuredAcceleration - static_cast<int>(std::lround(clamped * (configuredAcceleration - 1))));
+    return true;
+}
+
+size_t TransportWrapperLZ4::compressBound(const size_t &size) {
+    return LZ4_compressBound(size);
+}
+
+size_t TransportWrapperLZ4::compress(const char* source, const size_t &size, char* target, const size_t &targetCapacity) {
+    LZ4_stream_t* lz4stream = static_cast<LZ4_stream_t*>(stream);
+    int compressedSize = 0;
+    if (dictionary.size()) {
+        // each message is independent, so the dictionary is the only history
+        LZ4_loadDict(lz4stream, dictionary.data(), dictionary.size());
+        compressedSize = LZ4_compress_fast_continue(lz4stream, source, target, size, targetCapacity, acceleration.load(std::memory_order_relaxed));
+    } else {
+        // reuses the state memory instead of allocating it on each call
+        compressedSize = LZ4_compress_fast_extState(lz4stream, source, target, size, targetCapacity, acceleration.load(std::memory_order_relaxed));
+    }
+    if (compressedSize <= 0) {
+        return 0;
+    }
+    return compressedSize;
+}
+
+bool TransportWrapperLZ4::uncompress(const char* source, const size_t &size, char* target, const size_t &targetSize) {
+    int result = 0;
+    if (dictionary.size()) {
+        result = LZ4_decompress_safe_usingDict(source, target, size, targetSize, dictionary.data(), dictionary.size());
+    } else {
+        result = LZ4_decompress_safe(source, target, size, targetSize);
+    }
+    return result >= 0 && static_cast<size_t>(result) == targetSize;
+}
+
+size_t TransportWrapperLZ4::uncompressBound(const char* source, const size_t &size) {
+    // a byte of a match length extends it by at most 255 bytes
+    return size * 255;
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "TransportWrapperCompressed.hpp"
+#include <string>
+#include <memory>
+#include <atomic>
+
+namespace robot_remote_control {
+
+/**
+ * @brief wrapper to compress data with LZ4 before sending, fast enough to be used for all telemetry
+ *
+ * The compression state is reused for all messages. A dictionary (e.g. a typical serialized JointState)
+ * improves the compression of small repetitive messages, both sides have to use the same dictionary.
+ */
+class TransportWrapperLZ4 : public TransportWrapperCompressed {
+ public:
+    /**
+     * @brief Construct a new LZ4 wrapper
+     *
+     * @param transport the transport to send compressed data with
+     * @param minSize messages smaller than this are sent uncompressed
+     * @param acceleration 1 (default) for best compression, higher values are faster
+     * @param dictionary optional dictionary, has to be the same on both sides (max 64 kB are used)
+     */
+    explicit TransportWrapperLZ4(std::shared_ptr<Transport> transport, const size_t &minSize = 128, const int &acceleration = 1, const std::string &dictionary = "");
+    virtual ~TransportWrapperLZ4();
+
+    /**
+     * @brief lower the acceleration from the configured one (0) to 1, the best compression (1)
+     */
+    virtual bool setCompressionEffort(const float &effort);
+
+ protected:
+    virtual size_t compressBound(const size_t &size);
+    virtual size_t compress(const char* source, const size_t &size, char* target, const size_t &targetCapacity);
+    virtual bool uncompress(const char* source, const size_t &size, char* target, const size_t &targetSize);
+    virtual size_t uncompressBound(const char* source, const size_t &size);
+
+ private:
+    const int configuredAcceleration;
+    std::atomic<int> acceleration;
+    std::string dictionary;
+    // LZ4_stream_t, not in the header to keep lz4.h private
+    void* stream;
+};
+
+}  // end namespace robot_remote_control
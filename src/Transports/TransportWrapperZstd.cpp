@@ -0,0 +1,80 @@
+#include "TransportWrapperZstd.hpp"
+
+#include <zstd.h>
+#include <cstdio>
+#include <algorithm>
+#include <cmath>
+
+namespace robot_remote_control {
+
+TransportWrapperZstd::TransportWrapperZstd(std::shared_ptr<Transport> transport, const size_t &minSize, const int &compressionlevel, const std::string &dictionary):
+    TransportWrapperCompressed(transport, minSize),
+    configuredLevel(compressionlevel),
+    compressionlevel(compressionlevel),
+    cctx(ZSTD_createCCtx()),
+    dctx(ZSTD_createDCtx()),
+    cdict(nullptr),
+    ddict(nullptr) {
+    if (dictionary.size()) {
+        // digested once, not on each message
+        cdict = ZSTD_createCDict(dictionary.data(), dictionary.size(), compressionlevel);
+        ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+    }
+}
+
+TransportWrapperZstd::~TransportWrapperZstd() {
+    ZSTD_freeCDict(static_cast<ZSTD_CDict*>(cdict));
+    ZSTD_freeDDict(static_cast<ZSTD_DDict*>(ddict));
+    ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(cctx));
+    ZSTD_freeDCtx(static_cast<ZSTD_DCtx*>(dctx));
+}
+
+bool TransportWrapperZstd::setCompressionEffort(const float &effort) {
+    if (cdict) {
+        return false;
+    }
+    const int maxLevel = std::max<int>(configuredLevel, maxAdaptiveLevel);
+    const float clamped = std::min(1.0f, std::max(0.0f, effort));
+    compressionlevel.store(configuredLevel + static_cast<int>(std::lround(clamped * (maxLevel - configuredLevel))));
+    return true;
+}
+
+size_t TransportWrapperZstd::compressBound(const size_t &size) {
+    return ZSTD_compressBound(size);
+}
+
+size_t TransportWrapperZstd::compress(const char* source, const size_t &size, char* target, const size_t &targetCapacity) {
+    size_t result = 0;
+    if (cdict) {
+        result = ZSTD_compress_usingCDict(static_cast<ZSTD_CCtx*>(cctx), target, targetCapacity, source, size, static_cast<ZSTD_CDict*>(cdict));
+    } else {
+        result = ZSTD_compressCCtx(static_cast<ZSTD_CCtx*>(cctx), target, targetCapacity, source, size, compressionlevel.load(std::memory_order_relaxed));
+    }
+    if (ZSTD_isError(result)) {
+        printf("zstd compression failed: %s\n", ZSTD_getErrorName(result));
+        return 0;
+    }
+    return result;
+}
+
+bool TransportWrapperZstd::uncompress(const char* source, const size_t &size, char* target, const size_t &targetSize) {
+    size_t result = 0;
+    if (ddict) {
+        result = ZSTD_decompress_usingDDict(static_cast<ZSTD_DCtx*>(dctx), target, targetSize, source, size, static_cast<ZSTD_DDict*>(ddict));
+    } else {
+        result = ZSTD_decompressDCtx(static_cast<ZSTD_DCtx*>(dctx), target, targetSize, source, size);
+    }
+    return !ZSTD_isError(result) && result == targetSize;
+}
+
+size_t TransportWrapperZstd::uncompressBound(const char* source, const size_t &size) {
+    // the frames of compress() have the content size in the header
+    const unsigned long long contentSize = ZSTD_getFrameContentSize(source, size);
+    if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN || contentSize == ZSTD_CONTENTSIZE_ERROR) {
+        return 0;
+    }
+    // the header is received as well, a block of 4 bytes (RLE) holds at most 128 KiB
+    return std::min<unsigned long long>(contentSize, static_cast<unsigned long long>(size) * 32 * 1024);
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "TransportWrapperCompressed.hpp"
+#include <string>
+#include <memory>
+#include <atomic>
+
+namespace robot_remote_control {
+
+/**
+ * @brief wrapper to compress data with Zstandard before sending, better compression than LZ4 (e.g. for maps)
+ *
+ * The compression contexts are reused for all messages. A trained dictionary (zstd --train) improves the
+ * compression of small repetitive messages, both sides have to use the same dictionary.
+ */
+class TransportWrapperZstd : public TransportWrapperCompressed {
+ public:
+    /**
+     * @brief Construct a new Zstd wrapper
+     *
+     * @param transport the transport to send compressed data with
+     * @param minSize messages smaller than this are sent uncompressed
+     * @param compressionlevel 1-19 (negative values for faster compression)
+     * @param dictionary optional dictionary, has to be the same on both sides
+     */
+    explicit TransportWrapperZstd(std::shared_ptr<Transport> transport, const size_t &minSize = 128, const int &compressionlevel = 3, const std::string &dictionary = "");
+    virtual ~TransportWrapperZstd();
+
+    /**
+     * @brief raise the level from the configured one (0) to maxAdaptiveLevel (1),
+     * not supported with a dictionary (its level is fixed when it is digested)
+     */
+    virtual bool setCompressionEffort(const float &effort);
+
+    // higher levels cost too much time for large messages (e.g. maps)
+    enum : int { maxAdaptiveLevel = 12 };
+
+ protected:
+    virtual size_t compressBound(const size_t &size);
+    virtual size_t compress(const char* source, const size_t &size, char* target, const size_t &targetCapacity);
+    virtual bool uncompress(const char* source, const size_t &size, char* target, const size_t &targetSize);
+    virtual size_t uncompressBound(const char* source, const size_t &size);
+
+ private:
+    const int configuredLevel;
+    std::atomic<int> compressionlevel;
+    // zstd types, not in the header to keep zstd.h private
+    void* cctx;
+    void* dctx;
+    void* cdict;
+    void* ddict;
+};
+
+}  // end namespace robot_remote_control
@@ -1,47 +1,199 @@
 #include "TransportZmq.hpp"
+#include "../WireHeader.hpp"
 #include <zmq.hpp>
+#include <cstring>
 
 using namespace robot_remote_control;
 
+namespace {
+    struct ZmqMessageStorage : public ReceiveBuffer::Storage {
+        zmq::message_t msg;
+    };
+}
+
 std::shared_ptr<zmq::context_t> TransportZmq::getContextInstance(unsigned int threads){
     //implements a singleton using a local static variable
     static std::shared_ptr<zmq::context_t> contextInstance = std::shared_ptr<zmq::context_t>(new zmq::context_t(threads));
     return contextInstance;
 };
 
+bool TransportZmq::setIOThreads(const int &threads) {
+    std::shared_ptr<zmq::context_t> context = getContextInstance(threads);
+    return zmq_ctx_set(static_cast<void*>(*context), ZMQ_IO_THREADS, threads) == 0;
+}
 
 
 
-TransportZmq::TransportZmq(const std::string &addr, const ConnectionType &type){
+
+TransportZmq::TransportZmq(const std::string &addr, const ConnectionType &type, const SocketOptions &options):connectionType(type),peerUsesDelimiter(false),subscribedAll(false),nextReceiveSocket(0){
     
     context = getContextInstance();
+    socket = createSocket(addr, type, options);
+    if (type == SUB) {
+        subscribedAll = true;
+    }
+    receiveSockets.push_back(socket);
+}
+
+std::shared_ptr<zmq::socket_t> TransportZmq::createSocket(const std::string &addr, const ConnectionType &type, const SocketOptions &options) {
+    static const int zmqtypes[] = {ZMQ_REQ, ZMQ_REP, ZMQ_PUB, ZMQ_SUB, ZMQ_DEALER, ZMQ_ROUTER, ZMQ_PUSH, ZMQ_PULL};
+    std::shared_ptr<zmq::socket_t> newSocket = std::shared_ptr<zmq::socket_t>(new zmq::socket_t(*(context.get()), zmqtypes[type]));
+
+    // options have to be set before connect/bind to be used for the connections
+    if (options.sendHighWaterMark >= 0) {
+        newSocket->setsockopt(ZMQ_SNDHWM, options.sendHighWaterMark);
+    }
+    if (options.receiveHighWaterMark >= 0) {
+        newSocket->setsockopt(ZMQ_RCVHWM, options.receiveHighWaterMark);
+    }
+    if (options.conflate) {
+        newSocket->setsockopt(ZMQ_CONFLATE, 1);
+    }
+    if (options.linger >= 0) {
+        newSocket->setsockopt(ZMQ_LINGER, options.linger);
+    }
+    if (options.tcpKeepAlive >= 0) {
+        newSocket->setsockopt(ZMQ_TCP_KEEPALIVE, options.tcpKeepAlive);
+    }
+    if (options.tcpKeepAliveIdle >= 0) {
+        newSocket->setsockopt(ZMQ_TCP_KEEPALIVE_IDLE, options.tcpKeepAliveIdle);
+    }
+    if (options.tcpKeepAliveInterval >= 0) {
+        newSocket->setsockopt(ZMQ_TCP_KEEPALIVE_INTVL, options.tcpKeepAliveInterval);
+    }
+    if (options.affinity) {
+        newSocket->setsockopt(ZMQ_AFFINITY, options.affinity);
+    }
+    if (!options.identity.empty()) {
+        newSocket->setsockopt(ZMQ_ROUTING_ID, options.identity.data(), options.identity.size());
+    }
 
     switch(type){
         case REQ:{
-            socket = std::shared_ptr<zmq::socket_t>(new zmq::socket_t(*(context.get()), ZMQ_REQ));
-            socket->setsockopt(ZMQ_REQ_CORRELATE, 1);
-            socket->setsockopt(ZMQ_REQ_RELAXED, 1);
-            socket->connect(addr);
+            newSocket->setsockopt(ZMQ_REQ_CORRELATE, 1);
+            newSocket->setsockopt(ZMQ_REQ_RELAXED, 1);
+            newSocket->connect(addr);
             break;
         }
-        case REP:{
-            socket = std::shared_ptr<zmq::socket_t>(new zmq::socket_t(*(context.get()), ZMQ_REP));
-            socket->bind(addr);
+        case SUB:{
+            newSocket->setsockopt(ZMQ_SUBSCRIBE, NULL, 0);//subscribe all
+            newSocket->connect(addr);
             break;
         }
-        case PUB:{
-            socket = std::shared_ptr<zmq::socket_t>(new zmq::socket_t(*(context.get()), ZMQ_PUB));
-            socket->bind(addr);
+        case DEALER:
+        case PUSH:{
+            newSocket->connect(addr);
             break;
         }
-        case SUB:{
-            socket = std::shared_ptr<zmq::socket_t>(new zmq::socket_t(*(context.get()), ZMQ_SUB));
-            socket->setsockopt(ZMQ_SUBSCRIBE, NULL, 0);//subscribe all
-            socket->connect(addr);
+        case REP:
+        case PUB:
+        case ROUTER:
+        case PULL:{
+            newSocket->bind(addr);
             break;
         }
     }
+    return newSocket;
+}
+
+bool TransportZmq::addLatestValueType(const uint16_t &type, const std::string &addr, SocketOptions options) {
+    if (connectionType != PUB && connectionType != SUB) {
+        return false;
+    }
+    options.conflate = true;
+    std::shared_ptr<zmq::socket_t> latestValueSocket = createSocket(addr, connectionType, options);
+    if (connectionType == SUB) {
+        // the socket only carries this type
+        receiveSockets.push_back(latestValueSocket);
+    }
+    latestValueSockets[type] = latestValueSocket;
+    return true;
+}
+
+bool TransportZmq::receiveMessage(zmq::message_t *msg, int zmqflag){
+    if (receiveSockets.size() > 1) {
+        // SUB with latest value sockets: take the next socket with a message, in turn
+        while (true) {
+            for (size_t i = 0; i < receiveSockets.size(); ++i) {
+                size_t index = (nextReceiveSocket + i) % receiveSockets.size();
+                if (receiveSockets[index]->recv(msg, ZMQ_NOBLOCK)) {
+                    nextReceiveSocket = index + 1;
+                    return true;
+                }
+            }
+            if (zmqflag & ZMQ_NOBLOCK) {
+                return false;
+            }
+            waitForData(1000);
+        }
+    }
+    if (connectionType != ROUTER) {
+        return socket->recv(msg, zmqflag);
+    }
+    // ROUTER: [identity][empty delimiter (REQ peers only)][payload]
+    zmq::message_t identity;
+    if (!socket->recv(&identity, zmqflag)) {
+        return false;
+    }
+    peerIdentity.assign(static_cast<const char*>(identity.data()), identity.size());
+    // multipart messages are delivered at once, no need for NOBLOCK for the other parts
+    socket->recv(msg);
+    peerUsesDelimiter = false;
+    if (msg->size() == 0 && socket->getsockopt<int>(ZMQ_RCVMORE)) {
+        peerUsesDelimiter = true;
+        socket->recv(msg);
+    }
+    if (peerUsesDelimiter) {
+        // for setPeer()
+        delimiterPeers.insert(peerIdentity);
+    } else if (!delimiterPeers.empty()) {
+        delimiterPeers.erase(peerIdentity);
+    }
+    return true;
+}
+
+std::string TransportZmq::getPeer() {
+    if (connectionType != ROUTER) {
+        return std::string();
+    }
+    return peerIdentity;
+}
+
+bool TransportZmq::setPeer(const std::string &peer) {
+    if (connectionType != ROUTER) {
+        return false;
+    }
+    peerIdentity = peer;
+    peerUsesDelimiter = delimiterPeers.count(peer) > 0;
+    return true;
+}
 
+void TransportZmq::releasePeer(const std::string &peer) {
+    delimiterPeers.erase(peer);
+}
+
+bool TransportZmq::sendMessage(zmq::message_t *msg, int zmqflag){
+    if (connectionType == ROUTER) {
+        zmq::message_t identity(peerIdentity.data(), peerIdentity.size());
+        if (!socket->send(identity, zmqflag | ZMQ_SNDMORE)) {
+            return false;
+        }
+        if (peerUsesDelimiter) {
+            zmq::message_t delimiter;
+            socket->send(delimiter, zmqflag | ZMQ_SNDMORE);
+        }
+    }
+    if (!latestValueSockets.empty() && msg->size() >= sizeof(uint16_t)) {
+        uint16_t type;
+        memcpy(&type, msg->data(), sizeof(uint16_t));
+        // both telemetry headers
+        type &= ~WIRE_HEADER_FLAG;
+        auto latestValueSocket = latestValueSockets.find(type);
+        if (latestValueSocket != latestValueSockets.end()) {
+            return latestValueSocket->second->send(*msg, zmqflag);
+        }
+    }
+    return socket->send(*msg, zmqflag);
 }
 
 int TransportZmq::send(const std::string& buf, Flags flags){
@@ -51,20 +203,101 @@ int TransportZmq::send(const std::string& buf, Flags flags){
     if (flags & NOBLOCK){
         zmqflag = ZMQ_NOBLOCK;
     }
-    if (socket->send(msg,zmqflag)){
+    if (sendMessage(&msg, zmqflag)){
         return buf.size();
     }
     return 0;
 }
 
+int TransportZmq::send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags) {
+    // zmq allocates the message memory, it takes ownership of it on send, so there is no further copy
+    zmq::message_t msg(header.size + payloadSize);
+    char* target = static_cast<char*>(msg.data());
+    if (header.size) {
+        memcpy(target, header.data, header.size);
+    }
+    if (payloadSize && writePayload) {
+        writePayload(target + header.size);
+    }
+
+    int zmqflag = 0;
+    if (flags & NOBLOCK) {
+        zmqflag = ZMQ_NOBLOCK;
+    }
+    if (sendMessage(&msg, zmqflag)) {
+        return header.size + payloadSize;
+    }
+    return 0;
+}
+
 int TransportZmq::receive(std::string* buf,Flags flags){
     zmq::message_t requestmsg;
     int zmqflag = 0;
     if (flags & NOBLOCK){
         zmqflag = ZMQ_NOBLOCK;
     }
-    int result = socket->recv(&requestmsg,zmqflag);
+    int result = receiveMessage(&requestmsg,zmqflag);
     *buf = std::string((char*)requestmsg.data(),requestmsg.size());
     return requestmsg.size();
 }
 
+int TransportZmq::receive(ReceiveBuffer* buf, Flags flags) {
+    ZmqMessageStorage* storage = buf->getStorage<ZmqMessageStorage>();
+    int zmqflag = 0;
+    if (flags & NOBLOCK) {
+        zmqflag = ZMQ_NOBLOCK;
+    }
+    if (!receiveMessage(&storage->msg, zmqflag)) {
+        buf->setView(nullptr, 0);
+        return 0;
+    }
+    buf->setView(static_cast<const char*>(storage->msg.data()), storage->msg.size());
+    return storage->msg.size();
+}
+
+void TransportZmq::preallocate(ReceiveBuffer* buf, const size_t &bytes) {
+    if (buf) {
+        buf->getStorage<ZmqMessageStorage>();
+    }
+    Transport::preallocate(nullptr, bytes);
+}
+
+bool TransportZmq::waitForData(const unsigned int &timeoutMs) {
+    if (receiveSockets.size() > 1) {
+        std::vector<zmq::pollitem_t> items;
+        items.reserve(receiveSockets.size());
+        for (const std::shared_ptr<zmq::socket_t> &receiveSocket : receiveSockets) {
+            zmq::pollitem_t item = {static_cast<void*>(*receiveSocket), 0, ZMQ_POLLIN, 0};
+            items.push_back(item);
+        }
+        return zmq::poll(items.data(), items.size(), timeoutMs) > 0;
+    }
+    zmq::pollitem_t items[] = {{static_cast<void*>(*socket), 0, ZMQ_POLLIN, 0}};
+    zmq::poll(items, 1, timeoutMs);
+    return items[0].revents & ZMQ_POLLIN;
+}
+
+bool TransportZmq::subscribe(const std::string &topic) {
+    if (connectionType != SUB) {
+        return false;
+    }
+    // latest value sockets filter the same way, so unsubscribed types are not received on them either
+    for (const std::shared_ptr<zmq::socket_t> &receiveSocket : receiveSockets) {
+        if (subscribedAll) {
+            receiveSocket->setsockopt(ZMQ_UNSUBSCRIBE, NULL, 0);
+        }
+        receiveSocket->setsockopt(ZMQ_SUBSCRIBE, topic.data(), topic.size());
+    }
+    subscribedAll = false;
+    return true;
+}
+
+bool TransportZmq::unsubscribe(const std::string &topic) {
+    if (connectionType != SUB) {
+        return false;
+    }
+    for (const std::shared_ptr<zmq::socket_t> &receiveSocket : receiveSockets) {
+        receiveSocket->setsockopt(ZMQ_UNSUBSCRIBE, topic.data(), topic.size());
+    }
+    return true;
+}
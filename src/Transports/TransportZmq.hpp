@@ -3,11 +3,16 @@
 #include "Transport.hpp"
 #include <memory>
 #include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <cstdint>
 
 
 namespace zmq{
     class context_t;
     class socket_t;
+    class message_t;
 }
 
 namespace robot_remote_control
@@ -19,24 +24,158 @@ namespace robot_remote_control
 
         public:
 
-            enum ConnectionType {REQ,REP,PUB,SUB};
-
-            TransportZmq(const std::string &addr, const ConnectionType &type);
+            /**
+             * @brief DEALER (controller side) and ROUTER (robot side) allow several outstanding requests,
+             * the ROUTER replies to the peer of the last received message (ROUTER also accepts REQ peers).
+             * PUSH (controller side, connects) and PULL (robot side, binds) pass messages in one direction without replies
+             */
+            enum ConnectionType {REQ,REP,PUB,SUB,DEALER,ROUTER,PUSH,PULL};
+
+            /**
+             * @brief zmq socket options, negative values (and affinity 0) keep the zmq defaults
+             */
+            struct SocketOptions {
+                SocketOptions():sendHighWaterMark(-1), receiveHighWaterMark(-1), conflate(false), linger(-1),
+                                tcpKeepAlive(-1), tcpKeepAliveIdle(-1), tcpKeepAliveInterval(-1), affinity(0) {}
+                // ZMQ_SNDHWM/ZMQ_RCVHWM: maximum number of queued messages
+                int sendHighWaterMark;
+                int receiveHighWaterMark;
+                // ZMQ_CONFLATE: only keep the newest message (single part messages only, e.g. PUB/SUB)
+                bool conflate;
+                // ZMQ_LINGER: milliseconds to keep unsent messages after closing
+                int linger;
+                // ZMQ_TCP_KEEPALIVE (1 on, 0 off), ZMQ_TCP_KEEPALIVE_IDLE, ZMQ_TCP_KEEPALIVE_INTVL (seconds)
+                int tcpKeepAlive;
+                int tcpKeepAliveIdle;
+                int tcpKeepAliveInterval;
+                // ZMQ_AFFINITY: bitmask of the I/O threads handling the connections of the socket
+                uint64_t affinity;
+                // ZMQ_ROUTING_ID: the identity of a REQ or DEALER socket on the ROUTER, e.g. to set the priority of a controller
+                // (ControlledRobot::setClientPriority()), empty for a random one
+                std::string identity;
+            };
+
+            TransportZmq(const std::string &addr, const ConnectionType &type, const SocketOptions &options = SocketOptions());
             virtual ~TransportZmq(){};
 
+            /**
+             * @brief the zmq context shared by all TransportZmq instances
+             *
+             * @param threads number of I/O threads, only used by the first call, which creates the context
+             */
             static std::shared_ptr<zmq::context_t> getContextInstance(unsigned int threads = 1);
 
+            /**
+             * @brief set the number of I/O threads of the shared context (e.g. many robots on one controller, see RobotControllerHub)
+             * @warning only has effect before the first TransportZmq is created
+             *
+             * @return false if the value was not accepted by zmq
+             */
+            static bool setIOThreads(const int &threads);
+
+            using Transport::send;
+
             int send(const std::string& buf, Flags flags = NONE);
 
-            int receive(std::string* buf, Flags flags = NONE);
+            /**
+             * @brief the payload is written directly into the zmq::message_t, which is handed over to zmq on send
+             */
+            int send(const MessageView &header, const size_t &payloadSize, const PayloadWriter &writePayload, Flags flags = NONE);
 
+            int receive(std::string* buf, Flags flags = NONE);
 
+            /**
+             * @brief receive without copy, buf holds the zmq::message_t until the next receive into buf
+             */
+            int receive(ReceiveBuffer* buf, Flags flags = NONE);
+
+            /**
+             * @brief creates the zmq::message_t storage of buf, the message memory itself is managed by zmq
+             * (small messages like command acknowledgements are stored inside the zmq::message_t)
+             */
+            void preallocate(ReceiveBuffer* buf, const size_t &bytes);
+
+            /**
+             * @brief uses zmq::poll to wait for incoming messages
+             */
+            bool waitForData(const unsigned int &timeoutMs);
+
+            /**
+             * @brief set ZMQ_SUBSCRIBE on SUB sockets, the PUB side filters messages before sending.
+             * The first call removes the default subscription to all messages
+             *
+             * @return false if this is not a SUB socket
+             */
+            bool subscribe(const std::string &topic);
+
+            /**
+             * @brief remove a ZMQ_SUBSCRIBE topic on SUB sockets
+             *
+             * @return false if this is not a SUB socket
+             */
+            bool unsubscribe(const std::string &topic);
+
+            /**
+             * @brief send/receive a telemetry type on its own socket with ZMQ_CONFLATE, so only the newest message of the
+             * type is queued (e.g. CURRENT_POSE, CURRENT_TWIST, IMU_VALUES) while the others still use the main socket.
+             * Messages are routed by their type header (the first uint16_t), both sides have to add the same types
+             * with matching addresses (PUB binds, SUB connects), e.g.
+             *
+             *      robotTelemetry->addLatestValueType(CURRENT_POSE, "tcp://0.0.0.0:7003");
+             *      controllerTelemetry->addLatestValueType(CURRENT_POSE, "tcp://127.0.0.1:7003");
+             *
+             * On the controller side, RobotController::setLatestValueTelemetry() also keeps only the newest message in the buffer.
+             * @warning has to be called before the transport is used, TELEMETRY_BATCH messages are not routed
+             *
+             * @param type the telemetry type
+             * @param addr the address of the socket of this type
+             * @param options options of the socket, conflate is always set
+             * @return false if this is not a PUB or SUB socket
+             */
+            bool addLatestValueType(const uint16_t &type, const std::string &addr, SocketOptions options = SocketOptions());
+
+            /**
+             * @brief ROUTER: the identity of the peer of the last received message (SocketOptions::identity of the peer if set)
+             */
+            std::string getPeer();
+
+            /**
+             * @brief ROUTER: send to a peer returned by getPeer()
+             *
+             * @return false if this is not a ROUTER socket
+             */
+            bool setPeer(const std::string &peer);
+
+            /**
+             * @brief ROUTER: forget whether a peer is a REQ socket, its next message sets it again
+             */
+            void releasePeer(const std::string &peer);
 
 
         private:
+            std::shared_ptr<zmq::socket_t> createSocket(const std::string &addr, const ConnectionType &type, const SocketOptions &options);
+
+            // handle the routing frames of the ROUTER socket type and the latest value sockets
+            bool receiveMessage(zmq::message_t *msg, int zmqflag);
+            bool sendMessage(zmq::message_t *msg, int zmqflag);
 
             std::shared_ptr<zmq::context_t> context;
             std::shared_ptr<zmq::socket_t> socket;
 
+            // see addLatestValueType()
+            std::map<uint16_t, std::shared_ptr<zmq::socket_t> > latestValueSockets;
+            // SUB: the main socket and the latest value sockets, received in turn
+            std::vector< std::shared_ptr<zmq::socket_t> > receiveSockets;
+            size_t nextReceiveSocket;
+
+            ConnectionType connectionType;
+            // identity of the peer of the last received message (ROUTER only)
+            std::string peerIdentity;
+            bool peerUsesDelimiter;
+            // ROUTER: the REQ peers, see setPeer(), removed by releasePeer()
+            std::set<std::string> delimiterPeers;
+            // SUB only: the default empty topic subscription (all messages) is set
+            bool subscribedAll;
+
     };
 }
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+namespace robot_remote_control {
+
+/**
+ * @brief wait-free latest-value store for exactly one writer thread and one reader thread.
+ *
+ * Each side owns one of three slots, the third holds the latest published value. Publishing and fetching
+ * swap the own slot with it, so neither side waits for the other and a value is never copied while the other
+ * side may access it. So TYPE can be any type (e.g. a protobuf message), unlike a seqlock that needs trivially copyable types.
+ * Slots are reused, writing into one keeps the memory of the value written two generations before (e.g. of repeated fields).
+ */
+template <class TYPE> class TripleBuffer {
+ public:
+    TripleBuffer():writerSlot(0), readerSlot(1), latest(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /**
+     * @brief write a new value, the reader sees it after the next fetch()
+     *
+     * @param fill writes the value into the slot of the writer (containing an old value), nothing is published if it returns false
+     * @return true if published
+     */
+    bool write(const std::function<bool(TYPE *slot)> &fill) {
+        if (!fill(&slots[writerSlot].value)) {
+            return false;
+        }
+        publish();
+        return true;
+    }
+
+    void write(const TYPE &value) {
+        slots[writerSlot].value = value;
+        publish();
+    }
+
+    /**
+     * @brief take the latest published value into the slot of the reader
+     *
+     * @return true if there was a new value since the last fetch()
+     */
+    bool fetch() {
+        if (!(latest.load(std::memory_order_relaxed) & NEW_FLAG)) {
+            return false;
+        }
+        uint8_t previous = latest.exchange(readerSlot, std::memory_order_acq_rel);
+        readerSlot = previous & INDEX_MASK;
+        return true;
+    }
+
+    /**
+     * @brief the value of the last fetch(), only valid in the reader thread until the next fetch()
+     */
+    const TYPE& get() const {
+        return slots[readerSlot].value;
+    }
+
+    /**
+     * @brief true if a value was published that was not fetched yet, can be called from any thread
+     */
+    bool hasNew() const {
+        return latest.load(std::memory_order_acquire) & NEW_FLAG;
+    }
+
+ private:
+    enum : uint8_t { INDEX_MASK = 0x3, NEW_FLAG = 0x4 };
+    enum : size_t { CACHELINE_SIZE = 64 };
+
+    void publish() {
+        uint8_t previous = latest.exchange(writerSlot | NEW_FLAG, std::memory_order_acq_rel);
+        writerSlot = previous & INDEX_MASK;
+    }
+
+    // padded (no alignas, the buffers are members of heap allocated classes), the writer and the reader
+    // work on different slots at the same time
+    struct Slot {
+        TYPE value;
+        char padding[CACHELINE_SIZE];
+    };
+    Slot slots[3];
+
+    uint8_t writerSlot;
+    char writerPadding[CACHELINE_SIZE];
+    uint8_t readerSlot;
+    char readerPadding[CACHELINE_SIZE];
+    // the index of the latest published value and NEW_FLAG if not fetched yet
+    std::atomic<uint8_t> latest;
+};
+
+}  // namespace robot_remote_control
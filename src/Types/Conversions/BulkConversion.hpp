@@ -0,0 +1,209 @@
+#pragma once
+
+#include "../RobotRemoteControl.pb.h"
+#include "PackedPointCloud.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__AVX__) || defined(__SSE2__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define RRC_BULK_NEON
+#endif
+
+namespace robot_remote_control {
+
+/**
+ * @brief conversion kernels on contiguous arrays for the framework converters (rock, ros), instead of one protobuf setter per scalar.
+ * They use SSE2/AVX or NEON (aarch64) when the compiler targets it (e.g. -mavx or -march=native), a plain loop otherwise.
+ * The double arrays of Eigen vectors (e.g. std::vector<base::Point>, base::Vector4d colors) are contiguous, so they can be
+ * converted with one call: narrow(points.data()->data(), floats, points.size() * 3).
+ */
+namespace BulkConversion {
+
+    /**
+     * @brief convert count doubles to floats
+     */
+    inline void narrow(const double* from, float* to, const size_t &count) {
+        size_t i = 0;
+#if defined(__AVX__)
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(to + i, _mm256_cvtpd_ps(_mm256_loadu_pd(from + i)));
+        }
+#elif defined(__SSE2__)
+        for (; i + 4 <= count; i += 4) {
+            const __m128 low = _mm_cvtpd_ps(_mm_loadu_pd(from + i));
+            const __m128 high = _mm_cvtpd_ps(_mm_loadu_pd(from + i + 2));
+            _mm_storeu_ps(to + i, _mm_movelh_ps(low, high));
+        }
+#elif defined(RRC_BULK_NEON)
+        for (; i + 4 <= count; i += 4) {
+            vst1q_f32(to + i, vcombine_f32(vcvt_f32_f64(vld1q_f64(from + i)), vcvt_f32_f64(vld1q_f64(from + i + 2))));
+        }
+#endif
+        for (; i < count; ++i) {
+            to[i] = static_cast<float>(from[i]);
+        }
+    }
+
+    /**
+     * @brief convert count floats to doubles
+     */
+    inline void widen(const float* from, double* to, const size_t &count) {
+        size_t i = 0;
+#if defined(__AVX__)
+        for (; i + 4 <= count; i += 4) {
+            _mm256_storeu_pd(to + i, _mm256_cvtps_pd(_mm_loadu_ps(from + i)));
+        }
+#elif defined(__SSE2__)
+        for (; i + 4 <= count; i += 4) {
+            const __m128 values = _mm_loadu_ps(from + i);
+            _mm_storeu_pd(to + i, _mm_cvtps_pd(values));
+            _mm_storeu_pd(to + i + 2, _mm_cvtps_pd(_mm_movehl_ps(values, values)));
+        }
+#elif defined(RRC_BULK_NEON)
+        for (; i + 4 <= count; i += 4) {
+            const float32x4_t values = vld1q_f32(from + i);
+            vst1q_f64(to + i, vcvt_f64_f32(vget_low_f32(values)));
+            vst1q_f64(to + i + 2, vcvt_high_f64_f32(values));
+        }
+#endif
+        for (; i < count; ++i) {
+            to[i] = from[i];
+        }
+    }
+
+    /**
+     * @brief rigid transformation of points: p' = R * p + t
+     */
+    struct Transform {
+        // the columns of R and t, the 4th value is 0 (one SIMD register each)
+        float columns[4][4];
+
+        /**
+         * @brief the transformation of the pose, from its frame into the frame of the pose
+         * (an unset orientation is the identity)
+         */
+        static Transform fromPose(const Pose &pose) {
+            double x = pose.orientation().x(), y = pose.orientation().y(), z = pose.orientation().z(), w = pose.orientation().w();
+            const double norm = std::sqrt(x*x + y*y + z*z + w*w);
+            if (norm > 0) {
+                x /= norm; y /= norm; z /= norm; w /= norm;
+            } else {
+                w = 1;
+            }
+            const double rotation[3][3] = {{1 - 2*(y*y + z*z),     2*(x*y - z*w),     2*(x*z + y*w)},
+                                           {    2*(x*y + z*w), 1 - 2*(x*x + z*z),     2*(y*z - x*w)},
+                                           {    2*(x*z - y*w),     2*(y*z + x*w), 1 - 2*(x*x + y*y)}};
+            const double translation[3] = {pose.position().x(), pose.position().y(), pose.position().z()};
+            Transform transform;
+            for (int row = 0; row < 3; ++row) {
+                for (int column = 0; column < 3; ++column) {
+                    transform.columns[column][row] = rotation[row][column];
+                }
+                transform.columns[3][row] = translation[row];
+            }
+            for (int column = 0; column < 4; ++column) {
+                transform.columns[column][3] = 0;
+            }
+            return transform;
+        }
+
+        /**
+         * @brief the transformation into the frame of the pose (e.g. world points relative to the sensor pose)
+         */
+        static Transform toPose(const Pose &pose) {
+            const Transform forward = fromPose(pose);
+            Transform inverse;
+            // R^T and -R^T * t
+            for (int row = 0; row < 3; ++row) {
+                for (int column = 0; column < 3; ++column) {
+                    inverse.columns[column][row] = forward.columns[row][column];
+                }
+                inverse.columns[3][row] = -(forward.columns[row][0] * forward.columns[3][0] + forward.columns[row][1] * forward.columns[3][1]
+                                            + forward.columns[row][2] * forward.columns[3][2]);
+            }
+            for (int column = 0; column < 4; ++column) {
+                inverse.columns[column][3] = 0;
+            }
+            return inverse;
+        }
+    };
+
+    /**
+     * @brief transform count points of float x,y,z (e.g. PackedPointCloud::Point), from and to may be the same memory
+     */
+    inline void transform(const float* from, float* to, const size_t &count, const Transform &transform) {
+        if (!count) {
+            return;
+        }
+        size_t i = 0;
+        const float* c0 = transform.columns[0];
+        const float* c1 = transform.columns[1];
+        const float* c2 = transform.columns[2];
+        const float* t = transform.columns[3];
+#if defined(__SSE2__) || defined(RRC_BULK_NEON)
+        // one point per iteration: the 4th lane of the store overwrites the x of the next point, which was read already
+        float x = from[0], y = from[1], z = from[2];
+    #if defined(__SSE2__)
+        const __m128 r0 = _mm_loadu_ps(c0), r1 = _mm_loadu_ps(c1), r2 = _mm_loadu_ps(c2), r3 = _mm_loadu_ps(t);
+        for (; i + 1 < count; ++i) {
+            const __m128 point = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, _mm_set1_ps(x)), _mm_mul_ps(r1, _mm_set1_ps(y))),
+                                            _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(z)), r3));
+            x = from[3 * i + 3]; y = from[3 * i + 4]; z = from[3 * i + 5];
+            _mm_storeu_ps(to + 3 * i, point);
+        }
+    #else
+        const float32x4_t r0 = vld1q_f32(c0), r1 = vld1q_f32(c1), r2 = vld1q_f32(c2), r3 = vld1q_f32(t);
+        for (; i + 1 < count; ++i) {
+            const float32x4_t point = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(r3, r0, x), r1, y), r2, z);
+            x = from[3 * i + 3]; y = from[3 * i + 4]; z = from[3 * i + 5];
+            vst1q_f32(to + 3 * i, point);
+        }
+    #endif
+        // the last point is not followed by another one
+        to[3 * i] = c0[0] * x + c1[0] * y + c2[0] * z + t[0];
+        to[3 * i + 1] = c0[1] * x + c1[1] * y + c2[1] * z + t[1];
+        to[3 * i + 2] = c0[2] * x + c1[2] * y + c2[2] * z + t[2];
+#else
+        for (; i < count; ++i) {
+            const float x = from[3 * i], y = from[3 * i + 1], z = from[3 * i + 2];
+            to[3 * i] = c0[0] * x + c1[0] * y + c2[0] * z + t[0];
+            to[3 * i + 1] = c0[1] * x + c1[1] * y + c2[1] * z + t[1];
+            to[3 * i + 2] = c0[2] * x + c1[2] * y + c2[2] * z + t[2];
+        }
+#endif
+    }
+
+    /**
+     * @brief express the points relative to origin and set it as PointCloud::origin (the cloud gets packed)
+     *
+     * @param origin pose of the new origin in the current frame of the points
+     */
+    inline void toOrigin(PointCloud *cloud, const Pose &origin) {
+        PackedPointCloud::pack(cloud);
+        const size_t count = PackedPointCloud::size(*cloud);
+        if (count) {
+            float* points = reinterpret_cast<float*>(&(*cloud->mutable_packed_points())[0]);
+            transform(points, points, count, Transform::toPose(origin));
+        }
+        *cloud->mutable_origin() = origin;
+    }
+
+    /**
+     * @brief express the points in the frame of the cloud again (the frame of PointCloud::origin) and clear the origin
+     */
+    inline void fromOrigin(PointCloud *cloud) {
+        PackedPointCloud::pack(cloud);
+        const size_t count = PackedPointCloud::size(*cloud);
+        if (count && cloud->has_origin()) {
+            float* points = reinterpret_cast<float*>(&(*cloud->mutable_packed_points())[0]);
+            transform(points, points, count, Transform::fromPose(cloud->origin()));
+        }
+        cloud->clear_origin();
+    }
+
+}  // namespace BulkConversion
+}  // namespace robot_remote_control
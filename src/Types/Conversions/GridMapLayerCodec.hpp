@@ -0,0 +1,292 @@
+#pragma once
+
+#include "../RobotRemoteControl.pb.h"
+#include <string>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstdio>
+
+namespace robot_remote_control {
+
+/**
+ * @brief compact encodings of GridMap layers (SimpleSensor with size), the values are indexed x+y*size.x.
+ *
+ * QUANTIZED_8BIT_LAYER/QUANTIZED_16BIT_LAYER: one code per cell between the minimum and maximum of the layer,
+ * the error is at most quantization_scale/2, the maximum code is NaN
+ * SPARSE_LAYER: lossless, runs of empty cells (NaN or 0, whichever is more common) are only stored as their length
+ */
+namespace GridMapLayerCodec {
+
+    /**
+     * @brief number of cells of a layer, 0 if it is a single value
+     */
+    inline size_t cells(const SimpleSensor &layer) {
+        return static_cast<size_t>(layer.size().x()) * static_cast<size_t>(layer.size().y());
+    }
+
+    inline bool isEmptyCell(const float &value, const float &emptyValue) {
+        return std::isnan(emptyValue) ? std::isnan(value) : value == emptyValue;
+    }
+
+    /**
+     * @brief what an encoder needs to know about the values of a layer, collected in a single pass
+     */
+    struct LayerStatistics {
+        LayerStatistics():min(0), max(0), finite(0), infinite(0), nanCells(0), zeroCells(0), nanRuns(0), zeroRuns(0) {}
+        float min;
+        float max;
+        size_t finite;
+        size_t infinite;
+        size_t nanCells;
+        size_t zeroCells;
+        // number of runs of non-empty cells, if NaN/0 is the empty value
+        size_t nanRuns;
+        size_t zeroRuns;
+
+        float emptyValue() const {
+            return (nanCells >= zeroCells) ? std::numeric_limits<float>::quiet_NaN() : 0;
+        }
+
+        /**
+         * @brief approximated size of the sparse encoding (two varints per run, 4 bytes per value)
+         */
+        size_t sparseSize(const size_t &cells) const {
+            if (nanCells >= zeroCells) {
+                return nanRuns * 2 * 3 + (cells - nanCells) * sizeof(float);
+            }
+            return zeroRuns * 2 * 3 + (cells - zeroCells) * sizeof(float);
+        }
+    };
+
+    inline LayerStatistics getStatistics(const SimpleSensor &layer) {
+        LayerStatistics stats;
+        bool lastNan = true, lastZero = true;
+        for (const float &value : layer.value()) {
+            bool nan = std::isnan(value);
+            bool zero = value == 0;
+            if (nan) {
+                stats.nanCells++;
+            } else if (std::isinf(value)) {
+                stats.infinite++;
+            } else {
+                if (!stats.finite || value < stats.min) {
+                    stats.min = value;
+                }
+                if (!stats.finite || value > stats.max) {
+                    stats.max = value;
+                }
+                stats.finite++;
+            }
+            if (zero) {
+                stats.zeroCells++;
+            }
+            if (!nan && lastNan) {
+                stats.nanRuns++;
+            }
+            if (!zero && lastZero) {
+                stats.zeroRuns++;
+            }
+            lastNan = nan;
+            lastZero = zero;
+        }
+        return stats;
+    }
+
+    /**
+     * @brief max code for values of a bit depth, the code above is NaN
+     */
+    inline uint32_t maxQuantizationCode(const uint32_t &bits) {
+        return (1u << bits) - 2;
+    }
+
+    inline float quantizationScale(const LayerStatistics &stats, const uint32_t &bits) {
+        return (stats.max - stats.min) / maxQuantizationCode(bits);
+    }
+
+    template <class CODE> bool encodeQuantized(SimpleSensor *layer, const LayerStatistics &stats, const uint32_t &bits) {
+        if (stats.infinite) {
+            return false;
+        }
+        const uint32_t maxCode = maxQuantizationCode(bits);
+        const double scale = quantizationScale(stats, bits);
+        const double offset = stats.min;
+        std::string quantized;
+        quantized.resize(layer->value_size() * sizeof(CODE));
+        CODE* target = reinterpret_cast<CODE*>(&quantized[0]);
+        for (const float &value : layer->value()) {
+            if (std::isnan(value)) {
+                *target++ = maxCode + 1;
+            } else if (scale > 0) {
+                *target++ = std::min<uint32_t>(std::lround((value - offset) / scale), maxCode);
+            } else {
+                *target++ = 0;
+            }
+        }
+        layer->clear_value();
+        layer->set_quantized_values(std::move(quantized));
+        layer->set_quantization_scale(scale);
+        layer->set_quantization_offset(offset);
+        layer->set_encoding(bits == 8 ? QUANTIZED_8BIT_LAYER : QUANTIZED_16BIT_LAYER);
+        return true;
+    }
+
+    template <class CODE> bool decodeQuantized(SimpleSensor *layer) {
+        const size_t count = layer->quantized_values().size() / sizeof(CODE);
+        if (count != cells(*layer)) {
+            printf("invalid quantized layer %s\n", layer->name().c_str());
+            return false;
+        }
+        const CODE nanCode = maxQuantizationCode(sizeof(CODE) * 8) + 1;
+        const double scale = layer->quantization_scale();
+        const double offset = layer->quantization_offset();
+        const CODE* source = reinterpret_cast<const CODE*>(layer->quantized_values().data());
+        layer->mutable_value()->Resize(count, 0);
+        float* target = layer->mutable_value()->mutable_data();
+        for (size_t i = 0; i < count; ++i) {
+            target[i] = (source[i] == nanCode) ? std::numeric_limits<float>::quiet_NaN() : offset + source[i] * scale;
+        }
+        layer->clear_quantized_values();
+        layer->clear_quantization_scale();
+        layer->clear_quantization_offset();
+        return true;
+    }
+
+    inline bool encodeSparse(SimpleSensor *layer, const LayerStatistics &stats) {
+        const float emptyValue = stats.emptyValue();
+        google::protobuf::RepeatedField<float> values;
+        values.Swap(layer->mutable_value());
+        layer->mutable_run_values()->Reserve(values.size() - (std::isnan(emptyValue) ? stats.nanCells : stats.zeroCells));
+        bool empty = true;
+        uint32_t run = 0;
+        for (const float &value : values) {
+            bool emptyCell = isEmptyCell(value, emptyValue);
+            if (emptyCell != empty) {
+                layer->add_run_lengths(run);
+                run = 0;
+                empty = emptyCell;
+            }
+            if (!emptyCell) {
+                layer->add_run_values(value);
+            }
+            run++;
+        }
+        layer->add_run_lengths(run);
+        layer->set_empty_value(emptyValue);
+        layer->set_encoding(SPARSE_LAYER);
+        return true;
+    }
+
+    inline bool decodeSparse(SimpleSensor *layer) {
+        const size_t count = cells(*layer);
+        const float emptyValue = layer->empty_value();
+        layer->mutable_value()->Resize(count, emptyValue);
+        float* target = layer->mutable_value()->mutable_data();
+        size_t pos = 0, valueIndex = 0;
+        bool empty = true;
+        for (const uint32_t &run : layer->run_lengths()) {
+            if (run > count - pos || (!empty && valueIndex + run > static_cast<size_t>(layer->run_values_size()))) {
+                printf("invalid sparse layer %s\n", layer->name().c_str());
+                layer->clear_value();
+                return false;
+            }
+            if (!empty) {
+                std::copy(layer->run_values().data() + valueIndex, layer->run_values().data() + valueIndex + run, target + pos);
+                valueIndex += run;
+            }
+            pos += run;
+            empty = !empty;
+        }
+        layer->clear_run_lengths();
+        layer->clear_run_values();
+        layer->clear_empty_value();
+        return true;
+    }
+
+    /**
+     * @brief decode an encoded layer in place, unencoded layers are not changed
+     *
+     * @return true if the layer was encoded
+     */
+    inline bool decode(SimpleSensor *layer) {
+        bool decoded = false;
+        switch (layer->encoding()) {
+            case QUANTIZED_8BIT_LAYER: decoded = decodeQuantized<uint8_t>(layer); break;
+            case QUANTIZED_16BIT_LAYER: decoded = decodeQuantized<uint16_t>(layer); break;
+            case SPARSE_LAYER: decoded = decodeSparse(layer); break;
+            default: return false;
+        }
+        layer->clear_encoding();
+        return decoded;
+    }
+
+    /**
+     * @brief encode a layer in place
+     *
+     * @param layer the layer (encoded or not), single values (no size) are not encoded
+     * @param encoding the encoding, AUTO_LAYER selects the smallest one with an error up to max_error
+     * @return true if encoded as requested, false if the layer was left unencoded (e.g. infinite values can't be quantized)
+     */
+    inline bool encode(SimpleSensor *layer, const GridMapEncoding &encoding) {
+        decode(layer);
+        const size_t count = cells(*layer);
+        if (encoding.type() == UNENCODED_LAYER || count == 0 || static_cast<size_t>(layer->value_size()) != count) {
+            return encoding.type() == UNENCODED_LAYER;
+        }
+        LayerStatistics stats = getStatistics(*layer);
+        GridMapLayerEncodingType type = encoding.type();
+        if (type == AUTO_LAYER) {
+            type = UNENCODED_LAYER;
+            size_t smallest = count * sizeof(float);
+            auto select = [&](const GridMapLayerEncodingType &candidate, const size_t &size) {
+                if (size < smallest) {
+                    smallest = size;
+                    type = candidate;
+                }
+            };
+            select(SPARSE_LAYER, stats.sparseSize(count));
+            if (!stats.infinite && encoding.max_error() > 0) {
+                if (quantizationScale(stats, 16) / 2 <= encoding.max_error()) {
+                    select(QUANTIZED_16BIT_LAYER, count * sizeof(uint16_t));
+                }
+                if (quantizationScale(stats, 8) / 2 <= encoding.max_error()) {
+                    select(QUANTIZED_8BIT_LAYER, count * sizeof(uint8_t));
+                }
+            }
+        }
+        switch (type) {
+            case QUANTIZED_8BIT_LAYER: return encodeQuantized<uint8_t>(layer, stats, 8);
+            case QUANTIZED_16BIT_LAYER: return encodeQuantized<uint16_t>(layer, stats, 16);
+            case SPARSE_LAYER: return encodeSparse(layer, stats);
+            default: return encoding.type() == AUTO_LAYER;
+        }
+    }
+
+    /**
+     * @brief encode all layers of a grid map
+     *
+     * @return true if all layers were encoded as requested
+     */
+    inline bool encode(GridMap *gridmap, const GridMapEncoding &encoding) {
+        bool result = true;
+        for (SimpleSensor &layer : *gridmap->mutable_layers()) {
+            result &= encode(&layer, encoding);
+        }
+        return result;
+    }
+
+    /**
+     * @brief decode all layers of a grid map
+     *
+     * @return true if one of the layers was encoded
+     */
+    inline bool decode(GridMap *gridmap) {
+        bool encoded = false;
+        for (SimpleSensor &layer : *gridmap->mutable_layers()) {
+            encoded |= decode(&layer);
+        }
+        return encoded;
+    }
+
+}  // namespace GridMapLayerCodec
+}  // namespace robot_remote_control
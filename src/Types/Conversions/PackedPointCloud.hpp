@@ -0,0 +1,143 @@
+#pragma once
+
+#include "../RobotRemoteControl.pb.h"
+#include <string>
+#include <cstring>
+
+namespace robot_remote_control {
+
+/**
+ * @brief helpers for the packed representation of PointCloud (packed_points and structure of array channels).
+ * The packed points are float32 x,y,z in host byte order (little endian on all supported platforms).
+ * Readers should use these helpers, they also read the old repeated points of older senders.
+ */
+namespace PackedPointCloud {
+
+    /**
+     * @brief memory layout of one point in packed_points
+     */
+    struct Point {
+        float x;
+        float y;
+        float z;
+    };
+    static_assert(sizeof(Point) == 3 * sizeof(float), "packed points need to be float32 x,y,z without padding");
+
+    /**
+     * @brief number of points, packed or not
+     */
+    inline size_t size(const PointCloud &cloud) {
+        if (cloud.packed_points().size()) {
+            return cloud.packed_points().size() / sizeof(Point);
+        }
+        return cloud.points_size();
+    }
+
+    /**
+     * @brief resize the packed points (removes the unpacked ones), the points are written to the returned memory
+     *
+     * @return Point* memory for count points, valid until the cloud is modified
+     */
+    inline Point* resize(PointCloud *cloud, const size_t &count) {
+        cloud->clear_points();
+        std::string *packed = cloud->mutable_packed_points();
+        packed->resize(count * sizeof(Point));
+        return reinterpret_cast<Point*>(&(*packed)[0]);
+    }
+
+    /**
+     * @brief set the packed points with a single copy
+     *
+     * @param xyz count * 3 floats
+     */
+    inline void setPoints(PointCloud *cloud, const float* xyz, const size_t &count) {
+        cloud->clear_points();
+        cloud->set_packed_points(reinterpret_cast<const char*>(xyz), count * sizeof(Point));
+    }
+
+    /**
+     * @brief direct access to the packed points
+     *
+     * @return const Point* nullptr if the cloud is not packed
+     */
+    inline const Point* points(const PointCloud &cloud) {
+        if (cloud.packed_points().size()) {
+            return reinterpret_cast<const Point*>(cloud.packed_points().data());
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief get a point of a packed or unpacked cloud
+     */
+    inline Point getPoint(const PointCloud &cloud, const size_t &index) {
+        const Point* packed = points(cloud);
+        if (packed) {
+            return packed[index];
+        }
+        const Position &position = cloud.points(index);
+        return {static_cast<float>(position.x()), static_cast<float>(position.y()), static_cast<float>(position.z())};
+    }
+
+    /**
+     * @brief convert the repeated points to packed_points
+     */
+    inline void pack(PointCloud *cloud) {
+        if (!cloud->points_size()) {
+            return;
+        }
+        google::protobuf::RepeatedPtrField<Position> unpacked;
+        unpacked.Swap(cloud->mutable_points());
+        Point* target = resize(cloud, unpacked.size());
+        for (const Position &position : unpacked) {
+            *target++ = {static_cast<float>(position.x()), static_cast<float>(position.y()), static_cast<float>(position.z())};
+        }
+    }
+
+    /**
+     * @brief convert packed_points to repeated points (for receivers not reading packed points)
+     */
+    inline void unpack(PointCloud *cloud) {
+        const size_t count = size(*cloud);
+        const Point* packed = points(*cloud);
+        if (!packed) {
+            return;
+        }
+        cloud->mutable_points()->Reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            Position *position = cloud->add_points();
+            position->set_x(packed[i].x);
+            position->set_y(packed[i].y);
+            position->set_z(packed[i].z);
+        }
+        cloud->clear_packed_points();
+    }
+
+    /**
+     * @brief add a channel with stride values per point for all points currently in the cloud
+     *
+     * @return float* memory for size(cloud) * stride values, valid until the channel is modified
+     */
+    inline float* addChannel(PointCloud *cloud, const std::string &name, const size_t &stride = 1) {
+        ChannelFloat *channel = cloud->add_channels();
+        channel->set_name(name);
+        channel->mutable_values()->Resize(size(*cloud) * stride, 0);
+        return channel->mutable_values()->mutable_data();
+    }
+
+    /**
+     * @brief Get a channel by name
+     *
+     * @return const ChannelFloat* nullptr if there is no channel with this name
+     */
+    inline const ChannelFloat* getChannel(const PointCloud &cloud, const std::string &name) {
+        for (const ChannelFloat &channel : cloud.channels()) {
+            if (channel.name() == name) {
+                return &channel;
+            }
+        }
+        return nullptr;
+    }
+
+}  // namespace PackedPointCloud
+}  // namespace robot_remote_control
@@ -72,11 +72,22 @@ namespace RockConversion {
         rrc_type->clear_velocity();
         rrc_type->clear_effort();
 
-        for (unsigned int i = 0; i < rock_type.size(); i++) {
-            rrc_type->add_name(rock_type.names[i]);
-            rrc_type->add_position(rock_type.elements[i].position);
-            rrc_type->add_velocity(rock_type.elements[i].speed);
-            rrc_type->add_effort(rock_type.elements[i].effort);
+        const int count = rock_type.size();
+        rrc_type->mutable_name()->Reserve(count);
+        for (const std::string &name : rock_type.names) {
+            rrc_type->add_name(name);
+        }
+        // written directly into the reserved arrays instead of one add_*() each
+        rrc_type->mutable_position()->Resize(count, 0);
+        rrc_type->mutable_velocity()->Resize(count, 0);
+        rrc_type->mutable_effort()->Resize(count, 0);
+        double* position = rrc_type->mutable_position()->mutable_data();
+        double* velocity = rrc_type->mutable_velocity()->mutable_data();
+        double* effort = rrc_type->mutable_effort()->mutable_data();
+        for (const base::JointState &joint : rock_type.elements) {
+            *position++ = joint.position;
+            *velocity++ = joint.speed;
+            *effort++ = joint.effort;
         }
     }
 
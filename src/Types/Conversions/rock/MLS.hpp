@@ -2,10 +2,17 @@
 
 #include <robot_remote_control/Types/RobotRemoteControl.pb.h>
 #include <maps/grid/MLSMap.hpp>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "Eigen.hpp"
 #include "Time.hpp"
+#include "../GridMapLayerCodec.hpp"
 
 namespace robot_remote_control {
 namespace RockConversion {
@@ -26,17 +33,21 @@ namespace RockConversion {
      * 
      * @param rock_type 
      * @param rrc_type 
+     * @param name name of the layer
+     * @param encoding encoding of the layer, AUTO_LAYER (with max_error 0) usually results in a sparse layer for MLS maps
      */
-    inline static void convert(const maps::grid::MLSMapKalman &rock_type, SimpleSensor *rrc_type, const std::string &name = "") {
+    inline static void convert(const maps::grid::MLSMapKalman &rock_type, SimpleSensor *rrc_type, const std::string &name = "",
+                               const GridMapEncoding &encoding = GridMapEncoding()) {
         rrc_type->set_name(name);
 
         maps::grid::Vector2ui num_cell = rock_type.getNumCells();
         convert(num_cell, rrc_type->mutable_size());
         convert((base::Vector2d)rock_type.getResolution(), rrc_type->mutable_scale());
 
-        // reserve space for all value entries
-        rrc_type->mutable_value()->Reserve(num_cell.x() * num_cell.y());
-        for (size_t y = 0; y < num_cell.y()-1; y++) {
+        // all values, empty cells are NaN
+        rrc_type->mutable_value()->Resize(num_cell.x() * num_cell.y(), std::numeric_limits<float>::quiet_NaN());
+        float* values = rrc_type->mutable_value()->mutable_data();
+        for (size_t y = 0; y < num_cell.y(); y++) {
             for (size_t x = 0; x < num_cell.x(); x++) {
                 const maps::grid::MLSMapKalman::CellType &list = rock_type.at(x, y);
                 if (list.size()) {
@@ -44,13 +55,16 @@ namespace RockConversion {
                     auto patch = list.begin();
                     // set the only the lowest data point, but it's maximum value
                     // when a block is the lowest entry, we want to use the top of it
-                    rrc_type->mutable_value()->Set(x+y*num_cell.x(), patch->getMax());
+                    values[x+y*num_cell.x()] = patch->getMax();
                 }
             }
         }
+        GridMapLayerCodec::encode(rrc_type, encoding);
     }
 
-    inline static void convert(const SimpleSensor &rrc_type, maps::grid::MLSMapKalman *rock_type) {
+    inline static void convert(const SimpleSensor &encoded_type, maps::grid::MLSMapKalman *rock_type) {
+        SimpleSensor rrc_type = encoded_type;
+        GridMapLayerCodec::decode(&rrc_type);
         maps::grid::Vector2ui num_cell = rock_type->getNumCells();
         convert(rrc_type.size(), &num_cell);
         rock_type->resize(num_cell);
@@ -60,14 +74,164 @@ namespace RockConversion {
 
         // // reserve space for all value entries
         // rrc_type->mutable_value()->Reserve(num_cell.x() * num_cell.y());
-        for (size_t y = 0; y < num_cell.y()-1; y++) {
+        const float* values = rrc_type.value().data();
+        for (size_t y = 0; y < num_cell.y(); y++) {
             for (size_t x = 0; x < num_cell.x(); x++) {
-                maps::grid::SurfacePatch<maps::grid::MLSConfig::KALMAN> patch(rrc_type.value().Get(x+y*num_cell.x()), 0);  // set 0 variance
+                float value = values[x+y*num_cell.x()];
+                if (std::isnan(value)) {
+                    // empty cell
+                    continue;
+                }
+                maps::grid::SurfacePatch<maps::grid::MLSConfig::KALMAN> patch(value, 0);  // set 0 variance
                 rock_type->at(x, y).insert(patch);
             }
         }
     }
 
 
+    /**
+     * @brief the layers of an MLS tile (see MLSGridMapTiles), one value per cell, NaN for empty cells
+     */
+    inline static void convertTile(const maps::grid::MLSMapKalman &rock_type, const size_t &startX, const size_t &startY,
+                                   const size_t &sizeX, const size_t &sizeY, GridMap *tile, const GridMapEncoding &encoding) {
+        const base::Vector2d resolution = rock_type.getResolution();
+        tile->Clear();
+        // the corner of the tile in the grid frame, so the tiles are merged by MapTileCache::getGridMap()
+        tile->mutable_origin()->mutable_position()->set_x(startX * resolution.x());
+        tile->mutable_origin()->mutable_position()->set_y(startY * resolution.y());
+        tile->mutable_origin()->mutable_orientation()->set_w(1);
+
+        const char* names[] = {"min", "max", "variance", "patches"};
+        float* values[4];
+        for (int i = 0; i < 4; ++i) {
+            SimpleSensor *layer = tile->add_layers();
+            layer->set_name(names[i]);
+            layer->mutable_size()->set_x(sizeX);
+            layer->mutable_size()->set_y(sizeY);
+            convert(resolution, layer->mutable_scale());
+            layer->mutable_value()->Resize(sizeX * sizeY, i == 3 ? 0 : std::numeric_limits<float>::quiet_NaN());
+            values[i] = layer->mutable_value()->mutable_data();
+        }
+        // one pass over the patches of each cell for all layers
+        for (size_t y = 0; y < sizeY; y++) {
+            for (size_t x = 0; x < sizeX; x++) {
+                const maps::grid::MLSMapKalman::CellType &list = rock_type.at(startX + x, startY + y);
+                if (!list.size()) {
+                    continue;
+                }
+                const size_t cell = x + y * sizeX;
+                // the list is sorted from bottom to top
+                values[0][cell] = list.begin()->getMin();
+                values[1][cell] = list.rbegin()->getMax();
+                values[2][cell] = list.begin()->getVariance();
+                values[3][cell] = list.size();
+            }
+        }
+        GridMapLayerCodec::encode(tile, encoding);
+    }
+
+    /**
+     * @brief converts an MLS map into GridMap tiles for ControlledRobot::setMapTile() (min, max, variance and patch count layers),
+     * the tiles are converted in parallel and only the tiles marked dirty since the last update() are converted again.
+     *
+     * usage:
+     *   MLSGridMapTiles tiles(100);
+     *   tiles.markDirty(minX, minY, maxX, maxY);  // the cells changed by the last scan
+     *   tiles.update(mls, [&](const int32_t &x, const int32_t &y, const GridMap &tile) { robot.setMapTile(mapId, x, y, tile); });
+     */
+    class MLSGridMapTiles {
+     public:
+        /**
+         * @param tileSize cells per tile in x and y
+         * @param threads number of converting threads, 0 for one per core
+         * @param encoding encoding of the layers, lossless AUTO_LAYER by default
+         */
+        explicit MLSGridMapTiles(const size_t &tileSize = 100, const unsigned int &threads = 0, const GridMapEncoding &encoding = autoEncoding()):
+            tileSize(std::max<size_t>(tileSize, 1)), threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())), encoding(encoding),
+            tilesX(0), tilesY(0), allDirty(true) {}
+
+        /**
+         * @brief mark the tiles containing the cells minX..maxX, minY..maxY (inclusive) to be converted by the next update()
+         */
+        void markDirty(const size_t &minX, const size_t &minY, const size_t &maxX, const size_t &maxY) {
+            for (size_t y = minY / tileSize; y <= maxY / tileSize && y < tilesY; ++y) {
+                for (size_t x = minX / tileSize; x <= maxX / tileSize && x < tilesX; ++x) {
+                    dirty[x + y * tilesX] = true;
+                }
+            }
+        }
+
+        void markAllDirty() {
+            allDirty = true;
+        }
+
+        /**
+         * @brief convert the dirty tiles (all tiles on the first call or when the size of the map changed)
+         *
+         * @param setTile called in this thread for each converted tile with its tile index
+         * @return size_t number of converted tiles
+         */
+        size_t update(const maps::grid::MLSMapKalman &rock_type, const std::function<void(const int32_t &x, const int32_t &y, const GridMap &tile)> &setTile) {
+            const maps::grid::Vector2ui cells = rock_type.getNumCells();
+            const size_t x = (cells.x() + tileSize - 1) / tileSize;
+            const size_t y = (cells.y() + tileSize - 1) / tileSize;
+            if (x != tilesX || y != tilesY) {
+                tilesX = x;
+                tilesY = y;
+                allDirty = true;
+            }
+            if (allDirty) {
+                dirty.assign(tilesX * tilesY, true);
+                allDirty = false;
+            }
+
+            std::vector<size_t> pending;
+            for (size_t i = 0; i < dirty.size(); ++i) {
+                if (dirty[i]) {
+                    pending.push_back(i);
+                }
+            }
+            std::vector<GridMap> tiles(pending.size());
+            std::atomic<size_t> next(0);
+            auto convertTiles = [&]() {
+                for (size_t i = next++; i < pending.size(); i = next++) {
+                    const size_t startX = (pending[i] % tilesX) * tileSize;
+                    const size_t startY = (pending[i] / tilesX) * tileSize;
+                    convertTile(rock_type, startX, startY, std::min<size_t>(tileSize, cells.x() - startX), std::min<size_t>(tileSize, cells.y() - startY),
+                                &tiles[i], encoding);
+                }
+            };
+            std::vector<std::thread> workers;
+            for (unsigned int i = 1; i < std::min<size_t>(threads, pending.size()); ++i) {
+                workers.emplace_back(convertTiles);
+            }
+            convertTiles();
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+
+            for (size_t i = 0; i < pending.size(); ++i) {
+                setTile(pending[i] % tilesX, pending[i] / tilesX, tiles[i]);
+                dirty[pending[i]] = false;
+            }
+            return pending.size();
+        }
+
+        static GridMapEncoding autoEncoding() {
+            GridMapEncoding encoding;
+            encoding.set_type(AUTO_LAYER);
+            return encoding;
+        }
+
+     private:
+        size_t tileSize;
+        unsigned int threads;
+        GridMapEncoding encoding;
+        size_t tilesX;
+        size_t tilesY;
+        bool allDirty;
+        std::vector<bool> dirty;
+    };
+
 }  // namespace RockConversion
 }  // namespace robot_remote_control
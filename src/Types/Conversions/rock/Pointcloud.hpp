@@ -4,60 +4,64 @@
 #include <string>
 #include <base/samples/Pointcloud.hpp>
 #include "Time.hpp"
+#include "../PackedPointCloud.hpp"
+#include "../BulkConversion.hpp"
 
 namespace robot_remote_control {
 namespace RockConversion {
 
-    inline static void convert(base::samples::Pointcloud rock_type, PointCloud *rrc_type, const std::string frame = "world") {
-        for (auto &point : rock_type.points) {
-            robot_remote_control::Position* p = rrc_type->add_points();
-            p->set_x(point[0]);
-            p->set_y(point[1]);
-            p->set_z(point[2]);
+    /**
+     * @brief convert to the packed representation: one float32 array for the points, one for the colors (color_rgba, 4 values per point)
+     */
+    inline static void convert(const base::samples::Pointcloud &rock_type, PointCloud *rrc_type, const std::string frame = "world") {
+        convert(rock_type.time, rrc_type->mutable_timestamp());
+
+        const size_t count = rock_type.points.size();
+        // the Eigen vectors are contiguous doubles
+        PackedPointCloud::Point* points = PackedPointCloud::resize(rrc_type, count);
+        if (count) {
+            BulkConversion::narrow(rock_type.points.data()->data(), &points->x, count * 3);
         }
-        // std::vector<base::Vector4d> colors;
-        if (rock_type.colors.size()) {
-            for (auto &color : rock_type.colors) {
-                robot_remote_control::ChannelFloat *channel = rrc_type->add_channels();
-                channel->set_name("color_rgba");
-                channel->add_values(color[0]);
-                channel->add_values(color[1]);
-                channel->add_values(color[2]);
-                channel->add_values(color[3]);
-            }
+
+        rrc_type->clear_channels();
+        if (rock_type.colors.size() == count && count) {
+            float* colors = PackedPointCloud::addChannel(rrc_type, "color_rgba", 4);
+            BulkConversion::narrow(rock_type.colors.data()->data(), colors, count * 4);
         }
         rrc_type->set_frame(frame);
     }
 
-    inline static void convert(const PointCloud& rrc_type, base::samples::Pointcloud *rock_type) {
-        rock_type->points.clear();
-        rock_type->colors.clear();
+    /**
+     * @brief convert to the packed representation with the points relative to origin (e.g. the sensor pose in frame)
+     */
+    inline static void convert(const base::samples::Pointcloud &rock_type, const Pose &origin, PointCloud *rrc_type, const std::string frame = "world") {
+        convert(rock_type, rrc_type, frame);
+        BulkConversion::toOrigin(rrc_type, origin);
+    }
 
+    inline static void convert(const PointCloud& rrc_type, base::samples::Pointcloud *rock_type) {
         convert(rrc_type.timestamp(), &(rock_type->time));
 
-        rock_type->points.reserve(rrc_type.points().size());
-        for (auto &point : rrc_type.points()) {
-            base::Point rock_point;
-            rock_point[0] = point.x();
-            rock_point[1] = point.y();
-            rock_point[2] = point.z();
-            rock_type->points.push_back(rock_point);
+        const size_t count = PackedPointCloud::size(rrc_type);
+        rock_type->points.resize(count);
+        const PackedPointCloud::Point* packed = PackedPointCloud::points(rrc_type);
+        if (packed) {
+            BulkConversion::widen(&packed->x, rock_type->points.data()->data(), count * 3);
+        } else {
+            // unpacked cloud of older senders
+            for (size_t i = 0; i < count; ++i) {
+                const Position &point = rrc_type.points(i);
+                rock_type->points[i] = base::Point(point.x(), point.y(), point.z());
+            }
         }
 
-        if (rrc_type.channels_size()) {
-            for (auto &channel : rrc_type.channels()) {
-                if (channel.name() == "color_rgba") {
-                    rock_type->colors.reserve(channel.values().size()/4);
-                    int index = 0;
-                    base::Vector4d rock_color;
-                    for (auto &color : channel.values()) {
-                        int colorindex = index % 4;
-                        rock_color[colorindex] = color;
-                        if (colorindex == 3) {
-                            rock_type->colors.push_back(rock_color);
-                        }
-                    }
-                }
+        rock_type->colors.clear();
+        // older senders used one channel per point
+        for (const ChannelFloat &channel : rrc_type.channels()) {
+            if (channel.name() == "color_rgba" && channel.values_size() >= 4) {
+                const size_t colors = channel.values_size() / 4;
+                rock_type->colors.resize(rock_type->colors.size() + colors);
+                BulkConversion::widen(channel.values().data(), (rock_type->colors.end() - colors)->data(), colors * 4);
             }
         }
     }
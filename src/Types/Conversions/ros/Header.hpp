@@ -12,6 +12,11 @@ namespace RosConversion {
         to->set_nsecs(from.stamp.nsec);
     }
 
+    static void convert(const robot_remote_control::TimeStamp &from, std_msgs::Header *to) {
+        to->stamp.sec = from.secs();
+        to->stamp.nsec = from.nsecs();
+    }
+
 
 }  // namespace RosConversion
 }  // namespace robot_remote_control
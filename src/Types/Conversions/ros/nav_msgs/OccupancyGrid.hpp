@@ -0,0 +1,104 @@
+#pragma once
+
+#include <robot_remote_control/Types/RobotRemoteControl.pb.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include "../Header.hpp"
+#include "../geometry_msgs/Pose.hpp"
+#include "../../GridMapLayerCodec.hpp"
+
+namespace robot_remote_control {
+namespace RosConversion {
+
+    /**
+     * @brief the default layer encoding of OccupancyGrids: 8 bit codes, lossless for the occupancy values
+     */
+    inline GridMapEncoding occupancyEncoding() {
+        GridMapEncoding encoding;
+        encoding.set_type(QUANTIZED_8BIT_LAYER);
+        return encoding;
+    }
+
+    /**
+     * @brief convert to a GridMap with one layer, unknown cells (-1) are NaN.
+     * The occupancy (0..100) is lossless in QUANTIZED_8BIT_LAYER (the error is below 0.5), so the layer is 1 byte per cell like the OccupancyGrid.
+     *
+     * @param layerName the name of the layer
+     * @param encoding the encoding of the layer
+     */
+    static void convert(const nav_msgs::OccupancyGrid &from, robot_remote_control::GridMap* to, const std::string &layerName = "occupancy",
+                        const GridMapEncoding &encoding = occupancyEncoding()) {
+        convert(from.header, to->mutable_timestamp());
+        to->set_frame(from.header.frame_id);
+        convert(from.info.origin, to->mutable_origin());
+
+        to->clear_layers();
+        SimpleSensor *layer = to->add_layers();
+        layer->set_name(layerName);
+        convert(from.header, layer->mutable_timestamp());
+        layer->mutable_size()->set_x(from.info.width);
+        layer->mutable_size()->set_y(from.info.height);
+        layer->mutable_scale()->set_x(from.info.resolution);
+        layer->mutable_scale()->set_y(from.info.resolution);
+
+        const size_t cells = static_cast<size_t>(from.info.width) * from.info.height;
+        if (from.data.size() < cells) {
+            printf("invalid OccupancyGrid, %zu cells instead of %zu\n", from.data.size(), cells);
+            layer->clear_size();
+            return;
+        }
+        // same cell order (x + y * width)
+        layer->mutable_value()->Resize(cells, 0);
+        float* values = layer->mutable_value()->mutable_data();
+        for (size_t i = 0; i < cells; ++i) {
+            values[i] = from.data[i] < 0 ? std::numeric_limits<float>::quiet_NaN() : from.data[i];
+        }
+        GridMapLayerCodec::encode(layer, encoding);
+    }
+
+    /**
+     * @brief convert a layer of a GridMap (encoded or not) to an OccupancyGrid, NaN cells are unknown (-1),
+     * the values are rounded and limited to 0..100
+     *
+     * @return false if the layer does not exist or has no cells
+     */
+    static bool convert(const robot_remote_control::GridMap &from, nav_msgs::OccupancyGrid* to, const std::string &layerName = "occupancy") {
+        const SimpleSensor *found = nullptr;
+        for (const SimpleSensor &layer : from.layers()) {
+            if (layer.name() == layerName) {
+                found = &layer;
+                break;
+            }
+        }
+        if (!found || !GridMapLayerCodec::cells(*found)) {
+            return false;
+        }
+        SimpleSensor layer = *found;
+        GridMapLayerCodec::decode(&layer);
+        const size_t cells = GridMapLayerCodec::cells(layer);
+        if (static_cast<size_t>(layer.value_size()) != cells) {
+            return false;
+        }
+
+        convert(from.timestamp(), &to->header);
+        to->header.frame_id = from.frame();
+        to->info.map_load_time = to->header.stamp;
+        to->info.resolution = layer.scale().x();
+        to->info.width = layer.size().x();
+        to->info.height = layer.size().y();
+        convert(from.origin(), &to->info.origin);
+
+        to->data.resize(cells);
+        const float* values = layer.value().data();
+        for (size_t i = 0; i < cells; ++i) {
+            to->data[i] = std::isnan(values[i]) ? -1 : std::max(0l, std::min(100l, std::lround(values[i])));
+        }
+        return true;
+    }
+
+}  // namespace RosConversion
+}  // namespace robot_remote_control
@@ -10,18 +10,14 @@ namespace RosConversion {
     static void convert(const sensor_msgs::JointState &from, robot_remote_control::JointState* to) {
         convert(from.header, to->mutable_timestamp());
 
-        for (int i = 0; i < from.name.size(); ++i) {
-            to->add_name(from.name[i]);
-            if (from.position.size()) {
-                to->add_position(from.position[i]);
-            }
-            if (from.velocity.size()) {
-                to->add_velocity(from.velocity[i]);
-            }
-            if (from.effort.size()) {
-                to->add_effort(from.effort[i]);
-            }
+        to->mutable_name()->Reserve(from.name.size());
+        for (const std::string &name : from.name) {
+            to->add_name(name);
         }
+        // the values are doubles on both sides, each array is copied at once
+        to->mutable_position()->Add(from.position.begin(), from.position.end());
+        to->mutable_velocity()->Add(from.velocity.begin(), from.velocity.end());
+        to->mutable_effort()->Add(from.effort.begin(), from.effort.end());
     }
 
 }  // namespace RosConversion
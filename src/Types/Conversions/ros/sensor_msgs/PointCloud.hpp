@@ -2,16 +2,47 @@
 
 #include <robot_remote_control/Types/RobotRemoteControl.pb.h>
 #include <geometry_msgs/PoseStamped.h>
+#include <sensor_msgs/PointCloud.h>
+#include <cstring>
+#include "../../PackedPointCloud.hpp"
 
 namespace robot_remote_control {
 namespace RosConversion {
 
+    /**
+     * @brief convert to the packed representation, geometry_msgs::Point32 has the same layout, so points and channels are copied at once
+     */
     static void convert(const sensor_msgs::PointCloud &from, robot_remote_control::PointCloud* to) {
-        for (auto &point : from.points) {
-            robot_remote_control::Position* pos = to->add_points();
-            pos->set_x(point.x);
-            pos->set_y(point.y);
-            pos->set_z(point.z);
+        static_assert(sizeof(geometry_msgs::Point32) == sizeof(PackedPointCloud::Point), "geometry_msgs::Point32 layout differs");
+        PackedPointCloud::setPoints(to, reinterpret_cast<const float*>(from.points.data()), from.points.size());
+        to->set_frame(from.header.frame_id);
+        to->clear_channels();
+        for (const sensor_msgs::ChannelFloat32 &channel : from.channels) {
+            robot_remote_control::ChannelFloat *target = to->add_channels();
+            target->set_name(channel.name);
+            target->mutable_values()->Add(channel.values.begin(), channel.values.end());
+        }
+    }
+
+    static void convert(const robot_remote_control::PointCloud &from, sensor_msgs::PointCloud* to) {
+        const size_t count = PackedPointCloud::size(from);
+        to->header.frame_id = from.frame();
+        to->points.resize(count);
+        const PackedPointCloud::Point* packed = PackedPointCloud::points(from);
+        if (packed) {
+            memcpy(to->points.data(), packed, count * sizeof(PackedPointCloud::Point));
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                const Position &point = from.points(i);
+                to->points[i].x = point.x();
+                to->points[i].y = point.y();
+                to->points[i].z = point.z();
+            }
+        }
+        to->channels.resize(from.channels_size());
+        for (int i = 0; i < from.channels_size(); ++i) {
+            to->channels[i].name = from.channels(i).name();
+            to->channels[i].values.assign(from.channels(i).values().begin(), from.channels(i).values().end());
         }
     }
 
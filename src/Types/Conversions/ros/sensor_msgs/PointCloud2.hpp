@@ -1,16 +1,211 @@
 #pragma once
 
 #include <robot_remote_control/Types/RobotRemoteControl.pb.h>
-#include <sensor_msgs/point_cloud_conversion.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/PointField.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "../Header.hpp"
 #include "PointCloud.hpp"
+#include "../../PackedPointCloud.hpp"
 
 namespace robot_remote_control {
 namespace RosConversion {
 
-    static void convert(const sensor_msgs::PointCloud2 &pointcloud, robot_remote_control::PointCloud* to) {
-        sensor_msgs::PointCloud pcloud;
-        sensor_msgs::convertPointCloud2ToPointCloud(pointcloud, pcloud);
-        convert(pcloud, to);
+    namespace PointCloud2Fields {
+
+        inline const sensor_msgs::PointField* find(const sensor_msgs::PointCloud2 &cloud, const std::string &name) {
+            for (const sensor_msgs::PointField &field : cloud.fields) {
+                if (field.name == name) {
+                    return &field;
+                }
+            }
+            return nullptr;
+        }
+
+        inline size_t size(const uint8_t &datatype) {
+            switch (datatype) {
+                case sensor_msgs::PointField::INT8:
+                case sensor_msgs::PointField::UINT8: return 1;
+                case sensor_msgs::PointField::INT16:
+                case sensor_msgs::PointField::UINT16: return 2;
+                case sensor_msgs::PointField::INT32:
+                case sensor_msgs::PointField::UINT32:
+                case sensor_msgs::PointField::FLOAT32: return 4;
+                case sensor_msgs::PointField::FLOAT64: return 8;
+                default: return 0;
+            }
+        }
+
+        /**
+         * @brief true if the values of the field are inside of a point
+         */
+        inline bool fits(const sensor_msgs::PointField &field, const uint32_t &pointStep) {
+            return static_cast<uint64_t>(field.offset) + static_cast<uint64_t>(field.count) * size(field.datatype) <= pointStep;
+        }
+
+        /**
+         * @brief true if data holds height rows of width points
+         */
+        inline bool fits(const sensor_msgs::PointCloud2 &cloud) {
+            const uint64_t rowSize = static_cast<uint64_t>(cloud.width) * cloud.point_step;
+            return rowSize <= cloud.data.size() && (!cloud.height || static_cast<uint64_t>(cloud.height - 1) * cloud.row_step <= cloud.data.size() - rowSize);
+        }
+
+        template <class T> inline float read(const uint8_t* data) {
+            T value;
+            memcpy(&value, data, sizeof(T));
+            return static_cast<float>(value);
+        }
+
+        /**
+         * @brief read a value of any field type as float (little endian)
+         */
+        inline float read(const uint8_t* data, const uint8_t &datatype) {
+            switch (datatype) {
+                case sensor_msgs::PointField::INT8: return read<int8_t>(data);
+                case sensor_msgs::PointField::UINT8: return read<uint8_t>(data);
+                case sensor_msgs::PointField::INT16: return read<int16_t>(data);
+                case sensor_msgs::PointField::UINT16: return read<uint16_t>(data);
+                case sensor_msgs::PointField::INT32: return read<int32_t>(data);
+                case sensor_msgs::PointField::UINT32: return read<uint32_t>(data);
+                case sensor_msgs::PointField::FLOAT32: return read<float>(data);
+                case sensor_msgs::PointField::FLOAT64: return read<double>(data);
+                default: return 0;
+            }
+        }
+
+        inline sensor_msgs::PointField floatField(const std::string &name, const uint32_t &offset, const uint32_t &count = 1) {
+            sensor_msgs::PointField field;
+            field.name = name;
+            field.offset = offset;
+            field.datatype = sensor_msgs::PointField::FLOAT32;
+            field.count = count;
+            return field;
+        }
+
+    }  // namespace PointCloud2Fields
+
+    /**
+     * @brief convert to the packed representation by reading the field layout of the PointCloud2 directly.
+     * The points are copied at once if they are float32 x,y,z at the start of a 12 byte point (e.g. from pcl::PointXYZ without padding),
+     * point by point otherwise. The other fields are converted to channels (float, count values per point, FLOAT32 bits are copied,
+     * so e.g. a packed "rgb" field survives the round trip).
+     */
+    static void convert(const sensor_msgs::PointCloud2 &from, robot_remote_control::PointCloud* to) {
+        convert(from.header, to->mutable_timestamp());
+        to->set_frame(from.header.frame_id);
+        to->clear_channels();
+
+        const size_t count = static_cast<size_t>(from.width) * from.height;
+        const sensor_msgs::PointField* x = PointCloud2Fields::find(from, "x");
+        const sensor_msgs::PointField* y = PointCloud2Fields::find(from, "y");
+        const sensor_msgs::PointField* z = PointCloud2Fields::find(from, "z");
+        bool fieldsFit = x && y && z;
+        for (const sensor_msgs::PointField* coordinate : {x, y, z}) {
+            // a single value is read, whatever the count
+            fieldsFit = fieldsFit && PointCloud2Fields::size(coordinate->datatype)
+                        && static_cast<uint64_t>(coordinate->offset) + PointCloud2Fields::size(coordinate->datatype) <= from.point_step;
+        }
+        for (const sensor_msgs::PointField &field : from.fields) {
+            // fields of unknown types are not converted
+            fieldsFit = fieldsFit && (!PointCloud2Fields::size(field.datatype) || PointCloud2Fields::fits(field, from.point_step));
+        }
+        if (from.is_bigendian || !fieldsFit || !PointCloud2Fields::fits(from)) {
+            printf("unsupported PointCloud2 layout\n");
+            PackedPointCloud::resize(to, 0);
+            return;
+        }
+        const bool floats = x->datatype == sensor_msgs::PointField::FLOAT32 && y->datatype == sensor_msgs::PointField::FLOAT32
+                            && z->datatype == sensor_msgs::PointField::FLOAT32;
+        const bool consecutive = floats && y->offset == x->offset + sizeof(float) && z->offset == y->offset + sizeof(float);
+        const bool dense = from.row_step == from.width * from.point_step || from.height <= 1;
+
+        PackedPointCloud::Point* points = PackedPointCloud::resize(to, count);
+        if (consecutive && x->offset == 0 && from.point_step == sizeof(PackedPointCloud::Point) && dense) {
+            memcpy(points, from.data.data(), count * sizeof(PackedPointCloud::Point));
+        } else {
+            for (uint32_t row = 0; row < from.height; ++row) {
+                const uint8_t* point = from.data.data() + row * from.row_step;
+                for (uint32_t column = 0; column < from.width; ++column, point += from.point_step) {
+                    if (consecutive) {
+                        memcpy(points++, point + x->offset, sizeof(PackedPointCloud::Point));
+                    } else {
+                        *points++ = {PointCloud2Fields::read(point + x->offset, x->datatype), PointCloud2Fields::read(point + y->offset, y->datatype),
+                                     PointCloud2Fields::read(point + z->offset, z->datatype)};
+                    }
+                }
+            }
+        }
+
+        for (const sensor_msgs::PointField &field : from.fields) {
+            const size_t fieldSize = PointCloud2Fields::size(field.datatype);
+            if (&field == x || &field == y || &field == z || !fieldSize || !field.count || !count) {
+                continue;
+            }
+            float* values = PackedPointCloud::addChannel(to, field.name, field.count);
+            for (uint32_t row = 0; row < from.height; ++row) {
+                const uint8_t* point = from.data.data() + row * from.row_step + field.offset;
+                for (uint32_t column = 0; column < from.width; ++column, point += from.point_step) {
+                    for (uint32_t i = 0; i < field.count; ++i) {
+                        *values++ = PointCloud2Fields::read(point + i * fieldSize, field.datatype);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief convert to an unordered PointCloud2 (height 1) with float32 x,y,z and one float32 field per channel
+     * (count = values per point), without channels the packed points are the data with a single copy.
+     * Channels which do not have a multiple of the points as values are skipped.
+     * @warning encoded clouds (PointCloudEncoding) have to be decoded first, as done by RobotController
+     */
+    static void convert(const robot_remote_control::PointCloud &from, sensor_msgs::PointCloud2* to) {
+        const size_t count = PackedPointCloud::size(from);
+        to->header.frame_id = from.frame();
+        convert(from.timestamp(), &to->header);
+        to->height = 1;
+        to->width = count;
+        to->is_bigendian = false;
+        to->is_dense = false;
+
+        to->fields.clear();
+        to->fields.push_back(PointCloud2Fields::floatField("x", 0));
+        to->fields.push_back(PointCloud2Fields::floatField("y", sizeof(float)));
+        to->fields.push_back(PointCloud2Fields::floatField("z", 2 * sizeof(float)));
+        uint32_t pointStep = sizeof(PackedPointCloud::Point);
+        std::vector<const ChannelFloat*> channels;
+        for (const ChannelFloat &channel : from.channels()) {
+            if (!count || channel.values_size() == 0 || channel.values_size() % count) {
+                continue;
+            }
+            const uint32_t stride = channel.values_size() / count;
+            to->fields.push_back(PointCloud2Fields::floatField(channel.name(), pointStep, stride));
+            pointStep += stride * sizeof(float);
+            channels.push_back(&channel);
+        }
+        to->point_step = pointStep;
+        to->row_step = pointStep * count;
+        to->data.resize(to->row_step);
+
+        const PackedPointCloud::Point* packed = PackedPointCloud::points(from);
+        if (packed && channels.empty()) {
+            memcpy(to->data.data(), packed, count * sizeof(PackedPointCloud::Point));
+            return;
+        }
+        uint8_t* target = to->data.data();
+        for (size_t i = 0; i < count; ++i) {
+            const PackedPointCloud::Point point = packed ? packed[i] : PackedPointCloud::getPoint(from, i);
+            memcpy(target, &point, sizeof(PackedPointCloud::Point));
+            target += sizeof(PackedPointCloud::Point);
+            for (const ChannelFloat* channel : channels) {
+                const size_t stride = channel->values_size() / count;
+                memcpy(target, channel->values().data() + i * stride, stride * sizeof(float));
+                target += stride * sizeof(float);
+            }
+        }
     }
 
 }  // namespace RosConversion
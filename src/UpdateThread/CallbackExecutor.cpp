@@ -0,0 +1,142 @@
+#include "CallbackExecutor.hpp"
+
+#include <chrono>
+
+namespace robot_remote_control
+{
+
+CallbackExecutor::CallbackExecutor(const size_t &threads, const size_t &maxQueuedCallbacks):
+    maxQueuedCallbacks(maxQueuedCallbacks ? maxQueuedCallbacks : 1),
+    busyWorkers(0),
+    droppedCallbacks(0),
+    stopping(false) {
+    for (size_t i = 0; i < (threads ? threads : 1); ++i) {
+        workers.emplace_back(&CallbackExecutor::workerMain, this);
+    }
+}
+
+CallbackExecutor::~CallbackExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+bool CallbackExecutor::post(const uint32_t &key, const std::function<void()> &callback, const void* source) {
+    bool result = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto policy = policies.find(key);
+        bool latestOnly = policy != policies.end() && policy->second == LATEST_ONLY;
+        if (latestOnly) {
+            auto pending = pendingLatest.find(PendingKey(key, source));
+            if (pending != pendingLatest.end()) {
+                // keeps the position in the queue
+                *pending->second = callback;
+                return true;
+            }
+        }
+        if (queue.size() >= maxQueuedCallbacks) {
+            forgetPending(queue.front());
+            queue.pop_front();
+            droppedCallbacks++;
+            result = false;
+        }
+        Task task;
+        task.key = PendingKey(key, source);
+        task.callback = std::make_shared< std::function<void()> >(callback);
+        if (latestOnly) {
+            pendingLatest[task.key] = task.callback;
+        }
+        queue.push_back(task);
+    }
+    wakeup.notify_one();
+    return result;
+}
+
+void CallbackExecutor::setPolicy(const uint32_t &key, const Policy &policy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    policies[key] = policy;
+    if (policy == QUEUE_ALL) {
+        // the queued callbacks are called, but not replaced anymore
+        auto pending = pendingLatest.lower_bound(PendingKey(key, nullptr));
+        while (pending != pendingLatest.end() && pending->first.first == key) {
+            pending = pendingLatest.erase(pending);
+        }
+    }
+}
+
+bool CallbackExecutor::waitUntilIdle(const float &timeoutSeconds) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return idle.wait_for(lock, std::chrono::duration<float>(timeoutSeconds), [this]() {
+        return queue.empty() && busyWorkers == 0;
+    });
+}
+
+size_t CallbackExecutor::getDroppedCallbacks() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return droppedCallbacks;
+}
+
+void CallbackExecutor::forgetPending(const Task &task) {
+    auto pending = pendingLatest.find(task.key);
+    if (pending != pendingLatest.end() && pending->second == task.callback) {
+        pendingLatest.erase(pending);
+    }
+}
+
+bool CallbackExecutor::isOrdered(const uint32_t &key) const {
+    auto policy = policies.find(key);
+    return policy != policies.end() && policy->second == ORDERED;
+}
+
+std::deque<CallbackExecutor::Task>::iterator CallbackExecutor::nextTask() {
+    if (runningOrdered.empty()) {
+        return queue.begin();
+    }
+    for (auto task = queue.begin(); task != queue.end(); ++task) {
+        if (!runningOrdered.count(task->key.first)) {
+            return task;
+        }
+    }
+    return queue.end();
+}
+
+void CallbackExecutor::workerMain() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeup.wait(lock, [this]() { return stopping || nextTask() != queue.end(); });
+        if (stopping) {
+            return;
+        }
+        auto next = nextTask();
+        Task task = *next;
+        queue.erase(next);
+        forgetPending(task);
+        const bool ordered = isOrdered(task.key.first);
+        if (ordered) {
+            runningOrdered.insert(task.key.first);
+        }
+        busyWorkers++;
+        lock.unlock();
+        (*task.callback)();
+        lock.lock();
+        busyWorkers--;
+        if (ordered) {
+            runningOrdered.erase(task.key.first);
+            // the next callback of the key may be waiting for this one
+            if (!queue.empty()) {
+                wakeup.notify_all();
+            }
+        }
+        if (queue.empty() && busyWorkers == 0) {
+            idle.notify_all();
+        }
+    }
+}
+
+}  // namespace robot_remote_control
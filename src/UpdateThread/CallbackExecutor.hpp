@@ -0,0 +1,108 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace robot_remote_control
+{
+
+/**
+ * @brief runs callbacks on worker threads, so the thread receiving the data is not delayed by them.
+ * The queue is bounded, when it is full the oldest callback is dropped.
+ *
+ * Callbacks are posted with a key (e.g. the telemetry type) that selects the policy:
+ * QUEUE_ALL: all callbacks are called
+ * LATEST_ONLY: a callback replaces a not yet started one of the same key and source (e.g. for slow consumers like rendering)
+ * ORDERED: all callbacks are called, one at a time and in the order they were posted, also with more than one thread
+ *
+ * With more than one thread, callbacks of the same key (except ORDERED ones) may run concurrently and out of order.
+ */
+class CallbackExecutor {
+ public:
+    enum Policy {QUEUE_ALL, LATEST_ONLY, ORDERED};
+
+    /**
+     * @param threads number of worker threads
+     * @param maxQueuedCallbacks maximum number of callbacks waiting to be called
+     */
+    explicit CallbackExecutor(const size_t &threads = 1, const size_t &maxQueuedCallbacks = 1000);
+
+    /**
+     * @brief stops the workers, callbacks not started yet are dropped
+     * @warning must not be called from a callback of this executor
+     */
+    virtual ~CallbackExecutor();
+
+    /**
+     * @brief queue a callback
+     *
+     * @param key the key selecting the policy
+     * @param callback the callback
+     * @param source identifies the callbacks replacing each other with LATEST_ONLY (e.g. the registered user callback),
+     * so different callbacks of the same key are not coalesced
+     * @return false if a queued callback was dropped to make room for this one
+     */
+    bool post(const uint32_t &key, const std::function<void()> &callback, const void* source = nullptr);
+
+    /**
+     * @brief set the policy of a key, the default is QUEUE_ALL
+     */
+    void setPolicy(const uint32_t &key, const Policy &policy);
+
+    /**
+     * @brief wait until all queued callbacks are finished
+     *
+     * @param timeoutSeconds maximum time to wait
+     * @return true if idle
+     */
+    bool waitUntilIdle(const float &timeoutSeconds);
+
+    /**
+     * @brief number of callbacks dropped because the queue was full
+     */
+    size_t getDroppedCallbacks();
+
+ private:
+    typedef std::shared_ptr< std::function<void()> > CallbackPtr;
+
+    typedef std::pair<uint32_t, const void*> PendingKey;
+
+    struct Task {
+        PendingKey key;
+        CallbackPtr callback;
+    };
+
+    void workerMain();
+    // needs a locked mutex
+    void forgetPending(const Task &task);
+    // the first task which may be started (its key is not ORDERED or has no running callback), needs a locked mutex
+    std::deque<Task>::iterator nextTask();
+    bool isOrdered(const uint32_t &key) const;
+
+    const size_t maxQueuedCallbacks;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable idle;
+    std::deque<Task> queue;
+    std::map<uint32_t, Policy> policies;
+    // the queued callback of LATEST_ONLY keys, replaced by new ones
+    std::map<PendingKey, CallbackPtr> pendingLatest;
+    // the ORDERED keys with a running callback
+    std::set<uint32_t> runningOrdered;
+    size_t busyWorkers;
+    size_t droppedCallbacks;
+    bool stopping;
+
+    std::vector<std::thread> workers;
+};
+
+}  // namespace robot_remote_control
@@ -0,0 +1,125 @@
+#include "Clock.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace robot_remote_control
+{
+
+const bool Clock::is_steady;
+std::atomic<Clock::Source*> Clock::current(nullptr);
+
+namespace {
+    std::mutex sourcesMutex;
+    // keeps the sources alive, the current one last
+    std::vector< std::shared_ptr<Clock::Source> > &sources() {
+        static std::vector< std::shared_ptr<Clock::Source> > installed;
+        return installed;
+    }
+
+    int64_t systemRealtimeNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}  // namespace
+
+Clock::time_point Clock::now() {
+    Source* source = current.load(std::memory_order_acquire);
+    if (source) {
+        return source->now();
+    }
+    return std::chrono::steady_clock::now();
+}
+
+int64_t Clock::realtimeNs() {
+    Source* source = current.load(std::memory_order_acquire);
+    if (source) {
+        return source->realtimeNs();
+    }
+    return systemRealtimeNs();
+}
+
+bool Clock::waitUntil(const time_point &deadline, const unsigned int &maxWaitMs) {
+    Source* source = current.load(std::memory_order_acquire);
+    if (source) {
+        return source->waitUntil(deadline, maxWaitMs);
+    }
+    const time_point limit = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxWaitMs);
+    std::this_thread::sleep_until(std::min(deadline, limit));
+    return std::chrono::steady_clock::now() >= deadline;
+}
+
+void Clock::setSource(const std::shared_ptr<Source> &source) {
+    std::lock_guard<std::mutex> lock(sourcesMutex);
+    if (source) {
+        sources().push_back(source);
+    }
+    current.store(source.get(), std::memory_order_release);
+}
+
+VirtualClock::VirtualClock(const int64_t &startRealtimeNs):
+    start(std::chrono::steady_clock::now()),
+    startRealtimeNs(startRealtimeNs ? startRealtimeNs : systemRealtimeNs()),
+    elapsedNs(0) {}
+
+Clock::time_point VirtualClock::now() {
+    return start + std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(elapsedNs.load(std::memory_order_acquire)));
+}
+
+int64_t VirtualClock::realtimeNs() {
+    return startRealtimeNs + elapsedNs.load(std::memory_order_acquire);
+}
+
+bool VirtualClock::waitUntil(const Clock::time_point &deadline, const unsigned int &maxWaitMs) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (now() >= deadline) {
+        return true;
+    }
+    auto entry = deadlines.insert(deadline);
+    bool reached = advanced.wait_for(lock, std::chrono::milliseconds(maxWaitMs), [&]() { return now() >= deadline; });
+    deadlines.erase(entry);
+    return reached;
+}
+
+void VirtualClock::advance(const Clock::duration &step) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        elapsedNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(step).count(), std::memory_order_acq_rel);
+    }
+    advanced.notify_all();
+}
+
+void VirtualClock::advanceTo(const Clock::time_point &time) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const int64_t target = std::chrono::duration_cast<std::chrono::nanoseconds>(time - start).count();
+        if (target <= elapsedNs.load()) {
+            return;
+        }
+        elapsedNs.store(target, std::memory_order_release);
+    }
+    advanced.notify_all();
+}
+
+bool VirtualClock::advanceToNextDeadline() {
+    Clock::time_point next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // the reached deadlines are of threads waking up, Clock::time_point::max() is waiting without a deadline
+        auto deadline = deadlines.upper_bound(now());
+        if (deadline == deadlines.end() || *deadline == Clock::time_point::max()) {
+            return false;
+        }
+        next = *deadline;
+    }
+    advanceTo(next);
+    return true;
+}
+
+size_t VirtualClock::getWaiting() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::distance(deadlines.upper_bound(now()), deadlines.end());
+}
+
+}  // namespace robot_remote_control
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+
+namespace robot_remote_control
+{
+
+/**
+ * @brief the clock of the library: Timer, the deadlines of the Scheduler and the UpdateThread (heartbeats, statistics, ...)
+ * and the time stamps of ControlledRobot::getTime() and the clock offset estimation.
+ *
+ * It is the system clock, unless a VirtualClock is installed with setSource(), so simulations and tests
+ * (e.g. many ControlledRobots connected by a TransportLoopback in one process) run deterministically and faster than real time.
+ * Clock satisfies the requirements of a std::chrono clock, its time_point is the one of the steady_clock.
+ * @warning the source should be set before the robots and controllers are created, timers started before measure the time jump
+ */
+class Clock {
+ public:
+    typedef std::chrono::steady_clock::duration duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::steady_clock::time_point time_point;
+    static const bool is_steady = true;
+
+    /**
+     * @brief a replacement of the system clock
+     */
+    class Source {
+     public:
+        virtual ~Source() {}
+
+        virtual time_point now() = 0;
+
+        // nanoseconds since the epoch, for time stamps
+        virtual int64_t realtimeNs() = 0;
+
+        /**
+         * @brief block until the deadline on this clock, at most maxWaitMs of real time
+         *
+         * @return true if the deadline was reached
+         */
+        virtual bool waitUntil(const time_point &deadline, const unsigned int &maxWaitMs) = 0;
+    };
+
+    static time_point now();
+
+    /**
+     * @brief nanoseconds since the epoch, the system time (CLOCK_REALTIME) without a source
+     */
+    static int64_t realtimeNs();
+
+    /**
+     * @brief block until the deadline, at most maxWaitMs of real time
+     *
+     * @return true if the deadline was reached
+     */
+    static bool waitUntil(const time_point &deadline, const unsigned int &maxWaitMs);
+
+    /**
+     * @brief replace the system clock for the whole process, nullptr restores it
+     * (replaced sources are kept until the process exits, threads may still use them)
+     */
+    static void setSource(const std::shared_ptr<Source> &source);
+
+    /**
+     * @brief true if a source replaces the system clock
+     */
+    static bool isVirtual() {
+        return current.load(std::memory_order_acquire) != nullptr;
+    }
+
+ private:
+    static std::atomic<Source*> current;
+};
+
+/**
+ * @brief a clock which only advances when told so (advance(), advanceTo(), advanceToNextDeadline()).
+ *
+ * Threads wait in waitUntil() for their deadline on this clock (e.g. in PERIODIC mode the update threads wait for their
+ * next update() and scheduled tasks), so a simulation loop can jump from deadline to deadline with advanceToNextDeadline()
+ * as fast as the threads run, or step a fixed interval with advance() and call update() without threads.
+ */
+class VirtualClock : public Clock::Source {
+ public:
+    /**
+     * @param startRealtimeNs time stamp of the start in nanoseconds since the epoch, 0 for the current system time
+     */
+    explicit VirtualClock(const int64_t &startRealtimeNs = 0);
+
+    Clock::time_point now() override;
+    int64_t realtimeNs() override;
+    bool waitUntil(const Clock::time_point &deadline, const unsigned int &maxWaitMs) override;
+
+    void advance(const Clock::duration &step);
+
+    /**
+     * @brief set the time, earlier times are ignored (the clock is monotonic)
+     */
+    void advanceTo(const Clock::time_point &time);
+
+    /**
+     * @brief advance to the earliest deadline a thread waits for in waitUntil()
+     *
+     * @return false if no thread waits
+     */
+    bool advanceToNextDeadline();
+
+    /**
+     * @brief number of threads waiting in waitUntil() for a deadline that is not reached yet
+     */
+    size_t getWaiting();
+
+ private:
+    const Clock::time_point start;
+    const int64_t startRealtimeNs;
+    // since start
+    std::atomic<int64_t> elapsedNs;
+
+    std::mutex mutex;
+    std::condition_variable advanced;
+    std::multiset<Clock::time_point> deadlines;
+};
+
+}  // namespace robot_remote_control
@@ -0,0 +1,78 @@
+#include "Scheduler.hpp"
+
+#include <algorithm>
+
+namespace robot_remote_control
+{
+
+Scheduler::Scheduler():nextId(1) {}
+
+Scheduler::TaskId Scheduler::schedule(const Clock::duration &delay, const std::function<void()> &task, const Clock::duration &period) {
+    std::lock_guard<std::mutex> lock(mutex);
+    TaskId id = nextId++;
+    Task &entry = tasks[id];
+    entry.function = task;
+    entry.period = period;
+    deadlines.push_back(Deadline{Clock::now() + delay, id});
+    std::push_heap(deadlines.begin(), deadlines.end());
+    return id;
+}
+
+bool Scheduler::cancel(const TaskId &id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.erase(id) > 0;
+}
+
+size_t Scheduler::runDue(const Clock::time_point &now) {
+    size_t count = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    removeCancelled();
+    while (!deadlines.empty() && deadlines.front().time <= now) {
+        Deadline deadline = deadlines.front();
+        std::pop_heap(deadlines.begin(), deadlines.end());
+        deadlines.pop_back();
+        auto task = tasks.find(deadline.id);
+        // copied, the task may cancel itself
+        std::function<void()> function = task->second.function;
+        if (task->second.period > Clock::duration::zero()) {
+            deadline.time += task->second.period;
+            if (deadline.time <= now) {
+                // skip the missed runs, but keep the phase
+                deadline.time += ((now - deadline.time) / task->second.period + 1) * task->second.period;
+            }
+            deadlines.push_back(deadline);
+            std::push_heap(deadlines.begin(), deadlines.end());
+        } else {
+            tasks.erase(task);
+        }
+        lock.unlock();
+        function();
+        count++;
+        lock.lock();
+        removeCancelled();
+    }
+    return count;
+}
+
+Scheduler::Clock::time_point Scheduler::nextDeadline() {
+    std::lock_guard<std::mutex> lock(mutex);
+    removeCancelled();
+    if (deadlines.empty()) {
+        return Clock::time_point::max();
+    }
+    return deadlines.front().time;
+}
+
+size_t Scheduler::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size();
+}
+
+void Scheduler::removeCancelled() {
+    while (!deadlines.empty() && tasks.find(deadlines.front().id) == tasks.end()) {
+        std::pop_heap(deadlines.begin(), deadlines.end());
+        deadlines.pop_back();
+    }
+}
+
+}  // namespace robot_remote_control
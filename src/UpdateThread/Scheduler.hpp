@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Clock.hpp"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <map>
+
+namespace robot_remote_control
+{
+
+/**
+ * @brief runs periodic and one-shot tasks at their deadlines on the monotonic clock of the library (e.g. heartbeats, statistics).
+ * The deadlines are kept in a heap, runDue() runs the due tasks in the calling thread and
+ * nextDeadline() tells when to call it again, so a thread can sleep until the next deadline instead of polling.
+ *
+ * The UpdateThread runs its scheduler before each update() and wakes up for its deadlines.
+ * Tasks may be scheduled and cancelled from any thread and from tasks,
+ * a deadline earlier than the current wakeup of a waiting thread is run when it wakes up next.
+ */
+class Scheduler {
+ public:
+    // the steady_clock or the VirtualClock (Clock::setSource())
+    typedef robot_remote_control::Clock Clock;
+    typedef uint64_t TaskId;
+
+    Scheduler();
+
+    virtual ~Scheduler() = default;
+
+    /**
+     * @brief schedule a task
+     *
+     * @param delay time until the first run
+     * @param task the task
+     * @param period time between the deadlines of a periodic task, zero for a one-shot task.
+     * When runs were missed, a periodic task runs once and keeps its phase.
+     * @return TaskId id to cancel the task
+     */
+    TaskId schedule(const Clock::duration &delay, const std::function<void()> &task, const Clock::duration &period = Clock::duration::zero());
+
+    /**
+     * @brief schedule a periodic task, the first run is one period from now
+     */
+    TaskId schedulePeriodic(const Clock::duration &period, const std::function<void()> &task) {
+        return schedule(period, task, period);
+    }
+
+    /**
+     * @brief cancel a task, a currently running task finishes, but is not run again
+     *
+     * @return false if there is no such task (e.g. a one-shot task that already ran)
+     */
+    bool cancel(const TaskId &id);
+
+    /**
+     * @brief run all tasks with a deadline until now
+     *
+     * @param now the current time
+     * @return size_t number of tasks run
+     */
+    size_t runDue(const Clock::time_point &now = Clock::now());
+
+    /**
+     * @brief deadline of the next task
+     *
+     * @return Clock::time_point Clock::time_point::max() if there are no tasks
+     */
+    Clock::time_point nextDeadline();
+
+    /**
+     * @brief number of scheduled tasks
+     */
+    size_t size();
+
+ private:
+    struct Deadline {
+        Clock::time_point time;
+        TaskId id;
+        // the heap has the earliest deadline on top
+        bool operator<(const Deadline &other) const {
+            return time > other.time;
+        }
+    };
+
+    struct Task {
+        std::function<void()> function;
+        Clock::duration period;
+    };
+
+    // needs a locked mutex
+    void removeCancelled();
+
+    std::mutex mutex;
+    std::vector<Deadline> deadlines;
+    // cancelled tasks are only removed here, their deadlines are skipped
+    std::map<TaskId, Task> tasks;
+    TaskId nextId;
+};
+
+}  // namespace robot_remote_control
@@ -1,13 +1,14 @@
 #include "Timer.hpp"
+#include "Clock.hpp"
 
 #include <stdio.h>
 
-Timer::Timer() : running(false) {}
+Timer::Timer() : interval_s(0), running(false) {}
 
 void Timer::start(const float &interval_seconds) {
     running = true;
     interval_s = interval_seconds;
-    gettimeofday(&startTime, 0);
+    startTime = robot_remote_control::Clock::now();
 }
 
 
@@ -19,9 +20,24 @@ bool Timer::isExpired() {
     return false;
 }
 
+float Timer::getRemainingTime() {
+    if (!running) {
+        return -1;
+    }
+    float remaining = interval_s - getElapsedTime();
+    if (remaining < 0) {
+        return 0;
+    }
+    return remaining;
+}
+
 float Timer::getElapsedTime() {
-    timeval now, diff;
-    gettimeofday(&now, 0);
-    timersub(&now, &startTime, &diff);
-    return diff.tv_sec + (diff.tv_usec / 1000000.0);
+    return std::chrono::duration<float>(robot_remote_control::Clock::now() - startTime).count();
+}
+
+std::chrono::steady_clock::time_point Timer::getDeadline() {
+    if (!running) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(interval_s));
 }
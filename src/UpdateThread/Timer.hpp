@@ -1,8 +1,12 @@
 #pragma once
 
-#include <sys/time.h>
+#include <chrono>
 
 
+/**
+ * @brief measures time on the monotonic clock, so it is not affected by changes of the system time (e.g. NTP),
+ * on the VirtualClock if one is installed (robot_remote_control::Clock::setSource())
+ */
 class Timer {
  public:
     Timer();
@@ -14,9 +18,23 @@ class Timer {
 
     bool isExpired();
 
+    /**
+     * @brief Get the time until the interval expires
+     *
+     * @return float seconds until expired, 0 if already expired, -1 if the timer was not started
+     */
+    float getRemainingTime();
+
+    /**
+     * @brief Get the time the interval expires, e.g. to wait until then
+     *
+     * @return std::chrono::steady_clock::time_point the deadline, time_point::max() if the timer was not started
+     */
+    std::chrono::steady_clock::time_point getDeadline();
+
 
  private:
     float interval_s;
     bool running;
-    timeval startTime;
+    std::chrono::steady_clock::time_point startTime;
 };
@@ -2,7 +2,12 @@
 
 #include "UpdateThread.hpp"
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cstdio>
+#include <cstring>
 #include <utility>
+#include <algorithm>
 
 using namespace robot_remote_control;
 
@@ -18,19 +23,103 @@ UpdateThread::~UpdateThread() {
 
 void UpdateThread::updateThreadMain(const unsigned int &milliseconds, std::future<void> runningFuture, std::shared_ptr< LockableClass<Timer> > timer) {
     running = true;
-    while (runningFuture.wait_for(std::chrono::milliseconds(milliseconds)) == std::future_status::timeout) {
+    Scheduler::Clock::time_point nextUpdate = Scheduler::Clock::now() + std::chrono::milliseconds(milliseconds);
+    while (waitUntil(&runningFuture, std::min(nextUpdate, scheduler.nextDeadline()))) {
+        Scheduler::Clock::time_point now = Scheduler::Clock::now();
+        scheduler.runDue(now);
+        if (now >= nextUpdate) {
+            update();
+            timer->lockedAccess()->start();
+            nextUpdate = Scheduler::Clock::now() + std::chrono::milliseconds(milliseconds);
+        }
+    }
+    running = false;
+}
+
+void UpdateThread::reactorThreadMain(const unsigned int &milliseconds, std::future<void> runningFuture, std::shared_ptr< LockableClass<Timer> > timer) {
+    running = true;
+    while (runningFuture.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout) {
+        waitForUpdate(getWaitTime(milliseconds));
+        scheduler.runDue();
         update();
         timer->lockedAccess()->start();
     }
     running = false;
 }
 
-void UpdateThread::startUpdateThread(const unsigned int &milliseconds) {
+bool UpdateThread::waitUntil(std::future<void> *runningFuture, const Scheduler::Clock::time_point &deadline) {
+    if (!Clock::isVirtual()) {
+        return runningFuture->wait_until(deadline) == std::future_status::timeout;
+    }
+    // virtual time only passes when the clock is advanced, the stop is checked in between
+    while (!Clock::waitUntil(deadline, 10)) {
+        if (runningFuture->wait_for(std::chrono::milliseconds(0)) != std::future_status::timeout) {
+            return false;
+        }
+    }
+    return runningFuture->wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout;
+}
+
+void UpdateThread::waitForUpdate(const unsigned int &maxMilliseconds) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(maxMilliseconds));
+}
+
+unsigned int UpdateThread::getWaitTime(const unsigned int &maxMilliseconds) {
+    Scheduler::Clock::time_point deadline = scheduler.nextDeadline();
+    if (deadline == Scheduler::Clock::time_point::max()) {
+        return maxMilliseconds;
+    }
+    Scheduler::Clock::duration remaining = deadline - Scheduler::Clock::now();
+    if (remaining <= Scheduler::Clock::duration::zero()) {
+        return 0;
+    }
+    // rounded up, waking up early would only spin until the deadline
+    int64_t milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(remaining + std::chrono::milliseconds(1) - Scheduler::Clock::duration(1)).count();
+    return static_cast<unsigned int>(std::min<int64_t>(milliseconds, maxMilliseconds));
+}
+
+void UpdateThread::startUpdateThread(const unsigned int &milliseconds, const UpdateMode &mode, const ThreadOptions &options) {
     if (!running) {
         stopFuture = stopPromise.get_future();
-        updateThread = std::thread(&UpdateThread::updateThreadMain, this, std::move(milliseconds), std::move(stopFuture), threadTimer);
+        if (mode == REACTOR) {
+            updateThread = std::thread(&UpdateThread::reactorThreadMain, this, std::move(milliseconds), std::move(stopFuture), threadTimer);
+        } else {
+            updateThread = std::thread(&UpdateThread::updateThreadMain, this, std::move(milliseconds), std::move(stopFuture), threadTimer);
+        }
         running = true;
+        applyThreadOptions(&updateThread, options);
+    }
+}
+
+bool UpdateThread::applyThreadOptions(std::thread *thread, const ThreadOptions &options) {
+    bool result = true;
+    if (options.priority > 0) {
+        sched_param param;
+        param.sched_priority = options.priority;
+        int error = pthread_setschedparam(thread->native_handle(), SCHED_FIFO, &param);
+        if (error) {
+            printf("unable to set SCHED_FIFO priority %i: %s\n", options.priority, strerror(error));
+            result = false;
+        }
+    }
+    if (!options.cpus.empty()) {
+    #ifdef __linux__
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        for (const int &cpu : options.cpus) {
+            CPU_SET(cpu, &cpuset);
+        }
+        int error = pthread_setaffinity_np(thread->native_handle(), sizeof(cpu_set_t), &cpuset);
+        if (error) {
+            printf("unable to set the cpu affinity: %s\n", strerror(error));
+            result = false;
+        }
+    #else
+        printf("cpu affinity is not supported on this platform\n");
+        result = false;
+    #endif
     }
+    return result;
 }
 
 void UpdateThread::stopUpdateThread() {
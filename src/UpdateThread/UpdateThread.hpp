@@ -4,8 +4,10 @@
 #include <chrono>
 #include <future>
 #include <memory>
+#include <vector>
 
 #include "Timer.hpp"
+#include "Scheduler.hpp"
 #include "LockableClass.hpp"
 
 namespace robot_remote_control
@@ -16,6 +18,24 @@ namespace robot_remote_control
  */
 class UpdateThread{
  public: 
+    /**
+     * @brief PERIODIC: update() is called every milliseconds
+     * REACTOR: update() is called as soon as waitForUpdate() returns (e.g. when data arrived), but at least every milliseconds
+     * With a VirtualClock (Clock::setSource()) PERIODIC threads wait for the virtual time, REACTOR threads wait for data in real time.
+     */
+    enum UpdateMode {PERIODIC, REACTOR};
+
+    /**
+     * @brief scheduling of the update thread (e.g. for real-time control loops)
+     */
+    struct ThreadOptions {
+        ThreadOptions():priority(0) {}
+        // SCHED_FIFO priority (1-99, needs CAP_SYS_NICE), 0 keeps the default scheduler
+        int priority;
+        // cpus the thread may run on, empty for all
+        std::vector<int> cpus;
+    };
+
     UpdateThread();
     virtual ~UpdateThread();
 
@@ -28,10 +48,12 @@ class UpdateThread{
     /**
      * @brief starts the thread
      * 
-     * @param milliseconds milliseconds to wait after update() finishes
+     * @param milliseconds milliseconds to wait after update() finishes (maximum time to wait in REACTOR mode)
+     * @param mode PERIODIC or REACTOR
+     * @param options priority and cpu affinity of the thread, failures to apply them are printed, the thread runs anyway
      * @TODO make this ms between calls to update()
      */
-    void startUpdateThread(const unsigned int &milliseconds);
+    void startUpdateThread(const unsigned int &milliseconds, const UpdateMode &mode = PERIODIC, const ThreadOptions &options = ThreadOptions());
 
     /**
      * @brief waits until update() retruns and stops the thread
@@ -43,6 +65,26 @@ class UpdateThread{
         return running;
     };
 
+    /**
+     * @brief Get the scheduler run by the update thread before each update()
+     * The thread wakes up for the deadlines of the tasks, in PERIODIC mode update() is still only called every milliseconds.
+     * Without a running thread, the tasks are run by runScheduledTasks().
+     *
+     * @return Scheduler& the scheduler
+     */
+    Scheduler& getScheduler() {
+        return scheduler;
+    }
+
+    /**
+     * @brief run the due tasks of the scheduler, to be used when update() is called without the update thread
+     *
+     * @return size_t number of tasks run
+     */
+    size_t runScheduledTasks() {
+        return scheduler.runDue();
+    }
+
  protected:
     /**
      * @brief Get the Elapsed Time In Seconds
@@ -52,6 +94,26 @@ class UpdateThread{
      */
     float getElapsedTimeInS();
 
+    /**
+     * @brief apply scheduling options to a thread
+     *
+     * @return false if an option could not be applied
+     */
+    static bool applyThreadOptions(std::thread *thread, const ThreadOptions &options);
+
+    /**
+     * @brief used in REACTOR mode: blocks until update() has something to do or the timeout expired.
+     * the default just waits the timeout
+     *
+     * @param maxMilliseconds maximum time to wait
+     */
+    virtual void waitForUpdate(const unsigned int &maxMilliseconds);
+
+    /**
+     * @brief milliseconds until the next deadline of the scheduler (rounded up), at most maxMilliseconds
+     */
+    unsigned int getWaitTime(const unsigned int &maxMilliseconds);
+
 
  private:
     std::thread updateThread;
@@ -59,7 +121,11 @@ class UpdateThread{
     std::future<void> stopFuture;
     std::shared_ptr< LockableClass<Timer> > threadTimer;
     void updateThreadMain(const unsigned int &milliseconds, std::future<void> runningFuture, std::shared_ptr< LockableClass<Timer> > timer);
+    // waits on the clock of the library, false when the thread is stopped
+    bool waitUntil(std::future<void> *runningFuture, const Scheduler::Clock::time_point &deadline);
+    void reactorThreadMain(const unsigned int &milliseconds, std::future<void> runningFuture, std::shared_ptr< LockableClass<Timer> > timer);
     bool running;
+    Scheduler scheduler;
 
 };
 
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+
+namespace robot_remote_control {
+
+/**
+ * @brief set in the type of telemetry messages with a WireHeader instead of the plain uint16_t type header
+ */
+const uint16_t WIRE_HEADER_FLAG = 0x4000;
+
+/**
+ * @brief versioned header of telemetry messages, used after the controller negotiated it (RobotController::setVersionedHeader()),
+ * otherwise the robot keeps sending the plain uint16_t type header for older controllers.
+ *
+ * [uint16_t type | WIRE_HEADER_FLAG][uint8_t version][uint8_t header size][uint16_t flags][uint32_t sequence][uint64_t send time][uint32_t request id]
+ *
+ * The type stays in the first two bytes, so zmq topics and the routing by type work for both headers (with the flag masked).
+ * The header size allows newer versions to append fields, older readers skip them.
+ * The request id is only present with HAS_REQUEST_ID.
+ */
+struct WireHeader {
+    enum Flags : uint16_t {
+        NONE = 0,
+        COMPRESSED = 1,      // the payload is compressed
+        BATCHED = 2,         // the payload is a TELEMETRY_BATCH
+        CHUNKED = 4,         // the payload is part of a larger message (e.g. a MAP_CHUNK)
+        HAS_REQUEST_ID = 8,  // a uint32_t request id follows
+        FIXED_LAYOUT = 16    // the payload is a FixedLayout struct instead of the protobuf message
+    };
+
+    // enums instead of static members, so they can be passed by reference without a definition
+    enum : uint8_t { currentVersion = 1 };
+    enum : size_t { baseSize = 18, maxSize = baseSize + sizeof(uint32_t) };
+
+    WireHeader():type(0), version(0), flags(NONE), sequence(0), sendTimeNs(0), requestId(0) {}
+
+    // without WIRE_HEADER_FLAG
+    uint16_t type;
+    // 0 for a plain type header
+    uint8_t version;
+    uint16_t flags;
+    // counted per type by the sender
+    uint32_t sequence;
+    // monotonic clock of the sender (not comparable to the clock of the receiver without an offset)
+    uint64_t sendTimeNs;
+    uint32_t requestId;
+
+    size_t size() const {
+        return baseSize + ((flags & HAS_REQUEST_ID) ? sizeof(uint32_t) : 0);
+    }
+
+    /**
+     * @brief write the header
+     *
+     * @param target at least size() bytes
+     * @return size_t bytes written
+     */
+    size_t write(char* target) const {
+        const uint16_t flaggedType = type | WIRE_HEADER_FLAG;
+        const uint8_t version = currentVersion;
+        const uint8_t headerSize = size();
+        memcpy(target, &flaggedType, sizeof(uint16_t));
+        memcpy(target + 2, &version, sizeof(uint8_t));
+        memcpy(target + 3, &headerSize, sizeof(uint8_t));
+        memcpy(target + 4, &flags, sizeof(uint16_t));
+        memcpy(target + 6, &sequence, sizeof(uint32_t));
+        memcpy(target + 10, &sendTimeNs, sizeof(uint64_t));
+        if (flags & HAS_REQUEST_ID) {
+            memcpy(target + baseSize, &requestId, sizeof(uint32_t));
+        }
+        return headerSize;
+    }
+
+    /**
+     * @brief read a versioned or a plain type header
+     *
+     * @param data the message
+     * @param size size of the message
+     * @param header the header, version 0 for a plain type header
+     * @return size_t size of the header (the payload follows), 0 if the message is too short
+     */
+    static size_t read(const char* data, const size_t &size, WireHeader *header) {
+        *header = WireHeader();
+        if (size < sizeof(uint16_t)) {
+            return 0;
+        }
+        uint16_t flaggedType;
+        memcpy(&flaggedType, data, sizeof(uint16_t));
+        if (!(flaggedType & WIRE_HEADER_FLAG)) {
+            header->type = flaggedType;
+            return sizeof(uint16_t);
+        }
+        header->type = flaggedType & ~WIRE_HEADER_FLAG;
+        if (size < baseSize) {
+            return 0;
+        }
+        uint8_t headerSize;
+        memcpy(&header->version, data + 2, sizeof(uint8_t));
+        memcpy(&headerSize, data + 3, sizeof(uint8_t));
+        memcpy(&header->flags, data + 4, sizeof(uint16_t));
+        memcpy(&header->sequence, data + 6, sizeof(uint32_t));
+        memcpy(&header->sendTimeNs, data + 10, sizeof(uint64_t));
+        if (header->version == 0 || headerSize < header->size() || headerSize > size) {
+            return 0;
+        }
+        if (header->flags & HAS_REQUEST_ID) {
+            memcpy(&header->requestId, data + baseSize, sizeof(uint32_t));
+        }
+        return headerSize;
+    }
+
+    /**
+     * @brief the clock of sendTimeNs
+     */
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+}  // namespace robot_remote_control
@@ -60,6 +60,25 @@ class TypeGenerator{
         return data;
     }
 
+    static PointCloud genPointCloud(const int &points = 100) {
+        PointCloud data;
+        data.set_frame(std::to_string(std::rand()));
+        *data.mutable_origin() = genPose();
+        for (int values = 0; values < points; ++values) {
+            // small integers are exact in the float32 of packed points
+            Position *point = data.add_points();
+            point->set_x(std::rand() % 10000);
+            point->set_y(std::rand() % 10000);
+            point->set_z(std::rand() % 10000);
+        }
+        ChannelFloat *channel = data.add_channels();
+        channel->set_name("intensity");
+        for (int values = 0; values < points; ++values) {
+            channel->add_values(std::rand() % 256);
+        }
+        return data;
+    }
+
     static Pose genPose() {
         Pose data;
         *data.mutable_position() = genPosition();
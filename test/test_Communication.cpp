@@ -5,18 +5,45 @@
 #ifdef TRANSPORT_DEFAULT_GZIP
   #include "../src/Transports/TransportWrapperGzip.hpp"
 #endif
+#ifdef TRANSPORT_DEFAULT_LZ4
+  #include "../src/Transports/TransportWrapperLZ4.hpp"
+#endif
+#ifdef TRANSPORT_DEFAULT_ZSTD
+  #include "../src/Transports/TransportWrapperZstd.hpp"
+#endif
 #ifdef TRANSPORT_UDT
   #include "../src/Transports/TransportUDT.hpp"
 #endif
+#ifdef TRANSPORT_SHM
+  #include "../src/Transports/TransportShm.hpp"
+#endif
 
 #include "TypeGenerator.hpp"
+#include "../src/Types/Conversions/PackedPointCloud.hpp"
+#include "../src/Types/Conversions/BulkConversion.hpp"
 
 #include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <fstream>
+#include <sstream>
+#include <arpa/inet.h>
+#include <sys/socket.h>
 
 #define private public // :-|
 #define protected public // :-|
 #include "../src/RobotController/RobotController.hpp"
+#include "../src/RobotController/RobotControllerHub.hpp"
 #include "../src/ControlledRobot/ControlledRobot.hpp"
+#include "../src/MetricsExporter.hpp"
+#include "../src/Relay/TelemetryRelay.hpp"
+#include "../src/SharedTelemetryStore.hpp"
+#include "../src/Transports/TransportWrapperBonding.hpp"
+#include "../src/Transports/TransportWrapperFEC.hpp"
+#include "../src/Transports/TransportLoopback.hpp"
 
 using namespace robot_remote_control;
 
@@ -29,6 +56,29 @@ TransportSharedPtr telemetri;
 
 
 
+// counts the allocations of the thread setting countAllocations
+thread_local bool countAllocations = false;
+std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+  if (countAllocations) {
+    allocations++;
+  }
+  void* memory = malloc(size);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void* memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void* memory, size_t /*size*/) noexcept {
+  free(memory);
+}
+
 #define COMPARE_PROTOBUF(VAR1, VAR2) BOOST_TEST(VAR1.SerializeAsString() == VAR2.SerializeAsString())
 
 /**
@@ -56,6 +106,30 @@ void initComms() {
     if (!command.get()) {command = TransportSharedPtr(new TransportWrapperGzip(TransportSharedPtr(new TransportZmq("tcp://*:7003", TransportZmq::REP))));}
     if (!telemetri.get()) {telemetri = TransportSharedPtr(new TransportWrapperGzip(TransportSharedPtr(new TransportZmq("tcp://*:7004", TransportZmq::PUB))));}
   #endif
+  #ifdef TRANSPORT_DEFAULT_LZ4
+    // compress all messages
+    if (!commands.get()) {
+        printf("using zmq tcp with lz4 wrapper\n");
+        commands = TransportSharedPtr(new TransportWrapperLZ4(TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7003", TransportZmq::REQ)), 0));
+    }
+    if (!telemetry.get()) {telemetry = TransportSharedPtr(new TransportWrapperLZ4(TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7004", TransportZmq::SUB)), 0));}
+
+    if (!command.get()) {command = TransportSharedPtr(new TransportWrapperLZ4(TransportSharedPtr(new TransportZmq("tcp://*:7003", TransportZmq::REP)), 0));}
+    if (!telemetri.get()) {telemetri = TransportSharedPtr(new TransportWrapperLZ4(TransportSharedPtr(new TransportZmq("tcp://*:7004", TransportZmq::PUB)), 0));}
+  #endif
+  #ifdef TRANSPORT_DEFAULT_ZSTD
+    // use a dictionary for the telemetry
+    if (!commands.get()) {
+        printf("using zmq tcp with zstd wrapper\n");
+        commands = TransportSharedPtr(new TransportWrapperZstd(TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7003", TransportZmq::REQ)), 16));
+    }
+    if (!command.get()) {command = TransportSharedPtr(new TransportWrapperZstd(TransportSharedPtr(new TransportZmq("tcp://*:7003", TransportZmq::REP)), 16));}
+    {
+      std::string dictionary = TypeGenerator::genJointState().SerializeAsString() + TypeGenerator::genPose().SerializeAsString();
+      if (!telemetry.get()) {telemetry = TransportSharedPtr(new TransportWrapperZstd(TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7004", TransportZmq::SUB)), 16, 3, dictionary));}
+      if (!telemetri.get()) {telemetri = TransportSharedPtr(new TransportWrapperZstd(TransportSharedPtr(new TransportZmq("tcp://*:7004", TransportZmq::PUB)), 16, 3, dictionary));}
+    }
+  #endif
   #ifdef TRANSPORT_IPC
     if (!command.get()) {
         printf("using zmq IPC\n");
@@ -65,6 +139,30 @@ void initComms() {
     if (!commands.get()) {commands = TransportSharedPtr(new TransportZmq("ipc:///tmp/test0", TransportZmq::REQ));}
     if (!telemetry.get()) {telemetry = TransportSharedPtr(new TransportZmq("ipc:///tmp/test1", TransportZmq::SUB));}
   #endif
+  #ifdef TRANSPORT_SHM
+    if (!command.get()) {
+        printf("using shared memory\n");
+        command = TransportSharedPtr(new TransportShm("rrc_test0", TransportShm::SERVER));
+    }
+    if (!telemetri.get()) {
+        // like PUB, telemetry is dropped when nobody reads it
+        TransportShm::Options options;
+        options.dropWhenFull = true;
+        telemetri = TransportSharedPtr(new TransportShm("rrc_test1", TransportShm::SERVER, options));
+    }
+    if (!commands.get()) {commands = TransportSharedPtr(new TransportShm("rrc_test0", TransportShm::CLIENT));}
+    if (!telemetry.get()) {telemetry = TransportSharedPtr(new TransportShm("rrc_test1", TransportShm::CLIENT));}
+  #endif
+  #ifdef TRANSPORT_LOOPBACK
+    if (!command.get()) {
+        printf("using in-process loopback\n");
+        std::tie(commands, command) = TransportLoopback::createPair();
+        // like PUB, telemetry is dropped when nobody reads it
+        TransportLoopback::Options options;
+        options.dropWhenFull = true;
+        std::tie(telemetry, telemetri) = TransportLoopback::createPair(options);
+    }
+  #endif
   #ifdef TRANSPORT_UDT
     if (!command.get()) {
         printf("using UDT\n");
@@ -78,6 +176,65 @@ void initComms() {
   #endif
 }
 
+TransportSharedPtr asyncCommands;
+TransportSharedPtr asyncCommand;
+
+/**
+ * @brief init command transports that allow several outstanding requests
+ */
+void initAsyncComms() {
+  #ifdef TRANSPORT_DEFAULT
+    if (!asyncCommands.get()) {asyncCommands = TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7005", TransportZmq::DEALER));}
+    if (!asyncCommand.get()) {asyncCommand = TransportSharedPtr(new TransportZmq("tcp://*:7005", TransportZmq::ROUTER));}
+  #endif
+  #ifdef TRANSPORT_DEFAULT_GZIP
+    if (!asyncCommands.get()) {
+      asyncCommands = TransportSharedPtr(new TransportWrapperGzip(TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7005", TransportZmq::DEALER))));
+    }
+    if (!asyncCommand.get()) {
+      asyncCommand = TransportSharedPtr(new TransportWrapperGzip(TransportSharedPtr(new TransportZmq("tcp://*:7005", TransportZmq::ROUTER))));
+    }
+  #endif
+  #ifdef TRANSPORT_IPC
+    if (!asyncCommand.get()) {asyncCommand = TransportSharedPtr(new TransportZmq("ipc:///tmp/test2", TransportZmq::ROUTER));}
+    if (!asyncCommands.get()) {asyncCommands = TransportSharedPtr(new TransportZmq("ipc:///tmp/test2", TransportZmq::DEALER));}
+  #endif
+  // other transports (UDT) are not limited to one outstanding request
+  if (!asyncCommands.get()) {
+    initComms();
+    asyncCommands = commands;
+    asyncCommand = command;
+  }
+}
+
+TransportSharedPtr filteredTelemetry;
+TransportSharedPtr filteredTelemetri;
+
+/**
+ * @brief used to init a telemetry channel supporting subscriptions (no wrapper, the type header must not be compressed)
+ */
+void initFilteredComms() {
+  #ifdef TRANSPORT_DEFAULT_LZ4
+    // the type header is not compressed, so the wrapper forwards subscriptions
+    if (!filteredTelemetri.get()) {filteredTelemetri = TransportSharedPtr(new TransportWrapperLZ4(TransportSharedPtr(new TransportZmq("tcp://*:7006", TransportZmq::PUB)), 0));}
+    if (!filteredTelemetry.get()) {filteredTelemetry = TransportSharedPtr(new TransportWrapperLZ4(TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7006", TransportZmq::SUB)), 0));}
+  #endif
+  #if defined(TRANSPORT_DEFAULT) || defined(TRANSPORT_DEFAULT_GZIP) || defined(TRANSPORT_DEFAULT_ZSTD)
+    if (!filteredTelemetri.get()) {filteredTelemetri = TransportSharedPtr(new TransportZmq("tcp://*:7006", TransportZmq::PUB));}
+    if (!filteredTelemetry.get()) {filteredTelemetry = TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7006", TransportZmq::SUB));}
+  #endif
+  #ifdef TRANSPORT_IPC
+    if (!filteredTelemetri.get()) {filteredTelemetri = TransportSharedPtr(new TransportZmq("ipc:///tmp/test3", TransportZmq::PUB));}
+    if (!filteredTelemetry.get()) {filteredTelemetry = TransportSharedPtr(new TransportZmq("ipc:///tmp/test3", TransportZmq::SUB));}
+  #endif
+  // other transports don't support subscriptions
+  if (!filteredTelemetry.get()) {
+    initComms();
+    filteredTelemetry = telemetry;
+    filteredTelemetri = telemetri;
+  }
+}
+
 template <class PROTOBUFDATA> PROTOBUFDATA testCommand(PROTOBUFDATA protodata, const ControlMessageType &type) {
   initComms();
 
@@ -651,6 +808,75 @@ BOOST_AUTO_TEST_CASE(check_simple_sensors) {
 
 }
 
+BOOST_AUTO_TEST_CASE(check_simple_sensor_values) {
+  initComms();
+
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+
+  // the definition suggests the buffer sizes, the controller setting wins
+  SimpleSensors definition;
+  for (uint32_t id = 0; id < 200; ++id) {
+    SimpleSensor *sensor = definition.add_sensors();
+    sensor->set_id(id);
+    sensor->set_buffer_size(id == 1 ? 10 : 0);
+  }
+  definition.mutable_sensors(2)->set_buffer_size(10);
+  // a corrupt or huge suggestion is limited
+  definition.mutable_sensors(4)->set_buffer_size(4000000000u);
+  controller.setSimpleSensorBufferSize(2, 3);
+  BOOST_CHECK(!controller.setSimpleSensorBufferSize(3, 0));
+  BOOST_CHECK(!controller.setDefaultSimpleSensorBufferSize(0));
+  controller.initSimpleSensorBuffers(definition);
+  {
+    auto buffers = controller.simplesensorbuffer->lockedAccess();
+    BOOST_CHECK_EQUAL(buffers.get().size(), 200);
+    BOOST_CHECK_EQUAL(buffers.get()[0]->capacity(), 1);
+    BOOST_CHECK_EQUAL(buffers.get()[1]->capacity(), 10);
+    BOOST_CHECK_EQUAL(buffers.get()[2]->capacity(), 3);
+    BOOST_CHECK_EQUAL(buffers.get()[3]->capacity(), 1);
+    BOOST_CHECK_EQUAL(buffers.get()[4]->capacity(), SimpleBuffer<SimpleSensor>::maxSuggestedBufferSize);
+  }
+
+  robot.startUpdateThread(0);
+  controller.startUpdateThread(0);
+
+  // many values in one message, values of the same id are buffered in order
+  SimpleSensors values;
+  for (uint32_t id = 0; id < 200; ++id) {
+    SimpleSensor *sensor = values.add_sensors();
+    sensor->set_id(id);
+    sensor->add_value(id);
+  }
+  for (int i = 0; i < 4; ++i) {
+    SimpleSensor *sensor = values.add_sensors();
+    sensor->set_id(1);
+    sensor->add_value(1000 + i);
+  }
+  robot.setSimpleSensors(values);
+
+  std::vector<SimpleSensor> received;
+  for (int i = 0; i < 100 && controller.getAllSimpleSensor(199, &received) == 0; ++i) {
+    usleep(10000);
+  }
+  BOOST_REQUIRE_EQUAL(received.size(), 1);
+  BOOST_CHECK_EQUAL(received[0].value(0), 199);
+
+  received.clear();
+  BOOST_CHECK_EQUAL(controller.getAllSimpleSensor(1, &received), 5);
+  BOOST_CHECK_EQUAL(received[0].value(0), 1);
+  BOOST_CHECK_EQUAL(received[4].value(0), 1003);
+
+  // depth one keeps the latest value
+  SimpleSensor latest;
+  BOOST_CHECK(controller.getSimpleSensor(0, &latest));
+  BOOST_CHECK_EQUAL(latest.value(0), 0);
+  BOOST_CHECK(!controller.getSimpleSensor(0, &latest));
+
+  controller.stopUpdateThread();
+  robot.stopUpdateThread();
+}
+
 BOOST_AUTO_TEST_CASE(check_callbacks) {
   Pose robotpose, controlpose;
   robotpose = TypeGenerator::genPose();
@@ -703,3 +929,3310 @@ BOOST_AUTO_TEST_CASE(check_callbacks) {
 //   recv = testTelemetry(send, WRENCH_STATE);
 //   COMPARE_PROTOBUF(send, recv);
 // }
+
+BOOST_AUTO_TEST_CASE(check_receive_buffer) {
+  initComms();
+  ControlledRobot robot(command, telemetri);
+
+  Pose pose = TypeGenerator::genPose();
+  robot.setCurrentPose(pose);
+
+  // receive the raw telemetry message into a transport owned buffer
+  ReceiveBuffer buf;
+  Pose received;
+  bool found = false;
+  while (!found) {
+    if (telemetry->receive(&buf, Transport::NOBLOCK)) {
+      BOOST_REQUIRE(buf.size() >= sizeof(uint16_t));
+      // there may be old messages from the tests before
+      if (buf.view().get<uint16_t>() == CURRENT_POSE) {
+        MessageView payload = buf.view().sub(sizeof(uint16_t));
+        BOOST_CHECK(received.ParseFromArray(payload.data, payload.size));
+        found = received.SerializeAsString() == pose.SerializeAsString();
+      }
+    } else {
+      usleep(10000);
+    }
+  }
+  COMPARE_PROTOBUF(pose, received);
+
+  // views on the data behind the end are empty
+  BOOST_CHECK_EQUAL(buf.view().sub(buf.size() + 1).size, 0);
+}
+
+BOOST_AUTO_TEST_CASE(check_reactor_mode) {
+  initComms();
+
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+
+  // the robot waits on the transport, so it should not take the full second to read the command
+  robot.startUpdateThread(1000, UpdateThread::REACTOR);
+
+  Twist twist = TypeGenerator::genTwist();
+  Timer timer;
+  timer.start();
+  controller.setTwistCommand(twist);
+
+  Twist received;
+  while (!robot.getTwistCommand(&received) && timer.getElapsedTime() < 5) {
+    usleep(1000);
+  }
+  BOOST_CHECK(timer.getElapsedTime() < 0.5);
+  robot.stopUpdateThread();
+  COMPARE_PROTOBUF(twist, received);
+}
+
+BOOST_AUTO_TEST_CASE(check_async_requests) {
+  initComms();
+  initAsyncComms();
+
+  RobotController controller(asyncCommands, telemetry);
+  controller.setAsyncRequests(true);
+  ControlledRobot robot(asyncCommand, telemetri);
+
+  robot.startUpdateThread(10);
+  // receives the replies of the async requests
+  controller.startUpdateThread(10);
+
+  // many requests without waiting for the replies
+  std::vector< std::future<std::string> > replies;
+  for (int i = 0; i < 10; ++i) {
+    Twist twist = TypeGenerator::genTwist();
+    replies.push_back(controller.sendCommandAsync(twist, TWIST_COMMAND));
+  }
+  for (std::future<std::string> &reply : replies) {
+    std::string replystr = reply.get();
+    BOOST_REQUIRE_EQUAL(replystr.size(), sizeof(uint16_t));
+    BOOST_CHECK_EQUAL(MessageView(replystr).get<uint16_t>(), TWIST_COMMAND);
+  }
+
+  // the synchronous setters still work
+  Pose pose = TypeGenerator::genPose();
+  controller.setTargetPose(pose);
+  Pose received;
+  while (!robot.getTargetPoseCommand(&received)) {
+    usleep(1000);
+  }
+  COMPARE_PROTOBUF(pose, received);
+
+  controller.stopUpdateThread();
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_telemetry_batch) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+
+  Pose pose = TypeGenerator::genPose();
+  Twist twist = TypeGenerator::genTwist();
+  JointState joints = TypeGenerator::genJointState();
+
+  robot.beginTelemetryBatch();
+  robot.setCurrentPose(pose);
+  robot.setCurrentTwist(twist);
+  {
+    // nested batches are sent with the outer one
+    ControlledRobot::TelemetryBatch batch(&robot);
+    robot.setJointState(joints);
+  }
+  BOOST_CHECK(robot.commitTelemetryBatch() > 0);
+  // no open batch
+  BOOST_CHECK_EQUAL(robot.commitTelemetryBatch(), 0);
+
+  // there may be old messages from the tests before, all three are evaluated in the same update()
+  Pose receivedPose;
+  Twist receivedTwist;
+  JointState receivedJoints;
+  Timer timer;
+  timer.start();
+  while (receivedJoints.SerializeAsString() != joints.SerializeAsString() && timer.getElapsedTime() < 5) {
+    controller.update();
+    while (controller.getCurrentJointState(&receivedJoints) && receivedJoints.SerializeAsString() != joints.SerializeAsString()) {}
+    usleep(1000);
+  }
+  while (controller.getCurrentPose(&receivedPose)) {}
+  while (controller.getCurrentTwist(&receivedTwist)) {}
+  COMPARE_PROTOBUF(pose, receivedPose);
+  COMPARE_PROTOBUF(twist, receivedTwist);
+  COMPARE_PROTOBUF(joints, receivedJoints);
+}
+
+BOOST_AUTO_TEST_CASE(check_telemetry_rate_limit) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+
+  // only every third twist is sent
+  BOOST_CHECK(controller.setTelemetryRateLimit(CURRENT_TWIST, 0, 3));
+
+  Twist twist;
+  int sent = 0;
+  for (int i = 0; i < 9; ++i) {
+    twist = TypeGenerator::genTwist();
+    if (robot.setCurrentTwist(twist) > 0) {
+      sent++;
+    }
+  }
+  BOOST_CHECK_EQUAL(sent, 3);
+
+  // skipped messages are still available on request
+  Twist requested;
+  controller.requestTelemetry(CURRENT_TWIST, &requested);
+  COMPARE_PROTOBUF(twist, requested);
+
+  #ifdef RRC_STATISTICS
+    BOOST_CHECK_EQUAL(robot.getStatistics().stat_per_type[CURRENT_TWIST].getStats().skippedTotal, 6);
+  #endif
+
+  // the frequency limit lets the first message pass
+  BOOST_CHECK(controller.setTelemetryRateLimit(CURRENT_TWIST, 1));
+  BOOST_CHECK(robot.setCurrentTwist(twist) > 0);
+  BOOST_CHECK_EQUAL(robot.setCurrentTwist(twist), 0);
+
+  // remove the limit
+  BOOST_CHECK(controller.setTelemetryRateLimit(CURRENT_TWIST, 0));
+  BOOST_CHECK(robot.setCurrentTwist(twist) > 0);
+
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_telemetry_subscriptions) {
+  initComms();
+  initFilteredComms();
+  RobotController controller(commands, filteredTelemetry);
+  ControlledRobot robot(command, filteredTelemetri);
+
+  bool filtered = controller.subscribeTelemetry(CURRENT_POSE);
+
+  Pose pose = TypeGenerator::genPose();
+  Twist twist = TypeGenerator::genTwist();
+  Pose receivedPose;
+  Timer timer;
+  timer.start();
+  // subscriptions need some time to reach the publisher
+  while (receivedPose.SerializeAsString() != pose.SerializeAsString() && timer.getElapsedTime() < 5) {
+    robot.setCurrentTwist(twist);
+    robot.setCurrentPose(pose);
+    usleep(10000);
+    controller.update();
+    while (controller.getCurrentPose(&receivedPose)) {}
+  }
+  COMPARE_PROTOBUF(pose, receivedPose);
+
+  Twist receivedTwist;
+  if (filtered) {
+    // not subscribed, filtered on the robot side
+    BOOST_CHECK(!controller.getCurrentTwist(&receivedTwist));
+    BOOST_CHECK(controller.unsubscribeTelemetry(CURRENT_POSE));
+  } else {
+    BOOST_CHECK(controller.getCurrentTwist(&receivedTwist));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(check_packed_pointcloud) {
+  PointCloud unpacked = TypeGenerator::genPointCloud();
+  PointCloud packed = unpacked;
+  PackedPointCloud::pack(&packed);
+  BOOST_CHECK_EQUAL(packed.points_size(), 0);
+  BOOST_CHECK_EQUAL(PackedPointCloud::size(packed), PackedPointCloud::size(unpacked));
+  BOOST_CHECK(packed.ByteSizeLong() < unpacked.ByteSizeLong());
+  for (size_t i = 0; i < PackedPointCloud::size(unpacked); ++i) {
+    PackedPointCloud::Point a = PackedPointCloud::getPoint(packed, i);
+    PackedPointCloud::Point b = PackedPointCloud::getPoint(unpacked, i);
+    BOOST_CHECK_EQUAL(a.x, b.x);
+    BOOST_CHECK_EQUAL(a.y, b.y);
+    BOOST_CHECK_EQUAL(a.z, b.z);
+  }
+
+  PointCloud received = testTelemetry(packed, POINTCLOUD);
+  COMPARE_PROTOBUF(packed, received);
+  BOOST_REQUIRE(PackedPointCloud::getChannel(received, "intensity"));
+
+  // old receivers get the repeated points back
+  PackedPointCloud::unpack(&received);
+  COMPARE_PROTOBUF(unpacked, received);
+}
+
+BOOST_AUTO_TEST_CASE(check_pointcloud_encoding) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+  controller.startUpdateThread(10);
+
+  PointCloud cloud = TypeGenerator::genPointCloud();
+  PointCloud packed = cloud;
+  PackedPointCloud::pack(&packed);
+  const float resolution = 0.5;
+
+  auto checkPoints = [&](const PointCloud &decoded) {
+    // each point has its voxel center in the decoded cloud (within half the resolution on each axis)
+    for (size_t i = 0; i < PackedPointCloud::size(cloud); ++i) {
+      PackedPointCloud::Point point = PackedPointCloud::getPoint(cloud, i);
+      bool found = false;
+      for (size_t j = 0; j < PackedPointCloud::size(decoded) && !found; ++j) {
+        PackedPointCloud::Point center = PackedPointCloud::getPoint(decoded, j);
+        found = std::abs(center.x - point.x) <= resolution / 2 &&
+                std::abs(center.y - point.y) <= resolution / 2 &&
+                std::abs(center.z - point.z) <= resolution / 2;
+      }
+      BOOST_CHECK(found);
+    }
+  };
+
+  PointCloudEncoding encoding;
+  encoding.set_resolution(resolution);
+  encoding.set_type(QUANTIZED_POINTCLOUD);
+  BOOST_CHECK(controller.setPointCloudEncoding(encoding));
+
+  robot.setPointCloud(cloud);
+  PointCloud received;
+  while (!controller.getPointCloud(&received)) {
+    usleep(10000);
+  }
+  // quantized clouds keep point order and channels
+  BOOST_CHECK_EQUAL(PackedPointCloud::size(received), PackedPointCloud::size(cloud));
+  BOOST_CHECK(PackedPointCloud::getChannel(received, "intensity"));
+  checkPoints(received);
+
+  encoding.set_type(OCTREE_POINTCLOUD);
+  BOOST_CHECK(controller.setPointCloudEncoding(encoding));
+  robot.setPointCloudMap(cloud);
+  PointCloud map;
+  BOOST_CHECK(controller.requestPointCloudMap(&map));
+  BOOST_CHECK(PackedPointCloud::size(map) <= PackedPointCloud::size(cloud));
+  checkPoints(map);
+
+  PointCloud octree = cloud;
+  BOOST_CHECK(PointCloudCodec::encode(&octree, encoding));
+  BOOST_CHECK(octree.ByteSizeLong() < packed.ByteSizeLong());
+
+  // the extent is too large for 16 bit, stays packed
+  encoding.set_type(QUANTIZED_POINTCLOUD);
+  encoding.set_resolution(0.01);
+  PointCloud large = cloud;
+  BOOST_CHECK(!PointCloudCodec::encode(&large, encoding));
+  COMPARE_PROTOBUF(packed, large);
+
+  encoding.set_type(UNENCODED_POINTCLOUD);
+  BOOST_CHECK(controller.setPointCloudEncoding(encoding));
+
+  controller.stopUpdateThread();
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_map_tiles) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+
+  const uint32_t mapId = 10;
+  auto genTile = [](const float &value) {
+    GridMap tile;
+    SimpleSensor *layer = tile.add_layers();
+    layer->set_name("height");
+    layer->mutable_size()->set_x(4);
+    layer->mutable_size()->set_y(2);
+    layer->mutable_scale()->set_x(0.5);
+    layer->mutable_scale()->set_y(0.5);
+    layer->mutable_value()->Resize(8, value);
+    return tile;
+  };
+
+  robot.setMapTile(mapId, 0, 0, genTile(1));
+  robot.setMapTile(mapId, 1, 0, genTile(2));
+  robot.setMapTile(mapId, 1, 1, genTile(3));
+
+  MapTileCache cache;
+  BOOST_CHECK_EQUAL(controller.requestMapTiles(&cache, mapId), 3);
+  // nothing changed
+  BOOST_CHECK_EQUAL(controller.requestMapTiles(&cache, mapId), 0);
+
+  robot.setMapTile(mapId, 0, 0, genTile(4));
+  BOOST_CHECK_EQUAL(controller.requestMapTiles(&cache, mapId), 1);
+
+  GridMap merged;
+  BOOST_REQUIRE(cache.getGridMap(&merged));
+  BOOST_REQUIRE_EQUAL(merged.layers_size(), 1);
+  const SimpleSensor &layer = merged.layers(0);
+  BOOST_CHECK_EQUAL(layer.size().x(), 8);
+  BOOST_CHECK_EQUAL(layer.size().y(), 4);
+  BOOST_CHECK_EQUAL(layer.value(0), 4);
+  BOOST_CHECK_EQUAL(layer.value(4), 2);
+  BOOST_CHECK_EQUAL(layer.value(4 + 2 * 8), 3);
+  // missing tile
+  BOOST_CHECK(std::isnan(layer.value(2 * 8)));
+
+  // a new cache gets everything
+  MapTileCache newCache;
+  BOOST_CHECK_EQUAL(controller.requestMapTiles(&newCache, mapId), 3);
+
+  robot.clearMapTiles(mapId);
+  BOOST_CHECK_EQUAL(controller.requestMapTiles(&cache, mapId), 0);
+  BOOST_CHECK(cache.getTiles().empty());
+
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_map_transfer) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+  controller.startUpdateThread(0);
+
+  const uint32_t mapId = 11;
+  std::string map(300000, 0);
+  for (size_t i = 0; i < map.size(); ++i) {
+    map[i] = i % 251;
+  }
+  robot.setMap(map, mapId);
+
+  float lastProgress = 0;
+  std::shared_ptr<MapTransfer> transfer = controller.startMapTransfer(mapId, [&lastProgress](const float &progress) {
+    lastProgress = progress;
+  }, 16 * 1024);
+  BOOST_REQUIRE(transfer.get());
+  BOOST_REQUIRE(transfer->waitForCompletion(5));
+  BOOST_CHECK_EQUAL(lastProgress, 1);
+  std::string received;
+  BOOST_REQUIRE(transfer->getMap(&received));
+  BOOST_CHECK(received == map);
+
+  // unknown maps complete without data
+  std::shared_ptr<MapTransfer> missing = controller.startMapTransfer(mapId + 1);
+  BOOST_REQUIRE(missing.get());
+  BOOST_CHECK(missing->isComplete());
+  BOOST_CHECK(!missing->getMap(&received));
+
+  // maps larger than the maximum size are rejected before allocating the buffer
+  BOOST_CHECK(!controller.startMapTransfer(mapId, nullptr, 16 * 1024, map.size() - 1).get());
+
+  robot.stopUpdateThread();
+  controller.stopUpdateThread();
+
+  // resume after lost chunks
+  MapTransferSender sender;
+  MapTransfer resumed(1, mapId, 1000);
+  MapTransferInfo info = sender.start(resumed.getResumeRequest(), [&map](std::string *data) {
+    *data = map;
+    return true;
+  });
+  BOOST_CHECK_EQUAL(info.chunks(), 300);
+  // a forged info with too few chunks for the size
+  MapTransferInfo forged = info;
+  forged.set_total_size(0xffffffffffff);
+  BOOST_CHECK(!resumed.setInfo(forged));
+  forged = info;
+  forged.set_chunks(0xffffffff);
+  BOOST_CHECK(!resumed.setInfo(forged));
+  BOOST_CHECK(!resumed.isComplete());
+  BOOST_CHECK(resumed.setInfo(info));
+  MapChunk chunk;
+  for (int i = 0; i < 10; ++i) {
+    BOOST_REQUIRE(sender.nextChunk(&chunk));
+    // lose chunk 5
+    if (i != 5) {
+      resumed.addChunk(chunk);
+    }
+  }
+  BOOST_CHECK_EQUAL(resumed.getFirstMissingChunk(), 5);
+  MapTransferRequest request = resumed.getResumeRequest();
+  sender.start(request, [](std::string *data) { return false; });
+  while (sender.nextChunk(&chunk)) {
+    resumed.addChunk(chunk);
+  }
+  BOOST_CHECK(resumed.isComplete());
+  BOOST_REQUIRE(resumed.getMap(&received));
+  BOOST_CHECK(received == map);
+}
+
+BOOST_AUTO_TEST_CASE(check_gridmap_encoding) {
+  GridMap gridmap;
+  SimpleSensor *layer = gridmap.add_layers();
+  layer->set_name("height");
+  layer->mutable_size()->set_x(100);
+  layer->mutable_size()->set_y(100);
+  layer->mutable_value()->Resize(100 * 100, std::numeric_limits<float>::quiet_NaN());
+  // a few rows with values, most cells are empty
+  for (int i = 2000; i < 2300; ++i) {
+    layer->set_value(i, (i % 100) * 0.01);
+  }
+  const GridMap original = gridmap;
+
+  auto checkDecoded = [&original](const GridMap &decoded, const float &maxError) {
+    BOOST_REQUIRE_EQUAL(decoded.layers(0).value_size(), original.layers(0).value_size());
+    for (int i = 0; i < original.layers(0).value_size(); ++i) {
+      float expected = original.layers(0).value(i);
+      float value = decoded.layers(0).value(i);
+      if (std::isnan(expected)) {
+        BOOST_CHECK(std::isnan(value));
+      } else {
+        BOOST_CHECK_SMALL(value - expected, maxError);
+      }
+    }
+  };
+
+  GridMapEncoding encoding;
+  encoding.set_type(SPARSE_LAYER);
+  GridMap encoded = original;
+  BOOST_CHECK(GridMapLayerCodec::encode(&encoded, encoding));
+  BOOST_CHECK_EQUAL(encoded.layers(0).value_size(), 0);
+  BOOST_CHECK_LT(encoded.ByteSizeLong(), original.ByteSizeLong() / 10);
+  BOOST_CHECK(GridMapLayerCodec::decode(&encoded));
+  checkDecoded(encoded, 1e-6);
+
+  encoded = original;
+  encoding.set_type(QUANTIZED_8BIT_LAYER);
+  BOOST_CHECK(GridMapLayerCodec::encode(&encoded, encoding));
+  BOOST_CHECK_EQUAL(encoded.layers(0).quantized_values().size(), 100 * 100);
+  GridMapLayerCodec::decode(&encoded);
+  checkDecoded(encoded, 0.99 / 254 / 2 + 1e-6);
+
+  encoded = original;
+  encoding.set_type(QUANTIZED_16BIT_LAYER);
+  BOOST_CHECK(GridMapLayerCodec::encode(&encoded, encoding));
+  GridMapLayerCodec::decode(&encoded);
+  checkDecoded(encoded, 0.99 / 65534 / 2 + 1e-6);
+
+  // dense layer: quantized if allowed
+  GridMap dense = original;
+  for (float &value : *dense.mutable_layers(0)->mutable_value()) {
+    value = 1;
+  }
+  encoding.set_type(AUTO_LAYER);
+  encoding.set_max_error(0.01);
+  GridMapLayerCodec::encode(&dense, encoding);
+  BOOST_CHECK_EQUAL(dense.layers(0).encoding(), QUANTIZED_8BIT_LAYER);
+
+  // through the robot
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+  robot.setGridMapEncoding(encoding);
+  robot.setGridMap(original);
+  GridMap received;
+  BOOST_REQUIRE(controller.requestGridMap(&received));
+  checkDecoded(received, 1e-6);
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_compact_joints) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+
+  JointState controllable;
+  for (int i = 0; i < 40; ++i) {
+    controllable.add_name("manipulator_joint_" + std::to_string(i));
+    controllable.add_position(0);
+  }
+  robot.initControllableJoints(controllable);
+  BOOST_REQUIRE(controller.setCompactJoints());
+
+  // in table order, without names
+  JointState joints = controllable;
+  for (int i = 0; i < 40; ++i) {
+    joints.set_position(i, i * 0.1);
+  }
+  int compactSize = robot.setJointState(joints);
+  BOOST_CHECK_LT(compactSize, joints.ByteSizeLong() / 2);
+
+  JointState received;
+  Timer timer;
+  timer.start();
+  while (received.SerializeAsString() != joints.SerializeAsString() && timer.getElapsedTime() < 5) {
+    controller.update();
+    while (controller.getCurrentJointState(&received) && received.SerializeAsString() != joints.SerializeAsString()) {}
+    usleep(1000);
+  }
+  COMPARE_PROTOBUF(joints, received);
+
+  // requests get the names, the requesting controller may not know the table
+  JointState requested;
+  BOOST_REQUIRE(requested.ParseFromString(*robot.getLatestTelemetry(JOINT_STATE)));
+  COMPARE_PROTOBUF(joints, requested);
+
+  // commands for some joints use indices into the table
+  JointCommand command;
+  command.add_name("manipulator_joint_3");
+  command.add_name("manipulator_joint_1");
+  command.add_position(0.3);
+  command.add_position(0.1);
+  controller.setJointCommand(command);
+  JointCommand receivedCommand;
+  BOOST_CHECK(robot.getJointsCommand(&receivedCommand));
+  COMPARE_PROTOBUF(command, receivedCommand);
+
+  // the robot changes its joints: names are sent again
+  controllable.add_name("gripper");
+  robot.initControllableJoints(controllable);
+  controller.setJointCommand(command);
+  BOOST_CHECK(robot.getJointsCommand(&receivedCommand));
+  COMPARE_PROTOBUF(command, receivedCommand);
+  BOOST_CHECK_EQUAL(robot.setJointState(joints), joints.ByteSizeLong());
+
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_lazy_telemetry) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+
+  BOOST_CHECK(controller.setLazyTelemetry(LOG_MESSAGE));
+  // decoded on receive
+  BOOST_CHECK(!controller.setLazyTelemetry(JOINT_STATE));
+
+  LogMessage received_callback;
+  controller.addTelemetryReceivedCallback<LogMessage>(LOG_MESSAGE, [&](const LogMessage &log) {
+    received_callback = log;
+  });
+
+  controller.startUpdateThread(10);
+  robot.startUpdateThread(10);
+
+  LogMessage log_message;
+  log_message.set_level(INFO);
+  log_message.set_message("parsed when read");
+  robot.setLogMessage(log_message);
+
+  LogMessage received;
+  Timer timer;
+  timer.start();
+  while (!controller.getLogMessage(&received) && timer.getElapsedTime() < 5) {
+    usleep(10 * 1000);
+  }
+  COMPARE_PROTOBUF(log_message, received);
+  COMPARE_PROTOBUF(log_message, received_callback);
+
+  robot.stopUpdateThread();
+  controller.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_callback_executor) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  std::shared_ptr<CallbackExecutor> executor = std::make_shared<CallbackExecutor>();
+  controller.setCallbackExecutor(executor);
+
+  // reading the buffer of the same type, not possible in the update thread
+  std::atomic<int> callbacks(0);
+  controller.addTelemetryReceivedCallback<Pose>(CURRENT_POSE, [&](const Pose &pose) {
+    Pose buffered;
+    controller.getCurrentPose(&buffered);
+    callbacks++;
+  });
+
+  controller.startUpdateThread(10);
+  robot.startUpdateThread(10);
+
+  Pose pose;
+  pose.mutable_position()->set_x(1);
+  Timer timer;
+  timer.start();
+  while (callbacks == 0 && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    usleep(10 * 1000);
+  }
+  BOOST_CHECK(callbacks > 0);
+
+  robot.stopUpdateThread();
+  controller.stopUpdateThread();
+  BOOST_CHECK(executor->waitUntilIdle(5));
+}
+
+BOOST_AUTO_TEST_CASE(check_latest_value_telemetry) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  BOOST_CHECK(controller.setLatestValueTelemetry(CURRENT_POSE));
+  controller.startUpdateThread(10);
+  robot.startUpdateThread(10);
+
+  // wait for the connection
+  Pose pose;
+  Timer timer;
+  timer.start();
+  while (!controller.getCurrentPose(&pose) && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    usleep(10 * 1000);
+  }
+
+  for (int i = 0; i < 20; ++i) {
+    pose.mutable_position()->set_x(i);
+    robot.setCurrentPose(pose);
+  }
+  usleep(300 * 1000);
+
+  // only the newest pose is kept
+  BOOST_CHECK_EQUAL(controller.getBufferSize(CURRENT_POSE), 1);
+  Pose received;
+  BOOST_CHECK(controller.getCurrentPose(&received));
+  BOOST_CHECK_EQUAL(received.position().x(), 19);
+  BOOST_CHECK(!controller.getCurrentPose(&received));
+
+  robot.stopUpdateThread();
+  controller.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_receive_statistics) {
+  LatencyHistogram histogram;
+  for (uint64_t value = 1; value <= 10000; ++value) {
+    histogram.record(value);
+  }
+  LatencyHistogram::Summary summary = histogram.summary();
+  BOOST_CHECK_EQUAL(summary.count, 10000);
+  BOOST_CHECK_EQUAL(summary.min, 1);
+  BOOST_CHECK_EQUAL(summary.max, 10000);
+  // within the precision of the buckets
+  BOOST_CHECK_CLOSE(static_cast<double>(summary.p50), 5000, 3.2);
+  BOOST_CHECK_CLOSE(static_cast<double>(summary.p99), 9900, 3.2);
+  BOOST_CHECK_CLOSE(static_cast<double>(summary.p999), 9990, 3.2);
+
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  controller.startUpdateThread(10);
+  robot.startUpdateThread(10);
+
+  // wait for the connection
+  Pose pose;
+  Timer timer;
+  timer.start();
+  while (!controller.getCurrentPose(&pose) && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    usleep(10 * 1000);
+  }
+  controller.getReceiveStatistics().reset();
+
+  size_t bytes = 0;
+  for (int i = 0; i < 10; ++i) {
+    timeval now;
+    gettimeofday(&now, 0);
+    pose.mutable_timestamp()->set_secs(now.tv_sec);
+    pose.mutable_timestamp()->set_nsecs(now.tv_usec * 1000);
+    robot.setCurrentPose(pose);
+    bytes += pose.ByteSizeLong();
+    controller.setTwistCommand(TypeGenerator::genTwist());
+    usleep(10 * 1000);
+  }
+  usleep(100 * 1000);
+
+  ReceiveStatistics::TypeStats stats = controller.getReceiveStatistics().getTelemetryStats(CURRENT_POSE);
+  BOOST_CHECK_EQUAL(stats.messages, 10);
+  BOOST_CHECK_EQUAL(stats.bytes, bytes);
+  BOOST_CHECK_EQUAL(stats.interArrivalUs.count, 9);
+  BOOST_CHECK(stats.messagesPerSecond > 0);
+  BOOST_CHECK_EQUAL(stats.ageUs.count, 10);
+  // same clock on both sides
+  BOOST_CHECK(stats.ageUs.max < 1000000);
+  BOOST_CHECK_EQUAL(controller.getReceiveStatistics().getTelemetryStats(JOINT_STATE).messages, 0);
+  BOOST_CHECK(controller.getReceiveStatistics().getRoundTrip(TWIST_COMMAND).count >= 10);
+  BOOST_CHECK(controller.getReceiveStatistics().getRoundTrip(TWIST_COMMAND).p50 > 0);
+
+  robot.stopUpdateThread();
+  controller.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_clock_offset) {
+  // robot clock 5 s ahead and 100 ppm fast, asymmetric delays
+  ClockOffsetEstimator estimator;
+  const int64_t second = 1000000000;
+  int64_t local = 1000 * second;
+  for (int i = 0; i < 60; ++i) {
+    int64_t up = (1 + i % 5) * 1000000;
+    int64_t down = (1 + i % 3) * 1000000;
+    int64_t remoteReceive = local + up + 5 * second + (local + up - 1000 * second) / 10000;
+    estimator.addSample(local, remoteReceive, remoteReceive + 100000, local + up + 100000 + down);
+    local += second;
+  }
+  ClockOffsetEstimator::Estimate estimate = estimator.getEstimate();
+  BOOST_CHECK(estimate.valid);
+  int64_t expected = 5 * second + (local - 1000 * second) / 10000;
+  // within the delays
+  BOOST_CHECK_LT(std::llabs(estimator.getOffsetNs(local) - expected), 2000000);
+  BOOST_CHECK_CLOSE(estimate.driftPpm, 100, 20);
+  BOOST_CHECK_LT(std::llabs(estimator.toLocalNs(local + expected) - local), 2000000);
+
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(1);
+  BOOST_CHECK_EQUAL(controller.getRobotClockOffset(), 0);
+
+  controller.setHeartBeatDuration(0.05);
+  Timer timer;
+  timer.start();
+  while (!controller.getRobotClockEstimate().valid && timer.getElapsedTime() < 5) {
+    controller.update();
+    usleep(10 * 1000);
+  }
+  BOOST_CHECK(controller.getRobotClockEstimate().valid);
+  // same clock on both sides
+  BOOST_CHECK_LT(std::fabs(controller.getRobotClockOffset()), 0.01);
+  BOOST_CHECK_LT(std::fabs(controller.getAge(robot.getTime())), 0.01);
+
+  // stale telemetry is dropped
+  BOOST_CHECK(controller.setMaxTelemetryAge(CURRENT_POSE, 1));
+  BOOST_CHECK(!controller.setMaxTelemetryAge(SIMPLE_ACTIONS, 1));
+  Pose pose;
+  TimeStamp old = robot.getTime();
+  old.set_secs(old.secs() - 10);
+  *pose.mutable_timestamp() = old;
+  robot.setCurrentPose(pose);
+  *pose.mutable_timestamp() = robot.getTime();
+  robot.setCurrentPose(pose);
+  usleep(50 * 1000);
+  controller.update();
+
+  Pose received;
+  BOOST_CHECK(controller.getCurrentPose(&received));
+  BOOST_CHECK_EQUAL(received.timestamp().secs(), pose.timestamp().secs());
+  BOOST_CHECK(!controller.getCurrentPose(&received));
+  BOOST_CHECK_EQUAL(controller.getStaleTelemetryDropped(CURRENT_POSE), 1);
+
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_robot_statistics) {
+  // counted without races from several sending threads
+  Statistics statistics;
+  statistics.setEnabled(true);
+  std::vector<std::thread> senders;
+  for (int i = 0; i < 4; ++i) {
+    senders.emplace_back([&statistics]() {
+      for (int message = 0; message < 1000; ++message) {
+        statistics.stat_per_type[CURRENT_POSE].addBytesSent(10);
+      }
+    });
+  }
+  for (std::thread &sender : senders) {
+    sender.join();
+  }
+  BOOST_CHECK_EQUAL(statistics.stat_per_type[CURRENT_POSE].getStats().messagesTotal, 4000);
+  BOOST_CHECK_EQUAL(statistics.stat_per_type[CURRENT_POSE].getStats().bytesTotal, 40000);
+
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.getStatistics().setEnabled(true);
+  robot.setStatisticsPublishInterval(0.05);
+  controller.startUpdateThread(10);
+  robot.startUpdateThread(10);
+
+  Pose pose;
+  RobotStatistics robotStatistics;
+  Timer timer;
+  timer.start();
+  bool received = false;
+  while (!received && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    usleep(10 * 1000);
+    while (controller.getRobotStatistics(&robotStatistics)) {
+      received = robotStatistics.types_size() > 0;
+    }
+  }
+  BOOST_REQUIRE(received);
+  BOOST_CHECK(robotStatistics.global().messages() > 0);
+  bool poses = false;
+  for (const TelemetryStatistics &type : robotStatistics.types()) {
+    if (type.type() == CURRENT_POSE) {
+      poses = type.messages() > 0 && type.name() == "robot_remote_control.Pose";
+    }
+  }
+  BOOST_CHECK(poses);
+
+  // switched off at runtime, the counters stay
+  robot.getStatistics().setEnabled(false);
+  double sent = robot.getStatistics().stat_per_type[CURRENT_POSE].getStats().messagesTotal;
+  robot.setCurrentPose(pose);
+  BOOST_CHECK_EQUAL(robot.getStatistics().stat_per_type[CURRENT_POSE].getStats().messagesTotal, sent);
+  robot.setStatisticsPublishInterval(0);
+  // received before the next test
+  usleep(100 * 1000);
+
+  robot.stopUpdateThread();
+  controller.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_metrics_exporter) {
+  Statistics sent;
+  sent.names[CURRENT_POSE] = "robot_remote_control.Pose";
+  for (int i = 0; i < 3; ++i) {
+    sent.global.addBytesSent(10);
+    sent.stat_per_type[CURRENT_POSE].addBytesSent(10);
+  }
+  ReceiveStatistics received;
+  received.names[CURRENT_POSE] = "robot_remote_control.Pose";
+  received.addReceived(CURRENT_POSE, 100, 2000);
+  received.addReceived(CURRENT_POSE, 100, 3000);
+  received.addRoundTrip(TWIST_COMMAND, 0.001);
+
+  MetricsExporter exporter;
+  exporter.addCollector([&sent](std::string *out) { sent.appendMetrics(out); });
+  exporter.addCollector([&received](std::string *out) { received.appendMetrics(out); });
+  std::string metrics = exporter.collect();
+  BOOST_CHECK(metrics.find("# TYPE rrc_sent_bytes_total counter\nrrc_sent_bytes_total 30\n") != std::string::npos);
+  BOOST_CHECK(metrics.find("rrc_sent_type_messages_total{type=\"" + std::to_string(CURRENT_POSE) + "\",name=\"robot_remote_control.Pose\"} 3\n")
+              != std::string::npos);
+  BOOST_CHECK(metrics.find("rrc_received_bytes_total{type=\"" + std::to_string(CURRENT_POSE) + "\",name=\"robot_remote_control.Pose\"} 200\n")
+              != std::string::npos);
+  BOOST_CHECK(metrics.find("rrc_received_age_microseconds_count{type=\"" + std::to_string(CURRENT_POSE) + "\",name=\"robot_remote_control.Pose\"} 2\n")
+              != std::string::npos);
+  BOOST_CHECK(metrics.find("rrc_received_round_trip_microseconds{type=\"" + std::to_string(TWIST_COMMAND) + "\",quantile=\"0.5\"}")
+              != std::string::npos);
+  BOOST_CHECK_EQUAL(MetricsExporter::label("name", "a\"b"), "name=\"a\\\"b\"");
+
+  std::string path = "/tmp/rrc_test_metrics.prom";
+  BOOST_CHECK(exporter.writeFile(path));
+  std::ifstream file(path);
+  std::stringstream content;
+  content << file.rdbuf();
+  BOOST_CHECK_EQUAL(content.str(), metrics);
+  remove(path.c_str());
+
+  BOOST_REQUIRE(exporter.startHttpServer(0, "127.0.0.1"));
+  BOOST_REQUIRE(exporter.getHttpPort() != 0);
+  auto get = [&exporter](const std::string &path) {
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(exporter.getHttpPort());
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    std::string response;
+    if (connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+      std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+      send(client, request.data(), request.size(), 0);
+      char buffer[1024];
+      ssize_t size;
+      while ((size = recv(client, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, size);
+      }
+    }
+    close(client);
+    return response;
+  };
+  std::string response = get("/metrics");
+  BOOST_CHECK_EQUAL(response.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+  BOOST_CHECK(response.find("\r\n\r\n" + metrics) != std::string::npos);
+  BOOST_CHECK_EQUAL(get("/other").compare(0, 12, "HTTP/1.1 404"), 0);
+  exporter.stopHttpServer();
+  BOOST_CHECK_EQUAL(exporter.getHttpPort(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(check_bandwidth_governor) {
+  BandwidthGovernor governor;
+  Statistics statistics;
+  governor.setPriority(CURRENT_POSE, 0);
+  governor.setPriority(JOINT_STATE, 1);
+  governor.setPriority(POINTCLOUD, 2, 0.5);
+  governor.setLinkBudget(30000);
+  // per second: 1 kB poses, 20 kB joints, 100 kB point clouds
+  std::map<uint16_t, float> limits;
+  BandwidthGovernor::Decision decision;
+  for (int second = 0; second < 5; ++second) {
+    for (int i = 0; i < 10; ++i) {
+      statistics.stat_per_type[CURRENT_POSE].addBytesSent(100);
+      statistics.stat_per_type[POINTCLOUD].addBytesSent(10000);
+    }
+    for (int i = 0; i < 100; ++i) {
+      statistics.stat_per_type[JOINT_STATE].addBytesSent(200);
+    }
+    decision = governor.update(statistics, 1);
+    for (const std::pair<uint16_t, float> &limit : decision.rateLimits) {
+      limits[limit.first] = limit.second;
+    }
+  }
+  BOOST_CHECK_CLOSE(decision.demandBytesPerSecond, 121000, 5);
+  BOOST_CHECK_LT(decision.quality, 0.3);
+  BOOST_CHECK(limits.find(CURRENT_POSE) == limits.end());
+  BOOST_CHECK(limits.find(JOINT_STATE) == limits.end());
+  // the rest of the budget, at least the minimum frequency
+  BOOST_CHECK_GE(limits[POINTCLOUD], 0.5);
+  BOOST_CHECK_LT(limits[POINTCLOUD], 1);
+
+  // enough budget removes the limits
+  governor.setLinkBudget(1000000);
+  decision = governor.update(statistics, 1);
+  BOOST_REQUIRE_EQUAL(decision.rateLimits.size(), 1);
+  BOOST_CHECK_EQUAL(decision.rateLimits[0].first, POINTCLOUD);
+  BOOST_CHECK_EQUAL(decision.rateLimits[0].second, 0);
+  BOOST_CHECK_EQUAL(decision.quality, 1);
+
+  // estimated: queueing sets the throughput as budget, it grows without queueing until it is dropped
+  governor.setLinkBudget(0);
+  BOOST_CHECK_EQUAL(governor.getLinkBudget(), 0);
+  governor.addLinkSample(0.01, 5000);
+  BOOST_CHECK_EQUAL(governor.getLinkBudget(), 0);
+  governor.addLinkSample(0.1, 5000);
+  BOOST_CHECK_EQUAL(governor.getLinkBudget(), 5000);
+  governor.addLinkSample(0.01, 5000);
+  BOOST_CHECK_CLOSE(governor.getLinkBudget(), 5500, 0.1);
+  for (int i = 0; i < 10; ++i) {
+    governor.addLinkSample(0.01, 5000);
+  }
+  BOOST_CHECK_EQUAL(governor.getLinkBudget(), 0);
+
+  initComms();
+  ControlledRobot robot(command, telemetri);
+  robot.getStatistics().setEnabled(true);
+  PointCloudEncoding encoding;
+  encoding.set_type(QUANTIZED_POINTCLOUD);
+  encoding.set_resolution(0.01);
+  robot.setPointCloudEncoding(encoding);
+  robot.getBandwidthGovernor().setLinkBudget(1000);
+  robot.getBandwidthGovernor().setPriority(POINTCLOUD, 1);
+  PointCloud pointcloud = TypeGenerator::genPointCloud(1000);
+  for (int i = 0; i < 5; ++i) {
+    robot.setPointCloud(pointcloud);
+  }
+  decision = robot.governBandwidth();
+  BOOST_CHECK_LT(decision.quality, 1);
+  BOOST_CHECK_GT(robot.rateLimits[POINTCLOUD].minInterval, 0);
+  BOOST_CHECK_EQUAL(robot.getCoarsening(), 4);
+  BOOST_CHECK_CLOSE(robot.getGovernedPointCloudEncoding().resolution(), 0.04, 0.1);
+  BOOST_CHECK_CLOSE(robot.getPointCloudEncoding().resolution(), 0.01, 0.1);
+
+  // stopping the governor removes its limits
+  robot.setBandwidthGovernorInterval(10);
+  robot.setBandwidthGovernorInterval(0);
+  BOOST_CHECK_EQUAL(robot.rateLimits[POINTCLOUD].minInterval, 0);
+}
+
+BOOST_AUTO_TEST_CASE(check_description_cache) {
+  std::shared_ptr<DescriptionCache> cache = std::make_shared<DescriptionCache>();
+  BOOST_CHECK(cache->isCached(ROBOT_NAME));
+  BOOST_CHECK(!cache->isCached(CURRENT_POSE));
+  BOOST_CHECK_EQUAL(DescriptionCache::pathFor("/tmp", "my robot/1"), "/tmp/my_robot_1.rrcdesc");
+
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  RobotName name;
+  name.set_value("cached robot");
+  robot.initRobotName(name);
+  SimpleActions actions;
+  actions.add_actions()->set_name("action");
+  robot.initSimpleActions(actions);
+  robot.startUpdateThread(10);
+  controller.setDescriptionCache(cache);
+
+  // nothing cached: all types are transferred
+  BOOST_CHECK_EQUAL(controller.refreshDescriptions(), DescriptionCache::defaultTypes().size());
+  BOOST_CHECK(cache->isValidated(ROBOT_NAME));
+  RobotName receivedName;
+  controller.requestRobotName(&receivedName);
+  BOOST_CHECK_EQUAL(receivedName.value(), "cached robot");
+
+  // persisted and loaded by another controller, not validated until refreshed
+  const std::string path = DescriptionCache::pathFor("/tmp", "cached robot");
+  BOOST_REQUIRE(cache->save(path));
+  std::shared_ptr<DescriptionCache> loaded = std::make_shared<DescriptionCache>();
+  BOOST_REQUIRE(loaded->load(path));
+  BOOST_CHECK(!loaded->isValidated(ROBOT_NAME));
+  std::string payload;
+  BOOST_CHECK(loaded->get(ROBOT_NAME, &payload, false));
+  BOOST_CHECK(payload == name.SerializeAsString());
+  unlink(path.c_str());
+
+  // a reconnect: one request validates everything, nothing changed
+  controller.connectionLost(0);
+  BOOST_CHECK(!cache->isValidated(ROBOT_NAME));
+  BOOST_CHECK_EQUAL(controller.refreshDescriptions(), 0);
+  BOOST_CHECK(cache->isValidated(SIMPLE_ACTIONS));
+
+  // only the changed description is transferred
+  actions.add_actions()->set_name("second action");
+  robot.initSimpleActions(actions);
+  controller.connectionLost(0);
+  BOOST_CHECK_EQUAL(controller.refreshDescriptions(), 1);
+  SimpleActions receivedActions;
+  controller.requestSimpleActions(&receivedActions);
+  COMPARE_PROTOBUF(actions, receivedActions);
+
+  // served from the cache, without a request
+  robot.stopUpdateThread();
+  controller.requestRobotName(&receivedName);
+  BOOST_CHECK_EQUAL(receivedName.value(), "cached robot");
+  controller.setDescriptionCache(nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(check_telemetry_snapshot) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  Pose pose = TypeGenerator::genPose();
+  robot.setCurrentPose(pose);
+  robot.setRobotState("snapshot");
+  robot.startUpdateThread(10);
+
+  // one round trip, IMU_VALUES was never set and is left out
+  Pose receivedPose;
+  RobotState receivedState;
+  IMU receivedImu;
+  receivedImu.mutable_acceleration()->set_x(42);
+  int received = controller.requestTelemetrySnapshot<CURRENT_POSE, ROBOT_STATE, IMU_VALUES>(&receivedPose, &receivedState, &receivedImu);
+  BOOST_CHECK_EQUAL(received, 2);
+  COMPARE_PROTOBUF(pose, receivedPose);
+  BOOST_REQUIRE_EQUAL(receivedState.state_size(), 1);
+  BOOST_CHECK_EQUAL(receivedState.state(0), "snapshot");
+  BOOST_CHECK_EQUAL(receivedImu.acceleration().x(), 42);
+
+  // the buffers are filled like by received telemetry
+  Pose bufferedPose;
+  BOOST_CHECK(controller.getCurrentPose(&bufferedPose));
+  COMPARE_PROTOBUF(pose, bufferedPose);
+
+  std::map<uint16_t, std::string> payloads;
+  BOOST_CHECK_EQUAL(controller.requestTelemetrySnapshot({ROBOT_STATE}, &payloads), 1);
+  BOOST_CHECK(payloads[ROBOT_STATE] == receivedState.SerializeAsString());
+  robot.stopUpdateThread();
+  // receive the sent telemetry, it would reach the controller of the next test otherwise
+  controller.update();
+}
+
+BOOST_AUTO_TEST_CASE(check_drain_telemetry) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  controller.setLazyTelemetry(ROBOT_STATE);
+  controller.startUpdateThread(0);
+
+  const unsigned int count = 5;
+  for (unsigned int i = 0; i < count; ++i) {
+    robot.setRobotState(std::to_string(i));
+  }
+  for (int i = 0; i < 100 && controller.getBufferSize(ROBOT_STATE) < count; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_REQUIRE_EQUAL(controller.getBufferSize(ROBOT_STATE), count);
+
+  std::vector<RobotState> snapshot;
+  BOOST_CHECK(controller.peekAllTelemetry<ROBOT_STATE>(&snapshot));
+  BOOST_CHECK_EQUAL(snapshot.size(), count);
+  BOOST_CHECK_EQUAL(controller.getBufferSize(ROBOT_STATE), count);
+
+  std::vector<RobotState> states;
+  BOOST_CHECK_EQUAL(controller.getAllTelemetry<ROBOT_STATE>(&states), count);
+  BOOST_REQUIRE_EQUAL(states.size(), count);
+  for (unsigned int i = 0; i < count; ++i) {
+    BOOST_CHECK_EQUAL(states[i].state(0), std::to_string(i));
+    COMPARE_PROTOBUF(states[i], snapshot[i]);
+  }
+  BOOST_CHECK_EQUAL(controller.getBufferSize(ROBOT_STATE), 0);
+  controller.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_wait_for_data) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  controller.startUpdateThread(0);
+  robot.startUpdateThread(0);
+
+  // nothing received: times out
+  Pose pose;
+  while (controller.getCurrentPose(&pose)) {}
+  BOOST_CHECK(!controller.waitForTelemetry(CURRENT_POSE, 20));
+  BOOST_CHECK(!robot.waitForCommand(CONTROL_MESSAGE_TYPE_NUMBER + 5, 0));
+
+  std::thread sender([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    robot.setCurrentPose(TypeGenerator::genPose());
+    controller.setTargetPose(TypeGenerator::genPose());
+  });
+  BOOST_CHECK(controller.waitForTelemetry(CURRENT_POSE, 5000));
+  BOOST_CHECK(controller.getCurrentPose(&pose));
+  BOOST_CHECK(robot.waitForCommand(TARGET_POSE_COMMAND, 5000));
+  BOOST_CHECK(robot.getTargetPoseCommand(&pose));
+  // read, so there is no new command anymore
+  BOOST_CHECK(!robot.waitForCommand(TARGET_POSE_COMMAND, 0));
+  sender.join();
+
+  controller.stopUpdateThread();
+  robot.stopUpdateThread();
+}
+
+Transform makeTransform(const std::string &from, const std::string &to, const double &x, const double &y, const double &yaw, const int &secs) {
+  Transform transform;
+  transform.set_from(from);
+  transform.set_to(to);
+  transform.mutable_transform()->mutable_position()->set_x(x);
+  transform.mutable_transform()->mutable_position()->set_y(y);
+  transform.mutable_transform()->mutable_orientation()->set_z(std::sin(yaw / 2));
+  transform.mutable_transform()->mutable_orientation()->set_w(std::cos(yaw / 2));
+  transform.mutable_timestamp()->set_secs(secs);
+  return transform;
+}
+
+BOOST_AUTO_TEST_CASE(check_transform_tree) {
+  TransformTree tree(10);
+  Transforms model;
+  *model.add_transform() = makeTransform("base", "arm", 1, 0, 0, 0);
+  tree.add(model, true);
+  tree.add(makeTransform("odom", "base", 0, 0, 0, 1));
+  tree.add(makeTransform("odom", "base", 0, 2, M_PI / 2, 3));
+  BOOST_CHECK_EQUAL(tree.size(), 2);
+
+  // chained and interpolated: the base is at y 1 turned by 45 degrees
+  Transform result;
+  TimeStamp time;
+  time.set_secs(2);
+  BOOST_REQUIRE(tree.lookup("odom", "arm", time, &result));
+  BOOST_CHECK_CLOSE(result.transform().position().x(), std::sqrt(0.5), 1e-6);
+  BOOST_CHECK_CLOSE(result.transform().position().y(), 1 + std::sqrt(0.5), 1e-6);
+  BOOST_CHECK_CLOSE(result.transform().orientation().z(), std::sin(M_PI / 8), 1e-6);
+
+  // the inverted chain cancels out
+  Transform inverted;
+  BOOST_REQUIRE(tree.lookup("arm", "odom", time, &inverted));
+  Pose identity = TransformTree::compose(result.transform(), inverted.transform());
+  BOOST_CHECK_SMALL(identity.position().x(), 1e-9);
+  BOOST_CHECK_SMALL(identity.position().y(), 1e-9);
+  BOOST_CHECK_CLOSE(std::fabs(identity.orientation().w()), 1, 1e-6);
+
+  // latest, outside of the history and not connected
+  BOOST_REQUIRE(tree.lookup("odom", "arm", &result));
+  BOOST_CHECK_CLOSE(result.transform().position().y(), 3, 1e-6);
+  BOOST_CHECK_EQUAL(result.timestamp().secs(), 3);
+  time.set_secs(4);
+  BOOST_CHECK(!tree.lookup("odom", "arm", time, &result));
+  BOOST_CHECK(!tree.lookup("odom", "unknown", &result));
+
+  // the robot only sends the changed transforms
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  std::shared_ptr<TransformTree> received = controller.enableTransformTree();
+  controller.startUpdateThread(0);
+  robot.setStaticTransforms(model);
+  Transforms dynamic;
+  *dynamic.add_transform() = makeTransform("odom", "base", 0, 0, 0, 1);
+  *dynamic.add_transform() = makeTransform("base", "wheel", 0, 1, 0, 1);
+  BOOST_CHECK(robot.setChangedTransforms(dynamic) > 0);
+  BOOST_CHECK_EQUAL(robot.setChangedTransforms(dynamic), 0);
+  *dynamic.mutable_transform(1) = makeTransform("base", "wheel", 0, 1, 0.1, 2);
+  BOOST_CHECK(robot.setChangedTransforms(dynamic) > 0);
+
+  for (int i = 0; i < 100 && received->size() < 3; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_CHECK_EQUAL(received->size(), 3);
+  std::vector<Transforms> messages;
+  for (int i = 0; i < 100 && messages.size() < 2; ++i) {
+    controller.getAllTelemetry<TRANSFORMS>(&messages);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  BOOST_REQUIRE_EQUAL(messages.size(), 2);
+  BOOST_CHECK_EQUAL(messages[1].transform_size(), 1);
+  BOOST_CHECK(received->lookup("odom", "wheel", &result));
+  controller.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_trajectory_update) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+
+  uint32_t changedStart = 0, changedCount = 0;
+  int trajectorySize = 0;
+  robot.addTrajectoryChangedCallback([&](const Poses &trajectory, const uint32_t &start, const uint32_t &count) {
+    changedStart = start;
+    changedCount = count;
+    trajectorySize = trajectory.poses_size();
+  });
+  robot.startUpdateThread(0);
+
+  Poses trajectory;
+  for (int i = 0; i < 5; ++i) {
+    *trajectory.add_poses() = TypeGenerator::genPose();
+  }
+  controller.setRobotTrajectoryCommand(trajectory);
+  Poses received;
+  BOOST_CHECK(robot.waitForCommand(ROBOT_TRAJECTORY_COMMAND, 1000));
+  BOOST_CHECK(robot.getRobotTrajectoryCommand(&received));
+  COMPARE_PROTOBUF(trajectory, received);
+  BOOST_CHECK_EQUAL(changedStart, 0);
+  BOOST_CHECK_EQUAL(changedCount, 5);
+
+  // append
+  std::vector<Pose> appended = {TypeGenerator::genPose(), TypeGenerator::genPose()};
+  BOOST_CHECK(controller.appendToRobotTrajectory(appended));
+  *trajectory.add_poses() = appended[0];
+  *trajectory.add_poses() = appended[1];
+  BOOST_CHECK(robot.getRobotTrajectoryCommand(&received));
+  COMPARE_PROTOBUF(trajectory, received);
+  BOOST_CHECK_EQUAL(changedStart, 5);
+  BOOST_CHECK_EQUAL(changedCount, 2);
+  BOOST_CHECK_EQUAL(trajectorySize, 7);
+
+  // replace a waypoint in the middle
+  TrajectoryUpdate update;
+  update.set_start_index(2);
+  *update.add_poses() = TypeGenerator::genPose();
+  BOOST_CHECK(controller.updateRobotTrajectory(update));
+  *trajectory.mutable_poses(2) = update.poses(0);
+  BOOST_CHECK(robot.getRobotTrajectoryCommand(&received));
+  COMPARE_PROTOBUF(trajectory, received);
+  BOOST_CHECK_EQUAL(changedStart, 2);
+  BOOST_CHECK_EQUAL(changedCount, 1);
+
+  // replan the tail
+  appended = {TypeGenerator::genPose()};
+  BOOST_CHECK(controller.replaceRobotTrajectoryTail(3, appended));
+  trajectory.mutable_poses()->DeleteSubrange(3, 4);
+  *trajectory.add_poses() = appended[0];
+  BOOST_CHECK(robot.getRobotTrajectoryCommand(&received));
+  COMPARE_PROTOBUF(trajectory, received);
+  BOOST_CHECK_EQUAL(trajectorySize, 4);
+
+  // a gap is rejected, the trajectory stays
+  update.set_start_index(10);
+  BOOST_CHECK(!controller.updateRobotTrajectory(update));
+  BOOST_CHECK(!robot.getRobotTrajectoryCommand(&received));
+  COMPARE_PROTOBUF(trajectory, received);
+
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_command_dispatch) {
+  initComms();
+  ControlledRobot robot(command, telemetri);
+  BOOST_CHECK_EQUAL(robot.commandbuffers.size(), CONTROL_MESSAGE_TYPE_NUMBER);
+  BOOST_CHECK(robot.getCommandBuffer(TWIST_COMMAND) == &robot.twistCommand);
+  BOOST_CHECK(robot.getCommandBuffer(CONTROL_MESSAGE_TYPE_NUMBER + 5) == nullptr);
+  BOOST_CHECK(!robot.addCommandReceivedCallback(CONTROL_MESSAGE_TYPE_NUMBER + 5, []() {}));
+
+  // unknown types are rejected without growing the table
+  robot.replyTransport = nullptr;
+  uint16_t unknown = CONTROL_MESSAGE_TYPE_NUMBER + 5;
+  BOOST_CHECK_EQUAL(robot.evaluateRequest(std::string(reinterpret_cast<const char*>(&unknown), sizeof(unknown))), unknown);
+  BOOST_CHECK_EQUAL(robot.commandbuffers.size(), CONTROL_MESSAGE_TYPE_NUMBER);
+
+  // an extended command type
+  ControlledRobot::CommandBuffer<Twist> extendedCommand;
+  BOOST_CHECK(!robot.registerCommandType(REQUEST_ID_FLAG | 1, &extendedCommand));
+  BOOST_CHECK(robot.registerCommandType(unknown, &extendedCommand));
+  BOOST_CHECK_EQUAL(robot.commandbuffers.size(), unknown + 1);
+  int callbacks = 0;
+  BOOST_CHECK(robot.addCommandReceivedCallback(unknown, [&callbacks]() { callbacks++; }));
+  Twist twist;
+  twist.mutable_angular()->set_z(1);
+  std::string request(reinterpret_cast<const char*>(&unknown), sizeof(unknown));
+  request += twist.SerializeAsString();
+  BOOST_CHECK_EQUAL(robot.evaluateRequest(request), unknown);
+  Twist received;
+  BOOST_CHECK(extendedCommand.read(&received));
+  COMPARE_PROTOBUF(twist, received);
+  BOOST_CHECK_EQUAL(callbacks, 1);
+}
+
+// member templates are not allowed in local classes
+struct TelemetryTypeCounter {
+  int types;
+  int buffered;
+  template <uint16_t TYPE> void visit() {
+    types++;
+    buffered += TelemetryTraits<TYPE>::buffered;
+  }
+};
+
+BOOST_AUTO_TEST_CASE(check_message_traits) {
+  static_assert(std::is_same<TelemetryTraits<CURRENT_POSE>::type, Pose>::value, "CURRENT_POSE is a Pose");
+  static_assert(std::is_same<TelemetryTraits<CONTROLLABLE_JOINTS>::type, JointState>::value, "CONTROLLABLE_JOINTS is a JointState");
+  static_assert(std::is_same<ControlTraits<TWIST_COMMAND>::type, Twist>::value, "TWIST_COMMAND is a Twist");
+  static_assert(static_cast<uint16_t>(TelemetryTraits<IMU_VALUES>::id) == static_cast<uint16_t>(IMU_VALUES), "id of the traits");
+  static_assert(!TelemetryTraits<MAP>::buffered, "maps are only requested");
+
+  TelemetryTypeCounter counter{0, 0};
+  TelemetryTypes::forEach(counter);
+  BOOST_CHECK_EQUAL(counter.types, TelemetryTypes::size);
+  BOOST_CHECK_EQUAL(counter.buffered, TelemetryTypes::size - 5);
+
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  // all buffered types are registered
+  BOOST_CHECK(controller.telemetryAdders[CURRENT_POSE]);
+  BOOST_CHECK(controller.telemetryAdders[ROBOT_STATISTICS]);
+  BOOST_CHECK(!controller.telemetryAdders[MAP]);
+  BOOST_CHECK_EQUAL(robot.statistics.names[MAP], Map::descriptor()->full_name());
+  robot.startUpdateThread(10);
+
+  Twist twist;
+  twist.mutable_linear()->set_x(2);
+  controller.sendCommand<TWIST_COMMAND>(twist);
+  Twist receivedTwist;
+  Timer timer;
+  timer.start();
+  while (!robot.getTwistCommand(&receivedTwist) && timer.getElapsedTime() < 5) {
+    usleep(1000);
+  }
+  COMPARE_PROTOBUF(twist, receivedTwist);
+
+  int callbacks = 0;
+  controller.addTelemetryReceivedCallback<CURRENT_POSE>([&callbacks](const Pose &pose) { callbacks++; });
+  Pose pose;
+  pose.mutable_position()->set_y(5);
+  std::unique_ptr<Pose> received;
+  timer.start();
+  while (!received && timer.getElapsedTime() < 5) {
+    robot.setTelemetry<CURRENT_POSE>(pose);
+    controller.update();
+    received = controller.getTelemetry<CURRENT_POSE>();
+    usleep(10 * 1000);
+  }
+  BOOST_REQUIRE(received);
+  COMPARE_PROTOBUF(pose, (*received));
+  BOOST_CHECK(callbacks > 0);
+  while (controller.getTelemetry<CURRENT_POSE>(&pose)) {}
+
+  Pose requested;
+  controller.requestTelemetry<CURRENT_POSE>(&requested);
+  BOOST_CHECK_EQUAL(requested.position().y(), 5);
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_tracing) {
+  struct CountingHook : public Tracing::Hook {
+    CountingHook() {
+      for (auto &count : counts) {
+        count.store(0);
+      }
+    }
+    void trace(const Tracing::Point &point, const uint16_t &type, const size_t &size) {
+      counts[point]++;
+      if (point == Tracing::TELEMETRY_PARSE_START && type == CURRENT_POSE) {
+        poseParsed++;
+      }
+    }
+    std::array<std::atomic<int>, Tracing::POINT_NUMBER> counts;
+    std::atomic<int> poseParsed{0};
+  };
+  // static, the trace points may still use it after it was replaced
+  static CountingHook hook;
+  BOOST_CHECK(!Tracing::enabled());
+  BOOST_CHECK_EQUAL(std::string(Tracing::name(Tracing::BUFFER_DROP)), "buffer_drop");
+
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+  Tracing::setHook(&hook);
+  BOOST_CHECK(Tracing::enabled());
+
+  controller.addTelemetryReceivedCallback<Pose>(CURRENT_POSE, [](const Pose &pose) {});
+  Pose pose;
+  pose.mutable_position()->set_x(1);
+  Pose received;
+  Timer timer;
+  timer.start();
+  while (hook.poseParsed.load() == 0 && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    controller.update();
+    usleep(10 * 1000);
+  }
+  controller.requestCurrentPose(&received);
+  COMPARE_PROTOBUF(pose, received);
+  Tracing::setHook(nullptr);
+  robot.stopUpdateThread();
+
+  BOOST_CHECK(hook.counts[Tracing::TELEMETRY_SERIALIZED].load() > 0);
+  BOOST_CHECK(hook.counts[Tracing::TELEMETRY_SENT].load() > 0);
+  BOOST_CHECK(hook.counts[Tracing::TELEMETRY_RECEIVED].load() > 0);
+  BOOST_CHECK_EQUAL(hook.counts[Tracing::TELEMETRY_PARSE_START].load(), hook.counts[Tracing::TELEMETRY_PARSE_END].load());
+  BOOST_CHECK(hook.counts[Tracing::CALLBACK_DISPATCH].load() > 0);
+  BOOST_CHECK(hook.counts[Tracing::REQUEST_WAIT_START].load() > 0);
+  BOOST_CHECK_EQUAL(hook.counts[Tracing::REQUEST_WAIT_START].load(), hook.counts[Tracing::REQUEST_WAIT_END].load());
+  BOOST_CHECK(hook.counts[Tracing::REQUEST_PARSE_START].load() > 0);
+  BOOST_CHECK_EQUAL(hook.counts[Tracing::REQUEST_PARSE_START].load(), hook.counts[Tracing::REQUEST_PARSE_END].load());
+
+  // the pose buffer is full after some messages
+  Tracing::setHook(&hook);
+  std::string message = pose.SerializeAsString();
+  uint16_t type = CURRENT_POSE;
+  message.insert(0, reinterpret_cast<const char*>(&type), sizeof(type));
+  for (int i = 0; i < 100; ++i) {
+    controller.evaluateTelemetry(message);
+  }
+  Tracing::setHook(nullptr);
+  BOOST_CHECK(hook.counts[Tracing::BUFFER_DROP].load() > 0);
+  while (controller.getCurrentPose(&received)) {}
+}
+
+BOOST_AUTO_TEST_CASE(check_telemetry_log) {
+  const std::string path = "/tmp/rrc_test_telemetry_log";
+  auto poseMessage = [](const int &i) {
+    Pose pose;
+    pose.mutable_position()->set_x(i);
+    uint16_t type = CURRENT_POSE;
+    return std::string(reinterpret_cast<const char*>(&type), sizeof(type)) + pose.SerializeAsString();
+  };
+
+  // small segments and index intervals to test the rotation and seeking
+  TelemetryRecorder recorder(1024, 4);
+  BOOST_REQUIRE(recorder.open(path));
+  const int64_t startNs = 1000 * 1000 * 1000;
+  const int64_t stepNs = 10 * 1000 * 1000;
+  for (int i = 0; i < 100; ++i) {
+    BOOST_CHECK(recorder.record(poseMessage(i), startNs + i * stepNs));
+  }
+  // larger than a segment
+  std::string large(4096, 'x');
+  BOOST_CHECK(recorder.record(large, startNs + 100 * stepNs));
+  BOOST_CHECK_EQUAL(recorder.getRecorded(), 101);
+  recorder.close();
+  BOOST_CHECK(!recorder.isOpen());
+
+  TelemetryReplay replay;
+  BOOST_REQUIRE(replay.open(path));
+  BOOST_CHECK(replay.segments.size() > 2);
+  MessageView message;
+  uint64_t sequence;
+  int64_t timeNs;
+  for (int i = 0; i < 100; ++i) {
+    BOOST_REQUIRE(replay.next(&message, &sequence, &timeNs));
+    BOOST_CHECK(message.toString() == poseMessage(i));
+    BOOST_CHECK_EQUAL(sequence, i);
+    BOOST_CHECK_EQUAL(timeNs, startNs + i * stepNs);
+  }
+  BOOST_REQUIRE(replay.next(&message));
+  BOOST_CHECK(message.toString() == large);
+  BOOST_CHECK(!replay.next(&message));
+
+  BOOST_CHECK(replay.seekSequence(42));
+  BOOST_REQUIRE(replay.next(&message, &sequence));
+  BOOST_CHECK_EQUAL(sequence, 42);
+  BOOST_CHECK(message.toString() == poseMessage(42));
+  BOOST_CHECK(replay.seekTime(startNs + 57 * stepNs - 1));
+  BOOST_REQUIRE(replay.next(&message, &sequence));
+  BOOST_CHECK_EQUAL(sequence, 57);
+  BOOST_CHECK(!replay.seekSequence(1000));
+  BOOST_CHECK(!replay.next(&message));
+
+  // 10 messages of 10ms, 10 times faster
+  replay.rewind();
+  Timer timer;
+  timer.start();
+  int replayed = 0;
+  BOOST_CHECK_EQUAL(replay.replay([&](const MessageView &view) { replayed++; }, 10, 11), 11);
+  BOOST_CHECK_EQUAL(replayed, 11);
+  BOOST_CHECK(timer.getElapsedTime() >= 0.009);
+  BOOST_CHECK(timer.getElapsedTime() < 0.5);
+
+  // into a controller, as fast as possible
+  initComms();
+  RobotController controller(commands, telemetry);
+  BOOST_CHECK(replay.seekSequence(90));
+  BOOST_CHECK_EQUAL(replay.replay(&controller, 0, 5), 5);
+  Pose received;
+  int poses = 0;
+  while (controller.getCurrentPose(&received)) {
+    poses++;
+  }
+  BOOST_CHECK(poses > 0);
+  BOOST_CHECK_EQUAL(received.position().x(), 94);
+  replay.close();
+
+  // record the received telemetry of a controller
+  std::shared_ptr<TelemetryRecorder> controllerRecorder = std::make_shared<TelemetryRecorder>();
+  BOOST_REQUIRE(controllerRecorder->open(path));
+  controller.setTelemetryRecorder(controllerRecorder);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+  Pose pose;
+  pose.mutable_position()->set_x(7);
+  timer.start();
+  while (!controller.getCurrentPose(&received) && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    controller.update();
+    usleep(10 * 1000);
+  }
+  controller.setTelemetryRecorder(nullptr);
+  robot.stopUpdateThread();
+  controllerRecorder->close();
+  BOOST_CHECK(controllerRecorder->getRecorded() > 0);
+  // other telemetry of the shared transports may be recorded as well
+  BOOST_REQUIRE(replay.open(path));
+  bool recordedPose = false;
+  while (!recordedPose && replay.next(&message, nullptr, &timeNs)) {
+    recordedPose = controller.injectTelemetry(message) == CURRENT_POSE;
+  }
+  BOOST_CHECK(recordedPose);
+  BOOST_CHECK(controller.getCurrentPose(&received));
+  BOOST_CHECK_EQUAL(received.position().x(), 7);
+  BOOST_CHECK(std::abs(timeNs - ClockOffsetEstimator::nowNs()) < 60LL * 1000 * 1000 * 1000);
+  replay.close();
+  for (uint32_t segment = 0; unlink(TelemetryLogFormat::segmentPath(path, segment).c_str()) == 0; ++segment) {}
+  unlink(TelemetryLogFormat::indexPath(path).c_str());
+}
+
+BOOST_AUTO_TEST_CASE(check_versioned_header) {
+  WireHeader header;
+  header.type = CURRENT_POSE;
+  header.flags = WireHeader::HAS_REQUEST_ID;
+  header.sequence = 42;
+  header.sendTimeNs = WireHeader::now();
+  header.requestId = 7;
+  char buffer[WireHeader::maxSize + 4] = {0};
+  BOOST_CHECK_EQUAL(header.write(buffer), WireHeader::maxSize);
+  WireHeader read;
+  BOOST_CHECK_EQUAL(WireHeader::read(buffer, sizeof(buffer), &read), WireHeader::maxSize);
+  BOOST_CHECK_EQUAL(read.type, CURRENT_POSE);
+  BOOST_CHECK_EQUAL(read.version, WireHeader::currentVersion);
+  BOOST_CHECK_EQUAL(read.sequence, 42);
+  BOOST_CHECK_EQUAL(read.sendTimeNs, header.sendTimeNs);
+  BOOST_CHECK_EQUAL(read.requestId, 7);
+  // truncated
+  BOOST_CHECK_EQUAL(WireHeader::read(buffer, WireHeader::baseSize, &read), 0);
+  // the plain type header
+  const uint16_t plain = CURRENT_POSE;
+  BOOST_CHECK_EQUAL(WireHeader::read(reinterpret_cast<const char*>(&plain), sizeof(uint16_t), &read), sizeof(uint16_t));
+  BOOST_CHECK_EQUAL(read.type, CURRENT_POSE);
+  BOOST_CHECK_EQUAL(read.version, 0);
+
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+  BOOST_CHECK(controller.setVersionedHeader());
+  BOOST_CHECK_EQUAL(controller.getWireHeaderVersion(), WireHeader::currentVersion);
+  controller.startUpdateThread(10);
+
+  Pose pose;
+  pose.mutable_position()->set_x(3);
+  Pose received;
+  Timer timer;
+  timer.start();
+  while (!controller.getCurrentPose(&received) && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    usleep(10 * 1000);
+  }
+  COMPARE_PROTOBUF(pose, received);
+  for (int i = 0; i < 5; ++i) {
+    robot.setCurrentPose(pose);
+  }
+  usleep(100 * 1000);
+  while (controller.getCurrentPose(&received)) {}
+  RobotController::SequenceCounters counters = controller.getSequenceCounters(CURRENT_POSE);
+  BOOST_CHECK(counters.received >= 6);
+  BOOST_CHECK_EQUAL(counters.gaps, 0);
+  BOOST_CHECK_EQUAL(counters.reordered, 0);
+  controller.stopUpdateThread();
+
+  // gaps and reorders, evaluated directly
+  std::string message = pose.SerializeAsString();
+  auto sendSequence = [&](const uint32_t &sequence) {
+    WireHeader poseHeader;
+    poseHeader.type = CURRENT_POSE;
+    poseHeader.sequence = sequence;
+    char headerBuffer[WireHeader::maxSize];
+    size_t size = poseHeader.write(headerBuffer);
+    controller.evaluateTelemetry(std::string(headerBuffer, size) + message);
+  };
+  uint64_t receivedBefore = counters.received;
+  const uint32_t next = controller.telemetrySequences[CURRENT_POSE].expected;
+  // next + 1 and next + 2 are missing, next + 2 arrives late
+  sendSequence(next);
+  sendSequence(next + 3);
+  sendSequence(next + 2);
+  counters = controller.getSequenceCounters(CURRENT_POSE);
+  BOOST_CHECK_EQUAL(counters.received, receivedBefore + 3);
+  BOOST_CHECK_EQUAL(counters.gaps, 1);
+  BOOST_CHECK_EQUAL(counters.reordered, 1);
+  BOOST_CHECK_EQUAL(controller.getSequenceCounters().gaps, 1);
+
+  // a late message of a latest-value type is dropped (e.g. sent with TransportUDT::addLatestValueType())
+  while (controller.getCurrentPose(&received)) {}
+  BOOST_CHECK(controller.setLatestValueTelemetry(CURRENT_POSE));
+  pose.mutable_position()->set_x(5);
+  message = pose.SerializeAsString();
+  sendSequence(next + 5);
+  Pose late = pose;
+  late.mutable_position()->set_x(4);
+  message = late.SerializeAsString();
+  sendSequence(next + 4);
+  BOOST_CHECK(controller.getCurrentPose(&received));
+  COMPARE_PROTOBUF(pose, received);
+  BOOST_CHECK_EQUAL(controller.getSequenceCounters(CURRENT_POSE).dropped, 1);
+
+  BOOST_CHECK(controller.setVersionedHeader(false));
+  BOOST_CHECK_EQUAL(controller.getWireHeaderVersion(), 0);
+  robot.stopUpdateThread();
+  while (controller.getCurrentPose(&received)) {}
+}
+
+#ifdef TRANSPORT_DEFAULT
+BOOST_AUTO_TEST_CASE(check_control_lane) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  TransportSharedPtr controlLane = TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7005", TransportZmq::REQ));
+  TransportSharedPtr robotControlLane = TransportSharedPtr(new TransportZmq("tcp://*:7005", TransportZmq::REP));
+  controller.setControlTransport(controlLane);
+  robot.setControlTransport(robotControlLane);
+  robot.startUpdateThread(10);
+
+  Twist twist;
+  twist.mutable_linear()->set_x(0.5);
+  controller.setTwistCommand(twist);
+  Twist received;
+  BOOST_CHECK(robot.getTwistCommand(&received));
+  COMPARE_PROTOBUF(twist, received);
+
+  // other requests still use the command transport
+  RobotName name;
+  name.set_value("control lane");
+  robot.initRobotName(name);
+  RobotName requested;
+  controller.requestRobotName(&requested);
+  COMPARE_PROTOBUF(name, requested);
+
+  robot.stopUpdateThread();
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(check_controller_hub) {
+  initComms();
+  std::shared_ptr<RobotController> controller = std::make_shared<RobotController>(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+
+  RobotControllerHub hub(2);
+  BOOST_CHECK(hub.addRobot("robot", controller));
+  BOOST_CHECK(!hub.addRobot("robot", controller));
+  BOOST_CHECK_EQUAL(hub.size(), 1);
+  BOOST_CHECK(hub.getRobot("robot") == controller);
+  hub.start(10);
+
+  // the controller API is used as usual, only update() is called by the hub
+  Pose pose;
+  pose.mutable_position()->set_x(2);
+  Pose received;
+  Timer timer;
+  timer.start();
+  while (!controller->getCurrentPose(&received) && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    usleep(10 * 1000);
+  }
+  COMPARE_PROTOBUF(pose, received);
+
+  RobotName name;
+  name.set_value("hub test");
+  robot.initRobotName(name);
+  RobotName requested;
+  controller->requestRobotName(&requested);
+  COMPARE_PROTOBUF(name, requested);
+
+  hub.stop();
+  BOOST_CHECK(hub.removeRobot("robot"));
+  BOOST_CHECK(!hub.getRobot("robot"));
+  robot.stopUpdateThread();
+}
+
+/**
+ * @brief replays prepared requests and drops the replies, without allocating memory
+ */
+class ReplayTransport : public Transport {
+ public:
+  ReplayTransport():next(0), pending(0), replies(0) {}
+
+  int send(const std::string& buf, Flags flags = NONE) {
+    replies++;
+    return buf.size();
+  }
+
+  int receive(std::string* buf, Flags flags = NONE) {
+    if (!pending || requests.empty()) {
+      return 0;
+    }
+    pending--;
+    // keeps the capacity of buf
+    buf->assign(requests[next]);
+    next = (next + 1) % requests.size();
+    return buf->size();
+  }
+
+  void addRequest(uint16_t type, const google::protobuf::MessageLite &message, bool withRequestId = false) {
+    std::string request(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+    if (withRequestId) {
+      type |= REQUEST_ID_FLAG;
+      request.assign(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+      uint32_t id = requests.size();
+      request.append(reinterpret_cast<const char*>(&id), sizeof(uint32_t));
+    }
+    request.append(message.SerializeAsString());
+    requests.push_back(request);
+  }
+
+  std::vector<std::string> requests;
+  size_t next;
+  int pending;
+  int replies;
+};
+
+BOOST_AUTO_TEST_CASE(check_update_without_allocation) {
+  std::shared_ptr<ReplayTransport> requests = std::make_shared<ReplayTransport>();
+  Twist twist;
+  twist.mutable_linear()->set_x(0.5);
+  twist.mutable_angular()->set_z(0.1);
+  requests->addRequest(TWIST_COMMAND, twist);
+  JointCommand joints;
+  for (int i = 0; i < 6; ++i) {
+    joints.add_name("a_joint_name_longer_than_the_small_string_buffer_" + std::to_string(i));
+    joints.add_position(i);
+  }
+  joints.mutable_timestamp()->set_secs(1);
+  requests->addRequest(JOINTS_COMMAND, joints, true);
+  HeartBeat heartbeat;
+  heartbeat.set_heartbeatduration(1);
+  requests->addRequest(HEARTBEAT, heartbeat);
+
+  ControlledRobot robot(requests, TransportSharedPtr(new ReplayTransport()));
+  robot.preallocateBuffers(1024);
+
+  // warm-up: each request once per slot of the command buffers
+  requests->pending = requests->requests.size() * 3;
+  robot.update();
+
+  countAllocations = true;
+  requests->pending = requests->requests.size() * 100;
+  robot.update();
+  countAllocations = false;
+
+  BOOST_CHECK_EQUAL(allocations.load(), 0);
+  BOOST_CHECK_EQUAL(requests->replies, requests->requests.size() * 103);
+  Twist receivedTwist;
+  BOOST_CHECK(robot.getTwistCommand(&receivedTwist));
+  COMPARE_PROTOBUF(twist, receivedTwist);
+  JointCommand receivedJoints;
+  BOOST_CHECK(robot.getJointsCommand(&receivedJoints));
+  COMPARE_PROTOBUF(joints, receivedJoints);
+}
+
+BOOST_AUTO_TEST_CASE(check_streamed_commands_order) {
+  std::shared_ptr<ReplayTransport> stream = std::make_shared<ReplayTransport>();
+  auto addStreamed = [&stream](uint32_t streamId, uint32_t sequence, double x) {
+    Twist twist;
+    twist.mutable_linear()->set_x(x);
+    uint16_t type = TWIST_COMMAND;
+    std::string message(reinterpret_cast<const char*>(&streamId), sizeof(uint32_t));
+    message.append(reinterpret_cast<const char*>(&sequence), sizeof(uint32_t));
+    message.append(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+    message.append(twist.SerializeAsString());
+    stream->requests.push_back(message);
+  };
+  addStreamed(7, 1, 1);
+  addStreamed(7, 3, 3);
+  // out of order and duplicated
+  addStreamed(7, 2, 2);
+  addStreamed(7, 3, 3);
+  // a restarted or second controller streams with its own id
+  addStreamed(8, 1, 4);
+  addStreamed(7, 4, 5);
+
+  std::shared_ptr<ReplayTransport> requests = std::make_shared<ReplayTransport>();
+  ControlledRobot robot(requests, TransportSharedPtr(new ReplayTransport()));
+  robot.setCommandStreamTransport(stream);
+  stream->pending = 2;
+  robot.update();
+  Twist received;
+  BOOST_CHECK(robot.getTwistCommand(&received));
+  BOOST_CHECK_EQUAL(received.linear().x(), 3);
+
+  stream->pending = 2;
+  robot.update();
+  BOOST_CHECK(!robot.getTwistCommand(&received));
+  BOOST_CHECK_EQUAL(received.linear().x(), 3);
+  BOOST_CHECK_EQUAL(robot.getDroppedStreamedCommands(), 2);
+
+  // the sequences of the controllers are independent
+  stream->pending = 1;
+  robot.update();
+  BOOST_CHECK(robot.getTwistCommand(&received));
+  BOOST_CHECK_EQUAL(received.linear().x(), 4);
+  stream->pending = 1;
+  robot.update();
+  BOOST_CHECK(robot.getTwistCommand(&received));
+  BOOST_CHECK_EQUAL(received.linear().x(), 5);
+  BOOST_CHECK_EQUAL(robot.getDroppedStreamedCommands(), 2);
+
+  // nothing is acknowledged
+  BOOST_CHECK_EQUAL(stream->replies, 0);
+  BOOST_CHECK_EQUAL(requests->replies, 0);
+}
+
+#ifdef TRANSPORT_DEFAULT
+BOOST_AUTO_TEST_CASE(check_command_stream) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  controller.setCommandStreamTransport(TransportSharedPtr(new TransportZmq("tcp://127.0.0.1:7006", TransportZmq::PUSH)));
+  robot.setCommandStreamTransport(TransportSharedPtr(new TransportZmq("tcp://*:7006", TransportZmq::PULL)));
+  robot.startUpdateThread(1);
+
+  Twist twist;
+  Twist received;
+  Timer timer;
+  timer.start();
+  // nothing is queued before the connection, so send until the robot got one
+  for (int i = 1; !robot.getTwistCommand(&received) && timer.getElapsedTime() < 5; ++i) {
+    twist.mutable_linear()->set_x(i);
+    controller.setTwistCommand(twist);
+    usleep(10 * 1000);
+  }
+  BOOST_CHECK_GT(received.linear().x(), 0);
+
+  // the latest command wins
+  for (int i = 0; i < 100; ++i) {
+    twist.mutable_linear()->set_x(1000 + i);
+    controller.setTwistCommand(twist);
+  }
+  timer.start();
+  while (received.linear().x() != 1099 && timer.getElapsedTime() < 5) {
+    robot.getTwistCommand(&received);
+    usleep(1000);
+  }
+  BOOST_CHECK_EQUAL(received.linear().x(), 1099);
+  BOOST_CHECK_EQUAL(robot.getDroppedStreamedCommands(), 0);
+
+  // other requests still get their replies
+  RobotName name;
+  name.set_value("streaming");
+  robot.initRobotName(name);
+  RobotName requested;
+  controller.requestRobotName(&requested);
+  COMPARE_PROTOBUF(name, requested);
+
+  robot.stopUpdateThread();
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(check_heartbeat_piggybacking) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  std::atomic<int> heartbeats(0);
+  robot.addCommandReceivedCallback(HEARTBEAT, [&heartbeats]() { heartbeats++; });
+  robot.startUpdateThread(1);
+
+  controller.setHeartBeatDuration(0.2);
+  usleep(250 * 1000);
+  // the first heartbeat tells the robot the duration
+  controller.update();
+  BOOST_CHECK_EQUAL(heartbeats.load(), 1);
+
+  // commands keep the link busy, no explicit heartbeats
+  Twist twist;
+  for (int i = 0; i < 20; ++i) {
+    controller.setTwistCommand(twist);
+    controller.update();
+    usleep(50 * 1000);
+  }
+  BOOST_CHECK_EQUAL(heartbeats.load(), 1);
+  BOOST_CHECK(robot.isConnected());
+  BOOST_CHECK(controller.isConnected());
+  BOOST_CHECK_GT(controller.getHeartBreatRoundTripTime(), 0);
+
+  // idle link
+  usleep(250 * 1000);
+  controller.update();
+  BOOST_CHECK_EQUAL(heartbeats.load(), 2);
+
+  robot.stopUpdateThread();
+}
+
+/**
+ * @brief requests of several peers on one transport, like a ROUTER socket
+ */
+class PeerTransport : public Transport {
+ public:
+  int send(const std::string& buf, Flags flags = NONE) {
+    replies.push_back(std::make_pair(peer, buf));
+    return buf.size();
+  }
+
+  int receive(std::string* buf, Flags flags = NONE) {
+    if (requests.empty()) {
+      return 0;
+    }
+    peer = requests.front().first;
+    buf->assign(requests.front().second);
+    requests.pop_front();
+    return buf->size();
+  }
+
+  std::string getPeer() {
+    return peer;
+  }
+
+  bool setPeer(const std::string &selected) {
+    peer = selected;
+    return true;
+  }
+
+  void releasePeer(const std::string &gone) {
+    released.push_back(gone);
+  }
+
+  void addRequest(const std::string &from, uint16_t type, const google::protobuf::MessageLite &message) {
+    requests.push_back(std::make_pair(from, std::string(reinterpret_cast<const char*>(&type), sizeof(uint16_t)) + message.SerializeAsString()));
+  }
+
+  uint16_t replyType(const size_t &index) {
+    return *reinterpret_cast<const uint16_t*>(replies[index].second.data());
+  }
+
+  std::string peer;
+  std::deque< std::pair<std::string, std::string> > requests;
+  std::vector< std::pair<std::string, std::string> > replies;
+  std::vector<std::string> released;
+};
+
+BOOST_AUTO_TEST_CASE(check_multi_client) {
+  std::shared_ptr<PeerTransport> peers = std::make_shared<PeerTransport>();
+  initComms();
+  ControlledRobot robot(peers, telemetri);
+  robot.setMultiClient(true, 0.2);
+  robot.setClientPriority("supervisor", 1);
+  std::vector<std::string> connected, lost;
+  robot.addClientSessionCallback([&](const std::string &peer, const bool &isConnected) {
+    (isConnected ? connected : lost).push_back(peer);
+  });
+
+  // the first commanding station keeps the robot, others may still request data
+  Twist twist;
+  twist.mutable_linear()->set_x(1);
+  peers->addRequest("station1", TWIST_COMMAND, twist);
+  peers->addRequest("station2", TWIST_COMMAND, twist);
+  peers->addRequest("station2", HEARTBEAT, HeartBeat());
+  robot.update();
+  BOOST_REQUIRE_EQUAL(peers->replies.size(), 3);
+  BOOST_CHECK_EQUAL(peers->replies[0].first, "station1");
+  BOOST_CHECK_EQUAL(peers->replyType(0), TWIST_COMMAND);
+  BOOST_CHECK_EQUAL(peers->replies[1].first, "station2");
+  BOOST_CHECK_EQUAL(peers->replyType(1), NO_CONTROL_DATA);
+  BOOST_CHECK_EQUAL(peers->replyType(2), HEARTBEAT);
+  BOOST_CHECK_EQUAL(connected.size(), 2);
+  BOOST_CHECK_EQUAL(robot.getClientSessions().size(), 2);
+
+  // a higher priority takes over
+  peers->addRequest("supervisor", TWIST_COMMAND, twist);
+  peers->addRequest("station1", TWIST_COMMAND, twist);
+  robot.update();
+  BOOST_CHECK_EQUAL(peers->replyType(3), TWIST_COMMAND);
+  BOOST_CHECK_EQUAL(peers->replyType(4), NO_CONTROL_DATA);
+  BOOST_CHECK_EQUAL(robot.clientSessions.getCommander(), "supervisor");
+
+  // map requests are answered later, to their peer
+  robot.setMap(std::string(1000, 'm'), 1);
+  uint16_t mapRequest[2] = {MAP_REQUEST, 1};
+  peers->requests.push_back(std::make_pair("station2", std::string(reinterpret_cast<const char*>(mapRequest), sizeof(mapRequest))));
+  peers->addRequest("station1", HEARTBEAT, HeartBeat());
+  robot.update();
+  BOOST_CHECK(robot.deferredRequests->waitUntilIdle(1));
+  robot.update();
+  BOOST_REQUIRE_EQUAL(peers->replies.size(), 7);
+  BOOST_CHECK_EQUAL(peers->replies[5].first, "station1");
+  BOOST_CHECK_EQUAL(peers->replies[6].first, "station2");
+  BOOST_CHECK_EQUAL(peers->replies[6].second, std::string(1000, 'm'));
+
+  // the sessions expire, so does commanding
+  usleep(300 * 1000);
+  robot.update();
+  BOOST_CHECK_EQUAL(lost.size(), 3);
+  BOOST_CHECK_EQUAL(peers->released.size(), 3);
+  BOOST_CHECK(robot.clientSessions.getCommander().empty());
+  peers->addRequest("station1", TWIST_COMMAND, twist);
+  robot.update();
+  BOOST_CHECK_EQUAL(peers->replyType(7), TWIST_COMMAND);
+}
+
+BOOST_AUTO_TEST_CASE(check_multi_client_features) {
+  std::shared_ptr<PeerTransport> peers = std::make_shared<PeerTransport>();
+  TransportSharedPtr controllerTelemetry, robotTelemetry;
+  std::tie(controllerTelemetry, robotTelemetry) = TransportLoopback::createPair();
+  ControlledRobot robot(peers, robotTelemetry);
+  robot.setMultiClient(true, 0.2);
+  auto addVersionRequest = [&](const std::string &from, uint8_t version) {
+    const uint16_t type = WIRE_HEADER_VERSION;
+    peers->requests.push_back(std::make_pair(from, std::string(reinterpret_cast<const char*>(&type), sizeof(uint16_t)) +
+                                                   std::string(reinterpret_cast<const char*>(&version), sizeof(uint8_t))));
+  };
+
+  addVersionRequest("station1", 1);
+  robot.update();
+  BOOST_CHECK_EQUAL(robot.wireHeaderVersion.load(), 1);
+
+  // an older controller reads the plain header
+  peers->addRequest("station2", HEARTBEAT, HeartBeat());
+  robot.update();
+  BOOST_CHECK_EQUAL(robot.wireHeaderVersion.load(), 0);
+  addVersionRequest("station2", 1);
+  robot.update();
+  BOOST_CHECK_EQUAL(robot.wireHeaderVersion.load(), 1);
+
+  // switching back only affects the own session
+  addVersionRequest("station2", 0);
+  robot.update();
+  BOOST_CHECK_EQUAL(robot.wireHeaderVersion.load(), 0);
+  BOOST_CHECK_EQUAL(robot.clientSessions.getFeatures("station1").wireHeaderVersion, 1);
+
+  // the session of station2 expires (the heartbeat set its timeout to 0.1 s)
+  usleep(150 * 1000);
+  addVersionRequest("station1", 1);
+  robot.update();
+  BOOST_CHECK_EQUAL(robot.getClientSessions().size(), 1);
+  BOOST_CHECK_EQUAL(robot.wireHeaderVersion.load(), 1);
+
+  // the stream uses the features both controllers negotiated
+  Capabilities offer;
+  offer.set_protocol_version(1);
+  offer.set_wire_header_version(1);
+  offer.set_telemetry_chunks(true);
+  offer.set_log_messages(true);
+  offer.add_fixed_layout_types(CURRENT_POSE);
+  offer.add_fixed_layout_types(IMU_VALUES);
+  PointCloudEncoding* encoding = offer.add_pointcloud_encodings();
+  encoding->set_type(QUANTIZED_POINTCLOUD);
+  encoding->set_resolution(0.01);
+  peers->addRequest("station1", CAPABILITIES, offer);
+  robot.update();
+  BOOST_CHECK(robot.controllerReassemblesChunks.load());
+  BOOST_CHECK(robot.controllerSplitsLogs.load());
+  BOOST_CHECK_EQUAL(robot.getPointCloudEncoding().type(), QUANTIZED_POINTCLOUD);
+  offer.set_telemetry_chunks(false);
+  offer.set_log_messages(false);
+  offer.clear_fixed_layout_types();
+  offer.add_fixed_layout_types(CURRENT_POSE);
+  encoding->set_resolution(0.05);
+  peers->addRequest("station2", CAPABILITIES, offer);
+  robot.update();
+  BOOST_CHECK(!robot.controllerReassemblesChunks.load());
+  BOOST_CHECK(!robot.controllerSplitsLogs.load());
+  BOOST_CHECK_EQUAL(robot.getPointCloudEncoding().type(), UNENCODED_POINTCLOUD);
+  BOOST_CHECK_EQUAL(robot.wireHeaderVersion.load(), 1);
+  BOOST_CHECK(robot.clientSessions.getFeatures("station1").telemetryChunks);
+  BOOST_CHECK_EQUAL(robot.fixedLayoutTypes[CURRENT_POSE].load(), FixedLayout::available);
+  BOOST_CHECK(!robot.fixedLayoutTypes[IMU_VALUES].load());
+}
+
+BOOST_AUTO_TEST_CASE(check_telemetry_relay) {
+  initComms();
+  ControlledRobot robot(command, telemetri);
+  RobotName name;
+  name.set_value("relayed robot");
+  robot.initRobotName(name);
+  robot.startUpdateThread(10);
+
+  // the relay is the only controller of the robot, the stations connect to the relay
+  std::shared_ptr<PeerTransport> stations = std::make_shared<PeerTransport>();
+  std::shared_ptr<PeerTransport> fullTelemetry = std::make_shared<PeerTransport>();
+  std::shared_ptr<PeerTransport> reducedTelemetry = std::make_shared<PeerTransport>();
+  TelemetryRelay relay(commands, telemetry, stations);
+  relay.addDownstream(fullTelemetry);
+  TelemetryRelay::DownstreamOptions reduced;
+  reduced.decimation[CURRENT_POSE] = 2;
+  reduced.types.push_back(CURRENT_POSE);
+  relay.addDownstream(reducedTelemetry, reduced);
+
+  // the description is requested once
+  relay.update();
+  std::string cachedName;
+  BOOST_REQUIRE(relay.getLatest(ROBOT_NAME, &cachedName));
+  BOOST_CHECK_EQUAL(cachedName, name.SerializeAsString());
+
+  auto countPoses = [](const std::shared_ptr<PeerTransport> &transport) {
+    size_t poses = 0;
+    for (const auto &message : transport->replies) {
+      poses += (*reinterpret_cast<const uint16_t*>(message.second.data()) & ~WIRE_HEADER_FLAG) == CURRENT_POSE;
+    }
+    return poses;
+  };
+  Pose pose;
+  for (int i = 0; i < 4; ++i) {
+    pose.mutable_position()->set_x(i);
+    robot.setCurrentPose(pose);
+  }
+  Timer timer;
+  timer.start();
+  while (countPoses(fullTelemetry) < 4 && timer.getElapsedTime() < 5) {
+    relay.update();
+    usleep(1000);
+  }
+  BOOST_CHECK_EQUAL(countPoses(fullTelemetry), 4);
+  BOOST_CHECK_EQUAL(countPoses(reducedTelemetry), 2);
+  BOOST_CHECK_EQUAL(reducedTelemetry->replies.size(), 2);
+
+  // the latest telemetry is answered by the relay, commands reach the robot
+  uint16_t poseRequest[2] = {TELEMETRY_REQUEST, CURRENT_POSE};
+  stations->requests.push_back(std::make_pair("station1", std::string(reinterpret_cast<const char*>(poseRequest), sizeof(poseRequest))));
+  uint16_t nameRequest[2] = {TELEMETRY_REQUEST, ROBOT_NAME};
+  stations->requests.push_back(std::make_pair("station2", std::string(reinterpret_cast<const char*>(nameRequest), sizeof(nameRequest))));
+  Twist twist;
+  twist.mutable_linear()->set_x(1);
+  stations->addRequest("station1", TWIST_COMMAND, twist);
+  const uint64_t forwardedBefore = relay.getStatistics().requestsForwarded;
+  relay.update();
+  BOOST_REQUIRE_EQUAL(stations->replies.size(), 3);
+  Pose received;
+  received.ParseFromString(stations->replies[0].second);
+  COMPARE_PROTOBUF(pose, received);
+  BOOST_CHECK_EQUAL(stations->replies[1].first, "station2");
+  BOOST_CHECK_EQUAL(stations->replies[1].second, name.SerializeAsString());
+  BOOST_CHECK_EQUAL(stations->replyType(2), TWIST_COMMAND);
+  BOOST_CHECK_EQUAL(relay.getStatistics().answeredLocally, 2);
+  BOOST_CHECK_EQUAL(relay.getStatistics().requestsForwarded, forwardedBefore + 1);
+
+  Twist twistCommand;
+  BOOST_CHECK(robot.getTwistCommand(&twistCommand));
+  COMPARE_PROTOBUF(twist, twistCommand);
+
+  robot.stopUpdateThread();
+  // drain the telemetry for the following tests
+  relay.update();
+}
+
+BOOST_AUTO_TEST_CASE(check_image_frames) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+  controller.startUpdateThread(10);
+
+  // every second frame of camera 1, camera 2 is stopped
+  ImageStreamConfigs configs;
+  ImageStreamConfig *config = configs.add_streams();
+  config->set_camera_id(1);
+  config->set_decimation(2);
+  config->set_max_width(320);
+  config = configs.add_streams();
+  config->set_camera_id(2);
+  config->set_disabled(true);
+  BOOST_CHECK(controller.setImageStreamConfigs(configs));
+  ImageStreamConfig robotConfig;
+  BOOST_REQUIRE(robot.getImageStreamConfig(1, &robotConfig));
+  BOOST_CHECK_EQUAL(robotConfig.max_width(), 320);
+  BOOST_CHECK(!robot.getImageStreamConfig(3, &robotConfig));
+
+  // the encoder output is sent from its own buffer
+  std::string encoded(20000, 0);
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    encoded[i] = static_cast<char>(i * 7);
+  }
+  ImageFrame frame;
+  frame.set_camera_id(1);
+  frame.set_encoding(JPEG_IMAGE);
+  frame.set_width(320);
+  frame.set_height(240);
+  *frame.mutable_timestamp() = robot.getTime();
+  for (int i = 0; i < 4; ++i) {
+    BOOST_CHECK_EQUAL(robot.setImageFrame(frame, encoded.data(), encoded.size()) > 0, i % 2 == 0);
+  }
+  frame.set_camera_id(2);
+  BOOST_CHECK_EQUAL(robot.setImageFrame(frame, encoded.data(), encoded.size()), 0);
+  // the frame has data already
+  frame.set_camera_id(3);
+  frame.set_data("x");
+  BOOST_CHECK_EQUAL(robot.setImageFrame(frame, encoded.data(), encoded.size()), 0);
+  BOOST_CHECK(robot.setImageFrame(frame) > 0);
+
+  std::vector<ImageFrame> received;
+  ImageFrame receivedFrame;
+  Timer timer;
+  timer.start();
+  while (received.size() < 3 && timer.getElapsedTime() < 5) {
+    if (controller.getImageFrame(&receivedFrame)) {
+      received.push_back(receivedFrame);
+    } else {
+      usleep(1000);
+    }
+  }
+  BOOST_REQUIRE_EQUAL(received.size(), 3);
+  BOOST_CHECK_EQUAL(received[0].camera_id(), 1);
+  BOOST_CHECK_EQUAL(received[0].encoding(), JPEG_IMAGE);
+  BOOST_CHECK_EQUAL(received[0].width(), 320);
+  BOOST_CHECK(received[0].data() == encoded);
+  BOOST_CHECK_EQUAL(received[1].camera_id(), 1);
+  BOOST_CHECK_EQUAL(received[2].camera_id(), 3);
+  BOOST_CHECK_EQUAL(received[2].data(), "x");
+
+  controller.stopUpdateThread();
+  robot.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_session_resume) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+  BOOST_CHECK(controller.setVersionedHeader());
+
+  RobotName name;
+  name.set_value("resumed robot");
+  robot.initRobotName(name);
+  Pose pose;
+  pose.mutable_position()->set_x(1);
+  robot.setCurrentPose(pose);
+  Pose received;
+  Timer timer;
+  timer.start();
+  while (!controller.getCurrentPose(&received) && timer.getElapsedTime() < 5) {
+    controller.update();
+    usleep(1000);
+  }
+  COMPARE_PROTOBUF(pose, received);
+
+  // the first resume does not know the session of the robot, so it gets all types
+  BOOST_CHECK(controller.resumeSession() >= 2);
+  BOOST_CHECK_EQUAL(controller.robotSessionId, robot.getSessionId());
+  RobotName receivedName;
+  BOOST_CHECK(controller.getTelemetry(ROBOT_NAME, &receivedName));
+  COMPARE_PROTOBUF(name, receivedName);
+  while (controller.getCurrentPose(&received)) {}
+  // nothing changed
+  BOOST_CHECK_EQUAL(controller.resumeSession(), 0);
+
+  // the pose changes during a dropout
+  pose.mutable_position()->set_x(2);
+  robot.setCurrentPose(pose);
+  usleep(100 * 1000);
+  std::string lost;
+  while (telemetry->receive(&lost, Transport::NOBLOCK)) {}
+  BOOST_CHECK_EQUAL(controller.resumeSession(), 1);
+  BOOST_CHECK(controller.getCurrentPose(&received));
+  COMPARE_PROTOBUF(pose, received);
+
+  // resumed automatically when the robot replies again
+  controller.setSessionResumption();
+  controller.connectionLost(1);
+  pose.mutable_position()->set_x(3);
+  robot.setCurrentPose(pose);
+  usleep(100 * 1000);
+  while (telemetry->receive(&lost, Transport::NOBLOCK)) {}
+  controller.requestRobotName(&receivedName);
+  controller.update();
+  BOOST_CHECK(controller.getCurrentPose(&received));
+  COMPARE_PROTOBUF(pose, received);
+
+  BOOST_CHECK(controller.setVersionedHeader(false));
+  robot.stopUpdateThread();
+  controller.update();
+}
+
+// one direction of an in-memory link, which can go down
+class LinkTransport : public Transport {
+ public:
+  struct Channel {
+    std::mutex mutex;
+    std::deque<std::string> messages;
+  };
+
+  LinkTransport(std::shared_ptr<Channel> in, std::shared_ptr<Channel> out, std::shared_ptr<std::atomic<bool>> down):in(in), out(out), down(down) {}
+
+  int send(const std::string& buf, Flags flags = NONE) {
+    if (*down) {
+      // lost
+      return buf.size();
+    }
+    std::lock_guard<std::mutex> lock(out->mutex);
+    out->messages.push_back(buf);
+    return buf.size();
+  }
+
+  int receive(std::string* buf, Flags flags = NONE) {
+    std::lock_guard<std::mutex> lock(in->mutex);
+    if (in->messages.empty()) {
+      return 0;
+    }
+    buf->swap(in->messages.front());
+    in->messages.pop_front();
+    return buf->size();
+  }
+
+  std::shared_ptr<Channel> in;
+  std::shared_ptr<Channel> out;
+  std::shared_ptr<std::atomic<bool>> down;
+};
+
+BOOST_AUTO_TEST_CASE(check_bonding_failover) {
+  std::vector<TransportSharedPtr> robotLinks, controllerLinks;
+  std::vector<std::shared_ptr<std::atomic<bool>>> down;
+  for (int i = 0; i < 2; ++i) {
+    std::shared_ptr<LinkTransport::Channel> up = std::make_shared<LinkTransport::Channel>();
+    std::shared_ptr<LinkTransport::Channel> downstream = std::make_shared<LinkTransport::Channel>();
+    down.push_back(std::make_shared<std::atomic<bool>>(false));
+    robotLinks.push_back(std::make_shared<LinkTransport>(up, downstream, down.back()));
+    controllerLinks.push_back(std::make_shared<LinkTransport>(downstream, up, down.back()));
+  }
+  TransportWrapperBonding::Options options;
+  options.probeIntervalMs = 10;
+  options.failoverTimeoutMs = 50;
+  options.duplicateMaxSize = 16;
+  TransportWrapperBonding robot(robotLinks, options);
+  TransportWrapperBonding controller(controllerLinks, options);
+  // measure both links
+  usleep(100 * 1000);
+
+  // small messages are sent on both links, but received once
+  std::string received;
+  for (int i = 0; i < 10; ++i) {
+    controller.send("heartbeat" + std::to_string(i));
+  }
+  for (int i = 0; i < 10; ++i) {
+    BOOST_CHECK(robot.waitForData(100));
+    BOOST_CHECK(robot.receive(&received, Transport::NOBLOCK));
+    BOOST_CHECK_EQUAL(received, "heartbeat" + std::to_string(i));
+  }
+  usleep(10 * 1000);
+  BOOST_CHECK_EQUAL(robot.receive(&received, Transport::NOBLOCK), 0);
+  std::vector<TransportWrapperBonding::LinkStatistics> statistics = robot.getLinkStatistics();
+  BOOST_CHECK_EQUAL(statistics[0].received + statistics[1].received, 20);
+  BOOST_CHECK_EQUAL(statistics[0].duplicates + statistics[1].duplicates, 10);
+  BOOST_CHECK(statistics[0].alive && statistics[1].alive);
+  BOOST_CHECK(statistics[0].rttMs > 0);
+
+  // the active link goes down, the next one is used within the failover timeout
+  const std::string big(100, 'x');
+  const size_t active = controller.getActiveLink();
+  *down[active] = true;
+  usleep(options.failoverTimeoutMs * 2 * 1000);
+  BOOST_CHECK(controller.getActiveLink() != active);
+  BOOST_CHECK(!controller.getLinkStatistics()[active].alive);
+  BOOST_CHECK(controller.send(big));
+  BOOST_CHECK(robot.waitForData(100));
+  BOOST_CHECK(robot.receive(&received));
+  BOOST_CHECK_EQUAL(received, big);
+
+  // a restarted peer starts its sequence numbers again, they are no duplicates
+  TransportWrapperBonding restarted(controllerLinks, options);
+  BOOST_CHECK(restarted.send("restarted"));
+  BOOST_CHECK(robot.waitForData(100));
+  BOOST_CHECK(robot.receive(&received, Transport::NOBLOCK));
+  BOOST_CHECK_EQUAL(received, "restarted");
+}
+
+BOOST_AUTO_TEST_CASE(check_bonding_queue) {
+  std::shared_ptr<LinkTransport::Channel> up = std::make_shared<LinkTransport::Channel>();
+  std::shared_ptr<LinkTransport::Channel> downstream = std::make_shared<LinkTransport::Channel>();
+  std::shared_ptr<std::atomic<bool>> down = std::make_shared<std::atomic<bool>>(false);
+  TransportWrapperBonding::Options options;
+  options.maxQueuedMessages = 3;
+  TransportWrapperBonding robot({std::make_shared<LinkTransport>(up, downstream, down)}, options);
+  TransportWrapperBonding controller({std::make_shared<LinkTransport>(downstream, up, down)}, options);
+
+  // nobody receives, the latest messages are kept
+  for (int i = 0; i < 10; ++i) {
+    controller.send(std::to_string(i));
+  }
+  Timer timer;
+  timer.start();
+  while (robot.getDroppedMessages() < 7 && timer.getElapsedTime() < 5) {
+    usleep(1000);
+  }
+  BOOST_CHECK_EQUAL(robot.getDroppedMessages(), 7);
+  std::string received;
+  for (int i = 7; i < 10; ++i) {
+    BOOST_CHECK(robot.receive(&received, Transport::NOBLOCK));
+    BOOST_CHECK_EQUAL(received, std::to_string(i));
+  }
+}
+
+// datagrams sent are received in order, the test drops some of them
+class DatagramLoop : public Transport {
+ public:
+  int send(const std::string& buf, Flags flags = NONE) {
+    datagrams.push_back(buf);
+    return buf.size();
+  }
+
+  int receive(std::string* buf, Flags flags = NONE) {
+    if (datagrams.empty()) {
+      return 0;
+    }
+    buf->swap(datagrams.front());
+    datagrams.pop_front();
+    return buf->size();
+  }
+
+  std::deque<std::string> datagrams;
+};
+
+BOOST_AUTO_TEST_CASE(check_fec_fragmentation) {
+  std::shared_ptr<DatagramLoop> loop = std::make_shared<DatagramLoop>();
+  TransportWrapperFEC::Options options;
+  options.mtu = 1000;
+  options.maxPending = 2;
+  TransportWrapperFEC sender(loop, options);
+  TransportWrapperFEC receiver(loop, options);
+  sender.setGroupSize(POINTCLOUD, 4);
+
+  const uint16_t type = POINTCLOUD;
+  std::string message(reinterpret_cast<const char*>(&type), sizeof(uint16_t));
+  for (int i = 0; i < 5000; ++i) {
+    message.push_back(static_cast<char>(i * 7));
+  }
+  // 6 fragments of at most 982 bytes and 2 parity datagrams
+  BOOST_CHECK_EQUAL(sender.send(message), message.size());
+  BOOST_CHECK_EQUAL(loop->datagrams.size(), 8);
+  for (const std::string &datagram : loop->datagrams) {
+    BOOST_CHECK(datagram.size() <= options.mtu);
+    // routable by type
+    BOOST_CHECK_EQUAL(MessageView(datagram).get<uint16_t>(), POINTCLOUD);
+  }
+  std::string received;
+  BOOST_CHECK_EQUAL(receiver.receive(&received), message.size());
+  BOOST_CHECK(received == message);
+  // the parity of the completed message is ignored
+  BOOST_CHECK_EQUAL(receiver.receive(&received, Transport::NOBLOCK), 0);
+  BOOST_CHECK_EQUAL(receiver.getStatistics().parity, 2);
+
+  // one lost fragment in each group is recovered
+  sender.send(message);
+  loop->datagrams.erase(loop->datagrams.begin() + 5);
+  loop->datagrams.erase(loop->datagrams.begin() + 1);
+  BOOST_CHECK_EQUAL(receiver.receive(&received), message.size());
+  BOOST_CHECK(received == message);
+  BOOST_CHECK_EQUAL(receiver.getStatistics().recovered, 2);
+  BOOST_CHECK_EQUAL(receiver.receive(&received, Transport::NOBLOCK), 0);
+
+  // two lost fragments of the same group are not
+  sender.send(message);
+  loop->datagrams.erase(loop->datagrams.begin() + 1, loop->datagrams.begin() + 3);
+  BOOST_CHECK_EQUAL(receiver.receive(&received), 0);
+
+  // no parity for other types, the incomplete messages are dropped after maxPending newer ones
+  message[0] = CURRENT_POSE;
+  for (int i = 0; i < 2; ++i) {
+    sender.send(message);
+    loop->datagrams.pop_front();
+    BOOST_CHECK_EQUAL(loop->datagrams.size(), 5);
+    BOOST_CHECK_EQUAL(receiver.receive(&received), 0);
+  }
+  BOOST_CHECK_EQUAL(receiver.getStatistics().dropped, 1);
+  receiver.pending.clear();
+
+  // small messages are one datagram
+  const std::string small = message.substr(0, 100);
+  sender.send(small);
+  BOOST_CHECK_EQUAL(loop->datagrams.size(), 1);
+  BOOST_CHECK_EQUAL(receiver.receive(&received), small.size());
+  BOOST_CHECK(received == small);
+
+  // a datagram of a pending message id with another fragment count is not indexed into the message
+  sender.send(message.substr(0, 1500));
+  BOOST_REQUIRE_EQUAL(loop->datagrams.size(), 2);
+  std::string forged = loop->datagrams.back();
+  loop->datagrams.pop_back();
+  const uint16_t forgedIndex = 8;
+  const uint16_t forgedFragments = 10;
+  memcpy(&forged[6], &forgedIndex, sizeof(uint16_t));
+  memcpy(&forged[8], &forgedFragments, sizeof(uint16_t));
+  loop->datagrams.push_back(forged);
+  BOOST_CHECK_EQUAL(receiver.receive(&received), 0);
+  BOOST_CHECK_EQUAL(receiver.pending.size(), 1);
+  BOOST_CHECK_EQUAL(receiver.pending.begin()->second.missing, 1);
+}
+
+// blocks sending until it is opened, like a transport on a stalled link
+class GatedTransport : public Transport {
+ public:
+  GatedTransport():open(false) {}
+
+  int send(const std::string& buf, Flags flags = NONE) {
+    while (!open) {
+      usleep(1000);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    sent.push_back(buf);
+    return buf.size();
+  }
+
+  int receive(std::string* buf, Flags flags = NONE) {
+    return 0;
+  }
+
+  size_t count(const uint16_t &type) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::count_if(sent.begin(), sent.end(), [&type](const std::string &message) { return MessageView(message).get<uint16_t>() == type; });
+  }
+
+  std::atomic<bool> open;
+  std::mutex mutex;
+  std::vector<std::string> sent;
+};
+
+BOOST_AUTO_TEST_CASE(check_async_telemetry_queue) {
+  std::shared_ptr<GatedTransport> gated = std::make_shared<GatedTransport>();
+  ControlledRobot robot(std::make_shared<PeerTransport>(), gated);
+  robot.setAsyncTelemetry(true, 2);
+  robot.setTelemetryQueuePolicy(CURRENT_TWIST, TelemetrySendQueue::COALESCE);
+
+  // the setters return while the transport is blocked
+  Timer timer;
+  timer.start();
+  Pose pose;
+  Twist twist;
+  for (int i = 0; i < 10; ++i) {
+    pose.mutable_position()->set_x(i);
+    twist.mutable_linear()->set_x(i);
+    BOOST_CHECK(robot.setCurrentPose(pose) > 0);
+    BOOST_CHECK(robot.setCurrentTwist(twist) > 0);
+  }
+  for (int i = 0; i < 3; ++i) {
+    BOOST_CHECK(robot.setLogMessage(FATAL, "log " + std::to_string(i)) > 0);
+  }
+  BOOST_CHECK(timer.getElapsedTime() < 0.5);
+  BOOST_CHECK(!robot.flushTelemetry(10));
+
+  gated->open = true;
+  BOOST_CHECK(robot.flushTelemetry());
+  // the first pose may have been taken by the sender thread before the queue was full
+  BOOST_CHECK(gated->count(CURRENT_POSE) >= 2 && gated->count(CURRENT_POSE) <= 3);
+  BOOST_CHECK(gated->count(CURRENT_TWIST) >= 1 && gated->count(CURRENT_TWIST) <= 2);
+  BOOST_CHECK_EQUAL(gated->count(LOG_MESSAGE), 3);
+
+  // the newest values were kept
+  Pose lastPose;
+  Twist lastTwist;
+  for (const std::string &message : gated->sent) {
+    const uint16_t type = MessageView(message).get<uint16_t>();
+    if (type == CURRENT_POSE) {
+      lastPose.ParseFromString(message.substr(sizeof(uint16_t)));
+    } else if (type == CURRENT_TWIST) {
+      lastTwist.ParseFromString(message.substr(sizeof(uint16_t)));
+    }
+  }
+  COMPARE_PROTOBUF(pose, lastPose);
+  COMPARE_PROTOBUF(twist, lastTwist);
+
+  TelemetrySendQueue::Statistics statistics = robot.getTelemetryQueueStatistics();
+  BOOST_CHECK_EQUAL(statistics.queued, 23);
+  BOOST_CHECK_EQUAL(statistics.sent, gated->sent.size());
+  BOOST_CHECK(statistics.dropped >= 7);
+  BOOST_CHECK(statistics.coalesced >= 8);
+}
+
+BOOST_AUTO_TEST_CASE(check_telemetry_priority_chunks) {
+  std::shared_ptr<GatedTransport> gated = std::make_shared<GatedTransport>();
+  ControlledRobot robot(std::make_shared<PeerTransport>(), gated);
+  robot.setAsyncTelemetry();
+  robot.setTelemetryChunkSize(1000);
+
+  // the sender thread blocks on the first chunk of the point cloud, the poses are queued behind it
+  PointCloud cloud = TypeGenerator::genPointCloud(10000);
+  BOOST_CHECK(robot.setPointCloud(cloud) > 0);
+  usleep(10 * 1000);
+  Pose pose = TypeGenerator::genPose();
+  for (int i = 0; i < 3; ++i) {
+    BOOST_CHECK(robot.setCurrentPose(pose) > 0);
+  }
+  gated->open = true;
+  BOOST_CHECK(robot.flushTelemetry());
+
+  // the poses (HIGH) are sent between the chunks of the point cloud (BULK)
+  std::vector<size_t> chunks, poses;
+  for (size_t i = 0; i < gated->sent.size(); ++i) {
+    const uint16_t type = MessageView(gated->sent[i]).get<uint16_t>();
+    if (type == TELEMETRY_CHUNK) {
+      chunks.push_back(i);
+    } else if (type == CURRENT_POSE) {
+      poses.push_back(i);
+    }
+  }
+  const size_t cloudSize = cloud.ByteSizeLong();
+  BOOST_CHECK_EQUAL(chunks.size(), (cloudSize + 999) / 1000);
+  BOOST_CHECK_EQUAL(poses.size(), 3);
+  BOOST_CHECK(poses.back() < chunks.back());
+
+  // reassembled by the controller
+  std::shared_ptr<DatagramLoop> loop = std::make_shared<DatagramLoop>();
+  RobotController controller(std::make_shared<PeerTransport>(), loop);
+  loop->datagrams.assign(gated->sent.begin(), gated->sent.end());
+  controller.update();
+  PointCloud received;
+  BOOST_CHECK(controller.getPointCloud(&received));
+  COMPARE_PROTOBUF(cloud, received);
+  Pose receivedPose;
+  BOOST_CHECK(controller.getCurrentPose(&receivedPose));
+  COMPARE_PROTOBUF(pose, receivedPose);
+
+  // a lost chunk drops the message
+  loop->datagrams.assign(gated->sent.begin(), gated->sent.end());
+  loop->datagrams.erase(loop->datagrams.begin() + chunks[1]);
+  controller.update();
+  BOOST_CHECK(!controller.getPointCloud(&received));
+
+  // messages larger than the maximum size are dropped before allocating the buffer
+  controller.setMaxChunkedMessageSize(cloudSize - 1);
+  loop->datagrams.assign(gated->sent.begin(), gated->sent.end());
+  controller.update();
+  BOOST_CHECK(!controller.getPointCloud(&received));
+  controller.setMaxChunkedMessageSize(cloudSize);
+  loop->datagrams.assign(gated->sent.begin(), gated->sent.end());
+  controller.update();
+  BOOST_CHECK(controller.getPointCloud(&received));
+}
+
+BOOST_AUTO_TEST_CASE(check_capabilities) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  robot.startUpdateThread(10);
+  robot.setTelemetryChunkSize(4096);
+
+  JointState joints;
+  joints.add_name("joint1");
+  joints.add_position(0);
+  robot.initControllableJoints(joints);
+
+  Capabilities offer = RobotController::defaultCapabilities();
+  PointCloudEncoding encoding;
+  encoding.set_type(QUANTIZED_POINTCLOUD);
+  encoding.set_resolution(0.01);
+  *offer.add_pointcloud_encodings() = encoding;
+  BOOST_CHECK(controller.negotiateCapabilities(offer));
+
+  Capabilities selected = controller.getNegotiatedCapabilities();
+  BOOST_CHECK_EQUAL(selected.protocol_version(), PROTOCOL_VERSION);
+  BOOST_CHECK_EQUAL(selected.wire_header_version(), WireHeader::currentVersion);
+  BOOST_CHECK_EQUAL(controller.getWireHeaderVersion(), WireHeader::currentVersion);
+  BOOST_CHECK_EQUAL(selected.pointcloud_encodings_size(), 1);
+  BOOST_CHECK(selected.compact_joints());
+  BOOST_CHECK(selected.telemetry_chunks());
+  BOOST_CHECK(selected.session_resume());
+  BOOST_CHECK(controller.sessionResumption.load());
+  BOOST_CHECK(controller.compactJointTable.load() != 0);
+  COMPARE_PROTOBUF(robot.getNegotiatedCapabilities(), selected);
+
+  // without chunk support of the controller, the robot sends complete messages
+  offer.set_telemetry_chunks(false);
+  offer.set_compact_joints(false);
+  BOOST_CHECK(controller.negotiateCapabilities(offer));
+  BOOST_CHECK(!controller.getNegotiatedCapabilities().telemetry_chunks());
+  BOOST_CHECK_EQUAL(robot.telemetryQueue.chunkSize, 0);
+
+  BOOST_CHECK(controller.setVersionedHeader(false));
+  BOOST_CHECK(controller.setCompactJoints(false));
+  robot.stopUpdateThread();
+  controller.update();
+}
+
+BOOST_AUTO_TEST_CASE(check_bulk_conversion) {
+  // not a multiple of the vector width, so the remainder loops run as well
+  std::vector<double> doubles;
+  for (int i = 0; i < 23; ++i) {
+    doubles.push_back(i * 0.25 - 3);
+  }
+  std::vector<float> floats(doubles.size());
+  BulkConversion::narrow(doubles.data(), floats.data(), doubles.size());
+  std::vector<double> widened(doubles.size());
+  BulkConversion::widen(floats.data(), widened.data(), floats.size());
+  for (size_t i = 0; i < doubles.size(); ++i) {
+    BOOST_CHECK_EQUAL(floats[i], static_cast<float>(doubles[i]));
+    BOOST_CHECK_EQUAL(widened[i], doubles[i]);
+  }
+
+  PointCloud cloud = TypeGenerator::genPointCloud(101);
+  PackedPointCloud::pack(&cloud);
+  const PointCloud original = cloud;
+  // 90 degrees around z
+  Pose origin;
+  origin.mutable_position()->set_x(1);
+  origin.mutable_position()->set_y(2);
+  origin.mutable_orientation()->set_z(std::sqrt(0.5));
+  origin.mutable_orientation()->set_w(std::sqrt(0.5));
+  BulkConversion::toOrigin(&cloud, origin);
+  COMPARE_PROTOBUF(cloud.origin(), origin);
+  for (size_t i = 0; i < PackedPointCloud::size(cloud); ++i) {
+    PackedPointCloud::Point a = PackedPointCloud::getPoint(original, i);
+    PackedPointCloud::Point b = PackedPointCloud::getPoint(cloud, i);
+    BOOST_CHECK_CLOSE_FRACTION(b.x + 10, a.y - 2 + 10, 1e-4);
+    BOOST_CHECK_CLOSE_FRACTION(b.y + 10, -(a.x - 1) + 10, 1e-4);
+    BOOST_CHECK_CLOSE_FRACTION(b.z + 10, a.z + 10, 1e-4);
+  }
+  BulkConversion::fromOrigin(&cloud);
+  BOOST_CHECK(!cloud.has_origin());
+  for (size_t i = 0; i < PackedPointCloud::size(cloud); ++i) {
+    PackedPointCloud::Point a = PackedPointCloud::getPoint(original, i);
+    PackedPointCloud::Point b = PackedPointCloud::getPoint(cloud, i);
+    BOOST_CHECK_CLOSE_FRACTION(b.x + 10, a.x + 10, 1e-4);
+    BOOST_CHECK_CLOSE_FRACTION(b.y + 10, a.y + 10, 1e-4);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(check_off_thread_parsing) {
+  // the callbacks of an ORDERED key are called one at a time in order, also with several workers
+  CallbackExecutor executor(4);
+  executor.setPolicy(1, CallbackExecutor::ORDERED);
+  std::vector<int> order;
+  std::atomic<int> running(0);
+  bool overlapped = false;
+  for (int i = 0; i < 50; ++i) {
+    executor.post(1, [&, i]() {
+      overlapped |= running.fetch_add(1) > 0;
+      usleep(100);
+      order.push_back(i);
+      running.fetch_sub(1);
+    });
+  }
+  BOOST_CHECK(executor.waitUntilIdle(5));
+  BOOST_CHECK(!overlapped);
+  BOOST_REQUIRE_EQUAL(order.size(), 50);
+  for (int i = 0; i < 50; ++i) {
+    BOOST_CHECK_EQUAL(order[i], i);
+  }
+
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  controller.setOffThreadParsing({POINTCLOUD}, 2);
+
+  std::vector<std::string> frames;
+  std::thread::id callbackThread;
+  controller.addTelemetryReceivedCallback<PointCloud>(POINTCLOUD, [&](const PointCloud &cloud) {
+    frames.push_back(cloud.frame());
+    callbackThread = std::this_thread::get_id();
+  });
+  std::thread::id updateThread;
+  controller.addTelemetryReceivedCallback<Pose>(CURRENT_POSE, [&](const Pose &pose) {
+    updateThread = std::this_thread::get_id();
+  });
+
+  controller.startUpdateThread(10);
+  robot.startUpdateThread(10);
+
+  Pose pose;
+  Timer timer;
+  timer.start();
+  while (!controller.getCurrentPose(&pose) && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    usleep(10 * 1000);
+  }
+
+  PointCloud cloud;
+  for (int i = 0; i < 20000; ++i) {
+    Position *point = cloud.add_points();
+    point->set_x(i);
+    point->set_y(i);
+    point->set_z(i);
+  }
+  for (int i = 0; i < 5; ++i) {
+    cloud.set_frame(std::to_string(i));
+    robot.setPointCloud(cloud);
+  }
+
+  timer.start();
+  while (frames.size() < 5 && timer.getElapsedTime() < 5) {
+    usleep(10 * 1000);
+  }
+  BOOST_CHECK(controller.waitForParsing());
+  BOOST_REQUIRE_EQUAL(frames.size(), 5);
+  for (int i = 0; i < 5; ++i) {
+    BOOST_CHECK_EQUAL(frames[i], std::to_string(i));
+  }
+  BOOST_CHECK(callbackThread != updateThread);
+
+  PointCloud received;
+  BOOST_CHECK(controller.getPointCloud(&received));
+  BOOST_CHECK_EQUAL(received.frame(), "0");
+  BOOST_CHECK_EQUAL(received.points_size(), 20000);
+
+  robot.stopUpdateThread();
+  controller.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_telemetry_memory_budget) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+
+  PointCloud cloud;
+  for (int i = 0; i < 1000; ++i) {
+    Position *point = cloud.add_points();
+    point->set_x(i);
+    point->set_y(i);
+    point->set_z(i);
+  }
+  const size_t cloudBytes = cloud.ByteSizeLong();
+  controller.setTelemetryMemoryBudget(cloudBytes * 5 / 2);
+  BOOST_CHECK(!controller.setTelemetryByteCapacity(TELEMETRY_MESSAGE_TYPES_NUMBER, 1000));
+
+  std::atomic<int> clouds(0);
+  controller.addTelemetryReceivedCallback<PointCloud>(POINTCLOUD, [&](const PointCloud &received) {
+    clouds++;
+  });
+
+  controller.startUpdateThread(10);
+  robot.startUpdateThread(10);
+
+  Pose pose;
+  pose.mutable_position()->set_x(1);
+  Pose received;
+  Timer timer;
+  timer.start();
+  while (!controller.getCurrentPose(&received) && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    usleep(10 * 1000);
+  }
+
+  pose.mutable_position()->set_x(2);
+  robot.setCurrentPose(pose);
+  for (int i = 0; i < 5; ++i) {
+    cloud.set_frame(std::to_string(i));
+    robot.setPointCloud(cloud);
+  }
+  timer.start();
+  while ((clouds < 5 || controller.getBufferedTelemetryBytes() > cloudBytes * 5 / 2) && timer.getElapsedTime() < 5) {
+    usleep(10 * 1000);
+  }
+  BOOST_CHECK_EQUAL(clouds, 5);
+  BOOST_CHECK_LE(controller.getBufferedTelemetryBytes(), cloudBytes * 5 / 2);
+
+  // the oldest clouds were dropped, the small type is kept
+  ReceiveStatistics::TypeStats stats = controller.getReceiveStatistics().getTelemetryStats(POINTCLOUD);
+  BOOST_CHECK_EQUAL(stats.bufferedBytes, cloud.ByteSizeLong() * 2);
+  PointCloud buffered;
+  BOOST_CHECK(controller.getPointCloud(&buffered));
+  BOOST_CHECK_EQUAL(buffered.frame(), "3");
+  std::vector<Pose> poses;
+  BOOST_CHECK(controller.getAllTelemetry(CURRENT_POSE, &poses));
+  BOOST_CHECK_EQUAL(poses.back().position().x(), 2);
+
+  robot.stopUpdateThread();
+  controller.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_shared_telemetry_store) {
+  SharedTelemetryStore::Options options;
+  options.add(CURRENT_POSE).add(JOINT_STATE, SharedTelemetryStore::TypeLayout(2, 1024));
+  std::shared_ptr<SharedTelemetryStore> owner = std::make_shared<SharedTelemetryStore>("rrc_test_store", SharedTelemetryStore::OWNER, options);
+  SharedTelemetryStore reader("rrc_test_store", SharedTelemetryStore::READER);
+  BOOST_REQUIRE(reader.attached());
+  BOOST_CHECK(reader.isStored(CURRENT_POSE));
+  BOOST_CHECK(!reader.isStored(POINTCLOUD));
+
+  Pose pose;
+  BOOST_CHECK(!reader.getLatestTelemetry(CURRENT_POSE, &pose));
+  for (int i = 1; i <= 3; ++i) {
+    pose.mutable_position()->set_x(i);
+    BOOST_CHECK(owner->publish(CURRENT_POSE, pose));
+  }
+  Pose received;
+  BOOST_CHECK(reader.getLatestTelemetry<CURRENT_POSE>(&received));
+  BOOST_CHECK_EQUAL(received.position().x(), 3);
+  // the reader gets each message once, oldest first
+  for (int i = 1; i <= 3; ++i) {
+    BOOST_CHECK(reader.getCurrentPose(&received));
+    BOOST_CHECK_EQUAL(received.position().x(), i);
+  }
+  BOOST_CHECK(!reader.getCurrentPose(&received));
+
+  // the oldest messages are overwritten, too large ones are not stored
+  JointState joints;
+  for (int i = 0; i < 3; ++i) {
+    joints.add_position(i);
+    BOOST_CHECK(owner->publish(JOINT_STATE, joints));
+  }
+  joints.add_name(std::string(2000, 'x'));
+  BOOST_CHECK(!owner->publish(JOINT_STATE, joints));
+  BOOST_CHECK_EQUAL(reader.getOversized(JOINT_STATE), 1);
+  JointState receivedJoints;
+  BOOST_CHECK(reader.getJointState(&receivedJoints));
+  BOOST_CHECK_EQUAL(receivedJoints.position_size(), 2);
+  BOOST_CHECK(reader.getJointState(&receivedJoints));
+  BOOST_CHECK_EQUAL(receivedJoints.position_size(), 3);
+  BOOST_CHECK_EQUAL(reader.getDropped(JOINT_STATE), 1);
+  BOOST_CHECK(!owner->publish(POINTCLOUD, PointCloud()));
+
+  // published by the RobotController owning the store
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  controller.setTelemetryStore(owner);
+  controller.startUpdateThread(10);
+  robot.startUpdateThread(10);
+
+  pose.mutable_position()->set_x(5);
+  Timer timer;
+  timer.start();
+  received.Clear();
+  while (received.position().x() != 5 && timer.getElapsedTime() < 5) {
+    robot.setCurrentPose(pose);
+    reader.waitForTelemetry(10);
+    reader.getLatestTelemetry(CURRENT_POSE, &received);
+  }
+  BOOST_CHECK_EQUAL(received.position().x(), 5);
+
+  // more messages than the buffer of the controller holds, nobody pops it in this process
+  for (int i = 0; i < 20; ++i) {
+    pose.mutable_position()->set_x(10 + i);
+    robot.setCurrentPose(pose);
+    timer.start();
+    while (received.position().x() != 10 + i && timer.getElapsedTime() < 5) {
+      reader.waitForTelemetry(10);
+      reader.getLatestTelemetry(CURRENT_POSE, &received);
+    }
+    BOOST_REQUIRE_EQUAL(received.position().x(), 10 + i);
+  }
+
+  robot.stopUpdateThread();
+  controller.stopUpdateThread();
+  controller.setTelemetryStore(nullptr);
+
+  // a new owner replaces the segment, the reader attaches to it
+  owner.reset();
+  BOOST_CHECK(!reader.attached());
+  owner = std::make_shared<SharedTelemetryStore>("rrc_test_store", SharedTelemetryStore::OWNER, options);
+  BOOST_CHECK(reader.attached());
+  BOOST_CHECK_EQUAL(reader.getPublished(CURRENT_POSE), 0);
+  pose.mutable_position()->set_x(6);
+  owner->publish(CURRENT_POSE, pose);
+  BOOST_CHECK(reader.getCurrentPose(&received));
+  BOOST_CHECK_EQUAL(received.position().x(), 6);
+
+  // a crashed owner leaves its segment READY, the reader finds the segment of the next owner by the name
+  std::shared_ptr<SharedTelemetryStore> next = std::make_shared<SharedTelemetryStore>("rrc_test_store", SharedTelemetryStore::OWNER, options);
+  usleep((SharedTelemetryStore::replacementCheckMs + 50) * 1000);
+  BOOST_CHECK(reader.attached());
+  BOOST_CHECK_EQUAL(reader.getPublished(CURRENT_POSE), 0);
+  pose.mutable_position()->set_x(7);
+  next->publish(CURRENT_POSE, pose);
+  BOOST_CHECK(reader.getCurrentPose(&received));
+  BOOST_CHECK_EQUAL(received.position().x(), 7);
+  // the former owner does not remove the segment of its successor
+  owner.reset();
+  SharedTelemetryStore late("rrc_test_store", SharedTelemetryStore::READER);
+  BOOST_CHECK(late.attached());
+  BOOST_CHECK(late.getLatestTelemetry(CURRENT_POSE, &received));
+  BOOST_CHECK_EQUAL(received.position().x(), 7);
+}
+
+BOOST_AUTO_TEST_CASE(check_log_batching) {
+  initComms();
+  RobotController controller(commands, telemetry);
+  ControlledRobot robot(command, telemetri);
+  controller.startUpdateThread(10);
+
+  // long interval, the batches are sent when full or flushed
+  LogBatcher::Options options;
+  options.intervalMs = 100000;
+  options.maxEntries = 3;
+  options.limit(DEBUG, 0.01, 2);
+  robot.setLogBatching(options);
+
+  for (int i = 0; i < 3; ++i) {
+    BOOST_CHECK_EQUAL(robot.setLogMessage(INFO, "repeated"), 0);
+  }
+  BOOST_CHECK_EQUAL(robot.setLogMessage(DEBUG, "debug 1"), 0);
+  // the third entry sends the batch
+  BOOST_CHECK(robot.setLogMessage(DEBUG, "debug 2") > 0);
+  BOOST_CHECK_EQUAL(robot.setLogMessage(DEBUG, "debug 3"), -1);
+  BOOST_CHECK_EQUAL(robot.setLogMessage(DEBUG, "debug 4"), -1);
+
+  std::vector<LogMessage> logs;
+  LogMessage log;
+  Timer timer;
+  timer.start();
+  while (logs.size() < 3 && timer.getElapsedTime() < 5) {
+    if (controller.getLogMessage(&log)) {
+      logs.push_back(log);
+    } else {
+      usleep(10 * 1000);
+    }
+  }
+  BOOST_REQUIRE_EQUAL(logs.size(), 3);
+  BOOST_CHECK_EQUAL(logs[0].message(), "repeated");
+  BOOST_CHECK_EQUAL(logs[0].count(), 3);
+  BOOST_CHECK(logs[0].has_timestamp());
+  BOOST_CHECK_EQUAL(logs[1].message(), "debug 1");
+  BOOST_CHECK_EQUAL(logs[2].message(), "debug 2");
+
+  // the rate limited messages are reported
+  BOOST_CHECK(robot.flushLogMessages() > 0);
+  timer.start();
+  while (!controller.getLogMessage(&log) && timer.getElapsedTime() < 5) {
+    usleep(10 * 1000);
+  }
+  BOOST_CHECK_EQUAL(log.level(), WARN);
+  BOOST_CHECK_EQUAL(log.message(), "2 log messages of level 5 dropped by the rate limit");
+  BOOST_CHECK_EQUAL(robot.flushLogMessages(), 0);
+
+  LogBatcher::Statistics statistics = robot.getLogBatchingStatistics();
+  BOOST_CHECK_EQUAL(statistics.added, 7);
+  BOOST_CHECK_EQUAL(statistics.merged, 2);
+  BOOST_CHECK_EQUAL(statistics.rateLimited, 2);
+  BOOST_CHECK_EQUAL(statistics.batches, 2);
+
+  // sent immediately again
+  robot.disableLogBatching();
+  BOOST_CHECK(robot.setLogMessage(INFO, "single") > 0);
+
+  controller.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(check_loopback_transport) {
+  TransportSharedPtr first, second;
+  TransportLoopback::Options options;
+  options.capacity = 2;
+  options.dropWhenFull = true;
+  options.receiveTimeoutMs = 10;
+  std::tie(first, second) = TransportLoopback::createPair(options);
+
+  std::string received;
+  BOOST_CHECK_EQUAL(second->receive(&received), 0);
+  BOOST_CHECK_EQUAL(first->send("one"), 3);
+  BOOST_CHECK_EQUAL(first->send(MessageView("tw"), MessageView("o")), 3);
+  // full
+  BOOST_CHECK_EQUAL(first->send("three"), 0);
+  BOOST_CHECK_EQUAL(std::dynamic_pointer_cast<TransportLoopback>(first)->getDropped(), 1);
+  BOOST_CHECK(second->waitForData(10));
+  BOOST_CHECK_EQUAL(second->receive(&received), 3);
+  BOOST_CHECK_EQUAL(received, "one");
+  ReceiveBuffer buffer;
+  BOOST_CHECK_EQUAL(second->receive(&buffer), 3);
+  BOOST_CHECK_EQUAL(buffer.view().toString(), "two");
+  BOOST_CHECK_EQUAL(second->receive(&buffer, Transport::NOBLOCK), 0);
+  BOOST_CHECK_EQUAL(second->send("back"), 4);
+  BOOST_CHECK_EQUAL(first->receive(&received), 4);
+  BOOST_CHECK_EQUAL(received, "back");
+
+  // a robot and a controller on the virtual clock, the heartbeats only expire when the clock advances
+  std::shared_ptr<VirtualClock> clock = std::make_shared<VirtualClock>(1000000000000);
+  Clock::setSource(clock);
+  {
+    TransportSharedPtr controllerCommands, robotCommands, controllerTelemetry, robotTelemetry;
+    std::tie(controllerCommands, robotCommands) = TransportLoopback::createPair();
+    std::tie(controllerTelemetry, robotTelemetry) = TransportLoopback::createPair();
+    RobotController controller(controllerCommands, controllerTelemetry);
+    ControlledRobot robot(robotCommands, robotTelemetry);
+    BOOST_CHECK_EQUAL(robot.getTime().secs(), 1000);
+    // woken up by the requests
+    robot.startUpdateThread(10, UpdateThread::REACTOR);
+
+    controller.setHeartBeatDuration(1);
+    clock->advance(std::chrono::milliseconds(1100));
+    // sends the heartbeat
+    controller.update();
+    Timer timer;
+    timer.start(5);
+    while (!robot.isConnected() && !timer.isExpired()) {
+      clock->advance(std::chrono::milliseconds(1));
+      usleep(1000);
+    }
+    BOOST_CHECK(robot.isConnected());
+
+    Pose pose;
+    pose.mutable_position()->set_x(4);
+    robot.setCurrentPose(pose);
+    controller.update();
+    Pose receivedPose;
+    BOOST_CHECK(controller.getCurrentPose(&receivedPose));
+    BOOST_CHECK_EQUAL(receivedPose.position().x(), 4);
+
+    // no heartbeat for 5 virtual seconds
+    clock->advance(std::chrono::seconds(5));
+    timer.start(5);
+    while (robot.isConnected() && !timer.isExpired()) {
+      clock->advance(std::chrono::milliseconds(1));
+      usleep(1000);
+    }
+    BOOST_CHECK(!robot.isConnected());
+    BOOST_CHECK(robot.getTime().secs() >= 1006);
+    robot.stopUpdateThread();
+  }
+  Clock::setSource(nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(check_fixed_layout) {
+  // codec round trip, absent sub messages stay absent
+  Pose pose = TypeGenerator::genPose();
+  pose.set_orientation2d(1.5);
+  pose.mutable_timestamp()->set_secs(1234);
+  pose.mutable_timestamp()->set_nsecs(5678);
+  FixedLayout::PoseLayout poseLayout;
+  FixedLayout::Codec<Pose>::encode(pose, &poseLayout);
+  Pose decodedPose;
+  FixedLayout::Codec<Pose>::decode(poseLayout, &decodedPose);
+  COMPARE_PROTOBUF(pose, decodedPose);
+  int64_t timestamp;
+  BOOST_CHECK(FixedLayout::Codec<Pose>::timestampNs(poseLayout, &timestamp));
+  BOOST_CHECK_EQUAL(timestamp, 1234000005678);
+
+  Twist twist;
+  *twist.mutable_angular() = TypeGenerator::genVector3();
+  FixedLayout::TwistLayout twistLayout;
+  FixedLayout::Codec<Twist>::encode(twist, &twistLayout);
+  Twist decodedTwist;
+  FixedLayout::Codec<Twist>::decode(twistLayout, &decodedTwist);
+  BOOST_CHECK(!decodedTwist.has_linear());
+  COMPARE_PROTOBUF(twist, decodedTwist);
+
+  IMU imu;
+  *imu.mutable_acceleration() = TypeGenerator::genVector3();
+  *imu.mutable_mag() = TypeGenerator::genVector3();
+  *imu.mutable_orientation() = TypeGenerator::genOrentation();
+  std::string encoded(sizeof(FixedLayout::IMULayout), 0);
+  FixedLayout::IMULayout imuLayout;
+  FixedLayout::Codec<IMU>::encode(imu, &imuLayout);
+  memcpy(&encoded[0], &imuLayout, sizeof(imuLayout));
+  std::string serialized;
+  FixedLayout::serialize<IMU>(encoded, &serialized);
+  BOOST_CHECK(serialized == imu.SerializeAsString());
+  BOOST_CHECK(!FixedLayout::read(encoded.data(), encoded.size() - 1, &imuLayout));
+
+  if (!FixedLayout::available) {
+    return;
+  }
+  std::vector<uint16_t> types = FixedLayout::supportedTypes();
+  BOOST_CHECK_EQUAL(types.size(), 4);
+  BOOST_CHECK(std::find(types.begin(), types.end(), CURRENT_POSE) != types.end());
+
+  // negotiated, the pose is sent as struct (own transports, no replies of other tests are pending)
+  TransportSharedPtr controllerCommands, robotCommands, controllerTelemetry, robotTelemetry;
+  std::tie(controllerCommands, robotCommands) = TransportLoopback::createPair();
+  std::tie(controllerTelemetry, robotTelemetry) = TransportLoopback::createPair();
+  RobotController controller(controllerCommands, controllerTelemetry);
+  ControlledRobot robot(robotCommands, robotTelemetry);
+  robot.startUpdateThread(10);
+  BOOST_REQUIRE(controller.negotiateCapabilities());
+  BOOST_CHECK_EQUAL(controller.getNegotiatedCapabilities().fixed_layout_types_size(), 4);
+  BOOST_CHECK(robot.fixedLayoutTypes[CURRENT_POSE].load());
+  BOOST_CHECK(!robot.fixedLayoutTypes[JOINT_STATE].load());
+
+  BOOST_CHECK_EQUAL(robot.setCurrentPose(pose), sizeof(FixedLayout::PoseLayout));
+  BOOST_CHECK_EQUAL(robot.setCurrentIMUValues(imu), sizeof(FixedLayout::IMULayout));
+  Pose received;
+  IMU receivedImu;
+  Timer timer;
+  timer.start();
+  while ((!controller.getCurrentPose(&received) || !controller.getCurrentIMUState(&receivedImu)) && timer.getElapsedTime() < 5) {
+    controller.update();
+    usleep(10 * 1000);
+  }
+  COMPARE_PROTOBUF(pose, received);
+  COMPARE_PROTOBUF(imu, receivedImu);
+
+  // requests get the cached struct serialized as protobuf message
+  Pose requested;
+  controller.requestTelemetry(CURRENT_POSE, &requested);
+  COMPARE_PROTOBUF(pose, requested);
+
+  // a relay caches the protobuf message for its requests
+  TransportSharedPtr relayCommands, relayTelemetry, relayClients, unused;
+  std::tie(relayCommands, unused) = TransportLoopback::createPair();
+  std::tie(relayTelemetry, unused) = TransportLoopback::createPair();
+  std::tie(relayClients, unused) = TransportLoopback::createPair();
+  TelemetryRelay relay(relayCommands, relayTelemetry, relayClients);
+  WireHeader header;
+  header.type = CURRENT_POSE;
+  header.flags = WireHeader::FIXED_LAYOUT;
+  std::string message(header.size() + sizeof(poseLayout), 0);
+  header.write(&message[0]);
+  memcpy(&message[header.size()], &poseLayout, sizeof(poseLayout));
+  relay.cacheTelemetry(MessageView(message));
+  std::string cachedPose;
+  BOOST_REQUIRE(relay.getLatest(CURRENT_POSE, &cachedPose));
+  BOOST_CHECK(cachedPose == pose.SerializeAsString());
+
+  // without the versioned header there is no flag, protobuf is sent
+  BOOST_CHECK(controller.setVersionedHeader(false));
+  std::string buf;
+  pose.SerializeToString(&buf);
+  BOOST_CHECK_EQUAL(robot.setCurrentPose(pose), buf.size());
+  robot.stopUpdateThread();
+  controller.update();
+  while (controller.getCurrentPose(&received)) {}
+  COMPARE_PROTOBUF(pose, received);
+}
+
+#if defined(TRANSPORT_DEFAULT_LZ4) || defined(TRANSPORT_DEFAULT_ZSTD)
+BOOST_AUTO_TEST_CASE(check_compressed_size_limit) {
+  TransportSharedPtr sender, receiver;
+  std::tie(sender, receiver) = TransportLoopback::createPair();
+  #ifdef TRANSPORT_DEFAULT_LZ4
+    TransportWrapperLZ4 compressing(sender, 0);
+    TransportWrapperLZ4 uncompressing(receiver, 0);
+  #else
+    TransportWrapperZstd compressing(sender, 16);
+    TransportWrapperZstd uncompressing(receiver, 16);
+  #endif
+  const std::string message(100000, 'a');
+  std::string received;
+  BOOST_CHECK_EQUAL(compressing.send(message), message.size());
+  BOOST_CHECK_EQUAL(uncompressing.receive(&received), message.size());
+  BOOST_CHECK(received == message);
+
+  // the uncompressed size is larger than the data can hold, nothing is allocated for it
+  const std::string forged = std::string("\x01\x00", 2) + std::string(10, 'x') + "\xff\xff\xff\xff" + "\x01";
+  BOOST_CHECK_EQUAL(sender->send(forged), forged.size());
+  BOOST_CHECK_EQUAL(uncompressing.receive(&received), 0);
+}
+#endif
+
+#ifdef TRANSPORT_SHM
+BOOST_AUTO_TEST_CASE(check_shm_reattach) {
+  std::unique_ptr<TransportShm> server(new TransportShm("rrc_test_reattach", TransportShm::SERVER));
+  TransportShm client("rrc_test_reattach", TransportShm::CLIENT);
+  BOOST_REQUIRE(client.attached());
+  BOOST_CHECK_EQUAL(client.send("first"), 5);
+  std::string received;
+  BOOST_CHECK_EQUAL(server->receive(&received, Transport::NOBLOCK), 5);
+
+  // a restarted server (the crashed one did not close its segment) replaces the segment
+  TransportShm restarted("rrc_test_reattach", TransportShm::SERVER);
+  usleep((TransportShm::replacementCheckMs + 50) * 1000);
+  BOOST_CHECK_EQUAL(client.send("second"), 6);
+  BOOST_CHECK_EQUAL(restarted.receive(&received, Transport::NOBLOCK), 6);
+  BOOST_CHECK_EQUAL(received, "second");
+  BOOST_CHECK_EQUAL(restarted.send("reply"), 5);
+  BOOST_CHECK_EQUAL(client.receive(&received), 5);
+  BOOST_CHECK_EQUAL(received, "reply");
+
+  // the old server closes its own segment only
+  server.reset();
+  usleep((TransportShm::replacementCheckMs + 50) * 1000);
+  BOOST_CHECK_EQUAL(restarted.send("after"), 5);
+  BOOST_CHECK_EQUAL(client.receive(&received), 5);
+  BOOST_CHECK_EQUAL(received, "after");
+}
+
+BOOST_AUTO_TEST_CASE(check_shm_wrap) {
+  TransportShm::Options options;
+  options.capacity = 1024;
+  TransportShm server("rrc_test_wrap", TransportShm::SERVER, options);
+  TransportShm client("rrc_test_wrap", TransportShm::CLIENT);
+  std::string received;
+  BOOST_CHECK_EQUAL(client.send(std::string(500, 'a')), 500);
+  BOOST_CHECK_EQUAL(server.receive(&received), 500);
+
+  // larger than the rest of the ring, written at the start after the reader skipped the end
+  std::thread receiver([&]() { server.receive(&received); });
+  BOOST_CHECK_EQUAL(client.send(std::string(700, 'b')), 700);
+  receiver.join();
+  BOOST_CHECK(received == std::string(700, 'b'));
+
+  // without waiting the message fits once the end is skipped
+  BOOST_CHECK_EQUAL(client.send(std::string(800, 'c'), Transport::NOBLOCK), 0);
+  BOOST_CHECK_EQUAL(server.receive(&received, Transport::NOBLOCK), 0);
+  BOOST_CHECK_EQUAL(client.send(std::string(800, 'c'), Transport::NOBLOCK), 800);
+  BOOST_CHECK_EQUAL(server.receive(&received, Transport::NOBLOCK), 800);
+  BOOST_CHECK(received == std::string(800, 'c'));
+
+  // the largest message
+  receiver = std::thread([&]() { server.receive(&received); });
+  BOOST_CHECK_EQUAL(client.send(std::string(1016, 'd')), 1016);
+  receiver.join();
+  BOOST_CHECK(received == std::string(1016, 'd'));
+  BOOST_CHECK_EQUAL(client.send(std::string(1017, 'e')), 0);
+}
+#endif
@@ -1,5 +1,10 @@
 #include <boost/test/unit_test.hpp>
 #include "../src/RingBuffer.hpp"
+#include "../src/LockFreeRingBuffer.hpp"
+#include "../src/TripleBuffer.hpp"
+
+#include <thread>
+#include <string>
 
 
 namespace robot_remote_control {
@@ -8,7 +13,7 @@ namespace robot_remote_control {
  * @brief helper function to fill buffer with increasing numbers
  */
 
-void fillBuffer(unsigned int size, RingBuffer<int> *buffer, bool overwrite = false) {
+void fillBuffer(unsigned int size, TypedRingBufferBase<int> *buffer, bool overwrite = false) {
     for (unsigned int i = 0; i < size; i++) {
         buffer->pushData(i, overwrite);
     }
@@ -149,4 +154,267 @@ BOOST_AUTO_TEST_CASE(resize_buffer) {
     CHECK_BUFFER(5, buffer, 0);
 }
 
+BOOST_AUTO_TEST_CASE(lockfree_push_pop) {
+    LockFreeRingBuffer<int> buffer(5);
+    int data;
+
+    BOOST_CHECK_EQUAL(buffer.popData(&data), false);
+
+    fillBuffer(2, &buffer);
+    BOOST_CHECK_EQUAL(buffer.size(), 2);
+    CHECK_BUFFER(2, buffer, 0);
+    BOOST_CHECK_EQUAL(buffer.size(), 0);
+    BOOST_CHECK_EQUAL(buffer.popData(&data), false);
+
+    // no new items are added, until the buffer was read, so a size5 buffer schoud have 0-4
+    fillBuffer(20, &buffer);
+    BOOST_CHECK_EQUAL(buffer.pushData(0), false);
+    BOOST_CHECK_EQUAL(buffer.size(), 5);
+    CHECK_BUFFER(5, buffer, 0);
+    BOOST_CHECK_EQUAL(buffer.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(lockfree_push_pop_overwrite) {
+    LockFreeRingBuffer<int> buffer(5);
+
+    fillBuffer(2, &buffer, true);
+    CHECK_BUFFER(2, buffer, 0);
+
+    // oldest items are overwritten so a size 5 buffer schoud have 15-19
+    fillBuffer(20, &buffer, true);
+    BOOST_CHECK_EQUAL(buffer.size(), 5);
+    CHECK_BUFFER(5, buffer, 15);
+    BOOST_CHECK_EQUAL(buffer.size(), 0);
+
+    // same after a peek of an item that gets overwritten
+    int data;
+    fillBuffer(3, &buffer, true);
+    BOOST_CHECK_EQUAL(buffer.peekData(&data), true);
+    BOOST_CHECK_EQUAL(data, 0);
+    for (int i = 10; i < 13; ++i) {
+        buffer.pushData(i, true);
+    }
+    // 0 was overwritten
+    BOOST_CHECK_EQUAL(buffer.size(), 5);
+    BOOST_CHECK_EQUAL(buffer.peekData(&data), true);
+    BOOST_CHECK_EQUAL(data, 1);
+    CHECK_BUFFER(2, buffer, 1);
+    CHECK_BUFFER(3, buffer, 10);
+    BOOST_CHECK_EQUAL(buffer.popData(&data), false);
+}
+
+BOOST_AUTO_TEST_CASE(lockfree_peek_latest) {
+    // the way the buffers of the ControlledRobot are used (latest value stored for requests)
+    LockFreeRingBuffer<std::string> buffer(1);
+    std::string data;
+
+    BOOST_CHECK_EQUAL(buffer.peekData(&data), false);
+    for (int i = 0; i < 10; ++i) {
+        buffer.pushData(std::to_string(i), true);
+        BOOST_CHECK_EQUAL(buffer.peekData(&data), true);
+        BOOST_CHECK_EQUAL(data, std::to_string(i));
+        BOOST_CHECK_EQUAL(buffer.peekData(&data), true);
+        BOOST_CHECK_EQUAL(data, std::to_string(i));
+    }
+    BOOST_CHECK_EQUAL(buffer.popData(&data), true);
+    BOOST_CHECK_EQUAL(data, "9");
+    BOOST_CHECK_EQUAL(buffer.peekData(&data), false);
+}
+
+BOOST_AUTO_TEST_CASE(lockfree_concurrent_push_pop) {
+    LockFreeRingBuffer<std::string> buffer(8);
+    const int count = 200000;
+    int received = 0;
+    int last = -1;
+    bool ordered = true;
+
+    std::thread producer([&]() {
+        for (int i = 0; i < count; ++i) {
+            buffer.pushData(std::to_string(i), true);
+        }
+    });
+
+    std::string data;
+    while (last < count - 1) {
+        if (buffer.popData(&data)) {
+            int value = std::stoi(data);
+            ordered &= value > last;
+            last = value;
+            received++;
+        }
+    }
+    producer.join();
+
+    BOOST_CHECK(ordered);
+    BOOST_CHECK_EQUAL(last, count - 1);
+    BOOST_CHECK(received > 0);
+    BOOST_CHECK_EQUAL(buffer.size(), 0);
+}
+
+/**
+ * @brief pushInPlace() writes into the slots, failed fills push nothing and popped memory is reused
+ */
+void checkPushInPlace(TypedRingBufferBase<std::vector<int> > *buffer) {
+    BOOST_CHECK(!buffer->pushInPlace([](std::vector<int> *slot) { return false; }));
+    BOOST_CHECK_EQUAL(buffer->size(), 0);
+
+    for (int round = 0; round < 10; ++round) {
+        BOOST_CHECK(buffer->pushInPlace([round](std::vector<int> *slot) {
+            slot->assign(1000, round);
+            return true;
+        }, true));
+    }
+    BOOST_CHECK_EQUAL(buffer->size(), 2);
+    // a failed fill of the full buffer leaves the oldest element intact
+    BOOST_CHECK(!buffer->pushInPlace([](std::vector<int> *slot) {
+        slot->assign(1, -1);
+        return false;
+    }, true));
+    BOOST_CHECK_EQUAL(buffer->size(), 2);
+
+    // the memory of data goes into the buffer
+    std::vector<int> data(1000);
+    BOOST_CHECK(buffer->popData(&data));
+    BOOST_CHECK_EQUAL(data.size(), 1000);
+    BOOST_CHECK_EQUAL(data[0], 8);
+    // the slots have the capacity of the earlier rounds, so no allocation is needed to fill them
+    const int* memory = data.data();
+    BOOST_CHECK(buffer->pushInPlace([memory](std::vector<int> *slot) {
+        BOOST_CHECK(slot->capacity() >= 1000);
+        slot->assign(1000, 10);
+        return true;
+    }, true));
+    BOOST_CHECK(buffer->popData(&data));
+    BOOST_CHECK_EQUAL(data[0], 9);
+    BOOST_CHECK(memory != data.data());
+}
+
+BOOST_AUTO_TEST_CASE(push_in_place) {
+    RingBuffer<std::vector<int> > buffer(2);
+    checkPushInPlace(&buffer);
+}
+
+BOOST_AUTO_TEST_CASE(lockfree_push_in_place) {
+    LockFreeRingBuffer<std::vector<int> > buffer(2);
+    checkPushInPlace(&buffer);
+}
+
+BOOST_AUTO_TEST_CASE(push_pop_move) {
+    RingBuffer<std::vector<int> > buffer(2);
+    LockFreeRingBuffer<std::vector<int> > lockfree(2);
+    for (TypedRingBufferBase<std::vector<int> > *tested : {static_cast<TypedRingBufferBase<std::vector<int> >*>(&buffer),
+                                                          static_cast<TypedRingBufferBase<std::vector<int> >*>(&lockfree)}) {
+        std::vector<int> data(1000, 1);
+        const int* memory = data.data();
+        BOOST_CHECK(tested->pushData(std::move(data)));
+
+        // moved in and swapped out: the same memory, no copy
+        std::vector<int> received;
+        BOOST_CHECK(tested->popData(&received));
+        BOOST_CHECK_EQUAL(received.size(), 1000);
+        BOOST_CHECK(received.data() == memory);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pop_all) {
+    RingBuffer<int> buffer(5);
+    LockFreeRingBuffer<int> lockfree(5);
+    for (TypedRingBufferBase<int> *tested : {static_cast<TypedRingBufferBase<int>*>(&buffer), static_cast<TypedRingBufferBase<int>*>(&lockfree)}) {
+        // wrapped around and overwritten: 3-7 in order
+        fillBuffer(8, tested, true);
+        std::vector<int> data(1, -1);
+        BOOST_CHECK_EQUAL(tested->popAll(&data), 5);
+        BOOST_CHECK(data == std::vector<int>({-1, 3, 4, 5, 6, 7}));
+        BOOST_CHECK_EQUAL(tested->size(), 0);
+        BOOST_CHECK_EQUAL(tested->popAll(&data), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(peek_all) {
+    RingBuffer<int> buffer(5);
+    fillBuffer(7, &buffer, true);
+    std::vector<int> data;
+    BOOST_CHECK(buffer.peekAll(&data));
+    BOOST_CHECK(data == std::vector<int>({2, 3, 4, 5, 6}));
+    // not removed
+    CHECK_BUFFER(5, buffer, 2);
+
+    LockFreeRingBuffer<int> lockfree(5);
+    BOOST_CHECK(!lockfree.peekAll(&data));
+}
+
+BOOST_AUTO_TEST_CASE(byte_limit) {
+    RingBuffer<std::string> buffer(10);
+    std::atomic<int64_t> total(0);
+    std::shared_ptr<BufferedBytes> counter = std::make_shared<BufferedBytes>(&total);
+    buffer.pushData("before");
+    BOOST_CHECK(buffer.setByteLimit(10, counter));
+    BOOST_CHECK_EQUAL(counter->bytes, 6);
+
+    // the oldest elements are dropped
+    buffer.pushData("aaaa");
+    BOOST_CHECK_EQUAL(buffer.size(), 2);
+    BOOST_CHECK_EQUAL(counter->bytes, 10);
+    buffer.pushData("bbbb");
+    BOOST_CHECK_EQUAL(buffer.size(), 2);
+    BOOST_CHECK_EQUAL(counter->bytes, 8);
+
+    // the newest element is kept above the limit
+    buffer.pushData("0123456789abc");
+    BOOST_CHECK_EQUAL(buffer.size(), 1);
+    BOOST_CHECK_EQUAL(counter->bytes, 13);
+    BOOST_CHECK(!buffer.dropOldest());
+
+    std::string value;
+    BOOST_CHECK(buffer.popData(&value));
+    BOOST_CHECK_EQUAL(value, "0123456789abc");
+    BOOST_CHECK_EQUAL(counter->bytes, 0);
+    BOOST_CHECK_EQUAL(total, 0);
+
+    LockFreeRingBuffer<std::string> lockfree(10);
+    BOOST_CHECK(!lockfree.setByteLimit(10, counter));
+}
+
+BOOST_AUTO_TEST_CASE(triple_buffer_latest_value) {
+    TripleBuffer<std::string> buffer;
+    BOOST_CHECK(!buffer.hasNew());
+    BOOST_CHECK(!buffer.fetch());
+    BOOST_CHECK_EQUAL(buffer.get(), "");
+
+    buffer.write("first");
+    BOOST_CHECK(buffer.write([](std::string *slot) { *slot = "second"; return true; }));
+    // not published
+    BOOST_CHECK(!buffer.write([](std::string *slot) { *slot = "broken"; return false; }));
+    BOOST_CHECK(buffer.hasNew());
+    BOOST_CHECK(buffer.fetch());
+    BOOST_CHECK_EQUAL(buffer.get(), "second");
+    BOOST_CHECK(!buffer.fetch());
+    BOOST_CHECK_EQUAL(buffer.get(), "second");
+}
+
+BOOST_AUTO_TEST_CASE(triple_buffer_concurrent) {
+    TripleBuffer<std::string> buffer;
+    const int count = 200000;
+    int last = -1;
+    bool ordered = true;
+
+    std::thread writer([&]() {
+        for (int i = 0; i < count; ++i) {
+            buffer.write(std::to_string(i));
+        }
+    });
+
+    while (last < count - 1) {
+        if (buffer.fetch()) {
+            int value = std::stoi(buffer.get());
+            ordered &= value > last;
+            last = value;
+        }
+    }
+    writer.join();
+
+    BOOST_CHECK(ordered);
+    BOOST_CHECK(!buffer.hasNew());
+}
+
 }  // namespace robot_remote_control
@@ -0,0 +1,52 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../src/Types/Conversions/rock/MLS.hpp"
+
+#include <cmath>
+#include <map>
+#include <utility>
+
+using namespace robot_remote_control;
+
+BOOST_AUTO_TEST_CASE(check_mls_grid_map_tiles) {
+  // 3x2 tiles, the last column and row are smaller
+  maps::grid::MLSMapKalman mls(maps::grid::Vector2ui(250, 120), base::Vector2d(0.1, 0.1), maps::grid::MLSConfig());
+  mls.at(0, 0).insert(maps::grid::SurfacePatch<maps::grid::MLSConfig::KALMAN>(1, 0.1));
+  mls.at(210, 110).insert(maps::grid::SurfacePatch<maps::grid::MLSConfig::KALMAN>(2, 0.1));
+  mls.at(210, 110).insert(maps::grid::SurfacePatch<maps::grid::MLSConfig::KALMAN>(5, 0.1));
+
+  RockConversion::MLSGridMapTiles tiles(100, 2);
+  std::map<std::pair<int32_t, int32_t>, GridMap> received;
+  auto setTile = [&](const int32_t &x, const int32_t &y, const GridMap &tile) {
+    received[std::make_pair(x, y)] = tile;
+  };
+  BOOST_CHECK_EQUAL(tiles.update(mls, setTile), 6);
+  BOOST_REQUIRE_EQUAL(received.size(), 6);
+
+  GridMap corner = received[std::make_pair(2, 1)];
+  BOOST_REQUIRE(GridMapLayerCodec::decode(&corner));
+  BOOST_CHECK_CLOSE(corner.origin().position().x(), 20, 1e-3);
+  BOOST_CHECK_CLOSE(corner.origin().position().y(), 10, 1e-3);
+  BOOST_REQUIRE_EQUAL(corner.layers_size(), 4);
+  const SimpleSensor &min = corner.layers(0);
+  const SimpleSensor &max = corner.layers(1);
+  const SimpleSensor &patches = corner.layers(3);
+  BOOST_CHECK_EQUAL(min.size().x(), 50);
+  BOOST_CHECK_EQUAL(min.size().y(), 20);
+  // cell 210,110 of the map
+  const int cell = 10 + 10 * 50;
+  BOOST_REQUIRE_EQUAL(min.value_size(), 50 * 20);
+  BOOST_CHECK_CLOSE(min.value(cell), 2, 1e-3);
+  BOOST_CHECK_CLOSE(max.value(cell), 5, 1e-3);
+  BOOST_CHECK_EQUAL(patches.value(cell), 2);
+  BOOST_CHECK(std::isnan(min.value(0)));
+  BOOST_CHECK_EQUAL(patches.value(0), 0);
+
+  // only the tiles of changed cells are converted again
+  received.clear();
+  BOOST_CHECK_EQUAL(tiles.update(mls, setTile), 0);
+  tiles.markDirty(5, 5, 150, 20);
+  BOOST_CHECK_EQUAL(tiles.update(mls, setTile), 2);
+  BOOST_CHECK(received.count(std::make_pair(0, 0)));
+  BOOST_CHECK(received.count(std::make_pair(1, 0)));
+}
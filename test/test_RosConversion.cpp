@@ -0,0 +1,111 @@
+#include <boost/test/unit_test.hpp>
+
+#include "../src/Types/Conversions/ros/sensor_msgs/PointCloud2.hpp"
+
+#include <cstring>
+#include <vector>
+
+using namespace robot_remote_control;
+
+namespace {
+
+void setFloat(sensor_msgs::PointCloud2 *cloud, const size_t &offset, const float &value) {
+  memcpy(cloud->data.data() + offset, &value, sizeof(float));
+}
+
+// 2 rows of 3 points with an intensity and padding in the points and at the end of the rows
+sensor_msgs::PointCloud2 stridedCloud() {
+  sensor_msgs::PointCloud2 cloud;
+  cloud.header.frame_id = "lidar";
+  cloud.height = 2;
+  cloud.width = 3;
+  cloud.is_bigendian = false;
+  cloud.fields.push_back(RosConversion::PointCloud2Fields::floatField("x", 0));
+  cloud.fields.push_back(RosConversion::PointCloud2Fields::floatField("y", 4));
+  cloud.fields.push_back(RosConversion::PointCloud2Fields::floatField("z", 8));
+  cloud.fields.push_back(RosConversion::PointCloud2Fields::floatField("intensity", 16));
+  cloud.point_step = 32;
+  cloud.row_step = cloud.width * cloud.point_step + 16;
+  cloud.data.assign(cloud.height * cloud.row_step, 0);
+  for (uint32_t row = 0; row < cloud.height; ++row) {
+    for (uint32_t column = 0; column < cloud.width; ++column) {
+      const size_t point = row * cloud.row_step + column * cloud.point_step;
+      const float index = row * cloud.width + column;
+      setFloat(&cloud, point, index);
+      setFloat(&cloud, point + 4, index + 0.25);
+      setFloat(&cloud, point + 8, index + 0.5);
+      setFloat(&cloud, point + 16, index * 10);
+    }
+  }
+  return cloud;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(check_pointcloud2_packed_round_trip) {
+  PointCloud pointcloud;
+  pointcloud.set_frame("lidar");
+  const std::vector<float> xyz = {1, 2, 3, 4, 5, 6};
+  PackedPointCloud::setPoints(&pointcloud, xyz.data(), 2);
+
+  sensor_msgs::PointCloud2 cloud;
+  RosConversion::convert(pointcloud, &cloud);
+  BOOST_CHECK_EQUAL(cloud.point_step, sizeof(PackedPointCloud::Point));
+  BOOST_CHECK_EQUAL(cloud.data.size(), xyz.size() * sizeof(float));
+
+  PointCloud converted;
+  RosConversion::convert(cloud, &converted);
+  BOOST_CHECK_EQUAL(converted.frame(), "lidar");
+  BOOST_REQUIRE_EQUAL(PackedPointCloud::size(converted), 2);
+  BOOST_CHECK(memcmp(PackedPointCloud::points(converted), xyz.data(), xyz.size() * sizeof(float)) == 0);
+  BOOST_CHECK_EQUAL(converted.channels_size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(check_pointcloud2_strided_round_trip) {
+  const sensor_msgs::PointCloud2 cloud = stridedCloud();
+  PointCloud pointcloud;
+  RosConversion::convert(cloud, &pointcloud);
+  BOOST_REQUIRE_EQUAL(PackedPointCloud::size(pointcloud), 6);
+  const PackedPointCloud::Point* points = PackedPointCloud::points(pointcloud);
+  const ChannelFloat* intensity = PackedPointCloud::getChannel(pointcloud, "intensity");
+  BOOST_REQUIRE(intensity);
+  BOOST_REQUIRE_EQUAL(intensity->values_size(), 6);
+  for (int i = 0; i < 6; ++i) {
+    BOOST_CHECK_EQUAL(points[i].x, i);
+    BOOST_CHECK_EQUAL(points[i].y, i + 0.25);
+    BOOST_CHECK_EQUAL(points[i].z, i + 0.5);
+    BOOST_CHECK_EQUAL(intensity->values(i), i * 10);
+  }
+
+  // back as an unordered, packed cloud with the intensity behind the points
+  sensor_msgs::PointCloud2 converted;
+  RosConversion::convert(pointcloud, &converted);
+  BOOST_CHECK_EQUAL(converted.height, 1);
+  BOOST_CHECK_EQUAL(converted.width, 6);
+  BOOST_CHECK_EQUAL(converted.point_step, 16);
+  PointCloud again;
+  RosConversion::convert(converted, &again);
+  BOOST_CHECK(again.SerializeAsString() == pointcloud.SerializeAsString());
+}
+
+BOOST_AUTO_TEST_CASE(check_pointcloud2_invalid_layout) {
+  PointCloud pointcloud;
+
+  // z is read behind the point
+  sensor_msgs::PointCloud2 cloud = stridedCloud();
+  cloud.fields[2].offset = 30;
+  RosConversion::convert(cloud, &pointcloud);
+  BOOST_CHECK_EQUAL(PackedPointCloud::size(pointcloud), 0);
+
+  // the values of a field do not fit into the point
+  cloud = stridedCloud();
+  cloud.fields[3].count = 5;
+  RosConversion::convert(cloud, &pointcloud);
+  BOOST_CHECK_EQUAL(PackedPointCloud::size(pointcloud), 0);
+
+  // the rows do not fit into the data
+  cloud = stridedCloud();
+  cloud.row_step = 0xffffffff;
+  RosConversion::convert(cloud, &pointcloud);
+  BOOST_CHECK_EQUAL(PackedPointCloud::size(pointcloud), 0);
+}
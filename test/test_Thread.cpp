@@ -1,6 +1,15 @@
 #include <boost/test/unit_test.hpp>
 
 #include "../src/UpdateThread/UpdateThread.hpp"
+#include "../src/UpdateThread/CallbackExecutor.hpp"
+#include "../src/UpdateThread/Clock.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <unistd.h>
+#include <sched.h>
 
 using namespace robot_remote_control;
 
@@ -28,3 +37,228 @@ BOOST_AUTO_TEST_CASE(thread_stops_correctly)
 
 }
 
+class TestReactorThread: public UpdateThread{
+ public:
+  TestReactorThread():updates(0), wakeup(false) {}
+
+  void update() {
+    updates++;
+  }
+
+  void waitForUpdate(const unsigned int &maxMilliseconds) {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait_for(lock, std::chrono::milliseconds(maxMilliseconds), [this](){return wakeup;});
+    wakeup = false;
+  }
+
+  void notify() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      wakeup = true;
+    }
+    condition.notify_one();
+  }
+
+  std::atomic<int> updates;
+
+ private:
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool wakeup;
+};
+
+BOOST_AUTO_TEST_CASE(reactor_updates_on_event)
+{
+      TestReactorThread t;
+
+      // max wait of 10 s, so updates only happen on notify
+      t.startUpdateThread(10000, UpdateThread::REACTOR);
+
+      for (int i = 1; i <= 3; ++i) {
+        t.notify();
+        Timer timer;
+        timer.start();
+        while (t.updates < i && timer.getElapsedTime() < 5) {
+          usleep(1000);
+        }
+        BOOST_CHECK_EQUAL(t.updates, i);
+        BOOST_CHECK(timer.getElapsedTime() < 1);
+      }
+
+      t.notify();
+      t.stopUpdateThread();
+}
+
+BOOST_AUTO_TEST_CASE(callback_executor_policies)
+{
+      CallbackExecutor executor(1, 100);
+      executor.setPolicy(2, CallbackExecutor::LATEST_ONLY);
+
+      // block the worker, so the following callbacks are queued
+      std::mutex blockMutex;
+      std::unique_lock<std::mutex> block(blockMutex);
+      executor.post(0, [&]() { std::lock_guard<std::mutex> lock(blockMutex); });
+
+      std::vector<int> called;
+      for (int i = 0; i < 5; ++i) {
+        executor.post(1, [&called, i]() { called.push_back(i); });
+        executor.post(2, [&called, i]() { called.push_back(10 + i); });
+      }
+      block.unlock();
+      BOOST_CHECK(executor.waitUntilIdle(5));
+
+      // all of type 1 in order, only the latest of type 2 at the position of the first one
+      std::vector<int> expected = {0, 14, 1, 2, 3, 4};
+      BOOST_CHECK_EQUAL_COLLECTIONS(called.begin(), called.end(), expected.begin(), expected.end());
+      BOOST_CHECK_EQUAL(executor.getDroppedCallbacks(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(callback_executor_drops_oldest)
+{
+      CallbackExecutor executor(1, 3);
+
+      std::mutex blockMutex;
+      std::unique_lock<std::mutex> block(blockMutex);
+      std::atomic<bool> started(false);
+      executor.post(0, [&]() { started = true; std::lock_guard<std::mutex> lock(blockMutex); });
+      Timer timer;
+      timer.start();
+      while (!started && timer.getElapsedTime() < 5) {
+        usleep(1000);
+      }
+
+      std::vector<int> called;
+      for (int i = 0; i < 5; ++i) {
+        bool queued = executor.post(1, [&called, i]() { called.push_back(i); });
+        BOOST_CHECK_EQUAL(queued, i < 3);
+      }
+      block.unlock();
+      BOOST_CHECK(executor.waitUntilIdle(5));
+
+      std::vector<int> expected = {2, 3, 4};
+      BOOST_CHECK_EQUAL_COLLECTIONS(called.begin(), called.end(), expected.begin(), expected.end());
+      BOOST_CHECK_EQUAL(executor.getDroppedCallbacks(), 2);
+}
+
+class TestCpuThread: public UpdateThread{
+ public:
+  TestCpuThread():cpu(-1) {}
+
+  void update() {
+    cpu = sched_getcpu();
+  }
+
+  std::atomic<int> cpu;
+};
+
+BOOST_AUTO_TEST_CASE(thread_cpu_affinity)
+{
+      TestCpuThread t;
+      // a cpu this process is allowed to use
+      int cpu = sched_getcpu();
+      UpdateThread::ThreadOptions options;
+      options.cpus.push_back(cpu);
+      t.startUpdateThread(1, UpdateThread::PERIODIC, options);
+
+      // the options are applied after the thread started, check a later update
+      usleep(50 * 1000);
+      t.stopUpdateThread();
+      BOOST_CHECK_EQUAL(t.cpu, cpu);
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_deadlines)
+{
+      Scheduler scheduler;
+      BOOST_CHECK(scheduler.nextDeadline() == Scheduler::Clock::time_point::max());
+
+      std::vector<int> called;
+      Scheduler::Clock::time_point start = Scheduler::Clock::now();
+      scheduler.schedulePeriodic(std::chrono::milliseconds(10), [&called]() { called.push_back(1); });
+      scheduler.schedule(std::chrono::milliseconds(5), [&called]() { called.push_back(2); });
+      Scheduler::TaskId cancelled = scheduler.schedule(std::chrono::milliseconds(1), [&called]() { called.push_back(3); });
+      BOOST_CHECK(scheduler.cancel(cancelled));
+      BOOST_CHECK(!scheduler.cancel(cancelled));
+      BOOST_CHECK(scheduler.nextDeadline() >= start + std::chrono::milliseconds(5));
+      BOOST_CHECK(scheduler.nextDeadline() < start + std::chrono::milliseconds(10));
+
+      // the times are passed, so the test does not depend on the real time
+      BOOST_CHECK_EQUAL(scheduler.runDue(start), 0);
+      BOOST_CHECK_EQUAL(scheduler.runDue(start + std::chrono::milliseconds(100)), 2);
+      std::vector<int> expected = {2, 1};
+      BOOST_CHECK_EQUAL_COLLECTIONS(called.begin(), called.end(), expected.begin(), expected.end());
+
+      // the missed runs of the periodic task are skipped, the next deadline is in the future
+      BOOST_CHECK_EQUAL(scheduler.size(), 1);
+      BOOST_CHECK(scheduler.nextDeadline() > start + std::chrono::milliseconds(100));
+      BOOST_CHECK(scheduler.nextDeadline() <= start + std::chrono::milliseconds(120));
+}
+
+class TestCountingThread: public UpdateThread{
+ public:
+  TestCountingThread():updates(0) {}
+
+  void update() {
+    updates++;
+  }
+
+  std::atomic<int> updates;
+};
+
+BOOST_AUTO_TEST_CASE(thread_wakes_up_for_scheduled_tasks)
+{
+      for (const UpdateThread::UpdateMode &mode : {UpdateThread::PERIODIC, UpdateThread::REACTOR}) {
+        TestCountingThread t;
+        std::atomic<int> runs(0);
+        t.getScheduler().schedulePeriodic(std::chrono::milliseconds(10), [&runs]() { runs++; });
+        // the update interval is much longer than the period of the task
+        t.startUpdateThread(10000, mode);
+
+        Timer timer;
+        timer.start();
+        while (runs < 3 && timer.getElapsedTime() < 5) {
+          usleep(1000);
+        }
+        BOOST_CHECK(runs >= 3);
+        BOOST_CHECK(timer.getElapsedTime() < 1);
+        if (mode == UpdateThread::PERIODIC) {
+          BOOST_CHECK_EQUAL(t.updates, 0);
+        }
+        t.stopUpdateThread();
+      }
+}
+
+BOOST_AUTO_TEST_CASE(thread_on_virtual_clock)
+{
+      std::shared_ptr<VirtualClock> clock = std::make_shared<VirtualClock>();
+      Clock::setSource(clock);
+      Timer timer;
+      timer.start(1);
+      BOOST_CHECK(!timer.isExpired());
+      clock->advance(std::chrono::seconds(1));
+      BOOST_CHECK(timer.isExpired());
+
+      TestCountingThread t;
+      std::atomic<int> runs(0);
+      t.getScheduler().schedulePeriodic(std::chrono::seconds(1), [&runs]() { runs++; });
+      // real time does not advance the thread
+      t.startUpdateThread(400);
+      usleep(50000);
+      BOOST_CHECK_EQUAL(t.updates, 0);
+
+      // each step jumps to the next deadline: the updates at 0.4, 0.8, 1.2, 1.6 and the task at 1 virtual seconds
+      const Clock::time_point start = Clock::now();
+      for (int step = 0; step < 5; ++step) {
+        while (!clock->getWaiting()) {
+          usleep(100);
+        }
+        BOOST_CHECK(clock->advanceToNextDeadline());
+      }
+      while (!clock->getWaiting()) {
+        usleep(100);
+      }
+      BOOST_CHECK_EQUAL(t.updates, 4);
+      BOOST_CHECK_EQUAL(runs, 1);
+      BOOST_CHECK(Clock::now() - start >= std::chrono::milliseconds(1600));
+      t.stopUpdateThread();
+      Clock::setSource(nullptr);
+}